@@ -71,6 +71,11 @@ const TCHAR* const kUpdateAppsSingleInstance =
 const TCHAR* const kInstallAppSingleInstance =
     _T("%s-{F707E94F-D66B-4525-AD84-B1DA87D6A971}");
 
+// Base name of the shared memory in which the worker publishes the progress of
+// the apps of a bundle. The %s is replaced with the session ID of the bundle.
+const TCHAR* const kProgressTableName =
+    _T("%s-{6E2B9C41-0F5A-4D7E-B3C8-92A1D4F6E0B7}");
+
 // Ensures the GoogleUpdate3 server only runs one instance per machine and one
 // instance per each user session.
 const TCHAR* const kGoogleUpdate3SingleInstance =
@@ -106,6 +111,19 @@ const TCHAR* const kSilentDoNotKillJobObject =
 const TCHAR* const kInstallManagerSerializer =
     _T("{0A175FBE-AEEC-4fea-855A-2AA549A88846}");
 
+// Base name of the mutexes of the install slots, which bound the number of
+// installers which run at the same time for this user/machine. The index of
+// the slot is appended to the name.
+const TCHAR* const kInstallSlotMutex =
+    _T("{3E9B7C52-61D4-4F0A-B8E3-5A2C9D7F1B64}");
+
+// Base name of the lock which ensures that an app is installed by a single
+// installer for this user/machine at a given time, when the installers are
+// not serialized by kInstallManagerSerializer. The app id is appended to the
+// name.
+const TCHAR* const kAppInstallSerializer =
+    _T("{A6D2F813-0C5B-4E97-9D41-7B3E8F2A6C05}");
+
 // Serializes access to metrics stores, machine and user, respectively.
 const TCHAR* const kMetricsSerializer =
     _T("{C68009EA-1163-4498-8E93-D5C4E317D8CE}");
@@ -114,6 +132,15 @@ const TCHAR* const kMetricsSerializer =
 const TCHAR* const kRegistryAccessMutex =
     _T("{66CC0160-ABB3-4066-AE47-1CA6AD5065C8}");
 
+// Serializes access to the journal of persisted pings.
+const TCHAR* const kPingJournalSerializer =
+    _T("{5E0C3B8A-2F7D-4C61-9A4E-8B1D6F3E7C25}");
+
+// Serializes the updates of the crash index, which are loaded, changed, and
+// saved by the crash handlers and the processes which report crashes.
+const TCHAR* const kCrashIndexSerializer =
+    _T("{8F3A6D21-4B7E-4C0A-9E52-D1B6A7C3F840}");
+
 // Serializes opt user id generation.
 const TCHAR* const kOptUserIdLock =
     _T("{D19BAF17-7C87-467E-8D63-6C4B1C836373}");
@@ -285,6 +285,10 @@ const TCHAR* const kRegValueTestSource              = _T("TestSource");
 const TCHAR* const kRegValueAuCheckPeriodMs         = _T("AuCheckPeriodMs");
 const TCHAR* const kRegValueCrCheckPeriodMs         = _T("CrCheckPeriodMs");
 const TCHAR* const kRegValueAutoUpdateJitterMs      = _T("AutoUpdateJitterMs");
+const TCHAR* const kRegValueMaxConcurrentDownloads  =
+    _T("MaxConcurrentDownloads");
+const TCHAR* const kRegValueMaxDownloadBytesPerSec  =
+    _T("MaxDownloadBytesPerSec");
 const TCHAR* const kRegValueProxyHost               = _T("ProxyHost");
 const TCHAR* const kRegValueProxyPort               = _T("ProxyPort");
 const TCHAR* const kRegValueMID                     = _T("mid");
@@ -485,6 +489,16 @@ const int kSetupUpdateShutdownWaitMs  = 3 * 60 * 1000;  // 3 minutes.
 // when needed.
 const int kWaitForMSIExecuteMs                = 5 * 60000;  // 5 minutes.
 
+// The maximum number of apps that download at the same time, across all the
+// bundles of a worker process.
+const int kDefaultMaxConcurrentDownloads = 4;
+const int kMaxConcurrentDownloadsLimit   = 16;
+
+// The maximum number of installers that run at the same time in a worker
+// process. MSI installers are always run one at a time.
+const int kDefaultMaxConcurrentInstalls = 1;
+const int kMaxConcurrentInstallsLimit   = 4;
+
 // The Scheduled Tasks are initially set to start 5 minutes from the
 // installation time.
 #define kScheduledTaskDelayStartNs (5 * kMinsTo100ns);
@@ -528,6 +542,9 @@ const COLORREF kProgressLeftHighlightColor = RGB(0xbd, 0xbd, 0xbd);
 // ***                                                       ***
 const TCHAR kHeaderUserAgent[]           = _T("User-Agent");
 
+// The content coding of a compressed request body.
+const TCHAR kHeaderContentEncoding[]     = _T("Content-Encoding");
+
 // The HRESULT and HTTP status code updated by the prior
 // NetworkRequestImpl::DoSendHttpRequest() call.
 const TCHAR kHeaderXLastHR[]             = _T("X-Last-HR");
@@ -609,6 +626,13 @@ const TCHAR kWeakETagPrefix[]            = _T("W/");
 // before trying to do a subsequent update check is capped at 24 hours.
 const TCHAR kHeaderXRetryAfter[]         = _T("X-Retry-After");
 
+// The server uses the optional X-Request-Encoding header to indicate the
+// content codings it accepts for request bodies, for instance "gzip". The
+// client compresses subsequent requests with the first coding it supports.
+// The value "identity" turns compression off. Like X-Retry-After, the header
+// is only trusted over https.
+const TCHAR kHeaderXRequestEncoding[]    = _T("X-Request-Encoding");
+
 }  // namespace omaha
 
 #endif  // OMAHA_BASE_CONSTANTS_H_
@@ -202,6 +202,11 @@ const ULONG kFacilityOmaha = 67;
 #define GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED \
     MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50E)
 
+// The patch of a package is malformed or does not apply to the cached package
+// of the previous version.
+#define GOOPDATEDOWNLOAD_E_INVALID_PATCH            \
+    MAKE_OMAHA_HRESULT(SEVERITY_ERROR, 0x50F)
+
 #define GOOPDATEDOWNLOAD_E_FAILED_MOVE              \
     MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0x5FF)
 
@@ -520,6 +525,12 @@ const ULONG kFacilityOmaha = 67;
 
 // Crash handling error codes.
 
+// The crash reporting did not upload the crash because the same crash was
+// uploaded recently. The duplicate is counted and the count is sent with the
+// next upload of the crash.
+#define GOOPDATE_E_CRASH_DUPLICATE                           \
+    MAKE_HRESULT(SEVERITY_ERROR, FACILITY_ITF, 0xFFF9)
+
 // The crash reporting cannot start the crash server for
 // out-of-process crash handling.
 #define GOOPDATE_E_CRASH_START_SERVER_FAILED                 \
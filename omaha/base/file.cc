@@ -58,6 +58,7 @@
 #include "omaha/base/file.h"
 
 #include <algorithm>
+#include <limits>
 #include <memory>
 
 #include "omaha/base/app_util.h"
@@ -78,6 +79,10 @@ namespace omaha {
 // Constants
 const uint32 kZeroSize = 4096;  // Buffer size used for clearing data in a file.
 
+// The files are compared with mapped views of this size, so that large files
+// do not use much address space.
+const size_t kCompareViewSize = 16 * 1024 * 1024;
+
 // The moves-pending-reboot is a MULTISZ registry key in the HKLM part of the
 // registry.
 static const TCHAR* kSessionManagerKey =
@@ -107,9 +112,28 @@ HRESULT File::OpenShareMode(const TCHAR* file_name,
                             bool write,
                             bool async,
                             DWORD share_mode) {
+  VERIFY1(!async);
+  return DoOpen(file_name, write, share_mode, RANDOM_ACCESS, FILE_READ_DATA);
+}
+
+// The sequential access pattern lets the cache manager read ahead more
+// aggressively and discard the pages which have been read. Mapping a view of
+// the file requires GENERIC_READ access, so the files opened with an access
+// pattern can be mapped.
+HRESULT File::OpenWithAccessPattern(const TCHAR* file_name,
+                                    bool write,
+                                    DWORD share_mode,
+                                    AccessPattern access_pattern) {
+  return DoOpen(file_name, write, share_mode, access_pattern, GENERIC_READ);
+}
+
+HRESULT File::DoOpen(const TCHAR* file_name,
+                     bool write,
+                     DWORD share_mode,
+                     AccessPattern access_pattern,
+                     DWORD read_access) {
   ASSERT1(file_name && *file_name);
   ASSERT1(handle_ == INVALID_HANDLE_VALUE);
-  VERIFY1(!async);
 
   file_name_ = file_name;
 
@@ -118,24 +142,25 @@ HRESULT File::OpenShareMode(const TCHAR* file_name,
   // FILE_FLAG_WRITE_THROUGH
   // how efficient is NTFS encryption? FILE_ATTRIBUTE_ENCRYPTED
   // FILE_ATTRIBUTE_TEMPORARY
-  // FILE_FLAG_RANDOM_ACCESS
-  // FILE_FLAG_SEQUENTIAL_SCAN
 
   handle_ = ::CreateFile(file_name,
                          write ? (FILE_WRITE_DATA       |
                                   FILE_WRITE_ATTRIBUTES |
-                                  FILE_READ_DATA) : FILE_READ_DATA,
+                                  read_access) : read_access,
                          share_mode,
                          NULL,
                          write ? OPEN_ALWAYS : OPEN_EXISTING,
-                         FILE_FLAG_RANDOM_ACCESS,
+                         access_pattern == SEQUENTIAL_ACCESS ?
+                             FILE_FLAG_SEQUENTIAL_SCAN :
+                             FILE_FLAG_RANDOM_ACCESS,
                          NULL);
 
   if (handle_ == INVALID_HANDLE_VALUE) {
     HRESULT hr = HRESULTFromLastError();
     UTIL_LOG(LEVEL_ERROR,
-            (_T("[File::OpenShareMode - CreateFile failed][%s][%d][%d][0x%x]"),
-             file_name, write, async, hr));
+            (_T("[File::OpenWithAccessPattern - CreateFile failed]")
+             _T("[%s][%d][%d][0x%x]"),
+             file_name, write, access_pattern, hr));
     return hr;
   }
 
@@ -144,7 +169,8 @@ HRESULT File::OpenShareMode(const TCHAR* file_name,
       !::SetFileAttributes(file_name, FILE_ATTRIBUTE_NOT_CONTENT_INDEXED)) {
     HRESULT hr = HRESULTFromLastError();
     UTIL_LOG(LEVEL_ERROR,
-            (_T("[File::OpenShareMode - SetFileAttributes failed][0x%x]"), hr));
+            (_T("[File::OpenWithAccessPattern - SetFileAttributes failed]")
+             _T("[0x%x]"), hr));
     return hr;
   }
 
@@ -1131,6 +1157,120 @@ HRESULT File::GetLength(uint32* length) {
   return S_OK;
 }
 
+HRESULT File::ReadAt64(uint64 offset,
+                       byte* buf,
+                       uint32 len,
+                       uint32* bytes_read) {
+  ASSERT1(handle_ != INVALID_HANDLE_VALUE);
+  ASSERT1(buf);
+  ASSERT1(len);
+
+  // The offset in the OVERLAPPED structure is used by synchronous reads too.
+  OVERLAPPED overlapped = {0};
+  overlapped.Offset = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+  DWORD read = 0;
+  if (!::ReadFile(handle_, buf, len, &read, &overlapped)) {
+    HRESULT hr = HRESULTFromLastError();
+    if (hr != HRESULT_FROM_WIN32(ERROR_HANDLE_EOF)) {
+      UTIL_LOG(LEVEL_ERROR, (_T("[File::ReadAt64]")
+                             _T("[ReadFile failed][%s][0x%x]"),
+                             file_name_, hr));
+      return hr;
+    }
+    read = 0;
+  }
+
+  if (bytes_read) {
+    *bytes_read = read;
+  }
+  return S_OK;
+}
+
+HRESULT File::WriteAt64(uint64 offset,
+                        const byte* buf,
+                        uint32 len,
+                        uint32* bytes_written) {
+  ASSERT1(handle_ != INVALID_HANDLE_VALUE);
+  ASSERT1(!read_only_);
+  ASSERT1(buf);
+  ASSERT1(len);
+
+  OVERLAPPED overlapped = {0};
+  overlapped.Offset = static_cast<DWORD>(offset);
+  overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+  DWORD wrote = 0;
+  if (!::WriteFile(handle_, buf, len, &wrote, &overlapped)) {
+    HRESULT hr = HRESULTFromLastError();
+    UTIL_LOG(LEVEL_ERROR, (_T("[File::WriteAt64]")
+                           _T("[WriteFile failed][%s][0x%x]"),
+                           file_name_, hr));
+    return hr;
+  }
+
+  if (bytes_written) {
+    *bytes_written = wrote;
+  }
+  return (wrote == len) ? S_OK : E_FAIL;
+}
+
+// The new data is not zeroed on disk, but reads of it return zeros.
+HRESULT File::SetLength64(uint64 length) {
+  ASSERT1(handle_ != INVALID_HANDLE_VALUE);
+  ASSERT1(!read_only_);
+
+  FILE_END_OF_FILE_INFO info = {0};
+  info.EndOfFile.QuadPart = static_cast<LONGLONG>(length);
+  if (!::SetFileInformationByHandle(handle_,
+                                    FileEndOfFileInfo,
+                                    &info,
+                                    sizeof(info))) {
+    HRESULT hr = HRESULTFromLastError();
+    UTIL_LOG(LEVEL_ERROR, (_T("[File::SetLength64]")
+                           _T("[SetFileInformationByHandle failed][%s][0x%x]"),
+                           file_name_, hr));
+    return hr;
+  }
+  return S_OK;
+}
+
+HRESULT File::GetLength64(uint64* length) {
+  ASSERT1(length);
+  ASSERT1(handle_ != INVALID_HANDLE_VALUE);
+
+  LARGE_INTEGER size = {0};
+  if (!::GetFileSizeEx(handle_, &size)) {
+    HRESULT hr = HRESULTFromLastError();
+    UTIL_LOG(LEVEL_ERROR, (_T("[File::GetLength64]")
+                           _T("[GetFileSizeEx failed][%s][0x%x]"),
+                           file_name_, hr));
+    return hr;
+  }
+  *length = static_cast<uint64>(size.QuadPart);
+  return S_OK;
+}
+
+HRESULT File::Preallocate(uint64 length) {
+  ASSERT1(handle_ != INVALID_HANDLE_VALUE);
+  ASSERT1(!read_only_);
+
+  FILE_ALLOCATION_INFO info = {0};
+  info.AllocationSize.QuadPart = static_cast<LONGLONG>(length);
+  if (!::SetFileInformationByHandle(handle_,
+                                    FileAllocationInfo,
+                                    &info,
+                                    sizeof(info))) {
+    HRESULT hr = HRESULTFromLastError();
+    UTIL_LOG(LEVEL_ERROR, (_T("[File::Preallocate]")
+                           _T("[SetFileInformationByHandle failed][%s][0x%x]"),
+                           file_name_, hr));
+    return hr;
+  }
+  return S_OK;
+}
+
 HRESULT File::Touch() {
   ASSERT1(handle_ != INVALID_HANDLE_VALUE);
 
@@ -1223,6 +1363,23 @@ HRESULT File::GetFileSizeUnopen(const TCHAR* filename, uint32* out_size) {
   return S_OK;
 }
 
+HRESULT File::GetFileSizeUnopen64(const TCHAR* filename, uint64* out_size) {
+  ASSERT1(filename);
+  ASSERT1(out_size);
+
+  WIN32_FILE_ATTRIBUTE_DATA data;
+  SetZero(data);
+
+  if (!::GetFileAttributesEx(filename, ::GetFileExInfoStandard, &data)) {
+    return HRESULTFromLastError();
+  }
+
+  *out_size = (static_cast<uint64>(data.nFileSizeHigh) << 32) |
+              data.nFileSizeLow;
+
+  return S_OK;
+}
+
 // Get the last time with a file was written to, and the size
 HRESULT File::GetLastWriteTimeAndSize(const TCHAR* file_path,
                                       SYSTEMTIME* out_time,
@@ -1261,89 +1418,278 @@ HRESULT File::GetLastWriteTimeAndSize(const TCHAR* file_path,
   return S_OK;
 }
 
+namespace {
+
+// Reading a mapped view raises EXCEPTION_IN_PAGE_ERROR instead of returning
+// an error when the file can't be read, for instance when it is on a network
+// drive which is disconnected. The function has no objects to unwind, which
+// structured exception handling requires.
+HRESULT CompareMappedData(const byte* data1,
+                          const byte* data2,
+                          size_t length,
+                          bool* are_equal) {
+  __try {
+    *are_equal = memcmp(data1, data2, length) == 0;
+  } __except(GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ?
+                 EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH) {
+    return HRESULT_FROM_WIN32(ERROR_READ_FAULT);
+  }
+  return S_OK;
+}
+
+}  // namespace
+
 bool File::AreFilesIdentical(const TCHAR* filename1, const TCHAR* filename2) {
   UTIL_LOG(L4, (_T("[File::AreFilesIdentical][%s][%s]"), filename1, filename2));
 
-  uint32 file_size1 = 0;
-  HRESULT hr = File::GetFileSizeUnopen(filename1, &file_size1);
+  File file1;
+  HRESULT hr = file1.OpenWithAccessPattern(filename1,
+                                           false,
+                                           FILE_SHARE_READ,
+                                           SEQUENTIAL_ACCESS);
   if (FAILED(hr)) {
-    UTIL_LOG(LE, (_T("[GetFileSizeUnopen failed file_size1][0x%x]"), hr));
+    UTIL_LOG(LE, (_T("[file1.OpenWithAccessPattern failed][0x%x]"), hr));
     return false;
   }
 
-  uint32 file_size2 = 0;
-  hr = File::GetFileSizeUnopen(filename2, &file_size2);
+  File file2;
+  hr = file2.OpenWithAccessPattern(filename2,
+                                   false,
+                                   FILE_SHARE_READ,
+                                   SEQUENTIAL_ACCESS);
   if (FAILED(hr)) {
-    UTIL_LOG(LE, (_T("[GetFileSizeUnopen failed file_size2][0x%x]"), hr));
+    UTIL_LOG(LE, (_T("[file2.OpenWithAccessPattern failed][0x%x]"), hr));
     return false;
   }
 
-  if (file_size1 != file_size2) {
-    UTIL_LOG(L3, (_T("[file_size1 != file_size2][%d][%d]"),
-                  file_size1, file_size2));
+  BY_HANDLE_FILE_INFORMATION info1 = {0};
+  BY_HANDLE_FILE_INFORMATION info2 = {0};
+  if (!::GetFileInformationByHandle(file1.handle_, &info1) ||
+      !::GetFileInformationByHandle(file2.handle_, &info2)) {
+    hr = HRESULTFromLastError();
+    UTIL_LOG(LE, (_T("[GetFileInformationByHandle failed][0x%x]"), hr));
     return false;
   }
 
-  File file1;
-  hr = file1.OpenShareMode(filename1, false, false, FILE_SHARE_READ);
-  if (FAILED(hr)) {
-    UTIL_LOG(LE, (_T("[file1.OpenShareMode failed][0x%x]"), hr));
-    return false;
+  // The same file, or two hard links to the same file.
+  if (info1.dwVolumeSerialNumber == info2.dwVolumeSerialNumber &&
+      info1.nFileIndexHigh == info2.nFileIndexHigh &&
+      info1.nFileIndexLow == info2.nFileIndexLow) {
+    UTIL_LOG(L4, (_T("[same file]")));
+    return true;
   }
 
-  File file2;
-  hr = file2.OpenShareMode(filename2, false, false, FILE_SHARE_READ);
-  if (FAILED(hr)) {
-    UTIL_LOG(LE, (_T("[file2.OpenShareMode failed][0x%x]"), hr));
+  const uint64 file_size1 =
+      (static_cast<uint64>(info1.nFileSizeHigh) << 32) | info1.nFileSizeLow;
+  const uint64 file_size2 =
+      (static_cast<uint64>(info2.nFileSizeHigh) << 32) | info2.nFileSizeLow;
+  if (file_size1 != file_size2) {
+    UTIL_LOG(L3, (_T("[file_size1 != file_size2][%llu][%llu]"),
+                  file_size1, file_size2));
     return false;
   }
 
-  static const uint32 kBufferSize = 0x10000;
-  std::vector<uint8> buffer1(kBufferSize);
-  std::vector<uint8> buffer2(kBufferSize);
-  uint32 bytes_left = file_size1;
+  // memcmp is vectorized by the CRT, and comparing the mapped views does not
+  // copy the data of the files. The files are mapped once, and the views
+  // move through the mappings.
+  MappedFileView view1;
+  MappedFileView view2;
+  for (uint64 offset = 0; offset < file_size1; offset += kCompareViewSize) {
+    const size_t length = static_cast<size_t>(
+        std::min(file_size1 - offset, static_cast<uint64>(kCompareViewSize)));
 
-  while (bytes_left > 0) {
-    uint32 bytes_to_read = std::min(bytes_left, kBufferSize);
-    uint32 bytes_read1 = 0;
-    uint32 bytes_read2 = 0;
-
-    hr = file1.Read(bytes_to_read, &buffer1.front(), &bytes_read1);
+    hr = view1.Map(&file1, offset, length);
     if (FAILED(hr)) {
-      UTIL_LOG(LE, (_T("[file1.Read failed][%d][%d][0x%x]"),
-                    bytes_left, bytes_to_read, hr));
+      UTIL_LOG(LE, (_T("[view1.Map failed][%llu][0x%x]"), offset, hr));
       return false;
     }
-
-    hr = file2.Read(bytes_to_read, &buffer2.front(), &bytes_read2);
+    hr = view2.Map(&file2, offset, length);
     if (FAILED(hr)) {
-      UTIL_LOG(LE, (_T("[file2.Read failed][%d][%d][0x%x]"),
-                    bytes_left, bytes_to_read, hr));
+      UTIL_LOG(LE, (_T("[view2.Map failed][%llu][0x%x]"), offset, hr));
       return false;
     }
 
-    if (bytes_to_read != bytes_read1 || bytes_to_read != bytes_read2) {
-      UTIL_LOG(LE,
-          (_T("[bytes_to_read != bytes_read1 || bytes_to_read != bytes_read2]")
-          _T("[%d][%d][%d]"), bytes_to_read, bytes_read1, bytes_read2));
+    bool are_equal = false;
+    hr = CompareMappedData(view1.data(), view2.data(), length, &are_equal);
+    if (FAILED(hr)) {
+      UTIL_LOG(LE, (_T("[CompareMappedData failed][%llu][0x%x]"),
+                    offset, hr));
       return false;
     }
-
-    if (memcmp(&buffer1.front(), &buffer2.front(), bytes_read1) != 0) {
-      UTIL_LOG(L3, (_T("[memcmp failed][%d][%d]"), bytes_left, bytes_read1));
+    if (!are_equal) {
+      UTIL_LOG(L3, (_T("[memcmp failed][%llu]"), offset));
       return false;
     }
+  }
 
-    if (bytes_left < bytes_to_read) {
-      UTIL_LOG(LE, (_T("[bytes_left < bytes_to_read][%d][%d]"),
-                    bytes_left, bytes_to_read));
-      return false;
+  return true;
+}
+
+namespace {
+
+// The state shared by the threads which compare files in parallel.
+struct CompareFilesContext {
+  const std::vector<CString>* filenames1;
+  const std::vector<CString>* filenames2;
+  std::vector<int> are_identical;
+  volatile LONG next_index;
+};
+
+DWORD WINAPI CompareFilesThreadProc(void* param) {
+  CompareFilesContext* context = static_cast<CompareFilesContext*>(param);
+  const LONG num_files = static_cast<LONG>(context->filenames1->size());
+  for (;;) {
+    const LONG index = ::InterlockedIncrement(&context->next_index) - 1;
+    if (index >= num_files) {
+      return 0;
     }
+    context->are_identical[index] = File::AreFilesIdentical(
+        (*context->filenames1)[index], (*context->filenames2)[index]);
+  }
+}
 
-    bytes_left -= bytes_to_read;
+}  // namespace
+
+void File::AreFilesIdentical(const std::vector<CString>& filenames1,
+                             const std::vector<CString>& filenames2,
+                             int max_threads,
+                             std::vector<bool>* are_identical) {
+  ASSERT1(filenames1.size() == filenames2.size());
+  ASSERT1(max_threads > 0);
+  ASSERT1(are_identical);
+
+  CompareFilesContext context;
+  context.filenames1 = &filenames1;
+  context.filenames2 = &filenames2;
+  context.are_identical.resize(filenames1.size(), false);
+  context.next_index = 0;
+
+  // The calling thread compares files too. If a thread can't be created, the
+  // other threads compare its share of the files.
+  const size_t num_threads =
+      std::min(static_cast<size_t>(max_threads), filenames1.size());
+  std::vector<HANDLE> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    HANDLE thread = ::CreateThread(NULL, 0, CompareFilesThreadProc, &context,
+                                   0, NULL);
+    if (!thread) {
+      UTIL_LOG(LW, (_T("[CreateThread failed][0x%x]"), HRESULTFromLastError()));
+      break;
+    }
+    threads.push_back(thread);
   }
 
-  return true;
+  CompareFilesThreadProc(&context);
+
+  for (size_t i = 0; i != threads.size(); ++i) {
+    VERIFY1(::WaitForSingleObject(threads[i], INFINITE) == WAIT_OBJECT_0);
+    VERIFY1(::CloseHandle(threads[i]));
+  }
+
+  are_identical->assign(context.are_identical.begin(),
+                        context.are_identical.end());
+}
+
+MappedFileView::MappedFileView()
+    : mapped_file_(NULL),
+      mapped_file_handle_(INVALID_HANDLE_VALUE),
+      data_(NULL),
+      length_(0) {
+}
+
+MappedFileView::~MappedFileView() {
+  Unmap();
+}
+
+HRESULT MappedFileView::Map(File* file, uint64 offset, size_t length) {
+  ASSERT1(file);
+  ASSERT1(file->handle_ != INVALID_HANDLE_VALUE);
+
+  // The mapping of the file is kept when the next view is in the same file.
+  UnmapView();
+  if (mapped_file_ != file || mapped_file_handle_ != file->handle_) {
+    Unmap();
+  }
+
+  uint64 file_length = 0;
+  HRESULT hr = file->GetLength64(&file_length);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (offset > file_length) {
+    return E_INVALIDARG;
+  }
+  const uint64 bytes_left = file_length - offset;
+  if (!length) {
+    if (bytes_left > std::numeric_limits<size_t>::max()) {
+      return E_INVALIDARG;
+    }
+    length = static_cast<size_t>(bytes_left);
+  } else if (length > bytes_left) {
+    return E_INVALIDARG;
+  }
+
+  // Empty files can't be mapped.
+  if (!length) {
+    return S_OK;
+  }
+
+  if (!valid(file_mapping_)) {
+    reset(file_mapping_, ::CreateFileMapping(file->handle_,
+                                             NULL,
+                                             PAGE_READONLY,
+                                             0,
+                                             0,
+                                             NULL));
+    if (!valid(file_mapping_)) {
+      hr = HRESULTFromLastError();
+      UTIL_LOG(LEVEL_ERROR, (_T("[MappedFileView::Map]")
+                             _T("[CreateFileMapping failed][%s][0x%x]"),
+                             file->file_name_, hr));
+      return hr;
+    }
+    mapped_file_ = file;
+    mapped_file_handle_ = file->handle_;
+  }
+
+  // Views start at a multiple of the allocation granularity.
+  SYSTEM_INFO system_info = {0};
+  ::GetSystemInfo(&system_info);
+  const uint64 view_offset =
+      offset - offset % system_info.dwAllocationGranularity;
+  const size_t data_offset = static_cast<size_t>(offset - view_offset);
+
+  reset(view_, ::MapViewOfFile(get(file_mapping_),
+                               FILE_MAP_READ,
+                               static_cast<DWORD>(view_offset >> 32),
+                               static_cast<DWORD>(view_offset),
+                               data_offset + length));
+  if (!valid(view_)) {
+    hr = HRESULTFromLastError();
+    UTIL_LOG(LEVEL_ERROR, (_T("[MappedFileView::Map]")
+                           _T("[MapViewOfFile failed][%s][0x%x]"),
+                           file->file_name_, hr));
+    Unmap();
+    return hr;
+  }
+
+  data_ = static_cast<const byte*>(get(view_)) + data_offset;
+  length_ = length;
+  return S_OK;
+}
+
+void MappedFileView::Unmap() {
+  UnmapView();
+  reset(file_mapping_);
+  mapped_file_ = NULL;
+  mapped_file_handle_ = INVALID_HANDLE_VALUE;
+}
+
+void MappedFileView::UnmapView() {
+  reset(view_);
+  data_ = NULL;
+  length_ = 0;
 }
 
 FileLock::FileLock() {
@@ -33,6 +33,12 @@ namespace omaha {
 
 class File {
  public:
+    // Tells the cache manager how the file is going to be read.
+    enum AccessPattern {
+      RANDOM_ACCESS,
+      SEQUENTIAL_ACCESS,
+    };
+
     File();
     ~File();
 
@@ -41,6 +47,10 @@ class File {
                           bool write,
                           bool async,
                           DWORD share_mode);
+    HRESULT OpenWithAccessPattern(const TCHAR* file_name,
+                                  bool write,
+                                  DWORD share_mode,
+                                  AccessPattern access_pattern);
 
     HRESULT Close();
 
@@ -137,6 +147,24 @@ class File {
                             uint32 *new_size, bool clear_new_space);
     HRESULT GetLength(uint32 *len);
 
+    // 64-bit versions of the functions above, for files larger than 4 GB.
+    //
+    // ReadAt64 and WriteAt64 take the position of the data in the call and
+    // do not need a seek. Reading past the end of the file is not an error,
+    // and |bytes_read| is then less than |len|.
+    HRESULT ReadAt64(uint64 offset, byte* buf, uint32 len, uint32* bytes_read);
+    HRESULT WriteAt64(uint64 offset,
+                      const byte* buf,
+                      uint32 len,
+                      uint32* bytes_written);
+    HRESULT SetLength64(uint64 length);
+    HRESULT GetLength64(uint64* length);
+
+    // Reserves the disk space for |length| bytes without changing the length
+    // of the file. Files which are written sequentially are then less
+    // fragmented, and running out of disk space is detected before writing.
+    HRESULT Preallocate(uint64 length);
+
     // Sets the last write time to the current time
     HRESULT Touch();
 
@@ -154,6 +182,8 @@ class File {
     // and locked]
     static HRESULT GetFileSizeUnopen(const TCHAR * filename,
                                      uint32 * out_size);
+    static HRESULT GetFileSizeUnopen64(const TCHAR* filename,
+                                       uint64* out_size);
 
     // Optimized function that gets the last write time and size
     static HRESULT GetLastWriteTimeAndSize(const TCHAR* file_path,
@@ -164,6 +194,13 @@ class File {
     static bool AreFilesIdentical(const TCHAR* filename1,
                                   const TCHAR* filename2);
 
+    // Compares each file in |filenames1| with the file at the same index in
+    // |filenames2|, using up to |max_threads| threads.
+    static void AreFilesIdentical(const std::vector<CString>& filenames1,
+                                  const std::vector<CString>& filenames2,
+                                  int max_threads,
+                                  std::vector<bool>* are_identical);
+
  private:
     // See if we have any moves pending a reboot. Return SUCCESS if we do
     // not encounter errors (not finding a move is not an error). We need to
@@ -183,6 +220,16 @@ class File {
       size_t* value_size_chars_ptr,
       bool* found_ptr);
 
+    // Opens the file with |read_access|, and with write access if |write|
+    // is true.
+    HRESULT DoOpen(const TCHAR* file_name,
+                   bool write,
+                   DWORD share_mode,
+                   AccessPattern access_pattern,
+                   DWORD read_access);
+
+    friend class MappedFileView;
+
     HANDLE handle_;
     CString file_name_;
     bool read_only_;
@@ -196,6 +243,38 @@ class File {
     DISALLOW_COPY_AND_ASSIGN(File);
 };
 
+// A read-only view of a range of an open file, mapped in memory. Reading the
+// data from the view avoids copying it to an intermediate buffer.
+class MappedFileView {
+ public:
+  MappedFileView();
+  ~MappedFileView();
+
+  // Maps |length| bytes of |file| starting at |offset|, or the rest of the
+  // file if |length| is 0. The file must be opened with
+  // File::OpenWithAccessPattern, and stay open while the view is mapped.
+  // Mapping another range of the same file reuses the mapping of the file.
+  HRESULT Map(File* file, uint64 offset, size_t length);
+  void Unmap();
+
+  // Returns NULL if the mapped range is empty.
+  const byte* data() const { return data_; }
+  size_t length() const { return length_; }
+
+ private:
+  // Unmaps the view and keeps the mapping of the file.
+  void UnmapView();
+
+  scoped_file_mapping file_mapping_;
+  const File* mapped_file_;
+  HANDLE mapped_file_handle_;
+  scoped_file_view view_;
+  const byte* data_;
+  size_t length_;
+
+  DISALLOW_COPY_AND_ASSIGN(MappedFileView);
+};
+
 // File lock
 class FileLock {
  public:
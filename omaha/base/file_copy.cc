@@ -0,0 +1,216 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/file_copy.h"
+
+#include <atlstr.h>
+#include <algorithm>
+#include <memory>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/signatures.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+const DWORD kCopyBufferSize = 1024 * 1024;
+
+// Unbuffered writes must be multiples of the sector size of the volume, which
+// divides this size.
+const DWORD kWriteAlignment = 4096;
+
+// The destination file is written to a file with this suffix, which is then
+// renamed.
+const TCHAR kTempFileSuffix[] = _T(".tmp");
+
+// Creates the file for writing without buffering, or with buffering if the
+// volume does not support unbuffered writes.
+HRESULT CreateDestinationFile(const TCHAR* file_path, scoped_hfile* file) {
+  ASSERT1(file_path);
+  ASSERT1(file);
+
+  const DWORD kFlags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+  reset(*file, ::CreateFile(file_path,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            kFlags | FILE_FLAG_NO_BUFFERING,
+                            NULL));
+  if (valid(*file)) {
+    return S_OK;
+  }
+
+  HRESULT hr = HRESULTFromLastError();
+  if (hr != HRESULT_FROM_WIN32(ERROR_INVALID_PARAMETER)) {
+    return hr;
+  }
+
+  UTIL_LOG(L3, (_T("[unbuffered writes not supported][%s]"), file_path));
+  reset(*file, ::CreateFile(file_path,
+                            GENERIC_WRITE,
+                            0,
+                            NULL,
+                            CREATE_ALWAYS,
+                            kFlags,
+                            NULL));
+  return valid(*file) ? S_OK : HRESULTFromLastError();
+}
+
+// Copies |file_size| bytes from |source_file| to a new file at
+// |destination_file_path| and hashes them.
+HRESULT CopyAndHashData(HANDLE source_file,
+                        uint64 file_size,
+                        const FILETIME& last_write_time,
+                        const TCHAR* destination_file_path,
+                        std::vector<byte>* hash) {
+  ASSERT1(destination_file_path);
+  ASSERT1(hash);
+
+  scoped_hfile destination_file;
+  HRESULT hr = CreateDestinationFile(destination_file_path, &destination_file);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Reserving the space for the file keeps it in one piece. This is only an
+  // optimization.
+  FILE_ALLOCATION_INFO allocation_info = {0};
+  allocation_info.AllocationSize.QuadPart = static_cast<LONGLONG>(file_size);
+  VERIFY1(::SetFileInformationByHandle(get(destination_file),
+                                       FileAllocationInfo,
+                                       &allocation_info,
+                                       sizeof(allocation_info)));
+
+  // Unbuffered writes need a buffer aligned like their size.
+  std::vector<byte> buffer_storage(kCopyBufferSize + kWriteAlignment);
+  byte* buffer = reinterpret_cast<byte*>(
+      (reinterpret_cast<uintptr_t>(&buffer_storage.front()) +
+       kWriteAlignment - 1) & ~static_cast<uintptr_t>(kWriteAlignment - 1));
+
+  std::unique_ptr<CryptDetails::HashInterface> hasher(
+      CryptDetails::CreateHasher());
+
+  uint64 bytes_left = file_size;
+  while (bytes_left) {
+    const DWORD bytes_to_read = static_cast<DWORD>(
+        std::min(bytes_left, static_cast<uint64>(kCopyBufferSize)));
+    DWORD bytes_read = 0;
+    if (!::ReadFile(source_file, buffer, bytes_to_read, &bytes_read, NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_read != bytes_to_read) {
+      // The source file has been truncated.
+      return HRESULT_FROM_WIN32(ERROR_HANDLE_EOF);
+    }
+
+    hasher->update(buffer, bytes_read);
+
+    // The last block is padded, and the file is truncated to its length once
+    // all the data has been written.
+    const DWORD bytes_to_write =
+        (bytes_read + kWriteAlignment - 1) / kWriteAlignment * kWriteAlignment;
+    memset(buffer + bytes_read, 0, bytes_to_write - bytes_read);
+
+    DWORD bytes_written = 0;
+    if (!::WriteFile(get(destination_file),
+                     buffer,
+                     bytes_to_write,
+                     &bytes_written,
+                     NULL)) {
+      return HRESULTFromLastError();
+    }
+    if (bytes_written != bytes_to_write) {
+      return E_FAIL;
+    }
+
+    bytes_left -= bytes_read;
+  }
+
+  FILE_END_OF_FILE_INFO end_of_file_info = {0};
+  end_of_file_info.EndOfFile.QuadPart = static_cast<LONGLONG>(file_size);
+  if (!::SetFileInformationByHandle(get(destination_file),
+                                    FileEndOfFileInfo,
+                                    &end_of_file_info,
+                                    sizeof(end_of_file_info))) {
+    return HRESULTFromLastError();
+  }
+
+  // Keeps the time of the source file, like ::CopyFile does.
+  if (!::SetFileTime(get(destination_file), NULL, NULL, &last_write_time)) {
+    return HRESULTFromLastError();
+  }
+
+  const uint8_t* digest = hasher->final();
+  hash->assign(digest, digest + hasher->hash_size());
+  return S_OK;
+}
+
+}  // namespace
+
+HRESULT CopyFileAndHash(const TCHAR* source_file_path,
+                        const TCHAR* destination_file_path,
+                        std::vector<byte>* hash) {
+  ASSERT1(source_file_path);
+  ASSERT1(destination_file_path);
+  ASSERT1(hash);
+
+  scoped_hfile source_file(::CreateFile(source_file_path,
+                                        GENERIC_READ,
+                                        FILE_SHARE_READ,
+                                        NULL,
+                                        OPEN_EXISTING,
+                                        FILE_FLAG_SEQUENTIAL_SCAN,
+                                        NULL));
+  if (!valid(source_file)) {
+    return HRESULTFromLastError();
+  }
+
+  BY_HANDLE_FILE_INFORMATION info = {0};
+  if (!::GetFileInformationByHandle(get(source_file), &info)) {
+    return HRESULTFromLastError();
+  }
+  const uint64 file_size =
+      (static_cast<uint64>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+
+  const CString temp_file_path(CString(destination_file_path) +
+                               kTempFileSuffix);
+  HRESULT hr = CopyAndHashData(get(source_file),
+                               file_size,
+                               info.ftLastWriteTime,
+                               temp_file_path,
+                               hash);
+  if (SUCCEEDED(hr) &&
+      !::MoveFileEx(temp_file_path,
+                    destination_file_path,
+                    MOVEFILE_REPLACE_EXISTING)) {
+    hr = HRESULTFromLastError();
+  }
+
+  if (FAILED(hr)) {
+    UTIL_LOG(LE, (_T("[CopyFileAndHash failed][%s][%s][0x%08x]"),
+                  source_file_path, destination_file_path, hr));
+    ::DeleteFile(temp_file_path);
+    return hr;
+  }
+
+  return S_OK;
+}
+
+}  // namespace omaha
@@ -0,0 +1,39 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Copies a file and hashes its data in one sequential read of the source. The
+// destination is written without buffering to a temporary file, which
+// replaces the destination file when it is complete, so the hard links to the
+// previous destination file keep its data.
+
+#ifndef OMAHA_BASE_FILE_COPY_H_
+#define OMAHA_BASE_FILE_COPY_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// Copies |source_file_path| to |destination_file_path| and returns the
+// SHA-256 hash of the data in |hash|.
+HRESULT CopyFileAndHash(const TCHAR* source_file_path,
+                        const TCHAR* destination_file_path,
+                        std::vector<byte>* hash);
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_FILE_COPY_H_
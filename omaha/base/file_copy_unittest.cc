@@ -0,0 +1,86 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/file_copy.h"
+
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class FileCopyTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_dir_ = ConcatenatePath(app_util::GetTempDir(), _T("FileCopyTest"));
+    DeleteDirectory(test_dir_);
+    ASSERT_SUCCEEDED(CreateDir(test_dir_, NULL));
+  }
+
+  virtual void TearDown() {
+    EXPECT_SUCCEEDED(DeleteDirectory(test_dir_));
+  }
+
+  // Creates the file |name| in the test directory and returns its path.
+  CString CreateTestFile(const TCHAR* name, uint32 size, int seed) {
+    const CString file_path(ConcatenatePath(test_dir_, name));
+    CreatePatternFile(file_path, size, seed);
+    return file_path;
+  }
+
+  CString test_dir_;
+};
+
+TEST_F(FileCopyTest, CopyFileAndHash) {
+  // Sizes around the alignment of the unbuffered writes and the size of the
+  // copy buffer.
+  const uint32 kSizes[] = {0, 1, 4095, 4096, 4097, 1024 * 1024 + 3};
+  for (size_t i = 0; i != arraysize(kSizes); ++i) {
+    const CString source(CreateTestFile(_T("source"), kSizes[i], 1));
+    const CString destination(ConcatenatePath(test_dir_, _T("destination")));
+
+    std::vector<byte> hash;
+    EXPECT_SUCCEEDED(CopyFileAndHash(source, destination, &hash));
+    EXPECT_TRUE(File::AreFilesIdentical(source, destination));
+    EXPECT_FALSE(File::Exists(destination + _T(".tmp")));
+
+    std::vector<byte> expected_hash;
+    CryptoHash crypto_hash;
+    EXPECT_SUCCEEDED(crypto_hash.Compute(source, 0, &expected_hash));
+    EXPECT_TRUE(expected_hash == hash);
+
+    FILETIME source_time = {0};
+    FILETIME destination_time = {0};
+    EXPECT_SUCCEEDED(File::GetFileTime(source, NULL, NULL, &source_time));
+    EXPECT_SUCCEEDED(File::GetFileTime(destination, NULL, NULL,
+                                       &destination_time));
+    EXPECT_EQ(0, ::CompareFileTime(&source_time, &destination_time));
+  }
+}
+
+TEST_F(FileCopyTest, CopyFileAndHash_SourceDoesNotExist) {
+  std::vector<byte> hash;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            CopyFileAndHash(ConcatenatePath(test_dir_, _T("none")),
+                            ConcatenatePath(test_dir_, _T("destination")),
+                            &hash));
+}
+
+}  // namespace omaha
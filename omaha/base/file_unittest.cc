@@ -426,4 +426,263 @@ TEST(FileTest, AreFilesIdentical) {
   EXPECT_FALSE(File::AreFilesIdentical(known_file1, known_file2));
 }
 
+TEST(FileTest, AreFilesIdentical_CopiesAndHardLinks) {
+  CString windows_dir;
+  ASSERT_TRUE(::GetEnvironmentVariable(_T("SystemRoot"),
+                                       CStrBuf(windows_dir, MAX_PATH),
+                                       MAX_PATH));
+  const CString known_file(windows_dir + _T("\\NOTEPAD.EXE"));
+
+  const CString copy(GetTempFilename(_T("fil")));
+  ASSERT_SUCCEEDED(File::Copy(known_file, copy, true));
+  EXPECT_TRUE(File::AreFilesIdentical(known_file, copy));
+
+  const CString hard_link(copy + _T(".link"));
+  ASSERT_TRUE(::CreateHardLink(hard_link, copy, NULL));
+  EXPECT_TRUE(File::AreFilesIdentical(copy, hard_link));
+
+  // Files of the same size which differ in their last byte.
+  uint32 size = 0;
+  ASSERT_SUCCEEDED(File::GetFileSizeUnopen(copy, &size));
+  EXPECT_SUCCEEDED(File::Remove(hard_link));
+  {
+    File file;
+    ASSERT_SUCCEEDED(file.Open(copy, true, false));
+    byte last_byte = 0;
+    ASSERT_SUCCEEDED(file.ReadAt64(size - 1, &last_byte, 1, NULL));
+    last_byte = static_cast<byte>(~last_byte);
+    ASSERT_SUCCEEDED(file.WriteAt64(size - 1, &last_byte, 1, NULL));
+    ASSERT_SUCCEEDED(file.Close());
+  }
+  EXPECT_FALSE(File::AreFilesIdentical(known_file, copy));
+
+  EXPECT_FALSE(File::AreFilesIdentical(known_file, copy + _T(".none")));
+
+  std::vector<CString> filenames1;
+  std::vector<CString> filenames2;
+  filenames1.push_back(known_file);
+  filenames2.push_back(known_file);
+  filenames1.push_back(known_file);
+  filenames2.push_back(copy);
+  filenames1.push_back(known_file);
+  filenames2.push_back(copy + _T(".none"));
+  std::vector<bool> are_identical;
+  File::AreFilesIdentical(filenames1, filenames2, 2, &are_identical);
+  ASSERT_EQ(3, are_identical.size());
+  EXPECT_TRUE(are_identical[0]);
+  EXPECT_FALSE(are_identical[1]);
+  EXPECT_FALSE(are_identical[2]);
+
+  EXPECT_SUCCEEDED(File::Remove(copy));
+}
+
+TEST(FileTest, ReadAt64WriteAt64) {
+  const CString file_name(GetTempFilename(_T("fil")));
+  ASSERT_FALSE(file_name.IsEmpty());
+
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_name, true, false));
+
+  const byte kData[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint32 bytes_written = 0;
+  EXPECT_SUCCEEDED(file.WriteAt64(4, kData, sizeof(kData), &bytes_written));
+  EXPECT_EQ(sizeof(kData), bytes_written);
+
+  uint64 length = 0;
+  EXPECT_SUCCEEDED(file.GetLength64(&length));
+  EXPECT_EQ(12, length);
+
+  byte buffer[16] = {0};
+  uint32 bytes_read = 0;
+  EXPECT_SUCCEEDED(file.ReadAt64(6, buffer, 4, &bytes_read));
+  EXPECT_EQ(4, bytes_read);
+  EXPECT_EQ(0, memcmp(kData + 2, buffer, 4));
+
+  // Reading past the end of the file returns the bytes which are left.
+  EXPECT_SUCCEEDED(file.ReadAt64(8, buffer, sizeof(buffer), &bytes_read));
+  EXPECT_EQ(4, bytes_read);
+  EXPECT_EQ(0, memcmp(kData + 4, buffer, 4));
+  EXPECT_SUCCEEDED(file.ReadAt64(100, buffer, sizeof(buffer), &bytes_read));
+  EXPECT_EQ(0, bytes_read);
+
+  EXPECT_SUCCEEDED(file.Close());
+  EXPECT_SUCCEEDED(File::Remove(file_name));
+}
+
+TEST(FileTest, SetLength64_LargerThan4GB) {
+  const CString file_name(GetTempFilename(_T("fil")));
+  ASSERT_FALSE(file_name.IsEmpty());
+
+  // Make the file sparse, so that the test does not use disk space.
+  {
+    scoped_hfile handle(::CreateFile(file_name,
+                                     GENERIC_READ | GENERIC_WRITE,
+                                     0,
+                                     NULL,
+                                     OPEN_EXISTING,
+                                     FILE_ATTRIBUTE_NORMAL,
+                                     NULL));
+    ASSERT_TRUE(valid(handle));
+    DWORD bytes_returned = 0;
+    ASSERT_TRUE(::DeviceIoControl(get(handle), FSCTL_SET_SPARSE, NULL, 0,
+                                  NULL, 0, &bytes_returned, NULL));
+  }
+
+  const uint64 kLength = 5ULL * 1024 * 1024 * 1024;
+
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_name, true, false));
+  EXPECT_SUCCEEDED(file.SetLength64(kLength));
+
+  const byte kData[] = {1, 2, 3, 4};
+  EXPECT_SUCCEEDED(file.WriteAt64(kLength - sizeof(kData),
+                                  kData,
+                                  sizeof(kData),
+                                  NULL));
+  byte buffer[sizeof(kData)] = {0};
+  uint32 bytes_read = 0;
+  EXPECT_SUCCEEDED(file.ReadAt64(kLength - sizeof(kData),
+                                 buffer,
+                                 sizeof(buffer),
+                                 &bytes_read));
+  EXPECT_EQ(sizeof(kData), bytes_read);
+  EXPECT_EQ(0, memcmp(kData, buffer, sizeof(kData)));
+
+  uint64 length = 0;
+  EXPECT_SUCCEEDED(file.GetLength64(&length));
+  EXPECT_EQ(kLength, length);
+  EXPECT_SUCCEEDED(file.Close());
+
+  length = 0;
+  EXPECT_SUCCEEDED(File::GetFileSizeUnopen64(file_name, &length));
+  EXPECT_EQ(kLength, length);
+
+  EXPECT_SUCCEEDED(File::Remove(file_name));
+}
+
+TEST(FileTest, Preallocate) {
+  const CString file_name(GetTempFilename(_T("fil")));
+  ASSERT_FALSE(file_name.IsEmpty());
+
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_name, true, false));
+  EXPECT_SUCCEEDED(file.Preallocate(1024 * 1024));
+
+  // The length of the file does not change.
+  uint64 length = 0;
+  EXPECT_SUCCEEDED(file.GetLength64(&length));
+  EXPECT_EQ(0, length);
+
+  EXPECT_SUCCEEDED(file.Close());
+  EXPECT_SUCCEEDED(File::Remove(file_name));
+}
+
+TEST(FileTest, MappedFileView) {
+  const CString file_name(GetTempFilename(_T("fil")));
+  ASSERT_FALSE(file_name.IsEmpty());
+
+  // The data spans more than one allocation granularity unit, so that views
+  // starting in the middle of the file are tested.
+  const uint32 kLength = 256 * 1024;
+  std::vector<byte> data(kLength);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = static_cast<byte>(i * 7);
+  }
+
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_name, true, false));
+  ASSERT_SUCCEEDED(file.WriteAt64(0, &data.front(), kLength, NULL));
+  ASSERT_SUCCEEDED(file.Close());
+
+  ASSERT_SUCCEEDED(file.OpenWithAccessPattern(file_name,
+                                              false,
+                                              FILE_SHARE_READ,
+                                              File::SEQUENTIAL_ACCESS));
+
+  MappedFileView view;
+  EXPECT_SUCCEEDED(view.Map(&file, 0, 0));
+  EXPECT_EQ(kLength, view.length());
+  EXPECT_EQ(0, memcmp(&data.front(), view.data(), kLength));
+
+  const uint64 kOffset = 100 * 1024 + 3;
+  EXPECT_SUCCEEDED(view.Map(&file, kOffset, 1000));
+  EXPECT_EQ(1000, view.length());
+  EXPECT_EQ(0, memcmp(&data[kOffset], view.data(), 1000));
+
+  EXPECT_SUCCEEDED(view.Map(&file, kLength, 0));
+  EXPECT_EQ(0, view.length());
+  EXPECT_TRUE(view.data() == NULL);
+
+  EXPECT_EQ(E_INVALIDARG, view.Map(&file, kLength + 1, 0));
+  EXPECT_EQ(E_INVALIDARG, view.Map(&file, kLength - 10, 11));
+
+  // The view maps another file after mapping ranges of the first file.
+  const CString other_file_name(GetTempFilename(_T("fil")));
+  ASSERT_FALSE(other_file_name.IsEmpty());
+  const std::vector<byte> other_data(1000, 'x');
+  ASSERT_SUCCEEDED(WriteEntireFile(other_file_name, other_data));
+  File other_file;
+  ASSERT_SUCCEEDED(other_file.OpenWithAccessPattern(other_file_name,
+                                                    false,
+                                                    FILE_SHARE_READ,
+                                                    File::RANDOM_ACCESS));
+  EXPECT_SUCCEEDED(view.Map(&other_file, 0, 0));
+  EXPECT_EQ(other_data.size(), view.length());
+  EXPECT_EQ(0, memcmp(&other_data.front(), view.data(), other_data.size()));
+
+  view.Unmap();
+  EXPECT_SUCCEEDED(other_file.Close());
+  EXPECT_SUCCEEDED(File::Remove(other_file_name));
+  EXPECT_SUCCEEDED(file.Close());
+  EXPECT_SUCCEEDED(File::Remove(file_name));
+}
+
+// Checks that a file reads the same in 64 KB chunks and from a mapped view.
+TEST(FileTest, MappedFileView_ReadsSameData) {
+  const CString file_name(GetTempFilename(_T("fil")));
+  ASSERT_FALSE(file_name.IsEmpty());
+
+  const uint32 kLength = 1024 * 1024;
+  const uint32 kChunkSize = 64 * 1024;
+  std::vector<byte> buffer(kChunkSize, 0x5a);
+
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_name, true, false));
+  ASSERT_SUCCEEDED(file.Preallocate(kLength));
+  for (uint32 offset = 0; offset != kLength; offset += kChunkSize) {
+    ASSERT_SUCCEEDED(file.WriteAt64(offset, &buffer.front(), kChunkSize,
+                                    NULL));
+  }
+  ASSERT_SUCCEEDED(file.Close());
+
+  ASSERT_SUCCEEDED(file.OpenWithAccessPattern(file_name,
+                                              false,
+                                              FILE_SHARE_READ,
+                                              File::SEQUENTIAL_ACCESS));
+
+  uint32 read_sum = 0;
+  for (uint32 offset = 0; offset != kLength; offset += kChunkSize) {
+    uint32 bytes_read = 0;
+    ASSERT_SUCCEEDED(file.ReadAt64(offset, &buffer.front(), kChunkSize,
+                                   &bytes_read));
+    for (uint32 i = 0; i != bytes_read; ++i) {
+      read_sum += buffer[i];
+    }
+  }
+
+  uint32 view_sum = 0;
+  MappedFileView view;
+  ASSERT_SUCCEEDED(view.Map(&file, 0, 0));
+  EXPECT_EQ(kLength, view.length());
+  for (size_t i = 0; i != view.length(); ++i) {
+    view_sum += view.data()[i];
+  }
+  view.Unmap();
+
+  EXPECT_EQ(read_sum, view_sum);
+
+  EXPECT_SUCCEEDED(file.Close());
+  EXPECT_SUCCEEDED(File::Remove(file_name));
+}
+
 }  // namespace omaha
@@ -0,0 +1,335 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/name_value_file.h"
+
+#include <string.h>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+
+namespace omaha {
+
+namespace {
+
+const uint8 kUtf16LeBom[] = {0xFF, 0xFE};
+const uint8 kUtf8Bom[] = {0xEF, 0xBB, 0xBF};
+
+bool IsSpace(TCHAR c) {
+  return !!_istspace(c);
+}
+
+void TrimLeft(const TCHAR** begin, const TCHAR* end) {
+  while (*begin != end && IsSpace(**begin)) {
+    ++*begin;
+  }
+}
+
+void TrimRight(const TCHAR* begin, const TCHAR** end) {
+  while (*end != begin && IsSpace((*end)[-1])) {
+    --*end;
+  }
+}
+
+TextView MakeView(const TCHAR* begin, const TCHAR* end) {
+  return TextView(begin, static_cast<int>(end - begin));
+}
+
+}  // namespace
+
+bool TextView::EqualsNoCase(const TextView& other) const {
+  return length_ == other.length_ &&
+         (!length_ || !_tcsnicmp(data_, other.data_, length_));
+}
+
+bool TextView::EqualsNoCase(const TCHAR* other) const {
+  ASSERT1(other);
+  return EqualsNoCase(TextView(other, static_cast<int>(_tcslen(other))));
+}
+
+bool IsUnicodeNameValueFile(const uint8* data, size_t size) {
+  if (size >= sizeof(kUtf16LeBom) &&
+      !memcmp(data, kUtf16LeBom, sizeof(kUtf16LeBom))) {
+    return true;
+  }
+
+  // The files written by goopdate_utils::WriteNameValuePairsToHandle have no
+  // byte order mark. They start with a section, so the second byte is zero.
+  return size >= sizeof(WCHAR) && !(size % sizeof(WCHAR)) &&
+         data[0] && !data[1];
+}
+
+CString DecodeNameValueFile(const uint8* data, size_t size) {
+  ASSERT1(data || !size);
+
+  if (IsUnicodeNameValueFile(data, size)) {
+    if (!memcmp(data, kUtf16LeBom, sizeof(kUtf16LeBom))) {
+      data += sizeof(kUtf16LeBom);
+      size -= sizeof(kUtf16LeBom);
+    }
+    return CString(reinterpret_cast<const WCHAR*>(data),
+                   static_cast<int>(size / sizeof(WCHAR)));
+  }
+
+  if (size >= sizeof(kUtf8Bom) && !memcmp(data, kUtf8Bom, sizeof(kUtf8Bom))) {
+    return Utf8ToWideChar(reinterpret_cast<const char*>(data) +
+                              sizeof(kUtf8Bom),
+                          static_cast<uint32>(size - sizeof(kUtf8Bom)));
+  }
+
+  CString text;
+  if (size) {
+    VERIFY1(AnsiToWideString(reinterpret_cast<const char*>(data),
+                             static_cast<int>(size),
+                             CP_ACP,
+                             &text));
+  }
+  return text;
+}
+
+void EncodeNameValueFile(const CString& text,
+                         bool is_unicode,
+                         std::vector<uint8>* data) {
+  ASSERT1(data);
+  data->clear();
+
+  if (!is_unicode && !text.IsEmpty()) {
+    BOOL is_default_char_used = FALSE;
+    const int size = ::WideCharToMultiByte(CP_ACP,
+                                           0,
+                                           text,
+                                           text.GetLength(),
+                                           NULL,
+                                           0,
+                                           NULL,
+                                           &is_default_char_used);
+    if (size > 0 && !is_default_char_used) {
+      data->resize(size);
+      VERIFY1(::WideCharToMultiByte(CP_ACP,
+                                    0,
+                                    text,
+                                    text.GetLength(),
+                                    reinterpret_cast<char*>(&data->front()),
+                                    size,
+                                    NULL,
+                                    NULL) == size);
+      return;
+    }
+    is_unicode = true;
+  }
+
+  if (is_unicode) {
+    const uint8* bytes = reinterpret_cast<const uint8*>(text.GetString());
+    data->assign(kUtf16LeBom, kUtf16LeBom + sizeof(kUtf16LeBom));
+    data->insert(data->end(),
+                 bytes,
+                 bytes + text.GetLength() * sizeof(WCHAR));
+  }
+}
+
+NameValueParser::NameValueParser(const TCHAR* text, int length)
+    : text_(text),
+      length_(length),
+      pos_(0) {
+  ASSERT1(text || !length);
+  ASSERT1(length >= 0);
+}
+
+bool NameValueParser::Next(Line* line) {
+  ASSERT1(line);
+
+  if (pos_ >= length_) {
+    return false;
+  }
+
+  const TCHAR* const text_end = text_ + length_;
+  const TCHAR* begin = text_ + pos_;
+  const TCHAR* end = begin;
+  while (end != text_end && *end != _T('\n')) {
+    ++end;
+  }
+  pos_ = static_cast<int>(end - text_) + 1;
+  if (end != begin && end[-1] == _T('\r')) {
+    --end;
+  }
+
+  line->type = LINE_OTHER;
+  line->text = MakeView(begin, end);
+  line->name = TextView();
+  line->value = TextView();
+
+  TrimLeft(&begin, end);
+  TrimRight(begin, &end);
+  if (begin == end || *begin == _T(';')) {
+    return true;
+  }
+
+  // The name of a section ends at the last ']' of the line. A line without
+  // ']' is parsed as a pair.
+  if (*begin == _T('[')) {
+    for (const TCHAR* p = end - 1; p != begin; --p) {
+      if (*p == _T(']')) {
+        line->type = LINE_SECTION;
+        line->name = MakeView(begin + 1, p);
+        return true;
+      }
+    }
+  }
+
+  const TCHAR* separator = begin;
+  while (separator != end && *separator != _T('=')) {
+    ++separator;
+  }
+  const TCHAR* name_end = separator;
+  TrimRight(begin, &name_end);
+  if (separator == end || name_end == begin) {
+    return true;
+  }
+
+  const TCHAR* value_begin = separator + 1;
+  TrimLeft(&value_begin, end);
+  const TCHAR* value_end = end;
+  if (value_end - value_begin >= 2 &&
+      (*value_begin == _T('"') || *value_begin == _T('\'')) &&
+      value_end[-1] == *value_begin) {
+    ++value_begin;
+    --value_end;
+  }
+
+  line->type = LINE_PAIR;
+  line->name = MakeView(begin, name_end);
+  line->value = MakeView(value_begin, value_end);
+  return true;
+}
+
+bool NameValueParser::ReadSection(const TCHAR* section_name,
+                                  std::vector<Line>* pairs) {
+  ASSERT1(section_name);
+  ASSERT1(pairs);
+  pairs->clear();
+
+  bool is_found = false;
+  Line line = {};
+  while (Next(&line)) {
+    if (line.type == LINE_SECTION) {
+      if (is_found) {
+        break;
+      }
+      is_found = line.name.EqualsNoCase(section_name);
+    } else if (line.type == LINE_PAIR && is_found) {
+      pairs->push_back(line);
+    }
+  }
+
+  return is_found;
+}
+
+void AppendNameValueSection(const TCHAR* section_name,
+                            const std::map<CString, CString>& pairs,
+                            CString* text) {
+  ASSERT1(section_name);
+  ASSERT1(text);
+
+  SafeCStringAppendFormat(text, _T("[%s]\r\n"), section_name);
+  for (std::map<CString, CString>::const_iterator it = pairs.begin();
+       it != pairs.end();
+       ++it) {
+    SafeCStringAppendFormat(text,
+                            _T("%s=%s\r\n"),
+                            it->first.GetString(),
+                            it->second.GetString());
+  }
+}
+
+CString SetNameValuePairs(const CString& text,
+                          const TCHAR* section_name,
+                          const std::map<CString, CString>& pairs) {
+  ASSERT1(section_name);
+
+  // Only the lines of the section are split. The lines before and after the
+  // section are kept as they are.
+  int section_offset = -1;
+  int rest_offset = text.GetLength();
+
+  // The lines of the section, and the names of its pairs. The new pairs are
+  // added after the last line of the section which is not empty.
+  std::vector<CString> lines;
+  std::vector<CString> names;
+  size_t section_end = 0;
+
+  NameValueParser parser(text, text.GetLength());
+  NameValueParser::Line line = {};
+  for (int offset = 0; parser.Next(&line); offset = parser.position()) {
+    if (line.type == NameValueParser::LINE_SECTION) {
+      if (section_offset != -1) {
+        rest_offset = offset;
+        break;
+      }
+      if (line.name.EqualsNoCase(section_name)) {
+        section_offset = offset;
+      }
+    }
+    if (section_offset == -1) {
+      continue;
+    }
+
+    lines.push_back(line.text.ToString());
+    names.push_back(line.type == NameValueParser::LINE_PAIR ?
+                    line.name.ToString() : CString());
+    if (line.type != NameValueParser::LINE_OTHER ||
+        !line.text.ToString().Trim().IsEmpty()) {
+      section_end = lines.size();
+    }
+  }
+
+  CString result;
+  if (section_offset == -1) {
+    result = text;
+    if (!result.IsEmpty() && result[result.GetLength() - 1] != _T('\n')) {
+      result += _T("\r\n");
+    }
+    AppendNameValueSection(section_name, pairs, &result);
+    return result;
+  }
+
+  for (std::map<CString, CString>::const_iterator it = pairs.begin();
+       it != pairs.end();
+       ++it) {
+    size_t index = 1;
+    while (index != section_end && names[index].CompareNoCase(it->first)) {
+      ++index;
+    }
+    if (index == section_end) {
+      lines.insert(lines.begin() + index, CString());
+      names.insert(names.begin() + index, it->first);
+      ++section_end;
+    }
+    SafeCStringFormat(&lines[index],
+                      _T("%s=%s"),
+                      names[index].GetString(),
+                      it->second.GetString());
+  }
+
+  result = text.Left(section_offset);
+  for (size_t i = 0; i != lines.size(); ++i) {
+    result += lines[i];
+    result += _T("\r\n");
+  }
+  result += text.Mid(rest_offset);
+  return result;
+}
+
+}  // namespace omaha
@@ -0,0 +1,140 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Reads and writes the name/value files of the profile API, such as the
+// custom info files of the crashes, in one pass over the text of the file.
+// GetPrivateProfileString opens and scans the file again for each name,
+// which is quadratic in the number of names.
+//
+// The parser follows the rules of GetPrivateProfileString:
+//   * the lines are trimmed, and the lines which start with ';' are comments.
+//   * "[name]" starts a section. Only the first section with a name is read,
+//     and the names of the sections are not case sensitive.
+//   * "name=value" is a pair. The name and the value are trimmed, and the
+//     quotes around the value are removed if they match. The lines without
+//     '=' or without a name are ignored.
+//   * the names are not case sensitive, and the first of the duplicate names
+//     has the value of all of them.
+
+#ifndef OMAHA_BASE_NAME_VALUE_FILE_H_
+#define OMAHA_BASE_NAME_VALUE_FILE_H_
+
+#include <windows.h>
+#include <tchar.h>
+#include <atlstr.h>
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+// A part of a text, which the text owns. The view is valid as long as the
+// text is not changed or destroyed.
+class TextView {
+ public:
+  TextView() : data_(NULL), length_(0) {}
+  TextView(const TCHAR* data, int length) : data_(data), length_(length) {}
+
+  const TCHAR* data() const { return data_; }
+  int length() const { return length_; }
+  bool empty() const { return !length_; }
+
+  CString ToString() const { return CString(data_, length_); }
+
+  bool EqualsNoCase(const TextView& other) const;
+  bool EqualsNoCase(const TCHAR* other) const;
+
+ private:
+  const TCHAR* data_;
+  int length_;
+};
+
+// Decodes the content of a name/value file to text, the same way as the
+// profile API: UTF-16LE if the file starts with the UTF-16LE byte order mark
+// or looks like UTF-16LE text, UTF-8 if it starts with the UTF-8 byte order
+// mark, and the ANSI code page otherwise.
+CString DecodeNameValueFile(const uint8* data, size_t size);
+
+// Encodes the text of a name/value file. The text is encoded with the ANSI
+// code page, like the profile API writes new files, unless |is_unicode| is
+// true or the text has characters which the code page does not have. Then,
+// the text is encoded as UTF-16LE, with the byte order mark.
+void EncodeNameValueFile(const CString& text,
+                         bool is_unicode,
+                         std::vector<uint8>* data);
+
+// Returns true if |data| is the content of a UTF-16LE name/value file.
+bool IsUnicodeNameValueFile(const uint8* data, size_t size);
+
+// Parses the lines of the text of a name/value file, in one pass. The
+// parser does not copy the text, which must outlive the parser.
+class NameValueParser {
+ public:
+  enum LineType {
+    LINE_SECTION,
+    LINE_PAIR,
+    LINE_OTHER,
+  };
+
+  struct Line {
+    LineType type;
+
+    // The name of the section or of the pair, and the value of the pair.
+    TextView name;
+    TextView value;
+
+    // The whole line, without the line break.
+    TextView text;
+  };
+
+  NameValueParser(const TCHAR* text, int length);
+
+  // Returns the next line of the text, or false at the end of the text.
+  bool Next(Line* line);
+
+  // Returns the pairs of the first section named |section_name| in the rest
+  // of the text, in the order of the text, with the duplicate names. Returns
+  // false if there is no such section.
+  bool ReadSection(const TCHAR* section_name, std::vector<Line>* pairs);
+
+  // The offset in the text of the next line.
+  int position() const { return pos_; }
+
+ private:
+  const TCHAR* const text_;
+  const int length_;
+  int pos_;
+
+  DISALLOW_COPY_AND_ASSIGN(NameValueParser);
+};
+
+// Appends a section named |section_name| with |pairs| to |text|.
+void AppendNameValueSection(const TCHAR* section_name,
+                            const std::map<CString, CString>& pairs,
+                            CString* text);
+
+// Sets |pairs| in the first section named |section_name| of |text|, with the
+// same result as a call to WritePrivateProfileString for each pair: the
+// first pair with the name of a pair is changed, the new pairs are added at
+// the end of the section, and the section is added at the end of the text if
+// it does not exist. The other lines are kept.
+CString SetNameValuePairs(const CString& text,
+                          const TCHAR* section_name,
+                          const std::map<CString, CString>& pairs);
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_NAME_VALUE_FILE_H_
@@ -0,0 +1,319 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/name_value_file.h"
+
+#include <string.h>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+typedef std::vector<std::pair<CString, CString> > PairList;
+
+// The files which are read with the parser and with the profile API. The
+// pairs are read from the section "s".
+const char* const kFiles[] = {
+  "",
+  "[s]\r\n",
+  "[s]\r\nname=value\r\n",
+  "name=value\r\n",
+  "[t]\r\nname=value\r\n",
+  "[S]\r\nname=value\r\n",
+  "  [s]  \r\n  name  =  value  \r\n\tother\t=\tvalue\t\r\n",
+  "[s]\r\na=\"quoted\"\r\nb='single'\r\nc=\"unbalanced\r\nd=\"\r\n"
+      "e=\"\"\r\nf=\"a\" \"b\"\r\ng='mixed\"\r\nh= \" spaces \" \r\n",
+  "[s]\r\n;a=comment\r\n  ; b=comment\r\nnovalue\r\nc=1\r\n",
+  "[s]\r\nname=first\r\nNAME=second\r\nname=third\r\nName=\r\n",
+  "[s]\r\na=1\r\n[t]\r\nb=2\r\n[S]\r\nc=3\r\na=4\r\n",
+  "[t]\r\na=1\r\n[s]\r\nb=2\r\n\r\n\r\nc=3\r\n[u]\r\nd=4\r\n",
+  "[s]\na=1\nb=2",
+  "[s]\r\npath=C:\\a=b\r\nurl=http://x/?a=b&c=d\r\nempty=\r\n",
+};
+
+// Returns the pairs of a section in the order of the file, the way
+// goopdate_utils::ReadNameValuePairsFromFile used to read them: the names
+// are enumerated, then each value is read with a call to
+// GetPrivateProfileString.
+PairList ReadSectionWithProfileApi(const CString& filename,
+                                   const TCHAR* section_name) {
+  PairList pairs;
+  TCHAR names[32768] = {};
+  const DWORD names_length = ::GetPrivateProfileString(section_name,
+                                                       NULL,
+                                                       NULL,
+                                                       names,
+                                                       arraysize(names),
+                                                       filename);
+  for (DWORD offset = 0; offset < names_length;) {
+    const CString name(names + offset);
+    TCHAR value[1024] = {};
+    ::GetPrivateProfileString(section_name,
+                              name,
+                              NULL,
+                              value,
+                              arraysize(value),
+                              filename);
+    pairs.push_back(std::make_pair(name, CString(value)));
+    offset += name.GetLength() + 1;
+  }
+  return pairs;
+}
+
+// Returns the pairs of a section in the order of the file, with the value of
+// the first of the duplicate names.
+PairList ReadSectionWithParser(const CString& text,
+                               const TCHAR* section_name) {
+  NameValueParser parser(text, text.GetLength());
+  std::vector<NameValueParser::Line> lines;
+  parser.ReadSection(section_name, &lines);
+
+  PairList pairs;
+  for (size_t i = 0; i != lines.size(); ++i) {
+    size_t first = 0;
+    while (!lines[first].name.EqualsNoCase(lines[i].name)) {
+      ++first;
+    }
+    pairs.push_back(std::make_pair(lines[i].name.ToString(),
+                                   lines[first].value.ToString()));
+  }
+  return pairs;
+}
+
+// Returns all the sections of a file, read with the profile API.
+std::vector<std::pair<CString, PairList> > ReadFileWithProfileApi(
+    const CString& filename) {
+  std::vector<std::pair<CString, PairList> > sections;
+  TCHAR section_names[32768] = {};
+  const DWORD section_names_length =
+      ::GetPrivateProfileSectionNames(section_names,
+                                      arraysize(section_names),
+                                      filename);
+  for (DWORD offset = 0; offset < section_names_length;) {
+    const CString section_name(section_names + offset);
+    sections.push_back(std::make_pair(
+        section_name,
+        ReadSectionWithProfileApi(filename, section_name)));
+    offset += section_name.GetLength() + 1;
+  }
+  return sections;
+}
+
+void ExpectEqualPairs(const PairList& expected, const PairList& actual) {
+  ASSERT_EQ(expected.size(), actual.size());
+  for (size_t i = 0; i != expected.size(); ++i) {
+    EXPECT_STREQ(expected[i].first, actual[i].first);
+    EXPECT_STREQ(expected[i].second, actual[i].second);
+  }
+}
+
+// The profile API reads a file which does not exist as an empty file.
+void WriteAnsiFile(const CString& filename, const char* content) {
+  ::DeleteFile(filename);
+  if (!*content) {
+    return;
+  }
+  EXPECT_SUCCEEDED(WriteEntireFile(
+      filename,
+      std::vector<byte>(content, content + strlen(content))));
+}
+
+}  // namespace
+
+class NameValueFileTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    filename_ = GetTempFilename(_T("nvf"));
+    ASSERT_FALSE(filename_.IsEmpty());
+    other_filename_ = GetTempFilename(_T("nvf"));
+    ASSERT_FALSE(other_filename_.IsEmpty());
+  }
+
+  virtual void TearDown() {
+    ::DeleteFile(filename_);
+    ::DeleteFile(other_filename_);
+  }
+
+  CString filename_;
+  CString other_filename_;
+};
+
+TEST_F(NameValueFileTest, ReadSection_SameAsProfileApi) {
+  for (size_t i = 0; i != arraysize(kFiles); ++i) {
+    WriteAnsiFile(filename_, kFiles[i]);
+    const CString text(AnsiToWideString(kFiles[i],
+                                        static_cast<int>(strlen(kFiles[i]))));
+    ExpectEqualPairs(ReadSectionWithProfileApi(filename_, _T("s")),
+                     ReadSectionWithParser(text, _T("s")));
+  }
+}
+
+TEST_F(NameValueFileTest, SetNameValuePairs_SameAsProfileApi) {
+  std::map<CString, CString> pairs;
+  pairs[_T("a")] = _T("new a");
+  pairs[_T("NAME")] = _T("new name");
+  pairs[_T("new")] = _T("new value");
+  pairs[_T("empty")] = _T("");
+
+  for (size_t i = 0; i != arraysize(kFiles); ++i) {
+    WriteAnsiFile(filename_, kFiles[i]);
+    WriteAnsiFile(other_filename_, kFiles[i]);
+
+    for (std::map<CString, CString>::const_iterator it = pairs.begin();
+         it != pairs.end();
+         ++it) {
+      EXPECT_TRUE(::WritePrivateProfileString(_T("s"),
+                                              it->first,
+                                              it->second,
+                                              filename_));
+    }
+
+    const CString text(AnsiToWideString(kFiles[i],
+                                        static_cast<int>(strlen(kFiles[i]))));
+    std::vector<byte> data;
+    EncodeNameValueFile(SetNameValuePairs(text, _T("s"), pairs),
+                        false,
+                        &data);
+    EXPECT_SUCCEEDED(WriteEntireFile(other_filename_, data));
+
+    const std::vector<std::pair<CString, PairList> > expected_sections(
+        ReadFileWithProfileApi(filename_));
+    const std::vector<std::pair<CString, PairList> > actual_sections(
+        ReadFileWithProfileApi(other_filename_));
+    ASSERT_EQ(expected_sections.size(), actual_sections.size());
+    for (size_t j = 0; j != expected_sections.size(); ++j) {
+      EXPECT_STREQ(expected_sections[j].first, actual_sections[j].first);
+      ExpectEqualPairs(expected_sections[j].second,
+                       actual_sections[j].second);
+    }
+  }
+}
+
+TEST(NameValueParserTest, Next) {
+  const CString text(_T("; comment\r\n")
+                     _T("[section]\r\n")
+                     _T(" name = 'value' \n")
+                     _T("other\r\n")
+                     _T("[no end=value"));
+  NameValueParser parser(text, text.GetLength());
+  NameValueParser::Line line = {};
+
+  EXPECT_TRUE(parser.Next(&line));
+  EXPECT_EQ(NameValueParser::LINE_OTHER, line.type);
+  EXPECT_STREQ(_T("; comment"), line.text.ToString());
+
+  EXPECT_TRUE(parser.Next(&line));
+  EXPECT_EQ(NameValueParser::LINE_SECTION, line.type);
+  EXPECT_STREQ(_T("section"), line.name.ToString());
+
+  // The views point into the text.
+  EXPECT_TRUE(parser.Next(&line));
+  EXPECT_EQ(NameValueParser::LINE_PAIR, line.type);
+  EXPECT_EQ(text.GetString() + text.Find(_T("name")), line.name.data());
+  EXPECT_EQ(4, line.name.length());
+  EXPECT_EQ(text.GetString() + text.Find(_T("value")), line.value.data());
+  EXPECT_EQ(5, line.value.length());
+  EXPECT_STREQ(_T(" name = 'value' "), line.text.ToString());
+
+  EXPECT_TRUE(parser.Next(&line));
+  EXPECT_EQ(NameValueParser::LINE_OTHER, line.type);
+  EXPECT_STREQ(_T("other"), line.text.ToString());
+
+  EXPECT_TRUE(parser.Next(&line));
+  EXPECT_EQ(NameValueParser::LINE_PAIR, line.type);
+  EXPECT_STREQ(_T("[no end"), line.name.ToString());
+  EXPECT_STREQ(_T("value"), line.value.ToString());
+
+  EXPECT_FALSE(parser.Next(&line));
+}
+
+TEST(NameValueParserTest, SetNameValuePairs) {
+  std::map<CString, CString> pairs;
+  pairs[_T("B")] = _T("new b");
+  pairs[_T("c")] = _T("3");
+
+  EXPECT_STREQ(_T("[s]\r\nB=new b\r\nc=3\r\n"),
+               SetNameValuePairs(_T(""), _T("s"), pairs));
+  EXPECT_STREQ(_T("[t]\nx=1\r\n[s]\r\nB=new b\r\nc=3\r\n"),
+               SetNameValuePairs(_T("[t]\nx=1"), _T("s"), pairs));
+
+  // The lines which are not changed are kept as they are.
+  EXPECT_STREQ(_T("; comment\r\n")
+               _T("[S]\r\n")
+               _T(" a = 1 \r\n")
+               _T("b=new b\r\n")
+               _T("c=3\r\n")
+               _T("\r\n")
+               _T("[t]\n")
+               _T("b=2\n"),
+               SetNameValuePairs(_T("; comment\r\n")
+                                 _T("[S]\r\n")
+                                 _T(" a = 1 \r\n")
+                                 _T("b = 2\r\n")
+                                 _T("\r\n")
+                                 _T("[t]\n")
+                                 _T("b=2\n"),
+                                 _T("s"),
+                                 pairs));
+}
+
+TEST(NameValueParserTest, DecodeAndEncode) {
+  const CString text(_T("[s]\r\nname=\x00e9t\x00e9 \x0d05\r\n"));
+  const uint8* bytes = reinterpret_cast<const uint8*>(text.GetString());
+  const size_t size = text.GetLength() * sizeof(TCHAR);
+
+  // UTF-16LE, without the byte order mark.
+  EXPECT_TRUE(IsUnicodeNameValueFile(bytes, size));
+  EXPECT_STREQ(text, DecodeNameValueFile(bytes, size));
+
+  // The text has a character which is not in any ANSI code page, so it is
+  // encoded as UTF-16LE, with the byte order mark.
+  std::vector<uint8> data;
+  EncodeNameValueFile(text, false, &data);
+  ASSERT_EQ(size + 2, data.size());
+  EXPECT_EQ(0xFF, data[0]);
+  EXPECT_EQ(0xFE, data[1]);
+  EXPECT_TRUE(IsUnicodeNameValueFile(&data.front(), data.size()));
+  EXPECT_STREQ(text, DecodeNameValueFile(&data.front(), data.size()));
+
+  EncodeNameValueFile(_T("[s]\r\nname=value\r\n"), false, &data);
+  EXPECT_STREQ("[s]\r\nname=value\r\n",
+               CStringA(reinterpret_cast<const char*>(&data.front()),
+                        static_cast<int>(data.size())));
+  EXPECT_FALSE(IsUnicodeNameValueFile(&data.front(), data.size()));
+  EXPECT_STREQ(_T("[s]\r\nname=value\r\n"),
+               DecodeNameValueFile(&data.front(), data.size()));
+
+  EncodeNameValueFile(_T("[s]\r\nname=value\r\n"), true, &data);
+  EXPECT_EQ(0xFF, data[0]);
+  EXPECT_STREQ(_T("[s]\r\nname=value\r\n"),
+               DecodeNameValueFile(&data.front(), data.size()));
+
+  const char kUtf8[] = "\xEF\xBB\xBF[s]\r\nname=\xC3\xA9t\xC3\xA9\r\n";
+  EXPECT_STREQ(_T("[s]\r\nname=\x00e9t\x00e9\r\n"),
+               DecodeNameValueFile(reinterpret_cast<const uint8*>(kUtf8),
+                                   arraysize(kUtf8) - 1));
+
+  EXPECT_STREQ(_T(""), DecodeNameValueFile(NULL, 0));
+}
+
+}  // namespace omaha
@@ -19,6 +19,7 @@
 #include <intsafe.h>
 
 #include "omaha/base/logging.h"
+#include "omaha/base/reg_key_cache.h"
 #include "omaha/base/static_assert.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
@@ -39,6 +40,31 @@ REGSAM ApplyWoWOverride(REGSAM sam_desired, RegKey::WoWOverride wow_override) {
   return sam_desired | static_cast<REGSAM>(wow_override);
 }
 
+// Opens |full_key_name| through the RegKeyCache and calls |operation| with the
+// key. The key may have been deleted since it was cached, in which case it is
+// opened again and |operation| is retried once.
+template <typename Operation>
+HRESULT DoWithCachedKey(const TCHAR* full_key_name,
+                        bool create,
+                        Operation operation) {
+  RegKeyCache& cache = RegKeyCache::Instance();
+  HRESULT hr = S_OK;
+  for (int i = 0; i != 2; ++i) {
+    std::shared_ptr<RegKey> key;
+    hr = cache.OpenKey(full_key_name, create, &key);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = operation(key.get());
+    if (hr != HRESULT_FROM_WIN32(ERROR_KEY_DELETED)) {
+      break;
+    }
+    cache.Invalidate(full_key_name, create);
+  }
+  return hr;
+}
+
 }  // namespace
 
 HRESULT RegKey::Close() {
@@ -286,92 +312,84 @@ HRESULT RegKey::SetValueStaticHelper(const TCHAR * full_key_name,
   // value_name may be NULL
   ASSERT1(full_key_name);
 
-  HRESULT hr = HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
-  // get the root HKEY
-  CString key_name(full_key_name);
-  RootKeyInfo info = GetRootKeyInfo(&key_name);
-
-  if (info.key != NULL) {
-    RegKey key;
-    hr = key.Create(info.key, key_name.GetString(), NULL,
-                    REG_OPTION_NON_VOLATILE,
-                    ApplyWoWOverride(KEY_ALL_ACCESS, info.wow_override));
-    if (hr == S_OK) {
-      switch (type) {
-        case REG_DWORD:
-          hr = key.SetValue(value_name, *reinterpret_cast<DWORD *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Wrote int32 value: %s:%s = %d]"),
-                          full_key_name,
-                          value_name,
-                          *reinterpret_cast<DWORD*>(value)));
-          }
-          break;
-        case REG_QWORD:
-          hr = key.SetValue(value_name, *reinterpret_cast<DWORD64 *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Wrote int64 value: %s:%s = %s]"),
-                          full_key_name,
-                          value_name,
-                          String_Int64ToString(
-                              *reinterpret_cast<DWORD64*>(value), 10)));
-          }
-          break;
-        case REG_SZ:
-          hr = key.SetValue(value_name, reinterpret_cast<const TCHAR *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Wrote string value: %s:%s = %s]"),
-                          full_key_name,
-                          value_name,
-                          reinterpret_cast<const TCHAR *>(value)));
-          }
-          break;
-        case REG_BINARY:
-          hr = key.SetValue(value_name,
-                            reinterpret_cast<const byte *>(value),
-                            byte_count);
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Wrote binary value: %s:%s, len = %d]"),
-                          full_key_name, value_name, byte_count));
-          }
-          break;
-        case REG_MULTI_SZ:
-          hr = key.SetValue(value_name,
-                            reinterpret_cast<const byte *>(value),
-                            byte_count,
-                            type);
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Wrote multi-sz value: %s:%s, len = %d]"),
-                          full_key_name, value_name, byte_count));
-          }
-          break;
-        case REG_EXPAND_SZ:
-          hr = key.SetStringValue(value_name,
-                                  reinterpret_cast<const TCHAR *>(value),
-                                  type);
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Wrote expandable string value: %s:%s = %s]"),
-                          full_key_name, value_name, (const TCHAR *)value));
-          }
-          break;
-        default:
-          ASSERT(false, (_T("Unsupported Registry Type")));
-          hr = HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
-          break;
-      }
-      // close the key after writing
-      HRESULT temp_res = key.Close();
-      if (hr == S_OK) {
-        hr = temp_res;
-      } else {
-        ASSERT(false, (_T("Failed to write reg value: %s:%s (hr=0x%x)"),
-                       full_key_name, value_name, hr));
-      }
-    } else {
-      UTIL_LOG(L3, (_T("[Failed to create reg key: %s]"), full_key_name));
+  const HRESULT result = DoWithCachedKey(
+      full_key_name, true, [&](RegKey* key) {
+    HRESULT hr = S_OK;
+    switch (type) {
+      case REG_DWORD:
+        hr = key->SetValue(value_name, *reinterpret_cast<DWORD *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Wrote int32 value: %s:%s = %d]"),
+                        full_key_name,
+                        value_name,
+                        *reinterpret_cast<DWORD*>(value)));
+        }
+        break;
+      case REG_QWORD:
+        hr = key->SetValue(value_name, *reinterpret_cast<DWORD64 *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Wrote int64 value: %s:%s = %s]"),
+                        full_key_name,
+                        value_name,
+                        String_Int64ToString(
+                            *reinterpret_cast<DWORD64*>(value), 10)));
+        }
+        break;
+      case REG_SZ:
+        hr = key->SetValue(value_name, reinterpret_cast<const TCHAR *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Wrote string value: %s:%s = %s]"),
+                        full_key_name,
+                        value_name,
+                        reinterpret_cast<const TCHAR *>(value)));
+        }
+        break;
+      case REG_BINARY:
+        hr = key->SetValue(value_name,
+                           reinterpret_cast<const byte *>(value),
+                           byte_count);
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Wrote binary value: %s:%s, len = %d]"),
+                        full_key_name, value_name, byte_count));
+        }
+        break;
+      case REG_MULTI_SZ:
+        hr = key->SetValue(value_name,
+                           reinterpret_cast<const byte *>(value),
+                           byte_count,
+                           type);
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Wrote multi-sz value: %s:%s, len = %d]"),
+                        full_key_name, value_name, byte_count));
+        }
+        break;
+      case REG_EXPAND_SZ:
+        hr = key->SetStringValue(value_name,
+                                 reinterpret_cast<const TCHAR *>(value),
+                                 type);
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Wrote expandable string value: %s:%s = %s]"),
+                        full_key_name, value_name, (const TCHAR *)value));
+        }
+        break;
+      default:
+        ASSERT(false, (_T("Unsupported Registry Type")));
+        hr = HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+        break;
     }
+    // A deleted key is opened again and the value is written again.
+    if (FAILED(hr) && hr != HRESULT_FROM_WIN32(ERROR_KEY_DELETED)) {
+      ASSERT(false, (_T("Failed to write reg value: %s:%s (hr=0x%x)"),
+                     full_key_name, value_name, hr));
+    }
+    return hr;
+  });
+
+  if (FAILED(result)) {
+    UTIL_LOG(L3, (_T("[Failed to write reg value: %s:%s][0x%x]"),
+                  full_key_name, value_name, result));
   }
-  return hr;
+  return result;
 }
 
 // static GET helper
@@ -384,82 +402,70 @@ HRESULT RegKey::GetValueStaticHelper(const TCHAR * full_key_name,
                                      size_t * byte_count) {
   ASSERT1(full_key_name);
 
-  HRESULT hr = HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
-  // get the root HKEY
-  CString key_name(full_key_name);
-  RootKeyInfo info = GetRootKeyInfo(&key_name);
-
-  if (info.key != NULL) {
-    RegKey key;
-    hr = key.Open(info.key, key_name.GetString(),
-                  ApplyWoWOverride(KEY_READ, info.wow_override));
-    if (hr == S_OK) {
-      switch (type) {
-        case REG_DWORD:
-          hr = key.GetValue(value_name, reinterpret_cast<DWORD *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Read int32 value: %s:%s = %d]"),
-                          full_key_name,
-                          value_name,
-                          *reinterpret_cast<DWORD*>(value)));
-          }
-          break;
-        case REG_QWORD:
-          hr = key.GetValue(value_name, reinterpret_cast<DWORD64 *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Read int64 value: %s:%s = %s]"),
-                          full_key_name,
-                          value_name,
-                          String_Int64ToString(
-                              *(reinterpret_cast<DWORD64*>(value)), 10)));
-          }
-          break;
-        case REG_SZ:
-          hr = key.GetValue(value_name, reinterpret_cast<TCHAR * *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Read string value: %s:%s = %s]"),
-                          full_key_name,
-                          value_name,
-                          *reinterpret_cast<TCHAR * *>(value)));
-          }
-          break;
-        case REG_MULTI_SZ:
-          hr = key.GetValue(value_name,
-                            reinterpret_cast<std::vector<CString> *>(value));
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Read multi string value: %s:%s = %d]"),
-                full_key_name,
-                value_name,
-                reinterpret_cast<std::vector<CString>*>(value)->size()));
-          }
-          break;
-        case REG_BINARY:
-          hr = key.GetValue(value_name,
-                            reinterpret_cast<byte**>(value),
-                            byte_count);
-          if (SUCCEEDED(hr)) {
-            UTIL_LOG(L6, (_T("[Read binary value: %s:%s, len = %d]"),
-                          full_key_name, value_name, byte_count));
-          }
-          break;
-        default:
-          ASSERT(false, (_T("Unsupported Registry Type")));
-          hr = HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
-          break;
-      }
-      // close the key after writing
-      HRESULT temp_res = key.Close();
-      if (hr == S_OK) {
-        hr = temp_res;
-      } else {
-        UTIL_LOG(L5, (_T("[Failed to read reg value: %s:%s]"),
-                      full_key_name, value_name));
-      }
-    } else {
-      UTIL_LOG(L5, (_T("[reg value does not exist: %s]"), key_name));
+  const HRESULT result = DoWithCachedKey(
+      full_key_name, false, [&](RegKey* key) {
+    HRESULT hr = S_OK;
+    switch (type) {
+      case REG_DWORD:
+        hr = key->GetValue(value_name, reinterpret_cast<DWORD *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Read int32 value: %s:%s = %d]"),
+                        full_key_name,
+                        value_name,
+                        *reinterpret_cast<DWORD*>(value)));
+        }
+        break;
+      case REG_QWORD:
+        hr = key->GetValue(value_name, reinterpret_cast<DWORD64 *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Read int64 value: %s:%s = %s]"),
+                        full_key_name,
+                        value_name,
+                        String_Int64ToString(
+                            *(reinterpret_cast<DWORD64*>(value)), 10)));
+        }
+        break;
+      case REG_SZ:
+        hr = key->GetValue(value_name, reinterpret_cast<TCHAR * *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Read string value: %s:%s = %s]"),
+                        full_key_name,
+                        value_name,
+                        *reinterpret_cast<TCHAR * *>(value)));
+        }
+        break;
+      case REG_MULTI_SZ:
+        hr = key->GetValue(value_name,
+                           reinterpret_cast<std::vector<CString> *>(value));
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Read multi string value: %s:%s = %d]"),
+              full_key_name,
+              value_name,
+              reinterpret_cast<std::vector<CString>*>(value)->size()));
+        }
+        break;
+      case REG_BINARY:
+        hr = key->GetValue(value_name,
+                           reinterpret_cast<byte**>(value),
+                           byte_count);
+        if (SUCCEEDED(hr)) {
+          UTIL_LOG(L6, (_T("[Read binary value: %s:%s, len = %d]"),
+                        full_key_name, value_name, byte_count));
+        }
+        break;
+      default:
+        ASSERT(false, (_T("Unsupported Registry Type")));
+        hr = HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+        break;
     }
+    return hr;
+  });
+
+  if (FAILED(result)) {
+    UTIL_LOG(L5, (_T("[Failed to read reg value: %s:%s][0x%x]"),
+                  full_key_name, value_name, result));
   }
-  return hr;
+  return result;
 }
 
 // GET helper
@@ -648,6 +654,41 @@ HRESULT RegKey::GetValue(const TCHAR* value_name, OUT CString* value) const {
   return hr;
 }
 
+HRESULT RegKey::GetValues(ValueRequest* values, size_t num_values) const {
+  ASSERT1(values || !num_values);
+  ASSERT1(h_key_);
+
+  for (size_t i = 0; i != num_values; ++i) {
+    ValueRequest& request = values[i];
+    ASSERT1(request.value);
+    switch (request.type) {
+      case REG_DWORD:
+        request.hr = GetValue(request.value_name,
+                              static_cast<DWORD*>(request.value));
+        break;
+      case REG_QWORD:
+        request.hr = GetValue(request.value_name,
+                              static_cast<DWORD64*>(request.value));
+        break;
+      case REG_SZ:
+        request.hr = GetValue(request.value_name,
+                              static_cast<CString*>(request.value));
+        break;
+      default:
+        ASSERT(false, (_T("Unsupported Registry Type")));
+        request.hr = HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+        break;
+    }
+
+    // The remaining values can't be read either.
+    if (request.hr == HRESULT_FROM_WIN32(ERROR_KEY_DELETED)) {
+      return request.hr;
+    }
+  }
+
+  return S_OK;
+}
+
 // convert REG_MULTI_SZ bytes to string array
 HRESULT RegKey::MultiSZBytesToStringArray(const byte * buffer,
                                           size_t byte_count,
@@ -925,20 +966,31 @@ HRESULT RegKey::CopyValue(const TCHAR * full_from_key_name,
 bool RegKey::HasValue(const TCHAR * full_key_name, const TCHAR * value_name) {
   ASSERT1(full_key_name);
 
-  bool has_value = false;
-  // get the root HKEY
-  CString key_name(full_key_name);
-  RootKeyInfo info = GetRootKeyInfo(&key_name);
+  HRESULT hr = DoWithCachedKey(full_key_name, false, [&](RegKey* key) {
+    LONG res = ::RegQueryValueEx(key->h_key_, value_name, NULL, NULL, NULL,
+                                 NULL);
+    return HRESULT_FROM_WIN32(res);
+  });
+  return SUCCEEDED(hr);
+}
 
-  if (info.key != NULL) {
-    RegKey key;
-    if (key.Open(info.key, key_name.GetString(),
-                 ApplyWoWOverride(KEY_READ, info.wow_override)) == S_OK) {
-      has_value = key.HasValue(value_name);
-      key.Close();
+// static version of GetValues
+HRESULT RegKey::GetValues(const TCHAR* full_key_name,
+                          ValueRequest* values,
+                          size_t num_values) {
+  ASSERT1(full_key_name);
+
+  const HRESULT hr = DoWithCachedKey(full_key_name, false, [&](RegKey* key) {
+    return key->GetValues(values, num_values);
+  });
+
+  // The values have not been read if the key could not be opened.
+  if (FAILED(hr)) {
+    for (size_t i = 0; i != num_values; ++i) {
+      values[i].hr = hr;
     }
   }
-  return has_value;
+  return hr;
 }
 
 HRESULT RegKey::GetValueType(const TCHAR* full_key_name,
@@ -986,6 +1038,9 @@ HRESULT RegKey::DeleteKey(const TCHAR* full_key_name, bool recursively) {
   if (hr == S_OK) {
     hr = recursively ? key.RecurseDeleteSubKey(key_name) :
                        key.DeleteSubKey(key_name);
+
+    // The cached keys under the deleted key can't be used anymore.
+    RegKeyCache::Instance().InvalidateAll();
   } else if (hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) ||
              hr == HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND)) {
     hr = S_FALSE;
@@ -204,6 +204,20 @@ class RegKey {
                    size_t * byte_count,
                    DWORD *type) const;
 
+  // A value read by GetValues. |value| points to a DWORD, a DWORD64, or a
+  // CString, depending on |type|, which is REG_DWORD, REG_QWORD, or REG_SZ.
+  // |hr| receives the result of reading the value.
+  struct ValueRequest {
+    const TCHAR* value_name;
+    DWORD type;
+    void* value;
+    HRESULT hr;
+  };
+
+  // get several values in one pass over the key. Returns S_OK even if some of
+  // the values can't be read, and the result for each value is in its |hr|.
+  HRESULT GetValues(ValueRequest* values, size_t num_values) const;
+
   // RENAMERS
 
   // Rename a named value.
@@ -320,6 +334,11 @@ class RegKey {
                           byte * * value,
                           size_t * byte_count);
 
+  // get several values of the key, which is opened once.
+  static HRESULT GetValues(const TCHAR* full_key_name,
+                           ValueRequest* values,
+                           size_t num_values);
+
   // Try reg keys successively if there is a failure in getting a value.
   //
   // Typically used when there is a user value and a default value if the
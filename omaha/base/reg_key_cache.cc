@@ -0,0 +1,286 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/reg_key_cache.h"
+
+#include <utility>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/registry_monitor_manager.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+RegKeyCache* RegKeyCache::instance_ = NULL;
+LLock RegKeyCache::instance_lock_;
+
+RegKeyCache::RegKeyCache()
+    : max_open_keys_(kDefaultMaxOpenKeys),
+      generation_(0),
+      num_hits_(0),
+      num_misses_(0) {
+}
+
+RegKeyCache::~RegKeyCache() {
+  // Stop the monitor before the keys are closed, since its callback closes
+  // the keys.
+  registry_monitor_.reset();
+}
+
+RegKeyCache& RegKeyCache::Instance() {
+  __mutexScope(instance_lock_);
+  if (!instance_) {
+    instance_ = new RegKeyCache;
+  }
+  return *instance_;
+}
+
+void RegKeyCache::DeleteInstance() {
+  RegKeyCache* instance = omaha::interlocked_exchange_pointer(
+      &instance_, static_cast<RegKeyCache*>(NULL));
+  delete instance;
+}
+
+HRESULT RegKeyCache::StartMonitoring(const std::vector<CString>& key_trees) {
+  ASSERT1(!registry_monitor_.get());
+
+  std::unique_ptr<RegistryMonitor> registry_monitor(new RegistryMonitor);
+  HRESULT hr = registry_monitor->Initialize();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (size_t i = 0; i != key_trees.size(); ++i) {
+    const ParsedKeyName key_name(ParseKeyName(key_trees[i]));
+    if (!key_name.root_key) {
+      return E_INVALIDARG;
+    }
+
+    // RegistryMonitor watches the default view of the registry, therefore
+    // trees in the 64-bit view can't be cached.
+    if (key_name.wow_override != RegKey::k32BitView) {
+      return E_INVALIDARG;
+    }
+
+    hr = registry_monitor->MonitorKeyTree(key_name.root_key,
+                                          key_name.sub_key,
+                                          RegistryKeyChangeCallback,
+                                          this);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  hr = registry_monitor->StartMonitoring();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  UTIL_LOG(L3, (_T("[RegKeyCache::StartMonitoring][%Iu trees]"),
+                key_trees.size()));
+
+  __mutexScope(lock_);
+  registry_monitor_ = std::move(registry_monitor);
+  set_cached_key_trees(key_trees);
+  return S_OK;
+}
+
+void RegKeyCache::set_cached_key_trees(const std::vector<CString>& key_trees) {
+  __mutexScope(lock_);
+
+  cached_trees_.clear();
+  for (size_t i = 0; i != key_trees.size(); ++i) {
+    const ParsedKeyName key_name(ParseKeyName(key_trees[i]));
+    if (key_name.root_key) {
+      cached_trees_.push_back(key_name);
+    }
+  }
+  InvalidateAll();
+}
+
+HRESULT RegKeyCache::OpenKey(const TCHAR* full_key_name,
+                             bool create,
+                             std::shared_ptr<RegKey>* key) {
+  ASSERT1(full_key_name);
+  ASSERT1(key);
+
+  const CString cache_key(GetCacheKey(full_key_name, create));
+  uint32 generation = 0;
+
+  {
+    __mutexScope(lock_);
+    std::map<CString, CachedKey>::iterator it = keys_.find(cache_key);
+    if (it != keys_.end()) {
+      lru_.splice(lru_.end(), lru_, it->second.lru_position);
+      *key = it->second.key;
+      ++num_hits_;
+      return S_OK;
+    }
+    generation = generation_;
+  }
+
+  const ParsedKeyName key_name(ParseKeyName(full_key_name));
+  if (!key_name.root_key) {
+    return HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND);
+  }
+
+  // The key is opened without holding the lock. Another thread may open the
+  // same key in the meantime, in which case the first key is cached.
+  std::shared_ptr<RegKey> new_key(std::make_shared<RegKey>());
+  const REGSAM wow_override = static_cast<REGSAM>(key_name.wow_override);
+  HRESULT hr = create ?
+      new_key->Create(key_name.root_key, key_name.sub_key, NULL,
+                      REG_OPTION_NON_VOLATILE,
+                      KEY_ALL_ACCESS | wow_override) :
+      new_key->Open(key_name.root_key, key_name.sub_key,
+                    KEY_READ | wow_override);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  __mutexScope(lock_);
+  ++num_misses_;
+  *key = new_key;
+
+  if (generation != generation_ || !IsInCachedTree(key_name)) {
+    return S_OK;
+  }
+
+  std::pair<std::map<CString, CachedKey>::iterator, bool> result =
+      keys_.insert(std::make_pair(cache_key, CachedKey()));
+  if (!result.second) {
+    *key = result.first->second.key;
+    return S_OK;
+  }
+
+  result.first->second.key = new_key;
+  result.first->second.lru_position = lru_.insert(lru_.end(), cache_key);
+
+  while (static_cast<int>(keys_.size()) > max_open_keys_) {
+    keys_.erase(lru_.front());
+    lru_.pop_front();
+  }
+
+  return S_OK;
+}
+
+void RegKeyCache::Invalidate(const TCHAR* full_key_name, bool create) {
+  ASSERT1(full_key_name);
+
+  __mutexScope(lock_);
+  std::map<CString, CachedKey>::iterator it =
+      keys_.find(GetCacheKey(full_key_name, create));
+  if (it == keys_.end()) {
+    return;
+  }
+
+  lru_.erase(it->second.lru_position);
+  keys_.erase(it);
+}
+
+void RegKeyCache::InvalidateAll() {
+  __mutexScope(lock_);
+
+  // The keys which are still in use are closed when their last user releases
+  // them.
+  keys_.clear();
+  lru_.clear();
+  ++generation_;
+}
+
+void RegKeyCache::set_max_open_keys(int max_open_keys) {
+  ASSERT1(max_open_keys >= 0);
+
+  __mutexScope(lock_);
+  max_open_keys_ = max_open_keys;
+  while (static_cast<int>(keys_.size()) > max_open_keys_) {
+    keys_.erase(lru_.front());
+    lru_.pop_front();
+  }
+}
+
+int RegKeyCache::num_hits() const {
+  __mutexScope(lock_);
+  return num_hits_;
+}
+
+int RegKeyCache::num_misses() const {
+  __mutexScope(lock_);
+  return num_misses_;
+}
+
+int RegKeyCache::num_open_keys() const {
+  __mutexScope(lock_);
+  return static_cast<int>(keys_.size());
+}
+
+// static
+RegKeyCache::ParsedKeyName RegKeyCache::ParseKeyName(
+    const TCHAR* full_key_name) {
+  ASSERT1(full_key_name);
+
+  ParsedKeyName key_name;
+  key_name.sub_key = full_key_name;
+  const RegKey::RootKeyInfo info = RegKey::GetRootKeyInfo(&key_name.sub_key);
+  key_name.root_key = info.key;
+  key_name.wow_override = info.wow_override;
+  key_name.sub_key.TrimRight(_T('\\'));
+  key_name.sub_key.MakeLower();
+  return key_name;
+}
+
+// static
+CString RegKeyCache::GetCacheKey(const TCHAR* full_key_name, bool create) {
+  CString cache_key(full_key_name);
+  cache_key.MakeLower();
+  cache_key.AppendChar(create ? _T('+') : _T('-'));
+  return cache_key;
+}
+
+bool RegKeyCache::IsInCachedTree(const ParsedKeyName& key_name) const {
+  for (size_t i = 0; i != cached_trees_.size(); ++i) {
+    const ParsedKeyName& tree = cached_trees_[i];
+    if (tree.root_key != key_name.root_key ||
+        tree.wow_override != key_name.wow_override) {
+      continue;
+    }
+
+    const int tree_length = tree.sub_key.GetLength();
+    if (key_name.sub_key.Left(tree_length) != tree.sub_key) {
+      continue;
+    }
+
+    if (key_name.sub_key.GetLength() == tree_length ||
+        key_name.sub_key[tree_length] == _T('\\')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void RegKeyCache::RegistryKeyChangeCallback(const TCHAR* key_name,
+                                            void* user_data) {
+  ASSERT1(key_name);
+  ASSERT1(user_data);
+
+  UTIL_LOG(L5, (_T("[RegKeyCache::RegistryKeyChangeCallback][%s]"), key_name));
+  UNREFERENCED_PARAMETER(key_name);
+
+  RegKeyCache* cache = static_cast<RegKeyCache*>(user_data);
+  cache->InvalidateAll();
+}
+
+}  // namespace omaha
@@ -0,0 +1,133 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// RegKeyCache keeps the registry keys opened by the static RegKey functions,
+// so that successive reads and writes of the values of the same key do not
+// parse the key name and open and close the key each time.
+//
+// Only the keys under the key trees passed to StartMonitoring are cached, and
+// any change under one of these trees closes all the cached keys. Since the
+// RegistryMonitor notifies the changes asynchronously, the callers reopen a
+// key if the cached key has been deleted in the meantime. Until monitoring
+// starts, OpenKey opens the key each time.
+
+#ifndef OMAHA_BASE_REG_KEY_CACHE_H_
+#define OMAHA_BASE_REG_KEY_CACHE_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+class RegistryMonitor;
+
+class RegKeyCache {
+ public:
+  static const int kDefaultMaxOpenKeys = 32;
+
+  RegKeyCache();
+  ~RegKeyCache();
+
+  // The cache which is used by the static RegKey functions.
+  static RegKeyCache& Instance();
+  static void DeleteInstance();
+
+  // Starts caching the keys under |key_trees|, which are full key names, and
+  // monitoring these trees for changes.
+  HRESULT StartMonitoring(const std::vector<CString>& key_trees);
+
+  // Opens |full_key_name| for reading, or creates it for writing if |create|
+  // is true. The key is shared with the other callers and must not be closed.
+  HRESULT OpenKey(const TCHAR* full_key_name,
+                  bool create,
+                  std::shared_ptr<RegKey>* key);
+
+  // Closes the cached key. Call when an operation on a cached key fails
+  // because the key has been deleted.
+  void Invalidate(const TCHAR* full_key_name, bool create);
+
+  // Closes all the cached keys.
+  void InvalidateAll();
+
+  // Caches the keys under |key_trees| without monitoring the registry. Keys
+  // are only closed by calls to Invalidate and InvalidateAll. For testing.
+  void set_cached_key_trees(const std::vector<CString>& key_trees);
+
+  void set_max_open_keys(int max_open_keys);
+
+  int num_hits() const;
+  int num_misses() const;
+  int num_open_keys() const;
+
+ private:
+  // A key name split into its root key and lowercase subkey name.
+  struct ParsedKeyName {
+    ParsedKeyName() : root_key(NULL), wow_override(RegKey::k32BitView) {}
+
+    HKEY root_key;
+    RegKey::WoWOverride wow_override;
+    CString sub_key;
+  };
+
+  struct CachedKey {
+    std::shared_ptr<RegKey> key;
+    std::list<CString>::iterator lru_position;
+  };
+
+  static ParsedKeyName ParseKeyName(const TCHAR* full_key_name);
+  static CString GetCacheKey(const TCHAR* full_key_name, bool create);
+
+  // Returns true if |key_name| is one of the cached trees or is under one.
+  bool IsInCachedTree(const ParsedKeyName& key_name) const;
+
+  static void RegistryKeyChangeCallback(const TCHAR* key_name,
+                                        void* user_data);
+
+  mutable LLock lock_;
+
+  std::vector<ParsedKeyName> cached_trees_;
+
+  // Cached keys by lowercase key name and access, and their names from the
+  // least to the most recently used.
+  std::map<CString, CachedKey> keys_;
+  std::list<CString> lru_;
+  int max_open_keys_;
+
+  // Incremented each time the cached keys are closed. A key opened while the
+  // keys are closed is not cached, since it may already be deleted.
+  uint32 generation_;
+
+  int num_hits_;
+  int num_misses_;
+
+  std::unique_ptr<RegistryMonitor> registry_monitor_;
+
+  static RegKeyCache* instance_;
+  static LLock instance_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegKeyCache);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_BASE_REG_KEY_CACHE_H_
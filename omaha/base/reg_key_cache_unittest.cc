@@ -0,0 +1,217 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/base/reg_key_cache.h"
+
+#include <memory>
+#include <vector>
+
+#include "omaha/base/reg_key.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+#define kTestKeyTree    _T("HKCU\\Software\\") PATH_COMPANY_NAME \
+                        _T("\\") PRODUCT_NAME _T("\\UnitTest\\RegKeyCache")
+#define kTestKey1       kTestKeyTree _T("\\Key1")
+#define kTestKey2       kTestKeyTree _T("\\Key2")
+#define kTestKey3       kTestKeyTree _T("\\Key3")
+#define kUncachedKey    _T("HKCU\\Software\\") PATH_COMPANY_NAME \
+                        _T("\\") PRODUCT_NAME _T("\\UnitTest\\Uncached")
+
+const TCHAR kValueNameDword[] = _T("dword");
+const TCHAR kValueNameQword[] = _T("qword");
+const TCHAR kValueNameString[] = _T("string");
+
+}  // namespace
+
+class RegKeyCacheTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    RegKey::DeleteKey(kTestKeyTree);
+    RegKey::DeleteKey(kUncachedKey);
+    cache_.reset(new RegKeyCache);
+    cache_->set_cached_key_trees(std::vector<CString>(1, kTestKeyTree));
+  }
+
+  virtual void TearDown() {
+    RegKeyCache::Instance().set_cached_key_trees(std::vector<CString>());
+    cache_.reset();
+    EXPECT_SUCCEEDED(RegKey::DeleteKey(kTestKeyTree));
+    EXPECT_SUCCEEDED(RegKey::DeleteKey(kUncachedKey));
+  }
+
+  std::unique_ptr<RegKeyCache> cache_;
+};
+
+TEST_F(RegKeyCacheTest, OpenKey_KeyDoesNotExist) {
+  std::shared_ptr<RegKey> key;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            cache_->OpenKey(kTestKey1, false, &key));
+  EXPECT_EQ(0, cache_->num_open_keys());
+}
+
+TEST_F(RegKeyCacheTest, OpenKey_InvalidRootKey) {
+  std::shared_ptr<RegKey> key;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND),
+            cache_->OpenKey(_T("HKXX\\Software"), false, &key));
+}
+
+TEST_F(RegKeyCacheTest, OpenKey_HitsAndMisses) {
+  std::shared_ptr<RegKey> key1;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, true, &key1));
+  EXPECT_EQ(1, cache_->num_misses());
+
+  std::shared_ptr<RegKey> key2;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, true, &key2));
+  EXPECT_EQ(key1.get(), key2.get());
+  EXPECT_EQ(1, cache_->num_hits());
+
+  // Key names are not case sensitive.
+  CString key_name(kTestKey1);
+  key_name.MakeUpper();
+  EXPECT_SUCCEEDED(cache_->OpenKey(key_name, true, &key2));
+  EXPECT_EQ(key1.get(), key2.get());
+  EXPECT_EQ(2, cache_->num_hits());
+
+  // Keys opened for reading are cached separately.
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, false, &key2));
+  EXPECT_NE(key1.get(), key2.get());
+  EXPECT_EQ(2, cache_->num_misses());
+  EXPECT_EQ(2, cache_->num_open_keys());
+}
+
+TEST_F(RegKeyCacheTest, OpenKey_KeyNotInCachedTree) {
+  std::shared_ptr<RegKey> key1;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kUncachedKey, true, &key1));
+  std::shared_ptr<RegKey> key2;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kUncachedKey, true, &key2));
+  EXPECT_NE(key1.get(), key2.get());
+  EXPECT_EQ(0, cache_->num_hits());
+  EXPECT_EQ(0, cache_->num_open_keys());
+
+  // A key whose name starts with the name of the tree is not in the tree.
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKeyTree _T("Sibling"), true, &key1));
+  EXPECT_EQ(0, cache_->num_open_keys());
+  EXPECT_SUCCEEDED(RegKey::DeleteKey(kTestKeyTree _T("Sibling")));
+}
+
+TEST_F(RegKeyCacheTest, OpenKey_EvictsLeastRecentlyUsed) {
+  cache_->set_max_open_keys(2);
+
+  std::shared_ptr<RegKey> key;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, true, &key));
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey2, true, &key));
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, true, &key));
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey3, true, &key));
+  EXPECT_EQ(2, cache_->num_open_keys());
+  EXPECT_EQ(3, cache_->num_misses());
+
+  // Key2 has been evicted and Key1 is still cached.
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, true, &key));
+  EXPECT_EQ(2, cache_->num_hits());
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey2, true, &key));
+  EXPECT_EQ(4, cache_->num_misses());
+
+  cache_->set_max_open_keys(0);
+  EXPECT_EQ(0, cache_->num_open_keys());
+}
+
+TEST_F(RegKeyCacheTest, Invalidate) {
+  std::shared_ptr<RegKey> key1;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey1, true, &key1));
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey2, true, &key1));
+
+  cache_->Invalidate(kTestKey1, true);
+  EXPECT_EQ(1, cache_->num_open_keys());
+
+  // The key which is still in use remains open.
+  std::shared_ptr<RegKey> key2;
+  EXPECT_SUCCEEDED(cache_->OpenKey(kTestKey2, true, &key2));
+  EXPECT_EQ(key1.get(), key2.get());
+  cache_->InvalidateAll();
+  EXPECT_EQ(0, cache_->num_open_keys());
+  EXPECT_SUCCEEDED(key1->SetValue(kValueNameDword, static_cast<DWORD>(1)));
+}
+
+TEST_F(RegKeyCacheTest, StaticFunctions_ReopenDeletedKey) {
+  RegKeyCache& cache = RegKeyCache::Instance();
+  cache.set_cached_key_trees(std::vector<CString>(1, kTestKeyTree));
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey1, kValueNameDword,
+                                    static_cast<DWORD>(1)));
+  EXPECT_EQ(1, cache.num_open_keys());
+
+  // Deleting the key with a RegKey instance does not invalidate the cache.
+  RegKey parent_key;
+  EXPECT_SUCCEEDED(parent_key.Open(kTestKeyTree));
+  EXPECT_SUCCEEDED(parent_key.RecurseDeleteSubKey(_T("Key1")));
+  EXPECT_FALSE(RegKey::HasKey(kTestKey1));
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey1, kValueNameDword,
+                                    static_cast<DWORD>(2)));
+  DWORD value = 0;
+  EXPECT_SUCCEEDED(RegKey::GetValue(kTestKey1, kValueNameDword, &value));
+  EXPECT_EQ(2, value);
+
+  // The static DeleteKey closes the cached keys.
+  EXPECT_SUCCEEDED(RegKey::DeleteKey(kTestKey1));
+  EXPECT_EQ(0, cache.num_open_keys());
+  EXPECT_FALSE(RegKey::HasValue(kTestKey1, kValueNameDword));
+}
+
+TEST_F(RegKeyCacheTest, GetValues) {
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey1, kValueNameDword,
+                                    static_cast<DWORD>(10)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey1, kValueNameQword,
+                                    static_cast<DWORD64>(20)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(kTestKey1, kValueNameString, _T("foo")));
+
+  DWORD dword_value = 0;
+  DWORD64 qword_value = 0;
+  CString string_value;
+  CString missing_value(_T("unchanged"));
+  RegKey::ValueRequest values[] = {
+    {kValueNameDword, REG_DWORD, &dword_value, E_FAIL},
+    {kValueNameQword, REG_QWORD, &qword_value, E_FAIL},
+    {kValueNameString, REG_SZ, &string_value, E_FAIL},
+    {_T("missing"), REG_SZ, &missing_value, S_OK},
+  };
+  EXPECT_SUCCEEDED(RegKey::GetValues(kTestKey1, values, arraysize(values)));
+
+  EXPECT_SUCCEEDED(values[0].hr);
+  EXPECT_EQ(10, dword_value);
+  EXPECT_SUCCEEDED(values[1].hr);
+  EXPECT_EQ(20, qword_value);
+  EXPECT_SUCCEEDED(values[2].hr);
+  EXPECT_STREQ(_T("foo"), string_value);
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), values[3].hr);
+  EXPECT_STREQ(_T("unchanged"), missing_value);
+}
+
+TEST_F(RegKeyCacheTest, GetValues_KeyDoesNotExist) {
+  DWORD value = 0;
+  RegKey::ValueRequest values[] = {
+    {kValueNameDword, REG_DWORD, &value, S_OK},
+  };
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            RegKey::GetValues(kTestKey1, values, arraysize(values)));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND), values[0].hr);
+}
+
+}  // namespace omaha
@@ -140,6 +140,10 @@ class KeyWatcher {
     callback_param_ = callback_param;
   }
 
+  void set_watch_subtree(bool watch_subtree) {
+    watch_subtree_ = watch_subtree;
+  }
+
   // Callback called when the notification event is signaled by the OS
   // as a result of a change in the monitored key.
   void HandleEvent(HANDLE handle);
@@ -156,6 +160,9 @@ class KeyWatcher {
   RegistryKeyChangeCallback callback_;
   void* callback_param_;
 
+  // True if changes in the subkeys of the key are reported as well.
+  bool watch_subtree_;
+
   DISALLOW_COPY_AND_ASSIGN(KeyWatcher);
 };
 
@@ -166,6 +173,7 @@ class RegistryMonitorImpl : public Runnable {
 
   HRESULT MonitorKey(HKEY root_key,
                      const CString& sub_key,
+                     bool watch_subtree,
                      RegistryKeyChangeCallback callback,
                      void* user_data);
 
@@ -326,7 +334,8 @@ KeyWatcher::KeyWatcher(const KeyId& key_id)
     : key_id_(key_id),
       notification_event_(::CreateEvent(NULL, false, false, NULL)),
       callback_(NULL),
-      callback_param_(NULL) {
+      callback_param_(NULL),
+      watch_subtree_(false) {
 }
 
 KeyWatcher::~KeyWatcher() {
@@ -347,8 +356,11 @@ HRESULT KeyWatcher::StartWatching() {
                               REG_NOTIFY_CHANGE_ATTRIBUTES    |
                               REG_NOTIFY_CHANGE_LAST_SET      |
                               REG_NOTIFY_CHANGE_SECURITY;
-  LONG result = ::RegNotifyChangeKeyValue(key_.Key(), false, kNotifyFilter,
-                                          get(notification_event_), true);
+  LONG result = ::RegNotifyChangeKeyValue(key_.Key(),
+                                          watch_subtree_,
+                                          kNotifyFilter,
+                                          get(notification_event_),
+                                          true);
   UTIL_LOG(L3, (_T("[KeyWatcher::StartWatching][key '%s' %s]"),
                 key_id_.key_name(),
                 result == ERROR_SUCCESS ? _T("ok") : _T("failed")));
@@ -452,6 +464,7 @@ HRESULT RegistryMonitorImpl::Initialize() {
 
 HRESULT RegistryMonitorImpl::MonitorKey(HKEY root_key,
                                         const CString& sub_key,
+                                        bool watch_subtree,
                                         RegistryKeyChangeCallback callback,
                                         void* user_data) {
   ASSERT1(callback);
@@ -461,6 +474,7 @@ HRESULT RegistryMonitorImpl::MonitorKey(HKEY root_key,
   for (size_t i = 0; i != watchers_.size(); ++i) {
     if (KeyId::IsEqual(watchers_[i].first, key_id)) {
       watchers_[i].second->set_callback(callback, user_data);
+      watchers_[i].second->set_watch_subtree(watch_subtree);
       return S_OK;
     }
   }
@@ -469,6 +483,7 @@ HRESULT RegistryMonitorImpl::MonitorKey(HKEY root_key,
   }
   std::unique_ptr<KeyWatcher> key_watcher(new KeyWatcher(key_id));
   key_watcher->set_callback(callback, user_data);
+  key_watcher->set_watch_subtree(watch_subtree);
   Watcher watcher(key_id, key_watcher.release());
   watchers_.push_back(watcher);
   return S_OK;
@@ -572,7 +587,14 @@ HRESULT RegistryMonitor::MonitorKey(HKEY root_key,
                                     const CString& sub_key,
                                     RegistryKeyChangeCallback callback,
                                     void* user_data) {
-  return impl_->MonitorKey(root_key, sub_key, callback, user_data);
+  return impl_->MonitorKey(root_key, sub_key, false, callback, user_data);
+}
+
+HRESULT RegistryMonitor::MonitorKeyTree(HKEY root_key,
+                                        const CString& sub_key,
+                                        RegistryKeyChangeCallback callback,
+                                        void* user_data) {
+  return impl_->MonitorKey(root_key, sub_key, true, callback, user_data);
 }
 
 HRESULT RegistryMonitor::MonitorValue(HKEY root_key,
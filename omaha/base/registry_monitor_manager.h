@@ -68,6 +68,15 @@ class RegistryMonitor {
                      RegistryKeyChangeCallback callback,
                      void* user_data);
 
+  // Monitors a registry sub key and all its subkeys for changes. The callback
+  // is called with the name of the monitored key, regardless of which subkey
+  // has changed. Registering the same sub key overrides the previous
+  // registration.
+  HRESULT MonitorKeyTree(HKEY root_key,
+                         const CString& sub_key,
+                         RegistryKeyChangeCallback callback,
+                         void* user_data);
+
   // Adds a registry value to the list of values to monitor for changes.
   // All values must be registered before starting monitoring. Registering
   // the same value is allowed, although not particularly useful.
@@ -231,5 +231,29 @@ TEST_F(RegistryMonitorTest, MonitorKey) {
                                                  kWaitForChangeMs));
 }
 
-}  // namespace omaha
+// Changes to the values of a subkey are only reported when the whole tree
+// of the key is monitored.
+TEST_F(RegistryMonitorTest, MonitorKeyTree) {
+  EXPECT_HRESULT_SUCCEEDED(RegKey::CreateKey(_T("HKCU\\key\\subkey")));
+
+  RegistryMonitor registry_monitor;
+  EXPECT_HRESULT_SUCCEEDED(registry_monitor.Initialize());
+  EXPECT_HRESULT_SUCCEEDED(registry_monitor.MonitorKeyTree(
+      HKEY_CURRENT_USER, kKeyName, RegistryKeyCallback, this));
+
+  EXPECT_HRESULT_SUCCEEDED(registry_monitor.StartMonitoring());
 
+  EXPECT_HRESULT_SUCCEEDED(RegKey::SetValue(_T("HKCU\\key\\subkey"),
+                                            kValueName,
+                                            _T("foo")));
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(registry_changed_event_),
+                                                 kWaitForChangeMs));
+
+  EXPECT_TRUE(::ResetEvent(get(registry_changed_event_)));
+  EXPECT_HRESULT_SUCCEEDED(RegKey::DeleteValue(_T("HKCU\\key\\subkey"),
+                                               kValueName));
+  EXPECT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(registry_changed_event_),
+                                                 kWaitForChangeMs));
+}
+
+}  // namespace omaha
@@ -23,6 +23,10 @@
 #include <string>
 #include <memory>
 
+#if defined(_M_IX86) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
 #include "omaha/base/commontypes.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
@@ -288,33 +292,290 @@ CString AnsiToWideString(const char *from, int length) {
 }
 
 
-// Transform a unicode string into UTF8, as represented in an ASCII string
-CStringA WideToUtf8(const CString& w) {
-  // Add a cutoff. If it's all ascii, convert it directly
-  const TCHAR* input = static_cast<const TCHAR*>(w.GetString());
-  int input_len = w.GetLength(), i;
-  for (i = 0; i < input_len; ++i) {
-    if (input[i] > 127) {
-      break;
+namespace {
+
+// The code is compiled for IA32 on x86, therefore the SSE2 code paths are
+// selected at runtime.
+bool HasSse2() {
+#if defined(_M_IX86) || defined(_M_X64)
+  static const bool has_sse2 =
+      !!::IsProcessorFeaturePresent(PF_XMMI64_INSTRUCTIONS_AVAILABLE);
+  return has_sse2;
+#else
+  return false;
+#endif
+}
+
+// Copies the ASCII characters at the start of |in| to |out| and returns how
+// many were copied. |out| has room for |length| characters.
+size_t NarrowAsciiPrefix(const wchar_t* in, size_t length, char* out) {
+  size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+  if (HasSse2()) {
+    const __m128i non_ascii_mask = _mm_set1_epi16(static_cast<short>(0xff80));
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+      const __m128i low = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(in + i));
+      const __m128i high = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(in + i + 8));
+      const __m128i non_ascii =
+          _mm_and_si128(_mm_or_si128(low, high), non_ascii_mask);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi16(non_ascii, zero)) != 0xffff) {
+        break;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                       _mm_packus_epi16(low, high));
     }
   }
+#endif
+  for (; i < length && in[i] < 0x80; ++i) {
+    out[i] = static_cast<char>(in[i]);
+  }
+  return i;
+}
 
-  // If we made it to the end without breaking, then it's all ANSI, so do a quick convert
-  if (i == input_len) {
-    return WideToAnsiDirect(w);
+// Copies the ASCII bytes at the start of |in| to |out| and returns how many
+// were copied. |out| has room for |length| characters.
+size_t WidenAsciiPrefix(const uint8* in, size_t length, wchar_t* out) {
+  size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+  if (HasSse2()) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+      const __m128i bytes = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(in + i));
+      if (_mm_movemask_epi8(bytes)) {
+        break;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                       _mm_unpacklo_epi8(bytes, zero));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8),
+                       _mm_unpackhi_epi8(bytes, zero));
+    }
+  }
+#endif
+  for (; i < length && in[i] < 0x80; ++i) {
+    out[i] = in[i];
   }
+  return i;
+}
 
-  // Figure out how long the string is
-  int req_bytes = ::WideCharToMultiByte(CP_UTF8, 0, w, -1, NULL, 0, NULL, NULL);
+bool IsHighSurrogate(wchar_t c) {
+  return c >= 0xd800 && c <= 0xdbff;
+}
+
+bool IsLowSurrogate(wchar_t c) {
+  return c >= 0xdc00 && c <= 0xdfff;
+}
+
+// Computes the length of the UTF-8 encoding of |in|. Returns false if |in| has
+// unpaired surrogates.
+bool GetUtf8Length(const wchar_t* in, size_t length, size_t* utf8_length) {
+  size_t result = 0;
+  for (size_t i = 0; i < length; ++i) {
+    const wchar_t c = in[i];
+    if (c < 0x80) {
+      result += 1;
+    } else if (c < 0x800) {
+      result += 2;
+    } else if (IsHighSurrogate(c)) {
+      if (i + 1 == length || !IsLowSurrogate(in[i + 1])) {
+        return false;
+      }
+      result += 4;
+      ++i;
+    } else if (IsLowSurrogate(c)) {
+      return false;
+    } else {
+      result += 3;
+    }
+  }
+  *utf8_length = result;
+  return true;
+}
+
+// Encodes |in|, which has no unpaired surrogates, to |out|, which has exactly
+// the room for the UTF-8 encoding of |in|.
+void EncodeUtf8(const wchar_t* in, size_t length, char* out) {
+  size_t i = 0;
+  for (;;) {
+    const size_t ascii_length = NarrowAsciiPrefix(in + i, length - i, out);
+    i += ascii_length;
+    out += ascii_length;
+    if (i == length) {
+      return;
+    }
+
+    uint32 c = in[i++];
+    if (c < 0x800) {
+      *out++ = static_cast<char>(0xc0 | (c >> 6));
+    } else {
+      if (IsHighSurrogate(static_cast<wchar_t>(c))) {
+        c = 0x10000 + ((c - 0xd800) << 10) + (in[i++] - 0xdc00);
+        *out++ = static_cast<char>(0xf0 | (c >> 18));
+        *out++ = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+      } else {
+        *out++ = static_cast<char>(0xe0 | (c >> 12));
+      }
+      *out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+    }
+    *out++ = static_cast<char>(0x80 | (c & 0x3f));
+  }
+}
+
+// Decodes the UTF-8 in |in| to |out|, which has room for |length| characters,
+// and returns the number of characters in |out_length|. Returns false if |in|
+// is not well-formed UTF-8.
+bool DecodeUtf8(const uint8* in,
+                size_t length,
+                wchar_t* out,
+                size_t* out_length) {
+  const wchar_t* const out_start = out;
+  size_t i = 0;
+  for (;;) {
+    const size_t ascii_length = WidenAsciiPrefix(in + i, length - i, out);
+    i += ascii_length;
+    out += ascii_length;
+    if (i == length) {
+      *out_length = out - out_start;
+      return true;
+    }
+
+    // The ranges of the second byte exclude the overlong encodings, the
+    // surrogates, and the code points above U+10FFFF.
+    const uint8 lead = in[i];
+    size_t num_trail_bytes = 0;
+    uint8 min_second = 0x80;
+    uint8 max_second = 0xbf;
+    uint32 c = 0;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+      num_trail_bytes = 1;
+      c = lead & 0x1f;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+      num_trail_bytes = 2;
+      c = lead & 0x0f;
+      if (lead == 0xe0) {
+        min_second = 0xa0;
+      } else if (lead == 0xed) {
+        max_second = 0x9f;
+      }
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+      num_trail_bytes = 3;
+      c = lead & 0x07;
+      if (lead == 0xf0) {
+        min_second = 0x90;
+      } else if (lead == 0xf4) {
+        max_second = 0x8f;
+      }
+    } else {
+      return false;
+    }
 
-  std::unique_ptr<char[]> utf8_buffer(new char[req_bytes]);
+    if (length - i <= num_trail_bytes ||
+        in[i + 1] < min_second || in[i + 1] > max_second) {
+      return false;
+    }
+    for (size_t j = 1; j <= num_trail_bytes; ++j) {
+      const uint8 trail = in[i + j];
+      if ((trail & 0xc0) != 0x80) {
+        return false;
+      }
+      c = (c << 6) | (trail & 0x3f);
+    }
+    i += num_trail_bytes + 1;
+
+    if (c < 0x10000) {
+      *out++ = static_cast<wchar_t>(c);
+    } else {
+      c -= 0x10000;
+      *out++ = static_cast<wchar_t>(0xd800 + (c >> 10));
+      *out++ = static_cast<wchar_t>(0xdc00 + (c & 0x3ff));
+    }
+  }
+}
+
+// Converts |in| to UTF-8 in the buffer returned by |output->Resize()|, which
+// may be called a second time with a larger size. Returns false if |in| has
+// unpaired surrogates, which ::WideCharToMultiByte replaces.
+template <typename Output>
+bool WideToUtf8Buffer(const wchar_t* in, size_t length, Output* output) {
+  // Most of the strings are ASCII, and are converted in one pass.
+  char* out = output->Resize(length);
+  const size_t ascii_length = NarrowAsciiPrefix(in, length, out);
+  if (ascii_length == length) {
+    return true;
+  }
+
+  size_t utf8_length = 0;
+  if (!GetUtf8Length(in + ascii_length, length - ascii_length, &utf8_length)) {
+    return false;
+  }
+  out = output->Resize(ascii_length + utf8_length);
+  EncodeUtf8(in + ascii_length, length - ascii_length, out + ascii_length);
+  return true;
+}
+
+// Converts |in| with ::WideCharToMultiByte, for the strings which are not
+// well-formed UTF-16.
+template <typename Output>
+void WideToUtf8BufferOs(const wchar_t* in, size_t length, Output* output) {
+  ASSERT1(length <= INT_MAX);
+  const int in_length = static_cast<int>(length);
+  const int utf8_length = ::WideCharToMultiByte(CP_UTF8, 0, in, in_length,
+                                                NULL, 0, NULL, NULL);
+  char* out = output->Resize(utf8_length);
+  VERIFY1(utf8_length == ::WideCharToMultiByte(CP_UTF8, 0, in, in_length,
+                                               out, utf8_length, NULL, NULL));
+}
+
+class CStringAOutput {
+ public:
+  explicit CStringAOutput(CStringA* str) : str_(str), length_(0) {}
+  ~CStringAOutput() { str_->ReleaseBufferSetLength(length_); }
+
+  char* Resize(size_t length) {
+    length_ = static_cast<int>(length);
+    return str_->GetBufferSetLength(length_);
+  }
+
+ private:
+  CStringA* str_;
+  int length_;
+
+  DISALLOW_COPY_AND_ASSIGN(CStringAOutput);
+};
+
+class VectorOutput {
+ public:
+  explicit VectorOutput(std::vector<uint8>* vec) : vec_(vec) {}
 
-  int conv_bytes = ::WideCharToMultiByte(CP_UTF8, 0, w, -1, utf8_buffer.get(), req_bytes, NULL, NULL);
-  ASSERT1(req_bytes == conv_bytes);
+  char* Resize(size_t length) {
+    vec_->resize(length);
+    return length ? reinterpret_cast<char*>(&vec_->front()) : NULL;
+  }
 
-  // conv_bytes includes the null terminator, when we read this in, don't read the terminator
-  CStringA out(utf8_buffer.get(), conv_bytes - 1);
+ private:
+  std::vector<uint8>* vec_;
 
+  DISALLOW_COPY_AND_ASSIGN(VectorOutput);
+};
+
+}  // namespace
+
+// Transform a unicode string into UTF8, as represented in an ASCII string
+CStringA WideToUtf8(const CString& w) {
+  CStringA out;
+  if (w.IsEmpty()) {
+    return out;
+  }
+
+  {
+    CStringAOutput output(&out);
+    if (!WideToUtf8Buffer(w.GetString(), w.GetLength(), &output)) {
+      WideToUtf8BufferOs(w.GetString(), w.GetLength(), &output);
+    }
+  }
   return out;
 }
 
@@ -322,45 +583,44 @@ CStringA WideToUtf8(const CString& w) {
 void WideToUtf8Vector(const CString& wstr, std::vector<uint8>* vec_out) {
   ASSERT1(vec_out);
 
-  if (wstr.IsEmpty()) {
-    vec_out->clear();
-    return;
+  VectorOutput output(vec_out);
+  if (!WideToUtf8Buffer(wstr.GetString(), wstr.GetLength(), &output)) {
+    WideToUtf8BufferOs(wstr.GetString(), wstr.GetLength(), &output);
   }
-
-  CStringA str_as_utf8(WideToUtf8(wstr));
-
-  ASSERT1(str_as_utf8.GetLength() > 0);
-  vec_out->resize(str_as_utf8.GetLength());
-  memcpy(&vec_out->front(), CStrBufA(str_as_utf8), vec_out->size());
 }
 
 CString Utf8ToWideChar(const char* utf8, uint32 num_bytes) {
   ASSERT1(utf8);
-  if (num_bytes == 0) {
+
+  // The string ends at the first null character, if any.
+  const void* null_char = memchr(utf8, 0, num_bytes);
+  if (null_char) {
+    num_bytes = static_cast<uint32>(static_cast<const char*>(null_char) - utf8);
+  }
+  if (num_bytes == 0 || num_bytes > INT_MAX) {
     return CString();
   }
 
-  uint32 number_of_wide_chars = ::MultiByteToWideChar(CP_UTF8, 0, utf8, num_bytes, NULL, 0);
-  number_of_wide_chars += 1;  // make room for NULL terminator
-
+  // UTF-8 needs at least as many bytes as UTF-16 needs characters, therefore
+  // the ASCII strings are converted in a buffer of the exact size.
   CString ret_string;
-  TCHAR* buffer = ret_string.GetBuffer(number_of_wide_chars);
-  DWORD number_of_characters_copied = ::MultiByteToWideChar(CP_UTF8, 0, utf8, num_bytes, buffer, number_of_wide_chars);
-  ASSERT1(number_of_characters_copied == number_of_wide_chars - 1);
-  buffer[number_of_wide_chars - 1] = _T('\0');  // ensure there is a NULL terminator
-  ret_string.ReleaseBuffer();
-
-  // Strip the byte order marker if there is one in the document.
-  if (ret_string[0] == kUnicodeBom) {
-    ret_string = ret_string.Right(ret_string.GetLength() - 1);
+  TCHAR* buffer = ret_string.GetBufferSetLength(static_cast<int>(num_bytes));
+  size_t number_of_wide_chars = 0;
+  if (!DecodeUtf8(reinterpret_cast<const uint8*>(utf8), num_bytes,
+                  buffer, &number_of_wide_chars)) {
+    // ::MultiByteToWideChar replaces the malformed sequences.
+    number_of_wide_chars = ::MultiByteToWideChar(
+        CP_UTF8, 0, utf8, num_bytes, buffer, static_cast<int>(num_bytes));
+    ASSERT1(number_of_wide_chars);
   }
+  ret_string.ReleaseBufferSetLength(static_cast<int>(number_of_wide_chars));
 
-  if (number_of_characters_copied > 0) {
-    return ret_string;
+  // Strip the byte order marker if there is one in the document.
+  if (!ret_string.IsEmpty() && ret_string[0] == kUnicodeBom) {
+    ret_string.Delete(0);
   }
 
-  // Failure case
-  return CString();
+  return ret_string;
 }
 
 CString Utf8BufferToWideChar(const std::vector<uint8>& buffer) {
@@ -647,6 +907,21 @@ int Base64EscapeInternal(const char *src, int szsrc,
   char *cur_dest = dest;
   const unsigned char *cur_src = reinterpret_cast<const unsigned char*>(src);
 
+  // The blocks for which |dest| has room are encoded without checking the
+  // room for each of them.
+  const int num_blocks = std::min(szsrc / 3, std::max(szdest, 0) / 4);
+  for (int i = 0; i < num_blocks; ++i) {
+    const uint32 bits = (cur_src[0] << 16) | (cur_src[1] << 8) | cur_src[2];
+    cur_dest[0] = base64[bits >> 18];
+    cur_dest[1] = base64[(bits >> 12) & 0x3f];
+    cur_dest[2] = base64[(bits >> 6) & 0x3f];
+    cur_dest[3] = base64[bits & 0x3f];
+    cur_dest += 4;
+    cur_src += 3;
+  }
+  szsrc -= num_blocks * 3;
+  szdest -= num_blocks * 4;
+
   // Three bytes of data encodes to four characters of cyphertext.
   // So we can pump through three-byte chunks atomically.
   while (szsrc > 2) { /* keep going until we have less than 24 bits */
@@ -786,6 +1061,31 @@ int Base64UnescapeInternal(const char *src, int len_src,
   int decode;
   int destidx = 0;
   int state = 0;
+
+  // Groups of four base64 characters are decoded together while |dest| has
+  // room for them. The non-base64 characters in a group, such as whitespace,
+  // padding, and null characters, are handled one at a time below.
+  if (dest) {
+    const unsigned char* in = reinterpret_cast<const unsigned char*>(src);
+    while (len_src >= 4 && len_dest - destidx >= 3) {
+      const uint32 a = static_cast<unsigned char>(unbase64[in[0]]);
+      const uint32 b = static_cast<unsigned char>(unbase64[in[1]]);
+      const uint32 c = static_cast<unsigned char>(unbase64[in[2]]);
+      const uint32 d = static_cast<unsigned char>(unbase64[in[3]]);
+      if ((a | b | c | d) >= 64) {
+        break;
+      }
+      const uint32 bits = (a << 18) | (b << 12) | (c << 6) | d;
+      dest[destidx] = static_cast<char>(bits >> 16);
+      dest[destidx + 1] = static_cast<char>(bits >> 8);
+      dest[destidx + 2] = static_cast<char>(bits);
+      destidx += 3;
+      in += 4;
+      len_src -= 4;
+    }
+    src = reinterpret_cast<const char*>(in);
+  }
+
   // Used an unsigned char, since ch is used as an array index (into unbase64).
   unsigned char ch = 0;
   while (len_src-- && (ch = *src++) != '\0')  {
@@ -2002,15 +2302,148 @@ bool ContainsOnlyAsciiChars(const CString& str) {
   }
   return true;
 }
+namespace {
+
+#if defined(_M_IX86) || defined(_M_X64)
+
+// Converts the 16 nibbles in |nibbles| to lowercase hex digits.
+__m128i NibblesToHexDigits(__m128i nibbles) {
+  const __m128i letters = _mm_and_si128(
+      _mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)),
+      _mm_set1_epi8('a' - '0' - 10));
+  return _mm_add_epi8(_mm_add_epi8(nibbles, _mm_set1_epi8('0')), letters);
+}
+
+void StoreHexDigits(__m128i digits, char* out) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), digits);
+}
+
+void StoreHexDigits(__m128i digits, wchar_t* out) {
+  const __m128i zero = _mm_setzero_si128();
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out),
+                   _mm_unpacklo_epi8(digits, zero));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 8),
+                   _mm_unpackhi_epi8(digits, zero));
+}
+
+// Loads 16 characters as bytes. The wide characters above 0xff become bytes
+// which are not hex digits.
+__m128i LoadHexDigits(const char* in) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+}
+
+__m128i LoadHexDigits(const wchar_t* in) {
+  return _mm_packus_epi16(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in)),
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 8)));
+}
+
+// Returns x <= y for each unsigned byte.
+__m128i LessOrEqualEpu8(__m128i x, __m128i y) {
+  return _mm_cmpeq_epi8(_mm_min_epu8(x, y), x);
+}
+
+// Converts the 16 hex digits in |digits| to 8 bytes in the low bytes of the
+// 16-bit lanes of |bytes|. Returns false if |digits| has other characters.
+bool HexDigitsToBytes(__m128i digits, __m128i* bytes) {
+  const __m128i digit_values = _mm_sub_epi8(digits, _mm_set1_epi8('0'));
+  const __m128i is_digit = LessOrEqualEpu8(digit_values, _mm_set1_epi8(9));
+  const __m128i letter_values = _mm_sub_epi8(
+      _mm_or_si128(digits, _mm_set1_epi8(0x20)), _mm_set1_epi8('a'));
+  const __m128i is_letter = LessOrEqualEpu8(letter_values, _mm_set1_epi8(5));
+  if (_mm_movemask_epi8(_mm_or_si128(is_digit, is_letter)) != 0xffff) {
+    return false;
+  }
+
+  const __m128i values = _mm_or_si128(
+      _mm_and_si128(digit_values, is_digit),
+      _mm_and_si128(_mm_add_epi8(letter_values, _mm_set1_epi8(10)),
+                    is_letter));
+  const __m128i high = _mm_and_si128(values, _mm_set1_epi16(0x00ff));
+  const __m128i low = _mm_srli_epi16(values, 8);
+  *bytes = _mm_or_si128(_mm_slli_epi16(high, 4), low);
+  return true;
+}
+
+#endif  // defined(_M_IX86) || defined(_M_X64)
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// Writes the lowercase hex digits of |bytes| to |out|, which has room for
+// twice |num_bytes| characters.
+template <typename Char>
+void EncodeHex(const uint8* bytes, size_t num_bytes, Char* out) {
+  size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+  if (HasSse2()) {
+    const __m128i low_nibble_mask = _mm_set1_epi8(0x0f);
+    for (; i + 16 <= num_bytes; i += 16) {
+      const __m128i in = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(bytes + i));
+      const __m128i high = NibblesToHexDigits(
+          _mm_and_si128(_mm_srli_epi16(in, 4), low_nibble_mask));
+      const __m128i low = NibblesToHexDigits(
+          _mm_and_si128(in, low_nibble_mask));
+      StoreHexDigits(_mm_unpacklo_epi8(high, low), out + i * 2);
+      StoreHexDigits(_mm_unpackhi_epi8(high, low), out + i * 2 + 16);
+    }
+  }
+#endif
+  for (; i < num_bytes; ++i) {
+    out[i * 2] = kHexDigits[bytes[i] >> 4];
+    out[i * 2 + 1] = kHexDigits[bytes[i] & 0xf];
+  }
+}
+
+int HexDigitValue(unsigned int c) {
+  if (c - '0' <= 9) {
+    return c - '0';
+  }
+  c |= 0x20;
+  if (c - 'a' <= 5) {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+// Decodes the |num_bytes| bytes encoded by the hex digits in |in| to |out|.
+// Returns false if |in| has characters which are not hex digits.
+template <typename Char>
+bool DecodeHex(const Char* in, size_t num_bytes, uint8* out) {
+  size_t i = 0;
+#if defined(_M_IX86) || defined(_M_X64)
+  if (HasSse2()) {
+    for (; i + 16 <= num_bytes; i += 16) {
+      __m128i low_bytes;
+      __m128i high_bytes;
+      if (!HexDigitsToBytes(LoadHexDigits(in + i * 2), &low_bytes) ||
+          !HexDigitsToBytes(LoadHexDigits(in + i * 2 + 16), &high_bytes)) {
+        return false;
+      }
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                       _mm_packus_epi16(low_bytes, high_bytes));
+    }
+  }
+#endif
+  for (; i < num_bytes; ++i) {
+    const int high = HexDigitValue(static_cast<unsigned int>(in[i * 2]));
+    const int low = HexDigitValue(static_cast<unsigned int>(in[i * 2 + 1]));
+    if (high < 0 || low < 0) {
+      return false;
+    }
+    out[i] = static_cast<uint8>((high << 4) | low);
+  }
+  return true;
+}
+
+}  // namespace
+
 CString BytesToHex(const uint8* bytes, size_t num_bytes) {
   CString result;
-  if (bytes && num_bytes < INT_MAX/sizeof(TCHAR)) {
-    result.Preallocate(static_cast<int>(num_bytes * sizeof(TCHAR)));
-    static const TCHAR* const kHexChars = _T("0123456789abcdef");
-    for (size_t i = 0; i != num_bytes; ++i) {
-      result.AppendChar(kHexChars[(bytes[i] >> 4)]);
-      result.AppendChar(kHexChars[(bytes[i] & 0xf)]);
-    }
+  if (bytes && num_bytes && num_bytes < INT_MAX / 2) {
+    const int length = static_cast<int>(num_bytes * 2);
+    EncodeHex(bytes, num_bytes, result.GetBufferSetLength(length));
+    result.ReleaseBufferSetLength(length);
   }
   return result;
 }
@@ -2138,8 +2571,6 @@ static char hex_value[256] = {
   0,  0,  0,  0,  0,  0,  0, 0, 0, 0, 0, 0, 0, 0, 0, 0
 };
 
-static char hex_char[] = "0123456789abcdef";
-
 // This is a templated function so that T can be either a char*
 // or a string.  This works because we use the [] operator to access
 // individual characters at a time.
@@ -2151,33 +2582,28 @@ static void a2b_hex_t(const char* a, T b, size_t num) {
   }
 }
 
-// This is a templated function so that T can be either a char*
-// or a string.  This works because we use the [] operator to access
-// individual characters at a time.
-template <typename T>
-static void b2a_hex_t(const unsigned char* b, T a, size_t num) {
-  for (size_t i = 0; i < num; i++) {
-    a[i * 2 + 0] = hex_char[b[i] >> 4];
-    a[i * 2 + 1] = hex_char[b[i] & 0xf];
+// The characters which are not hex digits decode as zeros.
+static void a2b_hex_bytes(const char* a, uint8* b, size_t num) {
+  if (!DecodeHex(a, num, b)) {
+    a2b_hex_t<uint8*>(a, b, num);
   }
 }
 
 void b2a_hex(const unsigned char* b, char* a, size_t num) {
-  b2a_hex_t<char*>(b, a, num);
+  EncodeHex(b, num, a);
 }
 
 void a2b_hex(const char* a, unsigned char* b, size_t num) {
-  a2b_hex_t<unsigned char*>(a, b, num);
+  a2b_hex_bytes(a, b, num);
 }
 
 void a2b_hex(const char* a, char* b, size_t num) {
-  a2b_hex_t<char*>(a, b, num);
+  a2b_hex_bytes(a, reinterpret_cast<uint8*>(b), num);
 }
 
 string b2a_hex(const char* b, size_t len) {
   string result;
-  result.resize(len << 1);
-  b2a_hex_t<string&>(reinterpret_cast<const unsigned char*>(b), result, len);
+  b2a_hex(reinterpret_cast<const unsigned char*>(b), &result, len);
   return result;
 }
 
@@ -2190,52 +2616,43 @@ string a2b_hex(const string& a) {
 
 void b2a_hex(const unsigned char* from, string* to, size_t num) {
   to->resize(num << 1);
-  b2a_hex_t<string&>(from, *to, num);
+  if (num) {
+    EncodeHex(from, num, &(*to)[0]);
+  }
 }
 
 void a2b_hex(const char* from, string* to, size_t num) {
   to->resize(num);
-  a2b_hex_t<string&>(from, *to, num);
+  if (num) {
+    a2b_hex_bytes(from, reinterpret_cast<uint8*>(&(*to)[0]), num);
+  }
 }
 
-template <typename T> bool CheckHexString(const T& str) {
-  if (str.IsEmpty()) {
-    return false;
-  }
+// Decodes |str| if it is a non-empty string of hex digits.
+template <typename T>
+bool DecodeHexString(const T& str, std::vector<uint8>* vec_out) {
+  ASSERT1(vec_out);
 
   const int kStrLen = str.GetLength();
-  if (kStrLen % 2 != 0) {
+  if (kStrLen == 0 || kStrLen % 2 != 0) {
     return false;
   }
 
-  for (int i = 0; i < kStrLen; ++i) {
-    if (!IsHexDigit(str[i])) {
-      return false;
-    }
+  std::vector<uint8> result(kStrLen / 2);
+  if (!DecodeHex(str.GetString(), result.size(), &result.front())) {
+    return false;
   }
 
+  vec_out->swap(result);
   return true;
 }
 
 bool SafeHexStringToVector(const CStringA& str, std::vector<uint8>* vec_out) {
-  ASSERT1(vec_out);
-
-  if (!CheckHexString(str)) {
-    return false;
-  }
-
-  vec_out->resize(str.GetLength() / 2);
-  a2b_hex(str.GetString(), &vec_out->front(), vec_out->size());
-  return true;
+  return DecodeHexString(str, vec_out);
 }
 
 bool SafeHexStringToVector(const CStringW& str, std::vector<uint8>* vec_out) {
-  // Check for input validity before we do a Wide->ANSI conversion.
-  if (!CheckHexString(str)) {
-    return false;
-  }
-
-  return SafeHexStringToVector(WideToAnsiDirect(str), vec_out);
+  return DecodeHexString(str, vec_out);
 }
 
 }  // namespace omaha
@@ -13,6 +13,8 @@
 // limitations under the License.
 // ========================================================================
 
+#include <algorithm>
+
 #include "base/basictypes.h"
 #include "base/rand_util.h"
 #include "omaha/base/debug.h"
@@ -1191,5 +1193,270 @@ TEST(StringTest, WideToUtf8Vector) {
   EXPECT_EQ(8, out.size());
 }
 
-}  // namespace omaha
+namespace {
+
+// The conversions of the OS, which the transcoder in string.cc must match.
+CStringA OsWideToUtf8(const CString& w) {
+  const int utf8_length = ::WideCharToMultiByte(CP_UTF8, 0, w, w.GetLength(),
+                                                NULL, 0, NULL, NULL);
+  CStringA utf8;
+  ::WideCharToMultiByte(CP_UTF8, 0, w, w.GetLength(),
+                        utf8.GetBufferSetLength(utf8_length), utf8_length,
+                        NULL, NULL);
+  utf8.ReleaseBufferSetLength(utf8_length);
+  return utf8;
+}
+
+CString OsUtf8ToWide(const std::vector<uint8>& utf8) {
+  const char* in = reinterpret_cast<const char*>(&utf8.front());
+  const int in_length = static_cast<int>(
+      std::find(utf8.begin(), utf8.end(), 0) - utf8.begin());
+  const int wide_length = ::MultiByteToWideChar(CP_UTF8, 0, in, in_length,
+                                                NULL, 0);
+  CString wide;
+  ::MultiByteToWideChar(CP_UTF8, 0, in, in_length,
+                        wide.GetBufferSetLength(wide_length), wide_length);
+  wide.ReleaseBufferSetLength(wide_length);
+  if (!wide.IsEmpty() && wide[0] == kUnicodeBom) {
+    wide.Delete(0);
+  }
+  return wide;
+}
+
+// Returns a random string, mostly ASCII, with characters from all the
+// planes, and unpaired surrogates if |allow_invalid|.
+CString RandomWideString(int length, bool allow_invalid) {
+  CString result;
+  for (int i = 0; i < length; ++i) {
+    const unsigned int kind = rand() % 100;
+    if (kind < 60) {
+      result.AppendChar(static_cast<TCHAR>(1 + rand() % 0x7f));
+    } else if (kind < 75) {
+      result.AppendChar(static_cast<TCHAR>(0x80 + rand() % 0x780));
+    } else if (kind < 90) {
+      TCHAR c = static_cast<TCHAR>(0x800 + rand() % 0xf800);
+      if (c >= 0xd800 && c <= 0xdfff && !allow_invalid) {
+        c = 0xe000;
+      }
+      result.AppendChar(c);
+    } else {
+      const unsigned int c = (rand() * 32 + rand() % 32) % 0x100000;
+      result.AppendChar(static_cast<TCHAR>(0xd800 + (c >> 10)));
+      result.AppendChar(static_cast<TCHAR>(0xdc00 + (c & 0x3ff)));
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(StringTest, Utf8_Differential) {
+  srand(1);
+  for (int i = 0; i < 10000; ++i) {
+    const CString wide(RandomWideString(rand() % 100, i % 2 == 1));
+    const CStringA utf8(WideToUtf8(wide));
+    EXPECT_STREQ(OsWideToUtf8(wide), utf8);
+
+    std::vector<uint8> utf8_vector;
+    WideToUtf8Vector(wide, &utf8_vector);
+    EXPECT_EQ(static_cast<size_t>(utf8.GetLength()), utf8_vector.size());
+    EXPECT_TRUE(utf8_vector.empty() ||
+                !memcmp(utf8.GetString(), &utf8_vector.front(),
+                        utf8_vector.size()));
+
+    if (utf8_vector.empty()) {
+      continue;
+    }
+
+    // Well-formed UTF-8.
+    EXPECT_STREQ(OsUtf8ToWide(utf8_vector), Utf8BufferToWideChar(utf8_vector));
+
+    // Malformed UTF-8, from corrupt and truncated sequences.
+    std::vector<uint8> corrupt(utf8_vector);
+    corrupt[rand() % corrupt.size()] = static_cast<uint8>(rand());
+    corrupt.resize(1 + rand() % corrupt.size());
+    EXPECT_STREQ(OsUtf8ToWide(corrupt), Utf8BufferToWideChar(corrupt));
+
+    // Random bytes.
+    std::vector<uint8> random_bytes(1 + rand() % 64);
+    for (size_t j = 0; j != random_bytes.size(); ++j) {
+      random_bytes[j] = static_cast<uint8>(rand());
+    }
+    EXPECT_STREQ(OsUtf8ToWide(random_bytes),
+                 Utf8BufferToWideChar(random_bytes));
+  }
+}
+
+TEST(StringTest, Utf8_EdgeCases) {
+  // Overlong encodings, surrogates, and code points above U+10FFFF are
+  // replaced like the OS does.
+  const char* const kMalformed[] = {
+    "\xc0\x80", "\xc1\xbf", "\xe0\x80\x80", "\xe0\x9f\xbf", "\xed\xa0\x80",
+    "\xed\xbf\xbf", "\xf0\x80\x80\x80", "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80",
+    "\xf5\x80\x80\x80", "\xff", "\x80", "\xc3", "\xe2\x82", "\xf0\x9f\x98",
+  };
+  for (size_t i = 0; i != arraysize(kMalformed); ++i) {
+    const std::vector<uint8> utf8(kMalformed[i],
+                                  kMalformed[i] + strlen(kMalformed[i]));
+    EXPECT_STREQ(OsUtf8ToWide(utf8), Utf8BufferToWideChar(utf8));
+  }
+
+  // The largest code points of each length.
+  EXPECT_STREQ(CString(L"\x7f\x7ff\xffff\xdbff\xdfff"),
+               Utf8ToWideChar("\x7f\xdf\xbf\xef\xbf\xbf\xf4\x8f\xbf\xbf", 10));
+
+  // The byte order mark is removed, and the string ends at the first null.
+  EXPECT_STREQ(_T("ab"), Utf8ToWideChar("\xef\xbb\xbf" "ab\0cd", 8));
+  EXPECT_STREQ(_T(""), Utf8ToWideChar("\xef\xbb\xbf", 3));
+  EXPECT_STREQ(_T(""), Utf8ToWideChar("\0ab", 3));
+
+  // Unpaired surrogates are replaced like the OS does.
+  const CString kUnpaired[] = {
+    CString(L"a\xd800"), CString(L"\xdc00z"), CString(L"\xd800\xd800\xdc00"),
+  };
+  for (size_t i = 0; i != arraysize(kUnpaired); ++i) {
+    EXPECT_STREQ(OsWideToUtf8(kUnpaired[i]), WideToUtf8(kUnpaired[i]));
+  }
+}
+
+namespace {
+
+const char kBase64Alphabet[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Straightforward codecs, which the optimized codecs in string.cc must match.
+std::string ReferenceBase64Escape(const std::string& data) {
+  std::string result;
+  for (size_t i = 0; i < data.size(); i += 3) {
+    uint32 bits = static_cast<uint8>(data[i]) << 16;
+    if (i + 1 < data.size()) {
+      bits |= static_cast<uint8>(data[i + 1]) << 8;
+    }
+    if (i + 2 < data.size()) {
+      bits |= static_cast<uint8>(data[i + 2]);
+    }
+    result += kBase64Alphabet[bits >> 18];
+    result += kBase64Alphabet[(bits >> 12) & 0x3f];
+    result += i + 1 < data.size() ? kBase64Alphabet[(bits >> 6) & 0x3f] : '=';
+    result += i + 2 < data.size() ? kBase64Alphabet[bits & 0x3f] : '=';
+  }
+  return result;
+}
+
+CString ReferenceBytesToHex(const std::string& data) {
+  CString result;
+  for (size_t i = 0; i != data.size(); ++i) {
+    result.AppendFormat(_T("%02x"), static_cast<uint8>(data[i]));
+  }
+  return result;
+}
+
+std::string RandomBytes(size_t length) {
+  std::string result(length, '\0');
+  for (size_t i = 0; i != length; ++i) {
+    result[i] = static_cast<char>(rand());
+  }
+  return result;
+}
 
+}  // namespace
+
+TEST(StringTest, Base64_Differential) {
+  srand(3);
+  for (int i = 0; i < 10000; ++i) {
+    const std::string data(RandomBytes(rand() % 100));
+    const std::string expected(ReferenceBase64Escape(data));
+
+    CStringA escaped;
+    Base64Escape(data.c_str(), static_cast<int>(data.size()), &escaped, true);
+    EXPECT_STREQ(expected.c_str(), escaped);
+
+    CStringA web_safe;
+    WebSafeBase64Escape(data.c_str(), static_cast<int>(data.size()),
+                        &web_safe, true);
+    std::string expected_web_safe(expected);
+    std::replace(expected_web_safe.begin(), expected_web_safe.end(), '+', '-');
+    std::replace(expected_web_safe.begin(), expected_web_safe.end(), '/', '_');
+    EXPECT_STREQ(expected_web_safe.c_str(), web_safe);
+
+    CStringA unescaped;
+    EXPECT_EQ(static_cast<int>(data.size()),
+              Base64Unescape(escaped, &unescaped));
+    EXPECT_EQ(data, std::string(unescaped, unescaped.GetLength()));
+
+    // Whitespace is skipped anywhere in the input.
+    CStringA spaced(escaped);
+    if (!spaced.IsEmpty()) {
+      spaced.Insert(rand() % spaced.GetLength(), rand() % 2 ? ' ' : '\n');
+    }
+    EXPECT_EQ(static_cast<int>(data.size()),
+              Base64Unescape(spaced, &unescaped));
+    EXPECT_EQ(data, std::string(unescaped, unescaped.GetLength()));
+
+    // Other characters are rejected.
+    CStringA corrupt(escaped);
+    const int corrupt_index = corrupt.IsEmpty() ? -1 :
+                              rand() % corrupt.GetLength();
+    if (corrupt_index >= 0 && corrupt[corrupt_index] != '=') {
+      corrupt.SetAt(corrupt_index, "!-_.*"[rand() % 5]);
+      EXPECT_EQ(-1, Base64Unescape(corrupt, &unescaped));
+    }
+  }
+}
+
+TEST(StringTest, Base64Unescape_ShortDestination) {
+  const char kEncoded[] = "AAECAwQFBgcICQ==";
+  char decoded[16] = {0};
+  EXPECT_EQ(10, Base64Unescape(kEncoded, arraysize(kEncoded) - 1,
+                               decoded, arraysize(decoded)));
+  EXPECT_EQ(10, Base64Unescape(kEncoded, arraysize(kEncoded) - 1,
+                               decoded, 10));
+  EXPECT_EQ(-1, Base64Unescape(kEncoded, arraysize(kEncoded) - 1,
+                               decoded, 9));
+  EXPECT_EQ(-1, Base64Unescape(kEncoded, arraysize(kEncoded) - 1,
+                               decoded, 1));
+  for (int i = 0; i != 10; ++i) {
+    EXPECT_EQ(i, decoded[i]);
+  }
+}
+
+TEST(StringTest, Hex_Differential) {
+  srand(4);
+  for (int i = 0; i < 10000; ++i) {
+    const std::string data(RandomBytes(rand() % 100));
+    const CString expected(ReferenceBytesToHex(data));
+
+    EXPECT_STREQ(expected,
+                 BytesToHex(reinterpret_cast<const uint8*>(data.c_str()),
+                            data.size()));
+    EXPECT_STREQ(CStringA(expected),
+                 b2a_hex(data.c_str(), data.size()).c_str());
+
+    // Both cases are decoded.
+    const CString hex = i % 2 ? expected : CString(expected).MakeUpper();
+    std::vector<uint8> decoded;
+    if (data.empty()) {
+      EXPECT_FALSE(SafeHexStringToVector(hex, &decoded));
+      continue;
+    }
+    EXPECT_TRUE(SafeHexStringToVector(hex, &decoded));
+    EXPECT_EQ(data, std::string(decoded.begin(), decoded.end()));
+    EXPECT_TRUE(SafeHexStringToVector(CStringA(hex), &decoded));
+    EXPECT_EQ(data, std::string(decoded.begin(), decoded.end()));
+    EXPECT_EQ(data, a2b_hex(std::string(CStringA(hex))));
+
+    // Any other character is rejected, and the output is not changed.
+    CString corrupt(hex);
+    corrupt.SetAt(rand() % corrupt.GetLength(),
+                  _T("g G/:@`\x100\x1ff")[rand() % 9]);
+    std::vector<uint8> unchanged(decoded);
+    EXPECT_FALSE(SafeHexStringToVector(corrupt, &decoded));
+    EXPECT_FALSE(SafeHexStringToVector(WideToAnsiDirect(corrupt), &decoded));
+    EXPECT_TRUE(unchanged == decoded);
+  }
+
+  // a2b_hex decodes the characters which are not hex digits as zeros.
+  EXPECT_EQ(std::string("\x0f\xf0\x01", 3), a2b_hex(std::string("zfFzz1")));
+}
+
+}  // namespace omaha
@@ -1707,31 +1707,6 @@ HRESULT GetLimitedTimeValues(const TCHAR* full_key_names[],
   return hr;
 }
 
-// Wininet.dll (and especially the version that comes with IE7, with 01/12/07
-// timestamp) incorrectly initializes Rasman.dll. As a result, there is a race
-// condition that causes double-free on a memory from process heap.
-// This causes memory corruption in the heap that may later produce a variety
-// of ill effects, most frequently a crash with a callstack that contains
-// wininet and rasman, or ntdll!RtlAllocHeap. The root cause is that
-// Rasapi32!LoadRasmanDllAndInit is not thread safe and can start very involved
-// process of initialization on 2 threads at the same time. It's a bug.
-// Solution: in the begining of the program, trigger synchronous load of
-// rasman dll. The easy way is to call a public ras api that does synchronous
-// initialization, which is what we do here.
-void EnsureRasmanLoaded() {
-  RASENTRYNAME ras_entry_name = {0};
-  DWORD size_bytes = sizeof(ras_entry_name);
-  DWORD number_of_entries = 0;
-  ras_entry_name.dwSize = size_bytes;
-  // we don't really need results of this method,
-  // it simply triggers RASAPI32!LoadRasmanDllAndInit() internally.
-  RasEnumEntriesWWrap(NULL,
-                      NULL,
-                      &ras_entry_name,
-                      &size_bytes,
-                      &number_of_entries);
-}
-
 // Appends two reg keys. Handles the situation where there are traling
 // back slashes in one and leading back slashes in two.
 CString AppendRegKeyPath(const CString& one, const CString& two) {
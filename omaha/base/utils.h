@@ -355,9 +355,6 @@ LARGE_INTEGER MSto100NSRelative(DWORD ms);
 // TODO(omaha): remove from public interface.
 inline void WINAPI NullAPCFunc(ULONG_PTR) {}
 
-// Forces rasman.dll load to avoid a crash in wininet.
-void EnsureRasmanLoaded();
-
 // Returns if the HRESULT argument is a COM error
 // For now, use a quick fix hr -> __hr. Leading underscore names are not to be
 // used in application code.
@@ -179,6 +179,37 @@ HRESULT LoadXMLFromRawData(const std::vector<byte>& xmldata,
   return S_OK;
 }
 
+HRESULT LoadXMLFromStream(IStream* stream,
+                          bool preserve_whitespace,
+                          IXMLDOMDocument** xmldoc) {
+  ASSERT1(stream);
+  ASSERT1(xmldoc);
+  ASSERT1(!*xmldoc);
+
+  *xmldoc = NULL;
+
+  CComPtr<IXMLDOMDocument> my_xmldoc;
+  RET_IF_FAILED(CoCreateSafeDOMDocument(&my_xmldoc));
+  RET_IF_FAILED(my_xmldoc->put_preserveWhiteSpace(
+                              VARIANT_BOOL(preserve_whitespace)));
+
+  VARIANT_BOOL is_successful(VARIANT_FALSE);
+  RET_IF_FAILED(my_xmldoc->load(CComVariant(stream), &is_successful));
+  if (!is_successful) {
+    CComPtr<IXMLDOMParseError> error;
+    CString error_message;
+    RET_IF_FAILED(GetXMLParseError(my_xmldoc, &error));
+    ASSERT1(error);
+    HRESULT error_code = 0;
+    RET_IF_FAILED(InterpretXMLParseError(error, &error_code, &error_message));
+    UTIL_LOG(LE, (_T("[LoadXMLFromStream][parse error: %s]"), error_message));
+    ASSERT1(FAILED(error_code));
+    return FAILED(error_code) ? error_code : CI_E_XML_LOAD_ERROR;
+  }
+  *xmldoc = my_xmldoc.Detach();
+  return S_OK;
+}
+
 HRESULT SaveXMLToFile(IXMLDOMDocument* xmldoc, const TCHAR* xmlfile) {
   ASSERT1(xmldoc);
   ASSERT1(xmlfile);
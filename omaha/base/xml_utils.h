@@ -51,6 +51,12 @@ HRESULT LoadXMLFromRawData(const std::vector<byte>& xmldata,
                            bool preserve_whitespace,
                            IXMLDOMDocument** xmldoc);
 
+// The stream is read incrementally while it is parsed. The data can be in any
+// encoding supported by the xml parser.
+HRESULT LoadXMLFromStream(IStream* stream,
+                          bool preserve_whitespace,
+                          IXMLDOMDocument** xmldoc);
+
 // xmlfile is in encoding specified in the XML document.
 HRESULT SaveXMLToFile(IXMLDOMDocument* xmldoc, const TCHAR * xmlfile);
 
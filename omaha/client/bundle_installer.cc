@@ -20,6 +20,8 @@
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
+#include "omaha/client/client_metrics.h"
 #include "omaha/client/client_utils.h"
 #include "omaha/client/help_url_builder.h"
 #include "omaha/client/resource.h"
@@ -435,6 +437,7 @@ BundleInstaller::BundleInstaller(HelpUrlBuilder* help_url_builder,
     : observer_(NULL),
       help_url_builder_(help_url_builder),
       parent_window_(NULL),
+      is_machine_(false),
       state_(kInit),
       result_(E_UNEXPECTED),
       is_canceled_(false),
@@ -530,6 +533,7 @@ HRESULT BundleInstaller::InstallBundle(bool is_machine,
   ASSERT1(!app_bundle_);
   app_bundle_.Attach(app_bundle);
   app_bundle_->put_parentHWND(reinterpret_cast<ULONG_PTR>(parent_window_));
+  is_machine_ = is_machine;
 
   observer_ = observer;
 
@@ -751,7 +755,23 @@ HRESULT BundleInstaller::HandleInitState() {
     if (FAILED(hr)) {
       return hr;
     }
+
+    CComBSTR app_id;
+    hr = app->get_appId(&app_id);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
     apps_.push_back(AdaptIApp(app));
+    app_ids_.push_back(CString(app_id));
+    app_names_.push_back(CString());
+  }
+
+  // The bundle has a session ID once it is initialized. Without one, the
+  // progress is always obtained from the COM server.
+  CComBSTR session_id;
+  if (SUCCEEDED(app_bundle_->get_sessionId(&session_id))) {
+    session_id_ = session_id;
   }
 
   ASSERT1(!apps_.empty());
@@ -773,18 +793,14 @@ HRESULT BundleInstaller::HandleProcessingState() {
   ASSERT1(!apps_.empty());
 
   for (size_t i = 0; i < apps_.size(); ++i) {
-    CurrentState current_state = STATE_INIT;
-    CComPtr<ICurrentState> icurrent_state;
-    const ComPtrIApp& app = apps_[i];
-    HRESULT hr = update3_utils::GetAppCurrentState(app,
-                                                   &current_state,
-                                                   &icurrent_state);
+    AppProgress progress;
+    HRESULT hr = GetAppProgress(i, &progress);
     if (FAILED(hr)) {
-      CORE_LOG(LE, (_T("[GetNextVersionState failed][0x%08x]"), hr));
+      CORE_LOG(LE, (_T("[GetAppProgress failed][0x%08x]"), hr));
       return hr;
     }
 
-    switch (current_state) {
+    switch (progress.state) {
       case STATE_INSTALL_COMPLETE:
       case STATE_NO_UPDATE:
       case STATE_ERROR:
@@ -795,26 +811,22 @@ HRESULT BundleInstaller::HandleProcessingState() {
         return S_OK;
       case STATE_UPDATE_AVAILABLE:
         return HandleUpdateAvailable();
-      case STATE_WAITING_TO_DOWNLOAD: {
-        CComBSTR app_id;
-        VERIFY_SUCCEEDED(app->get_appId(&app_id));
-        observer_->OnWaitingToDownload(app_id.m_str,
-                                       internal::GetAppDisplayName(app));
+      case STATE_WAITING_TO_DOWNLOAD:
+        observer_->OnWaitingToDownload(app_ids_[i], GetAppName(i));
         return S_OK;
-      }
       case STATE_RETRYING_DOWNLOAD:
         ASSERT(false, (_T("Unsupported")));
         return S_OK;  // Keep checking in order to be forwards compatible.
       case STATE_DOWNLOADING:
       case STATE_DOWNLOAD_COMPLETE:
-        return NotifyDownloadProgress(app, icurrent_state);
+        return NotifyDownloadProgress(i, progress);
       case STATE_EXTRACTING:
       case STATE_APPLYING_DIFFERENTIAL_PATCH:
       case STATE_READY_TO_INSTALL:
       case STATE_WAITING_TO_INSTALL:
-        return NotifyWaitingToInstall(app);
+        return NotifyWaitingToInstall(i);
       case STATE_INSTALLING:
-        return NotifyInstallProgress(app, icurrent_state);
+        return NotifyInstallProgress(i, progress);
       case STATE_PAUSED:
         ASSERT(false, (_T("Unsupported")));
         return S_OK;  // Keep checking in order to be forwards compatible.
@@ -835,6 +847,79 @@ HRESULT BundleInstaller::HandleProcessingState() {
   return NotifyBundleInstallComplete();
 }
 
+HRESULT BundleInstaller::GetAppProgress(size_t index, AppProgress* progress) {
+  ASSERT1(index < apps_.size());
+  ASSERT1(progress);
+
+  // The worker creates the table when the first app changes state.
+  if (!progress_table_.is_open() && !session_id_.IsEmpty()) {
+    progress_table_.Open(is_machine_, session_id_);
+  }
+
+  GUID app_guid = GUID_NULL;
+  if (SUCCEEDED(StringToGuidSafe(app_ids_[index], &app_guid)) &&
+      progress_table_.Read(app_guid, progress)) {
+    ++metric_client_progress_table_reads;
+    return S_OK;
+  }
+
+  ++metric_client_progress_com_reads;
+
+  CurrentState current_state = STATE_INIT;
+  CComPtr<ICurrentState> icurrent_state;
+  HRESULT hr = update3_utils::GetAppCurrentState(apps_[index],
+                                                 &current_state,
+                                                 &icurrent_state);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *progress = AppProgress();
+  progress->app_guid = app_guid;
+  progress->state = current_state;
+
+  ULONG bytes = 0;
+  ULONG bytes_total = 0;
+  if (SUCCEEDED(icurrent_state->get_bytesDownloaded(&bytes)) &&
+      SUCCEEDED(icurrent_state->get_totalBytesToDownload(&bytes_total))) {
+    progress->bytes_downloaded = bytes;
+    progress->total_bytes_to_download = bytes_total;
+  }
+
+  LONG time_remaining_ms = kCurrentStateProgressUnknown;
+  if (SUCCEEDED(icurrent_state->get_downloadTimeRemainingMs(
+          &time_remaining_ms))) {
+    progress->download_time_remaining_ms = time_remaining_ms;
+  }
+
+  ULONGLONG next_retry_time = 0;
+  if (SUCCEEDED(icurrent_state->get_nextRetryTime(&next_retry_time))) {
+    progress->next_download_retry_time = next_retry_time;
+  }
+
+  LONG percentage = kCurrentStateProgressUnknown;
+  if (SUCCEEDED(icurrent_state->get_installProgress(&percentage))) {
+    progress->install_progress_percentage = percentage;
+  }
+
+  time_remaining_ms = kCurrentStateProgressUnknown;
+  if (SUCCEEDED(icurrent_state->get_installTimeRemainingMs(
+          &time_remaining_ms))) {
+    progress->install_time_remaining_ms = time_remaining_ms;
+  }
+
+  return S_OK;
+}
+
+CString BundleInstaller::GetAppName(size_t index) {
+  ASSERT1(index < apps_.size());
+
+  if (app_names_[index].IsEmpty()) {
+    app_names_[index] = internal::GetAppDisplayName(apps_[index]);
+  }
+  return app_names_[index];
+}
+
 HRESULT BundleInstaller::NotifyUpdateAvailable(IApp* app) {
   CORE_LOG(L3, (_T("[BundleInstaller::NotifyUpdateAvailable]")));
   ASSERT1(app);
@@ -865,29 +950,27 @@ HRESULT BundleInstaller::NotifyUpdateAvailable(IApp* app) {
   return S_OK;
 }
 
-HRESULT BundleInstaller::NotifyDownloadProgress(IApp* app,
-                                                ICurrentState* icurrent_state) {
+HRESULT BundleInstaller::NotifyDownloadProgress(size_t index,
+                                                const AppProgress& progress) {
   CORE_LOG(L3, (_T("[BundleInstaller::NotifyDownloadProgress]")));
-  ASSERT1(icurrent_state);
+  ASSERT1(index < apps_.size());
   ASSERT1(observer_);
 
   int time_remaining_ms = kCurrentStateProgressUnknown;
   int percentage = 0;
   time64 next_retry_time = 0;
-  GetAppDownloadProgress(icurrent_state,
+  GetAppDownloadProgress(progress,
                          &time_remaining_ms,
                          &percentage,
                          &next_retry_time);
-  CComBSTR app_id;
-  VERIFY_SUCCEEDED(app->get_appId(&app_id));
 
   if (next_retry_time != 0) {
-    observer_->OnWaitingRetryDownload(app_id.m_str,
-                                      internal::GetAppDisplayName(app),
+    observer_->OnWaitingRetryDownload(app_ids_[index],
+                                      GetAppName(index),
                                       next_retry_time);
   } else {
-    observer_->OnDownloading(app_id.m_str,
-                             internal::GetAppDisplayName(app),
+    observer_->OnDownloading(app_ids_[index],
+                             GetAppName(index),
                              time_remaining_ms,
                              percentage);
   }
@@ -896,39 +979,33 @@ HRESULT BundleInstaller::NotifyDownloadProgress(IApp* app,
 
 // Starts the install unless the UI prevents the install from starting, in which
 // case it remains in the same state to be checked again next cycle.
-HRESULT BundleInstaller::NotifyWaitingToInstall(IApp* app) {
+HRESULT BundleInstaller::NotifyWaitingToInstall(size_t index) {
   CORE_LOG(L3, (_T("[BundleInstaller::NotifyWaitingToInstall]")));
-  ASSERT1(app);
+  ASSERT1(index < apps_.size());
   ASSERT1(observer_);
 
-  CComBSTR app_id;
-  VERIFY_SUCCEEDED(app->get_appId(&app_id));
-
   // can_start_install is ignored because download and install are no longer
   // discrete phases.
   bool can_start_install = false;
-  observer_->OnWaitingToInstall(app_id.m_str,
-                                internal::GetAppDisplayName(app),
+  observer_->OnWaitingToInstall(app_ids_[index],
+                                GetAppName(index),
                                 &can_start_install);
 
   return S_OK;
 }
 
-HRESULT BundleInstaller::NotifyInstallProgress(IApp* app,
-                                               ICurrentState* icurrent_state) {
+HRESULT BundleInstaller::NotifyInstallProgress(size_t index,
+                                               const AppProgress& progress) {
   CORE_LOG(L3, (_T("[BundleInstaller::NotifyInstallProgress]")));
-  ASSERT1(app);
-  ASSERT1(icurrent_state);
+  ASSERT1(index < apps_.size());
   ASSERT1(observer_);
 
   int time_remaining_ms = kCurrentStateProgressUnknown;
   int percentage = 0;
-  GetAppInstallProgress(icurrent_state, &time_remaining_ms, &percentage);
+  GetAppInstallProgress(progress, &time_remaining_ms, &percentage);
 
-  CComBSTR app_id;
-  VERIFY_SUCCEEDED(app->get_appId(&app_id));
-  observer_->OnInstalling(app_id.m_str,
-                          internal::GetAppDisplayName(app),
+  observer_->OnInstalling(app_ids_[index],
+                          GetAppName(index),
                           time_remaining_ms,
                           percentage);
   return S_OK;
@@ -1059,70 +1136,49 @@ HRESULT BundleInstaller::HandleUpdateCheckResults(int* num_updates) {
   return S_OK;
 }
 
-// Assumes icurrent_state represents an app in one of the downloading states.
+// Assumes progress represents an app in one of the downloading states.
 // TODO(omaha3): Since this method does not check the current state, it's
 // possible to be in Download Complete or later but not report 100%. The server
 // should ensure it reports 100% and 0 time in these cases.
-void BundleInstaller::GetAppDownloadProgress(ICurrentState* icurrent_state,
+void BundleInstaller::GetAppDownloadProgress(const AppProgress& progress,
                                              int* time_remaining_ms,
                                              int* percentage,
                                              time64* next_retry_time) {
-  ASSERT1(icurrent_state);
   ASSERT1(time_remaining_ms);
   ASSERT1(percentage);
+  ASSERT1(next_retry_time);
 
-  LONG local_time_remaining_ms = kCurrentStateProgressUnknown;
-  if (FAILED(icurrent_state->get_downloadTimeRemainingMs(
-          &local_time_remaining_ms))) {
-    local_time_remaining_ms = kCurrentStateProgressUnknown;
-  }
+  const uint64 bytes = progress.bytes_downloaded;
+  const uint64 bytes_total = progress.total_bytes_to_download;
 
   int local_percentage = 0;
-  ULONG bytes = 0;
-  ULONG bytes_total = 0;
-  if (FAILED(icurrent_state->get_bytesDownloaded(&bytes)) ||
-      FAILED(icurrent_state->get_totalBytesToDownload(&bytes_total))) {
-    local_percentage = 0;
-  } else {
+  if (bytes_total) {
     ASSERT1(bytes <= bytes_total);
     local_percentage = static_cast<int>(100ULL * bytes / bytes_total);
     ASSERT1(0 <= local_percentage && local_percentage <= 100);
   }
 
-
-  ULONGLONG local_next_retry_time = 0;
-  if (FAILED(icurrent_state->get_nextRetryTime(&local_next_retry_time))) {
-    local_next_retry_time = 0;
-  }
-
-  *time_remaining_ms = local_time_remaining_ms;
+  *time_remaining_ms = progress.download_time_remaining_ms;
   *percentage = local_percentage;
-  *next_retry_time = static_cast<time64>(local_next_retry_time);
+  *next_retry_time = static_cast<time64>(progress.next_download_retry_time);
 
   // TODO(omaha3): For now, this client treats extracting and patching as part
   // of downloading. Add UI support for these phases.
 
   CORE_LOG(L4, (_T("[AppDownloadProgress]")
-                _T("[bytes %u][bytes_total %u][percentage %d][ms %d]"),
+                _T("[bytes %llu][bytes_total %llu][percentage %d][ms %d]"),
                 bytes, bytes_total, *percentage, *time_remaining_ms));
 }
 
-void BundleInstaller::GetAppInstallProgress(ICurrentState* icurrent_state,
+void BundleInstaller::GetAppInstallProgress(const AppProgress& progress,
                                             int* time_remaining_ms,
                                             int* percentage) {
-  ASSERT1(icurrent_state);
   ASSERT1(time_remaining_ms);
   ASSERT1(percentage);
 
-  LONG local_time_remaining_ms = kCurrentStateProgressUnknown;
-  VERIFY_SUCCEEDED(
-      icurrent_state->get_installTimeRemainingMs(&local_time_remaining_ms));
-  LONG local_percentage = kCurrentStateProgressUnknown;
-  VERIFY_SUCCEEDED(icurrent_state->get_installProgress(&local_percentage));
-
-  ASSERT1(local_percentage <= 100);
-  *time_remaining_ms = local_time_remaining_ms;
-  *percentage = local_percentage;
+  ASSERT1(progress.install_progress_percentage <= 100);
+  *time_remaining_ms = progress.install_time_remaining_ms;
+  *percentage = progress.install_progress_percentage;
 
   CORE_LOG(L4, (_T("[AppInstallProgress][percentage %d][ms %d]"),
                 *percentage, *time_remaining_ms));
@@ -1192,6 +1248,9 @@ void BundleInstaller::Complete(const BundleCompletionInfo& bundle_info) {
 void BundleInstaller::ReleaseAppBundle() {
   CORE_LOG(L3, (_T("[ReleaseAppBundle]")));
   apps_.clear();
+  app_ids_.clear();
+  app_names_.clear();
+  progress_table_.Close();
   app_bundle_ = NULL;
 }
 
@@ -27,6 +27,7 @@
 #include "omaha/base/wtl_atlapp_wrapper.h"
 #include "goopdate/omaha3_idl.h"
 #include "omaha/client/install_progress_observer.h"
+#include "omaha/common/progress_table.h"
 
 namespace omaha {
 
@@ -162,22 +163,31 @@ class BundleInstaller
   // listening. Otherwise no effect.
   void StopListenToShutdownEvent(bool is_machine);
 
+  // Gets the state and the progress of the app at |index| from the progress
+  // table, which the worker updates without the COM server. The state is
+  // obtained from the COM server if the app is not in the table.
+  HRESULT GetAppProgress(size_t index, AppProgress* progress);
+
+  // Returns the display name of the app at |index|. The name is obtained from
+  // the COM server the first time.
+  CString GetAppName(size_t index);
+
   // These functions update the UI during HandleProcessingState().
   // TODO(omaha): Rename these to Notify*.
   HRESULT NotifyUpdateAvailable(IApp* app);
-  HRESULT NotifyDownloadProgress(IApp* app, ICurrentState* icurrent_state);
-  HRESULT NotifyWaitingToInstall(IApp* app);
-  HRESULT NotifyInstallProgress(IApp* app, ICurrentState* icurrent_state);
+  HRESULT NotifyDownloadProgress(size_t index, const AppProgress& progress);
+  HRESULT NotifyWaitingToInstall(size_t index);
+  HRESULT NotifyInstallProgress(size_t index, const AppProgress& progress);
   HRESULT NotifyBundleUpdateCheckOnlyComplete();
   HRESULT NotifyBundleInstallComplete();
 
   // Helper functions for the Notify* functions.
   HRESULT HandleUpdateCheckResults(int* num_updates);
-  void GetAppDownloadProgress(ICurrentState* icurrent_state,
+  void GetAppDownloadProgress(const AppProgress& progress,
                               int* time_remaining_ms,
                               int* percentage,
                               time64* next_retry_time);
-  void GetAppInstallProgress(ICurrentState* icurrent_state,
+  void GetAppInstallProgress(const AppProgress& progress,
                              int* time_remaining_ms,
                              int* percentage);
 
@@ -230,6 +240,17 @@ class BundleInstaller
   typedef CAdapt<ComPtrIApp> AdaptIApp;
   std::vector<AdaptIApp> apps_;
 
+  // The IDs and the display names of the apps in apps_, so that they are not
+  // obtained from the COM server on every poll. The names are empty until
+  // they are needed.
+  std::vector<CString> app_ids_;
+  std::vector<CString> app_names_;
+
+  // The progress table of app_bundle_, opened once the worker creates it.
+  ProgressTable progress_table_;
+  CString session_id_;
+  bool is_machine_;
+
   State state_;
   HRESULT result_;
   bool is_canceled_;
@@ -19,5 +19,7 @@ namespace omaha {
 
 DEFINE_METRIC_count(client_another_install_in_progress);
 DEFINE_METRIC_count(client_another_update_in_progress);
+DEFINE_METRIC_count(client_progress_table_reads);
+DEFINE_METRIC_count(client_progress_com_reads);
 
 }  // namespace omaha
@@ -32,6 +32,12 @@ DECLARE_METRIC_count(client_another_install_in_progress);
 // This metric was named worker_another_install_in_progress in Omaha 2.
 DECLARE_METRIC_count(client_another_update_in_progress);
 
+// How many times the state of an app was read from the progress table.
+DECLARE_METRIC_count(client_progress_table_reads);
+
+// How many times the state of an app was read from the COM server.
+DECLARE_METRIC_count(client_progress_com_reads);
+
 }  // namespace omaha
 
 #endif  // OMAHA_CLIENT_CLIENT_METRICS_H_
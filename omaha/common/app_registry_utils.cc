@@ -16,6 +16,7 @@
 #include "omaha/common/app_registry_utils.h"
 
 #include <memory>
+#include <vector>
 
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
@@ -32,6 +33,31 @@ namespace omaha {
 
 namespace app_registry_utils {
 
+namespace {
+
+// Returns the seconds since |install_time|, or 0 if the install time is not
+// valid.
+int ComputeInstallTimeDiffSec(DWORD install_time) {
+  const int now = Time64ToInt32(GetCurrent100NSTime());
+  if (0 != install_time &&
+      static_cast<DWORD>(now) >= install_time &&
+      INT_MAX >= static_cast<DWORD>(now) - install_time) {
+    return now - install_time;
+  }
+  return 0;
+}
+
+// Truncates day of install to the first day of that week.
+DWORD TruncateDayOfInstall(DWORD day_of_install) {
+  if (day_of_install == -1) {
+    return day_of_install;
+  }
+  const int kDaysInWeek = 7;
+  return day_of_install / kDaysInWeek * kDaysInWeek;
+}
+
+}  // namespace
+
 CString GetAppClientsKey(bool is_machine, const CString& app_guid) {
   return AppendRegKeyPath(
       ConfigManager::Instance()->registry_clients(is_machine),
@@ -387,12 +413,11 @@ HRESULT GetNumClients(bool is_machine, size_t* num_clients) {
 // Reads pv value from Clients key.
 void GetAppVersion(bool is_machine, const CString& app_id, CString* pv) {
   ASSERT1(pv);
-  RegKey key;
-  CString key_name = GetAppClientsKey(is_machine, app_id);
-  HRESULT hr = key.Open(key_name, KEY_READ);
-  if (SUCCEEDED(hr)) {
-    key.GetValue(kRegValueProductVersion, pv);
-  }
+
+  // Unlike the static RegKey::GetValue, GetValues leaves |pv| unchanged if the
+  // value does not exist.
+  RegKey::ValueRequest request = {kRegValueProductVersion, REG_SZ, pv, S_OK};
+  RegKey::GetValues(GetAppClientsKey(is_machine, app_id), &request, 1);
 }
 
 void GetAppName(bool is_machine, const CString& app_id, CString* name) {
@@ -432,32 +457,41 @@ void GetClientStateData(bool is_machine,
                         Cohort* cohort,
                         int* install_time_diff_sec,
                         int* day_of_install) {
-  RegKey key;
+  const CString key_name = GetAppClientStateKey(is_machine, app_id);
 
-  CString key_name = GetAppClientStateKey(is_machine, app_id);
-  HRESULT hr = key.Open(key_name, KEY_READ);
-  if (FAILED(hr)) {
-    return;
+  // The values of the ClientState key are read in one pass over the key.
+  DWORD install_time(0);
+  DWORD install_day(0);
+  const RegKey::ValueRequest requests[] = {
+    {kRegValueProductVersion, REG_SZ, pv, S_OK},
+    {kRegValueAdditionalParams, REG_SZ, ap, S_OK},
+    {kRegValueLanguage, REG_SZ, lang, S_OK},
+    {kRegValueBrandCode, REG_SZ, brand_code, S_OK},
+    {kRegValueClientId, REG_SZ, client_id, S_OK},
+    {kRegValueInstallationId, REG_SZ, iid, S_OK},
+    {kRegValueInstallTimeSec,
+     REG_DWORD,
+     install_time_diff_sec ? &install_time : NULL,
+     S_OK},
+    {kRegValueDayOfInstall,
+     REG_DWORD,
+     day_of_install ? &install_day : NULL,
+     S_OK},
+  };
+
+  std::vector<RegKey::ValueRequest> values;
+  for (size_t i = 0; i != arraysize(requests); ++i) {
+    if (requests[i].value) {
+      values.push_back(requests[i]);
+    }
   }
 
-  if (pv) {
-    key.GetValue(kRegValueProductVersion, pv);
-  }
-  if (ap) {
-    key.GetValue(kRegValueAdditionalParams, ap);
-  }
-  if (lang) {
-    key.GetValue(kRegValueLanguage, lang);
-  }
-  if (brand_code) {
-    key.GetValue(kRegValueBrandCode, brand_code);
-  }
-  if (client_id) {
-    key.GetValue(kRegValueClientId, client_id);
-  }
-  if (iid) {
-    key.GetValue(kRegValueInstallationId, iid);
+  if (FAILED(RegKey::GetValues(key_name,
+                               values.empty() ? NULL : &values.front(),
+                               values.size()))) {
+    return;
   }
+
   if (experiment_labels) {
     *experiment_labels = ExperimentLabels::ReadRegistry(is_machine, app_id);
   }
@@ -465,59 +499,35 @@ void GetClientStateData(bool is_machine,
     ReadCohort(is_machine, app_id, cohort);
   }
   if (install_time_diff_sec) {
-    *install_time_diff_sec = GetInstallTimeDiffSec(is_machine, app_id);
+    *install_time_diff_sec = ComputeInstallTimeDiffSec(install_time);
   }
 
   if (day_of_install) {
-    DWORD install_day(0);
-    GetDayOfInstall(is_machine, app_id, &install_day);
-    *day_of_install = static_cast<int>(install_day);
+    *day_of_install = static_cast<int>(TruncateDayOfInstall(install_day));
   }
 }
 
 int GetInstallTimeDiffSec(bool is_machine, const CString& app_id) {
-  RegKey key;
-
-  CString key_name = GetAppClientStateKey(is_machine, app_id);
-  HRESULT hr = key.Open(key_name, KEY_READ);
-  if (FAILED(hr)) {
-    return 0;
-  }
-
   DWORD install_time(0);
-  int install_time_diff_sec(0);
-  if (SUCCEEDED(key.GetValue(kRegValueInstallTimeSec, &install_time))) {
-    const int now = Time64ToInt32(GetCurrent100NSTime());
-    if (0 != install_time &&
-        static_cast<DWORD>(now) >= install_time &&
-        INT_MAX >= static_cast<DWORD>(now) - install_time) {
-      install_time_diff_sec = now - install_time;
-    }
+  if (FAILED(RegKey::GetValue(GetAppClientStateKey(is_machine, app_id),
+                              kRegValueInstallTimeSec,
+                              &install_time))) {
+    return 0;
   }
 
-  return install_time_diff_sec;
+  return ComputeInstallTimeDiffSec(install_time);
 }
 
 HRESULT GetDayOfInstall(
     bool is_machine, const CString& app_id, DWORD* day_of_install) {
-  RegKey key;
-
-  CString key_name = GetAppClientStateKey(is_machine, app_id);
-  HRESULT hr = key.Open(key_name, KEY_READ);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  hr = key.GetValue(kRegValueDayOfInstall, day_of_install);
+  HRESULT hr = RegKey::GetValue(GetAppClientStateKey(is_machine, app_id),
+                                kRegValueDayOfInstall,
+                                day_of_install);
   if (FAILED(hr)) {
     return hr;
   }
 
-  if (*day_of_install != -1) {
-    // Truncate day of install to the first day of that week.
-    const int kDaysInWeek = 7;
-    *day_of_install = *day_of_install / kDaysInWeek * kDaysInWeek;
-  }
+  *day_of_install = TruncateDayOfInstall(*day_of_install);
   return S_OK;
 }
 
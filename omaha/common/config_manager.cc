@@ -24,6 +24,8 @@
 #include <atlsecurity.h>
 #include <atltime.h>
 #include <math.h>
+#include <algorithm>
+#include <set>
 #include "base/rand_util.h"
 #include "omaha/base/app_util.h"
 #include "omaha/base/constants.h"
@@ -285,6 +287,378 @@ void GetPolicyString(const TCHAR* policy_name, CString* out) {
   }
 }
 
+// The Resolve functions below aggregate a policy value over `policies`, which
+// are in order of priority. They are called once for each value when a
+// PolicySnapshot is built, and also when the caller asks for the
+// IPolicyStatusValue.
+
+void ResolveLastCheckPeriodSec(const PolicyManagers& policies,
+                               PolicyValue<SecondsMinutes>* v) {
+  ASSERT1(v);
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    DWORD minutes = 0;
+    if (SUCCEEDED(policies[i]->GetLastCheckPeriodMinutes(&minutes))) {
+      const DWORD policy_period_sec =
+          minutes * 60ULL > INT_MAX ? INT_MAX : minutes * 60;
+      v->Update(policies[i]->IsManaged(),
+                policies[i]->source(),
+                {policy_period_sec});
+    }
+  }
+}
+
+int ResolvePackageCacheSizeLimitMBytes(
+    const PolicyManagers& policies,
+    IPolicyStatusValue** policy_status_value) {
+  DWORD kDefaultCacheStorageLimit = 500;  // 500 MB
+  DWORD kMaxCacheStorageLimit = 5000;     // 5 GB
+
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    DWORD cache_size_limit = 0;
+    HRESULT hr = policies[i]->GetPackageCacheSizeLimitMBytes(
+        &cache_size_limit);
+
+    if (SUCCEEDED(hr)) {
+      if (cache_size_limit <= kMaxCacheStorageLimit && cache_size_limit > 0) {
+        v.Update(policies[i]->IsManaged(),
+                 policies[i]->source(),
+                 cache_size_limit);
+      }
+    }
+  }
+
+  v.UpdateFinal(kDefaultCacheStorageLimit, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetPackageCacheSizeLimitMBytes][%s]"), v.ToString()));
+
+  return v.value();
+}
+
+int ResolvePackageCacheExpirationTimeDays(
+    const PolicyManagers& policies,
+    IPolicyStatusValue** policy_status_value) {
+  DWORD kDefaultCacheLifeTimeInDays = 180;  // 180 days.
+  DWORD kMaxCacheLifeTimeInDays = 1800;     // Roughly 5 years.
+
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    DWORD cache_life_limit = 0;
+    HRESULT hr = policies[i]->GetPackageCacheExpirationTimeDays(
+        &cache_life_limit);
+
+    if (SUCCEEDED(hr)) {
+      if (cache_life_limit <= kMaxCacheLifeTimeInDays && cache_life_limit > 0) {
+        v.Update(policies[i]->IsManaged(),
+                 policies[i]->source(),
+                 cache_life_limit);
+      }
+    }
+  }
+
+  v.UpdateFinal(kDefaultCacheLifeTimeInDays, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetPackageCacheExpirationTimeDays][%s]"), v.ToString()));
+
+  return v.value();
+}
+
+int ResolveMaxConcurrentInstalls(const PolicyManagers& policies) {
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    DWORD max_concurrent_installs = 0;
+    HRESULT hr = policies[i]->GetMaxConcurrentInstalls(
+        &max_concurrent_installs);
+
+    if (SUCCEEDED(hr) && max_concurrent_installs > 0) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               std::min(max_concurrent_installs,
+                        static_cast<DWORD>(kMaxConcurrentInstallsLimit)));
+    }
+  }
+
+  v.UpdateFinal(kDefaultMaxConcurrentInstalls, NULL);
+
+  OPT_LOG(L5, (_T("[GetMaxConcurrentInstalls][%s]"), v.ToString()));
+
+  return v.value();
+}
+
+// Resolves one of the proxy policies, which have no local default value.
+HRESULT ResolveProxyPolicy(
+    const PolicyManagers& policies,
+    HRESULT (PolicyManagerInterface::*get_policy)(CString*),
+    const TCHAR* policy_name,
+    CString* policy,
+    IPolicyStatusValue** policy_status_value) {
+  ASSERT1(get_policy);
+  ASSERT1(policy_name);
+  ASSERT1(policy);
+
+  PolicyValue<CString> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    CString value;
+    HRESULT hr = (policies[i].get()->*get_policy)(&value);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(), policies[i]->source(), value);
+    }
+  }
+
+  if (v.source().IsEmpty()) {
+    // No managed source had a value set for this policy. There is no local
+    // default value for this policy. So we return failure.
+    return E_FAIL;
+  }
+
+  v.UpdateFinal(CString(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[%s][%s]"), policy_name, v.ToString()));
+
+  *policy = v.value();
+  return S_OK;
+}
+
+HRESULT ResolveForceInstallApps(const PolicyManagers& policies,
+                                bool is_machine,
+                                std::vector<CString>* app_ids,
+                                IPolicyStatusValue** policy_status_value) {
+  ASSERT1(app_ids);
+
+  PolicyValue<std::vector<CString>> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    std::vector<CString> t;
+    HRESULT hr = policies[i]->GetForceInstallApps(is_machine, &t);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(), policies[i]->source(), t);
+    }
+  }
+
+  if (v.source().IsEmpty()) {
+    // No managed source had a value set for this policy. There is no local
+    // default value for this policy. So we return failure.
+    return E_FAIL;
+  }
+
+  v.UpdateFinal(std::vector<CString>(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetForceInstallApps][is_machine][%d][%s]"), is_machine,
+               v.ToString()));
+
+  *app_ids = v.value();
+  return S_OK;
+}
+
+DWORD ResolveEffectivePolicyForAppInstalls(
+    const PolicyManagers& policies,
+    const GUID& app_guid,
+    IPolicyStatusValue** policy_status_value) {
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    DWORD effective_policy = kPolicyDisabled;
+    HRESULT hr = policies[i]->GetEffectivePolicyForAppInstalls(
+        app_guid,
+        &effective_policy);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               effective_policy);
+    }
+  }
+
+  v.UpdateFinal(kInstallPolicyDefault, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetEffectivePolicyForAppInstalls][%s][%s]"),
+               GuidToString(app_guid), v.ToString()));
+
+  return v.value();
+}
+
+DWORD ResolveEffectivePolicyForAppUpdates(
+    const PolicyManagers& policies,
+    const GUID& app_guid,
+    IPolicyStatusValue** policy_status_value) {
+  PolicyValue<DWORD> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    DWORD effective_policy = kPolicyDisabled;
+    HRESULT hr = policies[i]->GetEffectivePolicyForAppUpdates(
+        app_guid,
+        &effective_policy);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               effective_policy);
+    }
+  }
+
+  v.UpdateFinal(kUpdatePolicyDefault, policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetEffectivePolicyForAppUpdates][%s][%s]"),
+               GuidToString(app_guid), v.ToString()));
+
+  return v.value();
+}
+
+CString ResolveTargetChannel(const PolicyManagers& policies,
+                             const GUID& app_guid,
+                             IPolicyStatusValue** policy_status_value) {
+  PolicyValue<CString> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    CString target_channel;
+    HRESULT hr = policies[i]->GetTargetChannel(app_guid, &target_channel);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               target_channel);
+    }
+  }
+
+  v.UpdateFinal(CString(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetTargetChannel][%s][%s]"),
+               GuidToString(app_guid), v.ToString()));
+  return v.value();
+}
+
+CString ResolveTargetVersionPrefix(const PolicyManagers& policies,
+                                   const GUID& app_guid,
+                                   IPolicyStatusValue** policy_status_value) {
+  PolicyValue<CString> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    CString target_version_prefix;
+    HRESULT hr = policies[i]->GetTargetVersionPrefix(app_guid,
+                                                     &target_version_prefix);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               target_version_prefix);
+    }
+  }
+
+  v.UpdateFinal(CString(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetTargetVersionPrefix][%s][%s]"),
+               GuidToString(app_guid), v.ToString()));
+
+  return v.value();
+}
+
+bool ResolveIsRollbackToTargetVersionAllowed(
+    const PolicyManagers& policies,
+    const GUID& app_guid,
+    IPolicyStatusValue** policy_status_value) {
+  PolicyValue<bool> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    bool rollback_allowed = false;
+    HRESULT hr = policies[i]->IsRollbackToTargetVersionAllowed(
+        app_guid,
+        &rollback_allowed);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               rollback_allowed);
+    }
+  }
+
+  v.UpdateFinal(false, policy_status_value);
+
+  OPT_LOG(L5, (_T("[IsRollbackToTargetVersionAllowed][%s][%s]"),
+               GuidToString(app_guid), v.ToString()));
+
+  return v.value();
+}
+
+// Resolves the times, but not whether the updates are suppressed now, since
+// the latter depends on the current time.
+HRESULT ResolveUpdatesSuppressedTimes(
+    const PolicyManagers& policies,
+    UpdatesSuppressedTimes* times,
+    IPolicyStatusValue** policy_status_value) {
+  ASSERT1(times);
+
+  PolicyValue<UpdatesSuppressedTimes> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    UpdatesSuppressedTimes t;
+    HRESULT hr = policies[i]->GetUpdatesSuppressedTimes(&t);
+    if (SUCCEEDED(hr)) {
+      v.Update(policies[i]->IsManaged(), policies[i]->source(), t);
+    }
+  }
+
+  if (v.source().IsEmpty()) {
+    // No managed source had a value set.
+    return E_FAIL;
+  }
+
+  // UpdatesSuppressedDurationMin is limited to 16 hours.
+  if (v.value().start_hour > 23 ||
+      v.value().start_min > 59 ||
+      v.value().duration_min > 16 * kMinPerHour) {
+    OPT_LOG(L5, (_T("[GetUpdatesSuppressedTimes][Out of bounds][%x][%x][%x]"),
+                 v.value().start_hour,
+                 v.value().start_min,
+                 v.value().duration_min));
+    return E_UNEXPECTED;
+  }
+
+  v.UpdateFinal(UpdatesSuppressedTimes(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetUpdatesSuppressedTimes][%s]"), v.ToString()));
+
+  *times = v.value();
+  return S_OK;
+}
+
+CString ResolveDownloadPreferenceGroupPolicy(
+    const PolicyManagers& policies,
+    IPolicyStatusValue** policy_status_value) {
+  PolicyValue<CString> v;
+
+  for (size_t i = 0; i != policies.size(); ++i) {
+    CString download_preference;
+    HRESULT hr = policies[i]->GetDownloadPreferenceGroupPolicy(
+        &download_preference);
+    if (SUCCEEDED(hr) && download_preference == kDownloadPreferenceCacheable) {
+      v.Update(policies[i]->IsManaged(),
+               policies[i]->source(),
+               download_preference);
+    }
+  }
+
+  v.UpdateFinal(CString(), policy_status_value);
+
+  OPT_LOG(L5, (_T("[GetDownloadPreferenceGroupPolicy][%s]"), v.ToString()));
+
+  return v.value();
+}
+
+AppPolicySnapshot ResolveAppPolicy(const PolicyManagers& policies,
+                                   const GUID& app_guid) {
+  AppPolicySnapshot app;
+  app.install_policy =
+      ResolveEffectivePolicyForAppInstalls(policies, app_guid, NULL);
+  app.update_policy =
+      ResolveEffectivePolicyForAppUpdates(policies, app_guid, NULL);
+  app.target_channel = ResolveTargetChannel(policies, app_guid, NULL);
+  app.target_version_prefix =
+      ResolveTargetVersionPrefix(policies, app_guid, NULL);
+  app.is_rollback_to_target_version_allowed =
+      ResolveIsRollbackToTargetVersionAllowed(policies, app_guid, NULL);
+  return app;
+}
+
 }  // namespace
 
 bool OmahaPolicyManager::IsManaged() {
@@ -359,6 +733,17 @@ HRESULT OmahaPolicyManager::GetPackageCacheExpirationTimeDays(
   return S_OK;
 }
 
+HRESULT OmahaPolicyManager::GetMaxConcurrentInstalls(
+    DWORD* max_concurrent_installs) {
+  if (!policy_.is_initialized || policy_.max_concurrent_installs == -1) {
+    return E_FAIL;
+  }
+
+  *max_concurrent_installs =
+      static_cast<DWORD>(policy_.max_concurrent_installs);
+  return S_OK;
+}
+
 HRESULT OmahaPolicyManager::GetProxyMode(CString* proxy_mode) {
   if (!policy_.is_initialized || policy_.proxy_mode.IsEmpty()) {
     return E_FAIL;
@@ -518,7 +903,9 @@ void ConfigManager::DeleteInstance() {
 ConfigManager::ConfigManager()
     : group_policy_manager_(new OmahaPolicyManager(_T("Group Policy"))),
       dm_policy_manager_(new OmahaPolicyManager(_T("Device Management"))),
-      are_cloud_policies_preferred_(false) {
+      are_cloud_policies_preferred_(false),
+      policy_snapshot_(std::make_shared<PolicySnapshot>()),
+      is_internal_user_(-1) {
   CString current_module_directory(app_util::GetCurrentModuleDirectory());
 
   CString path;
@@ -551,6 +938,7 @@ ConfigManager::ConfigManager()
   // under, we may reload the policies with the critical section lock. At the
   // moment, we reload the policies with the critical section lock for all User
   // installs and updates, as well as all Machine updates.
+  PublishDefaultPolicySnapshot();
   VERIFY1(SUCCEEDED(LoadPolicies(false)));
 }
 
@@ -659,63 +1047,29 @@ CString ConfigManager::GetTempDownloadDir() const {
     CORE_LOG(LW, (_T("[CreateDir failed][%s][0x%08x]"),
         temp_download_dir, hr));
   }
-  return temp_download_dir;
-}
-
-int ConfigManager::GetPackageCacheSizeLimitMBytes(
-    IPolicyStatusValue** policy_status_value) const {
-  DWORD kDefaultCacheStorageLimit = 500;  // 500 MB
-  DWORD kMaxCacheStorageLimit = 5000;     // 5 GB
-
-  PolicyValue<DWORD> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    DWORD cache_size_limit = 0;
-    HRESULT hr = policies_[i]->GetPackageCacheSizeLimitMBytes(
-        &cache_size_limit);
-
-    if (SUCCEEDED(hr)) {
-      if (cache_size_limit <= kMaxCacheStorageLimit && cache_size_limit > 0) {
-        v.Update(policies_[i]->IsManaged(),
-                 policies_[i]->source(),
-                 cache_size_limit);
-      }
-    }
-  }
-
-  v.UpdateFinal(kDefaultCacheStorageLimit, policy_status_value);
+  return temp_download_dir;
+}
 
-  OPT_LOG(L5, (_T("[GetPackageCacheSizeLimitMBytes][%s]"), v.ToString()));
+int ConfigManager::GetPackageCacheSizeLimitMBytes(
+    IPolicyStatusValue** policy_status_value) const {
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->package_cache_size_limit_mbytes;
+  }
 
-  return v.value();
+  return ResolvePackageCacheSizeLimitMBytes(snapshot->policies,
+                                            policy_status_value);
 }
 
 int ConfigManager::GetPackageCacheExpirationTimeDays(
     IPolicyStatusValue** policy_status_value) const {
-  DWORD kDefaultCacheLifeTimeInDays = 180;  // 180 days.
-  DWORD kMaxCacheLifeTimeInDays = 1800;     // Roughly 5 years.
-
-  PolicyValue<DWORD> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    DWORD cache_life_limit = 0;
-    HRESULT hr = policies_[i]->GetPackageCacheExpirationTimeDays(
-        &cache_life_limit);
-
-    if (SUCCEEDED(hr)) {
-      if (cache_life_limit <= kMaxCacheLifeTimeInDays && cache_life_limit > 0) {
-        v.Update(policies_[i]->IsManaged(),
-                 policies_[i]->source(),
-                 cache_life_limit);
-      }
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->package_cache_expiration_time_days;
   }
 
-  v.UpdateFinal(kDefaultCacheLifeTimeInDays, policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetPackageCacheExpirationTimeDays][%s]"), v.ToString()));
-
-  return v.value();
+  return ResolvePackageCacheExpirationTimeDays(snapshot->policies,
+                                               policy_status_value);
 }
 
 HRESULT ConfigManager::GetProxyMode(
@@ -723,28 +1077,19 @@ HRESULT ConfigManager::GetProxyMode(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(proxy_mode);
 
-  PolicyValue<CString> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    CString mode;
-    HRESULT hr = policies_[i]->GetProxyMode(&mode);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), mode);
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    if (SUCCEEDED(snapshot->proxy_mode_hr)) {
+      *proxy_mode = snapshot->proxy_mode;
     }
+    return snapshot->proxy_mode_hr;
   }
 
-  if (v.source().IsEmpty()) {
-    // No managed source had a value set for this policy. There is no local
-    // default value for this policy. So we return failure.
-    return E_FAIL;
-  }
-
-  v.UpdateFinal(CString(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetProxyMode][%s]"), v.ToString()));
-
-  *proxy_mode = v.value();
-  return S_OK;
+  return ResolveProxyPolicy(snapshot->policies,
+                            &PolicyManagerInterface::GetProxyMode,
+                            _T("GetProxyMode"),
+                            proxy_mode,
+                            policy_status_value);
 }
 
 HRESULT ConfigManager::GetProxyPacUrl(
@@ -752,28 +1097,19 @@ HRESULT ConfigManager::GetProxyPacUrl(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(proxy_pac_url);
 
-  PolicyValue<CString> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    CString pac_url;
-    HRESULT hr = policies_[i]->GetProxyPacUrl(&pac_url);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), pac_url);
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    if (SUCCEEDED(snapshot->proxy_pac_url_hr)) {
+      *proxy_pac_url = snapshot->proxy_pac_url;
     }
+    return snapshot->proxy_pac_url_hr;
   }
 
-  if (v.source().IsEmpty()) {
-    // No managed source had a value set for this policy. There is no local
-    // default value for this policy. So we return failure.
-    return E_FAIL;
-  }
-
-  v.UpdateFinal(CString(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetProxyPacUrl][%s]"), v.ToString()));
-
-  *proxy_pac_url = v.value();
-  return S_OK;
+  return ResolveProxyPolicy(snapshot->policies,
+                            &PolicyManagerInterface::GetProxyPacUrl,
+                            _T("GetProxyPacUrl"),
+                            proxy_pac_url,
+                            policy_status_value);
 }
 
 HRESULT ConfigManager::GetProxyServer(
@@ -781,28 +1117,19 @@ HRESULT ConfigManager::GetProxyServer(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(proxy_server);
 
-  PolicyValue<CString> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    CString server;
-    HRESULT hr = policies_[i]->GetProxyServer(&server);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), server);
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    if (SUCCEEDED(snapshot->proxy_server_hr)) {
+      *proxy_server = snapshot->proxy_server;
     }
+    return snapshot->proxy_server_hr;
   }
 
-  if (v.source().IsEmpty()) {
-    // No managed source had a value set for this policy. There is no local
-    // default value for this policy. So we return failure.
-    return E_FAIL;
-  }
-
-  v.UpdateFinal(CString(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetProxyServer][%s]"), v.ToString()));
-
-  *proxy_server = v.value();
-  return S_OK;
+  return ResolveProxyPolicy(snapshot->policies,
+                            &PolicyManagerInterface::GetProxyServer,
+                            _T("GetProxyServer"),
+                            proxy_server,
+                            policy_status_value);
 }
 
 HRESULT ConfigManager::GetForceInstallApps(
@@ -811,29 +1138,21 @@ HRESULT ConfigManager::GetForceInstallApps(
     IPolicyStatusValue** policy_status_value) const {
   ASSERT1(app_ids);
 
-  PolicyValue<std::vector<CString>> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    std::vector<CString> t;
-    HRESULT hr = policies_[i]->GetForceInstallApps(is_machine, &t);
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    const HRESULT hr = is_machine ? snapshot->machine_force_install_apps_hr :
+                                    snapshot->user_force_install_apps_hr;
     if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), t);
+      *app_ids = is_machine ? snapshot->machine_force_install_apps :
+                              snapshot->user_force_install_apps;
     }
+    return hr;
   }
 
-  if (v.source().IsEmpty()) {
-    // No managed source had a value set for this policy. There is no local
-    // default value for this policy. So we return failure.
-    return E_FAIL;
-  }
-
-  v.UpdateFinal(std::vector<CString>(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetForceInstallApps][is_machine][%d][%s]"), is_machine,
-               v.ToString()));
-
-  *app_ids = v.value();
-  return S_OK;
+  return ResolveForceInstallApps(snapshot->policies,
+                                 is_machine,
+                                 app_ids,
+                                 policy_status_value);
 }
 
 CString ConfigManager::GetMachineGoopdateInstallDirNoCreate() const {
@@ -956,11 +1275,20 @@ CPath ConfigManager::GetPolicyResponsesDir() const {
 #endif  // defined(HAS_DEVICE_MANAGEMENT)
 
 HRESULT ConfigManager::LoadPolicies(bool should_acquire_critical_section) {
-  HRESULT hr = LoadGroupPolicies(should_acquire_critical_section);
+  // The Group Policy critical section may be taken while loading the Group
+  // Policies, therefore `policy_lock_` is only taken afterwards.
+  return PublishLoadedPolicies(
+      LoadGroupPolicies(should_acquire_critical_section));
+}
+
+HRESULT ConfigManager::PublishLoadedPolicies(HRESULT hr) {
+  // The previous snapshot is kept if loading the policies fails.
   if (FAILED(hr)) {
     return hr;
   }
 
+  __mutexScope(policy_lock_);
+
   policies_.clear();
   if (are_cloud_policies_preferred_) {
     policies_.push_back(dm_policy_manager_);
@@ -970,12 +1298,19 @@ HRESULT ConfigManager::LoadPolicies(bool should_acquire_critical_section) {
     policies_.push_back(dm_policy_manager_);
   }
 
+  PublishPolicySnapshot();
   return hr;
 }
 
+void ConfigManager::PublishDefaultPolicySnapshot() {
+  __mutexScope(policy_lock_);
+  policies_.clear();
+  PublishPolicySnapshot();
+}
+
 HRESULT ConfigManager::LoadGroupPolicies(bool should_acquire_critical_section) {
   CachedOmahaPolicy group_policies;
-  ON_SCOPE_EXIT_OBJ(*group_policy_manager_, &OmahaPolicyManager::set_policy,
+  ON_SCOPE_EXIT_OBJ(*this, &ConfigManager::SetGroupPolicies,
                     ByRef(group_policies));
 
   HANDLE policy_critical_section = NULL;
@@ -1043,6 +1378,8 @@ HRESULT ConfigManager::LoadGroupPolicies(bool should_acquire_critical_section) {
   GetPolicyDword(kRegValueCacheSizeLimitMBytes,
                  &group_policies.cache_size_limit);
   GetPolicyDword(kRegValueCacheLifeLimitDays, &group_policies.cache_life_limit);
+  GetPolicyDword(kRegValueMaxConcurrentInstalls,
+                 &group_policies.max_concurrent_installs);
 
   GetPolicyDword(kRegValueUpdatesSuppressedStartHour,
                  &group_policies.updates_suppressed.start_hour);
@@ -1136,10 +1473,81 @@ HRESULT ConfigManager::LoadGroupPolicies(bool should_acquire_critical_section) {
   return S_OK;
 }
 
+void ConfigManager::SetGroupPolicies(const CachedOmahaPolicy& group_policies) {
+  __mutexScope(policy_lock_);
+  group_policy_manager_->set_policy(group_policies);
+}
+
 void ConfigManager::SetOmahaDMPolicies(const CachedOmahaPolicy& dm_policy) {
+  __mutexScope(policy_lock_);
   dm_policy_manager_->set_policy(dm_policy);
   REPORT_LOG(L1, (_T("[ConfigManager::SetOmahaDMPolicies][%s]"),
                   dm_policy.ToString()));
+  PublishPolicySnapshot();
+}
+
+void ConfigManager::PublishPolicySnapshot() {
+  std::shared_ptr<PolicySnapshot> snapshot(std::make_shared<PolicySnapshot>());
+  snapshot->version = policy_snapshot()->version + 1;
+
+  // The snapshot keeps its own copies of the policies, so that the policy
+  // managers can be updated while the snapshot is in use.
+  std::set<GUID, GUIDCompare> app_guids;
+  for (size_t i = 0; i != policies_.size(); ++i) {
+    const CachedOmahaPolicy policy(policies_[i]->policy());
+    snapshot->policies.push_back(std::make_shared<OmahaPolicyManager>(
+        policies_[i]->source(), policy));
+    for (const auto& app_settings : policy.application_settings) {
+      app_guids.insert(app_settings.first);
+    }
+  }
+
+  const PolicyManagers& policies = snapshot->policies;
+
+  PolicyValue<SecondsMinutes> last_check_period;
+  ResolveLastCheckPeriodSec(policies, &last_check_period);
+  snapshot->is_last_check_period_overridden =
+      !last_check_period.source().IsEmpty();
+  snapshot->last_check_period_source = last_check_period.source();
+  snapshot->last_check_period_sec = last_check_period.value().seconds;
+
+  snapshot->updates_suppressed_hr = ResolveUpdatesSuppressedTimes(
+      policies, &snapshot->updates_suppressed_times, NULL);
+  snapshot->download_preference =
+      ResolveDownloadPreferenceGroupPolicy(policies, NULL);
+  snapshot->package_cache_size_limit_mbytes =
+      ResolvePackageCacheSizeLimitMBytes(policies, NULL);
+  snapshot->package_cache_expiration_time_days =
+      ResolvePackageCacheExpirationTimeDays(policies, NULL);
+  snapshot->max_concurrent_installs = ResolveMaxConcurrentInstalls(policies);
+
+  snapshot->proxy_mode_hr = ResolveProxyPolicy(
+      policies, &PolicyManagerInterface::GetProxyMode, _T("GetProxyMode"),
+      &snapshot->proxy_mode, NULL);
+  snapshot->proxy_pac_url_hr = ResolveProxyPolicy(
+      policies, &PolicyManagerInterface::GetProxyPacUrl, _T("GetProxyPacUrl"),
+      &snapshot->proxy_pac_url, NULL);
+  snapshot->proxy_server_hr = ResolveProxyPolicy(
+      policies, &PolicyManagerInterface::GetProxyServer, _T("GetProxyServer"),
+      &snapshot->proxy_server, NULL);
+
+  snapshot->machine_force_install_apps_hr = ResolveForceInstallApps(
+      policies, true, &snapshot->machine_force_install_apps, NULL);
+  snapshot->user_force_install_apps_hr = ResolveForceInstallApps(
+      policies, false, &snapshot->user_force_install_apps, NULL);
+
+  // No policy manager has app-specific policies for GUID_NULL, so it resolves
+  // to the defaults which apply to all the other apps.
+  snapshot->default_app = ResolveAppPolicy(policies, GUID_NULL);
+  for (const GUID& app_guid : app_guids) {
+    snapshot->apps[app_guid] = ResolveAppPolicy(policies, app_guid);
+  }
+
+  OPT_LOG(L1, (_T("[ConfigManager::PublishPolicySnapshot][version %d]")
+               _T("[%Iu apps]"), snapshot->version, snapshot->apps.size()));
+
+  std::atomic_store(&policy_snapshot_,
+                    std::shared_ptr<const PolicySnapshot>(snapshot));
 }
 
 // Returns the override from the registry locations if present. Otherwise,
@@ -1158,8 +1566,10 @@ int ConfigManager::GetLastCheckPeriodSec(
     bool* is_overridden, IPolicyStatusValue** status_value_minutes) const {
   ASSERT1(is_overridden);
 
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
   PolicyValue<SecondsMinutes> v;
 
+  // The UpdateDev override is read each time, since it is not a policy.
   DWORD policy_period_sec = 0;
   if (SUCCEEDED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
                                  kRegValueLastCheckPeriodSec,
@@ -1170,30 +1580,37 @@ int ConfigManager::GetLastCheckPeriodSec(
       policy_period_sec = INT_MAX;
     }
     v.Update(true, _T("UpdateDev"), {policy_period_sec});
-  } else {
-    DWORD minutes = 0;
-    HRESULT hr = E_FAIL;
-    for (size_t i = 0; i != policies_.size(); ++i) {
-      hr = policies_[i]->GetLastCheckPeriodMinutes(&minutes);
-      if (SUCCEEDED(hr)) {
-        policy_period_sec = minutes * 60ULL > INT_MAX ? INT_MAX : minutes * 60;
-        v.Update(policies_[i]->IsManaged(),
-                 policies_[i]->source(),
-                 {policy_period_sec});
-      }
-    }
+  } else if (status_value_minutes) {
+    ResolveLastCheckPeriodSec(snapshot->policies, &v);
+  } else if (snapshot->is_last_check_period_overridden) {
+    v.Update(true,
+             snapshot->last_check_period_source,
+             {snapshot->last_check_period_sec});
   }
 
   *is_overridden = !v.source().IsEmpty();
-  policy_period_sec = IsInternalUser() ? kLastCheckPeriodInternalUserSec :
-                                         kLastCheckPeriodSec;
-  v.UpdateFinal({policy_period_sec}, status_value_minutes);
+  v.UpdateFinal({GetDefaultLastCheckPeriodSec()}, status_value_minutes);
 
   OPT_LOG(L5, (_T("[GetLastCheckPeriodSec][%s]"), v.ToString()));
 
   return v.value().seconds;
 }
 
+// IsInternalUser queries the computer name and the domain, which do not
+// change while the process runs, so it is only called the first time the
+// period is needed. The threads which race to call it get the same result.
+DWORD ConfigManager::GetDefaultLastCheckPeriodSec() const {
+  LONG is_internal_user = ::InterlockedCompareExchange(&is_internal_user_,
+                                                       -1,
+                                                       -1);
+  if (is_internal_user == -1) {
+    is_internal_user = IsInternalUser() ? 1 : 0;
+    ::InterlockedExchange(&is_internal_user_, is_internal_user);
+  }
+  return is_internal_user ? kLastCheckPeriodInternalUserSec :
+                            kLastCheckPeriodSec;
+}
+
 // All time values are in seconds.
 int ConfigManager::GetTimeSinceLastCheckedSec(bool is_machine) const {
   const uint32 now = Time64ToInt32(GetCurrent100NSTime());
@@ -1255,6 +1672,37 @@ bool ConfigManager::CanRetryNow(bool is_machine) const {
   return now >= retry_after || retry_after > now + kMaxRetryAfterSeconds;
 }
 
+CString ConfigManager::GetRequestEncoding(bool is_machine) const {
+  CString encoding;
+  if (SUCCEEDED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                                 kRegValueRequestEncoding,
+                                 &encoding))) {
+    CORE_LOG(L5, (_T("['RequestEncoding' override %s]"), encoding));
+    return encoding;
+  }
+
+  const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
+                                             USER_REG_UPDATE;
+  if (SUCCEEDED(RegKey::GetValue(reg_update_key,
+                                 kRegValueRequestEncoding,
+                                 &encoding))) {
+    return encoding;
+  }
+  return CString();
+}
+
+HRESULT ConfigManager::SetRequestEncoding(bool is_machine,
+                                          const CString& encoding) const {
+  const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
+                                             USER_REG_UPDATE;
+  if (encoding.IsEmpty()) {
+    HRESULT hr = RegKey::DeleteValue(reg_update_key, kRegValueRequestEncoding);
+    return hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) ||
+           hr == HRESULT_FROM_WIN32(ERROR_PATH_NOT_FOUND) ? S_OK : hr;
+  }
+  return RegKey::SetValue(reg_update_key, kRegValueRequestEncoding, encoding);
+}
+
 DEFINE_METRIC_integer(last_started_au);
 HRESULT ConfigManager::SetLastStartedAU(bool is_machine) const {
   const TCHAR* reg_update_key = is_machine ? MACHINE_REG_UPDATE:
@@ -1415,6 +1863,35 @@ int ConfigManager::GetAutoUpdateJitterMs() const {
   return (random_delay % kMaxJitterMs);
 }
 
+int ConfigManager::GetMaxConcurrentDownloads() const {
+  DWORD max_concurrent_downloads(0);
+  if (SUCCEEDED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                                 kRegValueMaxConcurrentDownloads,
+                                 &max_concurrent_downloads)) &&
+      max_concurrent_downloads > 0) {
+    return std::min(static_cast<int>(max_concurrent_downloads),
+                    kMaxConcurrentDownloadsLimit);
+  }
+
+  return kDefaultMaxConcurrentDownloads;
+}
+
+int ConfigManager::GetMaxConcurrentInstalls() const {
+  return policy_snapshot()->max_concurrent_installs;
+}
+
+int ConfigManager::GetMaxDownloadBytesPerSec() const {
+  DWORD max_download_bytes_per_sec(0);
+  if (SUCCEEDED(RegKey::GetValue(MACHINE_REG_UPDATE_DEV,
+                                 kRegValueMaxDownloadBytesPerSec,
+                                 &max_download_bytes_per_sec))) {
+    return max_download_bytes_per_sec > INT_MAX ?
+        INT_MAX : static_cast<int>(max_download_bytes_per_sec);
+  }
+
+  return 0;
+}
+
 // Overrides CodeRedCheckPeriodMs. Implements a lower bound value. Returns
 // INT_MAX if the registry value exceeds INT_MAX.
 int ConfigManager::GetCodeRedTimerIntervalMs() const {
@@ -1599,118 +2076,63 @@ bool ConfigManager::IsInternalUser() const {
 
 DWORD ConfigManager::GetEffectivePolicyForAppInstalls(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
-  PolicyValue<DWORD> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    DWORD effective_policy = kPolicyDisabled;
-    HRESULT hr = policies_[i]->GetEffectivePolicyForAppInstalls(
-        app_guid,
-        &effective_policy);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(),
-               policies_[i]->source(),
-               effective_policy);
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->GetAppPolicy(app_guid).install_policy;
   }
 
-  v.UpdateFinal(kInstallPolicyDefault, policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetEffectivePolicyForAppInstalls][%s][%s]"),
-               GuidToString(app_guid), v.ToString()));
-
-  return v.value();
+  return ResolveEffectivePolicyForAppInstalls(snapshot->policies,
+                                              app_guid,
+                                              policy_status_value);
 }
 
 DWORD ConfigManager::GetEffectivePolicyForAppUpdates(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
-  PolicyValue<DWORD> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    DWORD effective_policy = kPolicyDisabled;
-    HRESULT hr = policies_[i]->GetEffectivePolicyForAppUpdates(
-        app_guid,
-        &effective_policy);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(),
-               policies_[i]->source(),
-               effective_policy);
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->GetAppPolicy(app_guid).update_policy;
   }
 
-  v.UpdateFinal(kUpdatePolicyDefault, policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetEffectivePolicyForAppUpdates][%s][%s]"),
-               GuidToString(app_guid), v.ToString()));
-
-  return v.value();
+  return ResolveEffectivePolicyForAppUpdates(snapshot->policies,
+                                             app_guid,
+                                             policy_status_value);
 }
 
 CString ConfigManager::GetTargetChannel(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
-  PolicyValue<CString> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    CString target_channel;
-    HRESULT hr = policies_[i]->GetTargetChannel(app_guid, &target_channel);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(),
-               policies_[i]->source(),
-               target_channel);
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->GetAppPolicy(app_guid).target_channel;
   }
 
-  v.UpdateFinal(CString(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetTargetChannel][%s][%s]"),
-               GuidToString(app_guid), v.ToString()));
-  return v.value();
+  return ResolveTargetChannel(snapshot->policies,
+                              app_guid,
+                              policy_status_value);
 }
 
 CString ConfigManager::GetTargetVersionPrefix(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
-  PolicyValue<CString> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    CString target_version_prefix;
-    HRESULT hr = policies_[i]->GetTargetVersionPrefix(app_guid,
-                                                      &target_version_prefix);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(),
-               policies_[i]->source(),
-               target_version_prefix);
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->GetAppPolicy(app_guid).target_version_prefix;
   }
 
-  v.UpdateFinal(CString(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetTargetVersionPrefix][%s][%s]"),
-               GuidToString(app_guid), v.ToString()));
-
-  return v.value();
+  return ResolveTargetVersionPrefix(snapshot->policies,
+                                    app_guid,
+                                    policy_status_value);
 }
 
 bool ConfigManager::IsRollbackToTargetVersionAllowed(
     const GUID& app_guid, IPolicyStatusValue** policy_status_value) const {
-  PolicyValue<bool> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    bool rollback_allowed = false;
-    HRESULT hr = policies_[i]->IsRollbackToTargetVersionAllowed(
-        app_guid,
-        &rollback_allowed);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(),
-               policies_[i]->source(),
-               rollback_allowed);
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->GetAppPolicy(app_guid)
+        .is_rollback_to_target_version_allowed;
   }
 
-  v.UpdateFinal(false, policy_status_value);
-
-  OPT_LOG(L5, (_T("[IsRollbackToTargetVersionAllowed][%s][%s]"),
-               GuidToString(app_guid), v.ToString()));
-
-  return v.value();
+  return ResolveIsRollbackToTargetVersionAllowed(snapshot->policies,
+                                                 app_guid,
+                                                 policy_status_value);
 }
 
 HRESULT ConfigManager::GetUpdatesSuppressedTimes(
@@ -1720,35 +2142,22 @@ HRESULT ConfigManager::GetUpdatesSuppressedTimes(
   ASSERT1(times);
   ASSERT1(are_updates_suppressed);
 
-  PolicyValue<UpdatesSuppressedTimes> v;
-
-  HRESULT hr = E_FAIL;
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    UpdatesSuppressedTimes t;
-    hr = policies_[i]->GetUpdatesSuppressedTimes(&t);
-    if (SUCCEEDED(hr)) {
-      v.Update(policies_[i]->IsManaged(), policies_[i]->source(), t);
-    }
-  }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
 
-  if (v.source().IsEmpty()) {
-    // No managed source had a value set.
-    return E_FAIL;
+  UpdatesSuppressedTimes t;
+  HRESULT hr = S_OK;
+  if (!policy_status_value) {
+    hr = snapshot->updates_suppressed_hr;
+    t = snapshot->updates_suppressed_times;
+  } else {
+    hr = ResolveUpdatesSuppressedTimes(snapshot->policies,
+                                       &t,
+                                       policy_status_value);
   }
-
-  // UpdatesSuppressedDurationMin is limited to 16 hours.
-  if (v.value().start_hour > 23 ||
-      v.value().start_min > 59 ||
-      v.value().duration_min > 16 * kMinPerHour) {
-    OPT_LOG(L5, (_T("[GetUpdatesSuppressedTimes][Out of bounds][%x][%x][%x]"),
-                 v.value().start_hour,
-                 v.value().start_min,
-                 v.value().duration_min));
-    return E_UNEXPECTED;
+  if (FAILED(hr)) {
+    return hr;
   }
 
-  v.UpdateFinal(UpdatesSuppressedTimes(), policy_status_value);
-
   CTime now(CTime::GetCurrentTime());
   tm local = {};
   now.GetLocalTm(&local);
@@ -1757,19 +2166,17 @@ HRESULT ConfigManager::GetUpdatesSuppressedTimes(
   CTime start_updates_suppressed(local.tm_year + 1900,
                                  local.tm_mon + 1,
                                  local.tm_mday,
-                                 v.value().start_hour,
-                                 v.value().start_min,
+                                 t.start_hour,
+                                 t.start_min,
                                  local.tm_sec,
                                  local.tm_isdst);
-  CTimeSpan duration_updates_suppressed(0, 0, v.value().duration_min, 0);
+  CTimeSpan duration_updates_suppressed(0, 0, t.duration_min, 0);
   CTime end_updates_suppressed =
     start_updates_suppressed + duration_updates_suppressed;
   *are_updates_suppressed = now >= start_updates_suppressed &&
                             now <= end_updates_suppressed;
 
-  OPT_LOG(L5, (_T("[GetUpdatesSuppressedTimes][%s]"), v.ToString()));
-
-  *times = v.value();
+  *times = t;
   return S_OK;
 }
 
@@ -1850,24 +2257,13 @@ int ConfigManager::MaxCrashUploadsPerDay() const {
 
 CString ConfigManager::GetDownloadPreferenceGroupPolicy(
     IPolicyStatusValue** policy_status_value) const {
-  PolicyValue<CString> v;
-
-  for (size_t i = 0; i != policies_.size(); ++i) {
-    CString download_preference;
-    HRESULT hr = policies_[i]->GetDownloadPreferenceGroupPolicy(
-        &download_preference);
-    if (SUCCEEDED(hr) && download_preference == kDownloadPreferenceCacheable) {
-      v.Update(policies_[i]->IsManaged(),
-               policies_[i]->source(),
-               download_preference);
-    }
+  std::shared_ptr<const PolicySnapshot> snapshot(policy_snapshot());
+  if (!policy_status_value) {
+    return snapshot->download_preference;
   }
 
-  v.UpdateFinal(CString(), policy_status_value);
-
-  OPT_LOG(L5, (_T("[GetDownloadPreferenceGroupPolicy][%s]"), v.ToString()));
-
-  return v.value();
+  return ResolveDownloadPreferenceGroupPolicy(snapshot->policies,
+                                              policy_status_value);
 }
 
 #if defined(HAS_DEVICE_MANAGEMENT)
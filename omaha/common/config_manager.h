@@ -26,9 +26,11 @@
 #include <windows.h>
 #include <atlpath.h>
 #include <atlstr.h>
+#include <map>
 #include <memory>
 #include <vector>
 #include "base/basictypes.h"
+#include "gtest/gtest_prod.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
@@ -58,6 +60,7 @@ class PolicyManagerInterface {
   virtual HRESULT GetPackageCacheSizeLimitMBytes(DWORD* cache_size_limit) = 0;
   virtual HRESULT GetPackageCacheExpirationTimeDays(
       DWORD* cache_life_limit) = 0;
+  virtual HRESULT GetMaxConcurrentInstalls(DWORD* max_concurrent_installs) = 0;
   virtual HRESULT GetProxyMode(CString* proxy_mode) = 0;
   virtual HRESULT GetProxyPacUrl(CString* proxy_pac_url) = 0;
   virtual HRESULT GetProxyServer(CString* proxy_server) = 0;
@@ -79,6 +82,8 @@ class PolicyManagerInterface {
 class OmahaPolicyManager : public PolicyManagerInterface {
  public:
   explicit OmahaPolicyManager(const CString& source) : source_(source) {}
+  OmahaPolicyManager(const CString& source, const CachedOmahaPolicy& policy)
+      : source_(source), policy_(policy) {}
 
   CString source() override { return source_; }
 
@@ -90,6 +95,7 @@ class OmahaPolicyManager : public PolicyManagerInterface {
       CString* download_preference) override;
   HRESULT GetPackageCacheSizeLimitMBytes(DWORD* cache_size_limit) override;
   HRESULT GetPackageCacheExpirationTimeDays(DWORD* cache_life_limit) override;
+  HRESULT GetMaxConcurrentInstalls(DWORD* max_concurrent_installs) override;
   HRESULT GetProxyMode(CString* proxy_mode) override;
   HRESULT GetProxyPacUrl(CString* proxy_pac_url) override;
   HRESULT GetProxyServer(CString* proxy_server) override;
@@ -108,7 +114,7 @@ class OmahaPolicyManager : public PolicyManagerInterface {
                                            bool* rollback_allowed) override;
 
   void set_policy(const CachedOmahaPolicy& policy);
-  CachedOmahaPolicy policy() { return policy_; }
+  CachedOmahaPolicy policy() const { return policy_; }
 
  private:
   CString source_;
@@ -117,6 +123,65 @@ class OmahaPolicyManager : public PolicyManagerInterface {
   DISALLOW_COPY_AND_ASSIGN(OmahaPolicyManager);
 };
 
+typedef std::vector<std::shared_ptr<PolicyManagerInterface>> PolicyManagers;
+
+// The effective policies for one app, resolved over all the policy managers.
+struct AppPolicySnapshot {
+  DWORD install_policy = 0;
+  DWORD update_policy = 0;
+  CString target_channel;
+  CString target_version_prefix;
+  bool is_rollback_to_target_version_allowed = false;
+};
+
+// The policy values resolved over all the policy managers, in order of
+// priority. A snapshot is built each time the policies are loaded or set, and
+// is never modified after it is published. The ConfigManager getters read the
+// values from the current snapshot instead of querying each policy manager.
+struct PolicySnapshot {
+  // Incremented each time a snapshot is published.
+  int version = 0;
+
+  // Copies of the policy managers the snapshot is built from. These are used
+  // to build the IPolicyStatusValue objects, which report the source and the
+  // conflicts of each value.
+  PolicyManagers policies;
+
+  bool is_last_check_period_overridden = false;
+  CString last_check_period_source;
+  DWORD last_check_period_sec = 0;
+
+  HRESULT updates_suppressed_hr = E_FAIL;
+  UpdatesSuppressedTimes updates_suppressed_times;
+
+  CString download_preference;
+  int package_cache_size_limit_mbytes = 0;
+  int package_cache_expiration_time_days = 0;
+  int max_concurrent_installs = 0;
+
+  HRESULT proxy_mode_hr = E_FAIL;
+  CString proxy_mode;
+  HRESULT proxy_pac_url_hr = E_FAIL;
+  CString proxy_pac_url;
+  HRESULT proxy_server_hr = E_FAIL;
+  CString proxy_server;
+
+  HRESULT machine_force_install_apps_hr = E_FAIL;
+  std::vector<CString> machine_force_install_apps;
+  HRESULT user_force_install_apps_hr = E_FAIL;
+  std::vector<CString> user_force_install_apps;
+
+  // The effective policies of the apps which have app-specific policies in at
+  // least one policy manager. All other apps get `default_app`.
+  std::map<GUID, AppPolicySnapshot, GUIDCompare> apps;
+  AppPolicySnapshot default_app;
+
+  const AppPolicySnapshot& GetAppPolicy(const GUID& app_guid) const {
+    auto it = apps.find(app_guid);
+    return it != apps.end() ? it->second : default_app;
+  }
+};
+
 class ConfigManager {
  public:
   const TCHAR* user_registry_clients() const { return USER_REG_CLIENTS; }
@@ -297,6 +362,13 @@ class ConfigManager {
 
   CachedOmahaPolicy dm_policy() { return dm_policy_manager_->policy(); }
 
+  // Returns the policy snapshot which is current at the time of the call. The
+  // snapshot remains valid for as long as the caller holds it, even if the
+  // policies are reloaded in the meantime.
+  std::shared_ptr<const PolicySnapshot> policy_snapshot() const {
+    return std::atomic_load(&policy_snapshot_);
+  }
+
   // Returns the time interval between update checks in seconds.
   // 0 indicates updates are disabled.
   int GetLastCheckPeriodSec(bool* is_overridden) const;
@@ -314,6 +386,11 @@ class ConfigManager {
   HRESULT SetRetryAfterTime(bool is_machine, DWORD time) const;
   bool CanRetryNow(bool is_machine) const;
 
+  // Functions that deal with the X-Request-Encoding header from the server.
+  // The UpdateDev value overrides the value sent by the server.
+  CString GetRequestEncoding(bool is_machine) const;
+  HRESULT SetRequestEncoding(bool is_machine, const CString& encoding) const;
+
   // Gets and sets the last time a successful server update check was made.
   DWORD GetLastCheckedTime(bool is_machine) const;
   HRESULT SetLastCheckedTime(bool is_machine, DWORD time) const;
@@ -340,6 +417,19 @@ class ConfigManager {
   // by UpdateDev settings.
   int GetAutoUpdateJitterMs() const;
 
+  // Returns the maximum number of apps that can download at the same time.
+  // The range of the returned value is [1, kMaxConcurrentDownloadsLimit].
+  int GetMaxConcurrentDownloads() const;
+
+  // Returns the maximum number of installers that can run at the same time,
+  // from the MaxConcurrentInstalls policy. The range of the returned value is
+  // [1, kMaxConcurrentInstallsLimit].
+  int GetMaxConcurrentInstalls() const;
+
+  // Returns the maximum aggregate download rate in bytes per second. Zero
+  // means that the download rate is not limited.
+  int GetMaxDownloadBytesPerSec() const;
+
   // Code Red check interval functions.
   int GetCodeRedTimerIntervalMs() const;
   time64 GetTimeSinceLastCodeRedCheckMs(bool is_machine) const;
@@ -478,6 +568,25 @@ class ConfigManager {
   // config queries.
   HRESULT LoadGroupPolicies(bool should_acquire_critical_section);
 
+  // Sets the Group Policies on the Group Policy manager.
+  void SetGroupPolicies(const CachedOmahaPolicy& group_policies);
+
+  // Publishes a snapshot without any policy managers, which has the default
+  // policies. The defaults apply until the policies are loaded successfully.
+  void PublishDefaultPolicySnapshot();
+
+  // Sets up the policy managers in order of priority and publishes their
+  // snapshot if loading the Group Policies returned `hr`. Returns `hr`.
+  HRESULT PublishLoadedPolicies(HRESULT hr);
+
+  // Resolves the values of the policy managers in `policies_` into a new
+  // PolicySnapshot and publishes it. Must be called with `policy_lock_` held.
+  void PublishPolicySnapshot();
+
+  // Returns the time interval between update checks in seconds when it is
+  // not overridden. It is shorter for the internal users.
+  DWORD GetDefaultLastCheckPeriodSec() const;
+
   static LLock lock_;
   static ConfigManager* config_manager_;
 
@@ -485,11 +594,22 @@ class ConfigManager {
 
   bool is_running_from_official_user_dir_;
   bool is_running_from_official_machine_dir_;
-  std::vector<std::shared_ptr<PolicyManagerInterface>> policies_;  // NOLINT
-  std::shared_ptr<OmahaPolicyManager> group_policy_manager_;       // NOLINT
-  std::shared_ptr<OmahaPolicyManager> dm_policy_manager_;          // NOLINT
+  std::vector<std::shared_ptr<OmahaPolicyManager>> policies_;  // NOLINT
+  std::shared_ptr<OmahaPolicyManager> group_policy_manager_;   // NOLINT
+  std::shared_ptr<OmahaPolicyManager> dm_policy_manager_;      // NOLINT
   bool are_cloud_policies_preferred_;
 
+  // Serializes the updates of the policy managers and the snapshot builds.
+  // The readers of the snapshot do not take this lock.
+  LLock policy_lock_;
+  std::shared_ptr<const PolicySnapshot> policy_snapshot_;
+
+  // -1 until GetDefaultLastCheckPeriodSec calls IsInternalUser, and then the
+  // result of IsInternalUser.
+  mutable volatile LONG is_internal_user_;
+
+  FRIEND_TEST(ConfigManagerTest, PolicySnapshot_DefaultsWhenLoadFails);
+
   DISALLOW_COPY_AND_ASSIGN(ConfigManager);
 };
 
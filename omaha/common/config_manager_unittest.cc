@@ -13,6 +13,7 @@
 // limitations under the License.
 // ========================================================================
 
+#include <atlbase.h>
 #include <atltime.h>
 #include <limits.h>
 #include <tuple>
@@ -1956,6 +1957,28 @@ TEST_P(ConfigManagerTest, GetPackageCacheExpirationTimeDays_Override_Valid) {
             cm_->GetPackageCacheExpirationTimeDays(NULL));
 }
 
+TEST_P(ConfigManagerTest, GetMaxConcurrentInstalls_Default) {
+  EXPECT_EQ(kDefaultMaxConcurrentInstalls, cm_->GetMaxConcurrentInstalls());
+}
+
+TEST_P(ConfigManagerTest, GetMaxConcurrentInstalls_Override_TooBig) {
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueMaxConcurrentInstalls, 100));
+  EXPECT_EQ(IsDomain() ? kMaxConcurrentInstallsLimit :
+                         kDefaultMaxConcurrentInstalls,
+            cm_->GetMaxConcurrentInstalls());
+}
+
+TEST_P(ConfigManagerTest, GetMaxConcurrentInstalls_Override_TooSmall) {
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueMaxConcurrentInstalls, 0));
+  EXPECT_EQ(kDefaultMaxConcurrentInstalls, cm_->GetMaxConcurrentInstalls());
+}
+
+TEST_P(ConfigManagerTest, GetMaxConcurrentInstalls_Override_Valid) {
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueMaxConcurrentInstalls, 3));
+  EXPECT_EQ(IsDomain() ? 3 : kDefaultMaxConcurrentInstalls,
+            cm_->GetMaxConcurrentInstalls());
+}
+
 TEST_P(ConfigManagerTest, LastCheckedTime) {
   DWORD time = 500;
   EXPECT_SUCCEEDED(cm_->SetLastCheckedTime(true, time));
@@ -1995,6 +2018,25 @@ TEST_P(ConfigManagerTest, CanRetryNow) {
   EXPECT_TRUE(cm_->CanRetryNow(false));
 }
 
+TEST_P(ConfigManagerTest, RequestEncoding) {
+  EXPECT_STREQ(_T(""), cm_->GetRequestEncoding(true));
+  EXPECT_STREQ(_T(""), cm_->GetRequestEncoding(false));
+
+  EXPECT_SUCCEEDED(cm_->SetRequestEncoding(true, _T("gzip")));
+  EXPECT_STREQ(_T("gzip"), cm_->GetRequestEncoding(true));
+  EXPECT_STREQ(_T(""), cm_->GetRequestEncoding(false));
+
+  EXPECT_SUCCEEDED(cm_->SetRequestEncoding(true, _T("")));
+  EXPECT_STREQ(_T(""), cm_->GetRequestEncoding(true));
+  EXPECT_SUCCEEDED(cm_->SetRequestEncoding(true, _T("")));
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                                    kRegValueRequestEncoding,
+                                    _T("deflate")));
+  EXPECT_SUCCEEDED(cm_->SetRequestEncoding(false, _T("gzip")));
+  EXPECT_STREQ(_T("deflate"), cm_->GetRequestEncoding(false));
+}
+
 // Tests GetDir indirectly.
 TEST_P(ConfigManagerTest, GetDir) {
   RestoreRegistryHives();
@@ -2236,6 +2278,100 @@ TEST_P(ConfigManagerTest, GetDownloadPreferenceGroupPolicy) {
                cm_->GetDownloadPreferenceGroupPolicy(NULL));
 }
 
+TEST_P(ConfigManagerTest, PolicySnapshot_PublishedOnEachLoad) {
+  std::shared_ptr<const PolicySnapshot> snapshot(cm_->policy_snapshot());
+  ASSERT_TRUE(snapshot);
+  const int version = snapshot->version;
+  const int cache_size_limit = snapshot->package_cache_size_limit_mbytes;
+
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueCacheSizeLimitMBytes, 123));
+  std::shared_ptr<const PolicySnapshot> reloaded(cm_->policy_snapshot());
+  EXPECT_LT(version, reloaded->version);
+  EXPECT_EQ(IsDomain() ? 123 : cache_size_limit,
+            cm_->GetPackageCacheSizeLimitMBytes(NULL));
+
+  // The snapshot held by the caller is not modified by the reload.
+  EXPECT_EQ(version, snapshot->version);
+  EXPECT_EQ(cache_size_limit, snapshot->package_cache_size_limit_mbytes);
+
+  cm_->SetOmahaDMPolicies(cm_->dm_policy());
+  EXPECT_LT(reloaded->version, cm_->policy_snapshot()->version);
+}
+
+TEST_P(ConfigManagerTest, PolicySnapshot_MatchesPolicyStatusValues) {
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueInstallAppsDefault, kPolicyDisabled));
+  EXPECT_SUCCEEDED(SetPolicy(kInstallPolicyApp1, kPolicyEnabled));
+  EXPECT_SUCCEEDED(SetPolicyString(kRegValueProxyMode, kProxyModeFixedServers));
+  EXPECT_SUCCEEDED(SetPolicyString(kRegValueProxyServer, _T("proxy:8080")));
+
+  const GUID app_guids[] = {
+    StringToGuid(kAppGuid1),
+    StringToGuid(kAppGuid2),
+    StringToGuid(kChromeAppId),
+    GUID_NULL,
+  };
+  for (const GUID& app_guid : app_guids) {
+    CComPtr<IPolicyStatusValue> status;
+    EXPECT_EQ(cm_->GetEffectivePolicyForAppInstalls(app_guid, &status),
+              cm_->GetEffectivePolicyForAppInstalls(app_guid, NULL));
+    status.Release();
+    EXPECT_EQ(cm_->GetEffectivePolicyForAppUpdates(app_guid, &status),
+              cm_->GetEffectivePolicyForAppUpdates(app_guid, NULL));
+    status.Release();
+    EXPECT_STREQ(cm_->GetTargetChannel(app_guid, &status),
+                 cm_->GetTargetChannel(app_guid, NULL));
+    status.Release();
+    EXPECT_STREQ(cm_->GetTargetVersionPrefix(app_guid, &status),
+                 cm_->GetTargetVersionPrefix(app_guid, NULL));
+    status.Release();
+    EXPECT_EQ(cm_->IsRollbackToTargetVersionAllowed(app_guid, &status),
+              cm_->IsRollbackToTargetVersionAllowed(app_guid, NULL));
+  }
+
+  CComPtr<IPolicyStatusValue> status;
+  CString proxy_server;
+  CString snapshot_proxy_server;
+  EXPECT_EQ(cm_->GetProxyServer(&proxy_server, &status),
+            cm_->GetProxyServer(&snapshot_proxy_server, NULL));
+  EXPECT_STREQ(proxy_server, snapshot_proxy_server);
+
+  status.Release();
+  bool is_overridden = false;
+  bool is_snapshot_overridden = false;
+  EXPECT_EQ(cm_->GetLastCheckPeriodSec(&is_overridden, &status),
+            cm_->GetLastCheckPeriodSec(&is_snapshot_overridden, NULL));
+  EXPECT_EQ(is_overridden, is_snapshot_overridden);
+}
+
+// The ConfigManager constructor publishes the default policies, which are
+// kept when its first load of the policies fails.
+TEST_P(ConfigManagerTest, PolicySnapshot_DefaultsWhenLoadFails) {
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueInstallAppsDefault, kPolicyDisabled));
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueUpdateAppsDefault, kPolicyDisabled));
+  EXPECT_SUCCEEDED(SetPolicy(kRegValueCacheSizeLimitMBytes, 123));
+
+  cm_->PublishDefaultPolicySnapshot();
+  EXPECT_EQ(E_ACCESSDENIED, cm_->PublishLoadedPolicies(E_ACCESSDENIED));
+
+  const GUID app_guids[] = {
+    StringToGuid(kAppGuid1),
+    StringToGuid(kChromeAppId),
+    GUID_NULL,
+  };
+  for (const GUID& app_guid : app_guids) {
+    EXPECT_EQ(kInstallPolicyDefault,
+              cm_->GetEffectivePolicyForAppInstalls(app_guid, NULL));
+    EXPECT_EQ(kUpdatePolicyDefault,
+              cm_->GetEffectivePolicyForAppUpdates(app_guid, NULL));
+  }
+  EXPECT_EQ(500, cm_->GetPackageCacheSizeLimitMBytes(NULL));
+  EXPECT_EQ(180, cm_->GetPackageCacheExpirationTimeDays(NULL));
+
+  // The policies apply again once they load.
+  EXPECT_SUCCEEDED(cm_->LoadPolicies(false));
+  EXPECT_EQ(IsDomain() ? 123 : 500, cm_->GetPackageCacheSizeLimitMBytes(NULL));
+}
+
 #if defined(HAS_DEVICE_MANAGEMENT)
 
 TEST_P(ConfigManagerTest, GetCloudManagementEnrollmentToken) {
@@ -259,6 +259,10 @@ const TCHAR* const kRegValueLastOSVersion         = _T("LastOSVersion");
 // for update checks. See the explanation of kHeaderXRetryAfter in constants.h.
 const TCHAR* const kRegValueRetryAfter            = _T("RetryAfter");
 
+// The content coding of request bodies. See the explanation of
+// kHeaderXRequestEncoding in constants.h.
+const TCHAR* const kRegValueRequestEncoding       = _T("RequestEncoding");
+
 // UID registry entries.
 const TCHAR* const kRegValueUserId                = _T("uid");
 const TCHAR* const kRegValueOldUserId             = _T("old-uid");
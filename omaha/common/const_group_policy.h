@@ -59,6 +59,10 @@ const int kMaxAutoUpdateCheckPeriodMinutes = 43200;
 // The maximum value allowed for policy UpdatesSuppressedDurationMin.
 const int kMaxUpdatesSuppressedDurationMin = 960;
 
+// The maximum number of installers which run at the same time, in the range
+// [1, kMaxConcurrentInstallsLimit]. MSI installers always run alone.
+const TCHAR* const kRegValueMaxConcurrentInstalls = _T("MaxConcurrentInstalls");
+
 // This policy specifies what kind of download URLs could be returned to the
 // client in the update response and in which order of priority. The client
 // provides this information in the update request as a hint for the server.
@@ -220,9 +220,8 @@ HRESULT CreateCustomInfoFile(const CString& dump_file,
   UTIL_LOG(L1, (_T("[CreateCustomInfoFile][%s][%d pairs]"),
                 dump_file, custom_info_map.size()));
 
-  // Since goopdate_utils::WriteNameValuePairsToFile is implemented in terms
-  // of WritePrivateProfile API, relative paths are relative to the Windows
-  // directory instead of the current directory of the process.
+  // The custom info file is written next to the dump, which is in the crash
+  // directory, so the path of the dump is absolute.
   ASSERT1(!::PathIsRelative(dump_file));
 
   // Determine the path for custom info file.
@@ -29,15 +29,65 @@
 
 #include "omaha/common/experiment_labels.h"
 
+#include <algorithm>
+#include <map>
+
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
-#include "omaha/base/safe_format.h"
 #include "omaha/base/reg_key.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/common/app_registry_utils.h"
 #include "omaha/common/const_goopdate.h"
 
 namespace omaha {
 
+namespace {
+
+// The registry cache is cleared when it grows over these limits, which are
+// well above the number of label lists and strings of the installed apps.
+const size_t kMaxCachedLabelLists = 2048;
+const size_t kMaxCachedStrings = 16 * 1024;
+
+// Returns true if the character is in the range [a-zA-Z0-9_\-+,: ]
+// (Perl \w, plus the punctuation necessary for RFC822 dates.)
+bool IsLabelChar(wchar_t ch) {
+  return (ch >= L'+' && ch <= L'-') ||
+         (ch >= L'0' && ch <= L':') ||
+         (ch >= L'A' && ch <= L'Z') ||
+         (ch >= L'a' && ch <= L'z') ||
+         (ch == L'_') || (ch == L' ') ||
+         (ch == L'/') || (ch == L'\\') ||
+         (ch == L'.');
+}
+
+// Returns the string of |length| characters at |str|. If |pool| is not NULL,
+// the string shares its buffer with the equal string in the pool.
+CString MakeLabelString(std::set<CString>* pool,
+                        const TCHAR* str,
+                        int length) {
+  CString result(str, length);
+  if (pool) {
+    result = *pool->insert(result).first;
+  }
+  return result;
+}
+
+}  // namespace
+
+struct ExperimentLabels::RegistryCache {
+  struct Entry {
+    Entry() : is_valid(false) {}
+
+    CString label_list;
+    bool is_valid;
+    LabelList labels;
+  };
+
+  LLock lock;
+  std::map<CString, Entry> entries;
+  StringPool strings;
+};
+
 ExperimentLabels::ExperimentLabels() : labels_(), preserve_expired_(false) {}
 
 ExperimentLabels::~ExperimentLabels() {}
@@ -48,40 +98,39 @@ size_t ExperimentLabels::NumLabels() const {
 
 bool ExperimentLabels::ContainsKey(const CString& key) const {
   ASSERT1(!key.IsEmpty());
-  return labels_.find(key) != labels_.end();
+  return Find(key) != labels_.end();
 }
 
 void ExperimentLabels::GetLabelByIndex(int index, CString* key, CString* value,
                                        time64* expiration) const {
   ASSERT1(index >= 0);
-  ASSERT1(static_cast<LabelMap::size_type>(index) < labels_.size());
+  ASSERT1(static_cast<LabelList::size_type>(index) < labels_.size());
 
-  LabelMap::const_iterator cit = labels_.begin();
-  std::advance(cit, static_cast<LabelMap::size_type>(index));
+  const Label& label = labels_[static_cast<LabelList::size_type>(index)];
   if (key) {
-    *key = cit->first;
+    *key = label.key;
   }
   if (value) {
-    *value = cit->second.first;
+    *value = label.value;
   }
   if (expiration) {
-    *expiration = cit->second.second;
+    *expiration = label.expiration;
   }
 }
 
 bool ExperimentLabels::FindLabelByKey(const CString& key, CString* value,
                                       time64* expiration) const {
   ASSERT1(!key.IsEmpty());
-  LabelMap::const_iterator cit = labels_.find(key);
+  LabelList::const_iterator cit = Find(key);
   if (labels_.end() == cit) {
     return false;
   }
 
   if (value) {
-    *value = cit->second.first;
+    *value = cit->value;
   }
   if (expiration) {
-    *expiration = cit->second.second;
+    *expiration = cit->expiration;
   }
   return true;
 }
@@ -94,13 +143,19 @@ bool ExperimentLabels::SetLabel(const CString& key, const CString& value,
   if (expiration < GetCurrent100NSTime() && !preserve_expired_) {
     return false;
   }
-  labels_[key] = std::make_pair(value, expiration);
+  LabelList::iterator it = LowerBound(&labels_, key);
+  if (it != labels_.end() && it->key == key) {
+    it->value = value;
+    it->expiration = expiration;
+  } else {
+    labels_.insert(it, Label(key, value, expiration));
+  }
   return true;
 }
 
 bool ExperimentLabels::ClearLabel(const CString& key) {
-  LabelMap::iterator it = labels_.find(key);
-  if (labels_.end() == it) {
+  LabelList::iterator it = LowerBound(&labels_, key);
+  if (labels_.end() == it || it->key != key) {
     return false;
   }
   labels_.erase(it);
@@ -108,15 +163,12 @@ bool ExperimentLabels::ClearLabel(const CString& key) {
 }
 
 void ExperimentLabels::ExpireLabels() {
-  time64 current_time = GetCurrent100NSTime();
-  for (LabelMap::iterator it = labels_.begin(); it != labels_.end(); ++it) {
-    if (it->second.second < current_time) {
-      it = labels_.erase(it);
-      if (it == labels_.end()) {
-        break;
-      }
-    }
-  }
+  const time64 current_time = GetCurrent100NSTime();
+  labels_.erase(std::remove_if(labels_.begin(), labels_.end(),
+                               [current_time](const Label& label) {
+                                 return label.expiration < current_time;
+                               }),
+                labels_.end());
 }
 
 void ExperimentLabels::ClearAllLabels() {
@@ -126,20 +178,21 @@ void ExperimentLabels::ClearAllLabels() {
 CString ExperimentLabels::Serialize(SerializeOptions options) const {
   CString serialized;
   const time64 current_time = GetCurrent100NSTime();
-  for (LabelMap::const_iterator cit = labels_.begin();
+  for (LabelList::const_iterator cit = labels_.begin();
        cit != labels_.end();
        ++cit) {
-    if (preserve_expired_ || cit->second.second >= current_time) {
+    if (preserve_expired_ || cit->expiration >= current_time) {
       if (!serialized.IsEmpty()) {
-        serialized.Append(L";");
+        serialized.AppendChar(L';');
       }
-      SafeCStringAppendFormat(&serialized, L"%s=%s",
-                              cit->first, cit->second.first);
+      serialized.Append(cit->key);
+      serialized.AppendChar(L'=');
+      serialized.Append(cit->value);
       if (options & SerializeOptions::INCLUDE_TIMESTAMPS) {
         FILETIME ft = {};
-        Time64ToFileTime(cit->second.second, &ft);
-        SafeCStringAppendFormat(&serialized, L"|%s",
-                                ConvertTimeToGMTString(&ft));
+        Time64ToFileTime(cit->expiration, &ft);
+        serialized.AppendChar(L'|');
+        serialized.Append(ConvertTimeToGMTString(&ft));
       }
     }
   }
@@ -147,21 +200,25 @@ CString ExperimentLabels::Serialize(SerializeOptions options) const {
 }
 
 bool ExperimentLabels::Deserialize(const CString& label_list) {
-  LabelMap new_labels;
-  if (DoDeserialize(&new_labels, label_list, preserve_expired_)) {
-    std::swap(labels_, new_labels);
-    return true;
+  LabelList parsed_labels;
+  if (!ParseLabelList(label_list, NULL, &parsed_labels)) {
+    return false;
   }
-  return false;
+  LabelList new_labels;
+  ApplyLabels(parsed_labels, preserve_expired_, &new_labels);
+  std::swap(labels_, new_labels);
+  return true;
 }
 
 bool ExperimentLabels::DeserializeAndApplyDelta(const CString& label_list) {
-  LabelMap merged_labels = labels_;
-  if (DoDeserialize(&merged_labels, label_list, false)) {
-    std::swap(labels_, merged_labels);
-    return true;
+  // The delta is validated before it is applied, therefore it is applied in
+  // place instead of to a copy of the store.
+  LabelList parsed_labels;
+  if (!ParseLabelList(label_list, NULL, &parsed_labels)) {
+    return false;
   }
-  return false;
+  ApplyLabels(parsed_labels, false, &labels_);
+  return true;
 }
 
 void ExperimentLabels::SetPreserveExpiredLabels(bool preserve) {
@@ -178,17 +235,20 @@ HRESULT ExperimentLabels::WriteToRegistry(bool is_machine,
 
 HRESULT ExperimentLabels::ReadFromRegistry(bool is_machine,
                                            const CString& app_id) {
+  // The labels are read without checking for the value first, since a missing
+  // value reads as an empty list.
   CString label_list;
   const CString state_key(
       app_registry_utils::GetAppClientStateKey(is_machine, app_id));
-  if (RegKey::HasValue(state_key, kRegValueExperimentLabels)) {
-    VERIFY_SUCCEEDED(RegKey::GetValue(
-        state_key, kRegValueExperimentLabels, &label_list));
-  }
+  RegKey::GetValue(state_key, kRegValueExperimentLabels, &label_list);
 
-  if (!Deserialize(label_list)) {
+  LabelList parsed_labels;
+  if (!ParseRegistryLabelList(state_key, label_list, &parsed_labels)) {
     return E_FAIL;
   }
+  LabelList new_labels;
+  ApplyLabels(parsed_labels, preserve_expired_, &new_labels);
+  std::swap(labels_, new_labels);
 
   if (!is_machine) {
     return S_OK;
@@ -198,23 +258,29 @@ HRESULT ExperimentLabels::ReadFromRegistry(bool is_machine,
   // and integrate it into ClientState.
   const CString med_state_key(
       app_registry_utils::GetAppClientStateMediumKey(true, app_id));
-  if (RegKey::HasValue(med_state_key, kRegValueExperimentLabels)) {
-    VERIFY_SUCCEEDED(RegKey::GetValue(
-        med_state_key, kRegValueExperimentLabels, &label_list));
-  }
-
-  if (!label_list.IsEmpty()) {
-    if (!DeserializeAndApplyDelta(label_list)) {
+  CString med_label_list;
+  const bool has_med_label_list = SUCCEEDED(RegKey::GetValue(
+      med_state_key, kRegValueExperimentLabels, &med_label_list));
+
+  if (has_med_label_list && !med_label_list.IsEmpty()) {
+    if (!ParseRegistryLabelList(med_state_key,
+                                med_label_list,
+                                &parsed_labels)) {
       return E_FAIL;
     }
+    ApplyLabels(parsed_labels, false, &labels_);
+  } else if (!has_med_label_list && !label_list.IsEmpty()) {
+    // The ClientState labels are applied again as a delta, which removes the
+    // expired labels kept by SetPreserveExpiredLabels.
+    ApplyLabels(parsed_labels, false, &labels_);
   }
 
   return S_OK;
 }
 
 bool ExperimentLabels::IsStringValidLabelSet(const CString& label_list) {
-  ExperimentLabels labels;
-  return labels.Deserialize(label_list);
+  LabelList parsed_labels;
+  return ParseLabelList(label_list, NULL, &parsed_labels);
 }
 
 bool ExperimentLabels::IsLabelContentValid(const CString& str) {
@@ -222,98 +288,151 @@ bool ExperimentLabels::IsLabelContentValid(const CString& str) {
     return false;
   }
   for (int i = 0; i < str.GetLength(); ++i) {
-    wchar_t ch = str[i];
-    if (!((ch >= L'+' && ch <= L'-') ||
-          (ch >= L'0' && ch <= L':') ||
-          (ch >= L'A' && ch <= L'Z') ||
-          (ch >= L'a' && ch <= L'z') ||
-          (ch == L'_') || (ch == L' ') ||
-          (ch == L'/') || (ch == L'\\') ||
-          (ch == L'.') )) {
+    if (!IsLabelChar(str[i])) {
       return false;
     }
   }
   return true;
 }
 
-bool ExperimentLabels::SplitCombinedLabel(const CString& combined, CString* key,
-                                          CString* value, time64* expiration) {
-  ASSERT1(!combined.IsEmpty());
-  ASSERT1(key);
-  ASSERT1(value);
-  ASSERT1(expiration);
+bool ExperimentLabels::ParseLabelList(const CString& label_list,
+                                      StringPool* pool,
+                                      LabelList* labels) {
+  ASSERT1(labels);
+  labels->clear();
+
+  const TCHAR* const list = label_list;
+  const int length = label_list.GetLength();
+  int begin = 0;
+  while (begin < length) {
+    // Leading, trailing, and repeated label separators are accepted.
+    if (list[begin] == L';') {
+      ++begin;
+      continue;
+    }
 
-  int value_offset = combined.Find(L'=');
-  if (value_offset <= 0 || value_offset == combined.GetLength()) {
-    return false;
-  }
-  *key = combined.Left(value_offset);
-  if (!IsLabelContentValid(*key)) {
-    return false;
-  }
-  ++value_offset;
+    // Scans a label of the form "key=value|rfc822_date" up to the next
+    // separator, validating the characters of its parts along the way.
+    int value_begin = -1;
+    int expiration_begin = -1;
+    int end = begin;
+    for (; end < length && list[end] != L';'; ++end) {
+      const wchar_t ch = list[end];
+      if (IsLabelChar(ch)) {
+        continue;
+      }
+      if (ch == L'=' && value_begin < 0) {
+        value_begin = end + 1;
+      } else if (ch == L'|' && value_begin >= 0 && expiration_begin < 0) {
+        expiration_begin = end + 1;
+      } else {
+        return false;
+      }
+    }
 
-  int expiration_offset = combined.Find(L'|', value_offset);
-  if (expiration_offset <= value_offset ||
-      expiration_offset == combined.GetLength()) {
-    return false;
-  }
-  *value = combined.Mid(value_offset, expiration_offset - value_offset);
-  if (!IsLabelContentValid(*value)) {
-    return false;
-  }
-  ++expiration_offset;
+    // The key, the value, and the expiration must not be empty.
+    if (value_begin <= begin + 1 ||
+        expiration_begin <= value_begin + 1 ||
+        end <= expiration_begin) {
+      return false;
+    }
 
-  CString expiration_string = combined.Mid(expiration_offset);
-  if (!IsLabelContentValid(expiration_string)) {
-    return false;
-  }
-  SYSTEMTIME system_time = {};
-  if (!RFC822DateToSystemTime(expiration_string, &system_time, false)) {
-    return false;
+    SYSTEMTIME system_time = {};
+    const CString expiration_string(list + expiration_begin,
+                                    end - expiration_begin);
+    if (!RFC822DateToSystemTime(expiration_string, &system_time, false)) {
+      return false;
+    }
+
+    labels->push_back(Label(
+        MakeLabelString(pool, list + begin, value_begin - 1 - begin),
+        MakeLabelString(pool,
+                        list + value_begin,
+                        expiration_begin - 1 - value_begin),
+        SystemTimeToTime64(&system_time)));
+    begin = end;
   }
-  *expiration = SystemTimeToTime64(&system_time);
 
   return true;
 }
 
-bool ExperimentLabels::DoDeserialize(LabelMap* map, const CString& label_list,
-                                     bool accept_expired) {
-  ASSERT1(map);
+bool ExperimentLabels::ParseRegistryLabelList(const CString& key_name,
+                                              const CString& label_list,
+                                              LabelList* labels) {
+  ASSERT1(labels);
+
+  static RegistryCache cache;
+  __mutexScope(cache.lock);
+
+  std::map<CString, RegistryCache::Entry>::iterator it =
+      cache.entries.find(key_name);
+  if (it == cache.entries.end() || it->second.label_list != label_list) {
+    if (it == cache.entries.end()) {
+      if (cache.entries.size() >= kMaxCachedLabelLists ||
+          cache.strings.size() >= kMaxCachedStrings) {
+        cache.entries.clear();
+        cache.strings.clear();
+      }
+      it = cache.entries.insert(
+          std::make_pair(key_name, RegistryCache::Entry())).first;
+    }
+    RegistryCache::Entry& entry = it->second;
+    entry.label_list = label_list;
+    entry.is_valid = ParseLabelList(label_list, &cache.strings, &entry.labels);
+  }
 
-  if (label_list.IsEmpty()) {
-    return true;
+  if (!it->second.is_valid) {
+    return false;
   }
+  *labels = it->second.labels;
+  return true;
+}
 
-  time64 current_time = GetCurrent100NSTime();
+void ExperimentLabels::ApplyLabels(const LabelList& parsed_labels,
+                                   bool accept_expired,
+                                   LabelList* labels) {
+  ASSERT1(labels);
 
-  for (int offset = 0;;) {
-    CString combined_label = label_list.Tokenize(L";", offset);
-    if (combined_label.IsEmpty()) {
-      if (offset < 0) {
-        break;  // Natural end-of-string reached.
+  const time64 current_time = GetCurrent100NSTime();
+  for (LabelList::const_iterator cit = parsed_labels.begin();
+       cit != parsed_labels.end();
+       ++cit) {
+    LabelList::iterator it = LowerBound(labels, cit->key);
+    const bool exists = it != labels->end() && it->key == cit->key;
+
+    // If the label is well-formatted but expired, it is not added to the
+    // store. If there is already a label in the store with that key, it is
+    // deleted.
+    if (accept_expired || cit->expiration > current_time) {
+      if (exists) {
+        *it = *cit;
+      } else {
+        labels->insert(it, *cit);
       }
-      return false;
-    }
-
-    CString key;
-    CString value;
-    time64 expiration = 0;
-    if (!SplitCombinedLabel(combined_label, &key, &value, &expiration)) {
-      return false;
-    }
-
-    // If the label is well-formatted but expired, we accept the input, but
-    // do not add it to the map and do not emit an error.  If there is already
-    // a label in the map with that key, delete it.
-    if (accept_expired || expiration > current_time) {
-      (*map)[key] = std::make_pair(value, expiration);
-    } else {
-      map->erase(key);
+    } else if (exists) {
+      labels->erase(it);
     }
   }
+}
 
-  return true;
+ExperimentLabels::LabelList::iterator ExperimentLabels::LowerBound(
+    LabelList* labels,
+    const CString& key) {
+  ASSERT1(labels);
+  return std::lower_bound(labels->begin(), labels->end(), key,
+                          [](const Label& label, const CString& key) {
+                            return label.key < key;
+                          });
+}
+
+ExperimentLabels::LabelList::const_iterator ExperimentLabels::Find(
+    const CString& key) const {
+  LabelList::const_iterator cit = std::lower_bound(
+      labels_.begin(), labels_.end(), key,
+      [](const Label& label, const CString& key) {
+        return label.key < key;
+      });
+  return (cit != labels_.end() && cit->key == key) ? cit : labels_.end();
 }
 
 CString ExperimentLabels::CreateLabel(const CString& key,
@@ -393,5 +512,12 @@ CString ExperimentLabels::RemoveTimestamps(const CString& labels) {
   return stored_labels.Serialize(SerializeOptions::EXCLUDE_TIMESTAMPS);
 }
 
+CString ExperimentLabels::ReadRegistryNoTimestamps(bool is_machine,
+                                                   const CString& app_id) {
+  ExperimentLabels stored_labels;
+  VERIFY_SUCCEEDED(stored_labels.ReadFromRegistry(is_machine, app_id));
+  return stored_labels.Serialize(SerializeOptions::EXCLUDE_TIMESTAMPS);
+}
+
 }  // namespace omaha
 
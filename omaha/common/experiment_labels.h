@@ -32,8 +32,8 @@
 
 #include <atlstr.h>
 
-#include <map>
-#include <utility>
+#include <set>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "gtest/gtest_prod.h"
@@ -74,6 +74,13 @@ class ExperimentLabels {
   // "k1=v1;k2=v2".
   static CString RemoveTimestamps(const CString& labels);
 
+  // Reads the experiment labels for the given app_id like ReadRegistry, and
+  // returns them without time stamps, as they are sent in requests. This is
+  // equivalent to RemoveTimestamps(ReadRegistry(is_machine, app_id)) but the
+  // labels are not formatted and parsed again.
+  static CString ReadRegistryNoTimestamps(bool is_machine,
+                                          const CString& app_id);
+
  private:
   // Controls the format of the label serialization.
   enum SerializeOptions {
@@ -86,7 +93,25 @@ class ExperimentLabels {
   ExperimentLabels();
   ~ExperimentLabels();
 
-  typedef std::map<CString, std::pair<CString, time64> > LabelMap;
+  // A label in the store. The labels of a store are kept sorted by key.
+  struct Label {
+    Label() : expiration(0) {}
+    Label(const CString& label_key,
+          const CString& label_value,
+          time64 label_expiration)
+        : key(label_key),
+          value(label_value),
+          expiration(label_expiration) {}
+
+    CString key;
+    CString value;
+    time64 expiration;
+  };
+
+  typedef std::vector<Label> LabelList;
+
+  // The strings shared by the parsed label lists in the cache.
+  typedef std::set<CString> StringPool;
 
   // Returns the number of labels in the store.
   size_t NumLabels() const;
@@ -165,19 +190,36 @@ class ExperimentLabels {
   // (Perl \w, plus the punctuation necessary for RFC822 dates.)
   static bool IsLabelContentValid(const CString& str);
 
-  // Given an input string of the form "key=value|rfc822_date", converts it
-  // into separate key, value, and integer expiration dates.
-  static bool SplitCombinedLabel(const CString& combined,
-                                 CString* key,
-                                 CString* value,
-                                 time64* expiration);
-
-  // Splits an input string and applies it against an existing internal map.
-  static bool DoDeserialize(LabelMap* map,
-                            const CString& label_list,
-                            bool accept_expired);
-
-  LabelMap labels_;
+  // Parses and validates a label list in a single pass over the string. The
+  // labels are returned in the order of the list, including the expired ones.
+  // If |pool| is not NULL, the keys and values of the labels are shared with
+  // the equal strings in the pool.
+  static bool ParseLabelList(const CString& label_list,
+                             StringPool* pool,
+                             LabelList* labels);
+
+  // The cache of the parsed label lists read from the registry.
+  struct RegistryCache;
+
+  // Parses the label list read from the registry key |key_name|. The parsed
+  // list is cached for each key, and the list is parsed again only when the
+  // value in the registry changes.
+  static bool ParseRegistryLabelList(const CString& key_name,
+                                     const CString& label_list,
+                                     LabelList* labels);
+
+  // Applies the parsed labels in order against |labels|. Expired labels are
+  // removed from |labels| unless |accept_expired| is true.
+  static void ApplyLabels(const LabelList& parsed_labels,
+                          bool accept_expired,
+                          LabelList* labels);
+
+  // Returns the position of the label with this key in |labels|, or the
+  // position where such a label would be inserted.
+  static LabelList::iterator LowerBound(LabelList* labels, const CString& key);
+  LabelList::const_iterator Find(const CString& key) const;
+
+  LabelList labels_;
   bool preserve_expired_;
 
   FRIEND_TEST(ExperimentLabelsTest, Empty);
@@ -211,10 +253,12 @@ class ExperimentLabels {
   FRIEND_TEST(ExperimentLabelsTest,
               DeserializeAndApplyDelta_Overwrite_Multi_Expired);
   FRIEND_TEST(ExperimentLabelsTest, Expire);
+  FRIEND_TEST(ExperimentLabelsTest, ParseLabelList_SharesStrings);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, ClientStateOnly);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, ClientStateMediumOnly);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, Merge);
   FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, CreateReadWrite);
+  FRIEND_TEST(ExperimentLabelsRegistryProtectedTest, ReadFromRegistry_Cached);
   friend class ExperimentLabelsRegistryProtectedTest;
 
   DISALLOW_COPY_AND_ASSIGN(ExperimentLabels);
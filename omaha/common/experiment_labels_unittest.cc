@@ -13,8 +13,12 @@
 // limitations under the License.
 // ========================================================================
 
+#include <vector>
+
 #include "omaha/base/reg_key.h"
+#include "omaha/base/time.h"
 #include "omaha/base/utils.h"
+#include "omaha/common/app_registry_utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/experiment_labels.h"
@@ -788,6 +792,37 @@ TEST_F(ExperimentLabelsTest, Expire) {
   EXPECT_FALSE(el.ContainsKey(kLabelOldKey));
 }
 
+TEST_F(ExperimentLabelsTest, ParseLabelList_SharesStrings) {
+  ExperimentLabels::StringPool pool;
+  ExperimentLabels::LabelList first;
+  ExperimentLabels::LabelList second;
+  EXPECT_TRUE(ExperimentLabels::ParseLabelList(kLabelAllCombined,
+                                               &pool,
+                                               &first));
+  EXPECT_TRUE(ExperimentLabels::ParseLabelList(kLabelNewCombined,
+                                               &pool,
+                                               &second));
+
+  // The labels are returned in the order of the list, including the expired
+  // ones.
+  ASSERT_EQ(3, first.size());
+  EXPECT_STREQ(kLabelOneKey, first[0].key);
+  EXPECT_STREQ(kLabelOneValue, first[0].value);
+  EXPECT_EQ(kLabelOneExpInt, first[0].expiration);
+  EXPECT_STREQ(kLabelTwoKey, first[1].key);
+  EXPECT_STREQ(kLabelOldKey, first[2].key);
+  EXPECT_EQ(kLabelOldExpInt, first[2].expiration);
+
+  ASSERT_EQ(2, second.size());
+  EXPECT_EQ(first[0].key.GetString(), second[0].key.GetString());
+  EXPECT_EQ(first[1].value.GetString(), second[1].value.GetString());
+  EXPECT_EQ(6, pool.size());
+
+  // The output is cleared when the list is not valid.
+  EXPECT_FALSE(ExperimentLabels::ParseLabelList(_T("k=v|"), &pool, &second));
+  EXPECT_TRUE(second.empty());
+}
+
 class ExperimentLabelsRegistryProtectedTest : public testing::Test {
  protected:
   ExperimentLabelsRegistryProtectedTest()
@@ -955,6 +990,98 @@ TEST_F(ExperimentLabelsRegistryProtectedTest, CreateReadWrite) {
   EXPECT_STREQ(kExpectedMergedResult, merged_str);
 }
 
+TEST_F(ExperimentLabelsRegistryProtectedTest, ReadFromRegistry_Cached) {
+  ClearClientState();
+  SetClientState(kClientStateTestLabels);
+  SetClientStateMedium(kClientStateMediumTestLabels);
+
+  ExperimentLabels el;
+  EXPECT_SUCCEEDED(el.ReadFromRegistry(true, kExperimentLabelTestAppId));
+  EXPECT_EQ(4, el.NumLabels());
+
+  // A change of the registry value is seen by the next read.
+  const time64 expiration = GetCurrent100NSTime() + kDaysTo100ns;
+  ASSERT_SUCCEEDED(RegKey::SetValue(
+      GetAppClientStateMediumKey(),
+      kRegValueExperimentLabels,
+      ExperimentLabels::CreateLabel(_T("common"), _T("new"), expiration)));
+  EXPECT_SUCCEEDED(el.ReadFromRegistry(true, kExperimentLabelTestAppId));
+  CString common_value;
+  ASSERT_TRUE(el.FindLabelByKey(_T("common"), &common_value, NULL));
+  EXPECT_STREQ(_T("new"), common_value);
+
+  // So is an invalid value.
+  ASSERT_SUCCEEDED(RegKey::SetValue(GetAppClientStateMediumKey(),
+                                    kRegValueExperimentLabels,
+                                    _T("common=new|")));
+  EXPECT_EQ(E_FAIL, el.ReadFromRegistry(true, kExperimentLabelTestAppId));
+}
+
+TEST_F(ExperimentLabelsRegistryProtectedTest, ReadRegistryNoTimestamps) {
+  ClearClientState();
+  SetClientState(kClientStateTestLabels);
+  SetClientStateMedium(kClientStateMediumTestLabels);
+
+  EXPECT_STREQ(ExperimentLabels::RemoveTimestamps(kExpectedMergedResult),
+               ExperimentLabels::ReadRegistryNoTimestamps(
+                   true, kExperimentLabelTestAppId));
+  EXPECT_STREQ(ExperimentLabels::RemoveTimestamps(
+                   ExperimentLabels::ReadRegistry(
+                       true, kExperimentLabelTestAppId)),
+               ExperimentLabels::ReadRegistryNoTimestamps(
+                   true, kExperimentLabelTestAppId));
+
+  ClearClientState();
+  EXPECT_STREQ(_T(""), ExperimentLabels::ReadRegistryNoTimestamps(
+                           true, kExperimentLabelTestAppId));
+}
+
+// Reads the labels of 500 apps with 20 labels each, as the labels are read
+// for each app when an update request is built.
+TEST_F(ExperimentLabelsRegistryProtectedTest, ReadRegistryNoTimestamps_Apps) {
+  const int kNumApps = 500;
+  const int kNumLabels = 20;
+  const time64 expiration = GetCurrent100NSTime() + 30 * kDaysTo100ns;
+
+  std::vector<CString> app_ids;
+  for (int i = 0; i != kNumApps; ++i) {
+    GUID app_guid = GUID_NULL;
+    ASSERT_SUCCEEDED(::CoCreateGuid(&app_guid));
+    app_ids.push_back(GuidToString(app_guid));
+
+    CString label_list;
+    for (int j = 0; j != kNumLabels; ++j) {
+      CString key;
+      key.Format(_T("experiment_%d"), j);
+      CString value;
+      value.Format(_T("group_%d"), (i + j) % 4);
+      if (!label_list.IsEmpty()) {
+        label_list.AppendChar(_T(';'));
+      }
+      label_list.Append(ExperimentLabels::CreateLabel(key, value, expiration));
+    }
+    ASSERT_SUCCEEDED(RegKey::SetValue(
+        app_registry_utils::GetAppClientStateKey(true, app_ids[i]),
+        kRegValueExperimentLabels,
+        label_list));
+  }
+
+  std::vector<CString> expected_labels;
+  for (int i = 0; i != kNumApps; ++i) {
+    expected_labels.push_back(ExperimentLabels::RemoveTimestamps(
+        ExperimentLabels::ReadRegistry(true, app_ids[i])));
+  }
+
+  // The second read of each app uses the parsed labels in the cache.
+  for (int pass = 0; pass != 2; ++pass) {
+    for (int i = 0; i != kNumApps; ++i) {
+      EXPECT_STREQ(expected_labels[i],
+                   ExperimentLabels::ReadRegistryNoTimestamps(true,
+                                                              app_ids[i]));
+    }
+  }
+}
+
 TEST_F(ExperimentLabelsTest, RemoveTimestamps) {
   EXPECT_STREQ(ExperimentLabels::RemoveTimestamps(kLabelNewCombined),
                kLabelNewCombinedNoTimeStamps);
@@ -28,6 +28,7 @@
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
 #include "omaha/base/logging.h"
+#include "omaha/base/name_value_file.h"
 #include "omaha/base/omaha_version.h"
 #include "omaha/base/path.h"
 #include "omaha/base/proc_utils.h"
@@ -1318,28 +1319,32 @@ HRESULT ReadNameValuePairsFromFile(const CString& file_path,
 
   pairs->clear();
 
-  TCHAR str_buf[32768] = {0};
-
-  // Retrieve all key names in the section requested.
-  DWORD buf_count = ::GetPrivateProfileString(group_name,
-                                              NULL,
-                                              NULL,
-                                              str_buf,
-                                              arraysize(str_buf),
-                                              file_path);
-
-  DWORD offset = 0;
-  while (offset < buf_count) {
-    TCHAR val_buf[1024] = {0};
-    CString current_key = &(str_buf[offset]);
-    DWORD val_count = ::GetPrivateProfileString(group_name,
-                                                current_key,
-                                                NULL,
-                                                val_buf,
-                                                arraysize(val_buf),
-                                                file_path);
-    (*pairs)[current_key] = val_buf;
-    offset += current_key.GetLength() + 1;
+  std::vector<byte> buffer;
+  HRESULT hr = ReadEntireFileShareMode(file_path,
+                                       0,
+                                       FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                       &buffer);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const CString text(buffer.empty() ?
+                     CString() :
+                     DecodeNameValueFile(&buffer.front(), buffer.size()));
+  NameValueParser parser(text, text.GetLength());
+  std::vector<NameValueParser::Line> lines;
+  parser.ReadSection(group_name, &lines);
+
+  // Like GetPrivateProfileString, the names are not case sensitive and the
+  // first of the duplicate names has the value of all of them.
+  std::map<CString, CString> values;
+  for (size_t i = 0; i != lines.size(); ++i) {
+    const CString name(lines[i].name.ToString());
+    CString lowercase_name(name);
+    lowercase_name.MakeLower();
+    const std::pair<CString, CString> value(lowercase_name,
+                                            lines[i].value.ToString());
+    (*pairs)[name] = values.insert(value).first->second;
   }
 
   return S_OK;
@@ -1348,32 +1353,38 @@ HRESULT ReadNameValuePairsFromFile(const CString& file_path,
 HRESULT WriteNameValuePairsToFile(const CString& file_path,
                                   const CString& group_name,
                                   const std::map<CString, CString>& pairs) {
-  std::map<CString, CString>::const_iterator it = pairs.begin();
-  for (; it != pairs.end(); ++it) {
-    if (!::WritePrivateProfileString(group_name,
-                                     it->first,
-                                     it->second,
-                                     file_path)) {
-      return HRESULTFromLastError();
+  // The file is read and written once for all the pairs, instead of once for
+  // each pair by WritePrivateProfileString. Like WritePrivateProfileString,
+  // nothing is written if there are no pairs.
+  if (pairs.empty()) {
+    return S_OK;
+  }
+
+  std::vector<byte> buffer;
+  if (File::Exists(file_path)) {
+    HRESULT hr = ReadEntireFile(file_path, 0, &buffer);
+    if (FAILED(hr)) {
+      return hr;
     }
   }
 
-  return S_OK;
+  const bool is_unicode = !buffer.empty() &&
+                          IsUnicodeNameValueFile(&buffer.front(),
+                                                 buffer.size());
+  const CString text(buffer.empty() ?
+                     CString() :
+                     DecodeNameValueFile(&buffer.front(), buffer.size()));
+  EncodeNameValueFile(SetNameValuePairs(text, group_name, pairs),
+                      is_unicode,
+                      &buffer);
+  return WriteEntireFile(file_path, buffer);
 }
 
 HRESULT WriteNameValuePairsToHandle(const HANDLE file_handle,
                                     const CString& group_name,
                                     const std::map<CString, CString>& pairs) {
   CString content;
-  SafeCStringAppendFormat(&content, _T("[%s]\r\n"), group_name.GetString());
-  for (std::map<CString, CString>::const_iterator it = pairs.begin();
-       it != pairs.end();
-       ++it) {
-    SafeCStringAppendFormat(&content,
-                            _T("%s=%s\r\n"),
-                            it->first.GetString(),
-                            it->second.GetString());
-  }
+  AppendNameValueSection(group_name, pairs, &content);
   DWORD bytes_written = 0;
   if (!::WriteFile(file_handle,
                    content.GetString(),
@@ -231,14 +231,20 @@ HRESULT OpenUniqueEventFromEnvironment(const CString& var_name,
 // Creates an event based on the provided attributes.
 HRESULT CreateEvent(NamedObjectAttributes* event_attr, HANDLE* event_handle);
 
+// Reads the pairs of the section |group_name| of a name/value file, with the
+// same results as GetPrivateProfileString, in one pass over the file.
 HRESULT ReadNameValuePairsFromFile(const CString& file_path,
                                    const CString& group_name,
                                    std::map<CString, CString>* pairs);
 
+// Sets |pairs| in the section |group_name| of a name/value file, with the
+// same results as WritePrivateProfileString. The other sections and pairs of
+// the file are kept.
 HRESULT WriteNameValuePairsToFile(const CString& file_path,
                                   const CString& group_name,
                                   const std::map<CString, CString>& pairs);
 
+// Writes a section |group_name| with |pairs| to |file_handle|, as UTF-16LE.
 HRESULT WriteNameValuePairsToHandle(const HANDLE file_handle,
                                     const CString& group_name,
                                     const std::map<CString, CString>& pairs);
@@ -1473,6 +1473,40 @@ TEST(GoopdateUtilsTest, ReadNameValuePairsFromFileTest_ReadManyPairs) {
   ValidateStringMapEquality(pairs_write, pairs_read);
 }
 
+TEST(GoopdateUtilsTest, WriteNameValuePairsToFileTest_KeepsOtherPairs) {
+  CString temp_file = GetTempFile();
+  ON_SCOPE_EXIT(::DeleteFile, temp_file.GetString());
+  const char kContent[] = "[other]\r\nname=other\r\n"
+                          "[my_group]\r\nName=old\r\nkept=1\r\n";
+  ASSERT_SUCCEEDED(WriteEntireFile(
+      temp_file,
+      std::vector<byte>(kContent, kContent + arraysize(kContent) - 1)));
+
+  StringMap pairs_write;
+  pairs_write[_T("name")] = _T("new");
+  pairs_write[_T("added")] = _T("\x0d05");
+  ASSERT_SUCCEEDED(WriteNameValuePairsToFile(temp_file,
+                                             _T("my_group"),
+                                             pairs_write));
+
+  StringMap expected_pairs;
+  expected_pairs[_T("Name")] = _T("new");
+  expected_pairs[_T("kept")] = _T("1");
+  expected_pairs[_T("added")] = _T("\x0d05");
+  StringMap pairs_read;
+  ASSERT_SUCCEEDED(ReadNameValuePairsFromFile(temp_file,
+                                              _T("my_group"),
+                                              &pairs_read));
+  ValidateStringMapEquality(expected_pairs, pairs_read);
+
+  expected_pairs.clear();
+  expected_pairs[_T("name")] = _T("other");
+  ASSERT_SUCCEEDED(ReadNameValuePairsFromFile(temp_file,
+                                              _T("other"),
+                                              &pairs_read));
+  ValidateStringMapEquality(expected_pairs, pairs_read);
+}
+
 TEST(GoopdateUtilsTest, WriteInstallerDataToTempFile) {
   CStringA utf8_bom;
   utf8_bom.Format("%c%c%c", 0xEF, 0xBB, 0xBF);
@@ -30,7 +30,7 @@ namespace omaha {
 namespace xml {
 
 struct InstallPackage {
-  InstallPackage() : is_required(false), size(0) {}
+  InstallPackage() : is_required(false), size(0), size_diff(0) {}
 
   CString name;
   CString version;
@@ -38,6 +38,12 @@ struct InstallPackage {
   int size;
   CString hash_sha1;  // base64 encoded.
   CString hash_sha256;  // hex-digit encoded.
+
+  // The patch which rebuilds the package from the package of the installed
+  // version. Empty if the server has no patch for the installed version.
+  CString name_diff;
+  int size_diff;
+  CString hash_diff_sha256;  // hex-digit encoded.
 };
 
 struct InstallAction {
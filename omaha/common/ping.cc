@@ -18,7 +18,6 @@
 #include "omaha/base/constants.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/logging.h"
-#include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/string.h"
@@ -31,6 +30,8 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/experiment_labels.h"
 #include "omaha/common/goopdate_utils.h"
+#include "omaha/common/ping_coalescer.h"
+#include "omaha/common/ping_journal.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
 #include "omaha/goopdate/app.h"
@@ -45,12 +46,27 @@ const TCHAR* const Ping::kRegKeyPersistedPings = _T("PersistedPings");
 const TCHAR* const Ping::kRegValuePersistedPingTime = _T("PersistedPingTime");
 const TCHAR* const Ping::kRegValuePersistedPingString =
     _T("PersistedPingString");
-const time64 Ping::kPersistedPingExpiry100ns  = 10 * kDaysTo100ns;  // 10 days.
 
 // Minimum compatible Omaha version that understands the /ping command line.
 // 1.3.0.0.
 const ULONGLONG kMinOmahaVersionForPingOOP = 0x0001000300000000;
 
+// Sends the requests of the PingCoalescer in-process.
+class InProcessPingSender : public PingSenderInterface {
+ public:
+  explicit InProcessPingSender(bool is_machine) : is_machine_(is_machine) {}
+
+  virtual HRESULT SendPing(const HeadersVector& headers,
+                           const CString& request_string) {
+    return Ping::SendString(is_machine_, headers, request_string);
+  }
+
+ private:
+  const bool is_machine_;
+
+  DISALLOW_COPY_AND_ASSIGN(InProcessPingSender);
+};
+
 Ping::Ping(bool is_machine,
            const CString& session_id,
            const CString& install_source,
@@ -72,6 +88,7 @@ void Ping::Initialize(bool is_machine,
                       const CString& request_id) {
   is_machine_ = is_machine;
   request_id_ = request_id;
+  is_persisted_ = false;
 
   ping_request_.reset(xml::UpdateRequest::Create(is_machine,
                                                  session_id,
@@ -412,21 +429,7 @@ HRESULT Ping::LoadPersistedPings(bool is_machine,
 }
 
 bool Ping::IsPingExpired(time64 persisted_time) {
-  const time64 now = GetCurrent100NSTime();
-
-  if (now < persisted_time) {
-    CORE_LOG(LW, (_T("[Incorrect clock time][%I64u][%I64u]"),
-                  now, persisted_time));
-    return true;
-  }
-
-  const time64 time_difference = now - persisted_time;
-  CORE_LOG(L3, (_T("[%I64u][%I64u][%I64u]"),
-                now, persisted_time, time_difference));
-
-  const bool result = time_difference >= kPersistedPingExpiry100ns;
-  CORE_LOG(L3, (_T("[IsPingExpired][%d]"), result));
-  return result;
+  return PingCoalescer::IsPingExpired(persisted_time);
 }
 
 HRESULT Ping::DeletePersistedPing(bool is_machine,
@@ -448,13 +451,16 @@ HRESULT Ping::DeletePersistedPing(bool is_machine,
 }
 
 void Ping::DeletePersistedPingOnSuccess(const HRESULT& hr) {
-  if (SUCCEEDED(hr)) {
-    VERIFY_SUCCEEDED(DeletePersistedPing(is_machine_, request_id_));
+  if (FAILED(hr) || !is_persisted_) {
+    return;
   }
-}
 
-CString Ping::GetPersistedPingRegPath() {
-  return AppendRegKeyPath(GetPersistedPingsRegPath(is_machine_), request_id_);
+  // Journal writes to the machine install directory need admin.
+  scoped_revert_to_self revert_to_self;
+  PingJournal journal(is_machine_);
+  if (SUCCEEDED(journal.Remove(std::vector<CString>(1, request_id_)))) {
+    is_persisted_ = false;
+  }
 }
 
 HRESULT Ping::PersistPing() {
@@ -465,63 +471,68 @@ HRESULT Ping::PersistPing() {
     return hr;
   }
 
-  CString time_now_str;
-  SafeCStringFormat(&time_now_str, _T("%I64u"), GetCurrent100NSTime());
-  CORE_LOG(L3, (_T("[Ping::PersistPing][%s][%s][%s]"),
-                request_id_, time_now_str, ping_string));
-
-  CString ping_reg_path(GetPersistedPingRegPath());
+  const time64 time_now = GetCurrent100NSTime();
+  CORE_LOG(L3, (_T("[Ping::PersistPing][%s][%I64u][%s]"),
+                request_id_, time_now, ping_string));
 
-  // Registry writes to HKLM need admin.
+  // Journal writes to the machine install directory need admin.
   scoped_revert_to_self revert_to_self;
   ASSERT1(!is_machine_ || vista_util::IsUserAdmin());
 
-  hr = RegKey::SetValue(ping_reg_path,
-                        kRegValuePersistedPingString,
-                        ping_string);
-  if (FAILED(hr)) {
-    return hr;
+  PingJournal journal(is_machine_);
+  hr = journal.Append(PersistedPing(request_id_, time_now, ping_string));
+  if (SUCCEEDED(hr)) {
+    is_persisted_ = true;
   }
-
-  return RegKey::SetValue(ping_reg_path,
-                          kRegValuePersistedPingTime,
-                          time_now_str);
+  return hr;
 }
 
-HRESULT Ping::SendPersistedPings(bool is_machine) {
+HRESULT Ping::MigrateRegistryPersistedPings(bool is_machine,
+                                            PingJournal* journal) {
+  ASSERT1(journal);
+
   PingsVector persisted_pings;
   HRESULT hr = LoadPersistedPings(is_machine, &persisted_pings);
-  if (FAILED(hr) && (hr != HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND))) {
-    return hr;
+  if (FAILED(hr)) {
+    return hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) ? S_OK : hr;
   }
 
   for (size_t i = 0; i != persisted_pings.size(); ++i) {
     const CString& persisted_subkey_name(persisted_pings[i].first);
-    time64 persisted_time = persisted_pings[i].second.first;
-    int32 request_age = Time64ToInt32(GetCurrent100NSTime()) -
-                        Time64ToInt32(persisted_time);
-    const CString& persisted_ping_string(persisted_pings[i].second.second);
+    CORE_LOG(L3, (_T("[Moving persisted ping to journal][%s]"),
+                  persisted_subkey_name));
 
-    CORE_LOG(L3, (_T("[Resending persisted ping][%s][%I64u][%d][%s]"),
-                  persisted_subkey_name,
-                  persisted_time,
-                  request_age,
-                  persisted_ping_string));
+    hr = journal->Append(PersistedPing(persisted_subkey_name,
+                                       persisted_pings[i].second.first,
+                                       persisted_pings[i].second.second));
+    if (FAILED(hr)) {
+      return hr;
+    }
 
-    CString request_age_string;
-    SafeCStringFormat(&request_age_string, _T("%d"), request_age);
-    HeadersVector headers;
-    headers.push_back(std::make_pair(kHeaderXRequestAge, request_age_string));
+    VERIFY_SUCCEEDED(DeletePersistedPing(is_machine, persisted_subkey_name));
+  }
 
-    hr = SendString(is_machine, headers, persisted_ping_string);
+  return S_OK;
+}
 
-    if (SUCCEEDED(hr) || IsPingExpired(persisted_time)) {
-      CORE_LOG(L3, (_T("[Deleting persisted ping][0x%x]"), hr));
-      VERIFY_SUCCEEDED(DeletePersistedPing(is_machine,
-                                            persisted_subkey_name));
-    }
+HRESULT Ping::SendPersistedPings(bool is_machine) {
+  // Journal writes to the machine install directory need admin.
+  scoped_revert_to_self revert_to_self;
+  PingJournal journal(is_machine);
+
+  // Pings persisted by older versions are in the registry.
+  HRESULT hr = MigrateRegistryPersistedPings(is_machine, &journal);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[MigrateRegistryPersistedPings failed][%#x]"), hr));
   }
 
+  InProcessPingSender sender(is_machine);
+  PingCoalescer coalescer(&journal, &sender);
+  hr = coalescer.Flush();
+  CORE_LOG(L3, (_T("[Ping::SendPersistedPings][%#x][%d pings][%d requests]"),
+                hr, coalescer.num_pings_sent(), coalescer.num_requests_sent()));
+
+  // Pings which could not be sent are retried on the next run.
   return S_OK;
 }
 
@@ -77,6 +77,8 @@ namespace omaha {
 
 struct CommandLineExtraArgs;
 class App;
+class InProcessPingSender;
+class PingJournal;
 
 // Loads, builds, serializes, and sends pings. There are two ways to manipulate
 // ping instances. The simplest way is to have another entity, such as
@@ -152,10 +154,12 @@ class Ping {
   // mechanism.
   HRESULT Send(bool is_fire_and_forget);
 
-  // Persists the current Ping object to the registry.
+  // Persists the current Ping object to the ping journal. Persisting the
+  // object again replaces the ping persisted previously.
   HRESULT PersistPing();
 
-  // Sends all persisted pings. Deletes successful or expired pings.
+  // Sends all persisted pings, merging them into as few requests as possible.
+  // Deletes successful or expired pings.
   static HRESULT SendPersistedPings(bool is_machine);
 
   // Sends a ping string to the server, in-process. The ping_string must be web
@@ -178,15 +182,17 @@ class Ping {
   FRIEND_TEST(PingTest, PersistPing_Load_Delete);
   FRIEND_TEST(PingTest, PersistAndSendPersistedPings);
   FRIEND_TEST(PingTest, DISABLED_SendUsingGoogleUpdate);
+  FRIEND_TEST(PingTest, MigrateRegistryPersistedPings);
   FRIEND_TEST(PersistedPingsTest, AddPingEvents);
 
+  friend class InProcessPingSender;
+
   // pair<unique_id, pair<ping_time, ping_string>>.
   typedef
       std::vector<std::pair<CString, std::pair<time64, CString> > > PingsVector;
   static const TCHAR* const kRegKeyPersistedPings;
   static const TCHAR* const kRegValuePersistedPingTime;
   static const TCHAR* const kRegValuePersistedPingString;
-  static const time64 kPersistedPingExpiry100ns;
 
   void Initialize(bool is_machine,
                   const CString& session_id,
@@ -206,7 +212,8 @@ class Ping {
   xml::request::App BuildOmahaApp(const CString& version,
                                   const CString& next_version) const;
 
-  // Persistent Ping utility functions.
+  // Persistent Ping utility functions. Older versions persisted pings in the
+  // registry, under the PersistedPings key.
   static CString GetPersistedPingsRegPath(bool is_machine);
   static HRESULT LoadPersistedPings(bool is_machine,
                                     PingsVector* persisted_pings);
@@ -214,7 +221,10 @@ class Ping {
   static HRESULT DeletePersistedPing(bool is_machine,
                                      const CString& persisted_subkey_name);
   void DeletePersistedPingOnSuccess(const HRESULT& hr);
-  CString GetPersistedPingRegPath();
+
+  // Moves the pings persisted in the registry to the journal.
+  static HRESULT MigrateRegistryPersistedPings(bool is_machine,
+                                               PingJournal* journal);
 
   // Sends a string to the server.
   static HRESULT SendString(bool is_machine,
@@ -224,10 +234,14 @@ class Ping {
   bool is_machine_;
 
   // The request id is the unique key that is sent out in Ping requests to the
-  // Omaha server. Persisted Pings are also stored in the registry under this
+  // Omaha server. Persisted Pings are also stored in the journal under this
   // unique key.
   CString request_id_;
 
+  // True if PersistPing has stored this ping in the journal and the ping has
+  // not been removed from the journal since.
+  bool is_persisted_;
+
   // Information about apps.
   struct AppData {
     AppData() : install_time_diff_sec(0), day_of_install(0) {}
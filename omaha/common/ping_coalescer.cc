@@ -0,0 +1,439 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/ping_coalescer.h"
+
+#include <atlbase.h>
+#include <algorithm>
+#include <map>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+#include "omaha/base/xml_utils.h"
+#include "omaha/common/xml_const.h"
+
+namespace omaha {
+
+namespace {
+
+// A ping request parsed into a DOM. Pings are merged by appending the 'app'
+// elements of the other pings to the 'request' element of the first one.
+struct ParsedPing {
+  ParsedPing() : length(0), apps_length(0), num_events(0) {}
+
+  CComPtr<IXMLDOMDocument> document;
+  CComPtr<IXMLDOMElement> request;
+  std::vector<CComPtr<IXMLDOMNode> > apps;
+
+  // The length of the serialized request and of its 'app' elements.
+  int length;
+  int apps_length;
+
+  int num_events;
+
+  // The 'request' element and its children other than the 'app' elements,
+  // without the session id and the request id. Pings with the same key can
+  // be merged.
+  CString key;
+};
+
+HRESULT GetNodeName(IXMLDOMNode* node, CString* name) {
+  ASSERT1(node);
+  ASSERT1(name);
+
+  CComBSTR node_name;
+  HRESULT hr = node->get_nodeName(&node_name);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  *name = node_name;
+  return S_OK;
+}
+
+HRESULT GetNodeXml(IXMLDOMNode* node, CString* xml) {
+  ASSERT1(node);
+  ASSERT1(xml);
+
+  CComBSTR node_xml;
+  HRESULT hr = node->get_xml(&node_xml);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  *xml = node_xml;
+  return S_OK;
+}
+
+// Returns the key of |request|, without its children.
+HRESULT GetRequestElementKey(IXMLDOMElement* request, CString* key) {
+  ASSERT1(request);
+  ASSERT1(key);
+
+  // A shallow copy of the element has its attributes and no children.
+  CComPtr<IXMLDOMNode> node;
+  HRESULT hr = request->cloneNode(VARIANT_FALSE, &node);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  CComQIPtr<IXMLDOMElement> element(node);
+  if (!element) {
+    return E_NOINTERFACE;
+  }
+
+  hr = element->removeAttribute(CComBSTR(xml::attribute::kRequestId));
+  if (SUCCEEDED(hr)) {
+    hr = element->removeAttribute(CComBSTR(xml::attribute::kSessionId));
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return GetNodeXml(element, key);
+}
+
+HRESULT CountEvents(IXMLDOMNode* app, int* num_events) {
+  ASSERT1(app);
+  ASSERT1(num_events);
+
+  CComQIPtr<IXMLDOMElement> element(app);
+  if (!element) {
+    return E_NOINTERFACE;
+  }
+
+  CComPtr<IXMLDOMNodeList> events;
+  HRESULT hr = element->getElementsByTagName(CComBSTR(xml::element::kEvent),
+                                             &events);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  long length = 0;  // NOLINT
+  hr = events->get_length(&length);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  *num_events = static_cast<int>(length);
+  return S_OK;
+}
+
+HRESULT ParsePing(const CString& ping_string, ParsedPing* parsed_ping) {
+  ASSERT1(parsed_ping);
+
+  HRESULT hr = LoadXMLFromMemory(ping_string, false, &parsed_ping->document);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = parsed_ping->document->get_documentElement(&parsed_ping->request);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (!parsed_ping->request) {
+    return E_UNEXPECTED;
+  }
+
+  CString name;
+  hr = GetNodeName(parsed_ping->request, &name);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (name != xml::element::kRequest) {
+    return E_UNEXPECTED;
+  }
+
+  hr = GetRequestElementKey(parsed_ping->request, &parsed_ping->key);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CComPtr<IXMLDOMNodeList> children;
+  hr = parsed_ping->request->get_childNodes(&children);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  long num_children = 0;  // NOLINT
+  hr = children->get_length(&num_children);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (long i = 0; i != num_children; ++i) {  // NOLINT
+    CComPtr<IXMLDOMNode> child;
+    CString child_name;
+    CString child_xml;
+    hr = children->get_item(i, &child);
+    if (SUCCEEDED(hr)) {
+      hr = GetNodeName(child, &child_name);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = GetNodeXml(child, &child_xml);
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    if (child_name != xml::element::kApp) {
+      parsed_ping->key += child_xml;
+      continue;
+    }
+
+    int num_events = 0;
+    hr = CountEvents(child, &num_events);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    parsed_ping->apps.push_back(child);
+    parsed_ping->apps_length += child_xml.GetLength();
+    parsed_ping->num_events += num_events;
+  }
+
+  CString request_xml;
+  hr = GetNodeXml(parsed_ping->request, &request_xml);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  parsed_ping->length = lstrlen(xml::kXmlDirective) + request_xml.GetLength();
+
+  return S_OK;
+}
+
+// Appends the 'app' elements of the pings at |batch| in |parsed_pings| to the
+// first one, and serializes it with a new request id.
+HRESULT MergePings(const std::vector<ParsedPing>& parsed_pings,
+                   const std::vector<size_t>& batch,
+                   CString* request) {
+  ASSERT1(batch.size() > 1);
+  ASSERT1(request);
+
+  IXMLDOMElement* merged_request = parsed_pings[batch[0]].request;
+  for (size_t i = 1; i != batch.size(); ++i) {
+    const ParsedPing& parsed_ping = parsed_pings[batch[i]];
+    for (size_t j = 0; j != parsed_ping.apps.size(); ++j) {
+      CComPtr<IXMLDOMNode> app;
+      HRESULT hr = parsed_ping.apps[j]->cloneNode(VARIANT_TRUE, &app);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      CComPtr<IXMLDOMNode> appended_app;
+      hr = merged_request->appendChild(app, &appended_app);
+      if (FAILED(hr)) {
+        return hr;
+      }
+    }
+  }
+
+  CString request_id;
+  HRESULT hr = GetGuid(&request_id);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  hr = merged_request->setAttribute(CComBSTR(xml::attribute::kRequestId),
+                                    CComVariant(request_id));
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CString request_xml;
+  hr = GetNodeXml(merged_request, &request_xml);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Like XmlParser::GetXml, the xml directive is added to the serialized
+  // 'request' element.
+  *request = xml::kXmlDirective;
+  *request += request_xml;
+  request->TrimRight(_T("\r\n"));
+  return S_OK;
+}
+
+}  // namespace
+
+const time64 PingCoalescer::kPingExpiry100ns = 10 * kDaysTo100ns;  // 10 days.
+
+PingCoalescer::PingCoalescer(PingJournal* journal, PingSenderInterface* sender)
+    : journal_(journal),
+      sender_(sender),
+      max_request_length_(kDefaultMaxRequestLength),
+      num_requests_sent_(0),
+      num_pings_sent_(0),
+      num_events_sent_(0) {
+  ASSERT1(journal_);
+  ASSERT1(sender_);
+}
+
+PingCoalescer::~PingCoalescer() {
+}
+
+bool PingCoalescer::IsPingExpired(time64 persisted_time) {
+  const time64 now = GetCurrent100NSTime();
+
+  if (now < persisted_time) {
+    CORE_LOG(LW, (_T("[Incorrect clock time][%I64u][%I64u]"),
+                  now, persisted_time));
+    return true;
+  }
+
+  const time64 time_difference = now - persisted_time;
+  CORE_LOG(L3, (_T("[%I64u][%I64u][%I64u]"),
+                now, persisted_time, time_difference));
+
+  const bool result = time_difference >= kPingExpiry100ns;
+  CORE_LOG(L3, (_T("[IsPingExpired][%d]"), result));
+  return result;
+}
+
+HRESULT PingCoalescer::BuildRequests(
+    const PersistedPingVector& pings,
+    std::vector<CString>* requests,
+    std::vector<std::vector<size_t> >* batches,
+    std::vector<int>* num_events) const {
+  ASSERT1(requests);
+  ASSERT1(batches);
+  ASSERT1(num_events);
+
+  requests->clear();
+  batches->clear();
+  num_events->clear();
+
+  std::vector<ParsedPing> parsed_pings(pings.size());
+
+  // Maps the merge key to the batch which the next ping with that key can be
+  // added to. |lengths| holds the length of the merged request of each batch.
+  std::map<CString, size_t> open_batches;
+  std::vector<int> lengths;
+
+  for (size_t i = 0; i != pings.size(); ++i) {
+    ParsedPing& parsed_ping = parsed_pings[i];
+    HRESULT hr = ParsePing(pings[i].ping_string, &parsed_ping);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[PingCoalescer][can't merge ping][%s][%#x]"),
+                    pings[i].request_id, hr));
+      batches->push_back(std::vector<size_t>(1, i));
+      num_events->push_back(0);
+      lengths.push_back(pings[i].ping_string.GetLength());
+      continue;
+    }
+
+    std::map<CString, size_t>::iterator it = open_batches.find(parsed_ping.key);
+    if (it != open_batches.end() &&
+        lengths[it->second] + parsed_ping.apps_length <= max_request_length_) {
+      (*batches)[it->second].push_back(i);
+      (*num_events)[it->second] += parsed_ping.num_events;
+      lengths[it->second] += parsed_ping.apps_length;
+      continue;
+    }
+
+    open_batches[parsed_ping.key] = batches->size();
+    batches->push_back(std::vector<size_t>(1, i));
+    num_events->push_back(parsed_ping.num_events);
+    lengths.push_back(parsed_ping.length);
+  }
+
+  for (size_t i = 0; i != batches->size(); ++i) {
+    const std::vector<size_t>& batch = (*batches)[i];
+    ASSERT1(!batch.empty());
+
+    // A ping which is not merged with other pings is sent as it is, with its
+    // own request id.
+    if (batch.size() == 1) {
+      requests->push_back(pings[batch[0]].ping_string);
+      continue;
+    }
+
+    CString request;
+    HRESULT hr = MergePings(parsed_pings, batch, &request);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[PingCoalescer][MergePings failed][%#x]"), hr));
+      return hr;
+    }
+    requests->push_back(request);
+  }
+
+  return S_OK;
+}
+
+HRESULT PingCoalescer::Flush() {
+  PersistedPingVector pings;
+  HRESULT hr = journal_->Load(&pings);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[PingJournal::Load failed][%#x]"), hr));
+    return hr;
+  }
+
+  std::vector<CString> expired_request_ids;
+  PersistedPingVector pending_pings;
+  for (size_t i = 0; i != pings.size(); ++i) {
+    if (IsPingExpired(pings[i].persisted_time)) {
+      expired_request_ids.push_back(pings[i].request_id);
+    } else {
+      pending_pings.push_back(pings[i]);
+    }
+  }
+  VERIFY_SUCCEEDED(journal_->Remove(expired_request_ids));
+
+  std::vector<CString> requests;
+  std::vector<std::vector<size_t> > batches;
+  std::vector<int> num_events;
+  hr = BuildRequests(pending_pings, &requests, &batches, &num_events);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CORE_LOG(L3, (_T("[PingCoalescer::Flush][%u pings][%u requests]"),
+                pending_pings.size(), requests.size()));
+
+  HRESULT result = S_OK;
+  for (size_t i = 0; i != batches.size(); ++i) {
+    const std::vector<size_t>& batch = batches[i];
+
+    time64 oldest_time = pending_pings[batch[0]].persisted_time;
+    std::vector<CString> request_ids;
+    for (size_t j = 0; j != batch.size(); ++j) {
+      const PersistedPing& ping = pending_pings[batch[j]];
+      oldest_time = std::min(oldest_time, ping.persisted_time);
+      request_ids.push_back(ping.request_id);
+    }
+
+    const int32 request_age = Time64ToInt32(GetCurrent100NSTime()) -
+                              Time64ToInt32(oldest_time);
+    CString request_age_string;
+    SafeCStringFormat(&request_age_string, _T("%d"), request_age);
+    HeadersVector headers;
+    headers.push_back(std::make_pair(kHeaderXRequestAge, request_age_string));
+
+    // The remaining pings are sent by the next flush, so that a client which
+    // is offline does not wait for the network here.
+    hr = sender_->SendPing(headers, requests[i]);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[PingCoalescer][send failed][%#x]"), hr));
+      result = hr;
+      break;
+    }
+
+    ++num_requests_sent_;
+    num_pings_sent_ += static_cast<int>(batch.size());
+    num_events_sent_ += num_events[i];
+    VERIFY_SUCCEEDED(journal_->Remove(request_ids));
+  }
+
+  VERIFY_SUCCEEDED(journal_->Compact());
+  return result;
+}
+
+}  // namespace omaha
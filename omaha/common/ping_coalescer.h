@@ -0,0 +1,98 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PingCoalescer sends the pending pings of a PingJournal in as few requests as
+// possible. The pings are parsed, and the 'app' elements of pings which share
+// the same 'request' element, apart from the session id and the request id,
+// are merged into one request, up to a maximum request size. The merged
+// request has a new request id and keeps the session id of its first ping.
+//
+// The flush stops at the first request which fails to be sent. The remaining
+// pings are kept in the journal and sent by the next flush.
+
+#ifndef OMAHA_COMMON_PING_COALESCER_H_
+#define OMAHA_COMMON_PING_COALESCER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/common/ping_journal.h"
+#include "omaha/common/web_services_client.h"
+
+namespace omaha {
+
+class PingSenderInterface {
+ public:
+  virtual ~PingSenderInterface() {}
+
+  // Sends a ping request. Returns S_OK if the server accepted the request.
+  virtual HRESULT SendPing(const HeadersVector& headers,
+                           const CString& request_string) = 0;
+};
+
+class PingCoalescer {
+ public:
+  // The default maximum size of a merged request, in characters.
+  static const int kDefaultMaxRequestLength = 64 * 1024;
+
+  // Pings older than this are removed without being sent.
+  static const time64 kPingExpiry100ns;
+
+  PingCoalescer(PingJournal* journal, PingSenderInterface* sender);
+  ~PingCoalescer();
+
+  void set_max_request_length(int max_request_length) {
+    max_request_length_ = max_request_length;
+  }
+
+  // Sends the pending pings of the journal and removes the pings which have
+  // been sent or have expired. Returns the error of the request which could
+  // not be sent, if any.
+  HRESULT Flush();
+
+  // Merges |pings| into as few requests as the maximum request length allows.
+  // |batches| receives the indexes in |pings| of the pings in each request,
+  // and |num_events| the number of events in each request. Pings which can't
+  // be parsed are sent as they are, in a request of their own.
+  HRESULT BuildRequests(const PersistedPingVector& pings,
+                        std::vector<CString>* requests,
+                        std::vector<std::vector<size_t> >* batches,
+                        std::vector<int>* num_events) const;
+
+  // Statistics for the lifetime of the object.
+  int num_requests_sent() const { return num_requests_sent_; }
+  int num_pings_sent() const { return num_pings_sent_; }
+  int num_events_sent() const { return num_events_sent_; }
+
+  static bool IsPingExpired(time64 persisted_time);
+
+ private:
+  PingJournal* journal_;
+  PingSenderInterface* sender_;
+
+  int max_request_length_;
+
+  int num_requests_sent_;
+  int num_pings_sent_;
+  int num_events_sent_;
+
+  DISALLOW_COPY_AND_ASSIGN(PingCoalescer);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_PING_COALESCER_H_
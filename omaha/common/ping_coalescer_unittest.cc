@@ -0,0 +1,351 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/ping_coalescer.h"
+
+#include <memory>
+#include <vector>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/file.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+int CountSubstrings(const CString& s, const TCHAR* substring) {
+  int count = 0;
+  for (int pos = s.Find(substring);
+       pos != -1;
+       pos = s.Find(substring, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+// Builds a ping request like the ones Ping serializes, with one app and one
+// event.
+CString BuildPingString(const CString& session_id,
+                        const CString& request_id,
+                        const CString& install_source,
+                        const CString& app_id) {
+  CString ping_string;
+  ping_string.Format(
+      _T("<?xml version=\"1.0\" encoding=\"UTF-8\"?>")
+      _T("<request protocol=\"3.0\" updater=\"Omaha\" ")
+      _T("updaterversion=\"1.3.99.0\" shell_version=\"1.3.99.0\" ")
+      _T("ismachine=\"0\" sessionid=\"%s\" installsource=\"%s\" ")
+      _T("requestid=\"%s\" dedup=\"cr\">")
+      _T("<hw physmemory=\"16\" sse=\"1\" sse2=\"1\"/>")
+      _T("<os platform=\"win\" version=\"10.0\" sp=\"\" arch=\"x64\"/>")
+      _T("<app appid=\"%s\" version=\"1.0.0.0\" nextversion=\"\" ")
+      _T("lang=\"en\" brand=\"GGLS\" client=\"\">")
+      _T("<event eventtype=\"2\" eventresult=\"1\" errorcode=\"0\" ")
+      _T("extracode1=\"0\"/></app></request>"),
+      session_id, install_source, request_id, app_id);
+  return ping_string;
+}
+
+// Stands in for the ping server. Each request takes |latency_ms| to be
+// handled. The first |num_failures| requests fail.
+class FakePingServer : public PingSenderInterface {
+ public:
+  FakePingServer(int latency_ms, int num_failures)
+      : latency_ms_(latency_ms),
+        num_failures_(num_failures),
+        num_apps_received_(0),
+        num_events_received_(0) {}
+
+  virtual HRESULT SendPing(const HeadersVector& headers,
+                           const CString& request_string) {
+    if (latency_ms_) {
+      ::Sleep(latency_ms_);
+    }
+
+    if (num_failures_ > 0) {
+      --num_failures_;
+      return HRESULT_FROM_WIN32(ERROR_NETWORK_UNREACHABLE);
+    }
+
+    EXPECT_EQ(1, headers.size());
+    EXPECT_STREQ(kHeaderXRequestAge, headers[0].first);
+    EXPECT_EQ(1, CountSubstrings(request_string, _T("<request ")));
+    EXPECT_EQ(1, CountSubstrings(request_string, _T("requestid=")));
+    EXPECT_EQ(1, CountSubstrings(request_string, _T("sessionid=")));
+
+    requests_.push_back(request_string);
+    num_apps_received_ += CountSubstrings(request_string, _T("<app "));
+    num_events_received_ += CountSubstrings(request_string, _T("<event "));
+    return S_OK;
+  }
+
+  const std::vector<CString>& requests() const { return requests_; }
+  int num_apps_received() const { return num_apps_received_; }
+  int num_events_received() const { return num_events_received_; }
+
+ private:
+  const int latency_ms_;
+  int num_failures_;
+  std::vector<CString> requests_;
+  int num_apps_received_;
+  int num_events_received_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakePingServer);
+};
+
+}  // namespace
+
+class PingCoalescerTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    file_path_ = GetTempFilename(_T("png"));
+    ASSERT_FALSE(file_path_.IsEmpty());
+    ASSERT_SUCCEEDED(File::Remove(file_path_));
+    journal_.reset(new PingJournal(false, file_path_));
+  }
+
+  virtual void TearDown() {
+    journal_.reset();
+    EXPECT_SUCCEEDED(File::Remove(file_path_));
+  }
+
+  // Appends |num_pings| pings, each from a different session.
+  void AppendPings(int num_pings) {
+    for (int i = 0; i != num_pings; ++i) {
+      CString session_id;
+      CString request_id;
+      CString app_id;
+      EXPECT_SUCCEEDED(GetGuid(&session_id));
+      EXPECT_SUCCEEDED(GetGuid(&request_id));
+      EXPECT_SUCCEEDED(GetGuid(&app_id));
+      EXPECT_SUCCEEDED(journal_->Append(PersistedPing(
+          request_id,
+          GetCurrent100NSTime(),
+          BuildPingString(session_id, request_id, _T("ondemand"), app_id))));
+    }
+  }
+
+  PersistedPingVector LoadPings() {
+    PersistedPingVector pings;
+    EXPECT_SUCCEEDED(journal_->Load(&pings));
+    return pings;
+  }
+
+  CString file_path_;
+  std::unique_ptr<PingJournal> journal_;
+};
+
+TEST_F(PingCoalescerTest, BuildRequests_MergesPingsFromSessions) {
+  PersistedPingVector pings;
+  pings.push_back(PersistedPing(_T("{R1}"), 1, BuildPingString(
+      _T("{S1}"), _T("{R1}"), _T("ondemand"), _T("{A1}"))));
+  pings.push_back(PersistedPing(_T("{R2}"), 1, BuildPingString(
+      _T("{S2}"), _T("{R2}"), _T("ondemand"), _T("{A2}"))));
+  pings.push_back(PersistedPing(_T("{R3}"), 1, BuildPingString(
+      _T("{S3}"), _T("{R3}"), _T("ondemand"), _T("{A3}"))));
+
+  FakePingServer server(0, 0);
+  PingCoalescer coalescer(journal_.get(), &server);
+  std::vector<CString> requests;
+  std::vector<std::vector<size_t> > batches;
+  std::vector<int> num_events;
+  EXPECT_SUCCEEDED(coalescer.BuildRequests(pings,
+                                           &requests,
+                                           &batches,
+                                           &num_events));
+
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(1, batches.size());
+  EXPECT_EQ(3, batches[0].size());
+  ASSERT_EQ(1, num_events.size());
+  EXPECT_EQ(3, num_events[0]);
+
+  const CString& request = requests[0];
+  EXPECT_EQ(1, CountSubstrings(request, _T("<request ")));
+  EXPECT_EQ(1, CountSubstrings(request, _T("<hw ")));
+  EXPECT_EQ(3, CountSubstrings(request, _T("<app ")));
+  EXPECT_EQ(3, CountSubstrings(request, _T("<event ")));
+  EXPECT_EQ(1, CountSubstrings(request, _T("sessionid=\"{S1}\"")));
+  EXPECT_EQ(0, CountSubstrings(request, _T("{S2}")));
+  EXPECT_EQ(1, CountSubstrings(request, _T("requestid=")));
+  EXPECT_EQ(0, CountSubstrings(request, _T("requestid=\"{R1}\"")));
+  EXPECT_NE(-1, request.Find(_T("<app appid=\"{A1}\"")));
+  EXPECT_NE(-1, request.Find(_T("<app appid=\"{A3}\"")));
+  EXPECT_EQ(request.GetLength() - 10, request.Find(_T("</request>")));
+}
+
+TEST_F(PingCoalescerTest, BuildRequests_DifferentRequestsAreNotMerged) {
+  PersistedPingVector pings;
+  pings.push_back(PersistedPing(_T("{R1}"), 1, BuildPingString(
+      _T("{S1}"), _T("{R1}"), _T("ondemand"), _T("{A1}"))));
+  pings.push_back(PersistedPing(_T("{R2}"), 1, BuildPingString(
+      _T("{S2}"), _T("{R2}"), _T("scheduler"), _T("{A2}"))));
+  pings.push_back(PersistedPing(_T("{R3}"), 1, _T("not a request")));
+
+  FakePingServer server(0, 0);
+  PingCoalescer coalescer(journal_.get(), &server);
+  std::vector<CString> requests;
+  std::vector<std::vector<size_t> > batches;
+  std::vector<int> num_events;
+  EXPECT_SUCCEEDED(coalescer.BuildRequests(pings,
+                                           &requests,
+                                           &batches,
+                                           &num_events));
+
+  // Pings which are not merged are sent as they are.
+  ASSERT_EQ(3, requests.size());
+  for (size_t i = 0; i != pings.size(); ++i) {
+    ASSERT_EQ(1, batches[i].size());
+    EXPECT_EQ(i, batches[i][0]);
+    EXPECT_STREQ(pings[i].ping_string, requests[i]);
+  }
+  EXPECT_EQ(1, num_events[0]);
+  EXPECT_EQ(1, num_events[1]);
+  EXPECT_EQ(0, num_events[2]);
+}
+
+TEST_F(PingCoalescerTest, BuildRequests_MaxRequestLength) {
+  PersistedPingVector pings;
+  for (int i = 0; i != 5; ++i) {
+    CString id;
+    id.Format(_T("{%d}"), i);
+    pings.push_back(PersistedPing(id, 1, BuildPingString(
+        id, id, _T("ondemand"), id)));
+  }
+
+  // Leaves room for a little more than two pings in each request.
+  const int max_request_length = pings[0].ping_string.GetLength() * 2 + 100;
+
+  FakePingServer server(0, 0);
+  PingCoalescer coalescer(journal_.get(), &server);
+  coalescer.set_max_request_length(max_request_length);
+  std::vector<CString> requests;
+  std::vector<std::vector<size_t> > batches;
+  std::vector<int> num_events;
+  EXPECT_SUCCEEDED(coalescer.BuildRequests(pings,
+                                           &requests,
+                                           &batches,
+                                           &num_events));
+
+  ASSERT_LT(1, requests.size());
+  ASSERT_GT(pings.size(), requests.size());
+  EXPECT_LT(1, CountSubstrings(requests[0], _T("<app ")));
+
+  int num_apps = 0;
+  for (size_t i = 0; i != requests.size(); ++i) {
+    EXPECT_LE(requests[i].GetLength(), max_request_length);
+    num_apps += CountSubstrings(requests[i], _T("<app "));
+  }
+  EXPECT_EQ(5, num_apps);
+}
+
+TEST_F(PingCoalescerTest, Flush) {
+  AppendPings(10);
+
+  FakePingServer server(0, 0);
+  PingCoalescer coalescer(journal_.get(), &server);
+  EXPECT_SUCCEEDED(coalescer.Flush());
+
+  EXPECT_EQ(1, server.requests().size());
+  EXPECT_EQ(10, server.num_events_received());
+  EXPECT_EQ(1, coalescer.num_requests_sent());
+  EXPECT_EQ(10, coalescer.num_pings_sent());
+  EXPECT_EQ(10, coalescer.num_events_sent());
+
+  EXPECT_TRUE(LoadPings().empty());
+  EXPECT_FALSE(File::Exists(file_path_));
+}
+
+TEST_F(PingCoalescerTest, Flush_KeepsPingsWhichAreNotSent) {
+  AppendPings(3);
+
+  // The flush does not retry, and the pings are sent by the next flush.
+  FakePingServer server(0, 1);
+  PingCoalescer coalescer(journal_.get(), &server);
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_NETWORK_UNREACHABLE),
+            coalescer.Flush());
+  EXPECT_EQ(0, coalescer.num_requests_sent());
+  EXPECT_TRUE(server.requests().empty());
+  EXPECT_EQ(3, LoadPings().size());
+
+  EXPECT_SUCCEEDED(coalescer.Flush());
+  EXPECT_EQ(1, server.requests().size());
+  EXPECT_EQ(3, coalescer.num_pings_sent());
+  EXPECT_TRUE(LoadPings().empty());
+}
+
+TEST_F(PingCoalescerTest, Flush_StopsAtFirstFailure) {
+  AppendPings(3);
+
+  // Each ping is sent in a request of its own. The first request fails, so
+  // the other requests are not sent, although the server would accept them.
+  FakePingServer server(0, 1);
+  PingCoalescer coalescer(journal_.get(), &server);
+  coalescer.set_max_request_length(0);
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_NETWORK_UNREACHABLE), coalescer.Flush());
+  EXPECT_TRUE(server.requests().empty());
+  EXPECT_EQ(3, LoadPings().size());
+
+  EXPECT_SUCCEEDED(coalescer.Flush());
+  EXPECT_EQ(3, server.requests().size());
+  EXPECT_TRUE(LoadPings().empty());
+}
+
+TEST_F(PingCoalescerTest, Flush_RemovesExpiredPings) {
+  const time64 expired_time =
+      GetCurrent100NSTime() - PingCoalescer::kPingExpiry100ns - 1;
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(
+      _T("{R1}"),
+      expired_time,
+      BuildPingString(_T("{S1}"), _T("{R1}"), _T("ondemand"), _T("{A1}")))));
+  AppendPings(1);
+
+  FakePingServer server(0, 0);
+  PingCoalescer coalescer(journal_.get(), &server);
+  EXPECT_SUCCEEDED(coalescer.Flush());
+
+  ASSERT_EQ(1, server.requests().size());
+  EXPECT_EQ(-1, server.requests()[0].Find(_T("{A1}")));
+  EXPECT_EQ(1, coalescer.num_pings_sent());
+  EXPECT_TRUE(LoadPings().empty());
+}
+
+// Drains 1000 queued pings, sending the pings one at a time as
+// SendPersistedPings used to, and merging them.
+TEST_F(PingCoalescerTest, DrainThousandPings) {
+  const int kNumPings = 1000;
+
+  AppendPings(kNumPings);
+  FakePingServer one_at_a_time_server(0, 0);
+  PingCoalescer one_at_a_time(journal_.get(), &one_at_a_time_server);
+  one_at_a_time.set_max_request_length(0);
+  EXPECT_SUCCEEDED(one_at_a_time.Flush());
+
+  AppendPings(kNumPings);
+  FakePingServer coalesced_server(0, 0);
+  PingCoalescer coalesced(journal_.get(), &coalesced_server);
+  EXPECT_SUCCEEDED(coalesced.Flush());
+
+  EXPECT_EQ(kNumPings, one_at_a_time.num_requests_sent());
+  EXPECT_EQ(kNumPings, one_at_a_time_server.num_events_received());
+  EXPECT_EQ(kNumPings, coalesced_server.num_events_received());
+  EXPECT_GT(kNumPings / 50, coalesced.num_requests_sent());
+  EXPECT_TRUE(LoadPings().empty());
+}
+
+}  // namespace omaha
@@ -0,0 +1,379 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/ping_journal.h"
+
+#include <stdlib.h>
+#include <map>
+
+#include "omaha/base/const_object_names.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/path.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/config_manager.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+CStringA EncodePingString(const CString& ping_string) {
+  CStringA ping_string_base64;
+  WebSafeBase64Escape(WideToUtf8(ping_string), &ping_string_base64);
+  return ping_string_base64;
+}
+
+bool DecodePingString(const CStringA& ping_string_base64,
+                      CString* ping_string) {
+  ASSERT1(ping_string);
+
+  CStringA ping_string_utf8;
+  const int out_buffer_length = ping_string_base64.GetLength();
+  char* out_buffer = ping_string_utf8.GetBufferSetLength(out_buffer_length);
+  const int num_chars = WebSafeBase64Unescape(ping_string_base64,
+                                              ping_string_base64.GetLength(),
+                                              out_buffer,
+                                              out_buffer_length);
+  if (num_chars < 0) {
+    return false;
+  }
+  ping_string_utf8.ReleaseBufferSetLength(num_chars);
+
+  *ping_string = Utf8ToWideChar(ping_string_utf8, ping_string_utf8.GetLength());
+  return true;
+}
+
+// Returns the next space-separated field of |line| starting at |*pos|.
+CStringA NextField(const CStringA& line, int* pos) {
+  ASSERT1(pos);
+
+  if (*pos >= line.GetLength()) {
+    return CStringA();
+  }
+
+  int end = line.Find(' ', *pos);
+  if (end == -1) {
+    end = line.GetLength();
+  }
+
+  const CStringA field(line.Mid(*pos, end - *pos));
+  *pos = end + 1;
+  return field;
+}
+
+}  // namespace
+
+const TCHAR* const PingJournal::kJournalFileName = _T("PersistedPings.log");
+
+PingJournal::PingJournal(bool is_machine)
+    : file_path_(GetJournalPath(is_machine)) {
+  Initialize(is_machine);
+}
+
+PingJournal::PingJournal(bool is_machine, const CString& file_path)
+    : file_path_(file_path) {
+  Initialize(is_machine);
+}
+
+PingJournal::~PingJournal() {
+}
+
+void PingJournal::Initialize(bool is_machine) {
+  NamedObjectAttributes lock_attr;
+  GetNamedObjectAttributes(kPingJournalSerializer, is_machine, &lock_attr);
+  if (!lock_.InitializeWithSecAttr(lock_attr.name, &lock_attr.sa)) {
+    CORE_LOG(LW, (_T("[PingJournal][lock init failed][%u]"),
+                  ::GetLastError()));
+  }
+}
+
+CString PingJournal::GetJournalPath(bool is_machine) {
+  const ConfigManager& cm = *ConfigManager::Instance();
+  const CString install_dir = is_machine ?
+      cm.GetMachineGoopdateInstallDir() : cm.GetUserGoopdateInstallDir();
+  return ConcatenatePath(install_dir, kJournalFileName);
+}
+
+HRESULT PingJournal::Append(const PersistedPing& ping) {
+  ASSERT1(!ping.request_id.IsEmpty());
+  ASSERT1(ping.request_id.Find(_T(' ')) == -1);
+
+  CStringA record;
+  SafeCStringAFormat(&record, "%c %s %I64u %s\n",
+                     kPingRecord,
+                     WideToUtf8(ping.request_id),
+                     ping.persisted_time,
+                     EncodePingString(ping.ping_string));
+
+  __mutexScope(lock_);
+  return AppendRecords(record);
+}
+
+HRESULT PingJournal::Remove(const std::vector<CString>& request_ids) {
+  if (request_ids.empty()) {
+    return S_OK;
+  }
+
+  CStringA records;
+  for (size_t i = 0; i != request_ids.size(); ++i) {
+    SafeCStringAAppendFormat(&records, "%c %s\n",
+                             kDeleteRecord,
+                             WideToUtf8(request_ids[i]));
+  }
+
+  __mutexScope(lock_);
+  return AppendRecords(records);
+}
+
+HRESULT PingJournal::Load(PersistedPingVector* pings) {
+  ASSERT1(pings);
+
+  int num_records = 0;
+  __mutexScope(lock_);
+  HRESULT hr = LoadRecords(pings, &num_records);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Each sent ping leaves a delete record behind, so the journal of a process
+  // which never compacts it grows with every ping.
+  if (num_records >= kMinRecordsToCompactOnLoad &&
+      HasMostlyObsoleteRecords(pings->size(), num_records)) {
+    CORE_LOG(L3, (_T("[PingJournal::Load][compacting][%d records][%u pings]"),
+                  num_records, pings->size()));
+    hr = RewriteRecords(*pings);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[PingJournal::Load][compaction failed][%#x]"), hr));
+    }
+  }
+
+  return S_OK;
+}
+
+HRESULT PingJournal::Compact() {
+  __mutexScope(lock_);
+
+  PersistedPingVector pings;
+  int num_records = 0;
+  HRESULT hr = LoadRecords(&pings, &num_records);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (!HasMostlyObsoleteRecords(pings.size(), num_records)) {
+    return S_FALSE;
+  }
+
+  CORE_LOG(L3, (_T("[PingJournal::Compact][%d records][%u pings]"),
+                num_records, pings.size()));
+  return RewriteRecords(pings);
+}
+
+bool PingJournal::HasMostlyObsoleteRecords(size_t num_pings, int num_records) {
+  return static_cast<size_t>(num_records) >= 2 * num_pings;
+}
+
+HRESULT PingJournal::RewriteRecords(const PersistedPingVector& pings) {
+  if (pings.empty()) {
+    return File::Remove(file_path_);
+  }
+
+  CStringA records;
+  for (size_t i = 0; i != pings.size(); ++i) {
+    SafeCStringAAppendFormat(&records, "%c %s %I64u %s\n",
+                             kPingRecord,
+                             WideToUtf8(pings[i].request_id),
+                             pings[i].persisted_time,
+                             EncodePingString(pings[i].ping_string));
+  }
+
+  // The new journal is written aside and then moved over the old one, so that
+  // the pending pings survive a crash during compaction.
+  const CString temp_file_path(file_path_ + _T(".tmp"));
+  std::vector<byte> buffer(records.GetString(),
+                           records.GetString() + records.GetLength());
+  HRESULT hr = WriteEntireFile(temp_file_path, buffer);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[WriteEntireFile failed][%s][%#x]"),
+                  temp_file_path, hr));
+    return hr;
+  }
+
+  return File::Move(temp_file_path, file_path_, true);
+}
+
+HRESULT PingJournal::AppendRecords(const CStringA& records) {
+  ASSERT1(!records.IsEmpty());
+
+  // The file is shared for writing in case the named mutex could not be
+  // created, in which case the appends of the processes are not serialized.
+  scoped_hfile file(::CreateFile(file_path_,
+                                 FILE_READ_DATA | FILE_APPEND_DATA,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                 NULL,
+                                 OPEN_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL,
+                                 NULL));
+  if (!file) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[PingJournal][failed to open][%s][%#x]"),
+                  file_path_, hr));
+    return hr;
+  }
+
+  // A previous append may have been cut short, for instance by a crash or a
+  // full disk. The incomplete record is terminated so that it does not corrupt
+  // the records appended after it.
+  CStringA terminated_records(records);
+  LARGE_INTEGER file_size = {};
+  if (!::GetFileSizeEx(get(file), &file_size)) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[PingJournal][failed to get size][%#x]"), hr));
+    return hr;
+  }
+  if (file_size.QuadPart > 0) {
+    LARGE_INTEGER last_char_offset = {};
+    last_char_offset.QuadPart = file_size.QuadPart - 1;
+    char last_char = 0;
+    DWORD bytes_read = 0;
+    if (!::SetFilePointerEx(get(file), last_char_offset, NULL, FILE_BEGIN) ||
+        !::ReadFile(get(file), &last_char, 1, &bytes_read, NULL)) {
+      const HRESULT hr = HRESULTFromLastError();
+      CORE_LOG(LE, (_T("[PingJournal][failed to read][%#x]"), hr));
+      return hr;
+    }
+    if (bytes_read == 1 && last_char != '\n') {
+      CORE_LOG(LW, (_T("[PingJournal][terminating incomplete record]")));
+      terminated_records.Insert(0, '\n');
+    }
+  }
+
+  // The data is written at the end of the file regardless of the file pointer,
+  // since the file is opened for appending only.
+  DWORD bytes_written = 0;
+  if (!::WriteFile(get(file),
+                   terminated_records.GetString(),
+                   terminated_records.GetLength(),
+                   &bytes_written,
+                   NULL)) {
+    const HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[PingJournal][failed to write][%#x]"), hr));
+    return hr;
+  }
+
+  ASSERT1(bytes_written == static_cast<DWORD>(terminated_records.GetLength()));
+  return S_OK;
+}
+
+HRESULT PingJournal::LoadRecords(PersistedPingVector* pings,
+                                 int* num_records) {
+  ASSERT1(pings);
+  ASSERT1(num_records);
+
+  pings->clear();
+  *num_records = 0;
+
+  if (!File::Exists(file_path_)) {
+    return S_OK;
+  }
+
+  std::vector<byte> buffer;
+  HRESULT hr = ReadEntireFileShareMode(file_path_,
+                                       0,
+                                       FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                       &buffer);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[PingJournal][failed to read][%s][%#x]"),
+                  file_path_, hr));
+    return hr;
+  }
+
+  // Maps the lowercase request ids to their index in |pending|. The entries
+  // of the removed pings are left in |pending| with an empty request id.
+  std::map<CString, size_t> index;
+  PersistedPingVector pending;
+
+  const char* const data = reinterpret_cast<const char*>(buffer.data());
+  const size_t size = buffer.size();
+  size_t line_start = 0;
+  for (size_t i = 0; i != size; ++i) {
+    if (data[i] != '\n') {
+      continue;
+    }
+
+    const CStringA line(data + line_start, static_cast<int>(i - line_start));
+    line_start = i + 1;
+    ++*num_records;
+
+    int pos = 0;
+    const CStringA type(NextField(line, &pos));
+    const CStringA request_id_utf8(NextField(line, &pos));
+    const CString request_id(Utf8ToWideChar(request_id_utf8,
+                                            request_id_utf8.GetLength()));
+    CString request_id_key(request_id);
+    request_id_key.MakeLower();
+
+    if (type.GetLength() != 1 || request_id.IsEmpty()) {
+      CORE_LOG(LW, (_T("[PingJournal][invalid record][%d]"), *num_records));
+      continue;
+    }
+
+    if (type[0] == kDeleteRecord) {
+      std::map<CString, size_t>::iterator it = index.find(request_id_key);
+      if (it != index.end()) {
+        pending[it->second].request_id.Empty();
+        index.erase(it);
+      }
+      continue;
+    }
+
+    const time64 persisted_time = _strtoui64(NextField(line, &pos), NULL, 10);
+    CString ping_string;
+    if (type[0] != kPingRecord ||
+        persisted_time == 0 ||
+        !DecodePingString(NextField(line, &pos), &ping_string)) {
+      CORE_LOG(LW, (_T("[PingJournal][invalid record][%d]"), *num_records));
+      continue;
+    }
+
+    const PersistedPing ping(request_id, persisted_time, ping_string);
+    std::map<CString, size_t>::iterator it = index.find(request_id_key);
+    if (it != index.end()) {
+      pending[it->second] = ping;
+    } else {
+      index[request_id_key] = pending.size();
+      pending.push_back(ping);
+    }
+  }
+
+  if (line_start != size) {
+    CORE_LOG(LW, (_T("[PingJournal][ignoring incomplete record]")));
+  }
+
+  for (size_t i = 0; i != pending.size(); ++i) {
+    if (!pending[i].request_id.IsEmpty()) {
+      pings->push_back(pending[i]);
+    }
+  }
+
+  return S_OK;
+}
+
+}  // namespace omaha
@@ -0,0 +1,103 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// PingJournal stores the pings which have not been sent yet in a single
+// append-only file. Each line of the file is a record:
+//   P <request id> <persisted time> <web safe base64 of the UTF-8 ping>
+//   D <request id>
+// A "P" record adds or replaces the ping with the request id and a "D" record
+// removes it. The pending pings are obtained by replaying the records in
+// order. An incomplete last line, left by a process which crashed or ran out
+// of disk space while appending to the file, is ignored; the next record is
+// appended on a new line after it.
+//
+// The journal is shared by all Omaha processes of the user or the machine.
+// A named mutex serializes the access to the file.
+
+#ifndef OMAHA_COMMON_PING_JOURNAL_H_
+#define OMAHA_COMMON_PING_JOURNAL_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/base/time.h"
+
+namespace omaha {
+
+struct PersistedPing {
+  PersistedPing() : persisted_time(0) {}
+  PersistedPing(const CString& id, time64 time, const CString& ping)
+      : request_id(id), persisted_time(time), ping_string(ping) {}
+
+  CString request_id;
+  time64 persisted_time;
+  CString ping_string;
+};
+
+typedef std::vector<PersistedPing> PersistedPingVector;
+
+class PingJournal {
+ public:
+  // Uses the journal in the Omaha install directory.
+  explicit PingJournal(bool is_machine);
+  PingJournal(bool is_machine, const CString& file_path);
+  ~PingJournal();
+
+  static CString GetJournalPath(bool is_machine);
+
+  // Appends a ping. The ping replaces any pending ping with the same request
+  // id, which happens when a bundle persists its ping after each ping event.
+  HRESULT Append(const PersistedPing& ping);
+
+  // Removes the pending pings with the given request ids.
+  HRESULT Remove(const std::vector<CString>& request_ids);
+
+  // Returns the pending pings, in the order they were first appended. The file
+  // is compacted if it has many records and most of them are obsolete.
+  HRESULT Load(PersistedPingVector* pings);
+
+  // Rewrites the file so that it only contains the pending pings, or deletes
+  // the file if there are no pending pings. Does nothing if less than half of
+  // the records are obsolete.
+  HRESULT Compact();
+
+  const CString& file_path() const { return file_path_; }
+
+ private:
+  void Initialize(bool is_machine);
+  HRESULT AppendRecords(const CStringA& records);
+  HRESULT LoadRecords(PersistedPingVector* pings, int* num_records);
+  HRESULT RewriteRecords(const PersistedPingVector& pings);
+
+  // Returns true if less than half of the records are pending pings.
+  static bool HasMostlyObsoleteRecords(size_t num_pings, int num_records);
+
+  static const char kPingRecord = 'P';
+  static const char kDeleteRecord = 'D';
+  static const int kMinRecordsToCompactOnLoad = 100;
+  static const TCHAR* const kJournalFileName;
+
+  CString file_path_;
+  GLock lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(PingJournal);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_PING_JOURNAL_H_
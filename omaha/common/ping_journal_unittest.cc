@@ -0,0 +1,222 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/ping_journal.h"
+
+#include <memory>
+#include <vector>
+
+#include "omaha/base/file.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class PingJournalTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    file_path_ = GetTempFilename(_T("png"));
+    ASSERT_FALSE(file_path_.IsEmpty());
+    ASSERT_SUCCEEDED(File::Remove(file_path_));
+    journal_.reset(new PingJournal(false, file_path_));
+  }
+
+  virtual void TearDown() {
+    journal_.reset();
+    EXPECT_SUCCEEDED(File::Remove(file_path_));
+  }
+
+  uint32 GetFileSize() {
+    uint32 file_size = 0;
+    EXPECT_SUCCEEDED(File::GetFileSizeUnopen(file_path_, &file_size));
+    return file_size;
+  }
+
+  CString file_path_;
+  std::unique_ptr<PingJournal> journal_;
+};
+
+TEST_F(PingJournalTest, Load_NoJournal) {
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  EXPECT_TRUE(pings.empty());
+}
+
+TEST_F(PingJournalTest, AppendAndLoad) {
+  EXPECT_SUCCEEDED(journal_->Append(
+      PersistedPing(_T("{A}"), 100, _T("<request>ping 1</request>"))));
+  EXPECT_SUCCEEDED(journal_->Append(
+      PersistedPing(_T("{B}"), 200, _T("ping\r\n2 \x00e9"))));
+
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(2, pings.size());
+  EXPECT_STREQ(_T("{A}"), pings[0].request_id);
+  EXPECT_EQ(100, pings[0].persisted_time);
+  EXPECT_STREQ(_T("<request>ping 1</request>"), pings[0].ping_string);
+  EXPECT_STREQ(_T("{B}"), pings[1].request_id);
+  EXPECT_EQ(200, pings[1].persisted_time);
+  EXPECT_STREQ(_T("ping\r\n2 \x00e9"), pings[1].ping_string);
+}
+
+TEST_F(PingJournalTest, Append_ReplacesPingWithSameRequestId) {
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{A}"), 100, _T("a1"))));
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{B}"), 100, _T("b1"))));
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{a}"), 300, _T("a2"))));
+
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(2, pings.size());
+  EXPECT_STREQ(_T("a2"), pings[0].ping_string);
+  EXPECT_EQ(300, pings[0].persisted_time);
+  EXPECT_STREQ(_T("b1"), pings[1].ping_string);
+}
+
+TEST_F(PingJournalTest, Remove) {
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{A}"), 100, _T("a"))));
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{B}"), 100, _T("b"))));
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{C}"), 100, _T("c"))));
+
+  std::vector<CString> request_ids;
+  request_ids.push_back(_T("{A}"));
+  request_ids.push_back(_T("{c}"));
+  request_ids.push_back(_T("{NotPersisted}"));
+  EXPECT_SUCCEEDED(journal_->Remove(request_ids));
+
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(1, pings.size());
+  EXPECT_STREQ(_T("{B}"), pings[0].request_id);
+
+  // A ping can be persisted again after it has been removed.
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{A}"), 100, _T("a"))));
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(2, pings.size());
+  EXPECT_STREQ(_T("{A}"), pings[1].request_id);
+}
+
+TEST_F(PingJournalTest, Load_IgnoresIncompleteAndInvalidRecords) {
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{A}"), 100, _T("a"))));
+
+  const char kRecords[] = "X {B} 100 YQ==\nP {C} 0 Yw==\nP {D} 100 ZA";
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_path_, true, false));
+  uint32 file_size = 0;
+  ASSERT_SUCCEEDED(file.GetLength(&file_size));
+  ASSERT_SUCCEEDED(file.SeekFromBegin(file_size));
+  uint32 bytes_written = 0;
+  ASSERT_SUCCEEDED(file.Write(reinterpret_cast<const byte*>(kRecords),
+                              arraysize(kRecords) - 1,
+                              &bytes_written));
+  ASSERT_SUCCEEDED(file.Close());
+
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(1, pings.size());
+  EXPECT_STREQ(_T("{A}"), pings[0].request_id);
+}
+
+// The record appended after an incomplete record starts on a new line.
+TEST_F(PingJournalTest, Append_AfterIncompleteRecord) {
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{A}"), 100, _T("a"))));
+
+  const char kRecord[] = "P {B} 100 Y";
+  File file;
+  ASSERT_SUCCEEDED(file.Open(file_path_, true, false));
+  uint32 file_size = 0;
+  ASSERT_SUCCEEDED(file.GetLength(&file_size));
+  ASSERT_SUCCEEDED(file.SeekFromBegin(file_size));
+  uint32 bytes_written = 0;
+  ASSERT_SUCCEEDED(file.Write(reinterpret_cast<const byte*>(kRecord),
+                              arraysize(kRecord) - 1,
+                              &bytes_written));
+  ASSERT_SUCCEEDED(file.Close());
+
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{C}"), 100, _T("c"))));
+
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(2, pings.size());
+  EXPECT_STREQ(_T("{A}"), pings[0].request_id);
+  EXPECT_STREQ(_T("{C}"), pings[1].request_id);
+  EXPECT_STREQ(_T("c"), pings[1].ping_string);
+}
+
+TEST_F(PingJournalTest, Load_CompactsMostlyObsoleteJournal) {
+  std::vector<CString> request_ids;
+  for (int i = 0; i != 60; ++i) {
+    CString request_id;
+    request_id.Format(_T("{%d}"), i);
+    EXPECT_SUCCEEDED(journal_->Append(PersistedPing(request_id, 100 + i,
+                                                    _T("ping"))));
+    request_ids.push_back(request_id);
+  }
+  request_ids.pop_back();
+  EXPECT_SUCCEEDED(journal_->Remove(request_ids));
+
+  const uint32 file_size = GetFileSize();
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(1, pings.size());
+  EXPECT_STREQ(_T("{59}"), pings[0].request_id);
+  EXPECT_GT(file_size, GetFileSize());
+
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(1, pings.size());
+  EXPECT_STREQ(_T("{59}"), pings[0].request_id);
+}
+
+TEST_F(PingJournalTest, Compact_DeletesEmptyJournal) {
+  EXPECT_SUCCEEDED(journal_->Append(PersistedPing(_T("{A}"), 100, _T("a"))));
+  EXPECT_SUCCEEDED(journal_->Remove(std::vector<CString>(1, _T("{A}"))));
+  EXPECT_TRUE(File::Exists(file_path_));
+
+  EXPECT_SUCCEEDED(journal_->Compact());
+  EXPECT_FALSE(File::Exists(file_path_));
+}
+
+TEST_F(PingJournalTest, Compact_RewritesPendingPings) {
+  for (int i = 0; i != 10; ++i) {
+    CString request_id;
+    request_id.Format(_T("{%d}"), i);
+    EXPECT_SUCCEEDED(journal_->Append(PersistedPing(request_id, 100 + i,
+                                                    _T("ping"))));
+  }
+
+  // Not enough obsolete records to rewrite the file.
+  EXPECT_EQ(S_FALSE, journal_->Compact());
+
+  std::vector<CString> request_ids;
+  for (int i = 0; i != 8; ++i) {
+    CString request_id;
+    request_id.Format(_T("{%d}"), i);
+    request_ids.push_back(request_id);
+  }
+  EXPECT_SUCCEEDED(journal_->Remove(request_ids));
+
+  const uint32 file_size = GetFileSize();
+  EXPECT_EQ(S_OK, journal_->Compact());
+  EXPECT_GT(file_size, GetFileSize());
+
+  PersistedPingVector pings;
+  EXPECT_SUCCEEDED(journal_->Load(&pings));
+  ASSERT_EQ(2, pings.size());
+  EXPECT_STREQ(_T("{8}"), pings[0].request_id);
+  EXPECT_EQ(108, pings[0].persisted_time);
+  EXPECT_STREQ(_T("{9}"), pings[1].request_id);
+  EXPECT_EQ(109, pings[1].persisted_time);
+}
+
+}  // namespace omaha
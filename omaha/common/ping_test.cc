@@ -24,6 +24,8 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/ping.h"
+#include "omaha/common/ping_coalescer.h"
+#include "omaha/common/ping_journal.h"
 #include "omaha/goopdate/app_unittest_base.h"
 #include "omaha/testing/unit_test.h"
 
@@ -33,10 +35,12 @@ class PingTest : public testing::Test {
  protected:
   virtual void SetUp() {
     RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    File::Remove(PingJournal::GetJournalPath(false));
   }
 
   virtual void TearDown() {
     RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    File::Remove(PingJournal::GetJournalPath(false));
   }
 };
 
@@ -51,6 +55,7 @@ class PersistedPingsTest : public AppTestBase {
     AppTestBase::SetUp();
 
     RegKey::DeleteKey(USER_REG_UPDATE _T("\\PersistedPings"));
+    File::Remove(PingJournal::GetJournalPath(false));
 
     const TCHAR* const kAppId1 = _T("{DDE97E2B-A82C-4790-A630-FCA02F64E8BE}");
     EXPECT_SUCCEEDED(
@@ -259,7 +264,7 @@ TEST_F(PingTest, SendInProcess) {
 
 TEST_F(PingTest, IsPingExpired_PastTime) {
   const time64 time = GetCurrent100NSTime() -
-                      (Ping::kPersistedPingExpiry100ns + 1);
+                      (PingCoalescer::kPingExpiry100ns + 1);
   EXPECT_TRUE(Ping::IsPingExpired(time));
 }
 
@@ -336,31 +341,66 @@ TEST_F(PingTest, PersistAndSendPersistedPings) {
   time64 past(GetCurrent100NSTime());
   EXPECT_HRESULT_SUCCEEDED(install_ping.PersistPing());
 
-  CString reg_path(Ping::GetPersistedPingsRegPath(false));
-  CString ping_subkey_path(AppendRegKeyPath(reg_path,
-                                            install_ping.request_id_));
-  EXPECT_TRUE(RegKey::HasKey(ping_subkey_path));
+  PingJournal journal(false);
+  PersistedPingVector persisted_pings;
+  EXPECT_HRESULT_SUCCEEDED(journal.Load(&persisted_pings));
+  ASSERT_EQ(1, persisted_pings.size());
+  EXPECT_STREQ(install_ping.request_id_, persisted_pings[0].request_id);
 
-  CString persisted_time_string;
-  EXPECT_HRESULT_SUCCEEDED(RegKey::GetValue(ping_subkey_path,
-                                            Ping::kRegValuePersistedPingTime,
-                                            &persisted_time_string));
-  time64 persisted_time = _tcstoui64(persisted_time_string, NULL, 10);
+  time64 persisted_time = persisted_pings[0].persisted_time;
   EXPECT_LE(past, persisted_time);
   EXPECT_GE(GetCurrent100NSTime(), persisted_time);
 
-  CString persisted_ping;
-  EXPECT_HRESULT_SUCCEEDED(RegKey::GetValue(ping_subkey_path,
-                                            Ping::kRegValuePersistedPingString,
-                                            &persisted_ping));
+  const CString persisted_ping(persisted_pings[0].ping_string);
   EXPECT_NE(-1, persisted_ping.Find(_T("sessionid=\"unittest\"")));
   EXPECT_NE(-1, persisted_ping.Find(_T("<app appid=\"") GOOPDATE_APP_ID _T("\" version=\"1.0.0.0\" nextversion=\"2.0.0.0\" lang=\"en\" brand=\"GGLS\" client=\"a client id\" iid=\"{DE06587E-E5AB-4364-A46B-F3AC733007B3}\"><event eventtype=\"2\" eventresult=\"1\" errorcode=\"0\" extracode1=\"0\"/></app>")));  // NOLINT
 
   EXPECT_HRESULT_SUCCEEDED(Ping::SendPersistedPings(false));
 
+  EXPECT_HRESULT_SUCCEEDED(journal.Load(&persisted_pings));
+  EXPECT_EQ(0, persisted_pings.size());
+  EXPECT_FALSE(File::Exists(journal.file_path()));
+}
+
+TEST_F(PingTest, MigrateRegistryPersistedPings) {
+  CString pings_reg_path(Ping::GetPersistedPingsRegPath(false));
+
+  for (size_t i = 0; i < 3; ++i) {
+    CString i_str(String_DigitToChar(i + 1));
+    CString ping_reg_path(AppendRegKeyPath(pings_reg_path,
+                                           _T("TestKey") + i_str));
+    EXPECT_HRESULT_SUCCEEDED(RegKey::SetValue(ping_reg_path,
+                                              Ping::kRegValuePersistedPingTime,
+                                              i_str));
+    EXPECT_HRESULT_SUCCEEDED(RegKey::SetValue(
+        ping_reg_path,
+        Ping::kRegValuePersistedPingString,
+        _T("Test Ping ") + i_str));
+  }
+
+  PingJournal journal(false);
+  EXPECT_HRESULT_SUCCEEDED(Ping::MigrateRegistryPersistedPings(false,
+                                                               &journal));
+
+  PersistedPingVector persisted_pings;
+  EXPECT_HRESULT_SUCCEEDED(journal.Load(&persisted_pings));
+  ASSERT_EQ(3, persisted_pings.size());
+  for (size_t i = 0; i < persisted_pings.size(); ++i) {
+    CString i_str(String_DigitToChar(i + 1));
+    EXPECT_STREQ(_T("TestKey") + i_str, persisted_pings[i].request_id);
+    EXPECT_EQ(i + 1, persisted_pings[i].persisted_time);
+    EXPECT_STREQ(_T("Test Ping ") + i_str, persisted_pings[i].ping_string);
+  }
+
   RegKey pings_reg_key;
-  pings_reg_key.Open(reg_path, KEY_READ);
+  pings_reg_key.Open(pings_reg_path, KEY_READ);
   EXPECT_EQ(0, pings_reg_key.GetSubkeyCount());
+
+  // Nothing is left to migrate.
+  EXPECT_HRESULT_SUCCEEDED(Ping::MigrateRegistryPersistedPings(false,
+                                                               &journal));
+  EXPECT_HRESULT_SUCCEEDED(journal.Load(&persisted_pings));
+  EXPECT_EQ(3, persisted_pings.size());
 }
 
 // The tests below rely on the out-of-process mechanism to send install pings.
@@ -469,16 +509,19 @@ TEST_F(PersistedPingsTest, AddPingEvents) {
     app_->AddPingEvent(ping_event);
   }
 
-  Ping::PingsVector persisted_pings;
-  EXPECT_HRESULT_SUCCEEDED(Ping::LoadPersistedPings(false, &persisted_pings));
+  // Each ping event persists the ping of the bundle again, which replaces the
+  // ping persisted previously.
+  PingJournal journal(false);
+  PersistedPingVector persisted_pings;
+  EXPECT_HRESULT_SUCCEEDED(journal.Load(&persisted_pings));
   EXPECT_EQ(1, persisted_pings.size());
 
   for (size_t i = 0; i < persisted_pings.size(); ++i) {
-    time64 persisted_time = persisted_pings[i].second.first;
+    time64 persisted_time = persisted_pings[i].persisted_time;
     EXPECT_LE(past, persisted_time);
     EXPECT_GE(GetCurrent100NSTime(), persisted_time);
 
-    const CString persisted_ping(persisted_pings[i].second.second);
+    const CString persisted_ping(persisted_pings[i].ping_string);
     CString expected_requestid_substring;
     expected_requestid_substring.Format(_T("requestid=\"%s\""), request_id());
     EXPECT_NE(-1, persisted_ping.Find(expected_requestid_substring));
@@ -0,0 +1,312 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/progress_table.h"
+
+#include <algorithm>
+
+#include "omaha/base/const_object_names.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace {
+
+// Changes when the layout of the table changes.
+const LONG kFormatVersion = 1;
+
+// Enough for "65535.65535.65535.65535".
+const size_t kMaxVersionLength = 32;
+
+// How many times a reader tries to copy a row which is being written. The
+// writer holds a row for the time it takes to copy a few values, so the
+// limit is only reached if the writer dies in the middle of a write.
+const int kMaxReadAttempts = 1000;
+
+void GetTableAttributes(bool is_machine,
+                        const CString& session_id,
+                        NamedObjectAttributes* attr) {
+  ASSERT1(attr);
+
+  CString base_name;
+  SafeCStringFormat(&base_name, kProgressTableName, session_id);
+  GetNamedObjectAttributes(base_name, is_machine, attr);
+
+  if (is_machine) {
+    // The clients of the machine instance run as the users, who only read the
+    // table.
+    CSecurityDesc sd;
+    GetEveryoneDaclSecurityDescriptor(&sd, GENERIC_ALL, GENERIC_READ);
+    attr->sa.Set(sd);
+  } else {
+    // Creating a file mapping in the global namespace requires a privilege
+    // which the users do not have. The user worker and its clients run in the
+    // same session.
+    VERIFY1(attr->name.Replace(_T("Global\\"), _T("Local\\")) == 1);
+  }
+}
+
+}  // namespace
+
+struct ProgressTable::Header {
+  volatile LONG format_version;
+
+  // The number of rows in use. Only grows.
+  volatile LONG num_rows;
+
+  // Set if two bundles have the same session ID.
+  volatile LONG is_shared;
+
+  LONG reserved;
+};
+
+struct ProgressTable::Row {
+  // Odd while the writer changes the row.
+  volatile LONG sequence;
+
+  LONG state;
+  GUID app_guid;
+  uint64 bytes_downloaded;
+  uint64 total_bytes_to_download;
+  uint64 next_download_retry_time;
+  LONG download_time_remaining_ms;
+  LONG install_progress_percentage;
+  LONG install_time_remaining_ms;
+  WCHAR available_version[kMaxVersionLength];
+};
+
+ProgressTable::ProgressTable() : is_writer_(false) {
+}
+
+ProgressTable::~ProgressTable() {
+  Close();
+}
+
+HRESULT ProgressTable::Create(bool is_machine, const CString& session_id) {
+  ASSERT1(!is_open());
+  ASSERT1(!session_id.IsEmpty());
+
+  NamedObjectAttributes attr;
+  GetTableAttributes(is_machine, session_id, &attr);
+
+  const DWORD size = sizeof(Header) + kMaxRows * sizeof(Row);
+  reset(file_mapping_, ::CreateFileMapping(INVALID_HANDLE_VALUE,
+                                           &attr.sa,
+                                           PAGE_READWRITE,
+                                           0,
+                                           size,
+                                           attr.name));
+  if (!valid(file_mapping_)) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LW, (_T("[ProgressTable::Create]")
+                  _T("[CreateFileMapping failed][%s][0x%08x]"),
+                  attr.name, hr));
+    return hr;
+  }
+  const bool already_exists = ::GetLastError() == ERROR_ALREADY_EXISTS;
+
+  reset(view_, ::MapViewOfFile(get(file_mapping_), FILE_MAP_WRITE, 0, 0, size));
+  if (!valid(view_)) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[ProgressTable::Create]")
+                  _T("[MapViewOfFile failed][%s][0x%08x]"), attr.name, hr));
+    reset(file_mapping_);
+    return hr;
+  }
+
+  if (already_exists) {
+    // The readers can't tell the apps of the two bundles apart.
+    CORE_LOG(LW, (_T("[ProgressTable::Create][shared][%s]"), attr.name));
+    ::InterlockedExchange(&header()->is_shared, true);
+    Close();
+    return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+  }
+
+  // The memory of a new file mapping is zeroed.
+  ::InterlockedExchange(&header()->format_version, kFormatVersion);
+  is_writer_ = true;
+  return S_OK;
+}
+
+HRESULT ProgressTable::Open(bool is_machine, const CString& session_id) {
+  ASSERT1(!is_open());
+
+  if (session_id.IsEmpty()) {
+    return E_INVALIDARG;
+  }
+
+  NamedObjectAttributes attr;
+  GetTableAttributes(is_machine, session_id, &attr);
+
+  reset(file_mapping_, ::OpenFileMapping(FILE_MAP_READ, false, attr.name));
+  if (!valid(file_mapping_)) {
+    return HRESULTFromLastError();
+  }
+
+  const DWORD size = sizeof(Header) + kMaxRows * sizeof(Row);
+  reset(view_, ::MapViewOfFile(get(file_mapping_), FILE_MAP_READ, 0, 0, size));
+  if (!valid(view_)) {
+    HRESULT hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[ProgressTable::Open]")
+                  _T("[MapViewOfFile failed][%s][0x%08x]"), attr.name, hr));
+    reset(file_mapping_);
+    return hr;
+  }
+
+  is_writer_ = false;
+  return S_OK;
+}
+
+bool ProgressTable::is_open() const {
+  return valid(view_);
+}
+
+void ProgressTable::Close() {
+  reset(view_);
+  reset(file_mapping_);
+  is_writer_ = false;
+}
+
+HRESULT ProgressTable::Write(const AppProgress& progress) {
+  ASSERT1(is_open());
+  ASSERT1(is_writer_);
+  ASSERT1(!::IsEqualGUID(progress.app_guid, GUID_NULL));
+
+  if (!is_writer_) {
+    return E_UNEXPECTED;
+  }
+
+  // Only this process adds rows, so the rows can be searched without copying
+  // them.
+  const size_t num_rows = header()->num_rows;
+  size_t index = 0;
+  while (index != num_rows &&
+         !::IsEqualGUID(row(index)->app_guid, progress.app_guid)) {
+    ++index;
+  }
+
+  if (index == kMaxRows) {
+    return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+  }
+
+  Row* target = row(index);
+  const LONG sequence = target->sequence;
+  ASSERT1(!(sequence & 1));
+
+  // InterlockedExchange is a full barrier: the values are not written before
+  // the sequence is odd or after it is even again.
+  ::InterlockedExchange(&target->sequence, sequence + 1);
+
+  target->state = progress.state;
+  target->app_guid = progress.app_guid;
+  target->bytes_downloaded = progress.bytes_downloaded;
+  target->total_bytes_to_download = progress.total_bytes_to_download;
+  target->next_download_retry_time = progress.next_download_retry_time;
+  target->download_time_remaining_ms = progress.download_time_remaining_ms;
+  target->install_progress_percentage = progress.install_progress_percentage;
+  target->install_time_remaining_ms = progress.install_time_remaining_ms;
+
+  ASSERT1(static_cast<size_t>(progress.available_version.GetLength()) <
+          kMaxVersionLength);
+  _tcsncpy_s(target->available_version,
+             arraysize(target->available_version),
+             progress.available_version,
+             _TRUNCATE);
+
+  ::InterlockedExchange(&target->sequence, sequence + 2);
+
+  // The readers see the new row once it is complete.
+  if (index == num_rows) {
+    ::InterlockedIncrement(&header()->num_rows);
+  }
+
+  return S_OK;
+}
+
+bool ProgressTable::Read(const GUID& app_guid, AppProgress* progress) const {
+  ASSERT1(progress);
+
+  if (!is_open()) {
+    return false;
+  }
+
+  const Header* table_header = header();
+  if (table_header->format_version != kFormatVersion ||
+      table_header->is_shared) {
+    return false;
+  }
+
+  const size_t num_rows = std::min<size_t>(table_header->num_rows, kMaxRows);
+  for (size_t i = 0; i != num_rows; ++i) {
+    Row copy = {};
+    if (!ReadRow(row(i), &copy) || !::IsEqualGUID(copy.app_guid, app_guid)) {
+      continue;
+    }
+
+    copy.available_version[arraysize(copy.available_version) - 1] = 0;
+
+    progress->app_guid = copy.app_guid;
+    progress->state = static_cast<CurrentState>(copy.state);
+    progress->available_version = copy.available_version;
+    progress->bytes_downloaded = copy.bytes_downloaded;
+    progress->total_bytes_to_download = copy.total_bytes_to_download;
+    progress->download_time_remaining_ms = copy.download_time_remaining_ms;
+    progress->next_download_retry_time = copy.next_download_retry_time;
+    progress->install_progress_percentage = copy.install_progress_percentage;
+    progress->install_time_remaining_ms = copy.install_time_remaining_ms;
+    return true;
+  }
+
+  return false;
+}
+
+bool ProgressTable::ReadRow(const Row* row, Row* copy) {
+  ASSERT1(row);
+  ASSERT1(copy);
+
+  for (int i = 0; i != kMaxReadAttempts; ++i) {
+    const LONG sequence = row->sequence;
+    ::MemoryBarrier();
+
+    if (!(sequence & 1)) {
+      ::CopyMemory(copy, row, sizeof(*copy));
+      ::MemoryBarrier();
+
+      if (row->sequence == sequence) {
+        return true;
+      }
+    }
+
+    ::YieldProcessor();
+  }
+
+  return false;
+}
+
+ProgressTable::Header* ProgressTable::header() const {
+  ASSERT1(is_open());
+  return static_cast<Header*>(get(view_));
+}
+
+ProgressTable::Row* ProgressTable::row(size_t index) const {
+  ASSERT1(index < kMaxRows);
+  return reinterpret_cast<Row*>(header() + 1) + index;
+}
+
+}  // namespace omaha
@@ -0,0 +1,118 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ProgressTable is a table in shared memory in which the worker publishes the
+// state and the progress of the apps of a bundle, one row per app. The clients
+// which poll the bundle, such as the UI, the on-demand client, and
+// update3web, read the rows instead of calling the COM server.
+//
+// The table is named after the session ID of the bundle. Each row is
+// protected by a sequence lock: the writer makes the sequence odd while it
+// changes the row and even again when it is done, and the readers retry if
+// the sequence is odd or changes while they copy the row. Neither side takes
+// a lock, so the readers never block the worker.
+//
+// The table is a cache of the state of the COM objects. The readers fall back
+// to the COM server if the table does not exist, is full, or is shared by two
+// bundles with the same session ID.
+
+#ifndef OMAHA_COMMON_PROGRESS_TABLE_H_
+#define OMAHA_COMMON_PROGRESS_TABLE_H_
+
+#include <windows.h>
+#include <atlstr.h>
+
+#include "base/basictypes.h"
+#include "goopdate/omaha3_idl.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+// The values of ICurrentState which change while the app is processed.
+struct AppProgress {
+  AppProgress()
+      : app_guid(GUID_NULL),
+        state(STATE_INIT),
+        bytes_downloaded(0),
+        total_bytes_to_download(0),
+        download_time_remaining_ms(kCurrentStateProgressUnknown),
+        next_download_retry_time(0),
+        install_progress_percentage(kCurrentStateProgressUnknown),
+        install_time_remaining_ms(kCurrentStateProgressUnknown) {}
+
+  GUID app_guid;
+  CurrentState state;
+  CString available_version;
+  uint64 bytes_downloaded;
+  uint64 total_bytes_to_download;
+  LONG download_time_remaining_ms;
+  uint64 next_download_retry_time;
+  LONG install_progress_percentage;
+  LONG install_time_remaining_ms;
+};
+
+class ProgressTable {
+ public:
+  // The largest number of apps in a table. The apps after that are not
+  // published.
+  static const size_t kMaxRows = 128;
+
+  ProgressTable();
+  ~ProgressTable();
+
+  // Creates the table of the bundle with |session_id|. Called by the worker,
+  // which is the only writer. Fails if a table with the same name exists, in
+  // which case the existing table is marked as shared, so that its readers
+  // fall back to COM.
+  HRESULT Create(bool is_machine, const CString& session_id);
+
+  // Opens the table of the bundle with |session_id| for reading.
+  HRESULT Open(bool is_machine, const CString& session_id);
+
+  bool is_open() const;
+
+  // Publishes |progress| in the row of its app. The first write for an app
+  // adds a row for it. The calls must be serialized by the caller.
+  HRESULT Write(const AppProgress& progress);
+
+  // Reads the row of |app_guid|. Returns false if the app is not in the table
+  // or if the table can't be trusted.
+  bool Read(const GUID& app_guid, AppProgress* progress) const;
+
+  // The table is destroyed when its last reader or writer closes it.
+  void Close();
+
+ private:
+  struct Header;
+  struct Row;
+
+  // Copies |row| into |copy|. Returns false if the row is being written for
+  // too long.
+  static bool ReadRow(const Row* row, Row* copy);
+
+  Header* header() const;
+  Row* row(size_t index) const;
+
+  scoped_file_mapping file_mapping_;
+  scoped_file_view view_;
+  bool is_writer_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProgressTable);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_COMMON_PROGRESS_TABLE_H_
@@ -0,0 +1,201 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/common/progress_table.h"
+
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const GUID kApp1 = {0x6a4d7f02, 0x1c3b, 0x4f8e,
+                    {0x9a, 0x51, 0x2d, 0x7e, 0x3c, 0x60, 0xb8, 0x14}};
+const GUID kApp2 = {0xd0b95e73, 0x8f21, 0x4a6c,
+                    {0xb3, 0x0e, 0x5c, 0x19, 0x7a, 0x42, 0xe6, 0x8d}};
+
+const int kNumWrites = 100000;
+
+AppProgress MakeProgress(const GUID& app_guid, uint64 bytes) {
+  AppProgress progress;
+  progress.app_guid = app_guid;
+  progress.state = STATE_DOWNLOADING;
+  progress.available_version = _T("1.2.3.4");
+  progress.bytes_downloaded = bytes;
+  progress.total_bytes_to_download = bytes * 2;
+  progress.download_time_remaining_ms = static_cast<LONG>(bytes);
+  return progress;
+}
+
+// Writes rows in which the values depend on each other, so that the readers
+// can detect torn rows.
+DWORD WINAPI WriteProgress(void* param) {
+  ProgressTable* table = static_cast<ProgressTable*>(param);
+  for (int i = 1; i <= kNumWrites; ++i) {
+    if (FAILED(table->Write(MakeProgress(kApp1, i)))) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+}  // namespace
+
+class ProgressTableTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ASSERT_SUCCEEDED(GetGuid(&session_id_));
+    ASSERT_SUCCEEDED(writer_.Create(false, session_id_));
+  }
+
+  CString session_id_;
+  ProgressTable writer_;
+};
+
+TEST_F(ProgressTableTest, Open_NoTable) {
+  CString session_id;
+  EXPECT_SUCCEEDED(GetGuid(&session_id));
+
+  ProgressTable reader;
+  EXPECT_FAILED(reader.Open(false, session_id));
+  EXPECT_FALSE(reader.is_open());
+
+  AppProgress progress;
+  EXPECT_FALSE(reader.Read(kApp1, &progress));
+}
+
+TEST_F(ProgressTableTest, Open_NoSessionId) {
+  ProgressTable reader;
+  EXPECT_EQ(E_INVALIDARG, reader.Open(false, CString()));
+}
+
+TEST_F(ProgressTableTest, WriteAndRead) {
+  ProgressTable reader;
+  ASSERT_SUCCEEDED(reader.Open(false, session_id_));
+
+  AppProgress progress;
+  EXPECT_FALSE(reader.Read(kApp1, &progress));
+
+  AppProgress app1 = MakeProgress(kApp1, 10);
+  app1.next_download_retry_time = 1234;
+  EXPECT_SUCCEEDED(writer_.Write(app1));
+
+  AppProgress app2;
+  app2.app_guid = kApp2;
+  app2.state = STATE_INSTALLING;
+  app2.install_progress_percentage = 42;
+  app2.install_time_remaining_ms = 5000;
+  EXPECT_SUCCEEDED(writer_.Write(app2));
+
+  ASSERT_TRUE(reader.Read(kApp1, &progress));
+  EXPECT_TRUE(::IsEqualGUID(kApp1, progress.app_guid));
+  EXPECT_EQ(STATE_DOWNLOADING, progress.state);
+  EXPECT_STREQ(_T("1.2.3.4"), progress.available_version);
+  EXPECT_EQ(10, progress.bytes_downloaded);
+  EXPECT_EQ(20, progress.total_bytes_to_download);
+  EXPECT_EQ(10, progress.download_time_remaining_ms);
+  EXPECT_EQ(1234, progress.next_download_retry_time);
+  EXPECT_EQ(kCurrentStateProgressUnknown,
+            progress.install_progress_percentage);
+
+  ASSERT_TRUE(reader.Read(kApp2, &progress));
+  EXPECT_EQ(STATE_INSTALLING, progress.state);
+  EXPECT_TRUE(progress.available_version.IsEmpty());
+  EXPECT_EQ(42, progress.install_progress_percentage);
+  EXPECT_EQ(5000, progress.install_time_remaining_ms);
+
+  // A second write for an app replaces its row.
+  app2.state = STATE_INSTALL_COMPLETE;
+  app2.install_progress_percentage = 100;
+  EXPECT_SUCCEEDED(writer_.Write(app2));
+  ASSERT_TRUE(reader.Read(kApp2, &progress));
+  EXPECT_EQ(STATE_INSTALL_COMPLETE, progress.state);
+  EXPECT_EQ(100, progress.install_progress_percentage);
+}
+
+TEST_F(ProgressTableTest, Write_Full) {
+  for (size_t i = 0; i != ProgressTable::kMaxRows; ++i) {
+    AppProgress progress;
+    progress.app_guid = kApp1;
+    progress.app_guid.Data1 = static_cast<unsigned long>(i);  // NOLINT
+    EXPECT_SUCCEEDED(writer_.Write(progress));
+  }
+
+  AppProgress progress;
+  progress.app_guid = kApp2;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER),
+            writer_.Write(progress));
+
+  // The apps in the table are still updated.
+  progress.app_guid = kApp1;
+  progress.app_guid.Data1 = 0;
+  EXPECT_SUCCEEDED(writer_.Write(progress));
+}
+
+// The readers of a table which two bundles share fall back to COM.
+TEST_F(ProgressTableTest, Create_SameSessionId) {
+  EXPECT_SUCCEEDED(writer_.Write(MakeProgress(kApp1, 10)));
+
+  ProgressTable reader;
+  ASSERT_SUCCEEDED(reader.Open(false, session_id_));
+  AppProgress progress;
+  EXPECT_TRUE(reader.Read(kApp1, &progress));
+
+  ProgressTable other_writer;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS),
+            other_writer.Create(false, session_id_));
+  EXPECT_FALSE(other_writer.is_open());
+
+  EXPECT_FALSE(reader.Read(kApp1, &progress));
+}
+
+TEST_F(ProgressTableTest, Read_ConcurrentWrites) {
+  ProgressTable reader;
+  ASSERT_SUCCEEDED(reader.Open(false, session_id_));
+
+  scoped_handle thread(::CreateThread(NULL, 0, WriteProgress, &writer_, 0,
+                                      NULL));
+  ASSERT_TRUE(valid(thread));
+
+  int num_torn_reads = 0;
+  uint64 last_bytes = 0;
+  while (::WaitForSingleObject(get(thread), 0) == WAIT_TIMEOUT) {
+    AppProgress progress;
+    if (!reader.Read(kApp1, &progress)) {
+      continue;
+    }
+
+    if (progress.bytes_downloaded * 2 != progress.total_bytes_to_download ||
+        static_cast<LONG>(progress.bytes_downloaded) !=
+            progress.download_time_remaining_ms ||
+        progress.bytes_downloaded < last_bytes) {
+      ++num_torn_reads;
+    }
+    last_bytes = progress.bytes_downloaded;
+  }
+
+  EXPECT_EQ(0, num_torn_reads);
+
+  DWORD exit_code = 1;
+  EXPECT_TRUE(::GetExitCodeThread(get(thread), &exit_code));
+  EXPECT_EQ(0, exit_code);
+
+  AppProgress progress;
+  ASSERT_TRUE(reader.Read(kApp1, &progress));
+  EXPECT_EQ(static_cast<uint64>(kNumWrites), progress.bytes_downloaded);
+}
+
+}  // namespace omaha
@@ -121,6 +121,13 @@ UpdateRequest* UpdateRequest::Create(bool is_machine,
   return Create(is_machine, session_id, install_source, origin_url, request_id);
 }
 
+UpdateRequest* UpdateRequest::CreateFromRequest(
+    const request::Request& request) {
+  UpdateRequest* update_request = new UpdateRequest;
+  update_request->request_ = request;
+  return update_request;
+}
+
 void UpdateRequest::AddApp(const request::App& app) {
   request_.apps.push_back(app);
 }
@@ -42,6 +42,10 @@ class UpdateRequest {
                                const CString& install_source,
                                const CString& origin_url);
 
+  // Creates an instance with a copy of |request|, for tools which synthesize
+  // the requests of other clients. Caller takes ownership.
+  static UpdateRequest* CreateFromRequest(const request::Request& request);
+
   // Adds an 'app' element to the request.
   void AddApp(const request::App& app);
 
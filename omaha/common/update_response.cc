@@ -14,6 +14,7 @@
 // ========================================================================
 
 #include "omaha/common/update_response.h"
+#include <shlwapi.h>
 #include "omaha/base/utils.h"
 #include "omaha/common/xml_parser.h"
 
@@ -36,14 +37,20 @@ HRESULT UpdateResponse::Deserialize(const std::vector<uint8>& buffer) {
 }
 
 HRESULT UpdateResponse::DeserializeFromFile(const CString& filename) {
-  std::vector<uint8> buffer;
-  HRESULT hr = ReadEntireFile(filename, 0, &buffer);
+  // The parser reads the file from the stream as it goes, instead of the
+  // whole file being read into memory first.
+  CComPtr<IStream> stream;
+  HRESULT hr = ::SHCreateStreamOnFileEx(filename,
+                                        STGM_READ | STGM_SHARE_DENY_WRITE,
+                                        FILE_ATTRIBUTE_NORMAL,
+                                        false,
+                                        NULL,
+                                        &stream);
   if (FAILED(hr)) {
     return hr;
   }
 
-  ASSERT1(!buffer.empty());
-  return Deserialize(buffer);
+  return XmlParser::DeserializeResponseFromStream(stream, this);
 }
 
 int UpdateResponse::GetElapsedSecondsSinceDayStart() const {
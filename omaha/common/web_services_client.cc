@@ -44,7 +44,8 @@ WebServicesClient::WebServicesClient(bool is_machine)
       use_cup_(false),
       http_xdaystart_header_value_(-1),
       http_xdaynum_header_value_(-1),
-      retry_after_sec_(-1) {
+      retry_after_sec_(-1),
+      request_encoding_(CONTENT_ENCODING_IDENTITY) {
 }
 
 WebServicesClient::~WebServicesClient() {
@@ -66,6 +67,8 @@ HRESULT WebServicesClient::Initialize(const CString& url,
   original_url_ = url;
   headers_ = headers;
   use_cup_ = use_cup;
+  request_encoding_ = StringToContentEncoding(
+      ConfigManager::Instance()->GetRequestEncoding(is_machine_));
 
   return S_OK;
 }
@@ -239,11 +242,39 @@ HRESULT WebServicesClient::SendStringInternal(
     return hr;
   }
 
+  ContentEncoding encoding = CONTENT_ENCODING_IDENTITY;
+  __mutexBlock(lock_) {
+    if (utf8_request_string.GetLength() >= kMinEncodedRequestLength) {
+      encoding = request_encoding_;
+    }
+  }
+
   std::vector<uint8> response_buffer;
-  hr = network_request_->PostUtf8String(actual_url,
-                                        utf8_request_string,
-                                        &response_buffer);
+  hr = PostRequest(actual_url, utf8_request_string, encoding, &response_buffer);
   CORE_LOG(L3, (_T("[the request returned 0x%x]"), hr));
+
+  // The server does not accept the compressed body. Stop compressing and send
+  // the request again.
+  if (encoding != CONTENT_ENCODING_IDENTITY &&
+      http_status_code() == HTTP_STATUS_UNSUPPORTED_MEDIA) {
+    CORE_LOG(LW, (_T("[compressed request rejected, resending]")));
+    __mutexBlock(lock_) {
+      request_encoding_ = CONTENT_ENCODING_IDENTITY;
+    }
+    VERIFY_SUCCEEDED(ConfigManager::Instance()->SetRequestEncoding(
+        is_machine_, CString()));
+
+    hr = CreateRequest();
+    if (FAILED(hr)) {
+      return hr;
+    }
+    hr = PostRequest(actual_url,
+                     utf8_request_string,
+                     CONTENT_ENCODING_IDENTITY,
+                     &response_buffer);
+    CORE_LOG(L3, (_T("[the request returned 0x%x]"), hr));
+  }
+
   const CString response_string(Utf8BufferToWideChar(response_buffer));
   CORE_LOG(L3, (_T("[response received][%s]"), response_string));
 
@@ -256,6 +287,7 @@ HRESULT WebServicesClient::SendStringInternal(
     retry_after_sec_ =
         std::min(FindHttpHeaderValueInt(kHeaderXRetryAfter), kSecondsPerDay);
     CORE_LOG(L3, (_T("[retry_after_sec_][%d]"), retry_after_sec_));
+    CaptureRequestEncoding();
   }
 
   if (FAILED(hr)) {
@@ -290,6 +322,72 @@ HRESULT WebServicesClient::SendStringInternal(
   return S_OK;
 }
 
+HRESULT WebServicesClient::PostRequest(const CString& url,
+                                       const CStringA& utf8_request_string,
+                                       ContentEncoding encoding,
+                                       std::vector<uint8>* response_buffer) {
+  ASSERT1(response_buffer);
+
+  if (encoding == CONTENT_ENCODING_IDENTITY) {
+    return network_request_->PostUtf8String(url,
+                                            utf8_request_string,
+                                            response_buffer);
+  }
+
+  // The encoded body is what CUP hashes and signs, since the hash is computed
+  // over the bytes which are posted.
+  std::vector<uint8> encoded_request;
+  HRESULT hr = EncodeContent(encoding,
+                             utf8_request_string.GetString(),
+                             utf8_request_string.GetLength(),
+                             &encoded_request);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[EncodeContent failed][0x%x]"), hr));
+    return network_request_->PostUtf8String(url,
+                                            utf8_request_string,
+                                            response_buffer);
+  }
+
+  CORE_LOG(L3, (_T("[request encoded][%s][%d bytes][%u bytes]"),
+                ContentEncodingToString(encoding),
+                utf8_request_string.GetLength(),
+                encoded_request.size()));
+
+  network_request_->AddHeader(kHeaderContentEncoding,
+                              ContentEncodingToString(encoding));
+  return network_request_->Post(url,
+                                &encoded_request.front(),
+                                encoded_request.size(),
+                                response_buffer);
+}
+
+void WebServicesClient::CaptureRequestEncoding() {
+  if (!network_request_.get()) {
+    return;
+  }
+
+  const CString value = FindHttpHeaderValue(
+      network_request_->response_headers(), kHeaderXRequestEncoding);
+  if (value.IsEmpty()) {
+    return;
+  }
+
+  const ContentEncoding encoding = StringToContentEncoding(value);
+  CORE_LOG(L3, (_T("[X-Request-Encoding][%s][%d]"), value, encoding));
+
+  bool is_changed = false;
+  __mutexBlock(lock_) {
+    is_changed = encoding != request_encoding_;
+    request_encoding_ = encoding;
+  }
+
+  if (!is_changed) {
+    return;
+  }
+  VERIFY_SUCCEEDED(ConfigManager::Instance()->SetRequestEncoding(
+      is_machine_, ContentEncodingToString(encoding)));
+}
+
 void WebServicesClient::CaptureCustomHeaderValues() {
   const int day_start = FindHttpHeaderValueInt(kHeaderXDaystart);
   if (day_start != -1) {
@@ -22,6 +22,7 @@
 #include <utility>
 #include <vector>
 #include "base/basictypes.h"
+#include "omaha/net/content_encoding.h"
 #include "omaha/net/proxy_auth.h"
 
 namespace omaha {
@@ -148,11 +149,22 @@ class WebServicesClient : public WebServicesClientInterface {
 
   // Sends a string representing a protocol message and returns a parsed
   // response. The |update_response| parameter is only modified if the
-  // parsing has succeeded.
+  // parsing has succeeded. The request body is compressed if the server has
+  // asked for it. If the server rejects the compressed body, the request is
+  // sent again uncompressed.
   HRESULT SendStringInternal(const CString& url,
                              const CStringA& utf8_request_string,
                              xml::UpdateResponse* update_response);
 
+  HRESULT PostRequest(const CString& url,
+                      const CStringA& utf8_request_string,
+                      ContentEncoding encoding,
+                      std::vector<uint8>* response_buffer);
+
+  // Stores the request encoding that the server asks for in the
+  // X-Request-Encoding header, if the header is present.
+  void CaptureRequestEncoding();
+
   // Captures the values of kHeaderXDaystart and kHeaderXDaynum if the fields
   // are found in the response headers.
   void CaptureCustomHeaderValues();
@@ -201,6 +213,10 @@ class WebServicesClient : public WebServicesClientInterface {
   // header values are respected. Also, the header value is clamped to 24 hours.
   int retry_after_sec_;
 
+  // The content coding of the request bodies. Requests smaller than
+  // kMinEncodedRequestLength are always sent uncompressed.
+  ContentEncoding request_encoding_;
+
   // Set by the client of this class, may be used by the network request if
   // proxy authentication is required later on.
   ProxyAuthConfig proxy_auth_config_;
@@ -208,6 +224,8 @@ class WebServicesClient : public WebServicesClientInterface {
   // Each web services request must use its own network request instance.
   std::unique_ptr<NetworkRequest> network_request_;
 
+  static const int kMinEncodedRequestLength = 1024;
+
   friend class WebServicesClientTest;
   DISALLOW_COPY_AND_ASSIGN(WebServicesClient);
 };
@@ -421,6 +421,33 @@ class PackageElementHandler : public ElementHandler {
       return hr;
     }
 
+    // The patch is optional. A patch without its name, size or hash is
+    // ignored and the full package is downloaded. An empty name or hash is
+    // the same as a missing one.
+    if (HasAttribute(node, xml::attribute::kNameDiff)) {
+      hr = ReadStringAttribute(node,
+                               xml::attribute::kNameDiff,
+                               &install_package.name_diff);
+      if (SUCCEEDED(hr)) {
+        hr = ReadIntAttribute(node,
+                              xml::attribute::kSizeDiff,
+                              &install_package.size_diff);
+      }
+      if (SUCCEEDED(hr)) {
+        hr = ReadStringAttribute(node,
+                                 xml::attribute::kHashDiffSha256,
+                                 &install_package.hash_diff_sha256);
+      }
+      if (FAILED(hr) ||
+          install_package.name_diff.IsEmpty() ||
+          install_package.size_diff <= 0 ||
+          install_package.hash_diff_sha256.IsEmpty()) {
+        install_package.name_diff.Empty();
+        install_package.size_diff = 0;
+        install_package.hash_diff_sha256.Empty();
+      }
+    }
+
     InstallManifest& install_manifest =
         response->apps.back().update_check.install_manifest;
     install_manifest.packages.push_back(install_package);
@@ -1730,10 +1757,32 @@ HRESULT XmlParser::DeserializeResponse(const std::vector<uint8>& buffer,
     return hr;
   }
 
+  return xml_parser.ParseResponse(update_response);
+}
+
+HRESULT XmlParser::DeserializeResponseFromStream(
+    IStream* stream,
+    UpdateResponse* update_response) {
+  ASSERT1(stream);
+  ASSERT1(update_response);
+
+  XmlParser xml_parser;
+  HRESULT hr = LoadXMLFromStream(stream, false, &xml_parser.document_);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return xml_parser.ParseResponse(update_response);
+}
+
+HRESULT XmlParser::ParseResponse(UpdateResponse* update_response) {
+  ASSERT1(update_response);
+
   response::Response response;
-  xml_parser.response_ = &response;
+  response_ = &response;
 
-  hr = xml_parser.Parse();
+  HRESULT hr = Parse();
+  response_ = NULL;
   if (FAILED(hr)) {
     return hr;
   }
@@ -53,6 +53,11 @@ class XmlParser {
   static HRESULT DeserializeResponse(const std::vector<uint8>& buffer,
                                      UpdateResponse* update_response);
 
+  // Parses the update response while it is read from |stream|.
+  static HRESULT DeserializeResponseFromStream(
+      IStream* stream,
+      UpdateResponse* update_response);
+
   // Generates the update request from the request node.
   static HRESULT SerializeRequest(const UpdateRequest& update_request,
                                   CString* buffer);
@@ -112,6 +117,10 @@ class XmlParser {
                             const TCHAR* value,
                             IXMLDOMNode** element);
 
+  // Parses the loaded document into |update_response|, which is not modified
+  // in case of errors.
+  HRESULT ParseResponse(UpdateResponse* update_response);
+
   // Starts parsing of the xml document.
   HRESULT Parse();
 
@@ -294,6 +294,9 @@ TEST_F(XmlParserTest, Parse) {
     EXPECT_STREQ(
         _T("d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0"),
         install_package.hash_sha256);
+    EXPECT_TRUE(install_package.name_diff.IsEmpty());
+    EXPECT_EQ(0, install_package.size_diff);
+    EXPECT_TRUE(install_package.hash_diff_sha256.IsEmpty());
 
     EXPECT_EQ(2, install_manifest.install_actions.size());
 
@@ -398,6 +401,48 @@ TEST_F(XmlParserTest, Parse_InvalidDataStatusError) {
             update_response_utils::ValidateUntrustedData(app.data));
 }
 
+// The first package has a patch. The patch of the second package has no hash,
+// the patch of the third package has an empty hash, and the patch of the
+// fourth package has an empty name, so these patches are ignored.
+TEST_F(XmlParserTest, Parse_PackageDiff) {
+  CStringA buffer_string = "<?xml version=\"1.0\" encoding=\"UTF-8\"?><response protocol=\"3.0\"><app appid=\"{8A69D345-D564-463C-AFF1-A69D9E530F96}\" status=\"ok\"><updatecheck status=\"ok\"><urls><url codebase=\"http://cache.pack.google.com/edgedl/chrome/install/172.37/\"/></urls><manifest version=\"2.0.172.37\"><packages><package hash_sha256=\"d5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_installer.exe\" size=\"9614320\" namediff=\"chrome_installer_diff.exe\" sizediff=\"1234567\" hashdiff_sha256=\"0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0\"/><package hash_sha256=\"a5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_data.bin\" size=\"1024\" namediff=\"chrome_data_diff.bin\" sizediff=\"256\"/><package hash_sha256=\"b5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_empty_hash.bin\" size=\"2048\" namediff=\"chrome_empty_hash_diff.bin\" sizediff=\"512\" hashdiff_sha256=\"\"/><package hash_sha256=\"c5e06b4436c5e33f2de88298b890f47815fc657b63b3050d2217c55a5d0730b0\" name=\"chrome_empty_name.bin\" size=\"4096\" namediff=\"\" sizediff=\"1024\" hashdiff_sha256=\"0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0\"/></packages></manifest></updatecheck></app></response>";  // NOLINT
+  std::vector<uint8> buffer(buffer_string.GetLength());
+  memcpy(&buffer.front(), buffer_string, buffer.size());
+
+  std::unique_ptr<UpdateResponse> update_response(UpdateResponse::Create());
+  EXPECT_HRESULT_SUCCEEDED(XmlParser::DeserializeResponse(
+      buffer,
+      update_response.get()));
+  const response::Response& xml_response(update_response->response());
+  ASSERT_EQ(1, xml_response.apps.size());
+
+  const InstallManifest& install_manifest(
+      xml_response.apps[0].update_check.install_manifest);
+  ASSERT_EQ(4, install_manifest.packages.size());
+
+  const InstallPackage& install_package(install_manifest.packages[0]);
+  EXPECT_STREQ(_T("chrome_installer.exe"), install_package.name);
+  EXPECT_EQ(9614320, install_package.size);
+  EXPECT_STREQ(_T("chrome_installer_diff.exe"), install_package.name_diff);
+  EXPECT_EQ(1234567, install_package.size_diff);
+  EXPECT_STREQ(
+      _T("0f1e2d3c4b5a69788796a5b4c3d2e1f00f1e2d3c4b5a69788796a5b4c3d2e1f0"),
+      install_package.hash_diff_sha256);
+
+  const TCHAR* const kNoDiffPackageNames[] = {
+    _T("chrome_data.bin"),
+    _T("chrome_empty_hash.bin"),
+    _T("chrome_empty_name.bin"),
+  };
+  for (size_t i = 0; i != arraysize(kNoDiffPackageNames); ++i) {
+    const InstallPackage& no_diff_package(install_manifest.packages[i + 1]);
+    EXPECT_STREQ(kNoDiffPackageNames[i], no_diff_package.name);
+    EXPECT_TRUE(no_diff_package.name_diff.IsEmpty());
+    EXPECT_EQ(0, no_diff_package.size_diff);
+    EXPECT_TRUE(no_diff_package.hash_diff_sha256.IsEmpty());
+  }
+}
+
 TEST_F(XmlParserTest, Serialize_WithInvalidXmlCharacters) {
   std::unique_ptr<UpdateRequest> update_request(
       UpdateRequest::Create(false, _T("sid"), _T("is"), _T("http://foo/\"")));
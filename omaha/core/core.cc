@@ -575,20 +575,32 @@ HRESULT Core::InitializeScheduler(const Scheduler* scheduler) {
   ASSERT1(scheduler);
 
   const ConfigManager* cm = ConfigManager::Instance();
-  // Start update worker
-  HRESULT hr = scheduler->StartWithDelay(cm->GetUpdateWorkerStartUpDelayMs(),
-                                         cm->GetAutoUpdateTimerIntervalMs(),
-                                         [this]() { StartUpdateWorker(); });
+
+  // Start update worker. Each run is delayed by up to a tenth of the interval,
+  // which spreads the update checks of the clients which start or resume at
+  // the same time.
+  const int au_timer_interval = cm->GetAutoUpdateTimerIntervalMs();
+  HRESULT hr = scheduler->StartWithJitter(
+      cm->GetUpdateWorkerStartUpDelayMs(),
+      au_timer_interval,
+      au_timer_interval / 10,
+      0,
+      [this](HighresTimer*) { StartUpdateWorker(); });
 
   if (FAILED(hr)) {
     OPT_LOG(LW, (L"[Failed to start update worker scheduler][0x%08x]", hr));
     return hr;
   }
 
-  // Start Code Red worker
+  // Start Code Red worker. The code red check can run up to an update worker
+  // interval late, so it usually runs in the same wakeup as the update worker.
   const int cr_timer_interval = cm->GetCodeRedTimerIntervalMs();
-  hr = scheduler->StartWithDebugTimer(
-      cr_timer_interval, [this, cr_timer_interval](HighresTimer* debug_timer) {
+  hr = scheduler->StartWithJitter(
+      cr_timer_interval,
+      cr_timer_interval,
+      cr_timer_interval / 24,
+      std::min(au_timer_interval, cr_timer_interval / 24),
+      [this, cr_timer_interval](HighresTimer* debug_timer) {
         StartCodeRed();
         if (debug_timer) {
           int actual_time_ms = static_cast<int>(debug_timer->GetElapsedMs());
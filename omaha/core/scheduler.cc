@@ -15,143 +15,265 @@
 
 #include "omaha/core/scheduler.h"
 
+#include <algorithm>
+
+#include "base/rand_util.h"
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
+#include "omaha/base/utils.h"
 
 namespace omaha {
 
-Scheduler::SchedulerItem::SchedulerItem(HANDLE timer_queue,
-                                        int start_delay_ms,
-                                        int interval_ms,
-                                        bool has_debug_timer,
-                                        ScheduledWorkWithTimer work)
-    : start_delay_ms_(start_delay_ms), interval_ms_(interval_ms), work_(work) {
-  if (has_debug_timer) {
-    debug_timer_.reset(new HighresTimer());
-  }
+namespace {
 
-  if (timer_queue) {
-    timer_.reset(
-        new QueueTimer(timer_queue, &SchedulerItem::TimerCallback, this));
-    VERIFY_SUCCEEDED(
-        ScheduleNext(timer_.get(), debug_timer_.get(), start_delay_ms));
-  }
-}
-
-Scheduler::SchedulerItem::~SchedulerItem() {
-  // QueueTimer dtor may block for pending callbacks.
-  if (timer_) {
-    timer_.reset();
-  }
+// Reads the time from the tick count, which keeps counting while the computer
+// sleeps, so the work which missed its runs is due when the computer resumes.
+class SystemSchedulerClock : public SchedulerClock {
+ public:
+  SystemSchedulerClock() {}
 
-  if (debug_timer_) {
-    debug_timer_.reset();
+  virtual uint64 NowMs() {
+    return ::GetTickCount64();
   }
-}
 
-// static
-HRESULT Scheduler::SchedulerItem::ScheduleNext(QueueTimer* timer,
-                                               HighresTimer* debug_timer,
-                                               int start_after_ms) {
-  if (!timer) {
-    return E_FAIL;
+  virtual uint32 Random(uint32 range) {
+    uint32 random_value = 0;
+    if (!range || !RandUint32(&random_value)) {
+      return 0;
+    }
+    return range == UINT_MAX ? random_value : random_value % (range + 1);
   }
 
-  if (debug_timer) {
-    debug_timer->Start();
-  }
+ private:
+  DISALLOW_COPY_AND_ASSIGN(SystemSchedulerClock);
+};
 
-  const HRESULT hr = timer->Start(start_after_ms, 0, WT_EXECUTEONLYONCE);
+}  // namespace
 
-  if (FAILED(hr)) {
-    CORE_LOG(LE, (L"[can't start queue timer][0x%08x]", hr));
+Scheduler::SchedulerItem::SchedulerItem(int interval,
+                                        int jitter,
+                                        int coalescing_window,
+                                        bool has_debug_timer,
+                                        ScheduledWorkWithTimer work_fn)
+    : interval_ms(interval),
+      jitter_ms(jitter),
+      coalescing_window_ms(coalescing_window),
+      due_ms(0),
+      work(work_fn) {
+  if (has_debug_timer) {
+    debug_timer.reset(new HighresTimer());
   }
-
-  return hr;
 }
 
-// static
-void Scheduler::SchedulerItem::TimerCallback(QueueTimer* timer) {
-  ASSERT1(timer);
-  if (!timer) {
-    return;
-  }
-
-  SchedulerItem* item = reinterpret_cast<SchedulerItem*>(timer->ctx());
-  ASSERT1(item);
-
-  if (!item) {
-    CORE_LOG(LE, (L"[Expected timer context to contain SchedulerItem]"));
-    return;
-  }
-
-  // This may be long running, |item| may be deleted in the meantime,
-  // however the dtor should block on deleting the |timer| and allow
-  // pending callbacks to run.
-  if (item && item->work_) {
-    item->work_(item->debug_timer());
-  }
-
-  if (item) {
-    const HRESULT hr = SchedulerItem::ScheduleNext(timer,
-                                                   item->debug_timer(),
-                                                   item->interval_ms());
-    if (FAILED(hr)) {
-      CORE_LOG(L1, (L"[Scheduling next timer callback failed][0x%08x]", hr));
-    }
+Scheduler::Scheduler()
+    : system_clock_(new SystemSchedulerClock),
+      clock_(system_clock_.get()),
+      wheel_(clock_->NowMs()),
+      wakeups_(0) {
+  CORE_LOG(L1, (L"[Scheduler::Scheduler]"));
+  reset(timer_, ::CreateWaitableTimer(NULL, false, NULL));
+  reset(stop_event_, ::CreateEvent(NULL, true, false, NULL));
+  if (!valid(timer_) || !valid(stop_event_) || !thread_.Start(this)) {
+    CORE_LOG(LE, (L"[Failed to start the scheduler thread][%d]",
+                  ::GetLastError()));
   }
 }
 
-Scheduler::Scheduler() {
-  CORE_LOG(L1, (L"[Scheduler::Scheduler]"));
-  timer_queue_ = ::CreateTimerQueue();
-  if (!timer_queue_) {
-    CORE_LOG(LE, (L"[Failed to create Timer Queue][%d]", ::GetLastError()));
-  }
+Scheduler::Scheduler(SchedulerClock* clock)
+    : clock_(clock),
+      wheel_(clock->NowMs()),
+      wakeups_(0) {
+  ASSERT1(clock);
 }
 
 Scheduler::~Scheduler() {
   CORE_LOG(L1, (L"[Scheduler::~Scheduler]"));
 
-  timers_.clear();
-
-  if (timer_queue_) {
-    // The destructor blocks on deleting the timer queue and it waits for
-    // all timer callbacks to complete.
-    ::DeleteTimerQueueEx(timer_queue_, INVALID_HANDLE_VALUE);
-    timer_queue_ = NULL;
+  // Waits for the work which is running to complete.
+  if (valid(stop_event_)) {
+    VERIFY1(::SetEvent(get(stop_event_)));
+    VERIFY1(thread_.WaitTillExit(INFINITE));
   }
 }
 
 HRESULT Scheduler::StartWithDebugTimer(int interval,
                                        ScheduledWorkWithTimer work) const {
-  return DoStart(interval, interval, work, true /*has_debug_timer*/);
+  return DoStart(interval, interval, 0, 0, work, true /*has_debug_timer*/);
 }
 
 HRESULT Scheduler::StartWithDelay(int delay,
                                   int interval,
                                   ScheduledWork work) const {
-  return DoStart(delay, interval, std::bind(work));
+  return DoStart(delay, interval, 0, 0, std::bind(work));
 }
 
 HRESULT Scheduler::Start(int interval, ScheduledWork work) const {
-  return DoStart(interval, interval, std::bind(work));
+  return DoStart(interval, interval, 0, 0, std::bind(work));
+}
+
+HRESULT Scheduler::StartWithJitter(int delay,
+                                   int interval,
+                                   int jitter,
+                                   int coalescing_window,
+                                   ScheduledWorkWithTimer work) const {
+  return DoStart(delay, interval, jitter, coalescing_window, work,
+                 true /*has_debug_timer*/);
 }
 
 HRESULT Scheduler::DoStart(int start_delay,
                            int interval,
+                           int jitter,
+                           int coalescing_window,
                            ScheduledWorkWithTimer work_fn,
                            bool has_debug_timer) const {
-  CORE_LOG(L1, (L"[Scheduler::Start]"));
+  CORE_LOG(L1, (L"[Scheduler::Start][%d][%d][%d][%d]",
+                start_delay, interval, jitter, coalescing_window));
+
+  if (start_delay < 0 || interval <= 0 || jitter < 0 || coalescing_window < 0) {
+    return E_INVALIDARG;
+  }
 
-  if (!timer_queue_) {
-    return HRESULTFromLastError();
+  if (system_clock_ && !thread_.Running()) {
+    return E_UNEXPECTED;
   }
 
-  timers_.emplace_back(timer_queue_, start_delay, interval, has_debug_timer,
-                       work_fn);
+  __mutexScope(lock_);
+  items_.push_back(std::make_unique<SchedulerItem>(
+      interval, jitter, coalescing_window, has_debug_timer, work_fn));
+  ScheduleItem(items_.size() - 1, CurrentTimeMs(), start_delay);
+  ArmTimer();
   return S_OK;
 }
 
+bool Scheduler::GetNextWakeup(uint64* next_wakeup_ms) const {
+  ASSERT1(next_wakeup_ms);
+  __mutexScope(lock_);
+  return wheel_.GetNextExpiration(next_wakeup_ms);
+}
+
+bool Scheduler::RunDueWork(uint64* next_wakeup_ms) const {
+  ASSERT1(next_wakeup_ms);
+
+  std::vector<size_t> due_indexes;
+  std::vector<SchedulerItem*> due_items;
+  {
+    __mutexScope(lock_);
+    ++wakeups_;
+
+    const uint64 now_ms = CurrentTimeMs();
+    std::vector<int> expired_ids;
+    wheel_.Advance(now_ms, &expired_ids);
+
+    // All the work which is due runs now, including the work whose deadline
+    // is later in its coalescing window.
+    for (size_t i = 0; i != items_.size(); ++i) {
+      SchedulerItem* item = items_[i].get();
+      if (item->due_ms > now_ms) {
+        continue;
+      }
+
+      // When the work is later than its jitter and coalescing window allow,
+      // the computer was not running at the time, for instance because it was
+      // sleeping, and the work runs only once to catch up. Many computers
+      // resume at the same time, so the catch up run is delayed by a random
+      // jitter.
+      const uint64 late_ms = now_ms - item->due_ms;
+      if (item->jitter_ms &&
+          late_ms > static_cast<uint64>(item->jitter_ms) +
+                    item->coalescing_window_ms) {
+        CORE_LOG(L3, (L"[Scheduler catching up][%llu ms late]", late_ms));
+        ScheduleItem(i, now_ms, 0);
+        continue;
+      }
+
+      wheel_.Cancel(static_cast<int>(i));
+      due_indexes.push_back(i);
+      due_items.push_back(item);
+    }
+  }
+
+  // The work runs without the lock, so it can start more work.
+  for (size_t i = 0; i != due_items.size(); ++i) {
+    if (due_items[i]->work) {
+      due_items[i]->work(due_items[i]->debug_timer.get());
+    }
+  }
+
+  __mutexScope(lock_);
+  const uint64 now_ms = CurrentTimeMs();
+  for (size_t i = 0; i != due_indexes.size(); ++i) {
+    ScheduleItem(due_indexes[i], now_ms, due_items[i]->interval_ms);
+  }
+  return wheel_.GetNextExpiration(next_wakeup_ms);
+}
+
+int Scheduler::wakeups() const {
+  __mutexScope(lock_);
+  return wakeups_;
+}
+
+uint64 Scheduler::CurrentTimeMs() const {
+  return std::max(clock_->NowMs(), wheel_.now_ms());
+}
+
+void Scheduler::ScheduleItem(size_t index,
+                             uint64 now_ms,
+                             uint64 delay_ms) const {
+  ASSERT1(index < items_.size());
+  SchedulerItem* item = items_[index].get();
+
+  const uint32 jitter_ms = item->jitter_ms ? clock_->Random(item->jitter_ms) :
+                                             0;
+  item->due_ms = now_ms + delay_ms + jitter_ms;
+  wheel_.Schedule(static_cast<int>(index),
+                  item->due_ms + item->coalescing_window_ms);
+
+  if (item->debug_timer) {
+    item->debug_timer->Start();
+  }
+}
+
+void Scheduler::ArmTimer() const {
+  if (!valid(timer_)) {
+    return;
+  }
+
+  __mutexScope(lock_);
+  uint64 next_wakeup_ms = 0;
+  if (!wheel_.GetNextExpiration(&next_wakeup_ms)) {
+    VERIFY1(::CancelWaitableTimer(get(timer_)));
+    return;
+  }
+
+  const uint64 now_ms = CurrentTimeMs();
+  const uint64 delay_ms = next_wakeup_ms > now_ms ?
+      std::min(next_wakeup_ms - now_ms, static_cast<uint64>(INT_MAX)) : 0;
+  LARGE_INTEGER due_time = MSto100NSRelative(static_cast<DWORD>(delay_ms));
+  if (!::SetWaitableTimer(get(timer_), &due_time, 0, NULL, NULL, false)) {
+    CORE_LOG(LE, (L"[Failed to set the scheduler timer][%d]",
+                  ::GetLastError()));
+  }
+}
+
+void Scheduler::Run() {
+  const HANDLE handles[] = {get(stop_event_), get(timer_)};
+  for (;;) {
+    const DWORD result = ::WaitForMultipleObjects(arraysize(handles),
+                                                  handles,
+                                                  false,
+                                                  INFINITE);
+    if (result != WAIT_OBJECT_0 + 1) {
+      if (result != WAIT_OBJECT_0) {
+        CORE_LOG(LE, (L"[Scheduler wait failed][%d]", ::GetLastError()));
+      }
+      return;
+    }
+
+    uint64 next_wakeup_ms = 0;
+    RunDueWork(&next_wakeup_ms);
+    ArmTimer();
+  }
+}
+
 }  // namespace omaha
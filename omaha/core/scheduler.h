@@ -13,29 +13,55 @@
 // limitations under the License.
 // ========================================================================
 
-// TODO(omaha): consider using a waitable timer registered with the reactor. It
-// seems a lot less code than using the QueueTimer class.
+// The Scheduler runs all its work from one waitable timer and one thread. The
+// run times of the work are kept in a TimerWheel, and the timer is armed for
+// the earliest of them. Work which is allowed to run late, within a coalescing
+// window, runs in the same wakeup as other work when possible. Random jitter
+// spreads the runs of the clients over time, and after the computer resumes
+// from sleep, the work which missed its runs catches up only once.
 
 #ifndef OMAHA_CORE_SCHEDULER_H__
 #define OMAHA_CORE_SCHEDULER_H__
 
 #include <windows.h>
 #include <functional>
-#include <list>
 #include <memory>
+#include <vector>
 
 #include "base/basictypes.h"
 #include "omaha/base/highres_timer-win32.h"
-#include "omaha/base/queue_timer.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/base/thread.h"
+#include "omaha/core/timer_wheel.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 using ScheduledWork = std::function<void()>;
 using ScheduledWorkWithTimer = std::function<void(HighresTimer*)>;
 
-class Scheduler {
+// Provides the time and the random numbers used by a Scheduler. Tests and
+// simulations drive a Scheduler with a deterministic clock.
+class SchedulerClock {
  public:
+  virtual ~SchedulerClock() {}
+
+  // Returns the current time in milliseconds.
+  virtual uint64 NowMs() = 0;
+
+  // Returns a random number in the range [0, range].
+  virtual uint32 Random(uint32 range) = 0;
+};
+
+class Scheduler : public Runnable {
+ public:
+  // Creates a scheduler which runs the work on its own thread.
   explicit Scheduler();
+
+  // Creates a scheduler which reads the time from |clock| and does not have a
+  // thread. The work runs when RunDueWork is called.
+  explicit Scheduler(SchedulerClock* clock);
+
   ~Scheduler();
 
   // Starts the scheduler that executes |work| with regular |interval| (ms).
@@ -49,53 +75,88 @@ class Scheduler {
   // a timer which starts after the previous item finishes execution.
   HRESULT StartWithDebugTimer(int interval, ScheduledWorkWithTimer work) const;
 
+  // Starts the scheduler that executes |work| with regular |interval| (ms)
+  // after an initial |delay| (ms), and provides a debug timer to the callback.
+  // Each run is delayed by a random time up to |jitter| (ms). Each run may be
+  // delayed by up to |coalescing_window| (ms) more, to run in the same wakeup
+  // as other work.
+  HRESULT StartWithJitter(int delay,
+                          int interval,
+                          int jitter,
+                          int coalescing_window,
+                          ScheduledWorkWithTimer work) const;
+
+  // Returns false if there is no work. Otherwise, returns the time of the next
+  // wakeup, in the time of the clock, in |next_wakeup_ms|.
+  bool GetNextWakeup(uint64* next_wakeup_ms) const;
+
+  // Runs the work which is due at the current time, and returns the time of
+  // the next wakeup like GetNextWakeup. The thread of the scheduler calls this
+  // when the timer fires.
+  bool RunDueWork(uint64* next_wakeup_ms) const;
+
+  // Returns the number of calls to RunDueWork.
+  int wakeups() const;
+
  private:
-  class SchedulerItem {
-   public:
-    SchedulerItem(HANDLE timer_queue,
-                  int start_delay,
-                  int interval,
+  struct SchedulerItem {
+    SchedulerItem(int interval,
+                  int jitter,
+                  int coalescing_window,
                   bool has_debug_timer,
                   ScheduledWorkWithTimer work_fn);
 
-    ~SchedulerItem();
-
-    HighresTimer* debug_timer() const {
-      return debug_timer_ ? debug_timer_.get() : nullptr;
-    }
+    const int interval_ms;
+    const int jitter_ms;
+    const int coalescing_window_ms;
 
-    int interval_ms() const { return interval_ms_; }
-
-   private:
-    int start_delay_ms_;
-    int interval_ms_;
-
-    std::unique_ptr<QueueTimer> timer_;
+    // The work may run from |due_ms| to |due_ms| + |coalescing_window_ms|.
+    uint64 due_ms;
 
     // Measures the actual time interval between events for debugging
     // purposes. The timer is started when an alarm is set and then,
     // the value of the timer is read when the alarm goes off.
-    std::unique_ptr<HighresTimer> debug_timer_;
-
-    ScheduledWorkWithTimer work_;
+    std::unique_ptr<HighresTimer> debug_timer;
 
-    static HRESULT ScheduleNext(QueueTimer* timer,
-                                HighresTimer* debug_timer,
-                                int interval_ms);
-    static void TimerCallback(QueueTimer* timer);
+    const ScheduledWorkWithTimer work;
 
     DISALLOW_COPY_AND_ASSIGN(SchedulerItem);
   };
 
   HRESULT DoStart(int start_delay,
                   int interval,
+                  int jitter,
+                  int coalescing_window,
                   ScheduledWorkWithTimer work,
                   bool has_debug_timer = false) const;
 
-  // Timer queue handle for all QueueTimer objects.
-  HANDLE timer_queue_;
+  // Returns the current time, which does not go back.
+  uint64 CurrentTimeMs() const;
+
+  // Schedules the item at |index| to run |delay_ms| from |now_ms|, plus a
+  // random jitter.
+  void ScheduleItem(size_t index, uint64 now_ms, uint64 delay_ms) const;
+
+  // Arms the timer for the next wakeup, if the scheduler has a thread.
+  void ArmTimer() const;
+
+  // Runnable.
+  virtual void Run();
+
+  std::unique_ptr<SchedulerClock> system_clock_;
+  SchedulerClock* const clock_;
+
+  mutable LLock lock_;
+  mutable std::vector<std::unique_ptr<SchedulerItem>> items_;
+
+  // The deadlines of the items, keyed by the index of the item.
+  mutable TimerWheel wheel_;
+
+  mutable int wakeups_;
 
-  mutable std::list<SchedulerItem> timers_;
+  scoped_timer timer_;
+  scoped_event stop_event_;
+  Thread thread_;
 
   DISALLOW_COPY_AND_ASSIGN(Scheduler);
 };
@@ -15,10 +15,13 @@
 
 #include "omaha/core/scheduler.h"
 
+#include <algorithm>
 #include <functional>
+#include <vector>
 
 #include "omaha/base/constants.h"
 #include "omaha/base/highres_timer-win32.h"
+#include "omaha/testing/scheduler_simulation.h"
 #include "omaha/testing/unit_test.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -46,6 +49,9 @@ inline void AssertTimeoutAfter(HANDLE handle, DWORD timeout_ms) {
   ASSERT_EQ(WAIT_TIMEOUT, ::WaitForSingleObject(handle, timeout_ms));
 }
 
+const uint64 kMinuteMs = 60 * 1000;
+const uint64 kHourMs = 60 * kMinuteMs;
+
 }  // namespace
 
 class SchedulerTest : public ::testing::Test {
@@ -181,4 +187,168 @@ TEST_F(SchedulerTest, LongCallbackBlocks) {
   EXPECT_GE(timer.GetElapsedMs(), kCallbackDelay);
 }
 
+TEST_F(SchedulerTest, FakeClock_RunsAtInterval) {
+  FakeSchedulerClock clock(1);
+  clock.set_now_ms(1000);
+  Scheduler scheduler(&clock);
+
+  std::vector<uint64> run_times;
+  ASSERT_SUCCEEDED(scheduler.StartWithDelay(100, 1000, [&]() {
+    run_times.push_back(clock.NowMs());
+  }));
+
+  uint64 next_wakeup_ms = 0;
+  ASSERT_TRUE(scheduler.GetNextWakeup(&next_wakeup_ms));
+  EXPECT_EQ(1100, next_wakeup_ms);
+
+  // Nothing runs before the work is due.
+  clock.set_now_ms(1099);
+  ASSERT_TRUE(scheduler.RunDueWork(&next_wakeup_ms));
+  EXPECT_EQ(1100, next_wakeup_ms);
+  EXPECT_TRUE(run_times.empty());
+
+  RunScheduler(scheduler, &clock, 0, 0, 5000);
+  ASSERT_EQ(4, run_times.size());
+  EXPECT_EQ(1100, run_times[0]);
+  EXPECT_EQ(2100, run_times[1]);
+  EXPECT_EQ(3100, run_times[2]);
+  EXPECT_EQ(4100, run_times[3]);
+  EXPECT_EQ(5, scheduler.wakeups());
+}
+
+TEST_F(SchedulerTest, FakeClock_Jitter) {
+  FakeSchedulerClock clock(1);
+  Scheduler scheduler(&clock);
+
+  std::vector<uint64> run_times;
+  ASSERT_SUCCEEDED(scheduler.StartWithJitter(
+      1000, 1000, 500, 0, [&](HighresTimer*) {
+        run_times.push_back(clock.NowMs());
+      }));
+
+  RunScheduler(scheduler, &clock, 0, 0, 100000);
+  ASSERT_LE(66, run_times.size());
+  ASSERT_GE(100, run_times.size());
+  EXPECT_LE(1000, run_times[0]);
+  EXPECT_GE(1500, run_times[0]);
+  bool is_jittered = false;
+  for (size_t i = 1; i != run_times.size(); ++i) {
+    const uint64 interval_ms = run_times[i] - run_times[i - 1];
+    EXPECT_LE(1000, interval_ms);
+    EXPECT_GE(1500, interval_ms);
+    is_jittered |= interval_ms != run_times[1] - run_times[0];
+  }
+  EXPECT_TRUE(is_jittered);
+}
+
+TEST_F(SchedulerTest, FakeClock_Coalescing) {
+  FakeSchedulerClock clock(1);
+  Scheduler scheduler(&clock);
+
+  // The second work can run up to 600 ms late, so it always runs in a wakeup
+  // of the first work.
+  int first_count = 0;
+  int second_count = 0;
+  ASSERT_SUCCEEDED(scheduler.Start(1000, [&]() { ++first_count; }));
+  ASSERT_SUCCEEDED(scheduler.StartWithJitter(
+      1500, 1500, 0, 600, [&](HighresTimer*) {
+        EXPECT_EQ(0, clock.NowMs() % 1000);
+        ++second_count;
+      }));
+
+  RunScheduler(scheduler, &clock, 0, 0, 30500);
+  EXPECT_EQ(30, first_count);
+  EXPECT_EQ(15, second_count);
+  EXPECT_EQ(30, scheduler.wakeups());
+}
+
+TEST_F(SchedulerTest, FakeClock_CatchUpAfterSleep) {
+  FakeSchedulerClock clock(1);
+  Scheduler scheduler(&clock);
+
+  std::vector<uint64> jittered_run_times;
+  std::vector<uint64> run_times;
+  ASSERT_SUCCEEDED(scheduler.StartWithJitter(
+      kHourMs, kHourMs, 10 * kMinuteMs, 0, [&](HighresTimer*) {
+        jittered_run_times.push_back(clock.NowMs());
+      }));
+  ASSERT_SUCCEEDED(scheduler.Start(kHourMs, [&]() {
+    run_times.push_back(clock.NowMs());
+  }));
+
+  // The computer sleeps for 8 hours after 2 hours and a half. Each work runs
+  // once when the computer resumes, and the work with a jitter runs within
+  // the jitter.
+  const uint64 kSleepMs = 150 * kMinuteMs;
+  const uint64 kResumeMs = kSleepMs + 8 * kHourMs;
+  RunScheduler(scheduler, &clock, kSleepMs, kResumeMs, kResumeMs + kHourMs);
+
+  ASSERT_EQ(3, run_times.size());
+  EXPECT_EQ(kResumeMs, run_times[2]);
+
+  ASSERT_EQ(3, jittered_run_times.size());
+  EXPECT_LE(kResumeMs, jittered_run_times[2]);
+  EXPECT_GE(kResumeMs + 10 * kMinuteMs, jittered_run_times[2]);
+}
+
+TEST_F(SchedulerTest, FakeClock_ClockGoesBack) {
+  FakeSchedulerClock clock(1);
+  clock.set_now_ms(10000);
+  Scheduler scheduler(&clock);
+
+  int call_count = 0;
+  ASSERT_SUCCEEDED(scheduler.Start(1000, [&]() { ++call_count; }));
+
+  uint64 next_wakeup_ms = 0;
+  clock.set_now_ms(11000);
+  ASSERT_TRUE(scheduler.RunDueWork(&next_wakeup_ms));
+  EXPECT_EQ(1, call_count);
+  EXPECT_EQ(12000, next_wakeup_ms);
+
+  // The work does not run early when the clock goes back.
+  clock.set_now_ms(5000);
+  ASSERT_TRUE(scheduler.RunDueWork(&next_wakeup_ms));
+  EXPECT_EQ(1, call_count);
+  EXPECT_EQ(12000, next_wakeup_ms);
+}
+
+TEST_F(SchedulerTest, FakeClock_InvalidArguments) {
+  FakeSchedulerClock clock(1);
+  Scheduler scheduler(&clock);
+  EXPECT_EQ(E_INVALIDARG, scheduler.Start(0, []() {}));
+  EXPECT_EQ(E_INVALIDARG, scheduler.StartWithDelay(-1, 1000, []() {}));
+  EXPECT_EQ(E_INVALIDARG,
+            scheduler.StartWithJitter(0, 1000, -1, 0, [](HighresTimer*) {}));
+
+  uint64 next_wakeup_ms = 0;
+  EXPECT_FALSE(scheduler.GetNextWakeup(&next_wakeup_ms));
+}
+
+// Compares the wakeups of 100000 simulated clients and the peak of the
+// requests which reach the server, without jitter and coalescing, as before,
+// and with them. The benchmarks report the same simulation.
+TEST_F(SchedulerTest, FakeClock_Simulation) {
+  const int kNumClients = 100000;
+
+  SchedulerSimulationResult results[2];
+  for (int spread = 0; spread != 2; ++spread) {
+    ASSERT_SUCCEEDED(SimulateSchedulerClients(kNumClients,
+                                              spread != 0,
+                                              &results[spread]));
+  }
+
+  int peak_arrivals[2] = {};
+  for (int spread = 0; spread != 2; ++spread) {
+    const std::vector<int>& arrivals = results[spread].arrivals;
+    peak_arrivals[spread] = *std::max_element(arrivals.begin(),
+                                               arrivals.end());
+  }
+
+  // Spreading the catch up of the clients which resume together lowers the
+  // peak. The code red checks run in the wakeups of the update checks, so the
+  // only extra wakeup of a client is when it resumes and delays its catch up.
+  EXPECT_LT(peak_arrivals[1] * 4, peak_arrivals[0]);
+  EXPECT_LE(results[1].wakeups, results[0].wakeups + kNumClients);
+}
+
 }  // namespace omaha
@@ -0,0 +1,194 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// A timer at level L of the wheel has the same bits as the time of the wheel
+// above the bits of level L, and larger bits at level L. It is in the slot
+// given by its bits at level L. Therefore, the slots of a level which are not
+// empty all come after the slot of the current time at that level, and the
+// timers of a level all expire before the timers of the levels above it.
+
+#include "omaha/core/timer_wheel.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "omaha/base/debug.h"
+
+namespace omaha {
+
+TimerWheel::TimerWheel(uint64 now_ms) : now_ms_(now_ms) {
+  for (int level = 0; level != kNumLevels; ++level) {
+    occupied_[level] = 0;
+  }
+}
+
+TimerWheel::~TimerWheel() {}
+
+void TimerWheel::Schedule(int id, uint64 expiration_ms) {
+  Cancel(id);
+
+  // Timers can't expire after the end of the current rotation of the top
+  // wheel, which is more than a hundred years away.
+  Timer timer;
+  timer.expiration_ms = std::min(std::max(expiration_ms, now_ms_),
+                                 now_ms_ | kMaxDelayMs);
+  Place(id, &timer);
+  timers_[id] = timer;
+}
+
+bool TimerWheel::Cancel(int id) {
+  std::map<int, Timer>::iterator it = timers_.find(id);
+  if (it == timers_.end()) {
+    return false;
+  }
+  Unplace(id, it->second);
+  timers_.erase(it);
+  return true;
+}
+
+bool TimerWheel::IsScheduled(int id, uint64* expiration_ms) const {
+  std::map<int, Timer>::const_iterator cit = timers_.find(id);
+  if (cit == timers_.end()) {
+    return false;
+  }
+  if (expiration_ms) {
+    *expiration_ms = cit->second.expiration_ms;
+  }
+  return true;
+}
+
+bool TimerWheel::GetNextExpiration(uint64* expiration_ms) const {
+  ASSERT1(expiration_ms);
+
+  for (int level = 0; level != kNumLevels; ++level) {
+    const int current_slot = static_cast<int>(
+        (now_ms_ >> (kBitsPerLevel * level)) & (kSlotsPerLevel - 1));
+    ASSERT1(!(occupied_[level] & ((1ULL << current_slot) - 1)));
+    if (!(occupied_[level] >> current_slot)) {
+      continue;
+    }
+
+    int slot = current_slot;
+    while (!(occupied_[level] & (1ULL << slot))) {
+      ++slot;
+    }
+
+    if (level == 0) {
+      *expiration_ms = (now_ms_ & ~static_cast<uint64>(kSlotsPerLevel - 1)) |
+                       slot;
+      return true;
+    }
+
+    // The timers of a slot above the lowest level expire at different times.
+    const std::vector<int>& ids = slots_[level][slot];
+    ASSERT1(!ids.empty());
+    uint64 next_expiration_ms = std::numeric_limits<uint64>::max();
+    for (size_t i = 0; i != ids.size(); ++i) {
+      std::map<int, Timer>::const_iterator cit = timers_.find(ids[i]);
+      ASSERT1(cit != timers_.end());
+      next_expiration_ms = std::min(next_expiration_ms,
+                                    cit->second.expiration_ms);
+    }
+    *expiration_ms = next_expiration_ms;
+    return true;
+  }
+
+  ASSERT1(timers_.empty());
+  return false;
+}
+
+void TimerWheel::Advance(uint64 now_ms, std::vector<int>* expired_ids) {
+  ASSERT1(expired_ids);
+
+  now_ms = std::max(now_ms, now_ms_);
+
+  uint64 next_expiration_ms = 0;
+  while (GetNextExpiration(&next_expiration_ms) &&
+         next_expiration_ms <= now_ms) {
+    MoveTo(next_expiration_ms);
+
+    // After the move, the timers which expire now are in the current slot of
+    // the lowest level.
+    const int slot = static_cast<int>(
+        next_expiration_ms & (kSlotsPerLevel - 1));
+    std::vector<int> ids;
+    ids.swap(slots_[0][slot]);
+    occupied_[0] &= ~(1ULL << slot);
+    for (size_t i = 0; i != ids.size(); ++i) {
+      ASSERT1(timers_[ids[i]].expiration_ms == next_expiration_ms);
+      timers_.erase(ids[i]);
+      expired_ids->push_back(ids[i]);
+    }
+  }
+
+  MoveTo(now_ms);
+}
+
+void TimerWheel::Place(int id, Timer* timer) {
+  ASSERT1(timer);
+  ASSERT1(timer->expiration_ms >= now_ms_);
+
+  const uint64 different_bits = timer->expiration_ms ^ now_ms_;
+  int level = 0;
+  while (level != kNumLevels - 1 &&
+         (different_bits >> (kBitsPerLevel * (level + 1)))) {
+    ++level;
+  }
+
+  timer->level = level;
+  timer->slot = static_cast<int>(
+      (timer->expiration_ms >> (kBitsPerLevel * level)) &
+      (kSlotsPerLevel - 1));
+  slots_[level][timer->slot].push_back(id);
+  occupied_[level] |= 1ULL << timer->slot;
+}
+
+void TimerWheel::Unplace(int id, const Timer& timer) {
+  std::vector<int>& ids = slots_[timer.level][timer.slot];
+  std::vector<int>::iterator it = std::find(ids.begin(), ids.end(), id);
+  ASSERT1(it != ids.end());
+  ids.erase(it);
+  if (ids.empty()) {
+    occupied_[timer.level] &= ~(1ULL << timer.slot);
+  }
+}
+
+void TimerWheel::MoveTo(uint64 now_ms) {
+  ASSERT1(now_ms >= now_ms_);
+  now_ms_ = now_ms;
+
+  // The timers of the current slot of each level now have the same bits as
+  // the time of the wheel at that level, so they move to a lower level. The
+  // levels are visited from the top, since timers can move down by more than
+  // one level, to a slot which is also current.
+  for (int level = kNumLevels - 1; level != 0; --level) {
+    const int slot = static_cast<int>(
+        (now_ms_ >> (kBitsPerLevel * level)) & (kSlotsPerLevel - 1));
+    if (!(occupied_[level] & (1ULL << slot))) {
+      continue;
+    }
+
+    std::vector<int> ids;
+    ids.swap(slots_[level][slot]);
+    occupied_[level] &= ~(1ULL << slot);
+    for (size_t i = 0; i != ids.size(); ++i) {
+      Timer& timer = timers_[ids[i]];
+      Place(ids[i], &timer);
+      ASSERT1(timer.level < level);
+    }
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,108 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// TimerWheel keeps track of the expiration times of a set of timers, in
+// milliseconds. The timers are kept in a hierarchy of wheels of 64 slots. A
+// timer is in the lowest wheel whose slots are wide enough to tell its
+// expiration apart from the current time of the wheel, and it moves down to
+// the lower wheels as the time of the wheel gets closer to its expiration.
+// Scheduling and canceling a timer are constant time, and advancing the wheel
+// over a long period of time, for instance after the computer resumes from
+// sleep, only visits the slots of the timers which expire in that period.
+//
+// TimerWheel does not read a clock and does not fire any callbacks. The owner
+// advances the wheel to the current time and handles the expired timers.
+
+#ifndef OMAHA_CORE_TIMER_WHEEL_H_
+#define OMAHA_CORE_TIMER_WHEEL_H_
+
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class TimerWheel {
+ public:
+  explicit TimerWheel(uint64 now_ms);
+  ~TimerWheel();
+
+  // Schedules the timer |id| to expire at |expiration_ms|. A timer which is
+  // already scheduled with this id is rescheduled. Expiration times in the
+  // past expire at the next call to Advance.
+  void Schedule(int id, uint64 expiration_ms);
+
+  // Cancels the timer |id|. Returns false if the timer is not scheduled.
+  bool Cancel(int id);
+
+  // Returns true if the timer |id| is scheduled, and its expiration time in
+  // |expiration_ms|, which can be NULL.
+  bool IsScheduled(int id, uint64* expiration_ms) const;
+
+  // Returns false if no timer is scheduled. Otherwise, returns the earliest
+  // expiration time of the timers in |expiration_ms|.
+  bool GetNextExpiration(uint64* expiration_ms) const;
+
+  // Advances the wheel to |now_ms| and appends the ids of the timers which
+  // expired to |expired_ids|, in order of expiration. The time of the wheel
+  // does not go back if |now_ms| is earlier than the time of the wheel.
+  void Advance(uint64 now_ms, std::vector<int>* expired_ids);
+
+  uint64 now_ms() const { return now_ms_; }
+  size_t size() const { return timers_.size(); }
+
+ private:
+  static const int kBitsPerLevel = 6;
+  static const int kSlotsPerLevel = 1 << kBitsPerLevel;
+  static const int kNumLevels = 7;
+
+  // Timers can't be scheduled further than this from the time of the wheel,
+  // which is more than a hundred years.
+  static const uint64 kMaxDelayMs =
+      (1ULL << (kBitsPerLevel * kNumLevels)) - 1;
+
+  struct Timer {
+    Timer() : expiration_ms(0), level(0), slot(0) {}
+
+    uint64 expiration_ms;
+    int level;
+    int slot;
+  };
+
+  // Adds the timer |id| to the slot for its expiration time.
+  void Place(int id, Timer* timer);
+
+  // Removes the timer |id| from its slot.
+  void Unplace(int id, const Timer& timer);
+
+  // Moves the time of the wheel forward to |now_ms|, which must not be later
+  // than the next expiration time, and moves the timers of the slots which
+  // become current to the lower wheels.
+  void MoveTo(uint64 now_ms);
+
+  uint64 now_ms_;
+  std::map<int, Timer> timers_;
+  std::vector<int> slots_[kNumLevels][kSlotsPerLevel];
+
+  // One bit per slot, set if the slot is not empty.
+  uint64 occupied_[kNumLevels];
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_CORE_TIMER_WHEEL_H_
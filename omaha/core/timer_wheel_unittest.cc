@@ -0,0 +1,174 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/core/timer_wheel.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+TEST(TimerWheelTest, Empty) {
+  TimerWheel wheel(1000);
+  uint64 expiration_ms = 0;
+  EXPECT_FALSE(wheel.GetNextExpiration(&expiration_ms));
+
+  std::vector<int> expired_ids;
+  wheel.Advance(5000, &expired_ids);
+  EXPECT_TRUE(expired_ids.empty());
+  EXPECT_EQ(5000, wheel.now_ms());
+
+  // The time of the wheel does not go back.
+  wheel.Advance(4000, &expired_ids);
+  EXPECT_EQ(5000, wheel.now_ms());
+}
+
+TEST(TimerWheelTest, ExpiresInOrder) {
+  TimerWheel wheel(0);
+  wheel.Schedule(1, 24 * 60 * 60 * 1000);
+  wheel.Schedule(2, 70);
+  wheel.Schedule(3, 60 * 60 * 1000);
+  wheel.Schedule(4, 70);
+  wheel.Schedule(5, 5000);
+  EXPECT_EQ(5, wheel.size());
+
+  uint64 expiration_ms = 0;
+  ASSERT_TRUE(wheel.GetNextExpiration(&expiration_ms));
+  EXPECT_EQ(70, expiration_ms);
+
+  std::vector<int> expired_ids;
+  wheel.Advance(69, &expired_ids);
+  EXPECT_TRUE(expired_ids.empty());
+
+  // Advancing over a long time expires the timers in order.
+  wheel.Advance(2 * 60 * 60 * 1000, &expired_ids);
+  ASSERT_EQ(4, expired_ids.size());
+  EXPECT_EQ(2, expired_ids[0]);
+  EXPECT_EQ(4, expired_ids[1]);
+  EXPECT_EQ(5, expired_ids[2]);
+  EXPECT_EQ(3, expired_ids[3]);
+
+  ASSERT_TRUE(wheel.GetNextExpiration(&expiration_ms));
+  EXPECT_EQ(24 * 60 * 60 * 1000, expiration_ms);
+  EXPECT_TRUE(wheel.IsScheduled(1, NULL));
+  EXPECT_FALSE(wheel.IsScheduled(3, NULL));
+}
+
+TEST(TimerWheelTest, ScheduleAndCancel) {
+  TimerWheel wheel(100);
+
+  // A timer which is scheduled in the past expires at the next advance.
+  wheel.Schedule(1, 10);
+  uint64 expiration_ms = 0;
+  EXPECT_TRUE(wheel.IsScheduled(1, &expiration_ms));
+  EXPECT_EQ(100, expiration_ms);
+
+  // Scheduling a timer again moves it.
+  wheel.Schedule(1, 100000);
+  EXPECT_TRUE(wheel.IsScheduled(1, &expiration_ms));
+  EXPECT_EQ(100000, expiration_ms);
+  EXPECT_EQ(1, wheel.size());
+
+  EXPECT_TRUE(wheel.Cancel(1));
+  EXPECT_FALSE(wheel.Cancel(1));
+  EXPECT_FALSE(wheel.GetNextExpiration(&expiration_ms));
+
+  std::vector<int> expired_ids;
+  wheel.Advance(200000, &expired_ids);
+  EXPECT_TRUE(expired_ids.empty());
+}
+
+// Compares the wheel with a map of the expiration times over random
+// operations, with delays from a few milliseconds to several months.
+TEST(TimerWheelTest, MatchesModel) {
+  uint32 random_state = 12345;
+  auto next_random = [&random_state]() {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+  };
+  auto random_delay = [&next_random]() -> uint64 {
+    switch (next_random() % 3) {
+      case 0:
+        return next_random() % 100;
+      case 1:
+        return next_random() % 100000;
+      default:
+        return (static_cast<uint64>(next_random()) << 2) % (1ULL << 34);
+    }
+  };
+
+  for (int round = 0; round != 20; ++round) {
+    TimerWheel wheel(static_cast<uint64>(next_random()) << 8);
+    std::map<int, uint64> model;
+
+    for (int step = 0; step != 2000; ++step) {
+      const int id = next_random() % 50;
+      switch (next_random() % 4) {
+        case 0:
+        case 1: {
+          const uint64 expiration_ms = wheel.now_ms() + random_delay();
+          wheel.Schedule(id, expiration_ms);
+          model[id] = expiration_ms;
+          break;
+        }
+        case 2:
+          ASSERT_EQ(model.erase(id) != 0, wheel.Cancel(id));
+          break;
+        default: {
+          const uint64 now_ms = wheel.now_ms() + random_delay();
+          std::vector<int> expired_ids;
+          wheel.Advance(now_ms, &expired_ids);
+
+          uint64 previous_expiration_ms = 0;
+          for (size_t i = 0; i != expired_ids.size(); ++i) {
+            std::map<int, uint64>::iterator it = model.find(expired_ids[i]);
+            ASSERT_TRUE(it != model.end());
+            ASSERT_LE(it->second, now_ms);
+            ASSERT_LE(previous_expiration_ms, it->second);
+            previous_expiration_ms = it->second;
+            model.erase(it);
+          }
+          for (std::map<int, uint64>::const_iterator cit = model.begin();
+               cit != model.end();
+               ++cit) {
+            ASSERT_GT(cit->second, now_ms);
+          }
+          break;
+        }
+      }
+
+      ASSERT_EQ(model.size(), wheel.size());
+      uint64 expiration_ms = 0;
+      ASSERT_EQ(!model.empty(), wheel.GetNextExpiration(&expiration_ms));
+      if (!model.empty()) {
+        uint64 expected_expiration_ms = model.begin()->second;
+        for (std::map<int, uint64>::const_iterator cit = model.begin();
+             cit != model.end();
+             ++cit) {
+          expected_expiration_ms = std::min(expected_expiration_ms,
+                                            cit->second);
+        }
+        ASSERT_EQ(expected_expiration_ms, expiration_ms);
+      }
+    }
+  }
+}
+
+}  // namespace omaha
@@ -32,10 +32,31 @@
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
+#include "omaha/goopdate/worker_metrics.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
+namespace {
+
+// The registry values of the download and install progress are written every
+// time the progress crosses a multiple of this percentage.
+const int kRegistryProgressMilestonePercent = 10;
+
+// The value of the milestones before any progress is written.
+const int kNoRegistryMilestone = -2;
+
+// Returns the milestone of |percentage|. The unknown progress is a milestone
+// of its own.
+int GetRegistryMilestone(int percentage) {
+  if (percentage < 0) {
+    return kCurrentStateProgressUnknown;
+  }
+  return percentage - percentage % kRegistryProgressMilestonePercent;
+}
+
+}  // namespace
+
 App::App(const GUID& app_guid, bool is_update, AppBundle* app_bundle)
     : ModelObject(app_bundle->model()),
       app_bundle_(app_bundle),
@@ -62,6 +83,10 @@ App::App(const GUID& app_guid, bool is_update, AppBundle* app_bundle)
       source_url_index_(-1),
       state_cancelled_(STATE_ERROR),
       previous_total_download_bytes_(0),
+      install_progress_percentage_(kCurrentStateProgressUnknown),
+      registry_state_value_(-1),
+      registry_download_milestone_(kNoRegistryMilestone),
+      registry_install_milestone_(kNoRegistryMilestone),
       num_bytes_downloaded_(0),
       can_skip_signature_verification_(false) {
   ASSERT1(!::IsEqualGUID(GUID_NULL, app_guid_));
@@ -307,23 +332,70 @@ STDMETHODIMP App::put_usageStatsEnable(UINT usage_stats_enable) {
   return S_OK;
 }
 
-// TODO(omaha3): Replace decisions based on state() with calls to AppState.
-// In this case, there should be a GetCurrentState() method on AppState.
 STDMETHODIMP App::get_currentState(IDispatch** current_state) {
   __mutexScope(model()->lock());
 
   CORE_LOG(L6, (_T("[App::get_currentState][0x%p]"), this));
   ASSERT1(current_state);
 
-  ULONGLONG bytes_downloaded = 0;
-  ULONGLONG total_bytes_to_download = 0;
-  ULONGLONG next_download_retry_time = 0;
-  LONG download_time_remaining_ms = kCurrentStateProgressUnknown;
-  LONG install_progress_percentage = kCurrentStateProgressUnknown;
-  LONG install_time_remaining_ms = kCurrentStateProgressUnknown;
+  AppProgress progress;
+  HRESULT hr = GetCurrentProgress(&progress);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CComObject<CurrentAppState>* state_object = NULL;
+  hr = CurrentAppState::Create(progress.state,
+                               progress.available_version,
+                               progress.bytes_downloaded,
+                               progress.total_bytes_to_download,
+                               progress.download_time_remaining_ms,
+                               progress.next_download_retry_time,
+                               progress.install_progress_percentage,
+                               progress.install_time_remaining_ms,
+                               is_canceled_,
+                               error_context_.error_code,
+                               error_context_.extra_code1,
+                               completion_message_,
+                               installer_result_code_,
+                               installer_result_extra_code1_,
+                               post_install_launch_command_line_,
+                               post_install_url_,
+                               post_install_action_,
+                               &state_object);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return state_object->QueryInterface(current_state);
+}
+
+STDMETHODIMP App::get_untrustedData(BSTR* data) {
+  __mutexScope(model()->lock());
+  ASSERT1(data);
+  *data = untrusted_data_.AllocSysString();
+  return S_OK;
+}
+
+STDMETHODIMP App::put_untrustedData(BSTR data) {
+  __mutexScope(model()->lock());
+  untrusted_data_ = data;
+  return S_OK;
+}
+
+// TODO(omaha3): Replace decisions based on state() with calls to AppState.
+// In this case, there should be a GetCurrentState() method on AppState.
+HRESULT App::GetCurrentProgress(AppProgress* progress) {
+  ASSERT1(model()->IsLockedByCaller());
+  ASSERT1(progress);
+
+  *progress = AppProgress();
+  progress->app_guid = app_guid_;
+  progress->state = state();
+  progress->available_version = next_version_->version();
 
   HRESULT hr = S_OK;
-  switch (state()) {
+  switch (progress->state) {
     case STATE_INIT:
       break;
     case STATE_WAITING_TO_CHECK_FOR_UPDATE:
@@ -347,39 +419,27 @@ STDMETHODIMP App::get_currentState(IDispatch** current_state) {
     case STATE_EXTRACTING:
     case STATE_APPLYING_DIFFERENTIAL_PATCH:
     case STATE_READY_TO_INSTALL:
-      hr = GetDownloadProgress(&bytes_downloaded,
-                               &total_bytes_to_download,
-                               &download_time_remaining_ms,
-                               &next_download_retry_time);
-      if (SUCCEEDED(hr)) {
-        VERIFY_SUCCEEDED(AppManager::Instance()->WriteDownloadProgress(
-                *this,
-                bytes_downloaded,
-                total_bytes_to_download,
-                download_time_remaining_ms));
-      }
+      hr = GetDownloadProgress(&progress->bytes_downloaded,
+                               &progress->total_bytes_to_download,
+                               &progress->download_time_remaining_ms,
+                               &progress->next_download_retry_time);
       break;
     case STATE_WAITING_TO_INSTALL:
       break;
     case STATE_INSTALLING:
       // Many installers do not write Installer Progress. We try to read it, but
       // we ignore any read errors.
-      GetInstallProgress(&install_progress_percentage,
-                         &install_time_remaining_ms);
-      VERIFY_SUCCEEDED(AppManager::Instance()->WriteInstallProgress(
-              *this, install_progress_percentage, install_time_remaining_ms));
+      GetInstallProgress(&progress->install_progress_percentage,
+                         &progress->install_time_remaining_ms);
       break;
     case STATE_INSTALL_COMPLETE:
-      install_progress_percentage = 100;
-      install_time_remaining_ms = 0;
+      progress->install_progress_percentage = 100;
+      progress->install_time_remaining_ms = 0;
 
       ASSERT1(error_code() == S_OK);
       ASSERT1(!completion_message_.IsEmpty());
       ASSERT1(completion_result_ == PingEvent::EVENT_RESULT_SUCCESS ||
               completion_result_ == PingEvent::EVENT_RESULT_SUCCESS_REBOOT);
-
-      VERIFY_SUCCEEDED(AppManager::Instance()->WriteInstallProgress(
-              *this, install_progress_percentage, install_time_remaining_ms));
       break;
     case STATE_PAUSED:
       break;
@@ -399,49 +459,63 @@ STDMETHODIMP App::get_currentState(IDispatch** current_state) {
       break;
   }
 
-  VERIFY_SUCCEEDED(AppManager::Instance()->WriteStateValue(*this, state()));
+  return hr;
+}
 
-  if (FAILED(hr)) {
-    return hr;
+void App::PublishProgress() {
+  ASSERT1(model()->IsLockedByCaller());
+
+  AppProgress progress;
+  if (FAILED(GetCurrentProgress(&progress))) {
+    return;
   }
 
-  CComObject<CurrentAppState>* state_object = NULL;
-  hr = CurrentAppState::Create(state(),
-                               next_version()->version(),
-                               bytes_downloaded,
-                               total_bytes_to_download,
-                               download_time_remaining_ms,
-                               next_download_retry_time,
-                               install_progress_percentage,
-                               install_time_remaining_ms,
-                               is_canceled_,
-                               error_context_.error_code,
-                               error_context_.extra_code1,
-                               completion_message_,
-                               installer_result_code_,
-                               installer_result_extra_code1_,
-                               post_install_launch_command_line_,
-                               post_install_url_,
-                               post_install_action_,
-                               &state_object);
-  if (FAILED(hr)) {
-    return hr;
+  ProgressTable* progress_table = app_bundle_->progress_table();
+  if (progress_table && SUCCEEDED(progress_table->Write(progress))) {
+    ++metric_worker_progress_table_writes;
   }
 
-  return state_object->QueryInterface(current_state);
+  WriteRegistryProgress(progress);
 }
 
-STDMETHODIMP App::get_untrustedData(BSTR* data) {
-  __mutexScope(model()->lock());
-  ASSERT1(data);
-  *data = untrusted_data_.AllocSysString();
-  return S_OK;
-}
+void App::WriteRegistryProgress(const AppProgress& progress) {
+  ASSERT1(model()->IsLockedByCaller());
 
-STDMETHODIMP App::put_untrustedData(BSTR data) {
-  __mutexScope(model()->lock());
-  untrusted_data_ = data;
-  return S_OK;
+  AppManager* app_manager = AppManager::Instance();
+
+  if (registry_state_value_ != progress.state) {
+    registry_state_value_ = progress.state;
+    VERIFY_SUCCEEDED(app_manager->WriteStateValue(*this, progress.state));
+    ++metric_worker_progress_registry_writes;
+  }
+
+  if (progress.total_bytes_to_download) {
+    const int milestone = GetRegistryMilestone(static_cast<int>(
+        100ULL * progress.bytes_downloaded / progress.total_bytes_to_download));
+    if (registry_download_milestone_ != milestone) {
+      registry_download_milestone_ = milestone;
+      VERIFY_SUCCEEDED(app_manager->WriteDownloadProgress(
+              *this,
+              progress.bytes_downloaded,
+              progress.total_bytes_to_download,
+              progress.download_time_remaining_ms));
+      ++metric_worker_progress_registry_writes;
+    }
+  }
+
+  if (progress.state == STATE_INSTALLING ||
+      progress.state == STATE_INSTALL_COMPLETE) {
+    const int milestone =
+        GetRegistryMilestone(progress.install_progress_percentage);
+    if (registry_install_milestone_ != milestone) {
+      registry_install_milestone_ = milestone;
+      VERIFY_SUCCEEDED(app_manager->WriteInstallProgress(
+              *this,
+              progress.install_progress_percentage,
+              progress.install_time_remaining_ms));
+      ++metric_worker_progress_registry_writes;
+    }
+  }
 }
 
 // TODO(omaha3): If some packages are already cached, there may be awkward jumps
@@ -513,6 +587,12 @@ HRESULT App::GetInstallProgress(LONG* install_progress_percentage,
   *install_progress_percentage = kCurrentStateProgressUnknown;
   *install_time_remaining_ms = kCurrentStateProgressUnknown;
 
+  // The InstallerWrapper reports the progress as the installer writes it.
+  if (install_progress_percentage_ != kCurrentStateProgressUnknown) {
+    *install_progress_percentage = install_progress_percentage_;
+    return S_OK;
+  }
+
   // Installation progress is reported in "InstallerProgress" under
   // Google\\Update\\ClientState\\{AppID}. It is a value that goes from 0% to
   // 100%.
@@ -541,6 +621,8 @@ HRESULT App::GetInstallProgress(LONG* install_progress_percentage,
 HRESULT App::ResetInstallProgress() {
   ASSERT1(model()->IsLockedByCaller());
 
+  install_progress_percentage_ = kCurrentStateProgressUnknown;
+
   const CString base_key_name(ConfigManager::Instance()->registry_client_state(
       app_bundle_->is_machine()));
   const CString app_id_key_name(AppendRegKeyPath(base_key_name,
@@ -548,6 +630,15 @@ HRESULT App::ResetInstallProgress() {
   return RegKey::DeleteValue(app_id_key_name, kRegValueInstallerProgress);
 }
 
+void App::SetInstallProgress(LONG install_progress_percentage) {
+  __mutexScope(model()->lock());
+  ASSERT1(install_progress_percentage >= 0);
+
+  install_progress_percentage_ = std::min<LONG>(100,
+                                                install_progress_percentage);
+  PublishProgress();
+}
+
 AppBundle* App::app_bundle() {
   __mutexScope(model()->lock());
   return app_bundle_;
@@ -669,7 +760,8 @@ CString App::GetExperimentLabels() const {
 
 CString App::GetExperimentLabelsNoTimestamps() const {
   __mutexScope(model()->lock());
-  return ExperimentLabels::RemoveTimestamps(GetExperimentLabels());
+  return ExperimentLabels::ReadRegistryNoTimestamps(app_bundle_->is_machine(),
+                                                    app_guid_string());
 }
 
 CString App::referral_id() const {
@@ -1154,6 +1246,8 @@ void App::ChangeState(fsm::AppState* app_state) {
   if (ping_event.get()) {
     AddPingEvent(ping_event);
   }
+
+  PublishProgress();
 }
 
 void App::SetError(const ErrorContext& error_context, const CString& message) {
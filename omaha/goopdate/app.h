@@ -32,6 +32,7 @@
 #include "omaha/common/app_registry_utils.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/ping_event.h"
+#include "omaha/common/progress_table.h"
 #include "omaha/common/protocol_definition.h"
 #include "omaha/goopdate/com_wrapper_creator.h"
 #include "omaha/goopdate/installer_result_info.h"
@@ -387,6 +388,18 @@ class App : public ModelObject {
   // Deletes "InstallerProgress" under Google\\Update\\ClientState\\{AppID}.
   HRESULT ResetInstallProgress();
 
+  // Records the progress which the installer reported while it runs. The
+  // InstallerWrapper reports the changes of "InstallerProgress" as they
+  // happen, so the progress does not have to be read from the registry.
+  void SetInstallProgress(LONG install_progress_percentage);
+
+  // Publishes the state and the progress of the app in the progress table of
+  // the bundle. The registry values of the CurrentState key, which are read by
+  // older clients, are only written when the state changes and at every
+  // tenth of the download and install progress. Called under the model lock
+  // whenever the state or the progress changes.
+  void PublishProgress();
+
  private:
   // TODO(omaha): accessing directly the data members bypasses locking. Review
   // the places where members are accessed by friends and check the caller locks
@@ -409,6 +422,11 @@ class App : public ModelObject {
   HRESULT GetInstallProgress(LONG* install_progress_percentage,
                              LONG* install_time_remaining_ms);
 
+  // Gets the state and the progress which ICurrentState reports.
+  HRESULT GetCurrentProgress(AppProgress* progress);
+
+  void WriteRegistryProgress(const AppProgress& progress);
+
   void ChangeState(fsm::AppState* app_state);
 
   int GetTimeDifferenceMs(TimeMetricType time_start_metric_type,
@@ -515,6 +533,16 @@ class App : public ModelObject {
 
   uint64 previous_total_download_bytes_;
 
+  // The last progress reported by the installer, or
+  // kCurrentStateProgressUnknown.
+  LONG install_progress_percentage_;
+
+  // The values last written in the CurrentState key, so that the registry is
+  // only written at the milestones.
+  LONG registry_state_value_;
+  int registry_download_milestone_;
+  int registry_install_milestone_;
+
   // Metrics values.
   uint64 num_bytes_downloaded_;
   uint64 time_metrics_[TIME_METRICS_MAX];
@@ -27,6 +27,7 @@
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/lang.h"
+#include "omaha/common/progress_table.h"
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
 #include "omaha/common/web_services_client.h"
@@ -479,6 +480,24 @@ const CString& AppBundle::session_id() const {
   return session_id_;
 }
 
+ProgressTable* AppBundle::progress_table() {
+  ASSERT1(model()->IsLockedByCaller());
+
+  if (!progress_table_.get() && !session_id_.IsEmpty()) {
+    progress_table_.reset(new ProgressTable);
+    HRESULT hr = progress_table_->Create(is_machine_, session_id_);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[ProgressTable::Create failed][0x%08x]"), hr));
+    }
+  }
+
+  if (!progress_table_.get() || !progress_table_->is_open()) {
+    return NULL;
+  }
+
+  return progress_table_.get();
+}
+
 int AppBundle::priority() const {
   __mutexScope(model()->lock());
   return priority_;
@@ -45,6 +45,7 @@ namespace omaha {
 
 class App;
 class Model;
+class ProgressTable;
 class WebServicesClientInterface;
 class UserWorkItem;
 
@@ -165,6 +166,11 @@ class AppBundle
 
   const CString& session_id() const;
 
+  // Returns the table in which the apps publish their progress, or NULL if
+  // the table can't be created. The table is created the first time it is
+  // needed. Called under the model lock.
+  ProgressTable* progress_table();
+
   CString display_language() const;
 
   int priority() const;
@@ -248,6 +254,9 @@ class AppBundle
 
   std::unique_ptr<fsm::AppBundleState> app_bundle_state_;
 
+  // Named after session_id_, so that the clients can find it.
+  std::unique_ptr<ProgressTable> progress_table_;
+
   // Impersonation and primary tokens set by the client. Typically only
   // set by the gupdatem service. The gupdatem service exposes a narrow
   // interface to medium integrity clients. When a medium integrity client calls
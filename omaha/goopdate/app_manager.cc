@@ -15,6 +15,7 @@
 
 #include "omaha/goopdate/app_manager.h"
 
+#include <climits>
 #include <cstdlib>
 #include <algorithm>
 #include <functional>
@@ -32,10 +33,11 @@
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/oem_install_utils.h"
-#include "omaha/goopdate/application_usage_data.h"
+#include "omaha/goopdate/app_registry_snapshot.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
+#include "omaha/goopdate/usage_data_collector.h"
 
 namespace omaha {
 
@@ -45,6 +47,9 @@ const uint32 kInitialInstallTimeDiff = static_cast<uint32>(-1 * kSecondsPerDay);
 const uint32 kInitialDayOfInstall = static_cast<uint32>(-1);
 const uint32 kUnknownDayOfInstall = 0;
 
+// The apps of a bundle are read one after the other, well within this time.
+const uint64 kUsageDataMaxSweepAgeMs = 10 * 1000;
+
 // Returns the number of days haven been passed since the given time.
 // The parameter time is in the same format as C time() returns.
 int GetNumberOfDaysSince(int time) {
@@ -81,6 +86,71 @@ HRESULT EnumerateSubKeys(const TCHAR* key_name,
   return S_OK;
 }
 
+// The functions below compute the same values as the corresponding
+// AppManager and app_registry_utils functions from the registry snapshot of
+// an app.
+
+// Registered apps have a Clients key. Uninstalled apps only have a ClientState
+// key, which contains the pv value.
+bool IsRegisteredOrUninstalled(const AppRegistrySnapshot& snapshot) {
+  return snapshot.client_key().exists() ||
+         snapshot.client_state_key().HasValue(kRegValueProductVersion);
+}
+
+uint32 InstallTimeDiffSecFromSnapshot(const AppRegistrySnapshot& snapshot) {
+  if (!IsRegisteredOrUninstalled(snapshot)) {
+    return kInitialInstallTimeDiff;
+  }
+
+  DWORD install_time(0);
+  if (FAILED(snapshot.client_state_key().GetValue(kRegValueInstallTimeSec,
+                                                  &install_time))) {
+    return 0;
+  }
+
+  const int now = Time64ToInt32(GetCurrent100NSTime());
+  if (0 != install_time &&
+      static_cast<DWORD>(now) >= install_time &&
+      INT_MAX >= static_cast<DWORD>(now) - install_time) {
+    return now - install_time;
+  }
+  return 0;
+}
+
+uint32 DayOfInstallFromSnapshot(const AppRegistrySnapshot& snapshot) {
+  if (!IsRegisteredOrUninstalled(snapshot)) {
+    return kInitialDayOfInstall;
+  }
+
+  DWORD day_of_install(0);
+  if (SUCCEEDED(snapshot.client_state_key().GetValue(kRegValueDayOfInstall,
+                                                     &day_of_install)) &&
+      day_of_install != static_cast<DWORD>(-1)) {
+    // Truncate day of install to the first day of that week.
+    const int kDaysInWeek = 7;
+    return day_of_install / kDaysInWeek * kDaysInWeek;
+  }
+
+  return kUnknownDayOfInstall;
+}
+
+Tristate UsageStatsEnabledFromSnapshot(const AppRegistrySnapshot& snapshot) {
+  if (!IsRegisteredOrUninstalled(snapshot)) {
+    return TRISTATE_NONE;
+  }
+
+  // ClientStateMedium takes precedence. It only exists for machine apps.
+  DWORD stats_enabled = 0;
+  if (SUCCEEDED(snapshot.client_state_medium_key().GetValue(
+                    kRegValueUsageStats, &stats_enabled)) ||
+      SUCCEEDED(snapshot.client_state_key().GetValue(kRegValueUsageStats,
+                                                     &stats_enabled))) {
+    return TRISTATE_TRUE == stats_enabled ? TRISTATE_TRUE : TRISTATE_FALSE;
+  }
+
+  return TRISTATE_FALSE;
+}
+
 }  // namespace
 
 
@@ -137,8 +207,32 @@ HRESULT AppManager::ReadAppVersionNoLock(bool is_machine, const GUID& app_guid,
 }
 
 AppManager::AppManager(bool is_machine)
-    : is_machine_(is_machine) {
+    : is_machine_(is_machine),
+      snapshot_cache_(new AppRegistrySnapshotCache(
+          is_machine, std::make_unique<RegKeyAppRegistryBackend>())),
+      usage_data_collector_(new UsageDataCollector(
+          is_machine,
+          vista_util::IsVistaOrLater(),
+          std::make_unique<RegKeyUsageDataBackend>())) {
   CORE_LOG(L3, (_T("[AppManager::AppManager][is_machine=%d]"), is_machine));
+  VERIFY1(no_installing_apps_gate_.Open());
+}
+
+AppManager::~AppManager() {
+}
+
+HRESULT AppManager::EnableRegistrySnapshots() {
+  usage_data_collector_->set_max_sweep_age_ms(kUsageDataMaxSweepAgeMs);
+  return snapshot_cache_->StartMonitoring();
+}
+
+std::shared_ptr<const AppRegistrySnapshot> AppManager::GetRegistrySnapshot(
+    const CString& app_id) const {
+  return snapshot_cache_->GetSnapshot(app_id);
+}
+
+void AppManager::InvalidateRegistrySnapshot(const CString& app_id) const {
+  snapshot_cache_->Invalidate(app_id);
 }
 
 // App installers should use similar code to create a lock to acquire while
@@ -265,14 +359,73 @@ HRESULT AppManager::RunRegistrationUpdateHook(const CString& app_id) const {
 }
 
 
+void AppManager::AddInstallingApp(const GUID& app_guid) {
+  ASSERT1(IsRegistryStableStateLockedByCaller());
+  ASSERT1(!IsAppInstalling(app_guid));
+
+  __mutexScope(installing_apps_lock_);
+  installing_app_ids_.push_back(GuidToString(app_guid));
+  VERIFY1(no_installing_apps_gate_.Close());
+}
+
+void AppManager::RemoveInstallingApp(const GUID& app_guid) {
+  ASSERT1(IsRegistryStableStateLockedByCaller());
+
+  const CString app_id = GuidToString(app_guid);
+  __mutexScope(installing_apps_lock_);
+  for (AppIdVector::iterator it = installing_app_ids_.begin();
+       it != installing_app_ids_.end();
+       ++it) {
+    if (!it->CompareNoCase(app_id)) {
+      installing_app_ids_.erase(it);
+      if (installing_app_ids_.empty()) {
+        VERIFY1(no_installing_apps_gate_.Open());
+      }
+      return;
+    }
+  }
+
+  ASSERT1(false);
+}
+
+bool AppManager::IsAppInstalling(const GUID& app_guid) const {
+  const CString app_id = GuidToString(app_guid);
+  __mutexScope(installing_apps_lock_);
+  for (size_t i = 0; i != installing_app_ids_.size(); ++i) {
+    if (!installing_app_ids_[i].CompareNoCase(app_id)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The gate is opened when the last installing app is removed, so the caller
+// may wake up for the install of another app and wait again.
+void AppManager::WaitForAppInstall(const GUID& app_guid) {
+  ASSERT1(IsRegistryStableStateLockedByCaller());
+
+  while (IsAppInstalling(app_guid)) {
+    registry_stable_state_lock_.Unlock();
+    VERIFY1(no_installing_apps_gate_.Wait(INFINITE));
+    registry_stable_state_lock_.Lock();
+  }
+}
+
 // Vulnerable to a race condition with installers. To prevent this, hold
 // GetRegistryStableStateLock() while calling this function and related
 // functions, such as ReadAppPersistentData().
+// The apps which are being installed are not reported, since their installer
+// may be writing their Clients key.
 HRESULT AppManager::GetRegisteredApps(AppIdVector* app_ids) const {
   ASSERT1(app_ids);
   return EnumerateSubKeys(
       ConfigManager::Instance()->registry_clients(is_machine_),
       [&](const CString& subkey) {
+        GUID app_guid = GUID_NULL;
+        if (SUCCEEDED(StringToGuidSafe(subkey, &app_guid)) &&
+            this->IsAppInstalling(app_guid)) {
+          return;
+        }
         if (this->IsAppRegistered(subkey)) {
           app_ids->push_back(subkey);
         }
@@ -281,11 +434,18 @@ HRESULT AppManager::GetRegisteredApps(AppIdVector* app_ids) const {
 
 // Vulnerable to a race condition with installers. To prevent this, acquire
 // GetRegistryStableStateLock().
+// The apps which are being installed are not reported, since their Clients key
+// may not have been written yet.
 HRESULT AppManager::GetUninstalledApps(AppIdVector* app_ids) const {
   ASSERT1(app_ids);
   return EnumerateSubKeys(
       ConfigManager::Instance()->registry_client_state(is_machine_),
       [&](const CString& subkey) {
+        GUID app_guid = GUID_NULL;
+        if (SUCCEEDED(StringToGuidSafe(subkey, &app_guid)) &&
+            this->IsAppInstalling(app_guid)) {
+          return;
+        }
         if (this->IsAppUninstalled(subkey)) {
           app_ids->push_back(subkey);
         }
@@ -383,46 +543,38 @@ HRESULT AppManager::CreateClientStateKey(const GUID& app_guid,
 }
 
 HRESULT AppManager::ReadAppDefinedAttributes(
-    const CString& app_id, std::vector<StringPair>* attributes) const {
-  ASSERT1(!app_id.IsEmpty());
+    const AppRegistrySnapshot& snapshot,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
   ASSERT1(attributes->empty());
 
-  CString base_key_name(
-    is_machine_ ?
-    ConfigManager::Instance()->machine_registry_client_state_medium() :
-    ConfigManager::Instance()->registry_client_state(is_machine_));
-
-  RegKey app_id_key;
-  CString app_id_key_name = AppendRegKeyPath(base_key_name, app_id);
-  HRESULT hr = app_id_key.Open(app_id_key_name, KEY_READ);
-  if (FAILED(hr)) {
-    if (hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND)) {
-      hr = S_FALSE;
-    }
-    return hr;
+  const RegistryKeySnapshot& app_id_key = is_machine_ ?
+      snapshot.client_state_medium_key() :
+      snapshot.client_state_key();
+  if (!app_id_key.exists()) {
+    return S_FALSE;
   }
 
-  hr = ReadAppDefinedAttributeValues(&app_id_key, attributes);
+  HRESULT hr = ReadAppDefinedAttributeValues(app_id_key, attributes);
   if (FAILED(hr)) {
     return hr;
   }
 
-  return ReadAppDefinedAttributeSubkeys(&app_id_key, attributes);
+  return ReadAppDefinedAttributeSubkeys(app_id_key, attributes);
 }
 
 HRESULT AppManager::ReadAppDefinedAttributeValues(
-    RegKey* app_id_key, std::vector<StringPair>* attributes) const {
-  ASSERT1(app_id_key);
+    const RegistryKeySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
 
-  const int num_attributes = app_id_key->GetValueCount();
+  const int num_attributes = app_id_key.GetValueCount();
 
   for (int i = 0; i < num_attributes; ++i) {
     CString attribute_name;
     DWORD type(REG_SZ);
 
-    HRESULT hr = app_id_key->GetValueNameAt(i, &attribute_name, &type);
+    HRESULT hr = app_id_key.GetValueNameAt(i, &attribute_name, &type);
     attribute_name.MakeLower();
     if (FAILED(hr)) {
       OPT_LOG(LE, (_T("[ReadAppDefinedAttributeValues][Failed read Attribute]")
@@ -441,7 +593,7 @@ HRESULT AppManager::ReadAppDefinedAttributeValues(
     }
 
     CString attribute_value;
-    hr = app_id_key->GetValue(attribute_name, &attribute_value);
+    hr = app_id_key.GetValue(attribute_name, &attribute_value);
     if (FAILED(hr)) {
       continue;
     }
@@ -453,19 +605,16 @@ HRESULT AppManager::ReadAppDefinedAttributeValues(
 }
 
 HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
-    RegKey* app_id_key, std::vector<StringPair>* attributes) const {
-  ASSERT1(app_id_key);
+    const RegistryKeySnapshot& app_id_key,
+    std::vector<StringPair>* attributes) const {
   ASSERT1(attributes);
 
-  const int num_subkeys = app_id_key->GetSubkeyCount();
+  const int num_subkeys = app_id_key.GetSubkeyCount();
 
   for (int i = 0; i < num_subkeys; ++i) {
-    CString attribute_subkey_name;
-    HRESULT hr = app_id_key->GetSubkeyNameAt(i, &attribute_subkey_name);
+    const RegistryKeySnapshot& attribute_subkey = *app_id_key.GetSubkeyAt(i);
+    CString attribute_subkey_name(attribute_subkey.name());
     attribute_subkey_name.MakeLower();
-    if (FAILED(hr)) {
-      continue;
-    }
 
     if (!String_StartsWith(attribute_subkey_name,
                            kRegValueAppDefinedPrefix,
@@ -473,17 +622,9 @@ HRESULT AppManager::ReadAppDefinedAttributeSubkeys(
       continue;
     }
 
-
-    RegKey attribute_subkey;
-    hr = attribute_subkey.Open(app_id_key->Key(),
-                               attribute_subkey_name,
-                               KEY_READ);
-    if (FAILED(hr)) {
-      continue;
-    }
-
     CString value;
-    hr = attribute_subkey.GetValue(kRegValueAppDefinedAggregate, &value);
+    HRESULT hr = attribute_subkey.GetValue(kRegValueAppDefinedAggregate,
+                                           &value);
     if (FAILED(hr)) {
       continue;
     }
@@ -572,6 +713,11 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
 
   ASSERT1(app->model()->IsLockedByCaller());
 
+  if (IsAppInstalling(app_guid)) {
+    CORE_LOG(LW, (_T("[app is installing][%s]"), app_guid_string));
+    return GOOPDATE_E_APP_BEING_INSTALLED;
+  }
+
   __mutexScope(registry_access_lock_);
 
   const bool is_eula_accepted =
@@ -580,14 +726,16 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
                                             false);
   app->is_eula_accepted_ = is_eula_accepted ? TRISTATE_TRUE : TRISTATE_FALSE;
 
-  bool client_key_exists = false;
-  RegKey client_key;
-  HRESULT hr = OpenClientKey(app_guid, &client_key);
-  if (SUCCEEDED(hr)) {
-    client_key_exists = true;
+  // All the values below are read from the snapshot. It must be taken after
+  // IsAppEulaAccepted(), which may write to the ClientState key.
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(
+      GetRegistrySnapshot(app_guid_string));
 
+  const RegistryKeySnapshot& client_key = snapshot->client_key();
+  const bool client_key_exists = client_key.exists();
+  if (client_key_exists) {
     CString version;
-    hr = client_key.GetValue(kRegValueProductVersion, &version);
+    HRESULT hr = client_key.GetValue(kRegValueProductVersion, &version);
     CORE_LOG(L3, (_T("[AppManager::ReadAppPersistentData]")
                   _T("[%s][version=%s]"), app_guid_string, version));
     if (FAILED(hr)) {
@@ -626,21 +774,16 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
   // The following do not rely on client_state_key, so check them before
   // possibly returning if OpenClientStateKey fails.
 
-  // Reads the did run value.
-  ApplicationUsageData app_usage(is_machine_, vista_util::IsVistaOrLater());
-  app_usage.ReadDidRun(app_guid_string);
-
-  // Sets did_run regardless of the return value of ReadDidRun above. If read
-  // fails, active_state() should return ACTIVE_UNKNOWN which is intented.
-  app->did_run_ = app_usage.active_state();
+  // Reads the did run value. If the read fails, the state is ACTIVE_UNKNOWN,
+  // which is intended.
+  app->did_run_ = usage_data_collector_->GetActiveState(app_guid_string);
 
   // TODO(omaha3): Consider moving GetInstallTimeDiffSec() up here. Be careful
   // that the results when ClientState does not exist are desirable. See the
   // comments near that function and above set_days_since_last_active_ping call.
 
-  RegKey client_state_key;
-  hr = OpenClientStateKey(app_guid, KEY_READ, &client_state_key);
-  if (FAILED(hr)) {
+  const RegistryKeySnapshot& client_state_key = snapshot->client_state_key();
+  if (!client_state_key.exists()) {
     // It is possible that the client state key has not yet been populated.
     // In this case just return the information that we have gathered thus far.
     // However if both keys do not exist, then we are doing something wrong.
@@ -648,7 +791,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     if (client_key_exists) {
       return S_OK;
     } else {
-      return hr;
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
     }
   }
 
@@ -657,13 +800,13 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     client_state_key.GetValue(kRegValueLanguage, &app->language_);
   }
 
-  VERIFY_SUCCEEDED(ReadAppDefinedAttributes(GuidToString(app_guid),
+  VERIFY_SUCCEEDED(ReadAppDefinedAttributes(*snapshot,
                                              &app->app_defined_attributes_));
 
   client_state_key.GetValue(kRegValueAdditionalParams, &app->ap_);
   client_state_key.GetValue(kRegValueTTToken, &app->tt_token_);
 
-  ReadCohort(app_guid, &app->cohort_);
+  ReadCohort(*snapshot, &app->cohort_);
 
   CString iid;
   client_state_key.GetValue(kRegValueInstallationId, &iid);
@@ -694,13 +837,12 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->set_days_since_last_roll_call(days_since_last_roll_call);
   }
 
-  app->install_time_diff_sec_ = GetInstallTimeDiffSec(app_guid);
+  app->install_time_diff_sec_ = InstallTimeDiffSecFromSnapshot(*snapshot);
   // Generally GetInstallTimeDiffSec() shouldn't return kInitialInstallTimeDiff
   // here. The only exception is in the unexpected case when ClientState exists
   // without a pv.
   ASSERT1((app->install_time_diff_sec_ != kInitialInstallTimeDiff) ||
-          !RegKey::HasValue(GetClientStateKeyName(app_guid),
-                            kRegValueProductVersion));
+          !client_state_key.HasValue(kRegValueProductVersion));
 
   // For apps installed before day_of_install is implemented, skip sending
   // day_of_last* one more time (hence resets the values to 0). Once client
@@ -725,7 +867,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->set_day_of_last_roll_call(day_of_last_roll_call);
   }
 
-  app->day_of_install_ = GetDayOfInstall(app_guid);
+  app->day_of_install_ = DayOfInstallFromSnapshot(*snapshot);
 
   CString ping_freshness;
   if (SUCCEEDED(client_state_key.GetValue(kRegValuePingFreshness,
@@ -733,7 +875,7 @@ HRESULT AppManager::ReadAppPersistentData(App* app) {
     app->ping_freshness_ = ping_freshness;
   }
 
-  app->usage_stats_enable_ = GetAppUsageStatsEnabled(app_guid);
+  app->usage_stats_enable_ = UsageStatsEnabledFromSnapshot(*snapshot);
 
   return S_OK;
 }
@@ -781,9 +923,11 @@ HRESULT AppManager::ReadUninstalledAppPersistentData(App* app) {
 
   ASSERT1(app->current_version()->version().IsEmpty());
 
-  RegKey client_state_key;
-  hr = OpenClientStateKey(app->app_guid(), KEY_READ, &client_state_key);
-  ASSERT(SUCCEEDED(hr), (_T("Uninstalled apps have a ClientState key.")));
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(
+      GetRegistrySnapshot(app->app_guid_string()));
+  const RegistryKeySnapshot& client_state_key = snapshot->client_state_key();
+  ASSERT(client_state_key.exists(),
+         (_T("Uninstalled apps have a ClientState key.")));
 
   CString version;
   hr = client_state_key.GetValue(kRegValueProductVersion, &version);
@@ -823,6 +967,7 @@ HRESULT AppManager::WritePreInstallData(const App& app) {
 
   ASSERT1(IsRegistryStableStateLockedByCaller());
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   RegKey client_state_key;
   HRESULT hr = CreateClientStateKey(app.app_guid(), &client_state_key);
@@ -961,8 +1106,9 @@ void AppManager::ClearInstallerResultApiValues(const GUID& app_guid) {
   const CString update_key_name =
       ConfigManager::Instance()->registry_update(is_machine_);
 
-  ASSERT1(IsRegistryStableStateLockedByCaller());
+  ASSERT1(IsRegistryStableStateLockedByCaller() || IsAppInstalling(app_guid));
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(GuidToString(app_guid));
 
   // Delete the old LastXXX values.  These may not exist, so don't care if they
   // fail.
@@ -1045,8 +1191,14 @@ HRESULT AppManager::ReadInstallerRegistrationValues(App* app) {
 
   __mutexScope(registry_access_lock_);
 
-  RegKey client_key;
-  if (FAILED(OpenClientKey(app->app_guid(), &client_key))) {
+  // The installer has just written the Clients key. The registry monitor may
+  // not have reported the change yet, so the snapshot is always taken again.
+  InvalidateRegistrySnapshot(app_guid_string);
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(
+      GetRegistrySnapshot(app_guid_string));
+
+  const RegistryKeySnapshot& client_key = snapshot->client_key();
+  if (!client_key.exists()) {
     OPT_LOG(LE, (_T("[Installer did not create key][%s]"), app_guid_string));
     return GOOPDATEINSTALL_E_INSTALLER_DID_NOT_WRITE_CLIENTS_KEY;
   }
@@ -1079,6 +1231,7 @@ void AppManager::PersistSuccessfulUpdateCheckResponse(
   CORE_LOG(L2, (_T("[AppManager::PersistSuccessfulUpdateCheckResponse]")
                 _T("[%s][%d]"), app.app_guid_string(), is_update_available));
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   VERIFY_SUCCEEDED(SetTTToken(app));
 
@@ -1135,6 +1288,7 @@ void AppManager::PersistSuccessfulInstall(const App& app) {
 
   ASSERT1(IsRegistryStableStateLockedByCaller());
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   ASSERT1(!::IsEqualGUID(kGoopdateGuid, app.app_guid()));
 
@@ -1233,6 +1387,7 @@ HRESULT AppManager::WriteInstallProgress(const App& app,
 
 HRESULT AppManager::SynchronizeClientState(const GUID& app_guid) {
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(GuidToString(app_guid));
 
   RegKey client_key;
   HRESULT hr = OpenClientKey(app_guid, &client_key);
@@ -1279,6 +1434,7 @@ HRESULT AppManager::SetTTToken(const App& app) const {
   CORE_LOG(L3, (_T("[AppManager::SetTTToken][token=%s]"), app.tt_token()));
 
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   RegKey client_state_key;
   HRESULT hr = CreateClientStateKey(app.app_guid(), &client_state_key);
@@ -1298,20 +1454,35 @@ HRESULT AppManager::DeleteCohortKey(const GUID& app_guid) const {
                                              GuidToString(app_guid));
 }
 
-HRESULT AppManager::ReadCohort(const GUID& app_guid, Cohort * cohort) const {
-  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s]"), GuidToString(app_guid)));
-
+HRESULT AppManager::ReadCohort(const AppRegistrySnapshot& snapshot,
+                               Cohort* cohort) const {
   ASSERT1(cohort);
 
-  return app_registry_utils::ReadCohort(is_machine_,
-                                        GuidToString(app_guid),
-                                        cohort);
+  const RegistryKeySnapshot* cohort_key =
+      snapshot.client_state_key().GetSubkey(kRegSubkeyCohort);
+  if (!cohort_key) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  HRESULT hr = cohort_key->GetValue(NULL, &cohort->cohort);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // Optional values.
+  cohort_key->GetValue(kRegValueCohortHint, &cohort->hint);
+  cohort_key->GetValue(kRegValueCohortName, &cohort->name);
+
+  CORE_LOG(L3, (_T("[AppManager::ReadCohort][%s][%s][%s]"),
+                cohort->cohort, cohort->hint, cohort->name));
+  return S_OK;
 }
 
 HRESULT AppManager::WriteCohort(const App& app) const {
   CORE_LOG(L3, (_T("[AppManager::WriteCohort][%s]"), app.cohort().cohort));
 
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   return app_registry_utils::WriteCohort(is_machine_,
                                          app.app_guid_string(),
@@ -1337,6 +1508,8 @@ void AppManager::ClearOemInstalled(const AppIdVector& app_ids) {
       continue;
     }
 
+    InvalidateRegistrySnapshot(*it);
+
     VERIFY_SUCCEEDED(state_key.DeleteValue(kRegValueOemInstall));
 
     // The current time is close to when OEM activation has happened. Treat the
@@ -1350,6 +1523,7 @@ void AppManager::ClearOemInstalled(const AppIdVector& app_ids) {
 
 void AppManager::UpdateUpdateAvailableStats(const GUID& app_guid) const {
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(GuidToString(app_guid));
 
   RegKey state_key;
   HRESULT hr = CreateClientStateKey(app_guid, &state_key);
@@ -1472,6 +1646,7 @@ Tristate AppManager::GetAppUsageStatsEnabled(const GUID& app_guid) const {
 HRESULT AppManager::ClearInstallationId(const App& app) const {
   ASSERT1(app.model()->IsLockedByCaller());
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   if (::IsEqualGUID(app.iid(), GUID_NULL)) {
     return S_OK;
@@ -1505,6 +1680,7 @@ void AppManager::SetLastPingTimeMetrics(
   ASSERT1(app.model()->IsLockedByCaller());
 
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   int now = Time64ToInt32(GetCurrent100NSTime());
 
@@ -1563,6 +1739,7 @@ void AppManager::UpdateDayOfInstallIfNecessary(
   ASSERT1(app.model()->IsLockedByCaller());
 
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(app.app_guid_string());
 
   RegKey client_state_key;
   if (FAILED(CreateClientStateKey(app.app_guid(), &client_state_key))) {
@@ -1592,9 +1769,8 @@ HRESULT AppManager::PersistUpdateCheckSuccessfullySent(
     int elapsed_seconds_since_day_start) {
   ASSERT1(app.model()->IsLockedByCaller());
 
-  ApplicationUsageData app_usage(app.app_bundle()->is_machine(),
-                                 vista_util::IsVistaOrLater());
-  VERIFY_SUCCEEDED(app_usage.ResetDidRun(app.app_guid_string()));
+  ASSERT1(app.app_bundle()->is_machine() == is_machine_);
+  VERIFY_SUCCEEDED(usage_data_collector_->ResetDidRun(app.app_guid_string()));
 
   SetLastPingTimeMetrics(
       app, elapsed_days_since_datum, elapsed_seconds_since_day_start);
@@ -1611,6 +1787,7 @@ HRESULT AppManager::RemoveClientState(const GUID& app_guid) {
                 GuidToString(app_guid)));
   ASSERT1(IsRegistryStableStateLockedByCaller());
   __mutexScope(registry_access_lock_);
+  InvalidateRegistrySnapshot(GuidToString(app_guid));
 
   ASSERT1(!IsAppRegistered(app_guid));
 
@@ -18,6 +18,7 @@
 
 #include <windows.h>
 #include <atlstr.h>
+#include <memory>
 #include <vector>
 #include "base/basictypes.h"
 #include "omaha/base/synchronized.h"
@@ -27,8 +28,12 @@
 namespace omaha {
 
 class App;
+class AppRegistrySnapshot;
+class AppRegistrySnapshotCache;
 struct Cohort;
 class RegKey;
+class RegistryKeySnapshot;
+class UsageDataCollector;
 
 typedef std::vector<CString> AppIdVector;
 
@@ -45,6 +50,10 @@ typedef std::vector<CString> AppIdVector;
 //   WriteAppPersistentData().
 // If your operation absolutely needs consistent/stable state, use the functions
 // that ensure this.
+// The persistent data of the apps is read from snapshots of their registry
+// keys. Once EnableRegistrySnapshots() has been called, the snapshots are
+// retained until the registry monitor reports a change to the keys, so reads
+// may also return state that is out of date by the notification latency.
 // All write functions assume that the lock returned by
 // GetRegistryStableStateLock() is held. Reads do not require this lock to be
 // held.
@@ -66,6 +75,12 @@ class AppManager {
 
   static AppManager* Instance();
 
+  // Retains the registry snapshots of the apps between reads and starts
+  // monitoring the registry to discard the snapshots when the keys change.
+  // Also lets the apps read in a short time share one sweep of the did run
+  // values of the users.
+  HRESULT EnableRegistrySnapshots();
+
   // Reads the "pv" value from Google\Update\Clients\{app_guid}, and is used by
   // the Update3WebControl. This method does not take any locks, and is not
   // recommended for use in any other scenario.
@@ -196,6 +211,20 @@ class AppManager {
   // seconds or more.
   Lockable& GetRegistryStableStateLock() { return registry_stable_state_lock_; }
 
+  // Installers which can run concurrently run without the stable state lock.
+  // Their apps are marked as installing for the duration of the installer, so
+  // that GetRegisteredApps() and GetUninstalledApps() do not report them,
+  // ReadAppPersistentData() fails for them, and the installer result values
+  // of the apps can be cleared without the lock. Call these functions while
+  // holding GetRegistryStableStateLock().
+  void AddInstallingApp(const GUID& app_guid);
+  void RemoveInstallingApp(const GUID& app_guid);
+  bool IsAppInstalling(const GUID& app_guid) const;
+
+  // Blocks until the app is no longer installing. The stable state lock, which
+  // the caller holds, is released while waiting.
+  void WaitForAppInstall(const GUID& app_guid);
+
   // Gets the time since InstallTime was written. Returns 0 if InstallTime
   // could not be read. This could occur if the app is not already installed or
   // there is no valid install time in the registry, which can occur for apps
@@ -226,7 +255,7 @@ class AppManager {
 
  private:
   explicit AppManager(bool is_machine);
-  ~AppManager() {}
+  ~AppManager();
 
   bool InitializeRegistryLock();
 
@@ -244,23 +273,35 @@ class AppManager {
   HRESULT CreateClientStateKey(const GUID& app_guid,
                                RegKey* client_state_key) const;
 
+  // Returns the registry snapshot of the app.
+  std::shared_ptr<const AppRegistrySnapshot> GetRegistrySnapshot(
+      const CString& app_id) const;
+
+  // Discards the registry snapshot of the app. Called by the functions that
+  // modify the registry keys of the app.
+  void InvalidateRegistrySnapshot(const CString& app_id) const;
+
   // Reads name/value pairs that have a '_' prefix under the
   // ClientState/ClientStateMedium key.
   HRESULT ReadAppDefinedAttributes(
-      const CString& app_id, std::vector<StringPair>* attributes) const;
+      const AppRegistrySnapshot& snapshot,
+      std::vector<StringPair>* attributes) const;
   HRESULT ReadAppDefinedAttributeValues(
-      RegKey* app_id_key, std::vector<StringPair>* attributes) const;
+      const RegistryKeySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
   // Aggregates are '_' prefixed subkeys that store values that need to be
   // aggregated. The only aggregate supported at the moment is "sum".
   HRESULT ReadAppDefinedAttributeSubkeys(
-      RegKey* app_id_key, std::vector<StringPair>* attributes) const;
+      const RegistryKeySnapshot& app_id_key,
+      std::vector<StringPair>* attributes) const;
 
   // Write the TT Token with what the server returned.
   HRESULT SetTTToken(const App& app) const;
 
   CString GetCohortKeyName(const GUID& app_guid) const;
   HRESULT DeleteCohortKey(const GUID& app_guid) const;
-  HRESULT ReadCohort(const GUID& app_guid, Cohort* cohort) const;
+  HRESULT ReadCohort(const AppRegistrySnapshot& snapshot,
+                     Cohort* cohort) const;
   HRESULT WriteCohort(const App& app) const;
 
   // Stores information about the update available event for the app.
@@ -304,6 +345,16 @@ class AppManager {
   // Omaha that it is uninstalling the app.
   LLock registry_stable_state_lock_;
 
+  // The apps whose installers run without registry_stable_state_lock_.
+  AppIdVector installing_app_ids_;
+  LLock installing_apps_lock_;
+
+  // Open when no app is installing.
+  Gate no_installing_apps_gate_;
+
+  std::unique_ptr<AppRegistrySnapshotCache> snapshot_cache_;
+  std::unique_ptr<UsageDataCollector> usage_data_collector_;
+
   static AppManager* instance_;
 
   friend class RunRegistrationUpdateHooksFunc;
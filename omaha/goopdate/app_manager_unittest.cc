@@ -1388,6 +1388,30 @@ class HoldAppManagerLock : public Runnable {
   DISALLOW_IMPLICIT_CONSTRUCTORS(HoldAppManagerLock);
 };
 
+// Waits for the install of an app while holding the stable state lock.
+class WaitForAppInstallRunnable : public Runnable {
+ public:
+  WaitForAppInstallRunnable(AppManager* app_manager, const GUID& app_guid)
+      : app_manager_(app_manager),
+        app_guid_(app_guid),
+        is_app_installing_(true) {}
+
+  virtual void Run() {
+    __mutexScope(app_manager_->GetRegistryStableStateLock());
+    app_manager_->WaitForAppInstall(app_guid_);
+    is_app_installing_ = app_manager_->IsAppInstalling(app_guid_);
+  }
+
+  bool is_app_installing() const { return is_app_installing_; }
+
+ private:
+  AppManager* const app_manager_;
+  const GUID app_guid_;
+  bool is_app_installing_;
+
+  DISALLOW_COPY_AND_ASSIGN(WaitForAppInstallRunnable);
+};
+
 // Provide access to the member functions for other tests without requiring them
 // to know about the test fixture class.
 
@@ -2952,6 +2976,38 @@ TEST_F(AppManagerWithBundleUserTest, GetRegisteredApps) {
   EXPECT_STREQ(kGuid4, registered_app_ids[2]);
 }
 
+// The installer of an app which is installing may be writing the Clients key.
+TEST_F(AppManagerWithBundleUserTest, GetRegisteredApps_AppInstalling) {
+  App *expected_app0, *expected_app1, *expected_app2;
+  PopulateDataAndRegistryForRegisteredAndUnInstalledAppsTests(
+      false,
+      &expected_app0,
+      &expected_app1,
+      &expected_app2);
+
+  __mutexScope(app_manager_->GetRegistryStableStateLock());
+
+  const GUID app_guid = StringToGuid(kGuid1);
+  app_manager_->AddInstallingApp(app_guid);
+
+  AppIdVector registered_app_ids;
+  EXPECT_SUCCEEDED(app_manager_->GetRegisteredApps(&registered_app_ids));
+  ASSERT_EQ(2, static_cast<int>(registered_app_ids.size()));
+  EXPECT_STREQ(CString(kGuid2).MakeUpper(), registered_app_ids[0]);
+  EXPECT_STREQ(kGuid4, registered_app_ids[1]);
+
+  __mutexBlock(expected_app0->model()->lock()) {
+    EXPECT_EQ(GOOPDATE_E_APP_BEING_INSTALLED,
+              app_manager_->ReadAppPersistentData(expected_app0));
+  }
+
+  app_manager_->RemoveInstallingApp(app_guid);
+
+  registered_app_ids.clear();
+  EXPECT_SUCCEEDED(app_manager_->GetRegisteredApps(&registered_app_ids));
+  EXPECT_EQ(3, static_cast<int>(registered_app_ids.size()));
+}
+
 TEST_F(AppManagerWithBundleUserTest, GetRegisteredApps_InvalidPvValueType) {
   App *expected_app0, *expected_app1, *expected_app2;
   PopulateDataAndRegistryForRegisteredAndUnInstalledAppsTests(
@@ -3020,6 +3076,62 @@ TEST_F(AppManagerWithBundleUserTest, GetUninstalledApps) {
   EXPECT_STREQ(CString(kGuid3).MakeUpper(), registered_app_ids[0]);
 }
 
+// The installer of an app which is installing may not have written the Clients
+// key yet.
+TEST_F(AppManagerWithBundleUserTest, GetUninstalledApps_AppInstalling) {
+  App *expected_app0, *expected_app1, *expected_app2;
+  PopulateDataAndRegistryForRegisteredAndUnInstalledAppsTests(
+      false,
+      &expected_app0,
+      &expected_app1,
+      &expected_app2);
+
+  __mutexScope(app_manager_->GetRegistryStableStateLock());
+
+  const GUID app_guid = StringToGuid(kGuid3);
+  EXPECT_FALSE(app_manager_->IsAppInstalling(app_guid));
+  app_manager_->AddInstallingApp(app_guid);
+  EXPECT_TRUE(app_manager_->IsAppInstalling(app_guid));
+
+  AppIdVector uninstalled_app_ids;
+  EXPECT_SUCCEEDED(app_manager_->GetUninstalledApps(&uninstalled_app_ids));
+  EXPECT_TRUE(uninstalled_app_ids.empty());
+
+  app_manager_->RemoveInstallingApp(app_guid);
+  EXPECT_FALSE(app_manager_->IsAppInstalling(app_guid));
+
+  EXPECT_SUCCEEDED(app_manager_->GetUninstalledApps(&uninstalled_app_ids));
+  ASSERT_EQ(1, static_cast<int>(uninstalled_app_ids.size()));
+  EXPECT_STREQ(CString(kGuid3).MakeUpper(), uninstalled_app_ids[0]);
+}
+
+TEST_F(AppManagerUserTest, WaitForAppInstall) {
+  const GUID app_guid = StringToGuid(kGuid1);
+  const GUID other_app_guid = StringToGuid(kGuid2);
+  __mutexBlock(app_manager_->GetRegistryStableStateLock()) {
+    app_manager_->AddInstallingApp(app_guid);
+    app_manager_->AddInstallingApp(other_app_guid);
+  }
+
+  WaitForAppInstallRunnable wait_for_app_install(app_manager_, app_guid);
+  Thread thread;
+  ASSERT_TRUE(thread.Start(&wait_for_app_install));
+
+  // The thread can't return before the install of the app completes. The
+  // install of the other app may complete first.
+  EXPECT_FALSE(thread.WaitTillExit(0));
+  __mutexBlock(app_manager_->GetRegistryStableStateLock()) {
+    app_manager_->RemoveInstallingApp(other_app_guid);
+  }
+  EXPECT_FALSE(thread.WaitTillExit(0));
+
+  __mutexBlock(app_manager_->GetRegistryStableStateLock()) {
+    app_manager_->RemoveInstallingApp(app_guid);
+  }
+  EXPECT_TRUE(thread.WaitTillExit(60000));
+  EXPECT_FALSE(wait_for_app_install.is_app_installing());
+}
+
 TEST_F(AppManagerWithBundleMachineTest, GetOemInstalledAndEulaAcceptedApps) {
   // Create an OEM installed app.
   App* expected_app1 = CreateAppForRegistryPopulation(kGuid1);
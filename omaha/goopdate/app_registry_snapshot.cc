@@ -0,0 +1,403 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/app_registry_snapshot.h"
+
+#include <utility>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/registry_monitor_manager.h"
+#include "omaha/common/app_registry_utils.h"
+
+namespace omaha {
+
+namespace {
+
+CString ToLowerName(const TCHAR* name) {
+  CString lower_name(name ? name : _T(""));
+  lower_name.MakeLower();
+  return lower_name;
+}
+
+// Copies the values of |reg_key| into |key|.
+void ReadValues(RegKey* reg_key, RegistryKeySnapshot* key) {
+  ASSERT1(reg_key);
+  ASSERT1(key);
+
+  const int num_values = reg_key->GetValueCount();
+  for (int i = 0; i < num_values; ++i) {
+    CString value_name;
+    DWORD type = REG_NONE;
+    if (FAILED(reg_key->GetValueNameAt(i, &value_name, &type))) {
+      continue;
+    }
+
+    switch (type) {
+      case REG_SZ:
+      case REG_EXPAND_SZ: {
+        CString value;
+        if (SUCCEEDED(reg_key->GetValue(value_name, &value))) {
+          key->AddStringValue(value_name, value);
+        }
+        break;
+      }
+      case REG_DWORD: {
+        DWORD value = 0;
+        if (SUCCEEDED(reg_key->GetValue(value_name, &value))) {
+          key->AddDwordValue(value_name, value);
+        }
+        break;
+      }
+      default:
+        key->AddOtherValue(value_name, type);
+        break;
+    }
+  }
+}
+
+}  // namespace
+
+RegistryKeySnapshot::RegistryKeySnapshot() : exists_(false) {
+}
+
+RegistryKeySnapshot::~RegistryKeySnapshot() {
+}
+
+bool RegistryKeySnapshot::HasValue(const TCHAR* value_name) const {
+  return value_index_.find(ToLowerName(value_name)) != value_index_.end();
+}
+
+HRESULT RegistryKeySnapshot::GetValue(const TCHAR* value_name,
+                                      CString* value) const {
+  ASSERT1(value);
+
+  std::map<CString, size_t>::const_iterator it =
+      value_index_.find(ToLowerName(value_name));
+  if (it == value_index_.end()) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  const Value& snapshot_value = values_[it->second];
+  if (snapshot_value.type != REG_SZ && snapshot_value.type != REG_EXPAND_SZ) {
+    return HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+  }
+
+  *value = snapshot_value.string_value;
+  return S_OK;
+}
+
+HRESULT RegistryKeySnapshot::GetValue(const TCHAR* value_name,
+                                      DWORD* value) const {
+  ASSERT1(value);
+
+  std::map<CString, size_t>::const_iterator it =
+      value_index_.find(ToLowerName(value_name));
+  if (it == value_index_.end()) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  const Value& snapshot_value = values_[it->second];
+  if (snapshot_value.type != REG_DWORD) {
+    return HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+  }
+
+  *value = snapshot_value.dword_value;
+  return S_OK;
+}
+
+HRESULT RegistryKeySnapshot::GetValueNameAt(int index,
+                                            CString* value_name,
+                                            DWORD* type) const {
+  ASSERT1(value_name);
+  ASSERT1(type);
+
+  if (index < 0 || index >= GetValueCount()) {
+    return HRESULT_FROM_WIN32(ERROR_NO_MORE_ITEMS);
+  }
+
+  *value_name = values_[index].name;
+  *type = values_[index].type;
+  return S_OK;
+}
+
+const RegistryKeySnapshot* RegistryKeySnapshot::GetSubkey(
+    const TCHAR* subkey_name) const {
+  ASSERT1(subkey_name);
+
+  for (size_t i = 0; i != subkeys_.size(); ++i) {
+    if (subkeys_[i]->name_.CompareNoCase(subkey_name) == 0) {
+      return subkeys_[i].get();
+    }
+  }
+  return NULL;
+}
+
+const RegistryKeySnapshot* RegistryKeySnapshot::GetSubkeyAt(int index) const {
+  ASSERT1(index >= 0 && index < GetSubkeyCount());
+  return subkeys_[index].get();
+}
+
+void RegistryKeySnapshot::AddStringValue(const CString& value_name,
+                                         const CString& value) {
+  Value snapshot_value;
+  snapshot_value.name = value_name;
+  snapshot_value.type = REG_SZ;
+  snapshot_value.string_value = value;
+  snapshot_value.dword_value = 0;
+  AddValue(snapshot_value);
+}
+
+void RegistryKeySnapshot::AddDwordValue(const CString& value_name,
+                                        DWORD value) {
+  Value snapshot_value;
+  snapshot_value.name = value_name;
+  snapshot_value.type = REG_DWORD;
+  snapshot_value.dword_value = value;
+  AddValue(snapshot_value);
+}
+
+void RegistryKeySnapshot::AddOtherValue(const CString& value_name,
+                                        DWORD type) {
+  ASSERT1(type != REG_SZ && type != REG_EXPAND_SZ && type != REG_DWORD);
+
+  Value snapshot_value;
+  snapshot_value.name = value_name;
+  snapshot_value.type = type;
+  snapshot_value.dword_value = 0;
+  AddValue(snapshot_value);
+}
+
+void RegistryKeySnapshot::AddValue(const Value& value) {
+  exists_ = true;
+
+  const CString lower_name(ToLowerName(value.name));
+  std::map<CString, size_t>::const_iterator it = value_index_.find(lower_name);
+  if (it != value_index_.end()) {
+    values_[it->second] = value;
+    return;
+  }
+
+  value_index_[lower_name] = values_.size();
+  values_.push_back(value);
+}
+
+RegistryKeySnapshot* RegistryKeySnapshot::AddSubkey(
+    const CString& subkey_name) {
+  ASSERT1(!GetSubkey(subkey_name));
+  exists_ = true;
+
+  std::unique_ptr<RegistryKeySnapshot> subkey(new RegistryKeySnapshot);
+  subkey->exists_ = true;
+  subkey->name_ = subkey_name;
+  subkeys_.push_back(std::move(subkey));
+  return subkeys_.back().get();
+}
+
+HRESULT RegKeyAppRegistryBackend::ReadKey(const CString& key_name,
+                                          RegistryKeySnapshot* key) {
+  ASSERT1(key);
+
+  RegKey reg_key;
+  HRESULT hr = reg_key.Open(key_name, KEY_READ);
+  if (FAILED(hr)) {
+    return hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND) ? S_FALSE : hr;
+  }
+
+  key->set_exists(true);
+  ReadValues(&reg_key, key);
+
+  const int num_subkeys = reg_key.GetSubkeyCount();
+  for (int i = 0; i < num_subkeys; ++i) {
+    CString subkey_name;
+    if (FAILED(reg_key.GetSubkeyNameAt(i, &subkey_name))) {
+      continue;
+    }
+
+    RegKey reg_subkey;
+    if (FAILED(reg_subkey.Open(reg_key.Key(), subkey_name, KEY_READ))) {
+      continue;
+    }
+
+    ReadValues(&reg_subkey, key->AddSubkey(subkey_name));
+  }
+
+  return S_OK;
+}
+
+AppRegistrySnapshotCache::AppRegistrySnapshotCache(
+    bool is_machine,
+    std::unique_ptr<AppRegistryBackendInterface> backend)
+    : is_machine_(is_machine),
+      backend_(std::move(backend)),
+      generation_(0),
+      is_caching_(false),
+      num_snapshots_read_(0) {
+  ASSERT1(backend_.get());
+}
+
+AppRegistrySnapshotCache::~AppRegistrySnapshotCache() {
+  // Stops the monitoring thread before the snapshots are destroyed.
+  registry_monitor_.reset();
+}
+
+HRESULT AppRegistrySnapshotCache::StartMonitoring() {
+  ASSERT1(!registry_monitor_.get());
+
+  std::unique_ptr<RegistryMonitor> registry_monitor(new RegistryMonitor);
+  HRESULT hr = registry_monitor->Initialize();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const HKEY root_key = is_machine_ ? HKEY_LOCAL_MACHINE : HKEY_CURRENT_USER;
+  hr = registry_monitor->MonitorKeyTree(root_key,
+                                        GOOPDATE_REG_RELATIVE_CLIENTS,
+                                        RegistryKeyChangeCallback,
+                                        this);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = registry_monitor->MonitorKeyTree(root_key,
+                                        GOOPDATE_REG_RELATIVE_CLIENT_STATE,
+                                        RegistryKeyChangeCallback,
+                                        this);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (is_machine_) {
+    hr = registry_monitor->MonitorKeyTree(
+        root_key,
+        GOOPDATE_REG_RELATIVE_CLIENT_STATE_MEDIUM,
+        RegistryKeyChangeCallback,
+        this);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  hr = registry_monitor->StartMonitoring();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CORE_LOG(L3, (_T("[AppRegistrySnapshotCache::StartMonitoring]")));
+
+  __mutexScope(lock_);
+  registry_monitor_ = std::move(registry_monitor);
+  is_caching_ = true;
+  return S_OK;
+}
+
+void AppRegistrySnapshotCache::set_is_caching(bool is_caching) {
+  __mutexScope(lock_);
+  is_caching_ = is_caching;
+  if (!is_caching_) {
+    snapshots_.clear();
+    ++generation_;
+  }
+}
+
+std::shared_ptr<const AppRegistrySnapshot>
+    AppRegistrySnapshotCache::GetSnapshot(const CString& app_id) {
+  ASSERT1(!app_id.IsEmpty());
+
+  const CString key(ToLowerName(app_id));
+  uint32 generation = 0;
+  {
+    __mutexScope(lock_);
+    SnapshotMap::const_iterator it = snapshots_.find(key);
+    if (it != snapshots_.end()) {
+      return it->second;
+    }
+    generation = generation_;
+  }
+
+  // The keys are read without holding the lock, so that snapshots of other
+  // apps can be served in the meantime.
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(ReadSnapshot(app_id));
+
+  __mutexScope(lock_);
+  if (is_caching_ && generation == generation_) {
+    snapshots_[key] = snapshot;
+  }
+  return snapshot;
+}
+
+void AppRegistrySnapshotCache::Invalidate(const CString& app_id) {
+  __mutexScope(lock_);
+  snapshots_.erase(ToLowerName(app_id));
+  ++generation_;
+}
+
+void AppRegistrySnapshotCache::InvalidateAll() {
+  __mutexScope(lock_);
+  snapshots_.clear();
+  ++generation_;
+}
+
+std::shared_ptr<const AppRegistrySnapshot>
+    AppRegistrySnapshotCache::ReadSnapshot(const CString& app_id) {
+  ::InterlockedIncrement(&num_snapshots_read_);
+
+  std::shared_ptr<AppRegistrySnapshot> snapshot(new AppRegistrySnapshot);
+
+  HRESULT hr = backend_->ReadKey(
+      app_registry_utils::GetAppClientsKey(is_machine_, app_id),
+      &snapshot->client_key_);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[ReadKey Clients failed][%s][0x%08x]"), app_id, hr));
+  }
+
+  hr = backend_->ReadKey(
+      app_registry_utils::GetAppClientStateKey(is_machine_, app_id),
+      &snapshot->client_state_key_);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[ReadKey ClientState failed][%s][0x%08x]"), app_id, hr));
+  }
+
+  if (is_machine_) {
+    hr = backend_->ReadKey(
+        app_registry_utils::GetAppClientStateMediumKey(is_machine_, app_id),
+        &snapshot->client_state_medium_key_);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[ReadKey ClientStateMedium failed][%s][0x%08x]"),
+                    app_id, hr));
+    }
+  }
+
+  return snapshot;
+}
+
+void AppRegistrySnapshotCache::RegistryKeyChangeCallback(const TCHAR* key_name,
+                                                         void* user_data) {
+  ASSERT1(key_name);
+  ASSERT1(user_data);
+
+  CORE_LOG(L3, (_T("[AppRegistrySnapshotCache::RegistryKeyChangeCallback]")
+                _T("[%s]"), key_name));
+  UNREFERENCED_PARAMETER(key_name);
+
+  AppRegistrySnapshotCache* cache =
+      static_cast<AppRegistrySnapshotCache*>(user_data);
+  cache->InvalidateAll();
+}
+
+}  // namespace omaha
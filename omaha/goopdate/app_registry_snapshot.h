@@ -0,0 +1,209 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// AppRegistrySnapshot is an immutable in-memory copy of the Clients,
+// ClientState, and ClientStateMedium keys of an app. AppManager reads the
+// persistent data of an app from a snapshot instead of opening the keys and
+// reading the values one at a time.
+//
+// AppRegistrySnapshotCache retains the snapshots of the apps once it monitors
+// the registry for changes. Any change under the Clients, ClientState, or
+// ClientStateMedium keys discards all snapshots. Before monitoring starts, each
+// call to GetSnapshot reads the keys of the app again.
+
+#ifndef OMAHA_GOOPDATE_APP_REGISTRY_SNAPSHOT_H_
+#define OMAHA_GOOPDATE_APP_REGISTRY_SNAPSHOT_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+class RegistryMonitor;
+
+// A copy of the values and the immediate subkeys of a registry key. Only
+// string and DWORD values are copied. Value and subkey names are case
+// insensitive, as they are in the registry.
+class RegistryKeySnapshot {
+ public:
+  RegistryKeySnapshot();
+  ~RegistryKeySnapshot();
+
+  // Returns false if the key did not exist when the snapshot was taken.
+  bool exists() const { return exists_; }
+  void set_exists(bool exists) { exists_ = exists; }
+
+  // The functions below have the same semantics as the RegKey functions with
+  // the same names. |value_name| may be NULL for the default value.
+  bool HasValue(const TCHAR* value_name) const;
+  HRESULT GetValue(const TCHAR* value_name, CString* value) const;
+  HRESULT GetValue(const TCHAR* value_name, DWORD* value) const;
+
+  // Enumerates the values in the order they were added.
+  int GetValueCount() const { return static_cast<int>(values_.size()); }
+  HRESULT GetValueNameAt(int index, CString* value_name, DWORD* type) const;
+
+  // Returns NULL if the subkey does not exist.
+  const RegistryKeySnapshot* GetSubkey(const TCHAR* subkey_name) const;
+
+  // Enumerates the subkeys in the order they were added.
+  int GetSubkeyCount() const { return static_cast<int>(subkeys_.size()); }
+  const RegistryKeySnapshot* GetSubkeyAt(int index) const;
+  const CString& name() const { return name_; }
+
+  // Used by the backends to populate the snapshot. Values of other types
+  // than REG_SZ, REG_EXPAND_SZ, and REG_DWORD are enumerated but can't be
+  // read.
+  void AddStringValue(const CString& value_name, const CString& value);
+  void AddDwordValue(const CString& value_name, DWORD value);
+  void AddOtherValue(const CString& value_name, DWORD type);
+  RegistryKeySnapshot* AddSubkey(const CString& subkey_name);
+
+ private:
+  struct Value {
+    CString name;
+    DWORD type;
+    CString string_value;
+    DWORD dword_value;
+  };
+
+  void AddValue(const Value& value);
+
+  bool exists_;
+  CString name_;
+
+  std::vector<Value> values_;
+
+  // Maps the lowercase names of the values to their index in values_.
+  std::map<CString, size_t> value_index_;
+
+  std::vector<std::unique_ptr<RegistryKeySnapshot>> subkeys_;
+
+  DISALLOW_COPY_AND_ASSIGN(RegistryKeySnapshot);
+};
+
+// The registry keys of an app, as they were when the snapshot was taken.
+class AppRegistrySnapshot {
+ public:
+  AppRegistrySnapshot() {}
+
+  const RegistryKeySnapshot& client_key() const { return client_key_; }
+  const RegistryKeySnapshot& client_state_key() const {
+    return client_state_key_;
+  }
+
+  // Never exists for user apps.
+  const RegistryKeySnapshot& client_state_medium_key() const {
+    return client_state_medium_key_;
+  }
+
+ private:
+  RegistryKeySnapshot client_key_;
+  RegistryKeySnapshot client_state_key_;
+  RegistryKeySnapshot client_state_medium_key_;
+
+  friend class AppRegistrySnapshotCache;
+
+  DISALLOW_COPY_AND_ASSIGN(AppRegistrySnapshot);
+};
+
+// Reads registry keys into snapshots. Abstracted so that the snapshots can be
+// built from a fake registry in unit tests.
+class AppRegistryBackendInterface {
+ public:
+  virtual ~AppRegistryBackendInterface() {}
+
+  // Copies the values and the immediate subkeys of |key_name| into |key|.
+  // Returns S_FALSE if the key does not exist.
+  virtual HRESULT ReadKey(const CString& key_name,
+                          RegistryKeySnapshot* key) = 0;
+};
+
+// Reads the keys from the registry.
+class RegKeyAppRegistryBackend : public AppRegistryBackendInterface {
+ public:
+  RegKeyAppRegistryBackend() {}
+  virtual HRESULT ReadKey(const CString& key_name, RegistryKeySnapshot* key);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RegKeyAppRegistryBackend);
+};
+
+class AppRegistrySnapshotCache {
+ public:
+  AppRegistrySnapshotCache(
+      bool is_machine,
+      std::unique_ptr<AppRegistryBackendInterface> backend);
+  ~AppRegistrySnapshotCache();
+
+  // Starts monitoring the registry. The snapshots are retained from then on.
+  HRESULT StartMonitoring();
+
+  // Returns the snapshot of the app, reading the registry keys of the app if
+  // there is no snapshot for the app. The snapshot is never NULL.
+  std::shared_ptr<const AppRegistrySnapshot> GetSnapshot(const CString& app_id);
+
+  // Discards the snapshot of an app. Call after modifying the keys of the
+  // app, since the registry monitor notifies the changes asynchronously.
+  void Invalidate(const CString& app_id);
+
+  // Discards all the snapshots.
+  void InvalidateAll();
+
+  // Retains the snapshots without monitoring the registry. Snapshots are only
+  // discarded by calls to Invalidate and InvalidateAll. For testing.
+  void set_is_caching(bool is_caching);
+
+  // Returns how many times the keys of an app have been read.
+  int num_snapshots_read() const { return num_snapshots_read_; }
+
+ private:
+  std::shared_ptr<const AppRegistrySnapshot> ReadSnapshot(
+      const CString& app_id);
+
+  static void RegistryKeyChangeCallback(const TCHAR* key_name,
+                                        void* user_data);
+
+  const bool is_machine_;
+  std::unique_ptr<AppRegistryBackendInterface> backend_;
+
+  LLock lock_;
+
+  // Snapshots keyed by the lowercase app id.
+  typedef std::map<CString, std::shared_ptr<const AppRegistrySnapshot>>
+      SnapshotMap;
+  SnapshotMap snapshots_;
+
+  // Incremented each time snapshots are discarded. A snapshot read while
+  // snapshots are discarded is not retained, since it may be out of date.
+  uint32 generation_;
+
+  bool is_caching_;
+  volatile LONG num_snapshots_read_;
+
+  std::unique_ptr<RegistryMonitor> registry_monitor_;
+
+  DISALLOW_COPY_AND_ASSIGN(AppRegistrySnapshotCache);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_APP_REGISTRY_SNAPSHOT_H_
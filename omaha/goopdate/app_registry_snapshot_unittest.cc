@@ -0,0 +1,410 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/app_registry_snapshot.h"
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/error.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/app_registry_utils.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kAppId = _T("{B7BAF788-9D64-49c3-AFDC-B336AB12F332}");
+
+// An in-memory registry. Each ReadKey call counts as one round-trip.
+class FakeAppRegistryBackend : public AppRegistryBackendInterface {
+ public:
+  FakeAppRegistryBackend() : num_reads_(0) {}
+
+  void SetValue(const CString& key_name,
+                const CString& value_name,
+                const CString& value) {
+    FakeValue fake_value = { value_name, REG_SZ, value, 0 };
+    keys_[Lower(key_name)].push_back(fake_value);
+  }
+
+  void SetValue(const CString& key_name,
+                const CString& value_name,
+                DWORD value) {
+    FakeValue fake_value = { value_name, REG_DWORD, CString(), value };
+    keys_[Lower(key_name)].push_back(fake_value);
+  }
+
+  virtual HRESULT ReadKey(const CString& key_name, RegistryKeySnapshot* key) {
+    ++num_reads_;
+
+    const CString lower_key_name(Lower(key_name));
+    KeyMap::const_iterator it = keys_.find(lower_key_name);
+    if (it == keys_.end()) {
+      return S_FALSE;
+    }
+
+    key->set_exists(true);
+    AddValues(it->second, key);
+
+    // The subkeys are adjacent in the map, starting with the prefix.
+    const CString prefix(lower_key_name + _T("\\"));
+    for (it = keys_.lower_bound(prefix);
+         it != keys_.end() && it->first.Find(prefix) == 0;
+         ++it) {
+      const CString subkey_name(it->first.Mid(prefix.GetLength()));
+      if (subkey_name.Find(_T('\\')) == -1) {
+        AddValues(it->second, key->AddSubkey(subkey_name));
+      }
+    }
+    return S_OK;
+  }
+
+  int num_reads() const { return num_reads_; }
+
+ private:
+  struct FakeValue {
+    CString name;
+    DWORD type;
+    CString string_value;
+    DWORD dword_value;
+  };
+  typedef std::map<CString, std::vector<FakeValue>> KeyMap;
+
+  static CString Lower(const CString& name) {
+    CString lower_name(name);
+    lower_name.MakeLower();
+    return lower_name;
+  }
+
+  static void AddValues(const std::vector<FakeValue>& values,
+                        RegistryKeySnapshot* key) {
+    for (size_t i = 0; i != values.size(); ++i) {
+      if (values[i].type == REG_SZ) {
+        key->AddStringValue(values[i].name, values[i].string_value);
+      } else {
+        key->AddDwordValue(values[i].name, values[i].dword_value);
+      }
+    }
+  }
+
+  KeyMap keys_;
+  int num_reads_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeAppRegistryBackend);
+};
+
+// Writes the keys of a typical registered app into |backend|.
+void RegisterApp(bool is_machine,
+                 const CString& app_id,
+                 FakeAppRegistryBackend* backend) {
+  const CString clients_key(
+      app_registry_utils::GetAppClientsKey(is_machine, app_id));
+  backend->SetValue(clients_key, kRegValueProductVersion, _T("1.2.3.4"));
+  backend->SetValue(clients_key, kRegValueLanguage, _T("en"));
+  backend->SetValue(clients_key, kRegValueAppName, _T("App"));
+
+  const CString client_state_key(
+      app_registry_utils::GetAppClientStateKey(is_machine, app_id));
+  backend->SetValue(client_state_key, kRegValueProductVersion, _T("1.2.3.4"));
+  backend->SetValue(client_state_key, kRegValueAdditionalParams, _T("ap"));
+  backend->SetValue(client_state_key, kRegValueBrandCode, _T("GOOG"));
+  backend->SetValue(client_state_key, kRegValueInstallTimeSec, 1000UL);
+  backend->SetValue(client_state_key, kRegValueDayOfLastActivity, 4000UL);
+  backend->SetValue(client_state_key, kRegValueDayOfLastRollCall, 4000UL);
+  backend->SetValue(
+      AppendRegKeyPath(client_state_key, kRegSubkeyCohort),
+      _T(""),
+      _T("cohort"));
+
+  if (is_machine) {
+    backend->SetValue(
+        app_registry_utils::GetAppClientStateMediumKey(is_machine, app_id),
+        kRegValueUsageStats,
+        1UL);
+  }
+}
+
+}  // namespace
+
+TEST(RegistryKeySnapshotTest, Empty) {
+  RegistryKeySnapshot key;
+  EXPECT_FALSE(key.exists());
+  EXPECT_EQ(0, key.GetValueCount());
+  EXPECT_EQ(0, key.GetSubkeyCount());
+  EXPECT_FALSE(key.HasValue(_T("pv")));
+
+  CString value;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            key.GetValue(_T("pv"), &value));
+  EXPECT_TRUE(key.GetSubkey(_T("cohort")) == NULL);
+}
+
+TEST(RegistryKeySnapshotTest, Values) {
+  RegistryKeySnapshot key;
+  key.AddStringValue(_T("pv"), _T("1.0"));
+  key.AddDwordValue(_T("InstallTime"), 10);
+  key.AddStringValue(_T(""), _T("default"));
+  key.AddOtherValue(_T("binary"), REG_BINARY);
+  EXPECT_TRUE(key.exists());
+  EXPECT_EQ(4, key.GetValueCount());
+
+  // Value names are case insensitive.
+  CString string_value;
+  EXPECT_SUCCEEDED(key.GetValue(_T("PV"), &string_value));
+  EXPECT_STREQ(_T("1.0"), string_value);
+
+  DWORD dword_value = 0;
+  EXPECT_SUCCEEDED(key.GetValue(_T("installtime"), &dword_value));
+  EXPECT_EQ(10, dword_value);
+
+  EXPECT_SUCCEEDED(key.GetValue(NULL, &string_value));
+  EXPECT_STREQ(_T("default"), string_value);
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            key.GetValue(_T("pv"), &dword_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            key.GetValue(_T("InstallTime"), &string_value));
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH),
+            key.GetValue(_T("binary"), &string_value));
+  EXPECT_TRUE(key.HasValue(_T("binary")));
+
+  // Values are enumerated in the order they were added.
+  CString value_name;
+  DWORD type = REG_NONE;
+  EXPECT_SUCCEEDED(key.GetValueNameAt(1, &value_name, &type));
+  EXPECT_STREQ(_T("InstallTime"), value_name);
+  EXPECT_EQ(REG_DWORD, type);
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_NO_MORE_ITEMS),
+            key.GetValueNameAt(4, &value_name, &type));
+
+  // Adding a value again replaces it.
+  key.AddStringValue(_T("PV"), _T("2.0"));
+  EXPECT_EQ(4, key.GetValueCount());
+  EXPECT_SUCCEEDED(key.GetValue(_T("pv"), &string_value));
+  EXPECT_STREQ(_T("2.0"), string_value);
+}
+
+TEST(RegistryKeySnapshotTest, Subkeys) {
+  RegistryKeySnapshot key;
+  RegistryKeySnapshot* subkey = key.AddSubkey(_T("Cohort"));
+  ASSERT_TRUE(subkey);
+  subkey->AddStringValue(_T("hint"), _T("h"));
+  EXPECT_TRUE(key.exists());
+  EXPECT_TRUE(subkey->exists());
+
+  ASSERT_EQ(1, key.GetSubkeyCount());
+  EXPECT_EQ(subkey, key.GetSubkeyAt(0));
+  EXPECT_EQ(subkey, key.GetSubkey(_T("cohort")));
+  EXPECT_STREQ(_T("Cohort"), subkey->name());
+  EXPECT_TRUE(key.GetSubkey(_T("CurrentState")) == NULL);
+}
+
+class AppRegistrySnapshotCacheTest : public testing::Test {
+ protected:
+  AppRegistrySnapshotCacheTest() : backend_(new FakeAppRegistryBackend) {
+    fake_backend_ = backend_.get();
+  }
+
+  std::unique_ptr<AppRegistrySnapshotCache> CreateCache(bool is_machine) {
+    return std::make_unique<AppRegistrySnapshotCache>(is_machine,
+                                                      std::move(backend_));
+  }
+
+  std::unique_ptr<AppRegistryBackendInterface> backend_;
+  FakeAppRegistryBackend* fake_backend_;
+};
+
+TEST_F(AppRegistrySnapshotCacheTest, GetSnapshot_MachineApp) {
+  RegisterApp(true, kAppId, fake_backend_);
+  std::unique_ptr<AppRegistrySnapshotCache> cache(CreateCache(true));
+
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(
+      cache->GetSnapshot(kAppId));
+  ASSERT_TRUE(snapshot.get());
+  EXPECT_EQ(3, fake_backend_->num_reads());
+
+  CString pv;
+  EXPECT_SUCCEEDED(snapshot->client_key().GetValue(kRegValueProductVersion,
+                                                   &pv));
+  EXPECT_STREQ(_T("1.2.3.4"), pv);
+
+  const RegistryKeySnapshot* cohort_key =
+      snapshot->client_state_key().GetSubkey(kRegSubkeyCohort);
+  ASSERT_TRUE(cohort_key);
+  CString cohort;
+  EXPECT_SUCCEEDED(cohort_key->GetValue(NULL, &cohort));
+  EXPECT_STREQ(_T("cohort"), cohort);
+
+  DWORD usage_stats = 0;
+  EXPECT_SUCCEEDED(snapshot->client_state_medium_key().GetValue(
+      kRegValueUsageStats, &usage_stats));
+  EXPECT_EQ(1, usage_stats);
+}
+
+TEST_F(AppRegistrySnapshotCacheTest, GetSnapshot_UserApp) {
+  RegisterApp(false, kAppId, fake_backend_);
+  std::unique_ptr<AppRegistrySnapshotCache> cache(CreateCache(false));
+
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(
+      cache->GetSnapshot(kAppId));
+  EXPECT_EQ(2, fake_backend_->num_reads());
+  EXPECT_TRUE(snapshot->client_key().exists());
+  EXPECT_TRUE(snapshot->client_state_key().exists());
+  EXPECT_FALSE(snapshot->client_state_medium_key().exists());
+}
+
+TEST_F(AppRegistrySnapshotCacheTest, GetSnapshot_NoApp) {
+  std::unique_ptr<AppRegistrySnapshotCache> cache(CreateCache(false));
+
+  std::shared_ptr<const AppRegistrySnapshot> snapshot(
+      cache->GetSnapshot(kAppId));
+  ASSERT_TRUE(snapshot.get());
+  EXPECT_FALSE(snapshot->client_key().exists());
+  EXPECT_FALSE(snapshot->client_state_key().exists());
+}
+
+TEST_F(AppRegistrySnapshotCacheTest, NotCaching) {
+  RegisterApp(false, kAppId, fake_backend_);
+  std::unique_ptr<AppRegistrySnapshotCache> cache(CreateCache(false));
+
+  cache->GetSnapshot(kAppId);
+  cache->GetSnapshot(kAppId);
+  EXPECT_EQ(2, cache->num_snapshots_read());
+}
+
+TEST_F(AppRegistrySnapshotCacheTest, Caching) {
+  RegisterApp(false, kAppId, fake_backend_);
+  std::unique_ptr<AppRegistrySnapshotCache> cache(CreateCache(false));
+  cache->set_is_caching(true);
+
+  std::shared_ptr<const AppRegistrySnapshot> snapshot1(
+      cache->GetSnapshot(kAppId));
+
+  // App ids are case insensitive.
+  CString app_id(kAppId);
+  app_id.MakeLower();
+  std::shared_ptr<const AppRegistrySnapshot> snapshot2(
+      cache->GetSnapshot(app_id));
+  EXPECT_EQ(snapshot1.get(), snapshot2.get());
+  EXPECT_EQ(1, cache->num_snapshots_read());
+
+  cache->Invalidate(kAppId);
+  std::shared_ptr<const AppRegistrySnapshot> snapshot3(
+      cache->GetSnapshot(kAppId));
+  EXPECT_NE(snapshot1.get(), snapshot3.get());
+  EXPECT_EQ(2, cache->num_snapshots_read());
+
+  // The discarded snapshot remains valid for its holders.
+  CString pv;
+  EXPECT_SUCCEEDED(snapshot1->client_key().GetValue(kRegValueProductVersion,
+                                                    &pv));
+
+  cache->InvalidateAll();
+  cache->GetSnapshot(kAppId);
+  EXPECT_EQ(3, cache->num_snapshots_read());
+
+  cache->set_is_caching(false);
+  cache->GetSnapshot(kAppId);
+  cache->GetSnapshot(kAppId);
+  EXPECT_EQ(5, cache->num_snapshots_read());
+}
+
+// Reads the snapshots of 500 registered apps for 10 consecutive update
+// checks, with and without caching. The time of the reads is measured by the
+// GetAppRegistrySnapshots benchmarks.
+TEST_F(AppRegistrySnapshotCacheTest, RegisteredApps_NumReads) {
+  const int kNumApps = 500;
+  const int kNumUpdateChecks = 10;
+
+  std::vector<CString> app_ids;
+  for (int i = 0; i != kNumApps; ++i) {
+    CString app_id;
+    SafeCStringFormat(&app_id,
+                      _T("{B7BAF788-9D64-49C3-AFDC-%012X}"),
+                      i);
+    RegisterApp(true, app_id, fake_backend_);
+    app_ids.push_back(app_id);
+  }
+  std::unique_ptr<AppRegistrySnapshotCache> cache(CreateCache(true));
+
+  int num_reads[2] = {0};
+  for (int is_caching = 0; is_caching != 2; ++is_caching) {
+    cache->set_is_caching(!!is_caching);
+    const int reads_before = fake_backend_->num_reads();
+
+    for (int check = 0; check != kNumUpdateChecks; ++check) {
+      for (size_t i = 0; i != app_ids.size(); ++i) {
+        std::shared_ptr<const AppRegistrySnapshot> snapshot(
+            cache->GetSnapshot(app_ids[i]));
+        CString pv;
+        EXPECT_SUCCEEDED(snapshot->client_key().GetValue(
+            kRegValueProductVersion, &pv));
+      }
+    }
+    num_reads[is_caching] = fake_backend_->num_reads() - reads_before;
+  }
+
+  EXPECT_EQ(3 * kNumApps * kNumUpdateChecks, num_reads[0]);
+  EXPECT_EQ(3 * kNumApps, num_reads[1]);
+}
+
+class RegKeyAppRegistryBackendTest : public RegistryProtectedTest {
+};
+
+TEST_F(RegKeyAppRegistryBackendTest, ReadKey) {
+  const CString key_name(
+      app_registry_utils::GetAppClientStateKey(false, kAppId));
+  const CString cohort_key_name(AppendRegKeyPath(key_name, kRegSubkeyCohort));
+  EXPECT_SUCCEEDED(RegKey::SetValue(key_name, kRegValueProductVersion,
+                                    _T("1.0")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(key_name, kRegValueInstallTimeSec,
+                                    static_cast<DWORD>(10)));
+  EXPECT_SUCCEEDED(RegKey::SetValue(cohort_key_name, NULL, _T("cohort")));
+
+  RegKeyAppRegistryBackend backend;
+  RegistryKeySnapshot key;
+  EXPECT_EQ(S_OK, backend.ReadKey(key_name, &key));
+  EXPECT_TRUE(key.exists());
+
+  CString pv;
+  EXPECT_SUCCEEDED(key.GetValue(kRegValueProductVersion, &pv));
+  EXPECT_STREQ(_T("1.0"), pv);
+
+  DWORD install_time = 0;
+  EXPECT_SUCCEEDED(key.GetValue(kRegValueInstallTimeSec, &install_time));
+  EXPECT_EQ(10, install_time);
+
+  const RegistryKeySnapshot* cohort_key = key.GetSubkey(kRegSubkeyCohort);
+  ASSERT_TRUE(cohort_key);
+  CString cohort;
+  EXPECT_SUCCEEDED(cohort_key->GetValue(NULL, &cohort));
+  EXPECT_STREQ(_T("cohort"), cohort);
+
+  RegistryKeySnapshot missing_key;
+  EXPECT_EQ(S_FALSE,
+            backend.ReadKey(AppendRegKeyPath(key_name, _T("missing")),
+                            &missing_key));
+  EXPECT_FALSE(missing_key.exists());
+}
+
+}  // namespace omaha
@@ -23,10 +23,12 @@
 #include "omaha/common/update_request.h"
 #include "omaha/common/update_response.h"
 #include "omaha/goopdate/app_state_checking_for_update.h"
+#include "omaha/goopdate/app_state_downloading.h"
 #include "omaha/goopdate/app_state_installing.h"
 #include "omaha/goopdate/app_state_update_available.h"
 #include "omaha/goopdate/app_state_waiting_to_check_for_update.h"
 #include "omaha/goopdate/app_unittest_base.h"
+#include "omaha/goopdate/worker_metrics.h"
 #include "omaha/testing/unit_test.h"
 
 using ::testing::_;
@@ -917,6 +919,76 @@ TEST_F(AppInstallTest, InstallProgress_InvalidInstallerProgress) {
   EXPECT_EQ(100, local_percentage);
 }
 
+// The progress reported by the InstallerWrapper is used instead of the
+// registry value.
+TEST_F(AppInstallTest, InstallProgress_ReportedInstallerProgress) {
+  SetAppStateForUnitTest(app_, new fsm::AppStateInstalling);
+  EXPECT_EQ(STATE_INSTALLING, app_->state());
+
+  EXPECT_SUCCEEDED(RegKey::SetValue(kGuid1ClientStateKeyPathUser,
+                                    kRegValueInstallerProgress,
+                                    static_cast<DWORD>(11)));
+  app_->SetInstallProgress(42);
+
+  CComPtr<ICurrentState> icurrent_state;
+  CComPtr<IDispatch> idispatch;
+  EXPECT_SUCCEEDED(app_->get_currentState(&idispatch));
+  EXPECT_SUCCEEDED(idispatch.QueryInterface(&icurrent_state));
+
+  LONG local_percentage = kCurrentStateProgressUnknown;
+  EXPECT_SUCCEEDED(icurrent_state->get_installProgress(&local_percentage));
+  EXPECT_EQ(42, local_percentage);
+}
+
+// Drives a download and an install which report their progress many times
+// while a client polls ICurrentState. The registry progress values are only
+// written when the state changes and at every tenth of the progress: 0%, 10%,
+// ..., 100% of the download, and the unknown install progress and 0%, 10%,
+// ..., 100% of the install.
+TEST_F(AppInstallTest, PublishProgress_RegistryWrites) {
+  const int kPackageSize = 1000000;
+  const int kNumProgressCallbacks = 1000;
+  const int kMaxStateWrites = 1;
+  const int kMaxDownloadProgressWrites = 11;
+  const int kMaxInstallProgressWrites = 12;
+
+  ASSERT_SUCCEEDED(app_->next_version()->AddPackage(_T("Package.bin"),
+                                                    kPackageSize,
+                                                    _T("hash")));
+  Package* package = app_->next_version()->GetPackage(0);
+  ASSERT_TRUE(package);
+
+  int64 registry_writes = metric_worker_progress_registry_writes.value();
+  SetAppStateForUnitTest(app_, new fsm::AppStateDownloading);
+  package->OnRequestBegin();
+  for (int i = 0; i <= kNumProgressCallbacks; ++i) {
+    package->OnProgress(kPackageSize / kNumProgressCallbacks * i,
+                        kPackageSize,
+                        WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
+                        NULL);
+
+    CComPtr<IDispatch> idispatch;
+    EXPECT_SUCCEEDED(app_->get_currentState(&idispatch));
+  }
+  EXPECT_GE(registry_writes + kMaxStateWrites + kMaxDownloadProgressWrites,
+            metric_worker_progress_registry_writes.value());
+  EXPECT_LT(registry_writes + kMaxStateWrites,
+            metric_worker_progress_registry_writes.value());
+
+  registry_writes = metric_worker_progress_registry_writes.value();
+  SetAppStateForUnitTest(app_, new fsm::AppStateInstalling);
+  for (int i = 0; i <= 100; ++i) {
+    app_->SetInstallProgress(i);
+
+    CComPtr<IDispatch> idispatch;
+    EXPECT_SUCCEEDED(app_->get_currentState(&idispatch));
+  }
+  EXPECT_GE(registry_writes + kMaxStateWrites + kMaxInstallProgressWrites,
+            metric_worker_progress_registry_writes.value());
+  EXPECT_LT(registry_writes + kMaxStateWrites,
+            metric_worker_progress_registry_writes.value());
+}
+
 // Tests the interface for accessing experiments labels.
 TEST_F(AppInstallTest, ExperimentLabels) {
   // Create a bundle of one app, set an experiment label for that app, and
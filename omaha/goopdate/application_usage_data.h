@@ -18,6 +18,9 @@
 // The class provides methods to process the application data, before and
 // after the update check. In case of the did_run key we read the key
 // pre-update check and clear it post-update check.
+//
+// AppManager reads the did run values of all the apps at once with
+// UsageDataCollector instead.
 
 #ifndef OMAHA_GOOPDATE_APPLICATION_USAGE_DATA_H__
 #define OMAHA_GOOPDATE_APPLICATION_USAGE_DATA_H__
@@ -0,0 +1,233 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/bundle_download_plan.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/scoped_impersonation.h"
+#include "omaha/goopdate/download_budget.h"
+#include "omaha/goopdate/download_manager.h"
+#include "omaha/goopdate/model.h"
+
+namespace omaha {
+
+namespace {
+
+// How long the plan waits for its threads to return after all downloads have
+// completed. The threads have no work left at that point.
+const int kThreadPoolShutdownDelayMs = 60000;
+
+}  // namespace
+
+class BundleDownloadPlan::DownloadWorkItem : public UserWorkItem {
+ public:
+  explicit DownloadWorkItem(BundleDownloadPlan* plan) : plan_(plan) {
+    ASSERT1(plan);
+  }
+
+ private:
+  virtual void DoProcess() {
+    scoped_impersonation impersonate_user(plan_->impersonation_token_);
+    HRESULT hr = impersonate_user.result();
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[Impersonation failed][0x%08x]"), hr));
+    }
+
+    // Even if the impersonation failed, the apps must be claimed so that
+    // their completion events are signaled. In that case, the apps are not
+    // downloaded and they remain in the waiting state.
+    plan_->DownloadApps(SUCCEEDED(hr));
+  }
+
+  BundleDownloadPlan* plan_;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadWorkItem);
+};
+
+BundleDownloadPlan::BundleDownloadPlan(
+    DownloadManagerInterface* download_manager,
+    DownloadBudget* download_budget)
+    : download_manager_(download_manager),
+      download_budget_(download_budget),
+      impersonation_token_(NULL),
+      next_app_index_(0),
+      num_download_threads_(0),
+      is_background_(false) {
+  ASSERT1(download_manager);
+}
+
+BundleDownloadPlan::~BundleDownloadPlan() {
+  // The plan can be destroyed before all apps have been waited for, for
+  // instance when the caller returns early. Only the downloads in progress are
+  // waited for; the apps downloaded by WaitForApp are never in progress here.
+  const size_t num_claimed_apps = ClaimRemainingApps();
+  if (is_background_) {
+    for (size_t i = 0; i != num_claimed_apps; ++i) {
+      VERIFY1(::WaitForSingleObject(download_complete_events_[i], INFINITE) ==
+              WAIT_OBJECT_0);
+    }
+  }
+
+  thread_pool_.Stop();
+
+  for (size_t i = 0; i != download_complete_events_.size(); ++i) {
+    VERIFY1(::CloseHandle(download_complete_events_[i]));
+  }
+}
+
+HRESULT BundleDownloadPlan::Start(const std::vector<App*>& apps,
+                                  HANDLE impersonation_token) {
+  CORE_LOG(L3, (_T("[BundleDownloadPlan::Start][%Iu apps]"), apps.size()));
+  ASSERT1(apps_.empty());
+  ASSERT1(!is_background_);
+
+  apps_ = apps;
+  impersonation_token_ = impersonation_token;
+
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    HANDLE event = ::CreateEvent(NULL, true, false, NULL);
+    if (!event) {
+      const HRESULT hr = HRESULTFromLastError();
+      CORE_LOG(LE, (_T("[CreateEvent failed][0x%08x]"), hr));
+      return hr;
+    }
+    download_complete_events_.push_back(event);
+  }
+
+  if (!download_budget_ || apps_.size() < 2) {
+    return S_FALSE;
+  }
+
+  HRESULT hr = thread_pool_.Initialize(kThreadPoolShutdownDelayMs);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[ThreadPool::Initialize failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  // The flag must be set before the first work item runs, since the work
+  // items signal the completion events only in the background mode.
+  is_background_ = true;
+
+  const int num_threads = static_cast<int>(
+      std::min<size_t>(apps_.size(), download_budget_->max_connections()));
+  for (int i = 0; i != num_threads; ++i) {
+    // WT_EXECUTELONGFUNCTION causes the thread pool to use multiple threads.
+    hr = thread_pool_.QueueUserWorkItem(
+        std::make_unique<DownloadWorkItem>(this),
+        COINIT_MULTITHREADED,
+        WT_EXECUTELONGFUNCTION);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%08x]"), hr));
+      break;
+    }
+    ++num_download_threads_;
+  }
+
+  CORE_LOG(L3, (_T("[BundleDownloadPlan::Start][%d download threads]"),
+                num_download_threads_));
+  if (!num_download_threads_) {
+    is_background_ = false;
+    return hr;
+  }
+
+  return S_OK;
+}
+
+void BundleDownloadPlan::WaitForApp(size_t index) {
+  ASSERT1(index < apps_.size());
+
+  if (!is_background_) {
+    // Download the apps in bundle order on the calling thread. Each app is
+    // downloaded at most once, even if WaitForApp is called again.
+    while (static_cast<size_t>(next_app_index_) <= index) {
+      DownloadAppAt(ClaimNextApp());
+    }
+    return;
+  }
+
+  VERIFY1(::WaitForSingleObject(download_complete_events_[index], INFINITE) ==
+          WAIT_OBJECT_0);
+}
+
+bool BundleDownloadPlan::IsAppDownloaded(size_t index) const {
+  ASSERT1(index < apps_.size());
+
+  if (!is_background_) {
+    // The apps are downloaded on the calling thread, as soon as they are
+    // claimed.
+    return index < static_cast<size_t>(next_app_index_);
+  }
+
+  return ::WaitForSingleObject(download_complete_events_[index], 0) ==
+         WAIT_OBJECT_0;
+}
+
+HANDLE BundleDownloadPlan::download_complete_event(size_t index) const {
+  ASSERT1(is_background_);
+  ASSERT1(index < download_complete_events_.size());
+  return download_complete_events_[index];
+}
+
+void BundleDownloadPlan::WaitForAll() {
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    WaitForApp(i);
+  }
+}
+
+size_t BundleDownloadPlan::ClaimNextApp() {
+  const LONG index = ::InterlockedIncrement(&next_app_index_) - 1;
+  return std::min(static_cast<size_t>(index), apps_.size());
+}
+
+size_t BundleDownloadPlan::ClaimRemainingApps() {
+  const LONG num_apps = static_cast<LONG>(apps_.size());
+  const LONG index = ::InterlockedExchange(&next_app_index_, num_apps);
+  return std::min(static_cast<size_t>(index), apps_.size());
+}
+
+void BundleDownloadPlan::DownloadApps(bool can_download) {
+  for (size_t index = ClaimNextApp(); index < apps_.size();
+       index = ClaimNextApp()) {
+    if (can_download) {
+      DownloadAppAt(index);
+    } else {
+      VERIFY1(::SetEvent(download_complete_events_[index]));
+    }
+  }
+}
+
+void BundleDownloadPlan::DownloadAppAt(size_t index) {
+  ASSERT1(index < apps_.size());
+  App* app = apps_[index];
+  ASSERT1(app);
+
+  CORE_LOG(L3, (_T("[BundleDownloadPlan::DownloadAppAt][%Iu][%s]"),
+                index, app->app_guid_string()));
+
+  // This is a blocking call on the network. The download manager holds a
+  // connection of the budget for the duration of the download.
+  app->Download(download_manager_);
+
+  if (is_background_) {
+    VERIFY1(::SetEvent(download_complete_events_[index]));
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,124 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// BundleDownloadPlan downloads the apps of a bundle concurrently while letting
+// the caller consume the downloaded apps in bundle order. The worker uses it to
+// overlap the downloads of the remaining apps with the installation of the
+// apps that have already been downloaded, which the BundleInstallPlan starts
+// as the downloads complete.
+//
+// The plan starts as many threads as the DownloadBudget has connections. The
+// budget is shared by all bundles in the process and the download manager
+// holds one of its connections for each app it downloads.
+
+#ifndef OMAHA_GOOPDATE_BUNDLE_DOWNLOAD_PLAN_H_
+#define OMAHA_GOOPDATE_BUNDLE_DOWNLOAD_PLAN_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/thread_pool.h"
+
+namespace omaha {
+
+class App;
+class DownloadBudget;
+class DownloadManagerInterface;
+
+class BundleDownloadPlan {
+ public:
+  // |download_budget| can be NULL, in which case the apps are downloaded
+  // one at a time.
+  BundleDownloadPlan(DownloadManagerInterface* download_manager,
+                     DownloadBudget* download_budget);
+
+  // Waits for the downloads in progress to complete. The apps which have not
+  // started downloading are not downloaded.
+  ~BundleDownloadPlan();
+
+  // Starts downloading |apps| in the background. The background threads
+  // impersonate |impersonation_token| if the token is not NULL. If the
+  // background downloads can't be started, the apps are downloaded by
+  // WaitForApp on the calling thread.
+  HRESULT Start(const std::vector<App*>& apps, HANDLE impersonation_token);
+
+  // Blocks until the download of the app at |index| has completed, with
+  // or without errors. The outcome of the download is reflected in the state
+  // of the app.
+  void WaitForApp(size_t index);
+
+  // Blocks until all downloads have completed.
+  void WaitForAll();
+
+  // Returns true if the download of the app at |index| has completed. Does
+  // not block.
+  bool IsAppDownloaded(size_t index) const;
+
+  // Returns the event which is signaled when the download of the app at
+  // |index| completes. Only the background downloads signal the events.
+  HANDLE download_complete_event(size_t index) const;
+
+  size_t num_apps() const { return apps_.size(); }
+  App* app(size_t index) const { return apps_[index]; }
+
+  // Returns true if the apps are downloaded by background threads. Otherwise,
+  // the apps are downloaded by WaitForApp.
+  bool is_background() const { return is_background_; }
+
+  // Returns how many background threads are downloading the apps.
+  int num_download_threads() const { return num_download_threads_; }
+
+ private:
+  class DownloadWorkItem;
+
+  // Downloads apps from the plan until all apps have been claimed. If
+  // |can_download| is false, the apps are claimed but not downloaded.
+  void DownloadApps(bool can_download);
+
+  // Returns the index of the next app to download or apps_.size() if all apps
+  // have been claimed.
+  size_t ClaimNextApp();
+
+  // Claims the apps which have not been claimed yet, so that they are never
+  // downloaded. Returns the number of apps which had been claimed before.
+  size_t ClaimRemainingApps();
+
+  void DownloadAppAt(size_t index);
+
+  DownloadManagerInterface* download_manager_;
+  DownloadBudget* download_budget_;
+  HANDLE impersonation_token_;
+
+  std::vector<App*> apps_;
+
+  // One manual-reset event per app, signaled when the download of the app
+  // completes.
+  std::vector<HANDLE> download_complete_events_;
+
+  volatile LONG next_app_index_;
+  int num_download_threads_;
+
+  // True if the apps are downloaded by the thread pool.
+  bool is_background_;
+
+  ThreadPool thread_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleDownloadPlan);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_BUNDLE_DOWNLOAD_PLAN_H_
@@ -0,0 +1,236 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/bundle_download_plan.h"
+
+#include <vector>
+
+#include "omaha/goopdate/app_state_waiting_to_download.h"
+#include "omaha/goopdate/app_unittest_base.h"
+#include "omaha/goopdate/download_budget.h"
+#include "omaha/goopdate/download_manager.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kAppGuids[] = {
+  _T("{0B35E146-D9CB-4145-8A91-43FDCAEBCD1E}"),
+  _T("{C7F2B395-A01C-4806-AA07-9163F66AFC48}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E01}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E02}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E03}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E04}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E05}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E06}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E07}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E08}"),
+};
+
+// Stands in for the download manager and a local server which serves the
+// packages of an app in a fixed amount of time. Like the download manager, it
+// holds a connection of |download_budget| while it downloads an app.
+class FakeDownloadManager : public DownloadManagerInterface {
+ public:
+  explicit FakeDownloadManager(int download_time_ms)
+      : download_time_ms_(download_time_ms),
+        download_budget_(NULL),
+        num_downloads_(0),
+        num_active_downloads_(0),
+        max_active_downloads_(0) {}
+
+  virtual HRESULT Initialize() { return S_OK; }
+  virtual HRESULT PurgeAppLowerVersions(const CString&, const CString&) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT CachePackage(const Package*, File*, const CString*) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT CacheOfflinePackages(const std::vector<const Package*>&,
+                                       const std::vector<CString>&,
+                                       bool,
+                                       size_t*) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT GetPackage(const Package*, const CString&) const {
+    return E_NOTIMPL;
+  }
+  virtual bool IsPackageAvailable(const Package*) const { return false; }
+  virtual void Cancel(App*) {}
+  virtual void CancelAll() {}
+  virtual bool IsBusy() const { return num_active_downloads_ > 0; }
+
+  virtual HRESULT DownloadApp(App* app) {
+    ScopedDownloadConnection connection(download_budget_, NULL);
+    EXPECT_SUCCEEDED(connection.result());
+
+    const LONG num_active = ::InterlockedIncrement(&num_active_downloads_);
+    for (LONG max_active = max_active_downloads_; num_active > max_active;
+         max_active = max_active_downloads_) {
+      ::InterlockedCompareExchange(&max_active_downloads_,
+                                   num_active,
+                                   max_active);
+    }
+
+    app->Downloading();
+    ::Sleep(download_time_ms_);
+    app->DownloadComplete();
+    app->MarkReadyToInstall();
+
+    ::InterlockedDecrement(&num_active_downloads_);
+    ::InterlockedIncrement(&num_downloads_);
+    return S_OK;
+  }
+
+  void set_download_budget(DownloadBudget* download_budget) {
+    download_budget_ = download_budget;
+  }
+
+  LONG num_downloads() const { return num_downloads_; }
+  LONG max_active_downloads() const { return max_active_downloads_; }
+
+ private:
+  const int download_time_ms_;
+  DownloadBudget* download_budget_;
+  volatile LONG num_downloads_;
+  volatile LONG num_active_downloads_;
+  volatile LONG max_active_downloads_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeDownloadManager);
+};
+
+}  // namespace
+
+class BundleDownloadPlanTest : public AppTestBase {
+ protected:
+  BundleDownloadPlanTest() : AppTestBase(false, true) {}
+
+  void CreateApps(size_t num_apps) {
+    ASSERT_LE(num_apps, arraysize(kAppGuids));
+
+    for (size_t i = 0; i != num_apps; ++i) {
+      App* app = NULL;
+      ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuids[i]), &app));
+      SetAppStateForUnitTest(app, new fsm::AppStateWaitingToDownload);
+      apps_.push_back(app);
+    }
+  }
+
+  std::vector<App*> apps_;
+};
+
+TEST_F(BundleDownloadPlanTest, NoApps) {
+  FakeDownloadManager download_manager(0);
+  DownloadBudget download_budget(4, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+
+  BundleDownloadPlan download_plan(&download_manager, &download_budget);
+  EXPECT_EQ(S_FALSE, download_plan.Start(apps_, NULL));
+  EXPECT_EQ(0, download_plan.num_apps());
+  download_plan.WaitForAll();
+
+  EXPECT_EQ(0, download_manager.num_downloads());
+}
+
+TEST_F(BundleDownloadPlanTest, NoBudget_DownloadsInBundleOrder) {
+  CreateApps(3);
+
+  FakeDownloadManager download_manager(0);
+  BundleDownloadPlan download_plan(&download_manager, NULL);
+  EXPECT_EQ(S_FALSE, download_plan.Start(apps_, NULL));
+  EXPECT_EQ(0, download_plan.num_download_threads());
+
+  download_plan.WaitForApp(1);
+  EXPECT_EQ(STATE_READY_TO_INSTALL, apps_[0]->state());
+  EXPECT_EQ(STATE_READY_TO_INSTALL, apps_[1]->state());
+  EXPECT_EQ(STATE_WAITING_TO_DOWNLOAD, apps_[2]->state());
+  EXPECT_EQ(2, download_manager.num_downloads());
+
+  // Waiting again for an app does not download it again.
+  download_plan.WaitForApp(0);
+  EXPECT_EQ(2, download_manager.num_downloads());
+
+  download_plan.WaitForAll();
+  EXPECT_EQ(STATE_READY_TO_INSTALL, apps_[2]->state());
+  EXPECT_EQ(3, download_manager.num_downloads());
+  EXPECT_EQ(1, download_manager.max_active_downloads());
+}
+
+TEST_F(BundleDownloadPlanTest, ConcurrentDownloadsWithinBudget) {
+  CreateApps(10);
+
+  FakeDownloadManager download_manager(50);
+  DownloadBudget download_budget(3, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+
+  BundleDownloadPlan download_plan(&download_manager, &download_budget);
+  EXPECT_EQ(S_OK, download_plan.Start(apps_, NULL));
+  EXPECT_EQ(3, download_plan.num_download_threads());
+
+  download_plan.WaitForAll();
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    EXPECT_EQ(STATE_READY_TO_INSTALL, apps_[i]->state());
+  }
+
+  EXPECT_EQ(10, download_manager.num_downloads());
+  EXPECT_LE(download_manager.max_active_downloads(), 3);
+  EXPECT_GT(download_manager.max_active_downloads(), 1);
+}
+
+// The connection budget is shared by the plans of different bundles.
+TEST_F(BundleDownloadPlanTest, BudgetIsSharedAcrossPlans) {
+  CreateApps(8);
+
+  FakeDownloadManager download_manager(50);
+  DownloadBudget download_budget(2, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+  download_manager.set_download_budget(&download_budget);
+
+  std::vector<App*> first_apps(apps_.begin(), apps_.begin() + 4);
+  std::vector<App*> second_apps(apps_.begin() + 4, apps_.end());
+
+  {
+    BundleDownloadPlan first_plan(&download_manager, &download_budget);
+    BundleDownloadPlan second_plan(&download_manager, &download_budget);
+    EXPECT_SUCCEEDED(first_plan.Start(first_apps, NULL));
+    EXPECT_SUCCEEDED(second_plan.Start(second_apps, NULL));
+    first_plan.WaitForAll();
+    second_plan.WaitForAll();
+  }
+
+  EXPECT_EQ(8, download_manager.num_downloads());
+  EXPECT_LE(download_manager.max_active_downloads(), 2);
+}
+
+// The apps which have not started downloading when the plan is destroyed are
+// not downloaded.
+TEST_F(BundleDownloadPlanTest, Destructor_DoesNotStartDownloads) {
+  CreateApps(3);
+
+  FakeDownloadManager download_manager(0);
+  {
+    BundleDownloadPlan download_plan(&download_manager, NULL);
+    EXPECT_EQ(S_FALSE, download_plan.Start(apps_, NULL));
+    download_plan.WaitForApp(0);
+  }
+
+  EXPECT_EQ(1, download_manager.num_downloads());
+  EXPECT_EQ(STATE_READY_TO_INSTALL, apps_[0]->state());
+  EXPECT_EQ(STATE_WAITING_TO_DOWNLOAD, apps_[1]->state());
+  EXPECT_EQ(STATE_WAITING_TO_DOWNLOAD, apps_[2]->state());
+}
+
+}  // namespace omaha
@@ -0,0 +1,386 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/bundle_install_plan.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/scoped_impersonation.h"
+#include "omaha/base/string.h"
+#include "omaha/goopdate/bundle_download_plan.h"
+#include "omaha/goopdate/install_manager.h"
+#include "omaha/goopdate/model.h"
+
+namespace omaha {
+
+namespace {
+
+// How long the plan waits for its threads to return after all installs have
+// completed. The threads have no work left at that point.
+const int kThreadPoolShutdownDelayMs = 60000;
+
+}  // namespace
+
+// Installs the apps concurrently with the other installs of the plan.
+class BundleInstallPlan::ConcurrentInstallManager
+    : public InstallManagerInterface {
+ public:
+  explicit ConcurrentInstallManager(InstallManagerInterface* install_manager)
+      : install_manager_(install_manager) {
+    ASSERT1(install_manager);
+  }
+
+  virtual CString install_working_dir() const {
+    return install_manager_->install_working_dir();
+  }
+
+  virtual HRESULT Initialize() {
+    return install_manager_->Initialize();
+  }
+
+  virtual void InstallApp(App* app, const CString& dir) {
+    install_manager_->InstallAppConcurrently(app, dir);
+  }
+
+  virtual void InstallAppConcurrently(App* app, const CString& dir) {
+    install_manager_->InstallAppConcurrently(app, dir);
+  }
+
+ private:
+  InstallManagerInterface* install_manager_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConcurrentInstallManager);
+};
+
+class BundleInstallPlan::InstallWorkItem : public UserWorkItem {
+ public:
+  InstallWorkItem(BundleInstallPlan* plan, size_t index)
+      : plan_(plan),
+        index_(index) {
+    ASSERT1(plan);
+  }
+
+ private:
+  virtual void DoProcess() {
+    plan_->InstallAppAt(index_);
+  }
+
+  BundleInstallPlan* plan_;
+  const size_t index_;
+
+  DISALLOW_COPY_AND_ASSIGN(InstallWorkItem);
+};
+
+BundleInstallPlan::BundleInstallPlan(InstallManagerInterface* install_manager,
+                                     int max_concurrent_installs)
+    : install_manager_(install_manager),
+      concurrent_install_manager_(
+          new ConcurrentInstallManager(install_manager)),
+      max_concurrent_installs_(max_concurrent_installs),
+      num_active_installs_(0),
+      max_active_installs_(0) {
+  ASSERT1(install_manager);
+  ASSERT1(max_concurrent_installs >= 1);
+}
+
+BundleInstallPlan::~BundleInstallPlan() {
+  ASSERT1(!num_active_installs_);
+  thread_pool_.Stop();
+}
+
+void BundleInstallPlan::InstallAll(BundleDownloadPlan* download_plan) {
+  ASSERT1(download_plan);
+  ASSERT1(apps_.empty());
+
+  const size_t num_apps = download_plan->num_apps();
+  CORE_LOG(L3, (_T("[BundleInstallPlan::InstallAll][%Iu apps][%d installs]"),
+                num_apps, max_concurrent_installs_));
+
+  if (max_concurrent_installs_ <= 1 || num_apps < 2) {
+    InstallAllInOrder(download_plan);
+    return;
+  }
+
+  reset(install_complete_event_, ::CreateEvent(NULL, false, false, NULL));
+  if (!install_complete_event_) {
+    CORE_LOG(LE, (_T("[CreateEvent failed][0x%08x]"), HRESULTFromLastError()));
+    InstallAllInOrder(download_plan);
+    return;
+  }
+
+  HRESULT hr = thread_pool_.Initialize(kThreadPoolShutdownDelayMs);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[ThreadPool::Initialize failed][0x%08x]"), hr));
+    InstallAllInOrder(download_plan);
+    return;
+  }
+
+  for (size_t i = 0; i != num_apps; ++i) {
+    App* app = download_plan->app(i);
+    apps_.push_back(app);
+
+    // The packages of the apps are known from the update check, before the
+    // packages are downloaded.
+    footprints_.push_back(GetFootprint(app));
+    install_states_.push_back(INSTALL_PENDING);
+    is_concurrent_installs_.push_back(false);
+  }
+
+  while (!IsComplete()) {
+    for (size_t i = 0; i != num_apps; ++i) {
+      if (CanInstallAppAt(*download_plan, i)) {
+        StartInstallAppAt(i);
+      }
+    }
+
+    if (!IsComplete()) {
+      WaitForProgress(download_plan);
+    }
+  }
+
+  CORE_LOG(L3, (_T("[BundleInstallPlan::InstallAll][%d max active installs]"),
+                max_active_installs_));
+}
+
+void BundleInstallPlan::InstallAllInOrder(BundleDownloadPlan* download_plan) {
+  ASSERT1(download_plan);
+
+  for (size_t i = 0; i != download_plan->num_apps(); ++i) {
+    App* app = download_plan->app(i);
+
+    // Wait for the app to download if it has not already been downloaded.
+    // This is a blocking call on the network.
+    download_plan->WaitForApp(i);
+
+    ASSERT1(app->state() == STATE_READY_TO_INSTALL ||    // Downloaded above.
+            app->state() == STATE_WAITING_TO_INSTALL ||  // Downloaded earlier.
+            app->state() == STATE_NO_UPDATE ||
+            app->state() == STATE_ERROR);
+
+    app->QueueInstall();
+
+    // This is a blocking call on the app installer.
+    CallAsSelfAndImpersonate1(
+        app,
+        &App::Install,
+        install_manager_);
+
+    ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
+            app->state() == STATE_NO_UPDATE ||
+            app->state() == STATE_ERROR);
+  }
+
+  max_active_installs_ = download_plan->num_apps() ? 1 : 0;
+}
+
+bool BundleInstallPlan::CanInstallAppAt(const BundleDownloadPlan& download_plan,
+                                        size_t index) const {
+  ASSERT1(index < apps_.size());
+
+  __mutexScope(lock_);
+
+  if (install_states_[index] != INSTALL_PENDING ||
+      num_active_installs_ >= max_concurrent_installs_ ||
+      !download_plan.IsAppDownloaded(index)) {
+    return false;
+  }
+
+  // The apps which conflict are installed in bundle order, so the app waits
+  // for the pending apps before it, even if they are not downloaded yet.
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    const bool is_ahead = install_states_[i] == INSTALL_RUNNING ||
+                          (install_states_[i] == INSTALL_PENDING && i < index);
+    if (is_ahead && IsConflicting(footprints_[i], footprints_[index])) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+bool BundleInstallPlan::HasConcurrentAppsFor(size_t index) const {
+  ASSERT1(index < apps_.size());
+
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    if (i != index &&
+        install_states_[i] != INSTALL_COMPLETE &&
+        !IsConflicting(footprints_[i], footprints_[index])) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void BundleInstallPlan::StartInstallAppAt(size_t index) {
+  ASSERT1(index < apps_.size());
+  App* app = apps_[index];
+
+  ASSERT1(app->state() == STATE_READY_TO_INSTALL ||
+          app->state() == STATE_WAITING_TO_INSTALL ||
+          app->state() == STATE_NO_UPDATE ||
+          app->state() == STATE_ERROR);
+
+  app->QueueInstall();
+
+  {
+    __mutexScope(lock_);
+    install_states_[index] = INSTALL_RUNNING;
+    is_concurrent_installs_[index] = HasConcurrentAppsFor(index);
+    ++num_active_installs_;
+    max_active_installs_ = std::max(max_active_installs_, num_active_installs_);
+  }
+
+  CORE_LOG(L3, (_T("[BundleInstallPlan::StartInstallAppAt][%Iu][%s]"),
+                index, app->app_guid_string()));
+
+  // The apps which have nothing to install complete on the calling thread.
+  if (app->state() == STATE_WAITING_TO_INSTALL) {
+    // WT_EXECUTELONGFUNCTION causes the thread pool to use multiple threads.
+    HRESULT hr = thread_pool_.QueueUserWorkItem(
+        std::make_unique<InstallWorkItem>(this, index),
+        COINIT_MULTITHREADED,
+        WT_EXECUTELONGFUNCTION);
+    if (SUCCEEDED(hr)) {
+      return;
+    }
+    CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%08x]"), hr));
+  }
+
+  // This is a blocking call on the app installer.
+  CallAsSelfAndImpersonate1(this, &BundleInstallPlan::InstallAppAt, index);
+}
+
+void BundleInstallPlan::InstallAppAt(size_t index) {
+  ASSERT1(index < apps_.size());
+  App* app = apps_[index];
+
+  bool is_concurrent = false;
+  {
+    __mutexScope(lock_);
+    is_concurrent = is_concurrent_installs_[index];
+  }
+
+  app->Install(is_concurrent ? concurrent_install_manager_.get() :
+                               install_manager_);
+
+  ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
+          app->state() == STATE_NO_UPDATE ||
+          app->state() == STATE_ERROR);
+
+  __mutexScope(lock_);
+  install_states_[index] = INSTALL_COMPLETE;
+  --num_active_installs_;
+  VERIFY1(::SetEvent(get(install_complete_event_)));
+}
+
+void BundleInstallPlan::WaitForProgress(BundleDownloadPlan* download_plan) {
+  ASSERT1(download_plan);
+
+  std::vector<size_t> downloading_apps;
+  {
+    __mutexScope(lock_);
+    for (size_t i = 0; i != apps_.size(); ++i) {
+      if (install_states_[i] == INSTALL_PENDING &&
+          !download_plan->IsAppDownloaded(i)) {
+        downloading_apps.push_back(i);
+      }
+    }
+  }
+
+  if (!downloading_apps.empty() && !download_plan->is_background()) {
+    // The apps are downloaded on this thread while the installers which have
+    // started keep running. This is a blocking call on the network.
+    download_plan->WaitForApp(downloading_apps.front());
+    return;
+  }
+
+  std::vector<HANDLE> handles(1, get(install_complete_event_));
+  for (size_t i = 0; i != downloading_apps.size(); ++i) {
+    if (handles.size() == MAXIMUM_WAIT_OBJECTS) {
+      break;
+    }
+    handles.push_back(
+        download_plan->download_complete_event(downloading_apps[i]));
+  }
+
+  const DWORD result = ::WaitForMultipleObjects(
+      static_cast<DWORD>(handles.size()),
+      &handles.front(),
+      false,
+      INFINITE);
+  VERIFY1(result < WAIT_OBJECT_0 + handles.size());
+}
+
+bool BundleInstallPlan::IsComplete() const {
+  __mutexScope(lock_);
+  return std::count(install_states_.begin(),
+                    install_states_.end(),
+                    INSTALL_COMPLETE) ==
+         static_cast<ptrdiff_t>(install_states_.size());
+}
+
+BundleInstallPlan::Footprint BundleInstallPlan::GetFootprint(App* app) {
+  ASSERT1(app);
+
+  Footprint footprint;
+  footprint.is_exclusive = !!::IsEqualGUID(app->app_guid(), kGoopdateGuid);
+
+  // The apps without an update have no packages.
+  const AppVersion* next_version = app->next_version();
+  for (size_t i = 0; i != next_version->GetNumberOfPackages(); ++i) {
+    const Package* package = next_version->GetPackage(i);
+
+    // The first package is the installer of the app.
+    if (!i) {
+      footprint.is_msi = String_EndsWith(package->filename(), _T(".msi"), true);
+    }
+
+    const CString hash = package->expected_hash();
+    if (!hash.IsEmpty()) {
+      footprint.package_hashes.push_back(hash);
+    }
+  }
+
+  return footprint;
+}
+
+bool BundleInstallPlan::IsConflicting(const Footprint& first,
+                                      const Footprint& second) {
+  if (first.is_exclusive || second.is_exclusive) {
+    return true;
+  }
+
+  if (first.is_msi && second.is_msi) {
+    return true;
+  }
+
+  for (size_t i = 0; i != first.package_hashes.size(); ++i) {
+    if (std::find(second.package_hashes.begin(),
+                  second.package_hashes.end(),
+                  first.package_hashes[i]) != second.package_hashes.end()) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+}  // namespace omaha
@@ -0,0 +1,141 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// BundleInstallPlan installs the apps of a bundle as the BundleDownloadPlan
+// downloads them. Up to max_concurrent_installs installers run at the same
+// time, on background threads, as long as their apps do not conflict. Two apps
+// conflict if:
+//   * both are installed by Windows Installer, which runs one install at a
+//     time on the machine.
+//   * one of them is Omaha, since its installer replaces the running Omaha.
+//   * they have a package in common. Their installers write the same files.
+// The apps which conflict are installed in bundle order. With a limit of one
+// installer, all apps are installed in bundle order on the calling thread.
+//
+// An installer which may run at the same time as other installers runs
+// without the registry stable state lock. When the other apps of the bundle
+// conflict with the app, its installer holds the lock as usual.
+
+#ifndef OMAHA_GOOPDATE_BUNDLE_INSTALL_PLAN_H_
+#define OMAHA_GOOPDATE_BUNDLE_INSTALL_PLAN_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/base/thread_pool.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class App;
+class BundleDownloadPlan;
+class InstallManagerInterface;
+
+class BundleInstallPlan {
+ public:
+  BundleInstallPlan(InstallManagerInterface* install_manager,
+                    int max_concurrent_installs);
+
+  // Waits for the outstanding installs to complete.
+  ~BundleInstallPlan();
+
+  // Installs the apps of |download_plan| as their downloads complete. Blocks
+  // until all the apps have been installed, with or without errors. The
+  // outcome of each install is reflected in the state of the app. The
+  // installers run as self, even if the calling thread is impersonating.
+  void InstallAll(BundleDownloadPlan* download_plan);
+
+  // Returns the largest number of installs which ran at the same time.
+  int max_active_installs() const { return max_active_installs_; }
+
+ private:
+  class ConcurrentInstallManager;
+  class InstallWorkItem;
+
+  enum InstallState {
+    INSTALL_PENDING,
+    INSTALL_RUNNING,
+    INSTALL_COMPLETE,
+  };
+
+  // What the installer of an app changes on the machine, as far as Omaha can
+  // tell before running it.
+  struct Footprint {
+    Footprint() : is_msi(false), is_exclusive(false) {}
+
+    bool is_msi;
+    bool is_exclusive;
+    std::vector<CString> package_hashes;
+  };
+
+  static Footprint GetFootprint(App* app);
+  static bool IsConflicting(const Footprint& first, const Footprint& second);
+
+  // Installs the apps in bundle order on the calling thread.
+  void InstallAllInOrder(BundleDownloadPlan* download_plan);
+
+  // Returns true if the app at |index| can be installed now: the app has
+  // been downloaded, there is an install slot available, and the app does not
+  // conflict with the apps which are installing or come before it.
+  bool CanInstallAppAt(const BundleDownloadPlan& download_plan,
+                       size_t index) const;
+
+  // Returns true if an app which has not been installed yet does not conflict
+  // with the app at |index|, so that its installer could run at the same time.
+  // Called under |lock_|.
+  bool HasConcurrentAppsFor(size_t index) const;
+
+  // Starts installing the app at |index| on the thread pool. The app is
+  // installed on the calling thread if the work item can't be queued.
+  void StartInstallAppAt(size_t index);
+
+  // Blocks until an install completes or the download of a pending app
+  // completes.
+  void WaitForProgress(BundleDownloadPlan* download_plan);
+
+  // Installs the app at |index|. Called on the thread pool.
+  void InstallAppAt(size_t index);
+
+  bool IsComplete() const;
+
+  InstallManagerInterface* install_manager_;
+  std::unique_ptr<ConcurrentInstallManager> concurrent_install_manager_;
+  const int max_concurrent_installs_;
+
+  std::vector<App*> apps_;
+  std::vector<Footprint> footprints_;
+
+  // Protects the install states and the counters below.
+  LLock lock_;
+  std::vector<InstallState> install_states_;
+  std::vector<bool> is_concurrent_installs_;
+  int num_active_installs_;
+  int max_active_installs_;
+
+  // Auto-reset event, signaled when an install completes.
+  scoped_event install_complete_event_;
+
+  ThreadPool thread_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleInstallPlan);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_BUNDLE_INSTALL_PLAN_H_
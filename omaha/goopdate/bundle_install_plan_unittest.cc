@@ -0,0 +1,375 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/bundle_install_plan.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/goopdate/app_manager.h"
+#include "omaha/goopdate/app_state_waiting_to_download.h"
+#include "omaha/goopdate/app_unittest_base.h"
+#include "omaha/goopdate/bundle_download_plan.h"
+#include "omaha/goopdate/download_budget.h"
+#include "omaha/goopdate/download_manager.h"
+#include "omaha/goopdate/install_manager.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kAppGuids[] = {
+  _T("{0B35E146-D9CB-4145-8A91-43FDCAEBCD1E}"),
+  _T("{C7F2B395-A01C-4806-AA07-9163F66AFC48}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E01}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E02}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E03}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E04}"),
+};
+
+// How long the fakes wait for the other threads of a test before failing it.
+const DWORD kMaxWaitMs = 60000;
+
+// Downloads the packages of an app immediately.
+class FakeDownloadManager : public DownloadManagerInterface {
+ public:
+  FakeDownloadManager() {}
+
+  virtual HRESULT Initialize() { return S_OK; }
+  virtual HRESULT PurgeAppLowerVersions(const CString&, const CString&) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT CachePackage(const Package*, File*, const CString*) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT CacheOfflinePackages(const std::vector<const Package*>&,
+                                       const std::vector<CString>&,
+                                       bool,
+                                       size_t*) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT GetPackage(const Package*, const CString&) const {
+    return E_NOTIMPL;
+  }
+  virtual bool IsPackageAvailable(const Package*) const { return false; }
+  virtual void Cancel(App*) {}
+  virtual void CancelAll() {}
+  virtual bool IsBusy() const { return false; }
+
+  virtual HRESULT DownloadApp(App* app) {
+    app->Downloading();
+    app->DownloadComplete();
+    app->MarkReadyToInstall();
+    return S_OK;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FakeDownloadManager);
+};
+
+// Stands in for the install manager and the installers. The installers do not
+// exit before |num_concurrent_installs| of them have run at the same time, so
+// a test which expects installs to overlap fails instead of depending on the
+// timing of the threads. Records the order in which the installers start and
+// exit, and which apps were installed concurrently.
+class FakeInstallManager : public InstallManagerInterface {
+ public:
+  FakeInstallManager(const CString& install_working_dir,
+                     int num_concurrent_installs)
+      : install_working_dir_(install_working_dir),
+        num_concurrent_installs_(num_concurrent_installs),
+        num_installs_(0),
+        num_active_installs_(0),
+        max_active_installs_(0),
+        num_events_(0) {
+    reset(concurrent_installs_event_, ::CreateEvent(NULL, true, false, NULL));
+  }
+
+  virtual CString install_working_dir() const { return install_working_dir_; }
+  virtual HRESULT Initialize() { return S_OK; }
+
+  virtual void InstallApp(App* app, const CString& dir) {
+    UNREFERENCED_PARAMETER(dir);
+    RunInstaller(app, false);
+  }
+
+  virtual void InstallAppConcurrently(App* app, const CString& dir) {
+    UNREFERENCED_PARAMETER(dir);
+    RunInstaller(app, true);
+  }
+
+  // Returns true if the installer of |first| exited before the installer of
+  // |second| started.
+  bool IsInstalledBefore(const App* first, const App* second) const {
+    return GetEvent(first, exit_events_) < GetEvent(second, start_events_);
+  }
+
+  bool IsInstalledConcurrently(const App* app) const {
+    __mutexScope(lock_);
+    return std::find(concurrent_apps_.begin(), concurrent_apps_.end(), app) !=
+           concurrent_apps_.end();
+  }
+
+  LONG num_installs() const { return num_installs_; }
+  LONG max_active_installs() const { return max_active_installs_; }
+
+ private:
+  typedef std::vector<std::pair<const App*, LONG> > Events;
+
+  void RunInstaller(App* app, bool is_concurrent) {
+    app->Installing();
+
+    RecordEvent(app, &start_events_);
+    {
+      __mutexScope(lock_);
+      if (is_concurrent) {
+        concurrent_apps_.push_back(app);
+      }
+      max_active_installs_ = std::max(max_active_installs_,
+                                      ++num_active_installs_);
+      if (num_active_installs_ >= num_concurrent_installs_) {
+        EXPECT_TRUE(::SetEvent(get(concurrent_installs_event_)));
+      }
+    }
+
+    EXPECT_EQ(WAIT_OBJECT_0,
+              ::WaitForSingleObject(get(concurrent_installs_event_),
+                                    kMaxWaitMs));
+
+    RecordEvent(app, &exit_events_);
+    {
+      __mutexScope(lock_);
+      --num_active_installs_;
+      ++num_installs_;
+    }
+
+    AppManager& app_manager = *AppManager::Instance();
+    __mutexScope(app_manager.GetRegistryStableStateLock());
+
+    InstallerResultInfo result_info;
+    result_info.type = INSTALLER_RESULT_SUCCESS;
+    result_info.text = _T("success");
+    app->ReportInstallerComplete(result_info);
+  }
+
+  void RecordEvent(const App* app, Events* events) {
+    const LONG event = ::InterlockedIncrement(&num_events_);
+    __mutexScope(lock_);
+    events->push_back(std::make_pair(app, event));
+  }
+
+  LONG GetEvent(const App* app, const Events& events) const {
+    __mutexScope(lock_);
+    for (size_t i = 0; i != events.size(); ++i) {
+      if (events[i].first == app) {
+        return events[i].second;
+      }
+    }
+    ADD_FAILURE() << _T("The app was not installed.");
+    return 0;
+  }
+
+  const CString install_working_dir_;
+  const LONG num_concurrent_installs_;
+
+  // Manual-reset event, signaled when |num_concurrent_installs_| installers
+  // have run at the same time.
+  scoped_event concurrent_installs_event_;
+
+  LLock lock_;
+  Events start_events_;
+  Events exit_events_;
+  std::vector<const App*> concurrent_apps_;
+  LONG num_installs_;
+  LONG num_active_installs_;
+  LONG max_active_installs_;
+
+  volatile LONG num_events_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeInstallManager);
+};
+
+}  // namespace
+
+class BundleInstallPlanTest : public AppTestBaseWithRegistryOverride {
+ protected:
+  // The packages are copied by the mock worker, which succeeds without
+  // copying them.
+  BundleInstallPlanTest()
+      : AppTestBaseWithRegistryOverride(false,    // is_machine
+                                        false) {}  // use_strict_mock
+
+  virtual void SetUp() {
+    AppTestBaseWithRegistryOverride::SetUp();
+
+    install_working_dir_ = ConcatenatePath(app_util::GetTempDir(),
+                                           _T("bundle_install_plan_test"));
+    EXPECT_SUCCEEDED(CreateDir(install_working_dir_, NULL));
+  }
+
+  virtual void TearDown() {
+    EXPECT_SUCCEEDED(DeleteDirectory(install_working_dir_));
+
+    AppTestBaseWithRegistryOverride::TearDown();
+  }
+
+  void CreateApps(size_t num_apps) {
+    ASSERT_LE(num_apps, arraysize(kAppGuids));
+
+    for (size_t i = 0; i != num_apps; ++i) {
+      App* app = NULL;
+      ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuids[i]), &app));
+      apps_.push_back(app);
+    }
+    ResetApps();
+  }
+
+  void ResetApps() {
+    for (size_t i = 0; i != apps_.size(); ++i) {
+      SetAppStateForUnitTest(apps_[i], new fsm::AppStateWaitingToDownload);
+    }
+  }
+
+  void AddPackage(size_t index, const CString& filename, const CString& hash) {
+    ASSERT_SUCCEEDED(apps_[index]->next_version()->AddPackage(filename,
+                                                              100,
+                                                              hash));
+  }
+
+  // Downloads and installs all the apps.
+  void InstallAll(DownloadBudget* download_budget,
+                  FakeInstallManager* install_manager,
+                  int max_concurrent_installs) {
+    FakeDownloadManager download_manager;
+    BundleDownloadPlan download_plan(&download_manager, download_budget);
+    EXPECT_SUCCEEDED(download_plan.Start(apps_, NULL));
+
+    BundleInstallPlan install_plan(install_manager, max_concurrent_installs);
+    install_plan.InstallAll(&download_plan);
+    for (size_t i = 0; i != apps_.size(); ++i) {
+      EXPECT_EQ(STATE_INSTALL_COMPLETE, apps_[i]->state());
+    }
+  }
+
+  CString install_working_dir_;
+  std::vector<App*> apps_;
+};
+
+TEST_F(BundleInstallPlanTest, OneInstallAtATime_InstallsInBundleOrder) {
+  CreateApps(3);
+
+  FakeInstallManager install_manager(install_working_dir_, 1);
+  InstallAll(NULL, &install_manager, 1);
+
+  EXPECT_EQ(3, install_manager.num_installs());
+  EXPECT_EQ(1, install_manager.max_active_installs());
+  EXPECT_TRUE(install_manager.IsInstalledBefore(apps_[0], apps_[1]));
+  EXPECT_TRUE(install_manager.IsInstalledBefore(apps_[1], apps_[2]));
+  EXPECT_FALSE(install_manager.IsInstalledConcurrently(apps_[0]));
+}
+
+// The first installers wait for each other, so the limit is reached.
+TEST_F(BundleInstallPlanTest, ConcurrentInstallsWithinLimit) {
+  CreateApps(6);
+
+  DownloadBudget download_budget(4, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+  FakeInstallManager install_manager(install_working_dir_, 3);
+  InstallAll(&download_budget, &install_manager, 3);
+
+  EXPECT_EQ(6, install_manager.num_installs());
+  EXPECT_EQ(3, install_manager.max_active_installs());
+  EXPECT_TRUE(install_manager.IsInstalledConcurrently(apps_[0]));
+}
+
+// The installs are interleaved with the downloads, which run on the calling
+// thread when there is no download budget.
+TEST_F(BundleInstallPlanTest, ConcurrentInstalls_NoDownloadBudget) {
+  CreateApps(3);
+
+  FakeInstallManager install_manager(install_working_dir_, 1);
+  InstallAll(NULL, &install_manager, 3);
+
+  EXPECT_EQ(3, install_manager.num_installs());
+}
+
+// Windows Installer runs one install at a time, so the MSI installers run in
+// bundle order. The other installer runs at the same time as the first one.
+TEST_F(BundleInstallPlanTest, MsiInstallersAreInstalledInBundleOrder) {
+  CreateApps(3);
+  AddPackage(0, _T("first.msi"), _T("hash0"));
+  AddPackage(1, _T("second.exe"), _T("hash1"));
+  AddPackage(2, _T("third.MSI"), _T("hash2"));
+
+  DownloadBudget download_budget(4, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+  FakeInstallManager install_manager(install_working_dir_, 2);
+  InstallAll(&download_budget, &install_manager, 3);
+
+  EXPECT_EQ(3, install_manager.num_installs());
+  EXPECT_EQ(2, install_manager.max_active_installs());
+  EXPECT_TRUE(install_manager.IsInstalledBefore(apps_[0], apps_[2]));
+  EXPECT_FALSE(install_manager.IsInstalledBefore(apps_[0], apps_[1]));
+  EXPECT_TRUE(install_manager.IsInstalledConcurrently(apps_[0]));
+  EXPECT_TRUE(install_manager.IsInstalledConcurrently(apps_[1]));
+}
+
+// The installers of the apps which have a package in common write the same
+// files.
+TEST_F(BundleInstallPlanTest, SharedPackagesAreInstalledInBundleOrder) {
+  CreateApps(3);
+  AddPackage(0, _T("first.exe"), _T("hash0"));
+  AddPackage(0, _T("shared.dat"), _T("shared"));
+  AddPackage(1, _T("second.exe"), _T("hash1"));
+  AddPackage(2, _T("third.exe"), _T("hash2"));
+  AddPackage(2, _T("shared.dat"), _T("shared"));
+
+  DownloadBudget download_budget(4, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+  FakeInstallManager install_manager(install_working_dir_, 2);
+  InstallAll(&download_budget, &install_manager, 3);
+
+  EXPECT_EQ(3, install_manager.num_installs());
+  EXPECT_TRUE(install_manager.IsInstalledBefore(apps_[0], apps_[2]));
+  EXPECT_FALSE(install_manager.IsInstalledBefore(apps_[0], apps_[1]));
+}
+
+// The installers of apps which conflict with all the other apps of the bundle
+// never run at the same time as another installer, so they keep the registry
+// stable state lock.
+TEST_F(BundleInstallPlanTest, ConflictingApps_AreNotInstalledConcurrently) {
+  CreateApps(3);
+  AddPackage(0, _T("first.msi"), _T("hash0"));
+  AddPackage(1, _T("second.msi"), _T("hash1"));
+  AddPackage(2, _T("third.msi"), _T("hash2"));
+
+  DownloadBudget download_budget(4, 0);
+  ASSERT_SUCCEEDED(download_budget.Initialize());
+  FakeInstallManager install_manager(install_working_dir_, 1);
+  InstallAll(&download_budget, &install_manager, 3);
+
+  EXPECT_EQ(3, install_manager.num_installs());
+  EXPECT_EQ(1, install_manager.max_active_installs());
+  for (size_t i = 0; i != apps_.size(); ++i) {
+    EXPECT_FALSE(install_manager.IsInstalledConcurrently(apps_[i]));
+  }
+}
+
+}  // namespace omaha
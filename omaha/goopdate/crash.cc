@@ -43,6 +43,8 @@
 #include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
+#include "omaha/base/string.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/base/time.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
@@ -53,21 +55,29 @@
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/common/lang.h"
 #include "omaha/common/stats_uploader.h"
+#include "omaha/goopdate/crash_upload.h"
 #include "omaha/goopdate/goopdate_metrics.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 #include "third_party/breakpad/src/client/windows/crash_generation/client_info.h"
-#include "third_party/breakpad/src/client/windows/sender/crash_report_sender.h"
-
-using google_breakpad::CrashReportSender;
-using google_breakpad::ReportResult;
 
 namespace omaha {
 
+namespace {
+
+const TCHAR kCrashIndexFilename[] = _T("crash_index");
+
+// The parameter which carries the number of duplicates of a crash which were
+// not uploaded since the previous upload of the crash.
+const TCHAR kDuplicateCountParameter[] = _T("dup_count");
+
+}  // namespace
+
 const TCHAR* const CrashReporter::kDefaultProductName =
     SHORT_COMPANY_NAME _T(" Error Reporting");
 
 CrashReporter::CrashReporter()
   : is_machine_(false),
+    upload_transport_(new HttpCrashUploadTransport),
     crash_report_url_(kUrlCrashReport),
     max_reports_per_day_(INT_MAX) {
 }
@@ -82,14 +92,25 @@ HRESULT CrashReporter::Initialize(bool is_machine) {
   ASSERT1(!crash_dir_.IsEmpty());
   CORE_LOG(L2, (_T("[crash dir %s]"), crash_dir_));
 
-  // The checkpoint file maintains state information for the crash report
-  // client, such as the number of reports per day successfully sent.
-  checkpoint_file_ = ConcatenatePath(crash_dir_, _T("checkpoint"));
-  if (checkpoint_file_.IsEmpty()) {
+  // The crash index keeps the crashes being reported, and the crashes
+  // uploaded in the last day, which are used to meter the uploads and to
+  // recognize the duplicate crashes.
+  crash_index_file_ = ConcatenatePath(crash_dir_, kCrashIndexFilename);
+  if (crash_index_file_.IsEmpty()) {
     return GOOPDATE_E_PATH_APPEND_FAILED;
   }
 
-  return S_OK;
+  NamedObjectAttributes lock_attr;
+  GetNamedObjectAttributes(kCrashIndexSerializer, is_machine, &lock_attr);
+  if (!crash_index_lock_.InitializeWithSecAttr(lock_attr.name,
+                                               &lock_attr.sa)) {
+    hr = HRESULTFromLastError();
+    CORE_LOG(LE, (_T("[failed to create the crash index lock][%#08x]"), hr));
+    return hr;
+  }
+
+  __mutexScope(crash_index_lock_);
+  return crash_index_.Load(crash_index_file_);
 }
 
 
@@ -97,6 +118,13 @@ HRESULT CrashReporter::Report(const CString& crash_filename,
                               const CString& custom_info_filename) {
   ASSERT1(!crash_dir_.IsEmpty());
 
+  // Another process may have reported crashes since the index was loaded.
+  __mutexBlock(crash_index_lock_) {
+    VERIFY_SUCCEEDED(crash_index_.Load(crash_index_file_));
+    crash_index_.AddPendingCrash(crash_filename, GetCurrent100NSTime());
+    VERIFY_SUCCEEDED(crash_index_.Save());
+  }
+
   ConfigManager* cm = ConfigManager::Instance();
   const bool can_upload_omaha_crashes =
       cm->CanCollectStats(is_machine_) && cm->CanUseNetwork(is_machine_);
@@ -163,7 +191,11 @@ HRESULT CrashReporter::Report(const CString& crash_filename,
   if (is_out_of_process) {
     ::DeleteFile(custom_info_filename);
   }
-  CleanStaleCrashes();
+  __mutexBlock(crash_index_lock_) {
+    VERIFY_SUCCEEDED(crash_index_.Load(crash_index_file_));
+    crash_index_.RemovePendingCrash(crash_filename);
+    CleanStaleCrashes();
+  }
 
   return hr;
 }
@@ -172,23 +204,8 @@ HRESULT CrashReporter::ReadCustomInfoFile(const CString& custom_info_filename,
                                           ParameterMap* parameters) {
   ASSERT1(!custom_info_filename.IsEmpty());
   ASSERT1(parameters);
-  parameters->clear();
 
-  std::map<CString, CString> parameters_temp;
-  HRESULT hr = goopdate_utils::ReadNameValuePairsFromFile(
-      custom_info_filename,
-      kCustomClientInfoGroup,
-      &parameters_temp);
-  if (FAILED(hr)) {
-    return hr;
-  }
-
-  std::map<CString, CString>::const_iterator iter;
-  for (iter = parameters_temp.begin(); iter != parameters_temp.end(); ++iter) {
-    (*parameters)[iter->first.GetString()] = iter->second.GetString();
-  }
-
-  return S_OK;
+  return ReadCrashCustomInfo(custom_info_filename, parameters);
 }
 
 void CrashReporter::BuildParametersFromGoopdate(ParameterMap* parameters) {
@@ -241,56 +258,90 @@ HRESULT CrashReporter::UploadCrash(bool is_out_of_process,
   ASSERT1(report_id);
   report_id->Empty();
 
-  // Calling this avoids crashes in WinINet. See: http://b/1258692
-  EnsureRasmanLoaded();
-
   ASSERT1(!crash_dir_.IsEmpty());
-  ASSERT1(!checkpoint_file_.IsEmpty());
+  ASSERT1(upload_transport_.get());
 
-  // Do best effort to send the crash. If it can't communicate with the backend,
-  // it retries a few times over a few hours time interval.
-  HRESULT hr = S_OK;
-  for (int i = 0; i != kCrashReportAttempts; ++i) {
-    std::wstring report_code;
-    CrashReportSender sender(checkpoint_file_.GetString());
-    sender.set_max_reports_per_day(max_reports_per_day_);
-    OPT_LOG(L2, (_T("[Uploading crash report]")
-                 _T("[%s][%s]"), crash_report_url_, crash_filename));
-    ASSERT1(!crash_report_url_.IsEmpty());
-    std::map<std::wstring, std::wstring> crash_files;
-    crash_files[L"upload_file_minidump"] = crash_filename.GetString();
-    ReportResult res = sender.SendCrashReport(crash_report_url_.GetString(),
-                                              parameters,
-                                              crash_files,
-                                              &report_code);
-    switch (res) {
-      case google_breakpad::RESULT_SUCCEEDED:
-        report_id->SetString(report_code.c_str());
-        hr = S_OK;
-        break;
+  // The crashes without a signature, for instance because the minidump has
+  // no exception, are always uploaded.
+  CString signature;
+  HRESULT hr = GetCrashSignature(crash_filename, parameters, &signature);
+  if (FAILED(hr)) {
+    OPT_LOG(L2, (_T("[GetCrashSignature failed][%#08x]"), hr));
+  }
 
-      case google_breakpad::RESULT_FAILED:
-        OPT_LOG(L2, (_T("[Crash report failed but it will retry sending]")));
-        ::Sleep(kCrashReportResendPeriodMs);
-        hr = E_FAIL;
-        break;
+  const time64 now = GetCurrent100NSTime();
+  bool is_duplicate = false;
+  int upload_count = 0;
+  int duplicate_count = 0;
+  __mutexBlock(crash_index_lock_) {
+    VERIFY_SUCCEEDED(crash_index_.Load(crash_index_file_));
+    is_duplicate = !signature.IsEmpty() &&
+                   crash_index_.RecordDuplicate(signature, now);
+    if (is_duplicate) {
+      VERIFY_SUCCEEDED(crash_index_.Save());
+    }
+    upload_count = crash_index_.GetUploadCountInLastDay(now);
+    duplicate_count = crash_index_.GetDuplicateCount(signature);
+  }
 
-      case google_breakpad::RESULT_REJECTED:
-        hr = GOOPDATE_E_CRASH_REJECTED;
-        break;
+  if (is_duplicate) {
+    OPT_LOG(L2, (_T("[Crash is a duplicate][%s]"), signature));
+    uint64 crash_file_size = 0;
+    File crash_file;
+    if (SUCCEEDED(crash_file.OpenShareMode(crash_filename, false, false,
+                                           FILE_SHARE_READ)) &&
+        SUCCEEDED(crash_file.GetLength64(&crash_file_size))) {
+      metric_crash_upload_bytes_saved += static_cast<int64>(crash_file_size);
+    }
+    hr = GOOPDATE_E_CRASH_DUPLICATE;
+  } else if (upload_count >= max_reports_per_day_) {
+    hr = GOOPDATE_E_CRASH_THROTTLED;
+  } else {
+    ParameterMap upload_parameters(parameters);
+    if (duplicate_count) {
+      upload_parameters[kDuplicateCountParameter] =
+          itostr(duplicate_count).GetString();
+    }
 
-      case google_breakpad::RESULT_THROTTLED:
-        hr = GOOPDATE_E_CRASH_THROTTLED;
+    // Do best effort to send the crash. If it can't communicate with the
+    // backend, it retries a few times over a few hours time interval.
+    for (int i = 0; i != kCrashReportAttempts; ++i) {
+      OPT_LOG(L2, (_T("[Uploading crash report]")
+                   _T("[%s][%s]"), crash_report_url_, crash_filename));
+      ASSERT1(!crash_report_url_.IsEmpty());
+      uint64 body_length = 0;
+      uint64 bytes_sent = 0;
+      hr = SendCrashUpload(upload_transport_.get(),
+                           crash_report_url_,
+                           upload_parameters,
+                           crash_filename,
+                           report_id,
+                           &body_length,
+                           &bytes_sent);
+      metric_crash_upload_bytes_sent += static_cast<int64>(bytes_sent);
+      if (SUCCEEDED(hr)) {
+        if (body_length > bytes_sent) {
+          metric_crash_upload_bytes_saved +=
+              static_cast<int64>(body_length - bytes_sent);
+        }
+        // The index is loaded again, since the other processes may have
+        // changed it while the crash was uploaded.
+        __mutexBlock(crash_index_lock_) {
+          VERIFY_SUCCEEDED(crash_index_.Load(crash_index_file_));
+          crash_index_.RecordUpload(signature, GetCurrent100NSTime());
+          VERIFY_SUCCEEDED(crash_index_.Save());
+        }
         break;
+      }
 
-      default:
-        hr = E_FAIL;
+      // Continue the retry loop only when it could not contact the server.
+      if (hr != E_FAIL) {
         break;
-    }
-
-    // Continue the retry loop only when it could not contact the server.
-    if (res != google_breakpad::RESULT_FAILED) {
-      break;
+      }
+      if (i + 1 != kCrashReportAttempts) {
+        OPT_LOG(L2, (_T("[Crash report failed but it will retry sending]")));
+        ::Sleep(kCrashReportResendPeriodMs);
+      }
     }
   }
 
@@ -348,6 +399,22 @@ HRESULT CrashReporter::SaveLastCrash(const CString& crash_filename,
 HRESULT CrashReporter::CleanStaleCrashes() {
   CORE_LOG(L3, (_T("[Crash::CleanStaleCrashes]")));
 
+  // The crashes which were not reported, for instance because the process
+  // exited while uploading the crash, are in the index.
+  time64 now = GetCurrent100NSTime();
+  std::vector<CString> stale_crash_files;
+  crash_index_.RemoveStalePendingCrashes(now, &stale_crash_files);
+  for (size_t i = 0; i != stale_crash_files.size(); ++i) {
+    CORE_LOG(L3, (_T("[deleting stale crash file][%s]"),
+                  stale_crash_files[i]));
+    ::DeleteFile(stale_crash_files[i]);
+  }
+
+  if (!crash_index_.IsFullScanDue(now)) {
+    return crash_index_.Save();
+  }
+  crash_index_.set_last_full_scan_time(now);
+
   // ??- sequence is a c++ trigraph corresponding to a ~. Escape it.
   const TCHAR kWildCards[] = _T("???????\?-???\?-???\?-???\?-????????????.dmp");
   std::vector<CString> crash_files;
@@ -357,7 +424,6 @@ HRESULT CrashReporter::CleanStaleCrashes() {
     return hr;
   }
 
-  time64 now = GetCurrent100NSTime();
   for (size_t i = 0; i != crash_files.size(); ++i) {
     CORE_LOG(L3, (_T("[found crash file][%s]"), crash_files[i]));
     FILETIME creation_time = {0};
@@ -374,7 +440,7 @@ HRESULT CrashReporter::CleanStaleCrashes() {
     }
   }
 
-  return S_OK;
+  return crash_index_.Save();
 }
 
 // static
@@ -459,6 +525,14 @@ void CrashReporter::UpdateCrashUploadMetrics(bool is_out_of_process,
       }
       break;
 
+    case GOOPDATE_E_CRASH_DUPLICATE:
+      if (is_out_of_process) {
+        ++metric_oop_crashes_duplicate;
+      } else {
+        ++metric_crashes_duplicate;
+      }
+      break;
+
     default:
       ASSERT1(false);
       break;
@@ -21,9 +21,12 @@
 #include <atlsecurity.h>
 #include <atlstr.h>
 #include <map>
+#include <memory>
 #include "base/basictypes.h"
 #include "gtest/gtest_prod.h"
+#include "omaha/base/synchronized.h"
 #include "omaha/common/const_goopdate.h"
+#include "omaha/goopdate/crash_upload.h"
 #include "third_party/breakpad/src/client/windows/crash_generation/client_info.h"
 #include "third_party/breakpad/src/client/windows/crash_generation/crash_generation_server.h"
 
@@ -32,7 +35,7 @@ namespace omaha {
 // TODO(omaha): refactor so this is not a static class.
 class CrashReporter {
  public:
-  typedef std::map<std::wstring, std::wstring> ParameterMap;
+  typedef CrashParameters ParameterMap;
 
   CrashReporter();
 
@@ -77,7 +80,9 @@ class CrashReporter {
                             CString* report_id);
 
   // Uploads the crash, logs the result of the crash upload, and updates
-  // the crash metrics.
+  // the crash metrics. A crash which was uploaded in the last day is not
+  // uploaded again. It is counted instead, and the count is sent with the
+  // next upload of the crash.
   HRESULT UploadCrash(bool is_out_of_process,
                       const CString& crash_filename,
                       const ParameterMap& parameters,
@@ -88,7 +93,9 @@ class CrashReporter {
                         const CString& product_name);
 
   // Cleans up stale crashes from the crash dir. Curently, crashes older than
-  // 1 day are deleted.
+  // 1 day are deleted. The crashes which were not reported are found in the
+  // crash index, and the crash dir is scanned only once a day. The caller
+  // holds |crash_index_lock_| and has loaded the index.
   HRESULT CleanStaleCrashes();
 
   // Logs an entry in the Windows Event Log for the specified source.
@@ -116,7 +123,14 @@ class CrashReporter {
 
   bool is_machine_;
   CString crash_dir_;
-  CString checkpoint_file_;
+  CString crash_index_file_;
+
+  // The index is shared by the processes which report crashes. It is loaded,
+  // changed, and saved under |crash_index_lock_|, which is not held while the
+  // crashes are uploaded.
+  GLock crash_index_lock_;
+  CrashIndex crash_index_;
+  std::unique_ptr<CrashUploadTransport> upload_transport_;
   CString crash_report_url_;
   int max_reports_per_day_;
 
@@ -128,6 +142,7 @@ class CrashReporter {
   static const TCHAR* const kDefaultProductName;
 
   friend class CrashReporterTest;
+  friend class CrashUploadTest;
 
   FRIEND_TEST(CrashReporterTest, CleanStaleCrashes);
   FRIEND_TEST(CrashReporterTest, GetProductName);
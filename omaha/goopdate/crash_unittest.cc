@@ -260,13 +260,47 @@ TEST_F(CrashReporterTest, CleanStaleCrashes) {
   reporter_.CleanStaleCrashes();
   EXPECT_TRUE(File::Exists(crash_file));
 
-  // Create a time value 25 hours in the past. Expect the crash file is deleted.
+  // Create a time value 25 hours in the past. Expect the crash file remains,
+  // since the crash dir is scanned once a day.
   Time64ToFileTime(now - 25 * kHoursTo100ns, &time_created);
   EXPECT_HRESULT_SUCCEEDED(File::SetFileTime(crash_file, &time_created,
                                              NULL, NULL));
   reporter_.CleanStaleCrashes();
+  EXPECT_TRUE(File::Exists(crash_file));
+
+  // A day later, expect the crash file is deleted.
+  reporter_.crash_index_.set_last_full_scan_time(now - 25 * kHoursTo100ns);
+  reporter_.CleanStaleCrashes();
   EXPECT_FALSE(File::Exists(crash_file));
 }
 
+TEST_F(CrashReporterTest, CleanStaleCrashes_PendingCrashes) {
+  CString test_file;
+  test_file.AppendFormat(_T("%s\\unittest_support\\%s"),
+                         module_dir_, kMiniDumpFilename);
+  CString crash_file;
+  crash_file.AppendFormat(_T("%s\\%s"), reporter_.crash_dir_, _T("a.dmp"));
+  EXPECT_TRUE(::CopyFile(test_file, crash_file, false));
+
+  // The crash file does not match the pattern of the scan, so it is found
+  // only through the index.
+  const time64 now = GetCurrent100NSTime();
+  reporter_.crash_index_.AddPendingCrash(crash_file, now - 23 * kHoursTo100ns);
+  reporter_.CleanStaleCrashes();
+  EXPECT_TRUE(File::Exists(crash_file));
+  EXPECT_EQ(1, reporter_.crash_index_.num_pending_crashes());
+
+  reporter_.crash_index_.AddPendingCrash(crash_file, now - 25 * kHoursTo100ns);
+  reporter_.CleanStaleCrashes();
+  EXPECT_FALSE(File::Exists(crash_file));
+  EXPECT_EQ(0, reporter_.crash_index_.num_pending_crashes());
+
+  // The index was saved.
+  CrashIndex crash_index;
+  EXPECT_SUCCEEDED(crash_index.Load(reporter_.crash_index_file_));
+  EXPECT_EQ(0, crash_index.num_pending_crashes());
+  EXPECT_FALSE(crash_index.IsFullScanDue(now));
+}
+
 }  // namespace omaha
 
@@ -0,0 +1,688 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/crash_upload.h"
+
+#include <dbghelp.h>
+#include <string.h>
+#include <algorithm>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/path.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/security/sha256.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/goopdate_utils.h"
+#include "omaha/net/network_config.h"
+#include "omaha/net/network_request.h"
+
+namespace omaha {
+
+namespace {
+
+const char kMinidumpPartName[] = "upload_file_minidump";
+const char kBoundaryPrefix[] = "------------------------OmahaCrash";
+
+// The minidump is read and compressed 64KB at a time.
+const size_t kFileBufferSize = 64 * 1024;
+
+const TCHAR kIndexHeader[]       = _T("crash_index 1");
+const TCHAR kIndexScan[]         = _T("scan");
+const TCHAR kIndexPending[]      = _T("pending");
+const TCHAR kIndexUploaded[]     = _T("uploaded");
+const TCHAR kIndexTempSuffix[]   = _T(".tmp");
+
+// The uploads with duplicates which were not reported yet are kept longer,
+// so that the count is sent when the crash happens again.
+const time64 kMaxDuplicateAge = 7 * kDaysTo100ns;
+
+bool IsOlderThan(time64 time, time64 now, time64 age) {
+  // The time is compared both ways in case the clock was set back.
+  return _abs64(static_cast<int64>(now - time)) >= static_cast<int64>(age);
+}
+
+// Returns the data of the first stream of |stream_type| in the minidump, or
+// NULL if the minidump has no such stream or is not valid.
+const uint8* FindMinidumpStream(const uint8* dump,
+                                size_t dump_size,
+                                ULONG32 stream_type,
+                                size_t* stream_size) {
+  ASSERT1(dump);
+  ASSERT1(stream_size);
+
+  if (dump_size < sizeof(MINIDUMP_HEADER)) {
+    return NULL;
+  }
+  const MINIDUMP_HEADER* header =
+      reinterpret_cast<const MINIDUMP_HEADER*>(dump);
+  if (header->Signature != MINIDUMP_SIGNATURE ||
+      static_cast<uint64>(header->StreamDirectoryRva) +
+      static_cast<uint64>(header->NumberOfStreams) *
+          sizeof(MINIDUMP_DIRECTORY) > dump_size) {
+    return NULL;
+  }
+
+  const MINIDUMP_DIRECTORY* directory =
+      reinterpret_cast<const MINIDUMP_DIRECTORY*>(
+          dump + header->StreamDirectoryRva);
+  for (ULONG32 i = 0; i != header->NumberOfStreams; ++i) {
+    if (directory[i].StreamType != stream_type) {
+      continue;
+    }
+    const MINIDUMP_LOCATION_DESCRIPTOR& location = directory[i].Location;
+    if (static_cast<uint64>(location.Rva) + location.DataSize > dump_size) {
+      return NULL;
+    }
+    *stream_size = location.DataSize;
+    return dump + location.Rva;
+  }
+  return NULL;
+}
+
+// Returns the file name of the module which contains |address|, and the
+// offset of the address in the module.
+bool FindMinidumpModule(const uint8* dump,
+                        size_t dump_size,
+                        uint64 address,
+                        CString* module_name,
+                        uint64* offset) {
+  ASSERT1(module_name);
+  ASSERT1(offset);
+
+  size_t stream_size = 0;
+  const uint8* stream = FindMinidumpStream(dump,
+                                           dump_size,
+                                           ModuleListStream,
+                                           &stream_size);
+  if (!stream || stream_size < sizeof(ULONG32)) {
+    return false;
+  }
+  const MINIDUMP_MODULE_LIST* module_list =
+      reinterpret_cast<const MINIDUMP_MODULE_LIST*>(stream);
+  if (sizeof(ULONG32) + static_cast<uint64>(module_list->NumberOfModules) *
+                        sizeof(MINIDUMP_MODULE) > stream_size) {
+    return false;
+  }
+
+  for (ULONG32 i = 0; i != module_list->NumberOfModules; ++i) {
+    const MINIDUMP_MODULE& module = module_list->Modules[i];
+    if (address < module.BaseOfImage ||
+        address >= module.BaseOfImage + module.SizeOfImage) {
+      continue;
+    }
+
+    if (static_cast<uint64>(module.ModuleNameRva) + sizeof(ULONG32) >
+        dump_size) {
+      return false;
+    }
+    const MINIDUMP_STRING* name =
+        reinterpret_cast<const MINIDUMP_STRING*>(dump + module.ModuleNameRva);
+    if (static_cast<uint64>(module.ModuleNameRva) + sizeof(ULONG32) +
+        name->Length > dump_size) {
+      return false;
+    }
+    const CString path(name->Buffer,
+                       static_cast<int>(name->Length / sizeof(WCHAR)));
+    *module_name = GetFileFromPath(path);
+    module_name->MakeLower();
+    *offset = address - module.BaseOfImage;
+    return true;
+  }
+  return false;
+}
+
+CString FindParameter(const CrashParameters& parameters, const TCHAR* name) {
+  CrashParameters::const_iterator it = parameters.find(name);
+  return it != parameters.end() ? CString(it->second.c_str()) : CString();
+}
+
+}  // namespace
+
+HRESULT ReadCrashCustomInfo(const CString& custom_info_filename,
+                            CrashParameters* parameters) {
+  ASSERT1(!custom_info_filename.IsEmpty());
+  ASSERT1(parameters);
+  parameters->clear();
+
+  std::map<CString, CString> pairs;
+  HRESULT hr = goopdate_utils::ReadNameValuePairsFromFile(
+      custom_info_filename, kCustomClientInfoGroup, &pairs);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (std::map<CString, CString>::const_iterator it = pairs.begin();
+       it != pairs.end();
+       ++it) {
+    (*parameters)[it->first.GetString()] = it->second.GetString();
+  }
+  return S_OK;
+}
+
+HRESULT GetCrashSignature(const CString& crash_filename,
+                          const CrashParameters& parameters,
+                          CString* signature) {
+  ASSERT1(signature);
+  signature->Empty();
+
+  File file;
+  HRESULT hr = file.OpenWithAccessPattern(crash_filename,
+                                          false,
+                                          FILE_SHARE_READ,
+                                          File::RANDOM_ACCESS);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // The minidump is mapped, since only the exception and the module list are
+  // read, and they can be anywhere in the file.
+  MappedFileView view;
+  hr = view.Map(&file, 0, 0);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (!view.data()) {
+    return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+  }
+
+  size_t stream_size = 0;
+  const uint8* stream = FindMinidumpStream(view.data(),
+                                           view.length(),
+                                           ExceptionStream,
+                                           &stream_size);
+  if (!stream || stream_size < sizeof(MINIDUMP_EXCEPTION_STREAM)) {
+    return HRESULT_FROM_WIN32(ERROR_NOT_FOUND);
+  }
+  const MINIDUMP_EXCEPTION& exception =
+      reinterpret_cast<const MINIDUMP_EXCEPTION_STREAM*>(stream)->
+          ExceptionRecord;
+
+  // The address alone is not stable across runs of the program, because the
+  // modules load at random addresses. It is used only if it is not in a
+  // module.
+  CString module_name;
+  uint64 offset = exception.ExceptionAddress;
+  FindMinidumpModule(view.data(),
+                     view.length(),
+                     exception.ExceptionAddress,
+                     &module_name,
+                     &offset);
+
+  CString key;
+  SafeCStringFormat(&key, _T("%s|%s|0x%08x|%s+0x%I64x"),
+                    FindParameter(parameters, _T("prod")),
+                    FindParameter(parameters, _T("ver")),
+                    exception.ExceptionCode,
+                    module_name,
+                    offset);
+  const CStringA utf8_key(WideToUtf8(key));
+  uint8 digest[SHA256_DIGEST_SIZE] = {};
+  SHA256_hash(utf8_key.GetString(), utf8_key.GetLength(), digest);
+  *signature = BytesToHex(digest, arraysize(digest));
+
+  CORE_LOG(L3, (_T("[GetCrashSignature][%s][%s]"), key, *signature));
+  return S_OK;
+}
+
+CrashUploadBody::CrashUploadBody(const CrashParameters& parameters,
+                                 const CString& crash_filename)
+    : parameters_(parameters),
+      crash_filename_(crash_filename),
+      boundary_(kBoundaryPrefix),
+      is_file_open_(false),
+      part_(PART_DONE),
+      file_offset_(0),
+      encoded_offset_(0),
+      content_length_(0),
+      encoded_length_(0) {
+  CString guid;
+  if (SUCCEEDED(GetGuid(&guid))) {
+    guid.Remove(_T('{'));
+    guid.Remove(_T('}'));
+    boundary_ += WideToUtf8(guid);
+  }
+}
+
+CrashUploadBody::~CrashUploadBody() {
+}
+
+CString CrashUploadBody::GetContentType() const {
+  CString content_type;
+  SafeCStringFormat(&content_type,
+                    _T("multipart/form-data; boundary=%s"),
+                    CString(boundary_));
+  return content_type;
+}
+
+HRESULT CrashUploadBody::Rewind() {
+  if (!is_file_open_) {
+    HRESULT hr = file_.OpenWithAccessPattern(crash_filename_,
+                                             false,
+                                             FILE_SHARE_READ,
+                                             File::SEQUENTIAL_ACCESS);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[failed to open the crash][%s][%#08x]"),
+                    crash_filename_, hr));
+      return hr;
+    }
+    is_file_open_ = true;
+    file_buffer_.resize(kFileBufferSize);
+  }
+
+  HRESULT hr = encoder_.Initialize(CONTENT_ENCODING_GZIP);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  part_ = PART_PARAMETERS;
+  file_offset_ = 0;
+  encoded_.clear();
+  encoded_offset_ = 0;
+  content_length_ = 0;
+  encoded_length_ = 0;
+  return S_OK;
+}
+
+HRESULT CrashUploadBody::Read(void* buffer, size_t size, size_t* bytes_read) {
+  ASSERT1(buffer);
+  ASSERT1(bytes_read);
+  *bytes_read = 0;
+
+  // The encoder buffers its input, so a part may not produce any output.
+  while (encoded_offset_ == encoded_.size() && part_ != PART_DONE) {
+    encoded_.clear();
+    encoded_offset_ = 0;
+    HRESULT hr = EncodeNextPart();
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  const size_t bytes_to_copy = std::min(size,
+                                        encoded_.size() - encoded_offset_);
+  if (bytes_to_copy) {
+    memcpy(buffer, &encoded_.front() + encoded_offset_, bytes_to_copy);
+  }
+  encoded_offset_ += bytes_to_copy;
+  encoded_length_ += bytes_to_copy;
+  *bytes_read = bytes_to_copy;
+  return S_OK;
+}
+
+HRESULT CrashUploadBody::Encode(const void* buffer, size_t length) {
+  content_length_ += length;
+  return encoder_.Write(buffer, length, &encoded_);
+}
+
+HRESULT CrashUploadBody::EncodeNextPart() {
+  switch (part_) {
+    case PART_PARAMETERS: {
+      CStringA parameters;
+      for (CrashParameters::const_iterator it = parameters_.begin();
+           it != parameters_.end();
+           ++it) {
+        SafeCStringAAppendFormat(&parameters,
+            "--%s\r\n"
+            "Content-Disposition: form-data; name=\"%s\"\r\n\r\n"
+            "%s\r\n",
+            boundary_,
+            WideToUtf8(it->first.c_str()),
+            WideToUtf8(it->second.c_str()));
+      }
+      SafeCStringAAppendFormat(&parameters,
+          "--%s\r\n"
+          "Content-Disposition: form-data; name=\"%s\"; filename=\"%s\"\r\n"
+          "Content-Type: application/octet-stream\r\n\r\n",
+          boundary_,
+          kMinidumpPartName,
+          WideToUtf8(GetFileFromPath(crash_filename_)));
+      part_ = PART_MINIDUMP;
+      return Encode(parameters.GetString(), parameters.GetLength());
+    }
+
+    case PART_MINIDUMP: {
+      uint32 bytes_read = 0;
+      HRESULT hr = file_.ReadAt64(file_offset_,
+                                  &file_buffer_.front(),
+                                  static_cast<uint32>(file_buffer_.size()),
+                                  &bytes_read);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      if (!bytes_read) {
+        part_ = PART_END;
+        return S_OK;
+      }
+      file_offset_ += bytes_read;
+      return Encode(&file_buffer_.front(), bytes_read);
+    }
+
+    case PART_END: {
+      CStringA end;
+      SafeCStringAFormat(&end, "\r\n--%s--\r\n", boundary_);
+      part_ = PART_DONE;
+      HRESULT hr = Encode(end.GetString(), end.GetLength());
+      if (FAILED(hr)) {
+        return hr;
+      }
+      return encoder_.Finish(&encoded_);
+    }
+
+    case PART_DONE:
+    default:
+      ASSERT1(false);
+      return E_UNEXPECTED;
+  }
+}
+
+HRESULT HttpCrashUploadTransport::Post(const CString& url,
+                                       CrashUploadBody* body,
+                                       int* http_status_code,
+                                       std::vector<uint8>* response) {
+  ASSERT1(body);
+  ASSERT1(http_status_code);
+  ASSERT1(response);
+  *http_status_code = 0;
+
+  NetworkConfig* network_config = NULL;
+  NetworkConfigManager& network_manager = NetworkConfigManager::Instance();
+  HRESULT hr = network_manager.GetUserNetworkConfig(&network_config);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[GetUserNetworkConfig failed][%#08x]"), hr));
+    return hr;
+  }
+  NetworkRequest network_request(network_config->session());
+
+  // The body is sent from the stream, which the request rewinds each time it
+  // sends the body. The crash reporter retries the uploads itself.
+  SimpleRequest* simple_request(new SimpleRequest);
+  simple_request->set_request_stream(body);
+  network_request.AddHttpRequest(simple_request);
+  network_request.set_num_retries(0);
+  network_request.AddHeader(_T("Content-Type"), body->GetContentType());
+  network_request.AddHeader(kHeaderContentEncoding,
+                            ContentEncodingToString(CONTENT_ENCODING_GZIP));
+
+  hr = network_request.Post(url, NULL, 0, response);
+  *http_status_code = network_request.http_status_code();
+  return hr;
+}
+
+HRESULT SendCrashUpload(CrashUploadTransport* transport,
+                        const CString& url,
+                        const CrashParameters& parameters,
+                        const CString& crash_filename,
+                        CString* report_id,
+                        uint64* body_length,
+                        uint64* bytes_sent) {
+  ASSERT1(transport);
+  ASSERT1(report_id);
+  ASSERT1(body_length);
+  ASSERT1(bytes_sent);
+  report_id->Empty();
+
+  CrashUploadBody body(parameters, crash_filename);
+  int http_status_code = 0;
+  std::vector<uint8> response;
+  HRESULT hr = transport->Post(url, &body, &http_status_code, &response);
+  *body_length = body.content_length();
+  *bytes_sent = body.encoded_length();
+  OPT_LOG(L2, (_T("[SendCrashUpload][%#08x][%d][%I64u bytes][%I64u sent]"),
+               hr, http_status_code, *body_length, *bytes_sent));
+
+  if (SUCCEEDED(hr) && http_status_code == HTTP_STATUS_OK) {
+    if (!response.empty()) {
+      *report_id = Utf8ToWideChar(reinterpret_cast<const char*>(
+                                      &response.front()),
+                                  static_cast<uint32>(response.size()));
+      report_id->Trim();
+    }
+    return S_OK;
+  }
+
+  // Like the Breakpad sender, the client errors are rejections of the crash,
+  // and the other errors are failures to reach the server.
+  if (http_status_code >= HTTP_STATUS_BAD_REQUEST &&
+      http_status_code < HTTP_STATUS_SERVER_ERROR) {
+    return GOOPDATE_E_CRASH_REJECTED;
+  }
+  return E_FAIL;
+}
+
+CrashIndex::CrashIndex() : last_full_scan_time_(0) {
+}
+
+// The index is a UTF-8 text file, with one entry per line and the fields of
+// the entries separated by tabs:
+//   scan      <time>
+//   pending   <time>   <crash file>
+//   uploaded  <time>   <duplicate count>   <signature>
+HRESULT CrashIndex::Load(const CString& filename) {
+  ASSERT1(!filename.IsEmpty());
+
+  filename_ = filename;
+  last_full_scan_time_ = 0;
+  pending_crashes_.clear();
+  uploaded_crashes_.clear();
+
+  if (!File::Exists(filename)) {
+    return S_OK;
+  }
+
+  std::vector<uint8> buffer;
+  HRESULT hr = ReadEntireFileShareMode(filename, 0, FILE_SHARE_READ, &buffer);
+  if (FAILED(hr) || buffer.empty()) {
+    CORE_LOG(LW, (_T("[failed to read the crash index][%#08x]"), hr));
+    return S_OK;
+  }
+  const CString text(Utf8ToWideChar(
+      reinterpret_cast<const char*>(&buffer.front()),
+      static_cast<uint32>(buffer.size())));
+
+  int pos = 0;
+  if (text.Tokenize(_T("\n"), pos) != kIndexHeader) {
+    CORE_LOG(LW, (_T("[the crash index is not valid]")));
+    return S_OK;
+  }
+
+  for (CString line = text.Tokenize(_T("\n"), pos);
+       pos != -1;
+       line = text.Tokenize(_T("\n"), pos)) {
+    int field_pos = 0;
+    const CString type(line.Tokenize(_T("\t"), field_pos));
+    const time64 time = static_cast<time64>(
+        String_StringToInt64(line.Tokenize(_T("\t"), field_pos)));
+    if (type == kIndexScan) {
+      last_full_scan_time_ = time;
+    } else if (type == kIndexPending) {
+      PendingCrash pending_crash;
+      pending_crash.filename = line.Tokenize(_T("\t"), field_pos);
+      pending_crash.time = time;
+      if (!pending_crash.filename.IsEmpty()) {
+        pending_crashes_.push_back(pending_crash);
+      }
+    } else if (type == kIndexUploaded) {
+      UploadedCrash uploaded_crash;
+      uploaded_crash.time = time;
+      uploaded_crash.duplicate_count =
+          String_StringToInt(line.Tokenize(_T("\t"), field_pos));
+      if (field_pos != -1) {
+        uploaded_crash.signature = line.Tokenize(_T("\t"), field_pos);
+      }
+      uploaded_crashes_.push_back(uploaded_crash);
+    }
+  }
+
+  return S_OK;
+}
+
+// The index is written to a temporary file, which replaces the index, so that
+// the index is not truncated if the process exits while writing it. The name
+// of the temporary file is unique, so that the processes which save the index
+// do not write the same temporary file.
+HRESULT CrashIndex::Save() const {
+  ASSERT1(!filename_.IsEmpty());
+
+  CString text(kIndexHeader);
+  SafeCStringAppendFormat(&text, _T("\n%s\t%I64u"),
+                          kIndexScan, last_full_scan_time_);
+  for (size_t i = 0; i != pending_crashes_.size(); ++i) {
+    SafeCStringAppendFormat(&text, _T("\n%s\t%I64u\t%s"),
+                            kIndexPending,
+                            pending_crashes_[i].time,
+                            pending_crashes_[i].filename);
+  }
+  for (size_t i = 0; i != uploaded_crashes_.size(); ++i) {
+    SafeCStringAppendFormat(&text, _T("\n%s\t%I64u\t%d\t%s"),
+                            kIndexUploaded,
+                            uploaded_crashes_[i].time,
+                            uploaded_crashes_[i].duplicate_count,
+                            uploaded_crashes_[i].signature);
+  }
+  text += _T("\n");
+
+  std::vector<uint8> buffer;
+  WideToUtf8Vector(text, &buffer);
+
+  CString guid;
+  HRESULT hr = GetGuid(&guid);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  CString temp_filename;
+  SafeCStringFormat(&temp_filename, _T("%s.%s%s"),
+                    filename_, guid, kIndexTempSuffix);
+  hr = WriteEntireFile(temp_filename, buffer);
+  if (FAILED(hr)) {
+    ::DeleteFile(temp_filename);
+    CORE_LOG(LE, (_T("[failed to write the crash index][%#08x]"), hr));
+    return hr;
+  }
+  hr = File::Move(temp_filename, filename_, true);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[failed to replace the crash index][%#08x]"), hr));
+    ::DeleteFile(temp_filename);
+  }
+  return hr;
+}
+
+void CrashIndex::AddPendingCrash(const CString& crash_filename, time64 now) {
+  RemovePendingCrash(crash_filename);
+
+  PendingCrash pending_crash;
+  pending_crash.filename = crash_filename;
+  pending_crash.time = now;
+  pending_crashes_.push_back(pending_crash);
+}
+
+void CrashIndex::RemovePendingCrash(const CString& crash_filename) {
+  for (size_t i = 0; i != pending_crashes_.size();) {
+    if (!pending_crashes_[i].filename.CompareNoCase(crash_filename)) {
+      pending_crashes_.erase(pending_crashes_.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+void CrashIndex::RemoveStalePendingCrashes(time64 now,
+                                           std::vector<CString>* filenames) {
+  ASSERT1(filenames);
+
+  for (size_t i = 0; i != pending_crashes_.size();) {
+    if (IsOlderThan(pending_crashes_[i].time, now, kDaysTo100ns)) {
+      filenames->push_back(pending_crashes_[i].filename);
+      pending_crashes_.erase(pending_crashes_.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+bool CrashIndex::RecordDuplicate(const CString& signature, time64 now) {
+  ASSERT1(!signature.IsEmpty());
+
+  RemoveOldUploads(now);
+  for (size_t i = 0; i != uploaded_crashes_.size(); ++i) {
+    UploadedCrash& uploaded_crash = uploaded_crashes_[i];
+    if (uploaded_crash.signature == signature &&
+        !IsOlderThan(uploaded_crash.time, now, kDaysTo100ns)) {
+      ++uploaded_crash.duplicate_count;
+      return true;
+    }
+  }
+  return false;
+}
+
+int CrashIndex::GetDuplicateCount(const CString& signature) const {
+  for (size_t i = 0; i != uploaded_crashes_.size(); ++i) {
+    if (!signature.IsEmpty() &&
+        uploaded_crashes_[i].signature == signature) {
+      return uploaded_crashes_[i].duplicate_count;
+    }
+  }
+  return 0;
+}
+
+void CrashIndex::RecordUpload(const CString& signature, time64 now) {
+  RemoveOldUploads(now);
+  for (size_t i = 0; i != uploaded_crashes_.size();) {
+    if (!signature.IsEmpty() &&
+        uploaded_crashes_[i].signature == signature) {
+      uploaded_crashes_.erase(uploaded_crashes_.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+
+  UploadedCrash uploaded_crash;
+  uploaded_crash.signature = signature;
+  uploaded_crash.time = now;
+  uploaded_crash.duplicate_count = 0;
+  uploaded_crashes_.push_back(uploaded_crash);
+}
+
+int CrashIndex::GetUploadCountInLastDay(time64 now) const {
+  int count = 0;
+  for (size_t i = 0; i != uploaded_crashes_.size(); ++i) {
+    if (!IsOlderThan(uploaded_crashes_[i].time, now, kDaysTo100ns)) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+bool CrashIndex::IsFullScanDue(time64 now) const {
+  return IsOlderThan(last_full_scan_time_, now, kDaysTo100ns);
+}
+
+void CrashIndex::RemoveOldUploads(time64 now) {
+  for (size_t i = 0; i != uploaded_crashes_.size();) {
+    const UploadedCrash& uploaded_crash = uploaded_crashes_[i];
+    const time64 max_age = uploaded_crash.duplicate_count ? kMaxDuplicateAge :
+                                                            kDaysTo100ns;
+    if (IsOlderThan(uploaded_crash.time, now, max_age)) {
+      uploaded_crashes_.erase(uploaded_crashes_.begin() + i);
+    } else {
+      ++i;
+    }
+  }
+}
+
+}  // namespace omaha
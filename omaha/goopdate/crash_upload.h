@@ -0,0 +1,213 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// The upload of the crashes to the crash server. The minidump is sent in a
+// multipart/form-data body, which is compressed with gzip while it is sent,
+// so the minidump is never entirely in memory. A small index in the crash
+// directory tracks the crashes which are being reported, the signatures of
+// the crashes uploaded recently, and the times of the uploads.
+
+#ifndef OMAHA_GOOPDATE_CRASH_UPLOAD_H_
+#define OMAHA_GOOPDATE_CRASH_UPLOAD_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/file.h"
+#include "omaha/base/time.h"
+#include "omaha/net/content_encoding.h"
+#include "omaha/net/simple_request.h"
+
+namespace omaha {
+
+typedef std::map<std::wstring, std::wstring> CrashParameters;
+
+// Reads the parameters of a crash from the [ClientCustomData] section of a
+// custom info file written by crash_utils::CreateCustomInfoFile.
+HRESULT ReadCrashCustomInfo(const CString& custom_info_filename,
+                            CrashParameters* parameters);
+
+// Computes a signature which is the same for the duplicates of a crash: a
+// hash of the product, its version, the exception code, and the module and
+// the offset in the module of the exception address. Fails if the minidump
+// has no exception.
+HRESULT GetCrashSignature(const CString& crash_filename,
+                          const CrashParameters& parameters,
+                          CString* signature);
+
+// The body of a crash upload: a part for each parameter, then the minidump in
+// the "upload_file_minidump" part. The body is encoded with gzip as it is
+// read, and the minidump is read from the file as the body needs it.
+class CrashUploadBody : public RequestBodyStream {
+ public:
+  CrashUploadBody(const CrashParameters& parameters,
+                  const CString& crash_filename);
+  virtual ~CrashUploadBody();
+
+  // Returns the value of the Content-Type header of the body. The
+  // Content-Encoding of the body is always gzip.
+  CString GetContentType() const;
+
+  // Starts the body. Rewind must be called before the body is read.
+  virtual HRESULT Rewind();
+  virtual HRESULT Read(void* buffer, size_t size, size_t* bytes_read);
+
+  // The number of bytes of the body before and after the encoding, since the
+  // last Rewind.
+  uint64 content_length() const { return content_length_; }
+  uint64 encoded_length() const { return encoded_length_; }
+
+ private:
+  enum Part {
+    PART_PARAMETERS,
+    PART_MINIDUMP,
+    PART_END,
+    PART_DONE,
+  };
+
+  HRESULT Encode(const void* buffer, size_t length);
+  HRESULT EncodeNextPart();
+
+  const CrashParameters parameters_;
+  const CString crash_filename_;
+  CStringA boundary_;
+
+  File file_;
+  bool is_file_open_;
+  ContentEncoder encoder_;
+  Part part_;
+  uint64 file_offset_;
+  std::vector<uint8> file_buffer_;
+  std::vector<uint8> encoded_;
+  size_t encoded_offset_;
+  uint64 content_length_;
+  uint64 encoded_length_;
+
+  DISALLOW_COPY_AND_ASSIGN(CrashUploadBody);
+};
+
+// Sends the body of a crash upload to the crash server.
+class CrashUploadTransport {
+ public:
+  virtual ~CrashUploadTransport() {}
+
+  virtual HRESULT Post(const CString& url,
+                       CrashUploadBody* body,
+                       int* http_status_code,
+                       std::vector<uint8>* response) = 0;
+};
+
+// Sends the body with the chunked transfer encoding, over WinHttp, with the
+// network configurations of the user.
+class HttpCrashUploadTransport : public CrashUploadTransport {
+ public:
+  HttpCrashUploadTransport() {}
+
+  virtual HRESULT Post(const CString& url,
+                       CrashUploadBody* body,
+                       int* http_status_code,
+                       std::vector<uint8>* response);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(HttpCrashUploadTransport);
+};
+
+// Uploads a crash with |transport|. Returns S_OK and the id of the report if
+// the crash server accepted the crash, GOOPDATE_E_CRASH_REJECTED if it
+// rejected the crash, and E_FAIL if the crash server could not be reached.
+// |body_length| and |bytes_sent| receive the number of bytes of the body,
+// before and after the compression.
+HRESULT SendCrashUpload(CrashUploadTransport* transport,
+                        const CString& url,
+                        const CrashParameters& parameters,
+                        const CString& crash_filename,
+                        CString* report_id,
+                        uint64* body_length,
+                        uint64* bytes_sent);
+
+// The index of the crash directory. The crashes are added to the index when
+// they are received and removed when they have been reported, so the crashes
+// left behind, for instance by a crash handler which exited during an
+// upload, are found without scanning the directory. The index also counts the
+// duplicates of the crashes uploaded in the last day, and the uploads in the
+// last day, which are metered.
+class CrashIndex {
+ public:
+  CrashIndex();
+
+  // Loads the index from |filename|. The index is empty if the file does not
+  // exist or is not valid.
+  HRESULT Load(const CString& filename);
+  HRESULT Save() const;
+
+  void AddPendingCrash(const CString& crash_filename, time64 now);
+  void RemovePendingCrash(const CString& crash_filename);
+
+  // Removes the crashes which were added more than a day ago, and returns
+  // their files.
+  void RemoveStalePendingCrashes(time64 now, std::vector<CString>* filenames);
+
+  // Returns true and counts a duplicate if a crash with |signature| was
+  // uploaded in the last day.
+  bool RecordDuplicate(const CString& signature, time64 now);
+
+  // Returns the number of duplicates of |signature| which were not uploaded
+  // since the last upload of the crash.
+  int GetDuplicateCount(const CString& signature) const;
+
+  // Records an upload of a crash, which resets the count of its duplicates.
+  // |signature| is empty if the crash has no signature.
+  void RecordUpload(const CString& signature, time64 now);
+
+  int GetUploadCountInLastDay(time64 now) const;
+
+  // The directory is scanned once a day for the crashes which are not in the
+  // index, such as the crashes left behind by older versions.
+  bool IsFullScanDue(time64 now) const;
+  void set_last_full_scan_time(time64 time) { last_full_scan_time_ = time; }
+
+  size_t num_pending_crashes() const { return pending_crashes_.size(); }
+
+ private:
+  struct PendingCrash {
+    CString filename;
+    time64 time;
+  };
+
+  struct UploadedCrash {
+    CString signature;
+    time64 time;
+    int duplicate_count;
+  };
+
+  // Removes the uploads older than a day, except the ones with duplicates to
+  // report, which are kept for a week.
+  void RemoveOldUploads(time64 now);
+
+  CString filename_;
+  time64 last_full_scan_time_;
+  std::vector<PendingCrash> pending_crashes_;
+  std::vector<UploadedCrash> uploaded_crashes_;
+
+  DISALLOW_COPY_AND_ASSIGN(CrashIndex);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_CRASH_UPLOAD_H_
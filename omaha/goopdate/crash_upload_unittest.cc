@@ -0,0 +1,708 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/crash_upload.h"
+
+#include <windows.h>
+#include <dbghelp.h>
+#include <winhttp.h>
+#include <map>
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/const_addresses.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/string.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/goopdate_utils.h"
+#include "omaha/goopdate/crash.h"
+#include "omaha/net/content_encoding.h"
+#include "omaha/testing/local_http_server.h"
+#include "omaha/testing/unit_test.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR kCustomInfoFilename[] = _T("minidump.txt");
+
+const size_t kMaxDecodedLength = 64 * 1024 * 1024;
+
+// The exceptions of the minidumps of the tests happen in these functions.
+void FirstCrashFunction() {}
+void SecondCrashFunction() {}
+
+// Writes a minidump of the current process, with an exception of
+// |exception_code| at |exception_address|, like the minidumps written by the
+// crash handler.
+void WriteMinidumpWithException(const CString& filename,
+                                DWORD exception_code,
+                                void* exception_address) {
+  CONTEXT context = {};
+  ::RtlCaptureContext(&context);
+  EXCEPTION_RECORD exception_record = {};
+  exception_record.ExceptionCode = exception_code;
+  exception_record.ExceptionAddress = exception_address;
+  EXCEPTION_POINTERS exception_pointers = {&exception_record, &context};
+
+  MINIDUMP_EXCEPTION_INFORMATION exception_information = {};
+  exception_information.ThreadId = ::GetCurrentThreadId();
+  exception_information.ExceptionPointers = &exception_pointers;
+  exception_information.ClientPointers = FALSE;
+
+  scoped_hfile file(::CreateFile(filename, GENERIC_WRITE, 0, NULL,
+                                 CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL));
+  ASSERT_TRUE(valid(file));
+  ASSERT_TRUE(::MiniDumpWriteDump(::GetCurrentProcess(),
+                                  ::GetCurrentProcessId(),
+                                  get(file),
+                                  MiniDumpNormal,
+                                  &exception_information,
+                                  NULL,
+                                  NULL));
+}
+
+std::vector<uint8> ReadFile(const CString& filename) {
+  std::vector<uint8> buffer;
+  EXPECT_SUCCEEDED(ReadEntireFileShareMode(filename,
+                                           0,
+                                           FILE_SHARE_READ,
+                                           &buffer));
+  return buffer;
+}
+
+CStringA ToString(const std::vector<uint8>& buffer) {
+  return buffer.empty() ?
+      CStringA() :
+      CStringA(reinterpret_cast<const char*>(&buffer.front()),
+               static_cast<int>(buffer.size()));
+}
+
+// Keeps the content of each field of the form, by name, like the crash
+// server does.
+void ParseForm(const CStringA& boundary,
+               const CStringA& form,
+               std::map<CString, CStringA>* fields) {
+  ASSERT1(fields);
+  fields->clear();
+
+  const CStringA delimiter("--" + boundary);
+  EXPECT_EQ(0, form.Find(delimiter));
+  EXPECT_EQ(form.GetLength() - delimiter.GetLength() - 4,
+            form.Find(delimiter + "--\r\n"));
+
+  int pos = delimiter.GetLength() + 2;
+  for (int end = form.Find("\r\n" + delimiter, pos);
+       end != -1;
+       pos = end + delimiter.GetLength() + 4,
+       end = form.Find("\r\n" + delimiter, pos)) {
+    const int headers_end = form.Find("\r\n\r\n", pos);
+    EXPECT_LT(pos, headers_end);
+    EXPECT_LT(headers_end, end);
+    const CStringA headers(form.Mid(pos, headers_end - pos));
+    const int name_pos = headers.Find("name=\"") + 6;
+    const CStringA name(
+        headers.Mid(name_pos, headers.Find('"', name_pos) - name_pos));
+    (*fields)[CString(name)] = form.Mid(headers_end + 4,
+                                        end - headers_end - 4);
+  }
+}
+
+}  // namespace
+
+// A local stand-in for the crash server. It reads the body of the upload in
+// small parts, as WinHttp sends it, decodes it, and parses the form like the
+// crash server does. The body is read twice, as when a proxy asks for
+// authentication, to check that the body starts over when it is rewound.
+class LocalCrashServer : public CrashUploadTransport {
+ public:
+  LocalCrashServer()
+      : http_status_code_(HTTP_STATUS_OK),
+        num_uploads_(0),
+        num_bytes_received_(0) {}
+
+  virtual HRESULT Post(const CString& url,
+                       CrashUploadBody* body,
+                       int* http_status_code,
+                       std::vector<uint8>* response) {
+    EXPECT_STREQ(kUrlCrashReport, url);
+    EXPECT_TRUE(body);
+    EXPECT_TRUE(http_status_code);
+    EXPECT_TRUE(response);
+
+    const CString kContentTypePrefix(_T("multipart/form-data; boundary="));
+    const CString content_type(body->GetContentType());
+    EXPECT_EQ(0, content_type.Find(kContentTypePrefix));
+    const CStringA boundary(content_type.Mid(kContentTypePrefix.GetLength()));
+
+    std::vector<uint8> encoded;
+    HRESULT hr = ReadBody(body, &encoded);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    std::vector<uint8> encoded_again;
+    EXPECT_SUCCEEDED(ReadBody(body, &encoded_again));
+    EXPECT_TRUE(encoded == encoded_again);
+
+    ++num_uploads_;
+    num_bytes_received_ += encoded.size();
+
+    std::vector<uint8> decoded;
+    EXPECT_SUCCEEDED(DecodeContent(CONTENT_ENCODING_GZIP,
+                                   &encoded.front(),
+                                   encoded.size(),
+                                   kMaxDecodedLength,
+                                   &decoded));
+    EXPECT_EQ(decoded.size(), body->content_length());
+    ParseForm(boundary, ToString(decoded), &fields_);
+
+    *http_status_code = http_status_code_;
+    CStringA report_id;
+    SafeCStringAFormat(&report_id, "report%d\r\n", num_uploads_);
+    response->assign(report_id.GetString(),
+                     report_id.GetString() + report_id.GetLength());
+    return S_OK;
+  }
+
+  void set_http_status_code(int http_status_code) {
+    http_status_code_ = http_status_code;
+  }
+
+  int num_uploads() const { return num_uploads_; }
+  size_t num_bytes_received() const { return num_bytes_received_; }
+  const std::map<CString, CStringA>& fields() const { return fields_; }
+
+ private:
+  static HRESULT ReadBody(CrashUploadBody* body, std::vector<uint8>* encoded) {
+    HRESULT hr = body->Rewind();
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    uint8 buffer[1000] = {};
+    size_t bytes_read = 0;
+    do {
+      hr = body->Read(buffer, arraysize(buffer), &bytes_read);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      encoded->insert(encoded->end(), buffer, buffer + bytes_read);
+    } while (bytes_read);
+
+    EXPECT_EQ(encoded->size(), body->encoded_length());
+    return S_OK;
+  }
+
+  int http_status_code_;
+  int num_uploads_;
+  size_t num_bytes_received_;
+  std::map<CString, CStringA> fields_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalCrashServer);
+};
+
+// A crash server which listens on the loopback interface, for the uploads
+// through HttpCrashUploadTransport. It reads the chunked body of the upload
+// as WinHttp sends it, decodes it, and parses the form.
+class LocalHttpCrashServer : public LocalHttpServer {
+ public:
+  LocalHttpCrashServer()
+      : is_chunked_(false),
+        num_chunks_(0),
+        num_bytes_received_(0) {}
+  virtual ~LocalHttpCrashServer() {
+    Stop();
+  }
+
+  bool is_chunked() const { return is_chunked_; }
+  int num_chunks() const { return num_chunks_; }
+  size_t num_bytes_received() const { return num_bytes_received_; }
+  size_t num_bytes_decoded() const { return decoded_.size(); }
+  const CStringA& content_encoding() const { return content_encoding_; }
+  const std::map<CString, CStringA>& fields() const { return fields_; }
+
+ protected:
+  virtual bool BuildResponse(const Request& request, CStringA* response) {
+    EXPECT_EQ(0, request.request_line.Find("POST "));
+    is_chunked_ = request.is_chunked;
+    num_chunks_ = request.num_chunks;
+    num_bytes_received_ = request.body.GetLength();
+    content_encoding_ = request.GetHeader("Content-Encoding");
+
+    const CStringA kContentTypePrefix("multipart/form-data; boundary=");
+    const CStringA content_type(request.GetHeader("Content-Type"));
+    EXPECT_EQ(0, content_type.Find(kContentTypePrefix));
+    const CStringA boundary(content_type.Mid(kContentTypePrefix.GetLength()));
+
+    decoded_.clear();
+    if (!request.body.IsEmpty()) {
+      EXPECT_SUCCEEDED(DecodeContent(CONTENT_ENCODING_GZIP,
+                                     request.body.GetString(),
+                                     request.body.GetLength(),
+                                     kMaxDecodedLength,
+                                     &decoded_));
+    }
+    ParseForm(boundary, ToString(decoded_), &fields_);
+
+    const char kReportId[] = "report1\r\n";
+    SafeCStringAFormat(response,
+                       "HTTP/1.1 200 OK\r\n"
+                       "Content-Type: text/plain\r\n"
+                       "Content-Length: %d\r\n"
+                       "\r\n"
+                       "%s",
+                       static_cast<int>(arraysize(kReportId) - 1),
+                       kReportId);
+    return true;
+  }
+
+ private:
+  bool is_chunked_;
+  int num_chunks_;
+  size_t num_bytes_received_;
+  CStringA content_encoding_;
+  std::vector<uint8> decoded_;
+  std::map<CString, CStringA> fields_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalHttpCrashServer);
+};
+
+class CrashUploadTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    temp_dir_ = ConcatenatePath(app_util::GetTempDir(),
+                                _T("omaha_crash_upload_test"));
+    DeleteDirectory(temp_dir_);
+    EXPECT_SUCCEEDED(CreateDir(temp_dir_, NULL));
+    support_dir_ = ConcatenatePath(app_util::GetCurrentModuleDirectory(),
+                                   _T("unittest_support"));
+  }
+
+  virtual void TearDown() {
+    EXPECT_SUCCEEDED(DeleteDirectory(temp_dir_));
+  }
+
+  CString TempPath(const TCHAR* filename) const {
+    return ConcatenatePath(temp_dir_, filename);
+  }
+
+  // Sets up |reporter| to upload the crashes to |server|, which it owns.
+  static void SetUploadTransport(CrashReporter* reporter,
+                                 LocalCrashServer* server) {
+    reporter->upload_transport_.reset(server);
+  }
+
+  // Reports a crash of Chrome, with the custom info file of the unit tests,
+  // in the same way the crash handler does.
+  HRESULT ReportCrash(CrashReporter* reporter,
+                      DWORD exception_code,
+                      void* exception_address) {
+    const CString crash_filename(TempPath(_T("crash.dmp")));
+    const CString custom_info_filename(TempPath(kCustomInfoFilename));
+    WriteMinidumpWithException(crash_filename,
+                               exception_code,
+                               exception_address);
+    EXPECT_TRUE(::CopyFile(ConcatenatePath(support_dir_, kCustomInfoFilename),
+                           custom_info_filename,
+                           false));
+    return reporter->Report(crash_filename, custom_info_filename);
+  }
+
+  static size_t GetNumPendingCrashes(const CrashReporter& reporter) {
+    return reporter.crash_index_.num_pending_crashes();
+  }
+
+  CString temp_dir_;
+  CString support_dir_;
+};
+
+TEST_F(CrashUploadTest, ReadCrashCustomInfo_MatchesProfileApi) {
+  const CString filename(TempPath(_T("custom_info.txt")));
+  const char kCustomInfo[] =
+      "; The custom info of a crash.\r\n"
+      "[Other]\r\n"
+      "prod=Other\r\n"
+      "\r\n"
+      "[ClientCustomData]\r\n"
+      "prod = Chrome \r\n"
+      "ver=\"9.8.7.6\"\r\n"
+      "  lang =en\r\n"
+      "; guid=commented\r\n"
+      "empty=\r\n"
+      "ptype='browser'\r\n"
+      "quote=\"unbalanced\r\n"
+      "path=C:\\Program Files\\a=b\r\n"
+      "[Last]\n"
+      "guid=last";
+  EXPECT_SUCCEEDED(WriteEntireFile(
+      filename,
+      std::vector<uint8>(kCustomInfo,
+                         kCustomInfo + arraysize(kCustomInfo) - 1)));
+
+  CrashParameters parameters;
+  EXPECT_SUCCEEDED(ReadCrashCustomInfo(filename, &parameters));
+  EXPECT_EQ(7, parameters.size());
+  EXPECT_STREQ(_T("Chrome"), parameters[_T("prod")].c_str());
+  EXPECT_STREQ(_T("9.8.7.6"), parameters[_T("ver")].c_str());
+  EXPECT_STREQ(_T("en"), parameters[_T("lang")].c_str());
+  EXPECT_STREQ(_T(""), parameters[_T("empty")].c_str());
+  EXPECT_STREQ(_T("browser"), parameters[_T("ptype")].c_str());
+  EXPECT_STREQ(_T("\"unbalanced"), parameters[_T("quote")].c_str());
+  EXPECT_STREQ(_T("C:\\Program Files\\a=b"), parameters[_T("path")].c_str());
+
+  // The results are the same as the results of the profile API.
+  for (CrashParameters::const_iterator it = parameters.begin();
+       it != parameters.end();
+       ++it) {
+    TCHAR value[1024] = {};
+    ::GetPrivateProfileString(kCustomClientInfoGroup,
+                              it->first.c_str(),
+                              NULL,
+                              value,
+                              arraysize(value),
+                              filename);
+    EXPECT_STREQ(value, it->second.c_str());
+  }
+}
+
+TEST_F(CrashUploadTest, ReadCrashCustomInfo_WrittenByGoopdateUtils) {
+  const CString filename(TempPath(_T("custom_info.txt")));
+  std::map<CString, CString> pairs;
+  pairs[_T("prod")] = _T("Chrome");
+  pairs[_T("ver")] = _T("9.8.7.6");
+  pairs[_T("plat")] = _T("Win32");
+  EXPECT_SUCCEEDED(goopdate_utils::WriteNameValuePairsToFile(
+      filename, kCustomClientInfoGroup, pairs));
+
+  CrashParameters parameters;
+  EXPECT_SUCCEEDED(ReadCrashCustomInfo(filename, &parameters));
+  EXPECT_EQ(pairs.size(), parameters.size());
+  for (std::map<CString, CString>::const_iterator it = pairs.begin();
+       it != pairs.end();
+       ++it) {
+    EXPECT_STREQ(it->second, parameters[it->first.GetString()].c_str());
+  }
+
+  EXPECT_SUCCEEDED(ReadCrashCustomInfo(
+      ConcatenatePath(support_dir_, kCustomInfoFilename), &parameters));
+  EXPECT_STREQ(_T("Chrome"), parameters[_T("prod")].c_str());
+  EXPECT_STREQ(_T("9.8.7.6"), parameters[_T("ver")].c_str());
+
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            ReadCrashCustomInfo(TempPath(_T("missing.txt")), &parameters));
+}
+
+TEST_F(CrashUploadTest, GetCrashSignature) {
+  const CString first_crash(TempPath(_T("first.dmp")));
+  const CString first_crash_again(TempPath(_T("first_again.dmp")));
+  const CString second_crash(TempPath(_T("second.dmp")));
+  WriteMinidumpWithException(first_crash,
+                             EXCEPTION_ACCESS_VIOLATION,
+                             &FirstCrashFunction);
+  WriteMinidumpWithException(first_crash_again,
+                             EXCEPTION_ACCESS_VIOLATION,
+                             &FirstCrashFunction);
+  WriteMinidumpWithException(second_crash,
+                             EXCEPTION_ACCESS_VIOLATION,
+                             &SecondCrashFunction);
+
+  CrashParameters parameters;
+  parameters[_T("prod")] = _T("Chrome");
+  parameters[_T("ver")] = _T("1.2.3.4");
+
+  CString signature;
+  CString signature_again;
+  CString other_signature;
+  EXPECT_SUCCEEDED(GetCrashSignature(first_crash, parameters, &signature));
+  EXPECT_EQ(64, signature.GetLength());
+  EXPECT_SUCCEEDED(GetCrashSignature(first_crash_again,
+                                     parameters,
+                                     &signature_again));
+  EXPECT_STREQ(signature, signature_again);
+
+  EXPECT_SUCCEEDED(GetCrashSignature(second_crash,
+                                     parameters,
+                                     &other_signature));
+  EXPECT_STRNE(signature, other_signature);
+
+  parameters[_T("ver")] = _T("1.2.3.5");
+  EXPECT_SUCCEEDED(GetCrashSignature(first_crash,
+                                     parameters,
+                                     &other_signature));
+  EXPECT_STRNE(signature, other_signature);
+
+  // A file which is not a minidump has no signature.
+  EXPECT_FAILED(GetCrashSignature(
+      ConcatenatePath(support_dir_, kCustomInfoFilename),
+      parameters,
+      &signature));
+  EXPECT_TRUE(signature.IsEmpty());
+}
+
+TEST_F(CrashUploadTest, SendCrashUpload) {
+  const CString crash_filename(TempPath(_T("crash.dmp")));
+  WriteMinidumpWithException(crash_filename,
+                             EXCEPTION_ACCESS_VIOLATION,
+                             &FirstCrashFunction);
+  const std::vector<uint8> minidump(ReadFile(crash_filename));
+
+  CrashParameters parameters;
+  parameters[_T("prod")] = _T("Chrome");
+  parameters[_T("ver")] = _T("1.2.3.4");
+  parameters[_T("lang")] = _T("\x00e9t\x00e9");
+
+  LocalCrashServer server;
+  CString report_id;
+  uint64 body_length = 0;
+  uint64 bytes_sent = 0;
+  EXPECT_SUCCEEDED(SendCrashUpload(&server,
+                                   kUrlCrashReport,
+                                   parameters,
+                                   crash_filename,
+                                   &report_id,
+                                   &body_length,
+                                   &bytes_sent));
+  EXPECT_STREQ(_T("report1"), report_id);
+  EXPECT_EQ(1, server.num_uploads());
+  EXPECT_EQ(server.num_bytes_received(), bytes_sent);
+  EXPECT_LT(minidump.size(), body_length);
+
+  // The minidump compresses well, mostly because of the memory of the
+  // stacks of the threads.
+  EXPECT_GT(body_length / 2, bytes_sent);
+
+  std::map<CString, CStringA> fields(server.fields());
+  EXPECT_EQ(4, fields.size());
+  EXPECT_STREQ("Chrome", fields[_T("prod")]);
+  EXPECT_STREQ("1.2.3.4", fields[_T("ver")]);
+  EXPECT_STREQ(WideToUtf8(_T("\x00e9t\x00e9")), fields[_T("lang")]);
+  EXPECT_TRUE(ToString(minidump) == fields[_T("upload_file_minidump")]);
+
+  server.set_http_status_code(HTTP_STATUS_BAD_REQUEST);
+  EXPECT_EQ(GOOPDATE_E_CRASH_REJECTED,
+            SendCrashUpload(&server, kUrlCrashReport, parameters,
+                            crash_filename, &report_id,
+                            &body_length, &bytes_sent));
+  EXPECT_TRUE(report_id.IsEmpty());
+
+  server.set_http_status_code(HTTP_STATUS_SERVICE_UNAVAIL);
+  EXPECT_EQ(E_FAIL,
+            SendCrashUpload(&server, kUrlCrashReport, parameters,
+                            crash_filename, &report_id,
+                            &body_length, &bytes_sent));
+
+  // The body can't be read if the minidump does not exist.
+  EXPECT_EQ(E_FAIL,
+            SendCrashUpload(&server, kUrlCrashReport, parameters,
+                            TempPath(_T("missing.dmp")), &report_id,
+                            &body_length, &bytes_sent));
+  EXPECT_EQ(3, server.num_uploads());
+}
+
+// Posts a crash through WinHttp to a server on the loopback interface, so
+// that the chunks of the body and the count of the bytes written are checked
+// as the server receives them.
+TEST_F(CrashUploadTest, SendCrashUpload_HttpTransport) {
+  const CString crash_filename(TempPath(_T("crash.dmp")));
+  WriteMinidumpWithException(crash_filename,
+                             EXCEPTION_ACCESS_VIOLATION,
+                             &FirstCrashFunction);
+  const std::vector<uint8> minidump(ReadFile(crash_filename));
+
+  CrashParameters parameters;
+  parameters[_T("prod")] = _T("Chrome");
+  parameters[_T("ver")] = _T("1.2.3.4");
+
+  LocalHttpCrashServer server;
+  ASSERT_SUCCEEDED(server.Start());
+
+  HttpCrashUploadTransport transport;
+  CString report_id;
+  uint64 body_length = 0;
+  uint64 bytes_sent = 0;
+  EXPECT_SUCCEEDED(SendCrashUpload(&transport,
+                                   server.url(),
+                                   parameters,
+                                   crash_filename,
+                                   &report_id,
+                                   &body_length,
+                                   &bytes_sent));
+  server.Stop();
+
+  EXPECT_STREQ(_T("report1"), report_id);
+  EXPECT_EQ(1, server.num_requests_received());
+  EXPECT_TRUE(server.is_chunked());
+  EXPECT_LE(1, server.num_chunks());
+  EXPECT_STREQ("gzip", server.content_encoding());
+  EXPECT_EQ(bytes_sent, server.num_bytes_received());
+  EXPECT_EQ(body_length, server.num_bytes_decoded());
+
+  std::map<CString, CStringA> fields(server.fields());
+  EXPECT_EQ(3, fields.size());
+  EXPECT_STREQ("Chrome", fields[_T("prod")]);
+  EXPECT_STREQ("1.2.3.4", fields[_T("ver")]);
+  EXPECT_TRUE(ToString(minidump) == fields[_T("upload_file_minidump")]);
+}
+
+TEST_F(CrashUploadTest, CrashIndex_Duplicates) {
+  const time64 now = GetCurrent100NSTime();
+  const CString kSignature(_T("signature"));
+
+  CrashIndex crash_index;
+  EXPECT_SUCCEEDED(crash_index.Load(TempPath(_T("crash_index"))));
+  EXPECT_FALSE(crash_index.RecordDuplicate(kSignature, now));
+  EXPECT_EQ(0, crash_index.GetUploadCountInLastDay(now));
+
+  crash_index.RecordUpload(kSignature, now);
+  crash_index.RecordUpload(CString(), now);
+  EXPECT_EQ(2, crash_index.GetUploadCountInLastDay(now));
+  EXPECT_TRUE(crash_index.RecordDuplicate(kSignature, now + kHoursTo100ns));
+  EXPECT_TRUE(crash_index.RecordDuplicate(kSignature, now + kHoursTo100ns));
+  EXPECT_FALSE(crash_index.RecordDuplicate(_T("other"), now));
+  EXPECT_EQ(2, crash_index.GetDuplicateCount(kSignature));
+  EXPECT_EQ(0, crash_index.GetDuplicateCount(CString()));
+
+  // The index is the same after it is saved and loaded.
+  EXPECT_SUCCEEDED(crash_index.Save());
+  CrashIndex loaded_crash_index;
+  EXPECT_SUCCEEDED(loaded_crash_index.Load(TempPath(_T("crash_index"))));
+  EXPECT_EQ(2, loaded_crash_index.GetDuplicateCount(kSignature));
+  EXPECT_EQ(2, loaded_crash_index.GetUploadCountInLastDay(now));
+
+  // After a day, the crash is not a duplicate anymore, and the count of its
+  // duplicates is kept until it is uploaded again.
+  const time64 next_day = now + 25 * kHoursTo100ns;
+  EXPECT_EQ(0, loaded_crash_index.GetUploadCountInLastDay(next_day));
+  EXPECT_FALSE(loaded_crash_index.RecordDuplicate(kSignature, next_day));
+  EXPECT_EQ(2, loaded_crash_index.GetDuplicateCount(kSignature));
+  loaded_crash_index.RecordUpload(kSignature, next_day);
+  EXPECT_EQ(0, loaded_crash_index.GetDuplicateCount(kSignature));
+  EXPECT_EQ(1, loaded_crash_index.GetUploadCountInLastDay(next_day));
+}
+
+TEST_F(CrashUploadTest, CrashIndex_PendingCrashes) {
+  const time64 now = GetCurrent100NSTime();
+
+  CrashIndex crash_index;
+  EXPECT_SUCCEEDED(crash_index.Load(TempPath(_T("crash_index"))));
+  EXPECT_TRUE(crash_index.IsFullScanDue(now));
+  crash_index.set_last_full_scan_time(now);
+  EXPECT_FALSE(crash_index.IsFullScanDue(now + 23 * kHoursTo100ns));
+  EXPECT_TRUE(crash_index.IsFullScanDue(now + 25 * kHoursTo100ns));
+
+  crash_index.AddPendingCrash(_T("C:\\crashes\\a b.dmp"), now);
+  crash_index.AddPendingCrash(_T("C:\\crashes\\c.dmp"), now);
+  crash_index.AddPendingCrash(_T("C:\\crashes\\A B.dmp"), now);
+  EXPECT_EQ(2, crash_index.num_pending_crashes());
+  EXPECT_SUCCEEDED(crash_index.Save());
+
+  CrashIndex loaded_crash_index;
+  EXPECT_SUCCEEDED(loaded_crash_index.Load(TempPath(_T("crash_index"))));
+  EXPECT_EQ(2, loaded_crash_index.num_pending_crashes());
+  EXPECT_FALSE(loaded_crash_index.IsFullScanDue(now));
+  loaded_crash_index.RemovePendingCrash(_T("C:\\crashes\\c.dmp"));
+
+  std::vector<CString> stale_crashes;
+  loaded_crash_index.RemoveStalePendingCrashes(now + kHoursTo100ns,
+                                               &stale_crashes);
+  EXPECT_TRUE(stale_crashes.empty());
+  loaded_crash_index.RemoveStalePendingCrashes(now + 25 * kHoursTo100ns,
+                                               &stale_crashes);
+  ASSERT_EQ(1, stale_crashes.size());
+  EXPECT_STREQ(_T("C:\\crashes\\A B.dmp"), stale_crashes[0]);
+  EXPECT_EQ(0, loaded_crash_index.num_pending_crashes());
+
+  // An index which is not valid is ignored.
+  EXPECT_SUCCEEDED(WriteEntireFile(TempPath(_T("crash_index")),
+                                   std::vector<uint8>(10, 'x')));
+  EXPECT_SUCCEEDED(loaded_crash_index.Load(TempPath(_T("crash_index"))));
+  EXPECT_EQ(0, loaded_crash_index.num_pending_crashes());
+  EXPECT_TRUE(loaded_crash_index.IsFullScanDue(now));
+}
+
+// The index is saved through a temporary file with a unique name, which is
+// not left in the directory.
+TEST_F(CrashUploadTest, CrashIndex_SaveReplacesIndex) {
+  const time64 now = GetCurrent100NSTime();
+
+  CrashIndex crash_index;
+  CrashIndex other_crash_index;
+  EXPECT_SUCCEEDED(crash_index.Load(TempPath(_T("crash_index"))));
+  crash_index.AddPendingCrash(_T("C:\\crashes\\a.dmp"), now);
+  EXPECT_SUCCEEDED(crash_index.Save());
+
+  // The changes of an index which is loaded again are not lost.
+  EXPECT_SUCCEEDED(other_crash_index.Load(TempPath(_T("crash_index"))));
+  other_crash_index.AddPendingCrash(_T("C:\\crashes\\b.dmp"), now);
+  EXPECT_SUCCEEDED(other_crash_index.Save());
+  EXPECT_SUCCEEDED(crash_index.Load(TempPath(_T("crash_index"))));
+  EXPECT_EQ(2, crash_index.num_pending_crashes());
+
+  std::vector<CString> files;
+  EXPECT_SUCCEEDED(File::GetWildcards(temp_dir_, _T("crash_index*"), &files));
+  ASSERT_EQ(1, files.size());
+  EXPECT_STREQ(TempPath(_T("crash_index")), files[0]);
+}
+
+// Reports crashes to the local crash server through the crash reporter: the
+// duplicates of a crash are not uploaded, and the other crashes are uploaded
+// until the limit of uploads per day.
+TEST_F(CrashUploadTest, Report_DuplicateCrashes) {
+  CrashReporter reporter;
+  EXPECT_SUCCEEDED(reporter.Initialize(false));
+  reporter.SetCrashReportUrl(kUrlCrashReport);
+  reporter.SetMaxReportsPerDay(2);
+  LocalCrashServer* server = new LocalCrashServer;
+  SetUploadTransport(&reporter, server);
+
+  EXPECT_SUCCEEDED(ReportCrash(&reporter,
+                               EXCEPTION_ACCESS_VIOLATION,
+                               &FirstCrashFunction));
+  EXPECT_EQ(1, server->num_uploads());
+  EXPECT_STREQ("Chrome", server->fields().find(_T("prod"))->second);
+  EXPECT_TRUE(server->fields().find(_T("dup_count")) ==
+              server->fields().end());
+
+  EXPECT_EQ(GOOPDATE_E_CRASH_DUPLICATE,
+            ReportCrash(&reporter,
+                        EXCEPTION_ACCESS_VIOLATION,
+                        &FirstCrashFunction));
+  EXPECT_EQ(1, server->num_uploads());
+
+  EXPECT_SUCCEEDED(ReportCrash(&reporter,
+                               EXCEPTION_ACCESS_VIOLATION,
+                               &SecondCrashFunction));
+  EXPECT_EQ(2, server->num_uploads());
+
+  EXPECT_EQ(GOOPDATE_E_CRASH_THROTTLED,
+            ReportCrash(&reporter,
+                        EXCEPTION_STACK_OVERFLOW,
+                        &SecondCrashFunction));
+  EXPECT_EQ(2, server->num_uploads());
+
+  // The crash files are deleted, and the crashes are not pending anymore.
+  EXPECT_FALSE(File::Exists(TempPath(_T("crash.dmp"))));
+  EXPECT_FALSE(File::Exists(TempPath(kCustomInfoFilename)));
+  EXPECT_EQ(0, GetNumPendingCrashes(reporter));
+
+  EXPECT_SUCCEEDED(DeleteDirectory(reporter.crash_dir_));
+}
+
+}  // namespace omaha
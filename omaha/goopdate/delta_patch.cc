@@ -0,0 +1,635 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/delta_patch.h"
+
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/string.h"
+
+namespace omaha {
+
+namespace {
+
+const uint8 kMagic[] = {'O', 'M', 'D', 'P'};
+const uint32 kFormatVersion = 1;
+
+const uint8 kCommandCopy = 1;
+const uint8 kCommandInsert = 2;
+
+// The size of each of the buffers used to apply a patch.
+const uint32 kBufferSize = 64 * 1024;
+
+// The lengths in a patch are 32-bit.
+const uint64 kMaxDataSize = 0xFFFFFFFF;
+
+// The encoder looks up the blocks of this size of the new file in the old
+// file. A copy extends over up to kMaxEditSize different bytes when the next
+// kMinResyncSize bytes match again.
+const size_t kBlockSize = 16;
+const size_t kMaxEditSize = 8;
+const size_t kMinResyncSize = 8;
+
+// The multiplier of the rolling hash of the blocks.
+const uint32 kHashMultiplier = 257;
+
+// Writes the new file through a buffer. Writing more than the size in the
+// header of the patch is an invalid patch.
+class NewFileWriter {
+ public:
+  NewFileWriter(File* file, uint64 size)
+      : file_(file),
+        size_(size),
+        written_(0),
+        buffer_(new uint8[kBufferSize]),
+        used_(0) {
+    ASSERT1(file);
+  }
+
+  HRESULT Write(const uint8* data, uint32 size) {
+    if (size > size_ - written_) {
+      return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+    }
+    written_ += size;
+
+    while (size) {
+      if (used_ == kBufferSize) {
+        HRESULT hr = Flush();
+        if (FAILED(hr)) {
+          return hr;
+        }
+      }
+      const uint32 count = std::min(size, kBufferSize - used_);
+      memcpy(buffer_.get() + used_, data, count);
+      used_ += count;
+      data += count;
+      size -= count;
+    }
+    return S_OK;
+  }
+
+  HRESULT Flush() {
+    if (!used_) {
+      return S_OK;
+    }
+    HRESULT hr = file_->Write(buffer_.get(), used_, NULL);
+    used_ = 0;
+    return hr;
+  }
+
+  bool is_complete() const { return written_ == size_; }
+
+ private:
+  File* const file_;
+  const uint64 size_;
+  uint64 written_;
+  std::unique_ptr<uint8[]> buffer_;
+  uint32 used_;
+
+  DISALLOW_COPY_AND_ASSIGN(NewFileWriter);
+};
+
+// Reads the patch sequentially through a buffer. Running out of data before
+// the new file is complete is an invalid patch.
+class PatchReader {
+ public:
+  explicit PatchReader(File* file)
+      : file_(file),
+        buffer_(new uint8[kBufferSize]),
+        pos_(0),
+        end_(0) {
+    ASSERT1(file);
+  }
+
+  HRESULT Read(uint8* data, uint32 size) {
+    while (size) {
+      if (pos_ == end_) {
+        HRESULT hr = Fill();
+        if (FAILED(hr)) {
+          return hr;
+        }
+      }
+      const uint32 count = std::min(size, end_ - pos_);
+      memcpy(data, buffer_.get() + pos_, count);
+      pos_ += count;
+      data += count;
+      size -= count;
+    }
+    return S_OK;
+  }
+
+  template <typename T>
+  HRESULT ReadInteger(T* value) {
+    ASSERT1(value);
+
+    uint8 bytes[sizeof(T)] = {0};
+    HRESULT hr = Read(bytes, sizeof(bytes));
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    T result = 0;
+    for (size_t i = sizeof(T); i != 0; --i) {
+      result = static_cast<T>((static_cast<uint64>(result) << 8) |
+                              bytes[i - 1]);
+    }
+    *value = result;
+    return S_OK;
+  }
+
+  // Writes the next |size| bytes of the patch to |writer|.
+  HRESULT CopyTo(NewFileWriter* writer, uint32 size) {
+    ASSERT1(writer);
+
+    while (size) {
+      if (pos_ == end_) {
+        HRESULT hr = Fill();
+        if (FAILED(hr)) {
+          return hr;
+        }
+      }
+      const uint32 count = std::min(size, end_ - pos_);
+      HRESULT hr = writer->Write(buffer_.get() + pos_, count);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      pos_ += count;
+      size -= count;
+    }
+    return S_OK;
+  }
+
+  // Returns S_OK if all the patch has been read and S_FALSE otherwise.
+  HRESULT IsAtEnd() {
+    if (pos_ != end_) {
+      return S_FALSE;
+    }
+    uint32 bytes_read = 0;
+    HRESULT hr = file_->Read(kBufferSize, buffer_.get(), &bytes_read);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    pos_ = 0;
+    end_ = bytes_read;
+    return bytes_read ? S_FALSE : S_OK;
+  }
+
+ private:
+  HRESULT Fill() {
+    ASSERT1(pos_ == end_);
+
+    uint32 bytes_read = 0;
+    HRESULT hr = file_->Read(kBufferSize, buffer_.get(), &bytes_read);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    if (!bytes_read) {
+      return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+    }
+    pos_ = 0;
+    end_ = bytes_read;
+    return S_OK;
+  }
+
+  File* const file_;
+  std::unique_ptr<uint8[]> buffer_;
+  uint32 pos_;
+  uint32 end_;
+
+  DISALLOW_COPY_AND_ASSIGN(PatchReader);
+};
+
+// Applies the commands of a patch to the old file.
+class DeltaPatcher {
+ public:
+  DeltaPatcher(File* old_file,
+               uint64 old_size,
+               PatchReader* reader,
+               NewFileWriter* writer)
+      : old_file_(old_file),
+        old_size_(old_size),
+        reader_(reader),
+        writer_(writer),
+        buffer_(new uint8[kBufferSize]) {
+    ASSERT1(old_file);
+    ASSERT1(reader);
+    ASSERT1(writer);
+  }
+
+  HRESULT ApplyCommands() {
+    while (!writer_->is_complete()) {
+      uint8 command = 0;
+      HRESULT hr = reader_->ReadInteger(&command);
+      if (FAILED(hr)) {
+        return hr;
+      }
+
+      switch (command) {
+        case kCommandCopy:
+          hr = ApplyCopy();
+          break;
+        case kCommandInsert:
+          hr = ApplyInsert();
+          break;
+        default:
+          CORE_LOG(LE, (_T("[DeltaPatcher][unknown command][%u]"), command));
+          hr = GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+          break;
+      }
+      if (FAILED(hr)) {
+        return hr;
+      }
+    }
+
+    return writer_->Flush();
+  }
+
+ private:
+  HRESULT ApplyCopy() {
+    uint64 offset = 0;
+    uint32 length = 0;
+    uint32 num_edits = 0;
+    HRESULT hr = reader_->ReadInteger(&offset);
+    if (SUCCEEDED(hr)) {
+      hr = reader_->ReadInteger(&length);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = reader_->ReadInteger(&num_edits);
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    if (offset > old_size_ || length > old_size_ - offset) {
+      CORE_LOG(LE, (_T("[DeltaPatcher][copy out of range][%llu][%u]"),
+                    offset, length));
+      return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+    }
+
+    uint32 done = 0;
+    for (uint32 i = 0; i != num_edits; ++i) {
+      uint32 gap = 0;
+      uint32 count = 0;
+      hr = reader_->ReadInteger(&gap);
+      if (SUCCEEDED(hr)) {
+        hr = reader_->ReadInteger(&count);
+      }
+      if (FAILED(hr)) {
+        return hr;
+      }
+
+      if (gap > length - done || count > length - done - gap) {
+        return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+      }
+
+      hr = CopyOld(offset + done, gap);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      done += gap;
+
+      hr = reader_->CopyTo(writer_, count);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      done += count;
+    }
+
+    return CopyOld(offset + done, length - done);
+  }
+
+  HRESULT ApplyInsert() {
+    uint32 length = 0;
+    HRESULT hr = reader_->ReadInteger(&length);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    return reader_->CopyTo(writer_, length);
+  }
+
+  // Writes |size| bytes of the old file at |offset|, which are in range.
+  HRESULT CopyOld(uint64 offset, uint32 size) {
+    while (size) {
+      const uint32 count = std::min(size, kBufferSize);
+      uint32 bytes_read = 0;
+      HRESULT hr = old_file_->ReadAt64(offset,
+                                       buffer_.get(),
+                                       count,
+                                       &bytes_read);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      if (bytes_read != count) {
+        return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+      }
+
+      hr = writer_->Write(buffer_.get(), count);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      offset += count;
+      size -= count;
+    }
+    return S_OK;
+  }
+
+  File* const old_file_;
+  const uint64 old_size_;
+  PatchReader* const reader_;
+  NewFileWriter* const writer_;
+  std::unique_ptr<uint8[]> buffer_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeltaPatcher);
+};
+
+HRESULT ApplyPatchFile(const CString& old_file_path,
+                       File* patch_file,
+                       File* new_file) {
+  ASSERT1(patch_file);
+  ASSERT1(new_file);
+
+  PatchReader reader(patch_file);
+
+  uint8 magic[arraysize(kMagic)] = {0};
+  uint32 version = 0;
+  uint64 old_size = 0;
+  uint8 old_hash[SHA256_DIGEST_SIZE] = {0};
+  uint64 new_size = 0;
+  HRESULT hr = reader.Read(magic, sizeof(magic));
+  if (SUCCEEDED(hr)) {
+    hr = reader.ReadInteger(&version);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = reader.ReadInteger(&old_size);
+  }
+  if (SUCCEEDED(hr)) {
+    hr = reader.Read(old_hash, sizeof(old_hash));
+  }
+  if (SUCCEEDED(hr)) {
+    hr = reader.ReadInteger(&new_size);
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+      version != kFormatVersion) {
+    CORE_LOG(LE, (_T("[ApplyDeltaPatch][unsupported patch][%u]"), version));
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  // The old file is hashed before it is opened, since the hash opens it too.
+  std::vector<CString> old_files;
+  old_files.push_back(old_file_path);
+  hr = VerifyFileHashSha256(old_files, BytesToHex(old_hash, sizeof(old_hash)));
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[ApplyDeltaPatch][old file does not match][0x%08x]"),
+                  hr));
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  File old_file;
+  hr = old_file.OpenShareMode(old_file_path, false, false, FILE_SHARE_READ);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  uint64 old_file_size = 0;
+  hr = old_file.GetLength64(&old_file_size);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (old_file_size != old_size) {
+    return GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+  }
+
+  NewFileWriter writer(new_file, new_size);
+  DeltaPatcher patcher(&old_file, old_size, &reader, &writer);
+  hr = patcher.ApplyCommands();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = reader.IsAtEnd();
+  if (FAILED(hr)) {
+    return hr;
+  }
+  return hr == S_OK ? S_OK : GOOPDATEDOWNLOAD_E_INVALID_PATCH;
+}
+
+// Appends the commands of a patch.
+class PatchBuilder {
+ public:
+  explicit PatchBuilder(std::vector<uint8>* patch) : patch_(patch) {
+    ASSERT1(patch);
+  }
+
+  template <typename T>
+  void AppendInteger(T value) {
+    for (size_t i = 0; i != sizeof(T); ++i) {
+      patch_->push_back(static_cast<uint8>(static_cast<uint64>(value) >>
+                                           (8 * i)));
+    }
+  }
+
+  void AppendBytes(const uint8* data, size_t size) {
+    patch_->insert(patch_->end(), data, data + size);
+  }
+
+  void AppendInsert(const uint8* data, size_t size) {
+    if (!size) {
+      return;
+    }
+    AppendInteger(kCommandInsert);
+    AppendInteger(static_cast<uint32>(size));
+    AppendBytes(data, size);
+  }
+
+ private:
+  std::vector<uint8>* patch_;
+
+  DISALLOW_COPY_AND_ASSIGN(PatchBuilder);
+};
+
+// A run of different bytes in a copy, at |position| in the new file.
+struct Edit {
+  size_t position;
+  size_t size;
+};
+
+bool RangesMatch(const std::vector<uint8>& old_data,
+                 size_t old_pos,
+                 const std::vector<uint8>& new_data,
+                 size_t new_pos,
+                 size_t size) {
+  return old_pos + size <= old_data.size() &&
+         new_pos + size <= new_data.size() &&
+         memcmp(&old_data[old_pos], &new_data[new_pos], size) == 0;
+}
+
+uint32 HashBlock(const uint8* block) {
+  uint32 hash = 0;
+  for (size_t i = 0; i != kBlockSize; ++i) {
+    hash = hash * kHashMultiplier + block[i];
+  }
+  return hash;
+}
+
+}  // namespace
+
+HRESULT ApplyDeltaPatch(const CString& old_file_path,
+                        File* patch_file,
+                        File* new_file) {
+  ASSERT1(patch_file);
+  ASSERT1(new_file);
+  CORE_LOG(L3, (_T("[ApplyDeltaPatch][%s]"), old_file_path));
+
+  HRESULT hr = ApplyPatchFile(old_file_path, patch_file, new_file);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[ApplyDeltaPatch failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  return S_OK;
+}
+
+HRESULT CreateDeltaPatch(const std::vector<uint8>& old_data,
+                         const std::vector<uint8>& new_data,
+                         std::vector<uint8>* patch) {
+  ASSERT1(patch);
+
+  if (old_data.size() > kMaxDataSize || new_data.size() > kMaxDataSize) {
+    return E_INVALIDARG;
+  }
+
+  std::vector<byte> old_hash;
+  CryptoHash crypto;
+  HRESULT hr = crypto.Compute(old_data, &old_hash);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  ASSERT1(old_hash.size() == SHA256_DIGEST_SIZE);
+
+  patch->clear();
+  PatchBuilder builder(patch);
+  builder.AppendBytes(kMagic, sizeof(kMagic));
+  builder.AppendInteger(kFormatVersion);
+  builder.AppendInteger(static_cast<uint64>(old_data.size()));
+  builder.AppendBytes(&old_hash.front(), old_hash.size());
+  builder.AppendInteger(static_cast<uint64>(new_data.size()));
+
+  // Indexes the first occurrence of each aligned block of the old file.
+  std::map<uint32, size_t> old_blocks;
+  for (size_t i = 0; i + kBlockSize <= old_data.size(); i += kBlockSize) {
+    old_blocks.insert(std::make_pair(HashBlock(&old_data[i]), i));
+  }
+
+  uint32 top_multiplier = 1;
+  for (size_t i = 1; i != kBlockSize; ++i) {
+    top_multiplier *= kHashMultiplier;
+  }
+
+  const size_t new_size = new_data.size();
+  size_t literal_start = 0;
+  size_t pos = 0;
+  uint32 hash = new_size >= kBlockSize ? HashBlock(&new_data[0]) : 0;
+
+  while (pos + kBlockSize <= new_size) {
+    std::map<uint32, size_t>::const_iterator it = old_blocks.find(hash);
+    if (it == old_blocks.end() ||
+        !RangesMatch(old_data, it->second, new_data, pos, kBlockSize)) {
+      if (pos + kBlockSize < new_size) {
+        hash = (hash - new_data[pos] * top_multiplier) * kHashMultiplier +
+               new_data[pos + kBlockSize];
+      }
+      ++pos;
+      continue;
+    }
+
+    // Extends the match backward over the bytes not yet in the patch.
+    size_t new_start = pos;
+    size_t old_start = it->second;
+    while (new_start > literal_start && old_start > 0 &&
+           new_data[new_start - 1] == old_data[old_start - 1]) {
+      --new_start;
+      --old_start;
+    }
+
+    // Extends the match forward, over the runs of a few different bytes.
+    std::vector<Edit> edits;
+    size_t new_end = pos + kBlockSize;
+    size_t old_end = it->second + kBlockSize;
+    while (new_end < new_size && old_end < old_data.size()) {
+      if (new_data[new_end] == old_data[old_end]) {
+        ++new_end;
+        ++old_end;
+        continue;
+      }
+
+      size_t edit_size = 1;
+      while (edit_size <= kMaxEditSize &&
+             !RangesMatch(old_data, old_end + edit_size,
+                          new_data, new_end + edit_size,
+                          kMinResyncSize)) {
+        ++edit_size;
+      }
+      if (edit_size > kMaxEditSize) {
+        break;
+      }
+
+      Edit edit = {new_end, edit_size};
+      edits.push_back(edit);
+      new_end += edit_size;
+      old_end += edit_size;
+    }
+
+    builder.AppendInsert(&new_data[literal_start], new_start - literal_start);
+
+    builder.AppendInteger(kCommandCopy);
+    builder.AppendInteger(static_cast<uint64>(old_start));
+    builder.AppendInteger(static_cast<uint32>(new_end - new_start));
+    builder.AppendInteger(static_cast<uint32>(edits.size()));
+    size_t edited_end = new_start;
+    for (size_t i = 0; i != edits.size(); ++i) {
+      builder.AppendInteger(static_cast<uint32>(edits[i].position -
+                                                edited_end));
+      builder.AppendInteger(static_cast<uint32>(edits[i].size));
+      builder.AppendBytes(&new_data[edits[i].position], edits[i].size);
+      edited_end = edits[i].position + edits[i].size;
+    }
+
+    pos = new_end;
+    literal_start = new_end;
+    if (pos + kBlockSize <= new_size) {
+      hash = HashBlock(&new_data[pos]);
+    }
+  }
+
+  if (literal_start < new_size) {
+    builder.AppendInsert(&new_data[literal_start], new_size - literal_start);
+  }
+
+  return S_OK;
+}
+
+}  // namespace omaha
@@ -0,0 +1,70 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// A delta patch rebuilds the package of a new version from the package of the
+// previous version, so that an update downloads the difference between the
+// versions instead of the whole package. As in bsdiff, the new file is a
+// sequence of copies of ranges of the old file, in which a few bytes may be
+// replaced, and of literal bytes which are not found in the old file. The
+// replaced bytes account for the addresses and offsets which move between the
+// builds of an executable.
+//
+// A patch is applied in one pass over the patch and the new file, with random
+// reads of the old file, through fixed size buffers. The memory used does not
+// depend on the size of the files. The patch has the SHA-256 hash of the old
+// file, which is verified before the patch is applied. The caller verifies
+// the hash of the new file.
+//
+// The format of a patch, where integers are little-endian:
+//   header: "OMDP", uint32 version, uint64 old size, uint8[32] old SHA-256,
+//           uint64 new size.
+//   copy:   uint8 1, uint64 old offset, uint32 length, uint32 edit count,
+//           then for each edit: uint32 gap, uint32 count, |count| bytes. The
+//           gap is the number of bytes copied since the previous edit.
+//   insert: uint8 2, uint32 length, |length| bytes.
+// The commands follow the header, until the new file is complete.
+
+#ifndef OMAHA_GOOPDATE_DELTA_PATCH_H_
+#define OMAHA_GOOPDATE_DELTA_PATCH_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class File;
+
+// Applies the patch read from |patch_file| to the file at |old_file_path| and
+// writes the new file to |new_file|, which must be empty. The patch is read
+// from the current position of |patch_file|. Returns
+// GOOPDATEDOWNLOAD_E_INVALID_PATCH if the patch is malformed or if it does not
+// apply to the old file. |new_file| may be partially written on failure.
+HRESULT ApplyDeltaPatch(const CString& old_file_path,
+                        File* patch_file,
+                        File* new_file);
+
+// Creates the patch from |old_data| to |new_data|. The patches are created
+// offline along with the packages; this is used by the tests and the
+// benchmarks, and documents how the patches are expected to be encoded.
+HRESULT CreateDeltaPatch(const std::vector<uint8>& old_data,
+                         const std::vector<uint8>& new_data,
+                         std::vector<uint8>* patch);
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_DELTA_PATCH_H_
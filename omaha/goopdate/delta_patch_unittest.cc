@@ -0,0 +1,195 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/delta_patch.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+// The size of the header of a patch, and the offset of the old file offset of
+// the first command when it is a copy.
+const size_t kHeaderSize = 56;
+const size_t kFirstCopyOffset = kHeaderSize + 1;
+
+std::vector<uint8> CreateData(size_t size, uint32 seed) {
+  std::vector<uint8> data(size);
+  for (size_t i = 0; i != size; ++i) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = static_cast<uint8>(seed >> 16);
+  }
+  return data;
+}
+
+}  // namespace
+
+class DeltaPatchTest : public testing::Test {
+ protected:
+  DeltaPatchTest()
+      : old_file_(GetTempFilename(_T("ut_"))),
+        patch_file_(GetTempFilename(_T("ut_"))),
+        new_file_(GetTempFilename(_T("ut_"))) {}
+
+  virtual void TearDown() {
+    ::DeleteFile(old_file_);
+    ::DeleteFile(patch_file_);
+    ::DeleteFile(new_file_);
+  }
+
+  // Creates the patch from |old_data| to |new_data| and applies it.
+  void ExpectRoundTrip(const std::vector<uint8>& old_data,
+                       const std::vector<uint8>& new_data) {
+    std::vector<uint8> patch;
+    EXPECT_SUCCEEDED(CreateDeltaPatch(old_data, new_data, &patch));
+    EXPECT_SUCCEEDED(Apply(old_data, patch));
+
+    std::vector<uint8> patched_data;
+    EXPECT_SUCCEEDED(ReadEntireFile(new_file_, 0, &patched_data));
+    EXPECT_TRUE(new_data == patched_data);
+  }
+
+  HRESULT Apply(const std::vector<uint8>& old_data,
+                const std::vector<uint8>& patch) {
+    EXPECT_SUCCEEDED(WriteEntireFile(old_file_, old_data));
+    EXPECT_SUCCEEDED(WriteEntireFile(patch_file_, patch));
+    ::DeleteFile(new_file_);
+
+    File patch_file;
+    File new_file;
+    EXPECT_SUCCEEDED(patch_file.OpenShareMode(patch_file_,
+                                              false,
+                                              false,
+                                              FILE_SHARE_READ));
+    EXPECT_SUCCEEDED(new_file.Open(new_file_, true, false));
+    return ApplyDeltaPatch(old_file_, &patch_file, &new_file);
+  }
+
+  const CString old_file_;
+  const CString patch_file_;
+  const CString new_file_;
+};
+
+TEST_F(DeltaPatchTest, SameFile) {
+  const std::vector<uint8> data(CreateData(300000, 1));
+
+  std::vector<uint8> patch;
+  EXPECT_SUCCEEDED(CreateDeltaPatch(data, data, &patch));
+  EXPECT_GT(100, patch.size());
+
+  ExpectRoundTrip(data, data);
+}
+
+// Moves, replaces, and inserts ranges of the old file, the way the sections
+// of an executable change between two builds.
+TEST_F(DeltaPatchTest, ChangedFile) {
+  const std::vector<uint8> old_data(CreateData(500000, 3));
+  const std::vector<uint8> inserted(CreateData(5000, 4));
+
+  std::vector<uint8> new_data(old_data.begin() + 250000, old_data.end());
+  new_data.insert(new_data.end(), inserted.begin(), inserted.end());
+  new_data.insert(new_data.end(), old_data.begin(), old_data.begin() + 250000);
+  for (size_t i = 0; i < new_data.size(); i += 64) {
+    new_data[i] ^= 0x10;
+  }
+
+  std::vector<uint8> patch;
+  EXPECT_SUCCEEDED(CreateDeltaPatch(old_data, new_data, &patch));
+  EXPECT_GT(new_data.size() / 4, patch.size());
+
+  ExpectRoundTrip(old_data, new_data);
+}
+
+TEST_F(DeltaPatchTest, UnrelatedFile) {
+  ExpectRoundTrip(CreateData(100000, 5), CreateData(120000, 6));
+}
+
+// A patch only applies to the file it was created from.
+TEST_F(DeltaPatchTest, WrongOldFile) {
+  std::vector<uint8> old_data(CreateData(100000, 7));
+  std::vector<uint8> patch;
+  EXPECT_SUCCEEDED(CreateDeltaPatch(old_data, CreateData(1000, 8), &patch));
+
+  old_data[500] ^= 1;
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, patch));
+
+  old_data[500] ^= 1;
+  old_data.push_back(0);
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, patch));
+}
+
+TEST_F(DeltaPatchTest, InvalidPatch) {
+  const std::vector<uint8> old_data(CreateData(100000, 9));
+  std::vector<uint8> patch;
+  EXPECT_SUCCEEDED(CreateDeltaPatch(old_data, old_data, &patch));
+  ASSERT_LT(kFirstCopyOffset + 8, patch.size());
+
+  // Truncated.
+  std::vector<uint8> invalid_patch(patch.begin(), patch.end() - 1);
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, invalid_patch));
+
+  // Trailing data.
+  invalid_patch = patch;
+  invalid_patch.push_back(0);
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, invalid_patch));
+
+  // Unknown format.
+  invalid_patch = patch;
+  invalid_patch[0] = 'X';
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, invalid_patch));
+
+  // Copy out of the old file.
+  invalid_patch = patch;
+  invalid_patch[kFirstCopyOffset + 7] = 0x80;
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, invalid_patch));
+
+  // Unknown command.
+  invalid_patch = patch;
+  invalid_patch[kHeaderSize] = 0x7f;
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH, Apply(old_data, invalid_patch));
+
+  EXPECT_SUCCEEDED(Apply(old_data, patch));
+}
+
+TEST_F(DeltaPatchTest, VersionPair) {
+  const CString old_path(ConcatenatePath(
+      app_util::GetCurrentModuleDirectory(),
+      _T("unittest_support\\omaha_1.2.131.7_shell\\GoogleUpdate.exe")));
+  const CString new_path(ConcatenatePath(
+      app_util::GetCurrentModuleDirectory(),
+      _T("unittest_support\\omaha_1.2.183.9_shell\\GoogleUpdate.exe")));
+
+  std::vector<uint8> old_data;
+  std::vector<uint8> new_data;
+  ASSERT_SUCCEEDED(ReadEntireFileShareMode(old_path, 0, FILE_SHARE_READ,
+                                           &old_data));
+  ASSERT_SUCCEEDED(ReadEntireFileShareMode(new_path, 0, FILE_SHARE_READ,
+                                           &new_data));
+
+  std::vector<uint8> patch;
+  EXPECT_SUCCEEDED(CreateDeltaPatch(old_data, new_data, &patch));
+  EXPECT_GT(new_data.size() / 2, patch.size());
+
+  ExpectRoundTrip(old_data, new_data);
+}
+
+}  // namespace omaha
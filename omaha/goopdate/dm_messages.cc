@@ -604,6 +604,95 @@ void ValidateAppPolicies(const edm::ApplicationSettings& app_settings,
   ValidateAppTargetVersionPrefixPolicy(app_settings, validation_result);
 }
 
+// Identifies a compiled CachedOmahaPolicy. The version changes whenever the
+// layout of the compiled policy or the fields of CachedOmahaPolicy change.
+constexpr uint32 kCompiledOmahaPolicyMagic = 0x504d4f43;  // "COMP".
+constexpr uint32 kCompiledOmahaPolicyVersion = 1;
+
+// Appends fixed-size values and strings in native byte order.
+class CompiledPolicyWriter {
+ public:
+  explicit CompiledPolicyWriter(std::vector<uint8>* output) : output_(output) {
+    ASSERT1(output);
+  }
+
+  void WriteBytes(const void* data, size_t size) {
+    const uint8* bytes = static_cast<const uint8*>(data);
+    output_->insert(output_->end(), bytes, bytes + size);
+  }
+
+  void WriteUint32(uint32 value) { WriteBytes(&value, sizeof(value)); }
+  void WriteInt32(int value) { WriteBytes(&value, sizeof(value)); }
+  void WriteInt64(int64_t value) { WriteBytes(&value, sizeof(value)); }
+
+  void WriteString(const CString& value) {
+    WriteUint32(static_cast<uint32>(value.GetLength()));
+    WriteBytes(value.GetString(), value.GetLength() * sizeof(TCHAR));
+  }
+
+ private:
+  std::vector<uint8>* output_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompiledPolicyWriter);
+};
+
+// Reads the values written by CompiledPolicyWriter. Reading past the end of
+// the input fails, and all the subsequent reads fail too.
+class CompiledPolicyReader {
+ public:
+  explicit CompiledPolicyReader(const std::vector<uint8>& input)
+      : input_(input), position_(0) {}
+
+  bool ReadBytes(void* data, size_t size) {
+    if (!succeeded() || size > input_.size() - position_) {
+      position_ = input_.size() + 1;
+      return false;
+    }
+    if (size) {
+      memcpy(data, &input_[position_], size);
+    }
+    position_ += size;
+    return true;
+  }
+
+  bool ReadUint32(uint32* value) { return ReadBytes(value, sizeof(*value)); }
+  bool ReadInt32(int* value) { return ReadBytes(value, sizeof(*value)); }
+  bool ReadInt64(int64_t* value) { return ReadBytes(value, sizeof(*value)); }
+
+  bool ReadString(CString* value) {
+    ASSERT1(value);
+    uint32 length = 0;
+    if (!ReadUint32(&length) ||
+        length > (input_.size() - position_) / sizeof(TCHAR)) {
+      position_ = input_.size() + 1;
+      return false;
+    }
+    TCHAR* buffer = value->GetBufferSetLength(static_cast<int>(length));
+    ReadBytes(buffer, length * sizeof(TCHAR));
+    value->ReleaseBufferSetLength(static_cast<int>(length));
+    return true;
+  }
+
+  bool ReadBool(bool* value) {
+    ASSERT1(value);
+    uint32 bool_value = 0;
+    if (!ReadUint32(&bool_value)) {
+      return false;
+    }
+    *value = !!bool_value;
+    return true;
+  }
+
+  bool succeeded() const { return position_ <= input_.size(); }
+  bool at_end() const { return position_ == input_.size(); }
+
+ private:
+  const std::vector<uint8>& input_;
+  size_t position_;
+
+  DISALLOW_COPY_AND_ASSIGN(CompiledPolicyReader);
+};
+
 }  // namespace
 
 bool ValidateOmahaPolicyResponse(
@@ -804,6 +893,113 @@ HRESULT GetCachedOmahaPolicy(const std::string& raw_response,
   return S_OK;
 }
 
+void SerializeCompiledOmahaPolicy(const CachedOmahaPolicy& info,
+                                  const std::vector<uint8>& response_hash,
+                                  std::vector<uint8>* compiled_policy) {
+  ASSERT1(compiled_policy);
+
+  compiled_policy->clear();
+  CompiledPolicyWriter writer(compiled_policy);
+  writer.WriteUint32(kCompiledOmahaPolicyMagic);
+  writer.WriteUint32(kCompiledOmahaPolicyVersion);
+  writer.WriteUint32(static_cast<uint32>(response_hash.size()));
+  if (!response_hash.empty()) {
+    writer.WriteBytes(&response_hash.front(), response_hash.size());
+  }
+
+  writer.WriteUint32(info.is_managed);
+  writer.WriteUint32(info.is_initialized);
+  writer.WriteInt64(info.auto_update_check_period_minutes);
+  writer.WriteString(info.download_preference);
+  writer.WriteInt64(info.cache_size_limit);
+  writer.WriteInt64(info.cache_life_limit);
+  writer.WriteInt64(info.updates_suppressed.start_hour);
+  writer.WriteInt64(info.updates_suppressed.start_minute);
+  writer.WriteInt64(info.updates_suppressed.duration_min);
+  writer.WriteString(info.proxy_mode);
+  writer.WriteString(info.proxy_server);
+  writer.WriteString(info.proxy_pac_url);
+  writer.WriteInt32(info.install_default);
+  writer.WriteInt32(info.update_default);
+
+  writer.WriteUint32(static_cast<uint32>(info.application_settings.size()));
+  for (const auto& app : info.application_settings) {
+    writer.WriteBytes(&app.first, sizeof(app.first));
+    writer.WriteInt32(app.second.install);
+    writer.WriteInt32(app.second.update);
+    writer.WriteString(app.second.target_channel);
+    writer.WriteString(app.second.target_version_prefix);
+    writer.WriteInt32(app.second.rollback_to_target_version);
+  }
+}
+
+HRESULT DeserializeCompiledOmahaPolicy(
+    const std::vector<uint8>& compiled_policy,
+    const std::vector<uint8>& response_hash,
+    CachedOmahaPolicy* info) {
+  ASSERT1(info);
+
+  CompiledPolicyReader reader(compiled_policy);
+  uint32 magic = 0;
+  uint32 version = 0;
+  uint32 hash_size = 0;
+  if (!reader.ReadUint32(&magic) ||
+      !reader.ReadUint32(&version) ||
+      !reader.ReadUint32(&hash_size) ||
+      magic != kCompiledOmahaPolicyMagic ||
+      version != kCompiledOmahaPolicyVersion ||
+      hash_size != response_hash.size()) {
+    return E_UNEXPECTED;
+  }
+
+  std::vector<uint8> hash(hash_size);
+  if (hash_size && !reader.ReadBytes(&hash.front(), hash_size)) {
+    return E_UNEXPECTED;
+  }
+  if (hash != response_hash) {
+    return E_UNEXPECTED;
+  }
+
+  CachedOmahaPolicy policy;
+  reader.ReadBool(&policy.is_managed);
+  reader.ReadBool(&policy.is_initialized);
+  reader.ReadInt64(&policy.auto_update_check_period_minutes);
+  reader.ReadString(&policy.download_preference);
+  reader.ReadInt64(&policy.cache_size_limit);
+  reader.ReadInt64(&policy.cache_life_limit);
+  reader.ReadInt64(&policy.updates_suppressed.start_hour);
+  reader.ReadInt64(&policy.updates_suppressed.start_minute);
+  reader.ReadInt64(&policy.updates_suppressed.duration_min);
+  reader.ReadString(&policy.proxy_mode);
+  reader.ReadString(&policy.proxy_server);
+  reader.ReadString(&policy.proxy_pac_url);
+  reader.ReadInt32(&policy.install_default);
+  reader.ReadInt32(&policy.update_default);
+
+  uint32 num_apps = 0;
+  reader.ReadUint32(&num_apps);
+  for (uint32 i = 0; i < num_apps && reader.succeeded(); ++i) {
+    GUID app_guid = {};
+    ApplicationSettings app_settings;
+    reader.ReadBytes(&app_guid, sizeof(app_guid));
+    reader.ReadInt32(&app_settings.install);
+    reader.ReadInt32(&app_settings.update);
+    reader.ReadString(&app_settings.target_channel);
+    reader.ReadString(&app_settings.target_version_prefix);
+    reader.ReadInt32(&app_settings.rollback_to_target_version);
+    policy.application_settings.insert(
+        policy.application_settings.end(),
+        std::make_pair(app_guid, app_settings));
+  }
+
+  if (!reader.succeeded() || !reader.at_end()) {
+    return E_UNEXPECTED;
+  }
+
+  *info = policy;
+  return S_OK;
+}
+
 CStringA SerializeRegisterBrowserRequest(const CStringA& machine_name,
                                          const CStringA& serial_number,
                                          const CStringA& os_platform,
@@ -184,6 +184,7 @@ struct CachedOmahaPolicy {
   CString proxy_pac_url;
   int install_default = -1;
   int update_default = -1;
+  int max_concurrent_installs = -1;
 
   std::map<GUID, ApplicationSettings, GUIDCompare> application_settings;
 
@@ -214,6 +215,8 @@ struct CachedOmahaPolicy {
                             install_default);
     SafeCStringAppendFormat(&result, _T("[update_default][%d]"),
                             update_default);
+    SafeCStringAppendFormat(&result, _T("[max_concurrent_installs][%d]"),
+                            max_concurrent_installs);
 
     for (auto elem : application_settings) {
       SafeCStringAppendFormat(&result, _T("[application_settings][%s][%s]"),
@@ -236,6 +239,21 @@ HRESULT GetCachedPolicyInfo(const std::string& raw_response,
 HRESULT GetCachedOmahaPolicy(const std::string& raw_response,
                              CachedOmahaPolicy* info);
 
+// Serializes |info| in the compact form which DmStorage caches next to the
+// PolicyFetchResponse that |info| was read from. |response_hash| is the hash
+// of that response.
+void SerializeCompiledOmahaPolicy(const CachedOmahaPolicy& info,
+                                  const std::vector<uint8>& response_hash,
+                                  std::vector<uint8>* compiled_policy);
+
+// Deserializes a policy serialized by SerializeCompiledOmahaPolicy(). Returns
+// E_UNEXPECTED if |compiled_policy| is malformed, has another format version,
+// or was not serialized for a response with the hash |response_hash|.
+HRESULT DeserializeCompiledOmahaPolicy(
+    const std::vector<uint8>& compiled_policy,
+    const std::vector<uint8>& response_hash,
+    CachedOmahaPolicy* info);
+
 CStringA SerializeRegisterBrowserRequest(const CStringA& machine_name,
                                          const CStringA& serial_number,
                                          const CStringA& os_platform,
@@ -220,4 +220,44 @@ TEST_F(DmMessagesTest, ValidateOmahaPolicyResponse_ErrorPolicyValues) {
                "{8A69D345-D564-463C-AFF1-A69D9E530F96} empty policy value");
 }
 
+TEST_F(DmMessagesTest, CompiledOmahaPolicy) {
+  enterprise_management::PolicyFetchResponse response;
+  FillFetchResponseWithValidOmahaPolicy(&response);
+  CachedOmahaPolicy policy;
+  ASSERT_HRESULT_SUCCEEDED(
+      GetCachedOmahaPolicy(response.SerializeAsString(), &policy));
+  policy.proxy_server = _T("proxy:8080");
+
+  const std::vector<uint8> response_hash(32, 0xab);
+  std::vector<uint8> compiled_policy;
+  SerializeCompiledOmahaPolicy(policy, response_hash, &compiled_policy);
+
+  CachedOmahaPolicy compiled;
+  ASSERT_HRESULT_SUCCEEDED(DeserializeCompiledOmahaPolicy(compiled_policy,
+                                                          response_hash,
+                                                          &compiled));
+  EXPECT_STREQ(policy.ToString(), compiled.ToString());
+
+  // A policy compiled from another response is not used.
+  const std::vector<uint8> other_hash(32, 0xcd);
+  EXPECT_EQ(E_UNEXPECTED, DeserializeCompiledOmahaPolicy(compiled_policy,
+                                                         other_hash,
+                                                         &compiled));
+
+  // Truncated and extended policies are rejected.
+  std::vector<uint8> truncated_policy(compiled_policy.begin(),
+                                      compiled_policy.end() - 1);
+  EXPECT_EQ(E_UNEXPECTED, DeserializeCompiledOmahaPolicy(truncated_policy,
+                                                         response_hash,
+                                                         &compiled));
+  std::vector<uint8> extended_policy(compiled_policy);
+  extended_policy.push_back(0);
+  EXPECT_EQ(E_UNEXPECTED, DeserializeCompiledOmahaPolicy(extended_policy,
+                                                         response_hash,
+                                                         &compiled));
+  EXPECT_EQ(E_UNEXPECTED, DeserializeCompiledOmahaPolicy(std::vector<uint8>(),
+                                                         response_hash,
+                                                         &compiled));
+}
+
 }  // namespace omaha
@@ -24,6 +24,7 @@
 #include "omaha/base/path.h"
 #include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/base/signatures.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/app_registry_utils.h"
@@ -177,6 +178,38 @@ HRESULT WriteToFile(const CPath& filename, const char* buf, const size_t len) {
   return file.SetLength(bytes_written, false);
 }
 
+// Reads the CachedOmahaPolicy in |compiled_policy_file| if it was compiled
+// from the PolicyFetchResponse with the hash |response_hash|.
+HRESULT ReadCompiledOmahaPolicy(const CPath& compiled_policy_file,
+                                const std::vector<byte>& response_hash,
+                                CachedOmahaPolicy* info) {
+  ASSERT1(info);
+
+  if (!File::Exists(compiled_policy_file)) {
+    return S_FALSE;
+  }
+
+  std::vector<byte> compiled_policy;
+  HRESULT hr = ReadEntireFileShareMode(compiled_policy_file,
+                                       0,
+                                       FILE_SHARE_READ,
+                                       &compiled_policy);
+  if (FAILED(hr)) {
+    REPORT_LOG(LW, (_T("[ReadCompiledOmahaPolicy][Read failed][%s][%#x]"),
+                    compiled_policy_file, hr));
+    return hr;
+  }
+
+  hr = DeserializeCompiledOmahaPolicy(compiled_policy, response_hash, info);
+  if (FAILED(hr)) {
+    REPORT_LOG(L1, (_T("[ReadCompiledOmahaPolicy][Stale][%s][%#x]"),
+                    compiled_policy_file, hr));
+    return hr;
+  }
+
+  return S_OK;
+}
+
 }  // namespace
 
 DmStorage* DmStorage::instance_ = NULL;
@@ -387,8 +420,9 @@ HRESULT DmStorage::ReadCachedOmahaPolicy(const CPath& policy_responses_dir,
                true);
 
   CString dirname(encoded_policy_response_dirname);
-  CPath policy_response_file(policy_responses_dir);
-  policy_response_file.Append(dirname);
+  CPath policy_response_dir(policy_responses_dir);
+  policy_response_dir.Append(dirname);
+  CPath policy_response_file(policy_response_dir);
   policy_response_file.Append(kPolicyResponseFileName);
   if (!File::Exists(policy_response_file)) {
     return S_FALSE;
@@ -405,6 +439,21 @@ HRESULT DmStorage::ReadCachedOmahaPolicy(const CPath& policy_responses_dir,
     return hr;
   }
 
+  CPath compiled_policy_file(policy_response_dir);
+  compiled_policy_file.Append(kCompiledOmahaPolicyFileName);
+
+  // The compiled policy is only used if it was compiled from this response.
+  // Any failure to use it falls back to parsing the response.
+  std::vector<byte> response_hash;
+  CryptoHash crypto_hash;
+  VERIFY_SUCCEEDED(crypto_hash.Compute(data, &response_hash));
+  if (!response_hash.empty() &&
+      SUCCEEDED(ReadCompiledOmahaPolicy(compiled_policy_file,
+                                        response_hash,
+                                        info))) {
+    return S_OK;
+  }
+
   std::string raw_response(reinterpret_cast<const char*>(&data[0]),
                            data.size());
   hr = GetCachedOmahaPolicy(raw_response, info);
@@ -415,6 +464,17 @@ HRESULT DmStorage::ReadCachedOmahaPolicy(const CPath& policy_responses_dir,
     return hr;
   }
 
+  if (!response_hash.empty()) {
+    std::vector<uint8> compiled_policy;
+    SerializeCompiledOmahaPolicy(*info, response_hash, &compiled_policy);
+
+    // If the compiled policy can't be saved, the response is parsed again
+    // the next time.
+    WriteToFile(compiled_policy_file,
+                reinterpret_cast<const char*>(&compiled_policy.front()),
+                compiled_policy.size());
+  }
+
   return S_OK;
 }
 
@@ -40,6 +40,11 @@ const TCHAR kPolicyResponseFileName[] = _T("PolicyFetchResponse");
 // responses.
 const TCHAR kCachedPolicyInfoFileName[] = _T("CachedPolicyInfo");
 
+// This is the name of the file that ReadCachedOmahaPolicy() uses to store the
+// CachedOmahaPolicy that it reads from the Omaha PolicyFetchResponse, next to
+// that response. The file is used as long as the response does not change.
+const TCHAR kCompiledOmahaPolicyFileName[] = _T("CompiledOmahaPolicy");
+
 // A handler for storage related to cloud-based device management of Omaha. This
 // class provides access to an enrollment token, a device management token, and
 // a device identifier.
@@ -130,7 +135,10 @@ class DmStorage {
 
   // Reads the information within the PolicyFetchResponse file within the
   // |policy_responses_dir|\{Base64Encoded{kGoogleUpdatePolicyType}} directory.
-  // Then calls on GetCachedOmahaPolicy() to populate |info|.
+  // Then calls on GetCachedOmahaPolicy() to populate |info|. The result is
+  // saved in the "CompiledOmahaPolicy" file in the same directory, along with
+  // the hash of the PolicyFetchResponse, and subsequent calls read |info| from
+  // that file until the PolicyFetchResponse changes.
   static HRESULT ReadCachedOmahaPolicy(const CPath& policy_responses_dir,
                                        CachedOmahaPolicy* info);
 
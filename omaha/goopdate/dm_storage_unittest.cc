@@ -20,6 +20,7 @@
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
+#include "omaha/common/config_manager.h"
 #include "omaha/goopdate/dm_messages.h"
 #include "omaha/goopdate/dm_storage_test_utils.h"
 #include "omaha/testing/unit_test.h"
@@ -399,6 +400,134 @@ TEST_F(DmStorageTest, IsInvalidDMToken) {
   ASSERT_NO_FATAL_FAILURE(DeleteDmToken());
 }
 
+TEST_F(DmStorageTest, ReadCachedOmahaPolicy_CompiledPolicy) {
+  EXPECT_HRESULT_SUCCEEDED(DmStorage::CreateInstance(CString()));
+  ON_SCOPE_EXIT(DmStorage::DeleteInstance);
+  EXPECT_HRESULT_SUCCEEDED(DmStorage::Instance()->StoreDmToken("dm_token"));
+
+  const CPath policy_responses_dir = CPath(ConcatenatePath(
+      app_util::GetCurrentModuleDirectory(),
+      _T("Policies")));
+  PolicyResponses responses = {
+    {{kGoogleUpdatePolicyType, CannedOmahaPolicyFetchResponse()}}, ""
+  };
+  ASSERT_HRESULT_SUCCEEDED(DmStorage::PersistPolicies(policy_responses_dir,
+                                                      responses));
+
+  CPath compiled_policy_file(GetPolicyResponseFilePath(
+      policy_responses_dir, kGoogleUpdatePolicyType));
+  compiled_policy_file.RemoveFileSpec();
+  compiled_policy_file.Append(kCompiledOmahaPolicyFileName);
+  EXPECT_FALSE(compiled_policy_file.FileExists());
+
+  CachedOmahaPolicy info;
+  EXPECT_EQ(S_OK,
+            DmStorage::ReadCachedOmahaPolicy(policy_responses_dir, &info));
+  CheckCannedCachedOmahaPolicy(info);
+  EXPECT_TRUE(compiled_policy_file.FileExists());
+
+  // The compiled policy is used while the response does not change.
+  std::vector<byte> compiled_policy;
+  ASSERT_HRESULT_SUCCEEDED(ReadEntireFileShareMode(
+      compiled_policy_file, 0, FILE_SHARE_READ, &compiled_policy));
+  CachedOmahaPolicy compiled_info;
+  EXPECT_EQ(S_OK, DmStorage::ReadCachedOmahaPolicy(policy_responses_dir,
+                                                   &compiled_info));
+  EXPECT_STREQ(info.ToString(), compiled_info.ToString());
+
+  // A corrupt compiled policy is replaced.
+  compiled_policy.resize(compiled_policy.size() / 2);
+  {
+    File file;
+    ASSERT_HRESULT_SUCCEEDED(file.Open(compiled_policy_file, true, false));
+    ASSERT_HRESULT_SUCCEEDED(file.WriteAt64(
+        0, &compiled_policy.front(),
+        static_cast<uint32>(compiled_policy.size()), NULL));
+    ASSERT_HRESULT_SUCCEEDED(file.SetLength64(compiled_policy.size()));
+  }
+  EXPECT_EQ(S_OK,
+            DmStorage::ReadCachedOmahaPolicy(policy_responses_dir, &info));
+  CheckCannedCachedOmahaPolicy(info);
+  uint64 compiled_policy_size = 0;
+  EXPECT_HRESULT_SUCCEEDED(File::GetFileSizeUnopen64(compiled_policy_file,
+                                                     &compiled_policy_size));
+  EXPECT_EQ(compiled_policy.size() * 2, compiled_policy_size);
+
+  // A new response is parsed again.
+  wireless_android_enterprise_devicemanagement::OmahaSettingsClientProto
+      omaha_settings;
+  omaha_settings.set_auto_update_check_period_minutes(222);
+  enterprise_management::PolicyData policy_data;
+  policy_data.set_policy_value(omaha_settings.SerializeAsString());
+  enterprise_management::PolicyFetchResponse response;
+  response.set_policy_data(policy_data.SerializeAsString());
+  responses.responses[kGoogleUpdatePolicyType] = response.SerializeAsString();
+  ASSERT_HRESULT_SUCCEEDED(DmStorage::PersistPolicies(policy_responses_dir,
+                                                      responses));
+  EXPECT_EQ(S_OK,
+            DmStorage::ReadCachedOmahaPolicy(policy_responses_dir, &info));
+  EXPECT_EQ(222, info.auto_update_check_period_minutes);
+  EXPECT_TRUE(info.application_settings.empty());
+
+  EXPECT_HRESULT_SUCCEEDED(DeleteDirectory(policy_responses_dir));
+  ASSERT_NO_FATAL_FAILURE(DeleteDmToken());
+}
+
+// Loads a policy with 500 applications by parsing the response, then from the
+// compiled policy.
+TEST_F(DmStorageTest, ReadCachedOmahaPolicy_ManyApps) {
+  EXPECT_HRESULT_SUCCEEDED(DmStorage::CreateInstance(CString()));
+  ON_SCOPE_EXIT(DmStorage::DeleteInstance);
+  EXPECT_HRESULT_SUCCEEDED(DmStorage::Instance()->StoreDmToken("dm_token"));
+
+  const int kNumApps = 500;
+  wireless_android_enterprise_devicemanagement::OmahaSettingsClientProto
+      omaha_settings;
+  omaha_settings.set_auto_update_check_period_minutes(111);
+  for (int i = 0; i != kNumApps; ++i) {
+    GUID app_guid = GUID_NULL;
+    ASSERT_HRESULT_SUCCEEDED(::CoCreateGuid(&app_guid));
+    wireless_android_enterprise_devicemanagement::ApplicationSettings* app =
+        omaha_settings.add_application_settings();
+    app->set_app_guid(CStringA(GuidToString(app_guid)));
+    app->set_update(
+        wireless_android_enterprise_devicemanagement::AUTOMATIC_UPDATES_ONLY);
+    app->set_target_version_prefix("3.6.55");
+    app->set_target_channel("beta");
+  }
+  enterprise_management::PolicyData policy_data;
+  policy_data.set_policy_value(omaha_settings.SerializeAsString());
+  enterprise_management::PolicyFetchResponse response;
+  response.set_policy_data(policy_data.SerializeAsString());
+
+  const CPath policy_responses_dir = CPath(ConcatenatePath(
+      app_util::GetCurrentModuleDirectory(),
+      _T("Policies")));
+  PolicyResponses responses = {
+    {{kGoogleUpdatePolicyType, response.SerializeAsString()}}, ""
+  };
+  ASSERT_HRESULT_SUCCEEDED(DmStorage::PersistPolicies(policy_responses_dir,
+                                                      responses));
+
+  // Loading the policies is what GoopdateImpl does at startup.
+  CachedOmahaPolicy info;
+  EXPECT_EQ(S_OK,
+            DmStorage::ReadCachedOmahaPolicy(policy_responses_dir, &info));
+  ConfigManager::Instance()->SetOmahaDMPolicies(info);
+  EXPECT_EQ(kNumApps, info.application_settings.size());
+
+  CachedOmahaPolicy compiled_info;
+  EXPECT_EQ(S_OK,
+            DmStorage::ReadCachedOmahaPolicy(policy_responses_dir,
+                                             &compiled_info));
+  ConfigManager::Instance()->SetOmahaDMPolicies(compiled_info);
+  EXPECT_EQ(kNumApps, compiled_info.application_settings.size());
+  ConfigManager::Instance()->SetOmahaDMPolicies(CachedOmahaPolicy());
+
+  EXPECT_HRESULT_SUCCEEDED(DeleteDirectory(policy_responses_dir));
+  ASSERT_NO_FATAL_FAILURE(DeleteDmToken());
+}
+
 // This test must access the true registry, so it doesn't use the DmStorageTest
 // fixture.
 TEST(DmStorageDeviceIdTest, GetDeviceId) {
@@ -0,0 +1,102 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/download_budget.h"
+
+#include <algorithm>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/time.h"
+
+namespace omaha {
+
+DownloadBudget::DownloadBudget(int max_connections, int max_bytes_per_sec)
+    : max_connections_(std::max(max_connections, 1)),
+      max_bytes_per_sec_(std::max(max_bytes_per_sec, 0)),
+      available_bytes_(max_bytes_per_sec_),
+      last_refill_ms_(GetCurrentMsTime()) {
+  ASSERT1(max_connections > 0);
+  ASSERT1(max_bytes_per_sec >= 0);
+}
+
+DownloadBudget::~DownloadBudget() {
+}
+
+HRESULT DownloadBudget::Initialize() {
+  CORE_LOG(L3, (_T("[DownloadBudget::Initialize][connections %d][bps %d]"),
+                max_connections_, max_bytes_per_sec_));
+
+  reset(connection_slots_,
+        ::CreateSemaphore(NULL, max_connections_, max_connections_, NULL));
+  return connection_slots_ ? S_OK : HRESULTFromLastError();
+}
+
+HRESULT DownloadBudget::AcquireConnection(HANDLE cancel_event) {
+  ASSERT1(connection_slots_);
+
+  HANDLE handles[] = { get(connection_slots_), cancel_event };
+  const DWORD num_handles = cancel_event ? arraysize(handles) : 1;
+  const DWORD result = ::WaitForMultipleObjects(num_handles,
+                                                handles,
+                                                false,
+                                                INFINITE);
+  switch (result) {
+    case WAIT_OBJECT_0:
+      return S_OK;
+    case WAIT_OBJECT_0 + 1:
+      return GOOPDATE_E_CANCELLED;
+    default:
+      return HRESULTFromLastError();
+  }
+}
+
+void DownloadBudget::ReleaseConnection() {
+  ASSERT1(connection_slots_);
+  VERIFY1(::ReleaseSemaphore(get(connection_slots_), 1, NULL));
+}
+
+int DownloadBudget::ConsumeBandwidth(int num_bytes) {
+  return ConsumeBandwidthAt(num_bytes, GetCurrentMsTime());
+}
+
+int DownloadBudget::ConsumeBandwidthAt(int num_bytes, uint64 now_ms) {
+  if (!max_bytes_per_sec_ || num_bytes <= 0) {
+    return 0;
+  }
+
+  __mutexScope(lock_);
+
+  // The clock may move backwards when the system time is adjusted. In that
+  // case, restart the refill period from the current time.
+  if (now_ms > last_refill_ms_) {
+    const uint64 elapsed_ms = now_ms - last_refill_ms_;
+    available_bytes_ = std::min<int64>(
+        available_bytes_ + elapsed_ms * max_bytes_per_sec_ / 1000,
+        max_bytes_per_sec_);
+  }
+  last_refill_ms_ = now_ms;
+
+  available_bytes_ -= num_bytes;
+  if (available_bytes_ >= 0) {
+    return 0;
+  }
+
+  const int64 delay_ms = -available_bytes_ * 1000 / max_bytes_per_sec_;
+  return static_cast<int>(std::min<int64>(delay_ms, kMaxPacingDelayMs));
+}
+
+}  // namespace omaha
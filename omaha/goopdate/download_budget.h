@@ -0,0 +1,104 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// DownloadBudget bounds the number of app downloads that can be in flight at
+// the same time and the aggregate rate at which package bytes are transferred.
+// The budget is shared by all the bundles the worker is processing.
+
+#ifndef OMAHA_GOOPDATE_DOWNLOAD_BUDGET_H_
+#define OMAHA_GOOPDATE_DOWNLOAD_BUDGET_H_
+
+#include <windows.h>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class DownloadBudget {
+ public:
+  // |max_connections| must be positive. A |max_bytes_per_sec| value of zero
+  // means that the bandwidth is not limited.
+  DownloadBudget(int max_connections, int max_bytes_per_sec);
+  ~DownloadBudget();
+
+  HRESULT Initialize();
+
+  int max_connections() const { return max_connections_; }
+  int max_bytes_per_sec() const { return max_bytes_per_sec_; }
+
+  // Blocks until a connection slot is available. Returns GOOPDATE_E_CANCELLED
+  // if |cancel_event| is signaled before a slot is available. |cancel_event|
+  // can be NULL. Each successful call must be matched by a call to
+  // ReleaseConnection.
+  HRESULT AcquireConnection(HANDLE cancel_event);
+  void ReleaseConnection();
+
+  // Records that |num_bytes| have been transferred and returns how many
+  // milliseconds the caller should wait before transferring more bytes to
+  // stay within the bandwidth budget. The returned value is capped to
+  // kMaxPacingDelayMs so that callers remain responsive to cancellation.
+  int ConsumeBandwidth(int num_bytes);
+
+  static const int kMaxPacingDelayMs = 1000;
+
+ private:
+  int ConsumeBandwidthAt(int num_bytes, uint64 now_ms);
+
+  const int max_connections_;
+  const int max_bytes_per_sec_;
+
+  scoped_semaphore connection_slots_;
+
+  // Token bucket for the bandwidth budget. The bucket holds up to one second
+  // worth of bytes and it goes negative when the transfer is ahead of budget.
+  LLock lock_;
+  int64 available_bytes_;
+  uint64 last_refill_ms_;
+
+  friend class DownloadBudgetTest;
+
+  DISALLOW_COPY_AND_ASSIGN(DownloadBudget);
+};
+
+// Holds a connection slot of a DownloadBudget for the lifetime of the object.
+class ScopedDownloadConnection {
+ public:
+  ScopedDownloadConnection(DownloadBudget* budget, HANDLE cancel_event)
+      : budget_(budget), hr_(S_OK) {
+    if (budget_) {
+      hr_ = budget_->AcquireConnection(cancel_event);
+    }
+  }
+
+  ~ScopedDownloadConnection() {
+    if (budget_ && SUCCEEDED(hr_)) {
+      budget_->ReleaseConnection();
+    }
+  }
+
+  HRESULT result() const { return hr_; }
+
+ private:
+  DownloadBudget* budget_;
+  HRESULT hr_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedDownloadConnection);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_DOWNLOAD_BUDGET_H_
@@ -0,0 +1,132 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/download_budget.h"
+#include "omaha/base/error.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class DownloadBudgetTest : public testing::Test {
+ protected:
+  static int ConsumeBandwidthAt(DownloadBudget* budget,
+                                int num_bytes,
+                                uint64 now_ms) {
+    return budget->ConsumeBandwidthAt(num_bytes, now_ms);
+  }
+
+  static uint64 last_refill_ms(const DownloadBudget& budget) {
+    return budget.last_refill_ms_;
+  }
+};
+
+TEST_F(DownloadBudgetTest, UnlimitedBandwidth) {
+  DownloadBudget budget(1, 0);
+  EXPECT_EQ(0, budget.max_bytes_per_sec());
+  EXPECT_EQ(0, budget.ConsumeBandwidth(100 * 1024 * 1024));
+  EXPECT_EQ(0, budget.ConsumeBandwidth(100 * 1024 * 1024));
+}
+
+TEST_F(DownloadBudgetTest, ConsumeBandwidth) {
+  DownloadBudget budget(1, 1000);
+  const uint64 start_ms = last_refill_ms(budget);
+
+  // The bucket starts with one second worth of bytes.
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, 500, start_ms));
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, 500, start_ms));
+
+  // The transfer is ahead of the budget by 500 bytes.
+  EXPECT_EQ(500, ConsumeBandwidthAt(&budget, 500, start_ms));
+
+  // After 500 ms the bucket is empty again.
+  EXPECT_EQ(100, ConsumeBandwidthAt(&budget, 100, start_ms + 500));
+
+  // The bucket does not refill beyond its capacity.
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, 1000, start_ms + 60000));
+  EXPECT_EQ(1, ConsumeBandwidthAt(&budget, 1, start_ms + 60000));
+}
+
+TEST_F(DownloadBudgetTest, ConsumeBandwidth_DelayIsCapped) {
+  DownloadBudget budget(1, 1000);
+  const uint64 start_ms = last_refill_ms(budget);
+
+  EXPECT_EQ(DownloadBudget::kMaxPacingDelayMs,
+            ConsumeBandwidthAt(&budget, 100000, start_ms));
+}
+
+TEST_F(DownloadBudgetTest, ConsumeBandwidth_ClockMovesBackwards) {
+  DownloadBudget budget(1, 1000);
+  const uint64 start_ms = last_refill_ms(budget);
+
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, 1000, start_ms + 1000));
+  EXPECT_EQ(200, ConsumeBandwidthAt(&budget, 200, start_ms));
+  EXPECT_EQ(100, ConsumeBandwidthAt(&budget, 100, start_ms + 200));
+}
+
+TEST_F(DownloadBudgetTest, ConsumeBandwidth_IgnoresEmptyTransfers) {
+  DownloadBudget budget(1, 1000);
+  const uint64 start_ms = last_refill_ms(budget);
+
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, 0, start_ms));
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, -10, start_ms));
+  EXPECT_EQ(0, ConsumeBandwidthAt(&budget, 1000, start_ms));
+}
+
+TEST_F(DownloadBudgetTest, AcquireConnection) {
+  DownloadBudget budget(2, 0);
+  ASSERT_SUCCEEDED(budget.Initialize());
+  EXPECT_EQ(2, budget.max_connections());
+
+  scoped_event cancel_event(::CreateEvent(NULL, true, false, NULL));
+  ASSERT_TRUE(cancel_event);
+
+  EXPECT_SUCCEEDED(budget.AcquireConnection(get(cancel_event)));
+  EXPECT_SUCCEEDED(budget.AcquireConnection(NULL));
+
+  // All the connections are in use.
+  EXPECT_TRUE(::SetEvent(get(cancel_event)));
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, budget.AcquireConnection(get(cancel_event)));
+
+  budget.ReleaseConnection();
+  EXPECT_SUCCEEDED(budget.AcquireConnection(NULL));
+
+  budget.ReleaseConnection();
+  budget.ReleaseConnection();
+}
+
+TEST_F(DownloadBudgetTest, ScopedDownloadConnection) {
+  DownloadBudget budget(1, 0);
+  ASSERT_SUCCEEDED(budget.Initialize());
+
+  scoped_event cancel_event(::CreateEvent(NULL, true, true, NULL));
+  ASSERT_TRUE(cancel_event);
+
+  {
+    ScopedDownloadConnection connection(&budget, get(cancel_event));
+    EXPECT_SUCCEEDED(connection.result());
+
+    ScopedDownloadConnection no_connection(&budget, get(cancel_event));
+    EXPECT_EQ(GOOPDATE_E_CANCELLED, no_connection.result());
+  }
+
+  // The connection has been released when the scope ended.
+  ScopedDownloadConnection connection(&budget, get(cancel_event));
+  EXPECT_SUCCEEDED(connection.result());
+
+  ScopedDownloadConnection null_budget(NULL, NULL);
+  EXPECT_SUCCEEDED(null_budget.result());
+}
+
+}  // namespace omaha
@@ -26,22 +26,26 @@
 #include <shlwapi.h>
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
+#include "omaha/base/thread_pool.h"
 #include "omaha/base/user_rights.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/google_signaturevalidator.h"
+#include "omaha/goopdate/download_budget.h"
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/package_cache.h"
 #include "omaha/goopdate/server_resource.h"
@@ -94,20 +98,17 @@ HRESULT CreateNetworkRequest(NetworkRequest** network_request_ptr) {
   return S_OK;
 }
 
-// TODO(omaha): Unit test this method.
-HRESULT ValidateSize(File* source_file, uint64 expected_size) {
-  CORE_LOG(L3, (_T("[ValidateSize][%lld]"), expected_size));
-  ASSERT1(source_file);
-  ASSERT1(expected_size != 0);
-  ASSERT(expected_size <= UINT_MAX,
-         (_T("TODO(omaha): Add uint64 support to GetFileSizeUnopen().")));
+// The packages of an offline install are cached by up to this many threads.
+const int kMaxOfflinePackageThreads = 4;
 
-  uint32 file_size(0);
-  HRESULT hr = source_file->GetLength(&file_size);
-  ASSERT1(SUCCEEDED(hr));
-  if (FAILED(hr)) {
-    return hr;
-  }
+// How long the cacher waits for its threads to return after all packages have
+// been cached. The threads have no work left at that point.
+const int kThreadPoolShutdownDelayMs = 60000;
+
+HRESULT ValidateFileSize(uint64 file_size, uint64 expected_size) {
+  CORE_LOG(L3, (_T("[ValidateFileSize][%llu][%llu]"),
+                file_size, expected_size));
+  ASSERT1(expected_size != 0);
 
   if (0 == file_size) {
     return GOOPDATEDOWNLOAD_E_FILE_SIZE_ZERO;
@@ -121,6 +122,20 @@ HRESULT ValidateSize(File* source_file, uint64 expected_size) {
   return S_OK;
 }
 
+// TODO(omaha): Unit test this method.
+HRESULT ValidateSize(File* source_file, uint64 expected_size) {
+  ASSERT1(source_file);
+
+  uint64 file_size(0);
+  HRESULT hr = source_file->GetLength64(&file_size);
+  ASSERT1(SUCCEEDED(hr));
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return ValidateFileSize(file_size, expected_size);
+}
+
 // Adds the corresponding EVENT_{INSTALL,UPDATE}_DOWNLOAD_FINISH ping events
 // for the |download_metrics| provided as a parameter.
 void AddDownloadMetricsPingEvents(
@@ -138,10 +153,240 @@ void AddDownloadMetricsPingEvents(
   }
 }
 
+// Paces the transfers of a network request so that the downloads stay within
+// the bandwidth budget.
+class BudgetedPacer : public NetworkRequestPacer {
+ public:
+  explicit BudgetedPacer(DownloadBudget* download_budget)
+      : download_budget_(download_budget) {
+    ASSERT1(download_budget);
+  }
+
+  virtual int OnBytesReceived(int num_bytes) {
+    const int delay_ms = download_budget_->ConsumeBandwidth(num_bytes);
+    if (delay_ms > 0) {
+      CORE_LOG(L5, (_T("[BudgetedPacer][pacing %d ms]"), delay_ms));
+    }
+    return delay_ms;
+  }
+
+ private:
+  DownloadBudget* download_budget_;
+
+  DISALLOW_COPY_AND_ASSIGN(BudgetedPacer);
+};
+
 }  // namespace
 
+// Caches the packages of an offline install. The packages are claimed in
+// order by the threads of a pool and by the calling thread, and the progress
+// is logged as the packages complete.
+class DownloadManager::OfflinePackageCacher {
+ public:
+  OfflinePackageCacher(DownloadManager* download_manager,
+                       bool move_files,
+                       bool verify_signatures)
+      : download_manager_(download_manager),
+        move_files_(move_files),
+        verify_signatures_(verify_signatures),
+        next_index_(0),
+        num_packages_left_(0),
+        num_done_(0),
+        bytes_cached_(0),
+        num_moved_(0) {
+    ASSERT1(download_manager);
+  }
+
+  ~OfflinePackageCacher() {
+    thread_pool_.Stop();
+  }
+
+  void AddPackage(const Package* package, const CString& file_path) {
+    ASSERT1(package);
+
+    OfflinePackage offline_package;
+    offline_package.app_id = package->app_version()->app()->app_guid_string();
+    offline_package.version = package->app_version()->version();
+    offline_package.package_name = package->filename();
+    offline_package.expected_hash = package->expected_hash();
+    offline_package.expected_size = package->expected_size();
+    offline_package.file_path = file_path;
+    packages_.push_back(offline_package);
+  }
+
+  // Caches the packages and returns when all of them have been processed.
+  void Run() {
+    if (packages_.empty()) {
+      return;
+    }
+
+    num_packages_left_ = static_cast<LONG>(packages_.size());
+    reset(done_event_, ::CreateEvent(NULL, true, false, NULL));
+    if (!valid(done_event_)) {
+      CORE_LOG(LE, (_T("[CreateEvent failed][0x%08x]"),
+                    HRESULTFromLastError()));
+      CachePackages();
+      return;
+    }
+
+    const int num_threads = static_cast<int>(std::min<size_t>(
+        packages_.size(), kMaxOfflinePackageThreads)) - 1;
+    if (num_threads > 0 &&
+        SUCCEEDED(thread_pool_.Initialize(kThreadPoolShutdownDelayMs))) {
+      for (int i = 0; i != num_threads; ++i) {
+        // WT_EXECUTELONGFUNCTION causes the thread pool to use multiple
+        // threads.
+        HRESULT hr = thread_pool_.QueueUserWorkItem(
+            std::make_unique<CacheWorkItem>(this),
+            COINIT_MULTITHREADED,
+            WT_EXECUTELONGFUNCTION);
+        if (FAILED(hr)) {
+          CORE_LOG(LE, (_T("[QueueUserWorkItem failed][0x%08x]"), hr));
+          break;
+        }
+      }
+    }
+
+    CachePackages();
+    VERIFY1(::WaitForSingleObject(get(done_event_), INFINITE) ==
+            WAIT_OBJECT_0);
+  }
+
+  size_t num_packages() const { return packages_.size(); }
+  HRESULT result(size_t index) const { return packages_[index].hr; }
+  uint64 file_size(size_t index) const { return packages_[index].file_size; }
+  uint64 expected_size(size_t index) const {
+    return packages_[index].expected_size;
+  }
+  uint64 bytes_cached() const { return bytes_cached_; }
+  int num_moved() const { return num_moved_; }
+
+ private:
+  struct OfflinePackage {
+    OfflinePackage() : expected_size(0), file_size(0), hr(E_UNEXPECTED) {}
+
+    CString app_id;
+    CString version;
+    CString package_name;
+    CString expected_hash;
+    uint64 expected_size;
+    CString file_path;
+    uint64 file_size;
+    HRESULT hr;
+  };
+
+  class CacheWorkItem : public UserWorkItem {
+   public:
+    explicit CacheWorkItem(OfflinePackageCacher* cacher) : cacher_(cacher) {
+      ASSERT1(cacher);
+    }
+
+   private:
+    virtual void DoProcess() {
+      cacher_->CachePackages();
+    }
+
+    OfflinePackageCacher* cacher_;
+
+    DISALLOW_COPY_AND_ASSIGN(CacheWorkItem);
+  };
+
+  // Caches packages until all packages have been claimed.
+  void CachePackages() {
+    for (;;) {
+      const size_t index =
+          static_cast<size_t>(::InterlockedIncrement(&next_index_) - 1);
+      if (index >= packages_.size()) {
+        return;
+      }
+
+      bool is_moved = false;
+      CachePackage(&packages_[index], &is_moved);
+      ReportProgress(packages_[index], is_moved);
+
+      if (!::InterlockedDecrement(&num_packages_left_) &&
+          valid(done_event_)) {
+        VERIFY1(::SetEvent(get(done_event_)));
+      }
+    }
+  }
+
+  void CachePackage(OfflinePackage* offline_package, bool* is_moved) {
+    ASSERT1(offline_package);
+    ASSERT1(is_moved);
+
+    HRESULT hr = File::GetFileSizeUnopen64(offline_package->file_path,
+                                           &offline_package->file_size);
+    if (FAILED(hr)) {
+      offline_package->hr = hr;
+      return;
+    }
+
+    if (verify_signatures_) {
+      hr = download_manager_->EnsureSignatureIsValid(
+          offline_package->file_path);
+      if (FAILED(hr)) {
+        CORE_LOG(LE, (_T("[EnsureSignatureIsValid failed][%s][0x%08x]"),
+                      offline_package->package_name, hr));
+        offline_package->hr =
+            GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED;
+        return;
+      }
+    }
+
+    PackageCache::Key key(offline_package->app_id,
+                          offline_package->version,
+                          offline_package->package_name);
+    offline_package->hr = download_manager_->package_cache()->PutFile(
+        key,
+        offline_package->file_path,
+        offline_package->expected_hash,
+        move_files_,
+        is_moved);
+  }
+
+  void ReportProgress(const OfflinePackage& offline_package, bool is_moved) {
+    __mutexScope(lock_);
+
+    ++num_done_;
+    if (SUCCEEDED(offline_package.hr)) {
+      bytes_cached_ += offline_package.file_size;
+      if (is_moved) {
+        ++num_moved_;
+      }
+    }
+
+    CORE_LOG(L3, (_T("[OfflinePackageCacher][%Iu of %Iu][%s][%s][0x%08x]")
+                  _T("[%llu bytes cached]"),
+                  num_done_, packages_.size(), offline_package.app_id,
+                  offline_package.package_name, offline_package.hr,
+                  bytes_cached_));
+  }
+
+  DownloadManager* download_manager_;
+  const bool move_files_;
+  const bool verify_signatures_;
+
+  std::vector<OfflinePackage> packages_;
+
+  volatile LONG next_index_;
+  volatile LONG num_packages_left_;
+
+  // Signaled when the last package has been processed.
+  scoped_event done_event_;
+
+  LLock lock_;
+  size_t num_done_;
+  uint64 bytes_cached_;
+  int num_moved_;
+
+  ThreadPool thread_pool_;
+
+  DISALLOW_COPY_AND_ASSIGN(OfflinePackageCacher);
+};
+
 DownloadManager::DownloadManager(bool is_machine)
-    : lock_(NULL), is_machine_(false) {
+    : lock_(NULL), is_machine_(false), download_budget_(NULL) {
   CORE_LOG(L3, (_T("[DownloadManager::DownloadManager]")));
 
   omaha::interlocked_exchange_pointer(&lock_,
@@ -193,6 +438,12 @@ const PackageCache* DownloadManager::package_cache() const {
   return package_cache_.get();
 }
 
+void DownloadManager::set_download_budget(DownloadBudget* download_budget) {
+  __mutexScope(lock());
+  ASSERT1(download_state_.empty());
+  download_budget_ = download_budget;
+}
+
 HRESULT DownloadManager::Initialize() {
   HRESULT hr = package_cache()->Initialize(package_cache_root());
   if (FAILED(hr)) {
@@ -263,9 +514,23 @@ HRESULT DownloadManager::DownloadApp(App* app) {
   app->Downloading();
 
   CString message;
-  hr = S_OK;
 
-  for (size_t i = 0; i < num_packages; ++i) {
+  // The connections are shared by all the downloads of the process. This is a
+  // blocking call if the budget has no connections available, until a
+  // connection is released or the download is canceled.
+  DownloadBudget* download_budget = NULL;
+  __mutexBlock(lock()) {
+    download_budget = download_budget_;
+  }
+  ScopedDownloadConnection connection(download_budget, state->cancel_event());
+  hr = connection.result();
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[AcquireConnection failed][0x%08x]"), hr));
+    message = GetMessageForError(ErrorContext(hr, error_extra_code1()),
+                                 app->app_bundle()->display_language());
+  }
+
+  for (size_t i = 0; SUCCEEDED(hr) && i < num_packages; ++i) {
     Package* package(app_version->GetPackage(i));
     hr = DoDownloadPackage(package, state);
     if (FAILED(hr)) {
@@ -382,15 +647,51 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
     }
 
     NetworkRequest* network_request = state->network_request();
-
     network_request->set_callback(package);
 
+    std::unique_ptr<BudgetedPacer> budgeted_pacer;
+    __mutexBlock(lock()) {
+      if (download_budget_ && download_budget_->max_bytes_per_sec()) {
+        budgeted_pacer.reset(new BudgetedPacer(download_budget_));
+      }
+    }
+    network_request->set_pacer(budgeted_pacer.get());
+
     const std::vector<CString> download_base_urls(
         package->app_version()->download_base_urls());
 
     hr = E_FAIL;
+    uint64 bytes_downloaded = package->expected_size();
     app->SetCurrentTimeAs(App::TIME_DOWNLOAD_START);
-    for (size_t i = 0; i != download_base_urls.size(); ++i) {
+
+    // Downloads the patch from the installed version if the package of that
+    // version is still cached. The package is downloaded if the patch can't
+    // be downloaded or applied.
+    const CString base_version(app->current_version()->version());
+    if (package->has_diff() &&
+        !base_version.IsEmpty() &&
+        base_version != version &&
+        package_cache()->Exists(
+            PackageCache::Key(app_id, base_version, package_name))) {
+      ++metric_worker_download_diff_total;
+      hr = DoDownloadDiffPackage(base_version, package, state);
+      if (SUCCEEDED(hr)) {
+        ++metric_worker_download_diff_succeeded;
+        bytes_downloaded = package->diff_expected_size();
+        if (package->expected_size() > bytes_downloaded) {
+          metric_worker_download_diff_bytes_saved +=
+              package->expected_size() - bytes_downloaded;
+        }
+      } else if (hr != GOOPDATE_E_CANCELLED) {
+        ++metric_worker_download_diff_failed;
+        CORE_LOG(LW, (_T("[DoDownloadDiffPackage failed][0x%08x]"), hr));
+      }
+    }
+
+    for (size_t i = 0;
+         FAILED(hr) && hr != GOOPDATE_E_CANCELLED &&
+             i != download_base_urls.size();
+         ++i) {
       CString url;
       DWORD url_length(INTERNET_MAX_URL_LENGTH);
       hr = ::UrlCombine(download_base_urls[i],
@@ -413,6 +714,7 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
     }
 
     VERIFY_SUCCEEDED(network_request->Close());
+    network_request->set_pacer(NULL);
     DeleteBeforeOrAfterReboot(unique_filename_path);
     app->SetCurrentTimeAs(App::TIME_DOWNLOAD_COMPLETE);
 
@@ -421,8 +723,9 @@ HRESULT DownloadManager::DoDownloadPackage(Package* package, State* state) {
       return hr;
     }
 
-    // Assumes that downloaded bytes equal to the expected package size.
-    app->UpdateNumBytesDownloaded(package->expected_size());
+    // Assumes that downloaded bytes equal to the expected package size, or to
+    // the expected patch size if the package was patched.
+    app->UpdateNumBytesDownloaded(bytes_downloaded);
   } else {
     OPT_LOG(L3, (_T("[package is cached]")));
 
@@ -489,6 +792,103 @@ HRESULT DownloadManager::DoDownloadPackageFromUrl(const CString& url,
   return hr;
 }
 
+HRESULT DownloadManager::DoDownloadDiffPackage(const CString& base_version,
+                                               Package* package,
+                                               State* state) {
+  ASSERT1(package);
+  ASSERT1(state);
+
+  App* app = package->app_version()->app();
+  const CString diff_name(package->diff_filename());
+  const PackageCache::Key base_key(app->app_guid_string(),
+                                   base_version,
+                                   package->filename());
+
+  OPT_LOG(L3, (_T("[DownloadManager::DoDownloadDiffPackage][%s][%s]"),
+               diff_name, base_key.ToString()));
+
+  CString patch_path;
+  HRESULT hr = BuildUniqueFileName(diff_name, &patch_path);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  NetworkRequest* network_request = state->network_request();
+  const std::vector<CString> download_base_urls(
+      package->app_version()->download_base_urls());
+
+  hr = E_FAIL;
+  for (size_t i = 0; i != download_base_urls.size(); ++i) {
+    CString url;
+    DWORD url_length(INTERNET_MAX_URL_LENGTH);
+    hr = ::UrlCombine(download_base_urls[i],
+                      diff_name,
+                      CStrBuf(url, INTERNET_MAX_URL_LENGTH),
+                      &url_length,
+                      0);
+    if (FAILED(hr)) {
+      continue;
+    }
+
+    OPT_LOG(L3, (_T("[starting download][from '%s'][to '%s']"),
+                 url, patch_path));
+    hr = network_request->DownloadFile(url, patch_path);
+    AddDownloadMetricsPingEvents(network_request->download_metrics(), app);
+    if (SUCCEEDED(hr)) {
+      app->set_source_url_index(static_cast<int>(i));
+      break;
+    }
+    OPT_LOG(LE, (_T("[DownloadFile failed][%#x]"), hr));
+    if (hr == GOOPDATE_E_CANCELLED) {
+      break;
+    }
+  }
+
+  CString patched_path;
+  if (SUCCEEDED(hr)) {
+    hr = BuildUniqueFileName(package->filename(), &patched_path);
+  }
+
+  // As for a downloaded package, the files are opened as the impersonated
+  // user and only the package cache is accessed as self. The patch is opened
+  // before its hash is verified, so that it can't be changed afterwards.
+  if (SUCCEEDED(hr)) {
+    File patch_file;
+    File patched_file;
+    hr = patch_file.OpenShareMode(patch_path, false, false, FILE_SHARE_READ);
+    if (SUCCEEDED(hr)) {
+      hr = PackageCache::VerifyHash(patch_path, package->diff_expected_hash());
+    }
+    if (SUCCEEDED(hr)) {
+      hr = patched_file.Open(patched_path, true, false);
+    }
+    if (SUCCEEDED(hr)) {
+      scoped_revert_to_self revert_to_self;
+      hr = package_cache()->ApplyPatch(base_key, &patch_file, &patched_file);
+    }
+  }
+
+  // The patched package is verified and cached like a downloaded package.
+  if (SUCCEEDED(hr)) {
+    File source_file;
+    hr = source_file.OpenShareMode(patched_path, false, false, FILE_SHARE_READ);
+    if (SUCCEEDED(hr)) {
+      hr = CallAsSelfAndImpersonate3(this,
+                                     &DownloadManager::CachePackage,
+                                     static_cast<const Package*>(package),
+                                     &source_file,
+                                     &patched_path);
+    }
+  }
+
+  VERIFY_SUCCEEDED(network_request->Close());
+  DeleteBeforeOrAfterReboot(patch_path);
+  if (!patched_path.IsEmpty()) {
+    DeleteBeforeOrAfterReboot(patched_path);
+  }
+
+  return hr;
+}
 
 void DownloadManager::Cancel(App* app) {
   CORE_LOG(L3, (_T("[DownloadManager::Cancel][0x%p]"), app));
@@ -567,6 +967,61 @@ HRESULT DownloadManager::CachePackage(const Package* package,
   return hr;
 }
 
+HRESULT DownloadManager::CacheOfflinePackages(
+    const std::vector<const Package*>& packages,
+    const std::vector<CString>& file_paths,
+    bool move_files,
+    size_t* failed_index) {
+  CORE_LOG(L3, (_T("[DownloadManager::CacheOfflinePackages][%Iu][%d]"),
+                packages.size(), move_files));
+  ASSERT1(packages.size() == file_paths.size());
+  ASSERT1(failed_index);
+
+  *failed_index = 0;
+
+  OfflinePackageCacher cacher(
+      this,
+      move_files,
+      ConfigManager::Instance()->ShouldVerifyPayloadAuthenticodeSignature());
+  for (size_t i = 0; i != packages.size(); ++i) {
+    cacher.AddPackage(packages[i], file_paths[i]);
+  }
+
+  HighresTimer cache_timer;
+  cacher.Run();
+  const int elapsed_ms = static_cast<int>(cache_timer.GetElapsedMs());
+  metric_offline_packages_cached_ms.AddSample(elapsed_ms);
+
+  CORE_LOG(L2, (_T("[CacheOfflinePackages][%Iu packages][%llu bytes]")
+                _T("[%d moved][%d ms][%.1f MB/s]"),
+                cacher.num_packages(), cacher.bytes_cached(),
+                cacher.num_moved(), elapsed_ms,
+                elapsed_ms ? cacher.bytes_cached() / 1000.0 / elapsed_ms : 0));
+
+  for (size_t i = 0; i != cacher.num_packages(); ++i) {
+    HRESULT hr = cacher.result(i);
+    if (SUCCEEDED(hr)) {
+      continue;
+    }
+
+    *failed_index = i;
+    if (hr == GOOPDATEDOWNLOAD_E_AUTHENTICODE_VERIFICATION_FAILED) {
+      return hr;
+    }
+    if (hr != SIGS_E_INVALID_SIGNATURE) {
+      set_error_extra_code1(static_cast<int>(hr));
+      return GOOPDATEDOWNLOAD_E_CACHING_FAILED;
+    }
+
+    // Get a more specific error if possible.
+    HRESULT size_hr = ValidateFileSize(cacher.file_size(i),
+                                       cacher.expected_size(i));
+    return FAILED(size_hr) ? size_hr : hr;
+  }
+
+  return S_OK;
+}
+
 HRESULT DownloadManager::EnsureSignatureIsValid(const CString& file_path) {
   const TCHAR* ext = ::PathFindExtension(file_path);
   ASSERT1(ext);
@@ -663,6 +1118,9 @@ DownloadManager::State::State(App* app, NetworkRequest* network_request)
     : app_(app), network_request_(network_request) {
   ASSERT1(app);
   ASSERT1(network_request);
+
+  reset(cancel_event_, ::CreateEvent(NULL, true, false, NULL));
+  ASSERT1(valid(cancel_event_));
 }
 
 DownloadManager::State::~State() {
@@ -676,6 +1134,9 @@ NetworkRequest* DownloadManager::State::network_request() const {
 }
 
 HRESULT DownloadManager::State::CancelNetworkRequest() {
+  if (cancel_event_) {
+    VERIFY1(::SetEvent(get(cancel_event_)));
+  }
   return network_request_->Cancel();
 }
 
@@ -22,10 +22,12 @@
 #include <vector>
 
 #include "base/basictypes.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 namespace omaha {
 
 class App;
+class DownloadBudget;
 struct ErrorContext;
 class File;
 class HttpClient;
@@ -44,6 +46,11 @@ class DownloadManagerInterface {
   virtual HRESULT CachePackage(const Package* package,
                                File* source_file,
                                const CString* source_file_path) = 0;
+  virtual HRESULT CacheOfflinePackages(
+      const std::vector<const Package*>& packages,
+      const std::vector<CString>& file_paths,
+      bool move_files,
+      size_t* failed_index) = 0;
   virtual HRESULT DownloadApp(App* app) = 0;
   virtual HRESULT GetPackage(const Package* package,
                              const CString& dir) const = 0;
@@ -67,6 +74,18 @@ class DownloadManager : public DownloadManagerInterface {
                                File* source_file,
                                const CString* source_file_path);
 
+  // Caches the packages of an offline install from the files at the same
+  // index in |file_paths|. The packages are hashed while they are copied, on
+  // several threads. The files are moved instead of copied if |move_files| is
+  // true and they are on the same volume as the cache. Returns the error and
+  // the index of the first package which could not be cached in
+  // |failed_index|.
+  virtual HRESULT CacheOfflinePackages(
+      const std::vector<const Package*>& packages,
+      const std::vector<CString>& file_paths,
+      bool move_files,
+      size_t* failed_index);
+
   // Downloads the specified app and stores its packages in the package cache.
   //
   // This is a blocking call. All errors are reported through the return value.
@@ -96,6 +115,11 @@ class DownloadManager : public DownloadManagerInterface {
   static CString GetMessageForError(const ErrorContext& error_context,
                                     const CString& language);
 
+  // Sets the budget used to pace the package downloads. The budget is not
+  // owned by this object and it must outlive it. Must be called before
+  // starting any downloads.
+  void set_download_budget(DownloadBudget* download_budget);
+
  private:
   // Maintains per-app download state.
   class State {
@@ -107,6 +131,9 @@ class DownloadManager : public DownloadManagerInterface {
 
     NetworkRequest* network_request() const;
 
+    // Returns the event which is signaled when the download is canceled.
+    HANDLE cancel_event() const { return get(cancel_event_); }
+
     HRESULT CancelNetworkRequest();
 
    private:
@@ -115,9 +142,13 @@ class DownloadManager : public DownloadManagerInterface {
 
     std::unique_ptr<NetworkRequest> network_request_;
 
+    scoped_event cancel_event_;
+
     DISALLOW_COPY_AND_ASSIGN(State);
   };
 
+  class OfflinePackageCacher;
+
   // Creates a download state corresponding to the app. The state object is
   // owned by the download manager. A pointer to the state object is returned
   // to the caller.
@@ -131,6 +162,13 @@ class DownloadManager : public DownloadManagerInterface {
                                    Package* package,
                                    State* state);
 
+  // Downloads the patch of the package and applies it to the cached package of
+  // |base_version|, then caches the patched package. The patched package is
+  // verified like a downloaded package.
+  HRESULT DoDownloadDiffPackage(const CString& base_version,
+                                Package* package,
+                                State* state);
+
   HRESULT EnsureSignatureIsValid(const CString& file_path);
 
   bool is_machine() const;
@@ -159,6 +197,9 @@ class DownloadManager : public DownloadManagerInterface {
 
   std::unique_ptr<PackageCache> package_cache_;
 
+  // Paces the downloads to the bandwidth budget. Can be NULL.
+  DownloadBudget* download_budget_;
+
   friend class DownloadManagerTest;
   DISALLOW_COPY_AND_ASSIGN(DownloadManager);
 };
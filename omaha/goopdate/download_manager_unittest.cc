@@ -16,6 +16,8 @@
 // TODO(omaha): why so many dependencies for this unit test?
 
 #include <atlstr.h>
+#include <algorithm>
+#include <map>
 #include <vector>
 #include <windows.h>
 
@@ -34,7 +36,11 @@
 #include "omaha/goopdate/app_state_checking_for_update.h"
 #include "omaha/goopdate/app_state_waiting_to_download.h"
 #include "omaha/goopdate/app_unittest_base.h"
+#include "omaha/goopdate/delta_patch.h"
 #include "omaha/goopdate/download_manager.h"
+#include "omaha/goopdate/package_cache.h"
+#include "omaha/goopdate/worker_metrics.h"
+#include "omaha/testing/local_http_server.h"
 #include "omaha/testing/unit_test.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -53,7 +59,6 @@ const CString kUpdateBin1HashSha256 =
 const TCHAR kAppGuid1[] = _T("{0B35E146-D9CB-4145-8A91-43FDCAEBCD1E}");
 const TCHAR kAppGuid2[] = _T("{C7F2B395-A01C-4806-AA07-9163F66AFC48}");
 
-
 class DownloadAppWorkItem : public UserWorkItem {
  public:
   DownloadAppWorkItem(DownloadManager* download_manager, App* app)
@@ -70,6 +75,101 @@ class DownloadAppWorkItem : public UserWorkItem {
   DISALLOW_COPY_AND_ASSIGN(DownloadAppWorkItem);
 };
 
+// Serves the files added with AddFile. The range requests of BITS get the
+// requested range of the file.
+class LocalHttpFileServer : public LocalHttpServer {
+ public:
+  LocalHttpFileServer() : download_manager_(NULL), cancel_app_(NULL) {}
+  virtual ~LocalHttpFileServer() {
+    Stop();
+  }
+
+  // Serves |data| as |name|. Must be called before the server starts.
+  void AddFile(const CStringA& name, const std::vector<byte>& data) {
+    files_[name] = data;
+  }
+
+  // Cancels the download of |app| when |name| is requested, instead of
+  // serving the file. Must be called before the server starts.
+  void CancelOnRequest(const CStringA& name,
+                       DownloadManager* download_manager,
+                       App* app) {
+    cancel_name_ = name;
+    download_manager_ = download_manager;
+    cancel_app_ = app;
+  }
+
+  int num_requests(const CStringA& name) const {
+    std::map<CStringA, int>::const_iterator it = num_requests_.find(name);
+    return it == num_requests_.end() ? 0 : it->second;
+  }
+
+ protected:
+  virtual bool BuildResponse(const Request& request, CStringA* response) {
+    int pos = 0;
+    const CStringA method(request.request_line.Tokenize(" ", pos));
+    CStringA name(request.request_line.Tokenize(" ", pos));
+    name.TrimLeft('/');
+    ++num_requests_[name];
+
+    if (!cancel_name_.IsEmpty() && name == cancel_name_) {
+      download_manager_->Cancel(cancel_app_);
+      return false;
+    }
+
+    std::map<CStringA, std::vector<byte> >::const_iterator it =
+        files_.find(name);
+    if (it == files_.end() || it->second.empty()) {
+      *response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+      return true;
+    }
+
+    const std::vector<byte>& data(it->second);
+    const int size = static_cast<int>(data.size());
+    int first = 0;
+    int last = size - 1;
+    const CStringA range(request.GetHeader("Range"));
+    const bool is_range = !range.IsEmpty();
+    if (is_range) {
+      sscanf_s(range, "bytes=%d-%d", &first, &last);
+      last = std::min(last, size - 1);
+      if (first < 0 || first > last) {
+        *response = "HTTP/1.1 416 Range Not Satisfiable\r\n"
+                    "Content-Length: 0\r\n\r\n";
+        return true;
+      }
+    }
+
+    SafeCStringAFormat(response,
+                       "HTTP/1.1 %s\r\n"
+                       "Content-Type: application/octet-stream\r\n"
+                       "Accept-Ranges: bytes\r\n"
+                       "Content-Length: %d\r\n",
+                       is_range ? "206 Partial Content" : "200 OK",
+                       last - first + 1);
+    if (is_range) {
+      SafeCStringAAppendFormat(response,
+                               "Content-Range: bytes %d-%d/%d\r\n",
+                               first, last, size);
+    }
+    response->Append("\r\n");
+    if (method != "HEAD") {
+      response->Append(reinterpret_cast<const char*>(&data[first]),
+                       last - first + 1);
+    }
+    return true;
+  }
+
+ private:
+  std::map<CStringA, std::vector<byte> > files_;
+  std::map<CStringA, int> num_requests_;
+  CStringA cancel_name_;
+  DownloadManager* download_manager_;
+  App* cancel_app_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalHttpFileServer);
+};
+
 }  // namespace
 
 class DownloadManagerTest : public AppTestBase {
@@ -164,6 +264,10 @@ class DownloadManagerTest : public AppTestBase {
     SetAppStateForUnitTest(app, new fsm::AppStateWaitingToDownload);
   }
 
+  PackageCache* package_cache() {
+    return download_manager_->package_cache();
+  }
+
   const CString cache_path_;
   std::unique_ptr<DownloadManager> download_manager_;
   DWORD disable_payload_authenticode_verification_ = 0; // Saved from registry
@@ -1126,6 +1230,233 @@ TEST_F(DownloadManagerUserTest, DownloadApp_FallbackToNextUrlIfCachingFails) {
   EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
 }
 
+// Updates an app from version 1.0 to 2.0 with the packages served by a local
+// http server. The package of version 1.0 is still cached, so the patch from
+// 1.0 to 2.0 is downloaded before the package is.
+class DownloadManagerPatchTest : public DownloadManagerUserTest {
+ protected:
+  static const TCHAR kPackageName[];
+  static const TCHAR kPatchName[];
+  static const TCHAR kInstalledVersion[];
+  static const TCHAR kNextVersion[];
+
+  virtual void SetUp() {
+    DownloadManagerUserTest::SetUp();
+
+    // The packages of the test are not signed.
+    EXPECT_SUCCEEDED(RegKey::SetValue(
+        MACHINE_REG_UPDATE_DEV,
+        kRegValueDisablePayloadAuthenticodeVerification,
+        static_cast<DWORD>(1)));
+
+    // The next package replaces a few bytes of the installed package and
+    // appends some, as a new build of an executable does.
+    temp_file_ = GetTempFilename(_T("ut_"));
+    CreatePatternFile(temp_file_, 64 * 1024, 1);
+    EXPECT_SUCCEEDED(ReadEntireFile(temp_file_, 0, &installed_package_));
+    CreatePatternFile(temp_file_, 4 * 1024, 2);
+    EXPECT_SUCCEEDED(ReadEntireFile(temp_file_, 0, &next_package_));
+    next_package_.insert(next_package_.begin(),
+                         installed_package_.begin(),
+                         installed_package_.end());
+    for (size_t i = 0; i < installed_package_.size(); i += 1024) {
+      next_package_[i] ^= 0x10;
+    }
+    next_package_hash_ = Hash(next_package_);
+
+    EXPECT_SUCCEEDED(CreateDeltaPatch(installed_package_,
+                                      next_package_,
+                                      &patch_));
+    EXPECT_GT(next_package_.size() / 4, patch_.size());
+    patch_hash_ = Hash(patch_);
+
+    server_.AddFile(CStringA(kPackageName), next_package_);
+    server_.AddFile(CStringA(kPatchName), patch_);
+  }
+
+  virtual void TearDown() {
+    server_.Stop();
+    ::DeleteFile(temp_file_);
+    DownloadManagerUserTest::TearDown();
+  }
+
+  static CString Hash(const std::vector<byte>& data) {
+    CryptoHash crypto_hash;
+    std::vector<byte> hash;
+    EXPECT_SUCCEEDED(crypto_hash.Compute(data, &hash));
+    return BytesToHex(hash);
+  }
+
+  // Caches |data| as the package of the installed version.
+  void CacheInstalledPackage(const std::vector<byte>& data) {
+    EXPECT_SUCCEEDED(WriteEntireFile(temp_file_, data));
+    bool is_moved = false;
+    EXPECT_SUCCEEDED(package_cache()->PutFile(
+        PackageCache::Key(kAppGuid1, kInstalledVersion, kPackageName),
+        temp_file_,
+        Hash(data),
+        false,
+        &is_moved));
+  }
+
+  // Creates the app and loads an update response which has a patch with the
+  // hash |patch_hash|.
+  App* CreateApp(const CString& patch_hash) {
+    App* app = NULL;
+    EXPECT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
+    if (!app) {
+      return NULL;
+    }
+    EXPECT_SUCCEEDED(app->put_displayName(CComBSTR(_T("Patch Test"))));
+    EXPECT_SUCCEEDED(app->put_isEulaAccepted(VARIANT_TRUE));
+
+    CStringA buffer_string;
+    SafeCStringAFormat(&buffer_string,
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+      "<response protocol=\"3.0\">"
+        "<app appid=\"%S\" status=\"ok\">"
+          "<updatecheck status=\"ok\">"
+            "<urls>"
+              "<url codebase=\"%S\"/>"
+            "</urls>"
+            "<manifest version=\"%S\">"
+              "<packages>"
+                "<package "
+                  "hash_sha256=\"%S\" "
+                  "name=\"%S\" "
+                  "required=\"true\" "
+                  "size=\"%d\" "
+                  "namediff=\"%S\" "
+                  "sizediff=\"%d\" "
+                  "hashdiff_sha256=\"%S\"/>"
+              "</packages>"
+            "</manifest>"
+          "</updatecheck>"
+        "</app>"
+      "</response>",
+      kAppGuid1,
+      server_.url().GetString(),
+      kNextVersion,
+      next_package_hash_.GetString(),
+      kPackageName,
+      static_cast<int>(next_package_.size()),
+      kPatchName,
+      static_cast<int>(patch_.size()),
+      patch_hash.GetString());
+
+    EXPECT_SUCCEEDED(LoadBundleFromXml(app_bundle_.get(), buffer_string));
+    app->current_version()->set_version(kInstalledVersion);
+    SetAppStateWaitingToDownload(app);
+    return app;
+  }
+
+  bool IsNextPackageCached() {
+    return package_cache()->IsCached(
+        PackageCache::Key(kAppGuid1, kNextVersion, kPackageName),
+        next_package_hash_);
+  }
+
+  LocalHttpFileServer server_;
+  CString temp_file_;
+  std::vector<byte> installed_package_;
+  std::vector<byte> next_package_;
+  std::vector<byte> patch_;
+  CString next_package_hash_;
+  CString patch_hash_;
+};
+
+const TCHAR DownloadManagerPatchTest::kPackageName[] = _T("PatchData.bin");
+const TCHAR DownloadManagerPatchTest::kPatchName[] = _T("PatchData_diff.bin");
+const TCHAR DownloadManagerPatchTest::kInstalledVersion[] = _T("1.0.0.0");
+const TCHAR DownloadManagerPatchTest::kNextVersion[] = _T("2.0.0.0");
+
+TEST_F(DownloadManagerPatchTest, DownloadApp_Patch) {
+  CacheInstalledPackage(installed_package_);
+  ASSERT_SUCCEEDED(server_.Start());
+  App* app = CreateApp(patch_hash_);
+  ASSERT_TRUE(app);
+
+  const int64 diff_succeeded = metric_worker_download_diff_succeeded.value();
+  const int64 bytes_saved = metric_worker_download_diff_bytes_saved.value();
+
+  EXPECT_SUCCEEDED(download_manager_->DownloadApp(app));
+
+  EXPECT_LT(0, server_.num_requests(CStringA(kPatchName)));
+  EXPECT_EQ(0, server_.num_requests(CStringA(kPackageName)));
+  EXPECT_EQ(diff_succeeded + 1, metric_worker_download_diff_succeeded.value());
+  EXPECT_EQ(bytes_saved +
+                static_cast<int64>(next_package_.size() - patch_.size()),
+            metric_worker_download_diff_bytes_saved.value());
+
+  const Package* package = app->next_version()->GetPackage(0);
+  ASSERT_TRUE(package);
+  EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
+  EXPECT_TRUE(IsNextPackageCached());
+}
+
+TEST_F(DownloadManagerPatchTest, DownloadApp_PatchHashMismatch) {
+  CacheInstalledPackage(installed_package_);
+  ASSERT_SUCCEEDED(server_.Start());
+  App* app = CreateApp(next_package_hash_);
+  ASSERT_TRUE(app);
+
+  const int64 diff_failed = metric_worker_download_diff_failed.value();
+
+  EXPECT_SUCCEEDED(download_manager_->DownloadApp(app));
+
+  EXPECT_LT(0, server_.num_requests(CStringA(kPatchName)));
+  EXPECT_LT(0, server_.num_requests(CStringA(kPackageName)));
+  EXPECT_EQ(diff_failed + 1, metric_worker_download_diff_failed.value());
+
+  const Package* package = app->next_version()->GetPackage(0);
+  ASSERT_TRUE(package);
+  EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
+  EXPECT_TRUE(IsNextPackageCached());
+}
+
+// The cached package of the installed version is not the one the patch was
+// created from, so the patch does not apply to it.
+TEST_F(DownloadManagerPatchTest, DownloadApp_PatchBaseMismatch) {
+  std::vector<byte> other_package(installed_package_);
+  other_package[0] ^= 0x10;
+  CacheInstalledPackage(other_package);
+  ASSERT_SUCCEEDED(server_.Start());
+  App* app = CreateApp(patch_hash_);
+  ASSERT_TRUE(app);
+
+  const int64 diff_failed = metric_worker_download_diff_failed.value();
+
+  EXPECT_SUCCEEDED(download_manager_->DownloadApp(app));
+
+  EXPECT_LT(0, server_.num_requests(CStringA(kPatchName)));
+  EXPECT_LT(0, server_.num_requests(CStringA(kPackageName)));
+  EXPECT_EQ(diff_failed + 1, metric_worker_download_diff_failed.value());
+
+  const Package* package = app->next_version()->GetPackage(0);
+  ASSERT_TRUE(package);
+  EXPECT_TRUE(download_manager_->IsPackageAvailable(package));
+  EXPECT_TRUE(IsNextPackageCached());
+}
+
+// A cancelled patch download does not fall back to the package.
+TEST_F(DownloadManagerPatchTest, DownloadApp_PatchCancelled) {
+  CacheInstalledPackage(installed_package_);
+  App* app = CreateApp(patch_hash_);
+  ASSERT_TRUE(app);
+  server_.CancelOnRequest(CStringA(kPatchName), download_manager_.get(), app);
+  ASSERT_SUCCEEDED(server_.Start());
+
+  const int64 diff_failed = metric_worker_download_diff_failed.value();
+
+  EXPECT_EQ(GOOPDATE_E_CANCELLED, download_manager_->DownloadApp(app));
+
+  EXPECT_LT(0, server_.num_requests(CStringA(kPatchName)));
+  EXPECT_EQ(0, server_.num_requests(CStringA(kPackageName)));
+  EXPECT_EQ(diff_failed, metric_worker_download_diff_failed.value());
+  EXPECT_EQ(STATE_ERROR, app->state());
+  EXPECT_FALSE(IsNextPackageCached());
+}
+
 TEST_F(DownloadManagerUserTest, DownloadApp_EulaNotAccepted) {
   App* app = NULL;
   ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
@@ -1256,6 +1587,78 @@ TEST_F(DownloadManagerUserTest, CachePackage) {
 #endif // VERIFY_PAYLOAD_AUTHENTICODE_SIGNATURE
 }
 
+TEST_F(DownloadManagerUserTest, CacheOfflinePackages) {
+  App* app = NULL;
+  ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
+  AppVersion* version = app->next_version();
+
+  const CString offline_dir(GetUniqueTempDirectoryName());
+  ASSERT_SUCCEEDED(CreateDir(offline_dir, NULL));
+
+  std::vector<const Package*> packages;
+  std::vector<CString> file_paths;
+  for (int i = 0; i != 6; ++i) {
+    CString package_name;
+    package_name.Format(_T("package%d.bin"), i);
+    const uint32 size = 100000 * (i + 1);
+    const CString file_path(ConcatenatePath(offline_dir, package_name));
+    const CString hash(CreatePatternFile(file_path, size, i));
+    ASSERT_SUCCEEDED(version->AddPackage(package_name, size, hash));
+    packages.push_back(version->GetPackage(i));
+    file_paths.push_back(file_path);
+  }
+
+  // The packages are copied.
+  size_t failed_index = 0;
+  EXPECT_SUCCEEDED(download_manager_->CacheOfflinePackages(packages,
+                                                           file_paths,
+                                                           false,
+                                                           &failed_index));
+  for (size_t i = 0; i != packages.size(); ++i) {
+    EXPECT_TRUE(download_manager_->IsPackageAvailable(packages[i]));
+    EXPECT_TRUE(File::Exists(file_paths[i]));
+  }
+
+  // The packages are moved, replacing the cached packages.
+  EXPECT_SUCCEEDED(download_manager_->CacheOfflinePackages(packages,
+                                                           file_paths,
+                                                           true,
+                                                           &failed_index));
+  for (size_t i = 0; i != packages.size(); ++i) {
+    EXPECT_TRUE(download_manager_->IsPackageAvailable(packages[i]));
+    EXPECT_FALSE(File::Exists(file_paths[i]));
+  }
+
+  // A package which does not match its hash is not cached. The other
+  // packages are cached.
+  for (size_t i = 0; i != packages.size(); ++i) {
+    CreatePatternFile(file_paths[i],
+                      static_cast<uint32>(100000 * (i + 1)),
+                      i == 3 ? 100 : static_cast<int>(i));
+  }
+  EXPECT_SUCCEEDED(package_cache()->PurgeAll());
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE,
+            download_manager_->CacheOfflinePackages(packages,
+                                                    file_paths,
+                                                    false,
+                                                    &failed_index));
+  EXPECT_EQ(3, failed_index);
+  for (size_t i = 0; i != packages.size(); ++i) {
+    EXPECT_EQ(i != 3, download_manager_->IsPackageAvailable(packages[i]));
+  }
+
+  // A package of the wrong size gets a more specific error.
+  CreatePatternFile(file_paths[3], 10, 3);
+  EXPECT_EQ(GOOPDATEDOWNLOAD_E_FILE_SIZE_SMALLER,
+            download_manager_->CacheOfflinePackages(packages,
+                                                    file_paths,
+                                                    false,
+                                                    &failed_index));
+  EXPECT_EQ(3, failed_index);
+
+  EXPECT_SUCCEEDED(DeleteDirectory(offline_dir));
+}
+
 TEST_F(DownloadManagerUserTest, GetPackage_NotPresent) {
   App* app = NULL;
   ASSERT_SUCCEEDED(app_bundle_->createApp(CComBSTR(kAppGuid1), &app));
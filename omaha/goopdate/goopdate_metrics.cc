@@ -29,14 +29,19 @@ DEFINE_METRIC_count(crashes_uploaded);
 DEFINE_METRIC_count(crashes_throttled);
 DEFINE_METRIC_count(crashes_rejected);
 DEFINE_METRIC_count(crashes_failed);
+DEFINE_METRIC_count(crashes_duplicate);
 
 DEFINE_METRIC_count(oop_crashes_total);
 DEFINE_METRIC_count(oop_crashes_uploaded);
 DEFINE_METRIC_count(oop_crashes_throttled);
 DEFINE_METRIC_count(oop_crashes_rejected);
 DEFINE_METRIC_count(oop_crashes_failed);
+DEFINE_METRIC_count(oop_crashes_duplicate);
 DEFINE_METRIC_count(oop_crash_start_sender);
 
+DEFINE_METRIC_count(crash_upload_bytes_sent);
+DEFINE_METRIC_count(crash_upload_bytes_saved);
+
 DEFINE_METRIC_count(goopdate_handle_report_crash);
 
 DEFINE_METRIC_count(cr_process_total);
@@ -32,8 +32,9 @@ DECLARE_METRIC_integer(windows_user_profile_type);
 // Crash metrics.
 //
 // A crash can be handled in one of the following ways: uploaded, rejected by
-// the server, rejected by the client due to metering, or failed for other
-// reasons, such as the sender could not communicate with the crash server.
+// the server, rejected by the client due to metering, counted as a duplicate
+// of a crash uploaded recently, or failed for other reasons, such as the
+// sender could not communicate with the crash server.
 
 // In process crash reporting metrics.
 DECLARE_METRIC_count(crashes_total);
@@ -41,6 +42,7 @@ DECLARE_METRIC_count(crashes_uploaded);
 DECLARE_METRIC_count(crashes_throttled);
 DECLARE_METRIC_count(crashes_rejected);
 DECLARE_METRIC_count(crashes_failed);
+DECLARE_METRIC_count(crashes_duplicate);
 
 // Out of process crash reporting metrics.
 // The number of crashes requested by the applications should be close to the
@@ -51,8 +53,14 @@ DECLARE_METRIC_count(oop_crashes_uploaded);
 DECLARE_METRIC_count(oop_crashes_throttled);
 DECLARE_METRIC_count(oop_crashes_rejected);
 DECLARE_METRIC_count(oop_crashes_failed);
+DECLARE_METRIC_count(oop_crashes_duplicate);
 DECLARE_METRIC_count(oop_crash_start_sender);
 
+// The bytes of the crash uploads sent on the wire, and the bytes saved by the
+// compression of the uploads and by not uploading the duplicate crashes.
+DECLARE_METRIC_count(crash_upload_bytes_sent);
+DECLARE_METRIC_count(crash_upload_bytes_saved);
+
 // Increments every time GoopdateImpl::HandleReportCrash is called.
 DECLARE_METRIC_count(goopdate_handle_report_crash);
 
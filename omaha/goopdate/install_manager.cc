@@ -17,6 +17,7 @@
 #include <vector>
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/safe_format.h"
@@ -31,6 +32,7 @@
 #include "omaha/goopdate/model.h"
 #include "omaha/goopdate/server_resource.h"
 #include "omaha/goopdate/string_formatter.h"
+#include "omaha/goopdate/worker_metrics.h"
 
 namespace omaha {
 
@@ -58,6 +60,26 @@ bool GetInstallActionForEvent(
   return false;
 }
 
+// Records the progress of the installer in the app, where the clients of the
+// app read it.
+class AppInstallerProgressObserver : public InstallerProgressObserver {
+ public:
+  explicit AppInstallerProgressObserver(App* app) : app_(app) {
+    ASSERT1(app);
+  }
+
+  virtual void OnInstallerProgress(int install_progress_percentage) {
+    CORE_LOG(L3, (_T("[OnInstallerProgress][%s][%d]"),
+                  app_->app_guid_string(), install_progress_percentage));
+    app_->SetInstallProgress(install_progress_percentage);
+  }
+
+ private:
+  App* const app_;
+
+  DISALLOW_COPY_AND_ASSIGN(AppInstallerProgressObserver);
+};
+
 }  // namespace
 
 InstallManager::InstallManager(const Lockable* model_lock, bool is_machine)
@@ -90,10 +112,21 @@ CString InstallManager::install_working_dir() const {
   return install_working_dir_;
 }
 
+void InstallManager::InstallApp(App* app, const CString& dir) {
+  DoInstallApp(app, dir, false);
+}
+
+void InstallManager::InstallAppConcurrently(App* app, const CString& dir) {
+  DoInstallApp(app, dir, true);
+}
+
 // For each app, set the state to STATE_INSTALLING, install it, and update the
 // state of the model after it completes.
-void InstallManager::InstallApp(App* app,  const CString& dir) {
-  CORE_LOG(L3, (_T("[InstallManager::InstallApp][0x%p]"), app));
+void InstallManager::DoInstallApp(App* app,
+                                  const CString& dir,
+                                  bool is_concurrent) {
+  CORE_LOG(L3, (_T("[InstallManager::DoInstallApp][0x%p][%d]"),
+                app, is_concurrent));
   ASSERT1(app);
 
   const ConfigManager& cm = *ConfigManager::Instance();
@@ -125,7 +158,8 @@ void InstallManager::InstallApp(App* app,  const CString& dir) {
                           *model_lock_,
                           installer_wrapper_.get(),
                           app,
-                          dir);
+                          dir,
+                          is_concurrent);
 
   CORE_LOG(LE, (_T("[InstallApp returned][0x%p][0x%08x]"), app, hr));
 
@@ -140,7 +174,8 @@ HRESULT InstallManager::InstallApp(bool is_machine,
                                    const Lockable& model_lock,
                                    InstallerWrapper* installer_wrapper,
                                    App* app,
-                                   const CString& dir) {
+                                   const CString& dir,
+                                   bool is_concurrent) {
   UNREFERENCED_PARAMETER(is_machine);
   ASSERT1(installer_wrapper);
   ASSERT1(app);
@@ -157,7 +192,13 @@ HRESULT InstallManager::InstallApp(bool is_machine,
   CString expected_version;
 
   AppManager& app_manager = *AppManager::Instance();
-  __mutexScope(app_manager.GetRegistryStableStateLock());
+  Lockable& registry_stable_state_lock =
+      app_manager.GetRegistryStableStateLock();
+  __mutexScope(registry_stable_state_lock);
+
+  // An app is installed by one bundle at a time. Another bundle may be
+  // running the installer of the app without the stable state lock.
+  app_manager.WaitForAppInstall(app->app_guid());
 
   // TODO(omaha): If this does not get much simpler, extract method.
   AppVersion& next_version = *(app->next_version());
@@ -247,6 +288,15 @@ HRESULT InstallManager::InstallApp(bool is_machine,
       install_priority));
 
   InstallerResultInfo result_info;
+  AppInstallerProgressObserver progress_observer(app);
+
+  // The installers which run concurrently run without the stable state lock,
+  // so that the apps of the bundle which do not conflict can be installed at
+  // the same time. The app is marked as installing meanwhile.
+  if (is_concurrent) {
+    app_manager.AddInstallingApp(app_guid);
+    registry_stable_state_lock.Unlock();
+  }
 
   app->SetCurrentTimeAs(App::TIME_INSTALL_START);
   HRESULT hr = installer_wrapper->InstallApp(user_token,
@@ -257,9 +307,15 @@ HRESULT InstallManager::InstallApp(bool is_machine,
                                              language,
                                              app->untrusted_data(),
                                              install_priority,
+                                             &progress_observer,
                                              &result_info);
   app->SetCurrentTimeAs(App::TIME_INSTALL_COMPLETE);
 
+  if (is_concurrent) {
+    registry_stable_state_lock.Lock();
+    app_manager.RemoveInstallingApp(app_guid);
+  }
+
   OPT_LOG(L1, (_T("[InstallApp returned][0x%x][%s][type:%d][code: %d][%s][%s]"),
                hr, GuidToString(app_guid), result_info.type, result_info.code,
                result_info.text, result_info.post_install_launch_command_line));
@@ -271,6 +327,7 @@ HRESULT InstallManager::InstallApp(bool is_machine,
     // Skip checking application registration for Omaha self-updates because the
     // installer has not completed.
     if (!::IsEqualGUID(kGoopdateGuid, app_guid)) {
+      HighresTimer registration_check_timer;
       hr = app_manager.ReadInstallerRegistrationValues(app);
       if (SUCCEEDED(hr)) {
         hr = installer_wrapper->CheckApplicationRegistration(
@@ -280,6 +337,8 @@ HRESULT InstallManager::InstallApp(bool is_machine,
             existing_version,
             is_update);
       }
+      metric_worker_install_registration_check_ms.AddSample(
+          registration_check_timer.GetElapsedMs());
     }
   } else {
     ASSERT1(result_info.type != INSTALLER_RESULT_SUCCESS);
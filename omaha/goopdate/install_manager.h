@@ -41,6 +41,7 @@ class InstallManagerInterface {
   virtual CString install_working_dir() const = 0;
   virtual HRESULT Initialize() = 0;
   virtual void InstallApp(App* app, const CString& dir) = 0;
+  virtual void InstallAppConcurrently(App* app, const CString& dir) = 0;
 };
 
 class InstallManager : public InstallManagerInterface {
@@ -58,7 +59,14 @@ class InstallManager : public InstallManagerInterface {
   // in the specified directory.
   virtual void InstallApp(App* app, const CString& dir);
 
+  // Installs an application while the installers of other applications may be
+  // running. The installer runs without the registry stable state lock, and
+  // the application is marked as installing in the AppManager meanwhile.
+  virtual void InstallAppConcurrently(App* app, const CString& dir);
+
  private:
+  void DoInstallApp(App* app, const CString& dir, bool is_concurrent);
+
   // TODO(omaha): Rename to avoid overload.
   static HRESULT InstallApp(bool is_machine,
                             HANDLE user_token,
@@ -66,7 +74,8 @@ class InstallManager : public InstallManagerInterface {
                             const Lockable& model_lock,
                             InstallerWrapper* installer_wrapper,
                             App* app,
-                            const CString& dir);
+                            const CString& dir,
+                            bool is_concurrent);
   static void PopulateSuccessfulInstallResultInfo(
       const App* app,
       InstallerResultInfo* result_info);
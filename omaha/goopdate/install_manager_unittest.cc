@@ -17,6 +17,7 @@
 
 #include <atlpath.h>
 #include <atlstr.h>
+#include <functional>
 
 #include "omaha/base/app_util.h"
 #include "omaha/base/error.h"
@@ -27,6 +28,7 @@
 #include "omaha/base/shell.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/system.h"
+#include "omaha/base/thread.h"
 #include "omaha/base/timer.h"
 #include "omaha/base/utils.h"
 #include "omaha/base/vistautil.h"
@@ -36,6 +38,7 @@
 #include "omaha/common/install_manifest.h"
 #include "omaha/common/ping_event.h"
 #include "omaha/goopdate/app_bundle_state_initialized.h"
+#include "omaha/goopdate/app_manager.h"
 #include "omaha/goopdate/app_state_waiting_to_install.h"
 #include "omaha/goopdate/app_unittest_base.h"
 #include "omaha/goopdate/installer_wrapper.h"
@@ -93,10 +96,34 @@ const TCHAR kMsiInstallerBusyErrorMessage[] =
 
 const TCHAR kMsiLogFormat[] = _T("%s.log");
 
+// The "installer" waits for the signal, which is sent by waitfor /si.
+const TCHAR kWaitForSignalCommand[] = _T("waitfor /t 60 OmahaInstallTest");
+const TCHAR kSendSignalCommand[] = _T("waitfor /si OmahaInstallTest");
+
 // brand, InstallTime, DayOfInstall, DayOfLastActivity, DayOfLastRollCall, and
 // LastCheckSuccess are automatically populated.
 const int kNumAutoPopulatedValues = 7;
 
+// Runs an install on another thread.
+class InstallAppRunnable : public Runnable {
+ public:
+  explicit InstallAppRunnable(const std::function<HRESULT()>& install)
+      : install_(install),
+        hr_(E_PENDING) {}
+
+  virtual void Run() {
+    hr_ = install_();
+  }
+
+  HRESULT hr() const { return hr_; }
+
+ private:
+  std::function<HRESULT()> install_;
+  HRESULT hr_;
+
+  DISALLOW_COPY_AND_ASSIGN(InstallAppRunnable);
+};
+
 }  // namespace
 
 // Values and functions in installer_wrapper_unittest.cc.
@@ -176,7 +203,8 @@ class InstallManagerInstallAppTest : public AppTestBase {
 
   HRESULT InstallApp(const CString& existing_version,
                      App* app,
-                     const CString& dir) {
+                     const CString& dir,
+                     bool is_concurrent) {
     ASSERT1(app);
     return InstallManager::InstallApp(is_machine_,
                                       NULL,
@@ -184,7 +212,14 @@ class InstallManagerInstallAppTest : public AppTestBase {
                                       app->model()->lock(),
                                       installer_wrapper_.get(),
                                       app,
-                                      dir);
+                                      dir,
+                                      is_concurrent);
+  }
+
+  HRESULT InstallApp(const CString& existing_version,
+                     App* app,
+                     const CString& dir) {
+    return InstallApp(existing_version, app, dir, false);
   }
 
   void SetArgumentsInManifest(const CString& arguments,
@@ -592,6 +627,54 @@ TEST_F(InstallManagerInstallAppUserTest,
   EXPECT_EQ(POST_INSTALL_ACTION_DEFAULT, GetPostInstallAction(app_));
 }
 
+// The installer of a concurrent install runs without the stable state lock.
+// The installer does not exit before the test has acquired the lock, so the
+// test can't acquire the lock unless InstallApp released it.
+TEST_F(InstallManagerInstallAppUserTest,
+       InstallApp_ConcurrentInstallerRunsWithoutStableStateLock) {
+  CString arguments;
+  arguments.Format(kExecuteCommandAndTerminateSwitch, kWaitForSignalCommand);
+
+  // Create the Clients key since this isn't an actual installer.
+  ASSERT_SUCCEEDED(RegKey::SetValue(kFullAppClientsKeyPath,
+                                    kRegValueProductVersion,
+                                    _T("0.10.69.5")));
+
+  app_->next_version()->AddPackage(kCmdExecutable, 100, _T("sha256hash"));
+
+  SetArgumentsInManifest(arguments, _T("0.10.69.5"), app_);
+
+  InstallAppRunnable install([this]() {
+    return InstallApp(_T(""), app_, cmd_exe_dir_, true);
+  });
+  Thread thread;
+  ASSERT_TRUE(thread.Start(&install));
+
+  // The app is marked as installing, under the stable state lock, after it
+  // enters the installing state.
+  while (app_->state() == STATE_WAITING_TO_INSTALL) {
+    ::Sleep(10);
+  }
+  ASSERT_EQ(STATE_INSTALLING, app_->state());
+
+  AppManager& app_manager = *AppManager::Instance();
+  __mutexBlock(app_manager.GetRegistryStableStateLock()) {
+    EXPECT_TRUE(app_manager.IsAppInstalling(app_->app_guid()));
+  }
+
+  // The signal is lost if the installer is not waiting for it yet.
+  for (int i = 0; i != 60 && !thread.WaitTillExit(1000); ++i) {
+    EXPECT_SUCCEEDED(System::StartCommandLine(kSendSignalCommand));
+  }
+  ASSERT_TRUE(thread.WaitTillExit(0));
+
+  EXPECT_SUCCEEDED(install.hr());
+  EXPECT_EQ(STATE_INSTALL_COMPLETE, app_->state());
+  __mutexBlock(app_manager.GetRegistryStableStateLock()) {
+    EXPECT_FALSE(app_manager.IsAppInstalling(app_->app_guid()));
+  }
+}
+
 TEST_F(InstallManagerInstallAppMachineTest, InstallApp_MsiInstallerSucceeds) {
   if (!vista_util::IsUserAdmin()) {
     std::wcout << _T("\tTest did not run because the user is not an admin.")
@@ -13,6 +13,7 @@
 // limitations under the License.
 // ========================================================================
 
+#include <algorithm>
 #include <vector>
 #include "goopdate/omaha3_idl.h"
 #include "omaha/goopdate/installer_wrapper.h"
@@ -21,15 +22,19 @@
 #include "omaha/base/debug.h"
 #include "omaha/base/environment_block_modifier.h"
 #include "omaha/base/error.h"
+#include "omaha/base/highres_timer-win32.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/process.h"
+#include "omaha/base/reg_key.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scope_guard.h"
 #include "omaha/base/string.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/base/system_info.h"
 #include "omaha/base/utils.h"
+#include "omaha/common/app_registry_utils.h"
+#include "omaha/common/config_manager.h"
 #include "omaha/common/const_cmd_line.h"
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/goopdate_utils.h"
@@ -127,9 +132,75 @@ void GetSystemErrorString(uint32 error_code,
 
 }  // namespace
 
+// The names of the slots do not depend on the number of slots, so the
+// instances with different numbers of slots share the first slots.
+HRESULT InstallerWrapper::InstallSlots::Initialize(bool is_machine,
+                                                   int num_slots) {
+  ASSERT1(num_slots >= 1 && num_slots <= kMaxConcurrentInstallsLimit);
+
+  for (int i = 0; i != num_slots; ++i) {
+    CString mutex_name;
+    SafeCStringFormat(&mutex_name, _T("%s-%d"), kInstallSlotMutex, i);
+    NamedObjectAttributes mutex_attr;
+    GetNamedObjectAttributes(mutex_name, is_machine, &mutex_attr);
+    reset(slots_[i], ::CreateMutex(&mutex_attr.sa, false, mutex_attr.name));
+    if (!slots_[i]) {
+      const HRESULT hr = HRESULTFromLastError();
+      num_slots_ = 0;
+      return hr;
+    }
+  }
+
+  num_slots_ = num_slots;
+  return S_OK;
+}
+
+bool InstallerWrapper::InstallSlots::Lock() const {
+  ASSERT1(num_slots_ >= 1);
+
+  HANDLE handles[kMaxConcurrentInstallsLimit] = {};
+  for (int i = 0; i != num_slots_; ++i) {
+    handles[i] = get(slots_[i]);
+  }
+
+  const DWORD result = ::WaitForMultipleObjects(num_slots_,
+                                                handles,
+                                                is_exclusive_,
+                                                INFINITE);
+  if (result >= WAIT_ABANDONED_0 && result < WAIT_ABANDONED_0 + num_slots_) {
+    CORE_LOG(LW, (_T("[install slot was abandoned][%u]"),
+                  result - WAIT_ABANDONED_0));
+    return true;
+  }
+  return result < WAIT_OBJECT_0 + num_slots_;
+}
+
+// A mutex can only be released by the thread which holds it, so a shared lock
+// releases the one slot which the calling thread holds.
+bool InstallerWrapper::InstallSlots::Unlock() const {
+  ASSERT1(num_slots_ >= 1);
+
+  int num_released = 0;
+  for (int i = 0; i != num_slots_; ++i) {
+    if (::ReleaseMutex(get(slots_[i]))) {
+      ++num_released;
+      if (!is_exclusive_) {
+        break;
+      }
+    }
+  }
+
+  const bool is_released = num_released == (is_exclusive_ ? num_slots_ : 1);
+  ASSERT1(is_released);
+  return is_released;
+}
+
 InstallerWrapper::InstallerWrapper(bool is_machine)
     : is_machine_(is_machine),
-      num_tries_when_msi_busy_(1) {
+      num_tries_when_msi_busy_(1),
+      max_concurrent_installs_(kDefaultMaxConcurrentInstalls),
+      install_slot_(false),
+      all_install_slots_(true) {
   CORE_LOG(L3, (_T("[InstallerWrapper::InstallerWrapper]")));
 }
 
@@ -146,6 +217,20 @@ HRESULT InstallerWrapper::Initialize() {
     return GOOPDATEINSTALL_E_FAILED_INIT_INSTALLER_LOCK;
   }
 
+  max_concurrent_installs_ =
+      ConfigManager::Instance()->GetMaxConcurrentInstalls();
+  HRESULT hr = install_slot_.Initialize(is_machine_,
+                                        max_concurrent_installs_);
+  if (SUCCEEDED(hr)) {
+    hr = all_install_slots_.Initialize(is_machine_,
+                                       kMaxConcurrentInstallsLimit);
+  }
+  if (FAILED(hr)) {
+    OPT_LOG(LEVEL_ERROR, (_T("[Could not init install slots][0x%08x]"), hr));
+    return hr;
+  }
+
+  CORE_LOG(L2, (_T("[max concurrent installs][%d]"), max_concurrent_installs_));
   return S_OK;
 }
 
@@ -161,6 +246,7 @@ HRESULT InstallerWrapper::InstallApp(HANDLE user_token,
                                      const CString& language,
                                      const CString& untrusted_data,
                                      int install_priority,
+                                     InstallerProgressObserver* observer,
                                      InstallerResultInfo* result_info) {
   ASSERT1(result_info);
 
@@ -172,6 +258,7 @@ HRESULT InstallerWrapper::InstallApp(HANDLE user_token,
                             language,
                             untrusted_data,
                             install_priority,
+                            observer,
                             result_info);
 
   ASSERT1((SUCCEEDED(hr) && result_info->type == INSTALLER_RESULT_SUCCESS) ||
@@ -336,6 +423,7 @@ HRESULT InstallerWrapper::ExecuteAndWaitForInstaller(
     const CString& language,
     const CString& untrusted_data,
     int install_priority,
+    InstallerProgressObserver* observer,
     InstallerResultInfo* result_info) {
   CORE_LOG(L3, (_T("[InstallerWrapper::ExecuteAndWaitForInstaller]")));
   ASSERT1(result_info);
@@ -372,6 +460,7 @@ HRESULT InstallerWrapper::ExecuteAndWaitForInstaller(
                                       language,
                                       untrusted_data,
                                       install_priority,
+                                      observer,
                                       result_info);
     if (FAILED(hr)) {
       CORE_LOG(LE, (_T("[DoExecuteAndWaitForInstaller failed][0x%08x]"), hr));
@@ -425,11 +514,14 @@ HRESULT InstallerWrapper::DoExecuteAndWaitForInstaller(
     const CString& language,
     const CString& untrusted_data,
     int install_priority,
+    InstallerProgressObserver* observer,
     InstallerResultInfo* result_info) {
   OPT_LOG(L1, (_T("[Running installer][%s][%s][%s]"),
                executable_path, command_line, GuidToString(app_guid)));
   ASSERT1(result_info);
 
+  HighresTimer launch_timer;
+
   AppManager::Instance()->ClearInstallerResultApiValues(app_guid);
 
   // Create modified environment block to pass untrusted data.
@@ -462,6 +554,8 @@ HRESULT InstallerWrapper::DoExecuteAndWaitForInstaller(
     return GOOPDATEINSTALL_E_INSTALLER_FAILED_START;
   }
 
+  metric_worker_install_launch_ms.AddSample(launch_timer.GetElapsedMs());
+
   if (install_priority != INSTALL_PRIORITY_HIGH) {
     VERIFY1(::SetPriorityClass(p.GetHandle(), BELOW_NORMAL_PRIORITY_CLASS));
   }
@@ -478,7 +572,10 @@ HRESULT InstallerWrapper::DoExecuteAndWaitForInstaller(
     return S_OK;
   }
 
-  p.WaitUntilDead(kInstallerCompleteIntervalMs);
+  HighresTimer run_timer;
+  WaitForInstaller(app_guid, &p, observer);
+  metric_worker_install_run_ms.AddSample(run_timer.GetElapsedMs());
+
   hr = GetInstallerResult(app_guid, installer_type, p, language, result_info);
 
   if (result_info->type != INSTALLER_RESULT_SUCCESS) {
@@ -489,6 +586,93 @@ HRESULT InstallerWrapper::DoExecuteAndWaitForInstaller(
   return hr;
 }
 
+// Installers report their progress in the "InstallerProgress" value of the
+// ClientState key of the app. The wait covers the process and a change
+// notification on the key, so the progress is reported when it changes instead
+// of when a client polls for it. The progress is not reported if the key
+// cannot be watched, for instance if it does not exist yet.
+void InstallerWrapper::WaitForInstaller(const GUID& app_guid,
+                                        Process* p,
+                                        InstallerProgressObserver* observer) {
+  ASSERT1(p);
+
+  const CString client_state_key_name =
+      app_registry_utils::GetAppClientStateKey(is_machine_,
+                                               GuidToString(app_guid));
+  RegKeyWithChangeEvent client_state_key;
+  if (!observer ||
+      FAILED(client_state_key.Open(client_state_key_name,
+                                   KEY_NOTIFY | KEY_QUERY_VALUE)) ||
+      FAILED(client_state_key.SetupEvent(false, REG_NOTIFY_CHANGE_LAST_SET))) {
+    p->WaitUntilDead(kInstallerCompleteIntervalMs);
+    return;
+  }
+
+  // The change event is first, so the changes which happen before the
+  // installer exits are reported even if both handles are signaled.
+  const HANDLE handles[] = {client_state_key.change_event(), p->GetHandle()};
+  const ULONGLONG timeout_ms = kInstallerCompleteIntervalMs;
+  DWORD last_progress = static_cast<DWORD>(-1);
+  HighresTimer timer;
+  for (;;) {
+    DWORD progress = 0;
+    if (SUCCEEDED(client_state_key.GetValue(kRegValueInstallerProgress,
+                                            &progress)) &&
+        progress != last_progress) {
+      last_progress = progress;
+      observer->OnInstallerProgress(
+          static_cast<int>(std::min<DWORD>(100, progress)));
+    }
+
+    ULONGLONG elapsed_ms = timer.GetElapsedMs();
+    if (elapsed_ms >= timeout_ms) {
+      return;
+    }
+    const DWORD result = ::WaitForMultipleObjects(
+        arraysize(handles),
+        handles,
+        false,
+        static_cast<DWORD>(timeout_ms - elapsed_ms));
+    if (result != WAIT_OBJECT_0) {
+      CORE_LOG(L3, (_T("[WaitForInstaller][wait result %u]"), result));
+      return;
+    }
+
+    HRESULT hr = client_state_key.SetupEvent(false,
+                                             REG_NOTIFY_CHANGE_LAST_SET);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[SetupEvent failed][0x%08x]"), hr));
+      elapsed_ms = timer.GetElapsedMs();
+      if (elapsed_ms < timeout_ms) {
+        p->WaitUntilDead(static_cast<uint32>(timeout_ms - elapsed_ms));
+      }
+      return;
+    }
+  }
+}
+
+bool InstallerWrapper::IsSerialized(InstallerType installer_type) const {
+  return installer_type == MSI_INSTALLER || max_concurrent_installs_ <= 1;
+}
+
+HRESULT InstallerWrapper::InitializeAppInstallLock(const GUID& app_guid,
+                                                   GLock* lock) const {
+  ASSERT1(lock);
+
+  CString lock_name;
+  SafeCStringFormat(&lock_name, _T("%s-%s"),
+                    kAppInstallSerializer, GuidToString(app_guid));
+  NamedObjectAttributes lock_attr;
+  GetNamedObjectAttributes(lock_name, is_machine_, &lock_attr);
+  if (!lock->InitializeWithSecAttr(lock_attr.name, &lock_attr.sa)) {
+    const HRESULT hr = HRESULTFromLastError();
+    OPT_LOG(LEVEL_ERROR, (_T("[Could not init app install lock][0x%08x]"),
+                          hr));
+    return hr;
+  }
+  return S_OK;
+}
+
 HRESULT InstallerWrapper::GetInstallerResult(const GUID& app_guid,
                                              InstallerType installer_type,
                                              const Process& p,
@@ -697,7 +881,7 @@ HRESULT InstallerWrapper::CheckApplicationRegistration(
   return S_OK;
 }
 
-// Assumes installer_lock_ has been initialized.
+// Assumes installer_lock_ and the install slots have been initialized.
 HRESULT InstallerWrapper::DoInstallApp(HANDLE user_token,
                                        const GUID& app_guid,
                                        const CString& installer_path,
@@ -706,6 +890,7 @@ HRESULT InstallerWrapper::DoInstallApp(HANDLE user_token,
                                        const CString& language,
                                        const CString& untrusted_data,
                                        int install_priority,
+                                       InstallerProgressObserver* observer,
                                        InstallerResultInfo* result_info) {
   CORE_LOG(L1, (_T("[InstallerWrapper::DoInstallApp][%s][%s][%s]"),
                GuidToString(app_guid), installer_path, arguments));
@@ -736,18 +921,38 @@ HRESULT InstallerWrapper::DoInstallApp(HANDLE user_token,
     return hr;
   }
 
-  // Acquire the global lock here. This will ensure that we are the only
-  // installer running of the multiple goopdates.
-  __mutexBlock(installer_lock_) {
-    hr = ExecuteAndWaitForInstaller(user_token,
-                                    app_guid,
-                                    executable_path,
-                                    command_line,
-                                    installer_type,
-                                    language,
-                                    untrusted_data,
-                                    install_priority,
-                                    result_info);
+  // Acquire the global lock and all the install slots here when the installer
+  // must run alone. This will ensure that we are the only installer running
+  // of the multiple goopdates. Otherwise, the installer takes the lock of its
+  // app, so that the other goopdates do not install the app at the same time,
+  // and waits for one of the install slots of the goopdates.
+  const bool is_serialized = IsSerialized(installer_type);
+  GLock app_install_lock;
+  if (!is_serialized) {
+    hr = InitializeAppInstallLock(app_guid, &app_install_lock);
+    if (FAILED(hr)) {
+      return GOOPDATEINSTALL_E_FAILED_INIT_INSTALLER_LOCK;
+    }
+  }
+  const Lockable& install_lock = is_serialized ?
+      static_cast<const Lockable&>(installer_lock_) : app_install_lock;
+  const Lockable& slots_lock = is_serialized ?
+      all_install_slots_ : install_slot_;
+  HighresTimer wait_timer;
+  __mutexBlock(install_lock) {
+    __mutexBlock(slots_lock) {
+      metric_worker_install_wait_ms.AddSample(wait_timer.GetElapsedMs());
+      hr = ExecuteAndWaitForInstaller(user_token,
+                                      app_guid,
+                                      executable_path,
+                                      command_line,
+                                      installer_type,
+                                      language,
+                                      untrusted_data,
+                                      install_priority,
+                                      observer,
+                                      result_info);
+    }
   }
 
   if (FAILED(hr)) {
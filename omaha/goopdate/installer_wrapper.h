@@ -13,8 +13,11 @@
 // limitations under the License.
 // ========================================================================
 //
-// InstallerWrapper supports installing one app at a time. Installs from
-// multiple instances are serialized by a mutex.
+// InstallerWrapper runs the installers of the apps. Windows Installer runs
+// one install at a time, so the MSI installers from multiple instances are
+// serialized by a mutex. The other installers are serialized by the same
+// mutex, unless the MaxConcurrentInstalls policy allows more than one install
+// at a time.
 
 #ifndef OMAHA_GOOPDATE_INSTALLER_WRAPPER_H_
 #define OMAHA_GOOPDATE_INSTALLER_WRAPPER_H_
@@ -25,8 +28,10 @@
 #include <utility>
 
 #include "base/basictypes.h"
+#include "omaha/base/constants.h"
 #include "omaha/base/synchronized.h"
 #include "omaha/goopdate/installer_result_info.h"
+#include "omaha/third_party/smartany/scoped_any.h"
 
 // TODO(omaha): consider removing this dependency on the model.
 #include "omaha/goopdate/model.h"
@@ -36,6 +41,15 @@ namespace omaha {
 class AppVersion;
 class Process;
 
+// Receives the progress of an installer while it runs. The calls are made on
+// the thread which runs the installer.
+class InstallerProgressObserver {
+ public:
+  virtual ~InstallerProgressObserver() {}
+
+  // |install_progress_percentage| is in the range [0, 100].
+  virtual void OnInstallerProgress(int install_progress_percentage) = 0;
+};
 
 class InstallerWrapper {
  public:
@@ -51,6 +65,8 @@ class InstallerWrapper {
   //    information and a message for the installer error.
   //  * Other error values: Callers may use GetMessageForError() to convert the
   //    error value to an error message.
+  // The progress which the installer writes in the registry is reported to
+  // |observer| while the installer runs. |observer| can be NULL.
   HRESULT InstallApp(HANDLE user_token,
                      const GUID& app_guid,
                      const CString& installer_path,
@@ -59,6 +75,7 @@ class InstallerWrapper {
                      const CString& language,
                      const CString& untrusted_data,
                      int install_priority,
+                     InstallerProgressObserver* observer,
                      InstallerResultInfo* result_info);
 
   // Validate that the installer wrote the client key and the product version.
@@ -84,6 +101,27 @@ class InstallerWrapper {
     MAX_INSTALLER  // Last Installer Type value.
   };
 
+  // Bounds the number of installers of all the instances for the user or
+  // machine which run at the same time. Each slot is a named mutex, so the
+  // slot of an instance which exits while it holds the slot is recovered by
+  // the next instance which waits for it. A shared lock holds any one of the
+  // first |num_slots| slots, and an exclusive lock holds all of them.
+  class InstallSlots : public Lockable {
+   public:
+    explicit InstallSlots(bool is_exclusive)
+        : is_exclusive_(is_exclusive), num_slots_(0) {}
+    HRESULT Initialize(bool is_machine, int num_slots);
+    virtual bool Lock() const;
+    virtual bool Unlock() const;
+
+   private:
+    const bool is_exclusive_;
+    int num_slots_;
+    scoped_mutex slots_[kMaxConcurrentInstallsLimit];
+
+    DISALLOW_COPY_AND_ASSIGN(InstallSlots);
+  };
+
   // Determines the executable, command line, and installer type for
   // the installation based on the filename.
   static HRESULT BuildCommandLineFromFilename(const CString& filename,
@@ -102,6 +140,7 @@ class InstallerWrapper {
                                      const CString& language,
                                      const CString& untrusted_data,
                                      int install_priority,
+                                     InstallerProgressObserver* observer,
                                      InstallerResultInfo* result_info);
 
   // Executes the installer for ExecuteAndWaitForInstaller.
@@ -113,8 +152,23 @@ class InstallerWrapper {
                                        const CString& language,
                                        const CString& untrusted_data,
                                        int install_priority,
+                                       InstallerProgressObserver* observer,
                                        InstallerResultInfo* result_info);
 
+  // Waits for the installer to exit or to time out. The changes of the
+  // progress of the installer are reported to |observer| as the registry
+  // notifies them.
+  void WaitForInstaller(const GUID& app_guid,
+                        Process* p,
+                        InstallerProgressObserver* observer);
+
+  // Returns true if the installer must run alone.
+  bool IsSerialized(InstallerType installer_type) const;
+
+  // Initializes the lock which serializes the installers of |app_guid| which
+  // are not serialized by installer_lock_.
+  HRESULT InitializeAppInstallLock(const GUID& app_guid, GLock* lock) const;
+
   // Determines whether the installer succeeded and returns completion info.
   HRESULT GetInstallerResult(const GUID& app_guid,
                              InstallerType installer_type,
@@ -141,6 +195,7 @@ class InstallerWrapper {
                        const CString& language,
                        const CString& untrusted_data,
                        int install_priority,
+                       InstallerProgressObserver* observer,
                        InstallerResultInfo* result_info);
 
   // Whether this object is running in a machine Goopdate instance.
@@ -151,6 +206,10 @@ class InstallerWrapper {
   // kMsiAlreadyRunningRetryDelayBaseMs.
   int num_tries_when_msi_busy_;
 
+  // The number of installers which can run at the same time. MSI installers
+  // are always serialized.
+  int max_concurrent_installs_;
+
   // This is the base retry delay between retries when msiexec returns
   // ERROR_INSTALL_ALREADY_RUNNING. We exponentially backoff from this value.
   // Note that there is an additional delay for the MSI call, so the tries may
@@ -166,6 +225,13 @@ class InstallerWrapper {
   // global lock.
   GLock installer_lock_;
 
+  // The installers which are not serialized take the lock of their app and
+  // an install slot instead. The serialized installers take all the install
+  // slots after installer_lock_, so that they do not run at the same time as
+  // the installers of the instances which allow concurrent installs.
+  InstallSlots install_slot_;
+  InstallSlots all_install_slots_;
+
   friend class InstallerWrapperTest;
 
   DISALLOW_COPY_AND_ASSIGN(InstallerWrapper);
@@ -18,6 +18,7 @@
 #include <atlpath.h>
 #include <atlstr.h>
 #include <memory>
+#include <vector>
 
 #include "omaha/base/app_util.h"
 #include "omaha/base/error.h"
@@ -121,6 +122,33 @@ int GetNumMsiTries() {
   return IsBuildSystem() ? kNumMsiTriesOnBuildSystem : kNumMsiTriesDefault;
 }
 
+class RecordingProgressObserver : public InstallerProgressObserver {
+ public:
+  RecordingProgressObserver() {}
+
+  virtual void OnInstallerProgress(int install_progress_percentage) {
+    progress_.push_back(install_progress_percentage);
+  }
+
+  const std::vector<int>& progress() const { return progress_; }
+
+ private:
+  std::vector<int> progress_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingProgressObserver);
+};
+
+// Takes the lock and exits without releasing it.
+DWORD WINAPI LockAndExit(void* param) {
+  const Lockable* lock = static_cast<const Lockable*>(param);
+  return lock->Lock() ? 0 : 1;
+}
+
+DWORD WINAPI LockAndUnlock(void* param) {
+  const Lockable* lock = static_cast<const Lockable*>(param);
+  return lock->Lock() && lock->Unlock() ? 0 : 1;
+}
+
 }  // namespace
 
 extern const TCHAR kRegExecutable[] = _T("reg.exe");
@@ -397,6 +425,22 @@ class InstallerWrapperTest : public testing::Test {
         result_info);
   }
 
+  bool IsSerialized(int installer_type) const {
+    return iw_->IsSerialized(
+        static_cast<InstallerWrapper::InstallerType>(installer_type));
+  }
+
+  void SetMaxConcurrentInstalls(int max_concurrent_installs) {
+    iw_->max_concurrent_installs_ = max_concurrent_installs;
+    EXPECT_SUCCEEDED(iw_->install_slot_.Initialize(false,
+                                                   max_concurrent_installs));
+  }
+
+  const Lockable& install_slot() const { return iw_->install_slot_; }
+  const Lockable& all_install_slots() const {
+    return iw_->all_install_slots_;
+  }
+
   static const int kResultSuccess = AppManager::INSTALLER_RESULT_SUCCESS;
   static const int kResultFailedCustomError =
       AppManager::INSTALLER_RESULT_FAILED_CUSTOM_ERROR;
@@ -680,6 +724,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_InstallerWithoutFilenameExtension) {
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_UNKNOWN, result_info_.type);
@@ -701,6 +746,7 @@ TEST_F(InstallerWrapperUserTest,
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_UNKNOWN, result_info_.type);
@@ -721,6 +767,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_InstallerEmtpyFilename) {
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_UNKNOWN, result_info_.type);
@@ -742,6 +789,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_ExeFileDoesNotExist) {
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_UNKNOWN, result_info_.type);
@@ -789,6 +837,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_ExeInstallerWithArgumentsSucceeds) {
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -829,6 +878,7 @@ TEST_F(InstallerWrapperUserTest,
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_ERROR_OTHER, result_info_.type);
@@ -839,6 +889,84 @@ TEST_F(InstallerWrapperUserTest,
   EXPECT_EQ(POST_INSTALL_ACTION_DEFAULT, result_info_.post_install_action);
 }
 
+// The installer writes its progress in the ClientState key of the app. The
+// progress is reported to the observer, capped at 100.
+TEST_F(InstallerWrapperUserTest, InstallApp_ExeInstallerReportsProgress) {
+  const TCHAR kCommandToExecute[] =
+      _T("reg add \"%s\" /v InstallerProgress /t REG_DWORD /d 150 /f");
+
+  CString full_command_to_execute;
+  full_command_to_execute.Format(kCommandToExecute,
+                                 kFullAppClientStateKeyPath);
+  CString arguments;
+  arguments.Format(kExecuteCommandAndTerminateSwitch, full_command_to_execute);
+
+  ASSERT_SUCCEEDED(RegKey::CreateKey(kFullAppClientsKeyPath));
+  ASSERT_SUCCEEDED(RegKey::SetValue(kFullAppClientsKeyPath,
+                                    kRegValueProductVersion,
+                                    _T("0.10.69.5")));
+  ASSERT_SUCCEEDED(RegKey::CreateKey(kFullAppClientStateKeyPath));
+
+  RecordingProgressObserver observer;
+  __mutexScope(AppManager::Instance()->GetRegistryStableStateLock());
+  EXPECT_SUCCEEDED(iw_->InstallApp(NULL,
+                                   kAppGuid,
+                                   cmd_exe_path_,
+                                   arguments,
+                                   _T(""),  // Installer data.
+                                   kLanguageEnglish,
+                                   _T(""),  // Untrusted data.
+                                   0,
+                                   &observer,
+                                   &result_info_));
+
+  EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
+  ASSERT_FALSE(observer.progress().empty());
+  EXPECT_EQ(100, observer.progress().back());
+}
+
+TEST_F(InstallerWrapperUserTest, IsSerialized) {
+  SetMaxConcurrentInstalls(1);
+  EXPECT_TRUE(IsSerialized(kMsiInstaller));
+  EXPECT_TRUE(IsSerialized(kOtherInstaller));
+
+  SetMaxConcurrentInstalls(2);
+  EXPECT_TRUE(IsSerialized(kMsiInstaller));
+  EXPECT_FALSE(IsSerialized(kOtherInstaller));
+}
+
+TEST_F(InstallerWrapperUserTest, InstallSlots_RecoversAbandonedSlot) {
+  SetMaxConcurrentInstalls(1);
+
+  scoped_handle thread(::CreateThread(
+      NULL, 0, LockAndExit, const_cast<Lockable*>(&install_slot()), 0, NULL));
+  ASSERT_TRUE(thread);
+  ASSERT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(thread), 10000));
+  DWORD exit_code = 1;
+  EXPECT_TRUE(::GetExitCodeThread(get(thread), &exit_code));
+  EXPECT_EQ(0, exit_code);
+
+  EXPECT_TRUE(install_slot().Lock());
+  EXPECT_TRUE(install_slot().Unlock());
+}
+
+TEST_F(InstallerWrapperUserTest, InstallSlots_ExclusiveWaitsForSharedSlot) {
+  SetMaxConcurrentInstalls(2);
+
+  ASSERT_TRUE(install_slot().Lock());
+  scoped_handle thread(::CreateThread(
+      NULL, 0, LockAndUnlock, const_cast<Lockable*>(&all_install_slots()), 0,
+      NULL));
+  ASSERT_TRUE(thread);
+  EXPECT_EQ(WAIT_TIMEOUT, ::WaitForSingleObject(get(thread), 500));
+
+  EXPECT_TRUE(install_slot().Unlock());
+  ASSERT_EQ(WAIT_OBJECT_0, ::WaitForSingleObject(get(thread), 10000));
+  DWORD exit_code = 1;
+  EXPECT_TRUE(::GetExitCodeThread(get(thread), &exit_code));
+  EXPECT_EQ(0, exit_code);
+}
+
 /* TODO(omaha): Figure out a way to perform this test.
    ClearInstallerResultApiValues clears the result values it sets.
    TODO(omaha): Add another test that reports an error in using registry API.
@@ -869,6 +997,7 @@ TEST_F(InstallerWrapperUserTest,
                                    _T(""),  // Installer data.
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -927,6 +1056,7 @@ TEST_F(InstallerWrapperMachineTest, InstallApp_MsiInstallerSucceeds) {
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -992,6 +1122,7 @@ TEST_F(InstallerWrapperMachineTest,
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -1047,6 +1178,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_UpdateOmahaSucceeds) {
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -1086,6 +1218,7 @@ TEST_F(InstallerWrapperUserTest,
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -1113,6 +1246,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_InstallerDoesNotWriteClientsKey) {
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_FALSE(RegKey::HasKey(kFullAppClientsKeyPath));
@@ -1150,6 +1284,7 @@ TEST_F(InstallerWrapperUserTest,
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_ERROR_MSI, result_info_.type);
@@ -1194,6 +1329,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_MsiIsBusy_NoRetries) {
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_GT(2, install_timer.GetSeconds());  // Check Omaha did not retry.
@@ -1232,6 +1368,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_MsiIsBusy_TwoTries) {
                             kLanguageEnglish,
                             _T(""),  // Untrusted data.
                             0,
+                            NULL,  // Observer.
                             &result_info_));
 
   EXPECT_LE(5, install_timer.GetSeconds());  // Check Omaha did retry.
@@ -1285,6 +1422,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_InstallMultipleApps) {
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -1313,6 +1451,7 @@ TEST_F(InstallerWrapperUserTest, InstallApp_InstallMultipleApps) {
                                    kLanguageEnglish,
                                    _T(""),  // Untrusted data.
                                    0,
+                                   NULL,  // Observer.
                                    &result_info_));
 
   EXPECT_EQ(INSTALLER_RESULT_SUCCESS, result_info_.type);
@@ -28,6 +28,7 @@ Package::Package(AppVersion* app_version)
     : ModelObject(app_version->model()),
       app_version_(app_version),
       expected_size_(0),
+      diff_expected_size_(0),
       bytes_downloaded_(0),
       bytes_total_(0),
       next_download_retry_time_(0),
@@ -104,6 +105,8 @@ void Package::OnProgress(int bytes,
   bytes_total_ = bytes_total;
 
   progress_sampler_.AddSampleWithCurrentTimeStamp(bytes_downloaded_);
+
+  app_version_->app()->PublishProgress();
 }
 
 void Package::OnRequestBegin() {
@@ -112,12 +115,16 @@ void Package::OnRequestBegin() {
   bytes_downloaded_ = 0;
   bytes_total_ = 0;
   progress_sampler_.Reset();
+
+  app_version_->app()->PublishProgress();
 }
 
 void Package::OnRequestRetryScheduled(time64 next_download_retry_time) {
   __mutexScope(model()->lock());
   ASSERT1(next_download_retry_time >= GetCurrent100NSTime());
   next_download_retry_time_ = next_download_retry_time;
+
+  app_version_->app()->PublishProgress();
 }
 
 void Package::SetFileInfo(const CString& filename,
@@ -134,6 +141,20 @@ void Package::SetFileInfo(const CString& filename,
   expected_hash_ = expected_hash;
 }
 
+void Package::SetDiffInfo(const CString& filename,
+                          uint64 size,
+                          const CString& expected_hash) {
+  __mutexScope(model()->lock());
+
+  ASSERT1(!filename.IsEmpty());
+  ASSERT1(0 < size);
+  ASSERT1(!expected_hash.IsEmpty());
+
+  diff_filename_ = filename;
+  diff_expected_size_ = size;
+  diff_expected_hash_ = expected_hash;
+}
+
 CString Package::filename() const {
   __mutexScope(model()->lock());
   ASSERT1(!filename_.IsEmpty());
@@ -151,6 +172,26 @@ CString Package::expected_hash() const {
   return expected_hash_;
 }
 
+bool Package::has_diff() const {
+  __mutexScope(model()->lock());
+  return !diff_filename_.IsEmpty();
+}
+
+CString Package::diff_filename() const {
+  __mutexScope(model()->lock());
+  return diff_filename_;
+}
+
+uint64 Package::diff_expected_size() const {
+  __mutexScope(model()->lock());
+  return diff_expected_size_;
+}
+
+CString Package::diff_expected_hash() const {
+  __mutexScope(model()->lock());
+  return diff_expected_hash_;
+}
+
 uint64 Package::bytes_downloaded() const {
   __mutexScope(model()->lock());
   return bytes_downloaded_;
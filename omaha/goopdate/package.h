@@ -61,6 +61,10 @@ class Package
 
   void SetFileInfo(const CString& filename, uint64 size, const CString& hash);
 
+  // Sets the patch which rebuilds this package from the package of the
+  // installed version of the app.
+  void SetDiffInfo(const CString& filename, uint64 size, const CString& hash);
+
   // Returns the name of the file specified in the manifest.
   CString filename() const;
   // Returns the expected size of the file in bytes.
@@ -68,6 +72,13 @@ class Package
   // Returns expected file hashes.
   CString expected_hash() const;
 
+  // Returns true if the manifest specifies a patch for this package.
+  bool has_diff() const;
+  // Returns the name, the expected size, and the expected hash of the patch.
+  CString diff_filename() const;
+  uint64 diff_expected_size() const;
+  CString diff_expected_hash() const;
+
   uint64 bytes_downloaded() const;
 
   time64 next_download_retry_time() const;
@@ -86,6 +97,11 @@ class Package
   uint64 expected_size_;
   CString expected_hash_;
 
+  // The patch from the package of the installed version, if any.
+  CString diff_filename_;
+  uint64 diff_expected_size_;
+  CString diff_expected_hash_;
+
   int bytes_downloaded_;
   int bytes_total_;
   time64 next_download_retry_time_;
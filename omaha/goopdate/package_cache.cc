@@ -22,6 +22,7 @@
 #include "omaha/base/debug.h"
 #include "omaha/base/error.h"
 #include "omaha/base/file.h"
+#include "omaha/base/file_copy.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/string.h"
@@ -29,11 +30,19 @@
 #include "omaha/base/signaturevalidator.h"
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
+#include "omaha/goopdate/delta_patch.h"
 #include "omaha/goopdate/package_cache_internal.h"
 #include "omaha/goopdate/worker_metrics.h"
 
 namespace omaha {
 
+namespace {
+
+// PutFile does not hash larger files, like VerifyHash.
+const uint64 kMaxPackageSize = 1024 * 1024 * 1024;
+
+}  // namespace
+
 namespace internal {
 
 bool PackageSortByTimePredicate(const PackageInfo& package1,
@@ -229,6 +238,18 @@ bool PackageCache::IsCached(const Key& key, const CString& hash) const {
   return File::Exists(filename) && SUCCEEDED(VerifyHash(filename, hash));
 }
 
+bool PackageCache::Exists(const Key& key) const {
+  __mutexScope(cache_lock_);
+
+  CString filename;
+  HRESULT hr = BuildCacheFileNameForKey(key, &filename);
+  if (FAILED(hr)) {
+    return false;
+  }
+
+  return File::Exists(filename);
+}
+
 HRESULT PackageCache::Put(const Key& key,
                           File* source_file,
                           const CString& hash) {
@@ -282,6 +303,103 @@ HRESULT PackageCache::Put(const Key& key,
   return S_OK;
 }
 
+HRESULT PackageCache::PutFile(const Key& key,
+                              const CString& source_file_path,
+                              const CString& hash,
+                              bool move_file,
+                              bool* is_moved) {
+  ASSERT1(is_moved);
+
+  ++metric_worker_package_cache_put_total;
+  CORE_LOG(L3, (_T("[PackageCache::PutFile][key '%s'][%s][hash %s]"),
+                key.ToString(), source_file_path, hash));
+
+  *is_moved = false;
+
+  if (key.app_id().IsEmpty() || key.version().IsEmpty() ||
+      key.package_name().IsEmpty() ) {
+    return E_INVALIDARG;
+  }
+
+  CryptoHash crypto_hash;
+  std::vector<byte> expected_hash;
+  if (!SafeHexStringToVector(hash, &expected_hash) ||
+      !crypto_hash.IsValidSize(expected_hash.size())) {
+    return E_INVALIDARG;
+  }
+
+  uint64 file_size = 0;
+  HRESULT hr = File::GetFileSizeUnopen64(source_file_path, &file_size);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (file_size > kMaxPackageSize) {
+    return SIGS_E_FILE_SIZE_TOO_BIG;
+  }
+
+  CString destination_file;
+  {
+    __mutexScope(cache_lock_);
+
+    hr = BuildCacheFileNameForKey(key, &destination_file);
+    CORE_LOG(L3, (_T("[destination file '%s']"), destination_file));
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = CreateDir(GetDirectoryFromPath(destination_file), NULL);
+    if (FAILED(hr)) {
+      CORE_LOG(LE, (_T("[failed to create cache directory][0x%08x][%s]"),
+                    hr, destination_file));
+      return hr;
+    }
+  }
+
+  // MoveFileEx fails without MOVEFILE_COPY_ALLOWED if the file is on another
+  // volume, in which case the file is copied.
+  std::vector<byte> actual_hash;
+  if (move_file && ::MoveFileEx(source_file_path,
+                                destination_file,
+                                MOVEFILE_REPLACE_EXISTING)) {
+    *is_moved = true;
+    ++metric_worker_package_cache_put_moved;
+
+    // The packages expire by their creation time, which the move keeps.
+    FILETIME now = {0};
+    ::GetSystemTimeAsFileTime(&now);
+    hr = File::SetFileTime(destination_file, &now, NULL, NULL);
+    if (SUCCEEDED(hr)) {
+      hr = crypto_hash.Compute(destination_file, kMaxPackageSize,
+                               &actual_hash);
+    }
+    if (FAILED(hr)) {
+      ::DeleteFile(destination_file);
+    }
+  } else {
+    if (move_file) {
+      CORE_LOG(L3, (_T("[MoveFileEx failed, copying][0x%08x]"),
+                    HRESULTFromLastError()));
+    }
+    hr = CopyFileAndHash(source_file_path, destination_file, &actual_hash);
+  }
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[failed to put file in cache][0x%08x][%s]"),
+                  hr, destination_file));
+    return hr;
+  }
+
+  if (actual_hash != expected_hash) {
+    CORE_LOG(LE,
+        (_T("[failed to verify hash for file '%s'][expected hash %s]"),
+        destination_file, hash));
+    VERIFY1(::DeleteFile(destination_file));
+    return SIGS_E_INVALID_SIGNATURE;
+  }
+
+  ++metric_worker_package_cache_put_succeeded;
+  return S_OK;
+}
+
 HRESULT PackageCache::Get(const Key& key,
                           const CString& destination_file,
                           const CString& hash) const {
@@ -316,6 +434,35 @@ HRESULT PackageCache::Get(const Key& key,
   return File::Copy(source_file, destination_file, true);
 }
 
+HRESULT PackageCache::ApplyPatch(const Key& base_key,
+                                 File* patch_file,
+                                 File* destination_file) const {
+  ASSERT1(patch_file);
+  ASSERT1(destination_file);
+
+  CORE_LOG(L3, (_T("[PackageCache::ApplyPatch][key '%s']"),
+                base_key.ToString()));
+
+  __mutexScope(cache_lock_);
+
+  if (base_key.app_id().IsEmpty() || base_key.version().IsEmpty() ||
+      base_key.package_name().IsEmpty()) {
+    return E_INVALIDARG;
+  }
+
+  CString base_file;
+  HRESULT hr = BuildCacheFileNameForKey(base_key, &base_file);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  if (!File::Exists(base_file)) {
+    return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+  }
+
+  return ApplyDeltaPatch(base_file, patch_file, destination_file);
+}
+
 HRESULT PackageCache::Purge(const Key& key) {
   CORE_LOG(L3, (_T("[PackageCache::Purge][key '%s']"), key.ToString()));
 
@@ -69,12 +69,36 @@ class PackageCache {
               File* source_file,
               const CString& hash);
 
+  // Puts the file at |source_file_path| in the cache. Unlike Put, the file is
+  // hashed while it is copied and the cache lock is not held during the copy,
+  // therefore several files can be put concurrently. If |move_file| is true,
+  // the file is moved instead of copied when it is on the same volume as the
+  // cache, and |is_moved| is set to true.
+  HRESULT PutFile(const Key& key,
+                  const CString& source_file_path,
+                  const CString& hash,
+                  bool move_file,
+                  bool* is_moved);
+
   HRESULT Get(const Key& key,
               const CString& destination_file,
               const CString& hash) const;
 
   bool IsCached(const Key& key, const CString& hash) const;
 
+  // Returns true if a package is cached for the key. Unlike IsCached, the hash
+  // of the package is not verified.
+  bool Exists(const Key& key) const;
+
+  // Applies the patch read from |patch_file| to the cached package of
+  // |base_key| and writes the patched package to |destination_file|. The hash
+  // of the cached package is verified against the hash in the patch, since the
+  // manifest only has the hash of the new package. The caller verifies the
+  // patched package.
+  HRESULT ApplyPatch(const Key& base_key,
+                     File* patch_file,
+                     File* destination_file) const;
+
   HRESULT Purge(const Key& key);
 
   HRESULT PurgeVersion(const CString& app_id, const CString& version);
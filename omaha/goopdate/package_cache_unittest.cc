@@ -20,6 +20,7 @@
 #include "omaha/base/safe_format.h"
 #include "omaha/base/string.h"
 #include "omaha/base/utils.h"
+#include "omaha/goopdate/delta_patch.h"
 #include "omaha/goopdate/package_cache.h"
 #include "omaha/testing/unit_test.h"
 
@@ -257,6 +258,43 @@ TEST_F(PackageCacheTest, PutBadHashTest) {
   EXPECT_FALSE(package_cache_.IsCached(key1, hash_file1_));
 }
 
+TEST_F(PackageCacheTest, PutFileTest) {
+  EXPECT_HRESULT_SUCCEEDED(package_cache_.PurgeAll());
+
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  // The file is copied.
+  bool is_moved = true;
+  EXPECT_SUCCEEDED(package_cache_.PutFile(key1, source_file1_, hash_file1_,
+                                          false, &is_moved));
+  EXPECT_FALSE(is_moved);
+  EXPECT_TRUE(package_cache_.IsCached(key1, hash_file1_));
+  EXPECT_TRUE(File::Exists(source_file1_));
+  EXPECT_EQ(size_file1_, package_cache_.Size());
+
+  // A file on the same volume as the cache is moved.
+  const CString temp_file(ConcatenatePath(cache_root_, _T("temp_file")));
+  EXPECT_SUCCEEDED(File::Copy(source_file2_, temp_file, true));
+  EXPECT_SUCCEEDED(package_cache_.PutFile(key2, temp_file, hash_file2_,
+                                          true, &is_moved));
+  EXPECT_TRUE(is_moved);
+  EXPECT_TRUE(package_cache_.IsCached(key2, hash_file2_));
+  EXPECT_FALSE(File::Exists(temp_file));
+  EXPECT_EQ(size_file1_ + size_file2_, package_cache_.Size());
+
+  // A file which does not match the hash is not cached.
+  EXPECT_SUCCEEDED(package_cache_.Purge(key2));
+  EXPECT_EQ(SIGS_E_INVALID_SIGNATURE,
+            package_cache_.PutFile(key2, source_file1_, hash_file2_,
+                                   false, &is_moved));
+  EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
+  EXPECT_TRUE(File::Exists(source_file1_));
+
+  EXPECT_EQ(E_INVALIDARG, package_cache_.PutFile(key2, source_file2_, _T("b"),
+                                                 false, &is_moved));
+}
+
 // The key must include the app id, version, and package name for Put and Get
 // operations. If the version is not provided, "0.0.0.0" is used internally.
 TEST_F(PackageCacheTest, BadKeyTest) {
@@ -528,6 +566,77 @@ TEST_F(PackageCacheTest, PurgeExpiredCacheFiles) {
   EXPECT_FALSE(package_cache_.IsCached(key2, hash_file2_));
 }
 
+TEST_F(PackageCacheTest, ApplyPatch) {
+  std::vector<byte> old_data;
+  EXPECT_SUCCEEDED(ReadEntireFileShareMode(source_file1_, 0, FILE_SHARE_READ,
+                                           &old_data));
+  std::vector<byte> other_data;
+  EXPECT_SUCCEEDED(ReadEntireFileShareMode(source_file2_, 0, FILE_SHARE_READ,
+                                           &other_data));
+
+  // The new package changes a few bytes of the old package and inserts a few.
+  std::vector<byte> new_data(old_data);
+  new_data[1000] ^= 0xff;
+  new_data[100000] ^= 0xff;
+  new_data.insert(new_data.begin() + 50000, other_data.begin(),
+                  other_data.begin() + 100);
+
+  std::vector<byte> patch;
+  EXPECT_SUCCEEDED(CreateDeltaPatch(old_data, new_data, &patch));
+  EXPECT_GT(new_data.size() / 10, patch.size());
+
+  const CString patch_path(GetTempFilename(_T("ut_")));
+  const CString destination_path(GetTempFilename(_T("ut_")));
+  EXPECT_SUCCEEDED(WriteEntireFile(patch_path, patch));
+
+  File patch_file;
+  EXPECT_SUCCEEDED(patch_file.OpenShareMode(patch_path,
+                                            false,
+                                            false,
+                                            FILE_SHARE_READ));
+
+  Key key1(_T("app1"), _T("ver1"), _T("package1"));
+  Key key2(_T("app2"), _T("ver2"), _T("package2"));
+
+  // The package of the previous version is not cached.
+  EXPECT_FALSE(package_cache_.Exists(key1));
+  {
+    File destination_file;
+    EXPECT_SUCCEEDED(destination_file.Open(destination_path, true, false));
+    EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+              package_cache_.ApplyPatch(key1, &patch_file, &destination_file));
+  }
+
+  EXPECT_SUCCEEDED(package_cache_.Put(key1, &source_file1_file_, hash_file1_));
+  EXPECT_TRUE(package_cache_.Exists(key1));
+  {
+    File destination_file;
+    EXPECT_SUCCEEDED(destination_file.Open(destination_path, true, false));
+    EXPECT_SUCCEEDED(package_cache_.ApplyPatch(key1,
+                                               &patch_file,
+                                               &destination_file));
+  }
+
+  std::vector<byte> patched_data;
+  EXPECT_SUCCEEDED(ReadEntireFile(destination_path, 0, &patched_data));
+  EXPECT_TRUE(new_data == patched_data);
+
+  // The patch does not apply to another package.
+  EXPECT_TRUE(::DeleteFile(destination_path));
+  EXPECT_SUCCEEDED(patch_file.SeekToBegin());
+  EXPECT_SUCCEEDED(package_cache_.Put(key2, &source_file2_file_, hash_file2_));
+  {
+    File destination_file;
+    EXPECT_SUCCEEDED(destination_file.Open(destination_path, true, false));
+    EXPECT_EQ(GOOPDATEDOWNLOAD_E_INVALID_PATCH,
+              package_cache_.ApplyPatch(key2, &patch_file, &destination_file));
+  }
+
+  EXPECT_SUCCEEDED(patch_file.Close());
+  EXPECT_TRUE(::DeleteFile(patch_path));
+  EXPECT_TRUE(::DeleteFile(destination_path));
+}
+
 TEST_F(PackageCacheTest, VerifyHash) {
   EXPECT_HRESULT_SUCCEEDED(PackageCache::VerifyHash(source_file1_,
                                                     hash_file1_));
@@ -14,12 +14,16 @@
 // ========================================================================
 
 #include "omaha/goopdate/update3web.h"
+#include <memory>
 #include "omaha/base/constants.h"
 #include "omaha/base/error.h"
 #include "omaha/base/user_rights.h"
+#include "omaha/base/utils.h"
 #include "omaha/common/const_cmd_line.h"
+#include "omaha/common/progress_table.h"
 #include "omaha/common/update3_utils.h"
 #include "omaha/common/lang.h"
+#include "omaha/goopdate/current_state.h"
 
 namespace omaha {
 
@@ -41,6 +45,46 @@ HRESULT ComInitHelper(T data, Z** p) {
   return object->QueryInterface(IID_PPV_ARGS(p));
 }
 
+template <typename Base, typename T1, typename T2, typename Z>
+HRESULT ComInitHelper(T1 data1, T2 data2, Z** p) {
+  *p = NULL;
+  CComObject<Base>* object;
+  HRESULT hr = CComObject<Base>::CreateInstance(&object);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  CComPtr<IUnknown> object_releaser = object;
+  hr = object->Init(data1, data2);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  return object->QueryInterface(IID_PPV_ARGS(p));
+}
+
+// The progress table of an AppBundleWeb, which its AppWeb objects share. The
+// table is opened once the bundle has a session ID and the worker has created
+// the table.
+class BundleProgress {
+ public:
+  explicit BundleProgress(bool is_machine) : is_machine_(is_machine) {}
+
+  void set_session_id(const CString& session_id) { session_id_ = session_id; }
+
+  bool Read(const GUID& app_guid, AppProgress* progress) {
+    if (!table_.is_open() && !session_id_.IsEmpty()) {
+      table_.Open(is_machine_, session_id_);
+    }
+    return table_.Read(app_guid, progress);
+  }
+
+ private:
+  const bool is_machine_;
+  CString session_id_;
+  ProgressTable table_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleProgress);
+};
+
 class ATL_NO_VTABLE AppBundleWeb
     : public CComObjectRootEx<CComObjectThreadModel>,
       public IDispatchImpl<IAppBundleWeb,
@@ -85,6 +129,7 @@ class ATL_NO_VTABLE AppBundleWeb
   Update3WebBase* update3web_;
   CComPtr<IAppBundle> app_bundle_;
   bool has_installed_app_;
+  std::shared_ptr<BundleProgress> bundle_progress_;
 
   DISALLOW_COPY_AND_ASSIGN(AppBundleWeb);
 };
@@ -98,7 +143,8 @@ class ATL_NO_VTABLE AppWeb
                            kMinorTypeLibVersion> {
  public:
   AppWeb();
-  HRESULT Init(IApp* app);
+  HRESULT Init(IApp* app,
+               const std::shared_ptr<BundleProgress>& bundle_progress);
 
   DECLARE_NOT_AGGREGATABLE(AppWeb);
   DECLARE_NO_REGISTRY();
@@ -123,7 +169,15 @@ class ATL_NO_VTABLE AppWeb
   virtual ~AppWeb();
 
  private:
+  // Reads the state of the app from the progress table. Returns false if the
+  // state has to be obtained from the COM server.
+  bool ReadProgress(AppProgress* progress);
+
   CComPtr<IApp> app_;
+  std::shared_ptr<BundleProgress> bundle_progress_;
+
+  // Obtained from app_ the first time the state is read.
+  GUID app_guid_;
 
   DISALLOW_COPY_AND_ASSIGN(AppWeb);
 };
@@ -207,6 +261,9 @@ HRESULT AppBundleWeb::Init(Update3WebBase* update3web) {
   update3web_ = update3web;
   update3web_->AddRef();
 
+  bundle_progress_.reset(
+      new BundleProgress(update3web_->is_machine_install()));
+
   HRESULT hr = update3_utils::CreateAppBundle(update3web_->omaha_server(),
                                               &app_bundle_);
   if (FAILED(hr)) {
@@ -298,7 +355,7 @@ STDMETHODIMP AppBundleWeb::get_appWeb(int index, IDispatch** app_web) {
     return hr;
   }
 
-  return ComInitHelper<AppWeb>(app.p, app_web);
+  return ComInitHelper<AppWeb>(app.p, bundle_progress_, app_web);
 }
 
 AppBundleWeb::AppBundleWeb() : update3web_(NULL), has_installed_app_(false) {
@@ -382,7 +439,18 @@ AppBundleWeb::~AppBundleWeb() {
 }
 
 STDMETHODIMP AppBundleWeb::initialize() {
-  return app_bundle_->initialize();
+  HRESULT hr = app_bundle_->initialize();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // The bundle has a session ID once it is initialized.
+  CComBSTR session_id;
+  if (SUCCEEDED(app_bundle_->get_sessionId(&session_id))) {
+    bundle_progress_->set_session_id(CString(session_id));
+  }
+
+  return hr;
 }
 
 STDMETHODIMP AppBundleWeb::checkForUpdate() {
@@ -440,11 +508,13 @@ STDMETHODIMP AppBundleWeb::get_currentState(VARIANT* current_state) {
   return app_bundle_->get_currentState(current_state);
 }
 
-AppWeb::AppWeb() {
+AppWeb::AppWeb() : app_guid_(GUID_NULL) {
 }
 
-HRESULT AppWeb::Init(IApp* app) {
+HRESULT AppWeb::Init(IApp* app,
+                     const std::shared_ptr<BundleProgress>& bundle_progress) {
   app_ = app;
+  bundle_progress_ = bundle_progress;
   return S_OK;
 }
 
@@ -511,7 +581,69 @@ STDMETHODIMP AppWeb::cancel() {
 
 STDMETHODIMP AppWeb::get_currentState(IDispatch** current_state) {
   *current_state = NULL;
-  return app_->get_currentState(current_state);
+
+  AppProgress progress;
+  if (!ReadProgress(&progress)) {
+    return app_->get_currentState(current_state);
+  }
+
+  // The app has not completed, so it has no error or completion values.
+  CComObject<CurrentAppState>* state_object = NULL;
+  HRESULT hr = CurrentAppState::Create(progress.state,
+                                       progress.available_version,
+                                       progress.bytes_downloaded,
+                                       progress.total_bytes_to_download,
+                                       progress.download_time_remaining_ms,
+                                       progress.next_download_retry_time,
+                                       progress.install_progress_percentage,
+                                       progress.install_time_remaining_ms,
+                                       false,
+                                       S_OK,
+                                       0,
+                                       CString(),
+                                       0,
+                                       0,
+                                       CString(),
+                                       CString(),
+                                       POST_INSTALL_ACTION_DEFAULT,
+                                       &state_object);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  return state_object->QueryInterface(current_state);
+}
+
+bool AppWeb::ReadProgress(AppProgress* progress) {
+  ASSERT1(progress);
+
+  if (!bundle_progress_) {
+    return false;
+  }
+
+  if (::IsEqualGUID(app_guid_, GUID_NULL)) {
+    CComBSTR app_id;
+    if (FAILED(app_->get_appId(&app_id)) ||
+        FAILED(StringToGuidSafe(CString(app_id), &app_guid_))) {
+      return false;
+    }
+  }
+
+  if (!bundle_progress_->Read(app_guid_, progress)) {
+    return false;
+  }
+
+  // The completion values of the apps which have completed are only known to
+  // the COM server.
+  switch (progress->state) {
+    case STATE_INIT:
+    case STATE_NO_UPDATE:
+    case STATE_INSTALL_COMPLETE:
+    case STATE_ERROR:
+      return false;
+    default:
+      return true;
+  }
 }
 
 STDMETHODIMP AppWeb::launch() {
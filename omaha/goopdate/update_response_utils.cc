@@ -220,6 +220,14 @@ HRESULT BuildApp(const xml::UpdateResponse* update_response,
     if (FAILED(hr)) {
       return hr;
     }
+
+    if (!package.name_diff.IsEmpty()) {
+      Package* added_package(next_version->GetPackage(
+          next_version->GetNumberOfPackages() - 1));
+      added_package->SetDiffInfo(package.name_diff,
+                                 package.size_diff,
+                                 package.hash_diff_sha256);
+    }
   }
 
   if (!app->untrusted_data().IsEmpty()) {
@@ -0,0 +1,430 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/usage_data_collector.h"
+
+#include <utility>
+
+#include "omaha/base/const_utils.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/string.h"
+#include "omaha/base/user_info.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/config_manager.h"
+
+namespace omaha {
+
+namespace {
+
+// The keys of the registry classes of the users are also under HKU, as
+// "<sid>_Classes". They never contain a ClientState key.
+const TCHAR kClassesKeySuffix[] = _T("_Classes");
+
+}  // namespace
+
+HRESULT RegKeyUsageDataBackend::GetUserKeyNames(
+    std::vector<CString>* user_key_names) {
+  ASSERT1(user_key_names);
+  user_key_names->clear();
+
+  RegKey users_key;
+  HRESULT hr = users_key.Open(USERS_KEY, KEY_READ);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const uint32 num_users = users_key.GetSubkeyCount();
+  for (uint32 i = 0; i < num_users; ++i) {
+    CString user_key_name;
+    hr = users_key.GetSubkeyNameAt(i, &user_key_name);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[Key enum failed.][0x%08x][%d][%s]"),
+                    hr, i, USERS_KEY));
+      continue;
+    }
+
+    if (!String_EndsWith(user_key_name, kClassesKeySuffix, true)) {
+      user_key_names->push_back(user_key_name);
+    }
+  }
+
+  return S_OK;
+}
+
+HRESULT RegKeyUsageDataBackend::GetSubkeys(
+    const CString& key_name,
+    std::vector<RegistrySubkeyInfo>* subkeys) {
+  ASSERT1(subkeys);
+  subkeys->clear();
+
+  RegKey key;
+  HRESULT hr = key.Open(key_name, KEY_READ);
+  if (hr == HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND)) {
+    return S_FALSE;
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // RegKey::GetSubkeyNameAt does not return the last write time.
+  for (DWORD i = 0; ; ++i) {
+    TCHAR subkey_name[kMaxKeyNameChars] = {0};
+    DWORD subkey_name_size = arraysize(subkey_name);
+    RegistrySubkeyInfo subkey;
+    LONG result = ::RegEnumKeyEx(key.Key(),
+                                 i,
+                                 subkey_name,
+                                 &subkey_name_size,
+                                 NULL,
+                                 NULL,
+                                 NULL,
+                                 &subkey.last_write_time);
+    if (result == ERROR_NO_MORE_ITEMS) {
+      return S_OK;
+    }
+    if (result != ERROR_SUCCESS) {
+      return HRESULT_FROM_WIN32(result);
+    }
+
+    subkey.name = subkey_name;
+    subkeys->push_back(subkey);
+  }
+}
+
+HRESULT RegKeyUsageDataBackend::ReadDidRun(const CString& key_name,
+                                           bool* did_run) {
+  ASSERT1(did_run);
+
+  RegKey key;
+  HRESULT hr = key.Open(key_name, KEY_READ);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  DWORD type = REG_NONE;
+  hr = key.GetValueType(kRegValueDidRun, &type);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  switch (type) {
+    case REG_DWORD: {
+      DWORD value = 0;
+      hr = key.GetValue(kRegValueDidRun, &value);
+      *did_run = value == 1;
+      return hr;
+    }
+    case REG_SZ: {
+      CString value;
+      hr = key.GetValue(kRegValueDidRun, &value);
+      *did_run = value == _T("1");
+      return hr;
+    }
+    default:
+      return HRESULT_FROM_WIN32(ERROR_DATATYPE_MISMATCH);
+  }
+}
+
+HRESULT RegKeyUsageDataBackend::ClearDidRun(const CString& key_name) {
+  // Opens the key first, since RegKey::SetValue creates missing keys.
+  RegKey key;
+  HRESULT hr = key.Open(key_name);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  return key.SetValue(kRegValueDidRun, _T("0"));
+}
+
+HRESULT RegKeyUsageDataBackend::DeleteDidRun(const CString& key_name) {
+  return RegKey::DeleteValue(key_name, kRegValueDidRun);
+}
+
+UsageDataCollector::UsageDataCollector(
+    bool is_machine,
+    bool check_low_integrity,
+    std::unique_ptr<UsageDataBackendInterface> backend)
+    : is_machine_(is_machine),
+      check_low_integrity_(check_low_integrity),
+      backend_(std::move(backend)),
+      has_swept_(false),
+      last_sweep_ms_(0),
+      max_sweep_age_ms_(0),
+      num_sweeps_(0),
+      num_values_read_(0) {
+  ASSERT1(backend_.get());
+}
+
+UsageDataCollector::~UsageDataCollector() {
+}
+
+HRESULT UsageDataCollector::Collect() {
+  __mutexScope(lock_);
+
+  std::vector<CString> key_names;
+  HRESULT hr = GetClientStateKeyNames(&key_names);
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[GetClientStateKeyNames failed][0x%08x]"), hr));
+    return hr;
+  }
+
+  // The keys of the users who are no longer logged on are dropped.
+  const AppMap no_apps;
+  ClientStateMap user_keys;
+  for (size_t i = 0; i != key_names.size(); ++i) {
+    CString lower_key_name(key_names[i]);
+    lower_key_name.MakeLower();
+
+    ClientStateMap::const_iterator it = user_keys_.find(lower_key_name);
+    ClientStateKey& key = user_keys[lower_key_name];
+    key.name = key_names[i];
+    SweepKey(key.name,
+             it == user_keys_.end() ? no_apps : it->second.apps,
+             &key.apps);
+  }
+  user_keys_.swap(user_keys);
+
+  if (is_machine_) {
+    AppMap machine_apps;
+    SweepKey(ConfigManager::Instance()->registry_client_state(true),
+             machine_apps_,
+             &machine_apps);
+    machine_apps_.swap(machine_apps);
+  }
+
+  AggregateActiveStates();
+
+  has_swept_ = true;
+  last_sweep_ms_ = ::GetTickCount64();
+  ++num_sweeps_;
+  return S_OK;
+}
+
+ActiveStates UsageDataCollector::GetActiveState(const CString& app_guid) {
+  __mutexScope(lock_);
+
+  HRESULT hr = CollectIfStale();
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[UsageDataCollector::Collect failed][0x%08x]"), hr));
+  }
+
+  CString app_id(app_guid);
+  app_id.MakeLower();
+  std::map<CString, ActiveStates>::const_iterator it =
+      active_states_.find(app_id);
+  return it == active_states_.end() ? ACTIVE_UNKNOWN : it->second;
+}
+
+HRESULT UsageDataCollector::ResetDidRun(const CString& app_guid) {
+  CORE_LOG(L4, (_T("[UsageDataCollector::ResetDidRun][%s]"), app_guid));
+  __mutexScope(lock_);
+
+  HRESULT hr = CollectIfStale();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  CString app_id(app_guid);
+  app_id.MakeLower();
+
+  // The values which are already "0" are not written again. Each write
+  // changes the last write time of the key, so the next sweep reads the key
+  // again.
+  HRESULT result = S_OK;
+  bool user_value_exists = false;
+  for (ClientStateMap::iterator it = user_keys_.begin();
+       it != user_keys_.end();
+       ++it) {
+    AppMap::iterator app = it->second.apps.find(app_id);
+    if (app == it->second.apps.end() || !app->second.exists) {
+      continue;
+    }
+
+    user_value_exists = true;
+    if (!app->second.did_run) {
+      continue;
+    }
+
+    const CString key_name(AppendRegKeyPath(it->second.name, app_guid));
+    hr = backend_->ClearDidRun(key_name);
+    if (FAILED(hr)) {
+      CORE_LOG(LW, (_T("[ClearDidRun failed][0x%08x][%s]"), hr, key_name));
+      result = hr;
+    }
+    app->second.did_run = false;
+    ::ZeroMemory(&app->second.last_write_time,
+                 sizeof(app->second.last_write_time));
+  }
+
+  if (is_machine_) {
+    AppMap::iterator app = machine_apps_.find(app_id);
+    if (app != machine_apps_.end() && app->second.exists) {
+      const CString key_name(AppendRegKeyPath(
+          ConfigManager::Instance()->registry_client_state(true), app_guid));
+
+      // Once the installer of the app writes the did run values of the users,
+      // the value under HKLM is obsolete.
+      hr = S_OK;
+      if (user_value_exists) {
+        hr = backend_->DeleteDidRun(key_name);
+        app->second.exists = false;
+      } else if (app->second.did_run) {
+        hr = backend_->ClearDidRun(key_name);
+      }
+      if (FAILED(hr)) {
+        CORE_LOG(LW, (_T("[Reset failed][0x%08x][%s]"), hr, key_name));
+        result = hr;
+      }
+      app->second.did_run = false;
+      ::ZeroMemory(&app->second.last_write_time,
+                   sizeof(app->second.last_write_time));
+    }
+  }
+
+  std::map<CString, ActiveStates>::iterator it = active_states_.find(app_id);
+  if (it != active_states_.end()) {
+    it->second = ACTIVE_NOTRUN;
+  }
+
+  return result;
+}
+
+HRESULT UsageDataCollector::CollectIfStale() {
+  if (has_swept_ &&
+      ::GetTickCount64() - last_sweep_ms_ < max_sweep_age_ms_) {
+    return S_OK;
+  }
+  return Collect();
+}
+
+HRESULT UsageDataCollector::GetClientStateKeyNames(
+    std::vector<CString>* key_names) {
+  ASSERT1(key_names);
+  key_names->clear();
+
+  if (!is_machine_) {
+    key_names->push_back(
+        ConfigManager::Instance()->registry_client_state(false));
+
+    if (check_low_integrity_) {
+      // IE in protected mode writes to a low integrity copy of HKCU. The key
+      // is accessed directly, so that ieframe.dll is not loaded.
+      if (user_sid_.IsEmpty()) {
+        HRESULT hr = user_info::GetProcessUser(NULL, NULL, &user_sid_);
+        if (FAILED(hr)) {
+          CORE_LOG(LW, (_T("[GetProcessUser failed][0x%08x]"), hr));
+          return S_OK;
+        }
+      }
+
+      key_names->push_back(AppendRegKeyPath(
+          AppendRegKeyPath(USER_KEY_NAME,
+                           USER_REG_VISTA_LOW_INTEGRITY_HKCU,
+                           user_sid_),
+          GOOPDATE_REG_RELATIVE_CLIENT_STATE));
+    }
+    return S_OK;
+  }
+
+  std::vector<CString> user_key_names;
+  HRESULT hr = backend_->GetUserKeyNames(&user_key_names);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (size_t i = 0; i != user_key_names.size(); ++i) {
+    const CString& sid = user_key_names[i];
+    key_names->push_back(AppendRegKeyPath(USERS_KEY,
+                                          sid,
+                                          GOOPDATE_REG_RELATIVE_CLIENT_STATE));
+
+    if (check_low_integrity_) {
+      key_names->push_back(AppendRegKeyPath(
+          AppendRegKeyPath(USERS_KEY, sid, USER_REG_VISTA_LOW_INTEGRITY_HKCU),
+          sid,
+          GOOPDATE_REG_RELATIVE_CLIENT_STATE));
+    }
+  }
+
+  return S_OK;
+}
+
+void UsageDataCollector::SweepKey(const CString& key_name,
+                                  const AppMap& previous_apps,
+                                  AppMap* apps) {
+  ASSERT1(apps);
+  ASSERT1(apps->empty());
+
+  std::vector<RegistrySubkeyInfo> subkeys;
+  HRESULT hr = backend_->GetSubkeys(key_name, &subkeys);
+  if (FAILED(hr)) {
+    CORE_LOG(L4, (_T("[GetSubkeys failed][%s][0x%08x]"), key_name, hr));
+    return;
+  }
+
+  for (size_t i = 0; i != subkeys.size(); ++i) {
+    CString app_id(subkeys[i].name);
+    app_id.MakeLower();
+
+    AppMap::const_iterator previous = previous_apps.find(app_id);
+    if (previous != previous_apps.end() &&
+        ::CompareFileTime(&previous->second.last_write_time,
+                          &subkeys[i].last_write_time) == 0) {
+      apps->insert(apps->end(), *previous);
+      continue;
+    }
+
+    AppEntry entry = { subkeys[i].last_write_time, false, false };
+    bool did_run = false;
+    ++num_values_read_;
+    if (SUCCEEDED(backend_->ReadDidRun(
+            AppendRegKeyPath(key_name, subkeys[i].name), &did_run))) {
+      entry.exists = true;
+      entry.did_run = did_run;
+    }
+    apps->insert(apps->end(), std::make_pair(app_id, entry));
+  }
+}
+
+void UsageDataCollector::AggregateActiveStates() {
+  active_states_.clear();
+
+  for (ClientStateMap::const_iterator it = user_keys_.begin();
+       it != user_keys_.end();
+       ++it) {
+    AddActiveStates(it->second.apps);
+  }
+  AddActiveStates(machine_apps_);
+}
+
+// An app did run if any of the keys says so.
+void UsageDataCollector::AddActiveStates(const AppMap& apps) {
+  for (AppMap::const_iterator app = apps.begin(); app != apps.end(); ++app) {
+    if (!app->second.exists) {
+      continue;
+    }
+
+    // Inserts ACTIVE_NOTRUN for the first key which has a value for the app.
+    ActiveStates& state = active_states_[app->first];
+    if (app->second.did_run) {
+      state = ACTIVE_RUN;
+    }
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,190 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// UsageDataCollector reads the did run values of all the apps in one sweep
+// of the ClientState keys of the users, instead of opening the ClientState
+// key of each app under each user as ApplicationUsageData does. On terminal
+// servers with many users, ApplicationUsageData costs a registry read per
+// user for each app on each update check.
+//
+// The sweep enumerates the subkeys of each ClientState key, which returns the
+// last write time of the key of each app. The did run value of an app is only
+// read again when the key of the app has been written since the last sweep,
+// so a sweep of an unchanged registry costs one enumeration per user.
+//
+// The did run values are aggregated the same way ApplicationUsageData does:
+// an app did run if any user has a did run value of "1" for it, and the state
+// is unknown if no user has a did run value for it. For machine apps, the
+// ClientState key of the app under HKLM is also read, for the installers which
+// still write the value there.
+
+#ifndef OMAHA_GOOPDATE_USAGE_DATA_COLLECTOR_H_
+#define OMAHA_GOOPDATE_USAGE_DATA_COLLECTOR_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/common/const_goopdate.h"
+
+namespace omaha {
+
+// A subkey and the last time it or its values were written.
+struct RegistrySubkeyInfo {
+  CString name;
+  FILETIME last_write_time;
+};
+
+// The registry operations of a sweep. Abstracted so that the collector can be
+// tested and benchmarked with a fake registry of many users.
+class UsageDataBackendInterface {
+ public:
+  virtual ~UsageDataBackendInterface() {}
+
+  // Returns the names of the keys under HKU which may be the hives of users.
+  virtual HRESULT GetUserKeyNames(std::vector<CString>* user_key_names) = 0;
+
+  // Enumerates the immediate subkeys of |key_name|. Returns S_FALSE if the
+  // key does not exist.
+  virtual HRESULT GetSubkeys(const CString& key_name,
+                             std::vector<RegistrySubkeyInfo>* subkeys) = 0;
+
+  // Reads the did run value of |key_name|, which is either a string or a
+  // DWORD. Fails if the key or the value does not exist.
+  virtual HRESULT ReadDidRun(const CString& key_name, bool* did_run) = 0;
+
+  // Sets the did run value of |key_name| to "0".
+  virtual HRESULT ClearDidRun(const CString& key_name) = 0;
+
+  // Deletes the did run value of |key_name|.
+  virtual HRESULT DeleteDidRun(const CString& key_name) = 0;
+};
+
+// Reads and writes the did run values in the registry.
+class RegKeyUsageDataBackend : public UsageDataBackendInterface {
+ public:
+  RegKeyUsageDataBackend() {}
+
+  virtual HRESULT GetUserKeyNames(std::vector<CString>* user_key_names);
+  virtual HRESULT GetSubkeys(const CString& key_name,
+                             std::vector<RegistrySubkeyInfo>* subkeys);
+  virtual HRESULT ReadDidRun(const CString& key_name, bool* did_run);
+  virtual HRESULT ClearDidRun(const CString& key_name);
+  virtual HRESULT DeleteDidRun(const CString& key_name);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(RegKeyUsageDataBackend);
+};
+
+class UsageDataCollector {
+ public:
+  UsageDataCollector(bool is_machine,
+                     bool check_low_integrity,
+                     std::unique_ptr<UsageDataBackendInterface> backend);
+  ~UsageDataCollector();
+
+  // Sweeps the ClientState keys of the users. Only the did run values of the
+  // apps whose keys changed since the last sweep are read.
+  HRESULT Collect();
+
+  // Returns the did run state of the app. Sweeps first if the last sweep is
+  // older than the maximum sweep age, so that the apps of a bundle, which are
+  // read one after the other, share one sweep.
+  ActiveStates GetActiveState(const CString& app_guid);
+
+  // Clears the did run values of the app, the same way
+  // ApplicationUsageData::ResetDidRun does. Sweeps first if the last sweep is
+  // older than the maximum sweep age.
+  HRESULT ResetDidRun(const CString& app_guid);
+
+  // 0 makes each call to GetActiveState and ResetDidRun sweep.
+  void set_max_sweep_age_ms(uint64 max_sweep_age_ms) {
+    max_sweep_age_ms_ = max_sweep_age_ms;
+  }
+
+  // The number of sweeps, and of did run values read by them.
+  int num_sweeps() const { return num_sweeps_; }
+  int num_values_read() const { return num_values_read_; }
+
+ private:
+  // The did run value of an app under one ClientState key.
+  struct AppEntry {
+    FILETIME last_write_time;
+    bool exists;
+    bool did_run;
+  };
+
+  // Entries keyed by the lowercase app id.
+  typedef std::map<CString, AppEntry> AppMap;
+
+  // A ClientState key of a user and its app entries.
+  struct ClientStateKey {
+    CString name;
+    AppMap apps;
+  };
+
+  // The ClientState keys of the users, keyed by the lowercase key name.
+  typedef std::map<CString, ClientStateKey> ClientStateMap;
+
+  HRESULT CollectIfStale();
+
+  // Returns the names of the ClientState keys of the users.
+  HRESULT GetClientStateKeyNames(std::vector<CString>* key_names);
+
+  // Reads the apps of |key_name|, reusing the entries of |previous_apps| for
+  // the apps whose keys have not been written since.
+  void SweepKey(const CString& key_name,
+                const AppMap& previous_apps,
+                AppMap* apps);
+
+  // Computes active_states_ from the entries of the keys.
+  void AggregateActiveStates();
+  void AddActiveStates(const AppMap& apps);
+
+  const bool is_machine_;
+  const bool check_low_integrity_;
+  std::unique_ptr<UsageDataBackendInterface> backend_;
+
+  LLock lock_;
+
+  ClientStateMap user_keys_;
+
+  // The ClientState key under HKLM. Only swept for machine instances.
+  AppMap machine_apps_;
+
+  // The did run state of the apps which have a did run value, keyed by the
+  // lowercase app id.
+  std::map<CString, ActiveStates> active_states_;
+
+  // The SID of the user, for the low integrity key of user instances.
+  CString user_sid_;
+
+  bool has_swept_;
+  uint64 last_sweep_ms_;
+  uint64 max_sweep_age_ms_;
+
+  int num_sweeps_;
+  int num_values_read_;
+
+  DISALLOW_COPY_AND_ASSIGN(UsageDataCollector);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_GOOPDATE_USAGE_DATA_COLLECTOR_H_
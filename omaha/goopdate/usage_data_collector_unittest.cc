@@ -0,0 +1,473 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/goopdate/usage_data_collector.h"
+
+#include <climits>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/const_utils.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/error.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/app_registry_utils.h"
+#include "omaha/common/config_manager.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR kApp1[] = _T("{6ACB7D4D-E5BA-48b0-85FE-A4051500A1BD}");
+const TCHAR kApp2[] = _T("{DD7A1A0F-7A7C-4f4b-8A1C-C0B8B6E6C4F3}");
+const TCHAR kApp3[] = _T("{4B2E3F65-3E54-4d06-9D3C-0B2C1E7C0A8E}");
+
+const TCHAR kSid1[] = _T("S-1-5-21-1-2-3-1001");
+const TCHAR kSid2[] = _T("S-1-5-21-1-2-3-1002");
+const TCHAR kSid3[] = _T("S-1-5-21-1-2-3-1003");
+
+CString GetUserClientStateKey(const CString& sid) {
+  return AppendRegKeyPath(USERS_KEY, sid, GOOPDATE_REG_RELATIVE_CLIENT_STATE);
+}
+
+CString GetLowIntegrityClientStateKey(const CString& sid) {
+  return AppendRegKeyPath(
+      AppendRegKeyPath(USERS_KEY, sid, USER_REG_VISTA_LOW_INTEGRITY_HKCU),
+      sid,
+      GOOPDATE_REG_RELATIVE_CLIENT_STATE);
+}
+
+CString GetMachineClientStateKey() {
+  return ConfigManager::Instance()->registry_client_state(true);
+}
+
+// An in-memory registry of ClientState keys. Each write advances the last
+// write time of the key.
+class FakeUsageDataBackend : public UsageDataBackendInterface {
+ public:
+  FakeUsageDataBackend() : time_(0), num_reads_(0), num_writes_(0) {}
+
+  void AddUser(const CString& sid) {
+    user_key_names_.push_back(sid);
+  }
+
+  void RemoveUser(const CString& sid) {
+    for (size_t i = 0; i != user_key_names_.size(); ++i) {
+      if (user_key_names_[i] == sid) {
+        user_key_names_.erase(user_key_names_.begin() + i);
+        return;
+      }
+    }
+  }
+
+  // Creates the key of the app under |key_name| without a did run value.
+  void CreateAppKey(const CString& key_name, const CString& app_id) {
+    FakeKey& key = keys_[GetKeyId(key_name)][Lower(app_id)];
+    key.name = app_id;
+    Touch(&key);
+  }
+
+  void SetDidRun(const CString& key_name,
+                 const CString& app_id,
+                 bool did_run) {
+    FakeKey& key = keys_[GetKeyId(key_name)][Lower(app_id)];
+    key.name = app_id;
+    key.has_value = true;
+    key.did_run = did_run;
+    Touch(&key);
+  }
+
+  // Returns false if the app has no did run value under |key_name|.
+  bool GetDidRun(const CString& key_name,
+                 const CString& app_id,
+                 bool* did_run) const {
+    const FakeKey* key = FindKey(AppendRegKeyPath(key_name, app_id));
+    if (!key || !key->has_value) {
+      return false;
+    }
+    *did_run = key->did_run;
+    return true;
+  }
+
+  virtual HRESULT GetUserKeyNames(std::vector<CString>* user_key_names) {
+    *user_key_names = user_key_names_;
+    return S_OK;
+  }
+
+  virtual HRESULT GetSubkeys(const CString& key_name,
+                             std::vector<RegistrySubkeyInfo>* subkeys) {
+    subkeys->clear();
+
+    KeyMap::const_iterator it = keys_.find(GetKeyId(key_name));
+    if (it == keys_.end()) {
+      return S_FALSE;
+    }
+
+    for (SubkeyMap::const_iterator subkey = it->second.begin();
+         subkey != it->second.end();
+         ++subkey) {
+      RegistrySubkeyInfo info;
+      info.name = subkey->second.name;
+      info.last_write_time = subkey->second.last_write_time;
+      subkeys->push_back(info);
+    }
+    return S_OK;
+  }
+
+  virtual HRESULT ReadDidRun(const CString& key_name, bool* did_run) {
+    ++num_reads_;
+    const FakeKey* key = FindKey(key_name);
+    if (!key || !key->has_value) {
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    *did_run = key->did_run;
+    return S_OK;
+  }
+
+  virtual HRESULT ClearDidRun(const CString& key_name) {
+    ++num_writes_;
+    FakeKey* key = FindKey(key_name);
+    if (!key) {
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    key->has_value = true;
+    key->did_run = false;
+    Touch(key);
+    return S_OK;
+  }
+
+  virtual HRESULT DeleteDidRun(const CString& key_name) {
+    ++num_writes_;
+    FakeKey* key = FindKey(key_name);
+    if (!key) {
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    key->has_value = false;
+    Touch(key);
+    return S_OK;
+  }
+
+  int num_reads() const { return num_reads_; }
+  int num_writes() const { return num_writes_; }
+
+ private:
+  struct FakeKey {
+    FakeKey() : has_value(false), did_run(false) {
+      ::ZeroMemory(&last_write_time, sizeof(last_write_time));
+    }
+
+    CString name;
+    FILETIME last_write_time;
+    bool has_value;
+    bool did_run;
+  };
+  typedef std::map<CString, FakeKey> SubkeyMap;
+  typedef std::map<CString, SubkeyMap> KeyMap;
+
+  static CString Lower(const CString& name) {
+    CString lower_name(name);
+    lower_name.MakeLower();
+    return lower_name;
+  }
+
+  // The key names built by AppendRegKeyPath may end with a backslash.
+  static CString GetKeyId(const CString& key_name) {
+    CString key_id(Lower(key_name));
+    key_id.TrimRight(_T('\\'));
+    return key_id;
+  }
+
+  FakeKey* FindKey(const CString& key_name) const {
+    const int separator = key_name.ReverseFind(_T('\\'));
+    KeyMap::iterator it = keys_.find(GetKeyId(key_name.Left(separator)));
+    if (it == keys_.end()) {
+      return NULL;
+    }
+    SubkeyMap::iterator subkey =
+        it->second.find(Lower(key_name.Mid(separator + 1)));
+    return subkey == it->second.end() ? NULL : &subkey->second;
+  }
+
+  void Touch(FakeKey* key) {
+    ++time_;
+    key->last_write_time.dwLowDateTime = time_;
+  }
+
+  std::vector<CString> user_key_names_;
+  mutable KeyMap keys_;
+  DWORD time_;
+  int num_reads_;
+  int num_writes_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeUsageDataBackend);
+};
+
+}  // namespace
+
+class UsageDataCollectorTest : public testing::Test {
+ protected:
+  UsageDataCollectorTest() : backend_(NULL) {}
+
+  // Creates a collector for the users of kSid1, kSid2, and kSid3.
+  void CreateCollector(bool is_machine, bool check_low_integrity) {
+    backend_ = new FakeUsageDataBackend;
+    backend_->AddUser(kSid1);
+    backend_->AddUser(kSid2);
+    backend_->AddUser(kSid3);
+    collector_.reset(new UsageDataCollector(
+        is_machine,
+        check_low_integrity,
+        std::unique_ptr<UsageDataBackendInterface>(backend_)));
+  }
+
+  std::unique_ptr<UsageDataCollector> collector_;
+  FakeUsageDataBackend* backend_;
+};
+
+TEST_F(UsageDataCollectorTest, GetActiveState_AggregatesUsers) {
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid2), kApp1, true);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp2, false);
+  backend_->CreateAppKey(GetUserClientStateKey(kSid3), kApp3);
+
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp2));
+  EXPECT_EQ(ACTIVE_UNKNOWN, collector_->GetActiveState(kApp3));
+  EXPECT_EQ(ACTIVE_UNKNOWN,
+            collector_->GetActiveState(
+                _T("{00000000-0000-0000-0000-000000000000}")));
+
+  CString app1(kApp1);
+  app1.MakeUpper();
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(app1));
+}
+
+TEST_F(UsageDataCollectorTest, GetActiveState_MachineBackwardCompat) {
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetMachineClientStateKey(), kApp1, true);
+  backend_->SetDidRun(GetMachineClientStateKey(), kApp2, false);
+
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp2));
+}
+
+TEST_F(UsageDataCollectorTest, GetActiveState_LowIntegrity) {
+  CreateCollector(true, true);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, false);
+  backend_->SetDidRun(GetLowIntegrityClientStateKey(kSid1), kApp1, true);
+
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, false);
+  backend_->SetDidRun(GetLowIntegrityClientStateKey(kSid1), kApp1, true);
+
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+}
+
+TEST_F(UsageDataCollectorTest, GetActiveState_User) {
+  CreateCollector(false, false);
+  const CString key_name(
+      ConfigManager::Instance()->registry_client_state(false));
+  backend_->SetDidRun(key_name, kApp1, true);
+
+  // The keys of the other users are not read by user instances.
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp2, true);
+
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(ACTIVE_UNKNOWN, collector_->GetActiveState(kApp2));
+}
+
+TEST_F(UsageDataCollectorTest, Collect_ReadsChangedKeysOnly) {
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid2), kApp1, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid2), kApp2, true);
+  backend_->CreateAppKey(GetUserClientStateKey(kSid3), kApp3);
+
+  EXPECT_SUCCEEDED(collector_->Collect());
+  EXPECT_EQ(4, backend_->num_reads());
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+
+  EXPECT_SUCCEEDED(collector_->Collect());
+  EXPECT_EQ(4, backend_->num_reads());
+
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, true);
+  backend_->SetDidRun(GetUserClientStateKey(kSid3), kApp3, true);
+  EXPECT_SUCCEEDED(collector_->Collect());
+  EXPECT_EQ(6, backend_->num_reads());
+  EXPECT_EQ(6, collector_->num_values_read());
+
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp2));
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp3));
+}
+
+TEST_F(UsageDataCollectorTest, Collect_UserLoggedOff) {
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid2), kApp1, true);
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+
+  backend_->RemoveUser(kSid2);
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+
+  // The key of the user is read again when the user logs on again.
+  backend_->AddUser(kSid2);
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(3, backend_->num_reads());
+}
+
+TEST_F(UsageDataCollectorTest, GetActiveState_MaxSweepAge) {
+  CreateCollector(true, false);
+  collector_->set_max_sweep_age_ms(ULLONG_MAX);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, false);
+
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(ACTIVE_UNKNOWN, collector_->GetActiveState(kApp2));
+
+  // The apps read within the maximum age share the first sweep.
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, true);
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(1, collector_->num_sweeps());
+
+  collector_->set_max_sweep_age_ms(0);
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(2, collector_->num_sweeps());
+}
+
+TEST_F(UsageDataCollectorTest, ResetDidRun_Machine) {
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid1), kApp1, true);
+  backend_->SetDidRun(GetUserClientStateKey(kSid2), kApp1, false);
+  backend_->SetDidRun(GetUserClientStateKey(kSid3), kApp2, true);
+  backend_->SetDidRun(GetMachineClientStateKey(), kApp1, true);
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+
+  EXPECT_SUCCEEDED(collector_->ResetDidRun(kApp1));
+
+  // The value which is already "0" is not written again, and the value under
+  // HKLM is deleted since the users have values.
+  EXPECT_EQ(2, backend_->num_writes());
+
+  bool did_run = true;
+  EXPECT_TRUE(backend_->GetDidRun(GetUserClientStateKey(kSid1),
+                                  kApp1,
+                                  &did_run));
+  EXPECT_FALSE(did_run);
+  did_run = true;
+  EXPECT_TRUE(backend_->GetDidRun(GetUserClientStateKey(kSid2),
+                                  kApp1,
+                                  &did_run));
+  EXPECT_FALSE(did_run);
+  EXPECT_FALSE(backend_->GetDidRun(GetMachineClientStateKey(),
+                                   kApp1,
+                                   &did_run));
+
+  // The other apps are not reset.
+  EXPECT_TRUE(backend_->GetDidRun(GetUserClientStateKey(kSid3),
+                                  kApp2,
+                                  &did_run));
+  EXPECT_TRUE(did_run);
+
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp2));
+}
+
+TEST_F(UsageDataCollectorTest, ResetDidRun_MachineBackwardCompat) {
+  CreateCollector(true, false);
+  backend_->SetDidRun(GetMachineClientStateKey(), kApp1, true);
+  EXPECT_EQ(ACTIVE_RUN, collector_->GetActiveState(kApp1));
+
+  EXPECT_SUCCEEDED(collector_->ResetDidRun(kApp1));
+
+  bool did_run = true;
+  EXPECT_TRUE(backend_->GetDidRun(GetMachineClientStateKey(),
+                                  kApp1,
+                                  &did_run));
+  EXPECT_FALSE(did_run);
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+}
+
+TEST_F(UsageDataCollectorTest, ResetDidRun_NoSweep) {
+  CreateCollector(false, false);
+  const CString key_name(
+      ConfigManager::Instance()->registry_client_state(false));
+  backend_->SetDidRun(key_name, kApp1, true);
+
+  EXPECT_SUCCEEDED(collector_->ResetDidRun(kApp1));
+
+  bool did_run = true;
+  EXPECT_TRUE(backend_->GetDidRun(key_name, kApp1, &did_run));
+  EXPECT_FALSE(did_run);
+  EXPECT_EQ(ACTIVE_NOTRUN, collector_->GetActiveState(kApp1));
+}
+
+class RegKeyUsageDataBackendTest : public RegistryProtectedTest {
+};
+
+TEST_F(RegKeyUsageDataBackendTest, ReadAndWriteDidRun) {
+  const CString client_state_key_name(
+      ConfigManager::Instance()->registry_client_state(false));
+  const CString app1_key_name(
+      app_registry_utils::GetAppClientStateKey(false, kApp1));
+  const CString app2_key_name(
+      app_registry_utils::GetAppClientStateKey(false, kApp2));
+  EXPECT_SUCCEEDED(RegKey::SetValue(app1_key_name, kRegValueDidRun, _T("1")));
+  EXPECT_SUCCEEDED(RegKey::SetValue(app2_key_name,
+                                    kRegValueDidRun,
+                                    static_cast<DWORD>(0)));
+
+  RegKeyUsageDataBackend backend;
+  std::vector<RegistrySubkeyInfo> subkeys;
+  EXPECT_EQ(S_OK, backend.GetSubkeys(client_state_key_name, &subkeys));
+  ASSERT_EQ(2, subkeys.size());
+
+  bool did_run = false;
+  EXPECT_SUCCEEDED(backend.ReadDidRun(app1_key_name, &did_run));
+  EXPECT_TRUE(did_run);
+  EXPECT_SUCCEEDED(backend.ReadDidRun(app2_key_name, &did_run));
+  EXPECT_FALSE(did_run);
+  EXPECT_FAILED(backend.ReadDidRun(
+      app_registry_utils::GetAppClientStateKey(false, kApp3), &did_run));
+
+  EXPECT_SUCCEEDED(backend.ClearDidRun(app1_key_name));
+  CString value;
+  EXPECT_SUCCEEDED(RegKey::GetValue(app1_key_name, kRegValueDidRun, &value));
+  EXPECT_STREQ(_T("0"), value);
+
+  EXPECT_SUCCEEDED(backend.DeleteDidRun(app1_key_name));
+  EXPECT_FALSE(RegKey::HasValue(app1_key_name, kRegValueDidRun));
+
+  // Clearing the value does not create the key of the app.
+  const CString app3_key_name(
+      app_registry_utils::GetAppClientStateKey(false, kApp3));
+  EXPECT_FAILED(backend.ClearDidRun(app3_key_name));
+  EXPECT_FALSE(RegKey::HasKey(app3_key_name));
+
+  subkeys.clear();
+  EXPECT_EQ(S_FALSE,
+            backend.GetSubkeys(AppendRegKeyPath(client_state_key_name,
+                                                _T("missing")),
+                               &subkeys));
+  EXPECT_TRUE(subkeys.empty());
+}
+
+}  // namespace omaha
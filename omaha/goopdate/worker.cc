@@ -19,6 +19,7 @@
 #include <atlbase.h>
 #include <atlstr.h>
 #include <memory>
+#include <vector>
 
 #include "omaha/base/app_util.h"
 #include "omaha/base/const_object_names.h"
@@ -30,6 +31,7 @@
 #include "omaha/base/logging.h"
 #include "omaha/base/path.h"
 #include "omaha/base/reactor.h"
+#include "omaha/base/reg_key_cache.h"
 #include "omaha/base/safe_format.h"
 #include "omaha/base/scoped_impersonation.h"
 #include "omaha/base/system.h"
@@ -46,6 +48,9 @@
 #include "omaha/common/update_response.h"
 #include "omaha/common/web_services_client.h"
 #include "omaha/goopdate/app_manager.h"
+#include "omaha/goopdate/bundle_download_plan.h"
+#include "omaha/goopdate/bundle_install_plan.h"
+#include "omaha/goopdate/download_budget.h"
 #include "omaha/goopdate/download_manager.h"
 #include "omaha/goopdate/goopdate.h"
 #include "omaha/goopdate/install_manager.h"
@@ -236,7 +241,8 @@ void SendCupFailurePing(bool is_machine,
 Worker::Worker()
     : is_machine_(false),
       lock_count_(0),
-      single_instance_hr_(E_FAIL) {
+      single_instance_hr_(E_FAIL),
+      max_concurrent_installs_(kDefaultMaxConcurrentInstalls) {
   CORE_LOG(L1, (_T("[Worker::Worker]")));
 
   reactor_.reset(new Reactor);
@@ -252,6 +258,7 @@ Worker::~Worker() {
   Stop();
 
   AppManager::DeleteInstance();
+  RegKeyCache::DeleteInstance();
 }
 
 Worker* const Worker::kInvalidInstance = reinterpret_cast<Worker* const>(-1);
@@ -328,13 +335,38 @@ HRESULT Worker::Initialize(bool is_machine) {
     return hr;
   }
 
-  download_manager_.reset(new DownloadManager(is_machine_));
+  // Without the registry monitor, the persistent data of the apps is read
+  // from the registry each time, which is slower but still correct.
+  hr = AppManager::Instance()->EnableRegistrySnapshots();
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[EnableRegistrySnapshots failed][0x%08x]"), hr));
+  }
+
+  // Keeps the keys of the Update tree open for the static RegKey functions.
+  hr = RegKeyCache::Instance().StartMonitoring(std::vector<CString>(
+      1, ConfigManager::Instance()->registry_update(is_machine_)));
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[RegKeyCache::StartMonitoring failed][0x%08x]"), hr));
+  }
+
+  const ConfigManager& cm = *ConfigManager::Instance();
+  download_budget_.reset(new DownloadBudget(cm.GetMaxConcurrentDownloads(),
+                                            cm.GetMaxDownloadBytesPerSec()));
+  hr = download_budget_->Initialize();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  DownloadManager* download_manager = new DownloadManager(is_machine_);
+  download_manager->set_download_budget(download_budget_.get());
+  download_manager_.reset(download_manager);
 
   hr = download_manager_->Initialize();
   if (FAILED(hr)) {
     return hr;
   }
 
+  max_concurrent_installs_ = cm.GetMaxConcurrentInstalls();
   install_manager_.reset(new InstallManager(&model_->lock(), is_machine_));
   hr = install_manager_->Initialize();
   if (FAILED(hr)) {
@@ -554,6 +586,7 @@ void Worker::Download(std::shared_ptr<AppBundle> app_bundle) {
 
   const size_t num_apps = app_bundle->GetNumberOfApps();
 
+  std::vector<App*> apps;
   for (size_t i = 0; i != num_apps; ++i) {
     App* app = app_bundle->GetApp(i);
 
@@ -561,8 +594,22 @@ void Worker::Download(std::shared_ptr<AppBundle> app_bundle) {
             app->state() == STATE_NO_UPDATE ||
             app->state() == STATE_ERROR);
 
+    apps.push_back(app);
+  }
+
+  // The apps download concurrently, within the limits of the download budget.
+  BundleDownloadPlan download_plan(download_manager_.get(),
+                                   download_budget_.get());
+  hr = download_plan.Start(apps, app_bundle->impersonation_token());
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[BundleDownloadPlan::Start failed][0x%08x]"), hr));
+  }
+
+  for (size_t i = 0; i != num_apps; ++i) {
+    App* app = apps[i];
+
     // This is a blocking call on the network.
-    app->Download(download_manager_.get());
+    download_plan.WaitForApp(i);
 
     ASSERT1(app->state() == STATE_READY_TO_INSTALL ||
             app->state() == STATE_NO_UPDATE ||
@@ -630,6 +677,7 @@ void Worker::DownloadAndInstallHelper(AppBundle* app_bundle) {
 
   const size_t num_apps = app_bundle->GetNumberOfApps();
 
+  std::vector<App*> apps;
   for (size_t i = 0; i != num_apps; ++i) {
     App* app = app_bundle->GetApp(i);
 
@@ -638,28 +686,23 @@ void Worker::DownloadAndInstallHelper(AppBundle* app_bundle) {
             app->state() == STATE_NO_UPDATE ||
             app->state() == STATE_ERROR);
 
-    // Download the app if it has not already been downloaded.
-    // This is a blocking call on the network.
-    app->Download(download_manager_.get());
-
-    ASSERT1(app->state() == STATE_READY_TO_INSTALL ||    // Downloaded above.
-            app->state() == STATE_WAITING_TO_INSTALL ||  // Downloaded earlier.
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
-
-    app->QueueInstall();
-
-    // This is a blocking call on the app installer.
-    CallAsSelfAndImpersonate1(
-        app,
-        &App::Install,
-        install_manager_.get());
+    apps.push_back(app);
+  }
 
-    ASSERT1(app->state() == STATE_INSTALL_COMPLETE ||
-            app->state() == STATE_NO_UPDATE ||
-            app->state() == STATE_ERROR);
+  // The remaining apps keep downloading in the background while the apps that
+  // have already been downloaded are installed.
+  BundleDownloadPlan download_plan(download_manager_.get(),
+                                   download_budget_.get());
+  hr = download_plan.Start(apps, app_bundle->impersonation_token());
+  if (FAILED(hr)) {
+    CORE_LOG(LW, (_T("[BundleDownloadPlan::Start failed][0x%08x]"), hr));
   }
 
+  // This is a blocking call on the network and on the app installers.
+  BundleInstallPlan install_plan(install_manager_.get(),
+                                 max_concurrent_installs_);
+  install_plan.InstallAll(&download_plan);
+
   WriteEventLog(EVENTLOG_INFORMATION_TYPE,
                 kUpdateEventId,
                 _T("Application update/install"),
@@ -839,6 +882,8 @@ HRESULT Worker::CacheOfflinePackages(AppBundle* app_bundle) {
   CORE_LOG(L3, (_T("[Worker::CacheOfflinePackages]")));
   ASSERT1(app_bundle);
 
+  std::vector<const Package*> packages;
+  std::vector<CString> package_paths;
   for (size_t i = 0; i != app_bundle->GetNumberOfApps(); ++i) {
     App* app = app_bundle->GetApp(i);
     AppVersion* app_version = app->working_version();
@@ -863,26 +908,31 @@ HRESULT Worker::CacheOfflinePackages(AppBundle* app_bundle) {
         }
       }
 
-      File offline_package_file;
-      HRESULT hr = offline_package_file.OpenShareMode(offline_package_path,
-                                                      false,
-                                                      false,
-                                                      FILE_SHARE_READ);
-      if (FAILED(hr)) {
-        return hr;
-      }
-
-      hr = download_manager_->CachePackage(package,
-                                           &offline_package_file,
-                                           &offline_package_path);
-      if (FAILED(hr)) {
-        CORE_LOG(LE, (_T("[CachePackage failed][%s][%s][0x%x][%Iu]"),
-                      app->app_guid_string(), offline_package_path, hr, j));
-        return hr;
-      }
+      packages.push_back(package);
+      package_paths.push_back(offline_package_path);
     }
   }
 
+  if (packages.empty()) {
+    return S_OK;
+  }
+
+  // The offline directory is deleted once the packages are cached, therefore
+  // the packages can be moved. The machine cache only takes copies, which
+  // inherit the permissions of the cache directory.
+  size_t failed_index = 0;
+  HRESULT hr = download_manager_->CacheOfflinePackages(packages,
+                                                       package_paths,
+                                                       !is_machine_,
+                                                       &failed_index);
+  if (FAILED(hr)) {
+    CORE_LOG(LE, (_T("[CacheOfflinePackages failed][%s][%s][0x%x]"),
+                  packages[failed_index]->app_version()->app()->
+                      app_guid_string(),
+                  package_paths[failed_index], hr));
+    return hr;
+  }
+
   return S_OK;
 }
 
@@ -36,6 +36,7 @@ class UpdateResponse;
 }  // namespace xml
 
 class AppBundle;
+class DownloadBudget;
 class DownloadManagerInterface;
 class InstallManagerInterface;
 class Model;
@@ -185,9 +186,15 @@ class Worker : public WorkerModelInterface, public ShutdownCallback {
   std::unique_ptr<Reactor>         reactor_;
   std::unique_ptr<ShutdownHandler> shutdown_handler_;
   std::unique_ptr<Model>           model_;
+
+  // Shared by all the bundles. Must outlive the download manager.
+  std::unique_ptr<DownloadBudget> download_budget_;
   std::unique_ptr<DownloadManagerInterface> download_manager_;
   std::unique_ptr<InstallManagerInterface> install_manager_;
 
+  // The number of installers of a bundle which can run at the same time.
+  int max_concurrent_installs_;
+
   CMessageLoop message_loop_;
 
   static Worker* const kInvalidInstance;
@@ -23,8 +23,14 @@ DEFINE_METRIC_count(worker_download_succeeded);
 
 DEFINE_METRIC_count(worker_download_skipped_bits_machine);
 
+DEFINE_METRIC_count(worker_download_diff_total);
+DEFINE_METRIC_count(worker_download_diff_succeeded);
+DEFINE_METRIC_count(worker_download_diff_failed);
+DEFINE_METRIC_count(worker_download_diff_bytes_saved);
+
 DEFINE_METRIC_count(worker_package_cache_put_total);
 DEFINE_METRIC_count(worker_package_cache_put_succeeded);
+DEFINE_METRIC_count(worker_package_cache_put_moved);
 
 DEFINE_METRIC_count(worker_install_execute_total);
 DEFINE_METRIC_count(worker_install_execute_msi_total);
@@ -77,4 +83,14 @@ DEFINE_METRIC_timing(ping_succeeded_ms);
 DEFINE_METRIC_timing(updatecheck_failed_ms);
 DEFINE_METRIC_timing(updatecheck_succeeded_ms);
 
+DEFINE_METRIC_timing(offline_packages_cached_ms);
+
+DEFINE_METRIC_timing(worker_install_wait_ms);
+DEFINE_METRIC_timing(worker_install_launch_ms);
+DEFINE_METRIC_timing(worker_install_run_ms);
+DEFINE_METRIC_timing(worker_install_registration_check_ms);
+
+DEFINE_METRIC_count(worker_progress_table_writes);
+DEFINE_METRIC_count(worker_progress_registry_writes);
+
 }  // namespace omaha
@@ -30,12 +30,26 @@ DECLARE_METRIC_count(worker_download_succeeded);
 // How many times the download manager skipped BITS due to machine install.
 DECLARE_METRIC_count(worker_download_skipped_bits_machine);
 
+// How many times the download manager attempted to download the patch of a
+// package instead of the package.
+DECLARE_METRIC_count(worker_download_diff_total);
+// How many times the download manager successfully patched a package.
+DECLARE_METRIC_count(worker_download_diff_succeeded);
+// How many times the download manager fell back to downloading the package
+// because the patch could not be downloaded or applied.
+DECLARE_METRIC_count(worker_download_diff_failed);
+// How many bytes were not downloaded because the packages were patched.
+DECLARE_METRIC_count(worker_download_diff_bytes_saved);
+
 // How many times the package cache attempted to put the temporary file
 // to the cache directory.
 DECLARE_METRIC_count(worker_package_cache_put_total);
 // How many times the package cache successfully copied the temporary file
 // to the cache directory.
 DECLARE_METRIC_count(worker_package_cache_put_succeeded);
+// How many times the package cache moved a file to the cache directory
+// instead of copying it.
+DECLARE_METRIC_count(worker_package_cache_put_moved);
 
 // How many times ExecuteAndWaitForInstaller was called.
 DECLARE_METRIC_count(worker_install_execute_total);
@@ -141,6 +155,23 @@ DECLARE_METRIC_timing(updatecheck_failed_ms);
 // Time (ms) spent in DoUpdateCheck() when an update check succeeds.
 DECLARE_METRIC_timing(updatecheck_succeeded_ms);
 
+// Time (ms) spent caching the packages of an offline install.
+DECLARE_METRIC_timing(offline_packages_cached_ms);
+
+// Time (ms) an install waited for the installer lock or an install slot.
+DECLARE_METRIC_timing(worker_install_wait_ms);
+// Time (ms) spent starting the installer process.
+DECLARE_METRIC_timing(worker_install_launch_ms);
+// Time (ms) from the start of the installer until it exits or times out.
+DECLARE_METRIC_timing(worker_install_run_ms);
+// Time (ms) spent checking the registration of the app after the installer.
+DECLARE_METRIC_timing(worker_install_registration_check_ms);
+
+// Number of times the progress of an app was published in the progress table.
+DECLARE_METRIC_count(worker_progress_table_writes);
+// Number of progress milestones written in the CurrentState registry key.
+DECLARE_METRIC_count(worker_progress_registry_writes);
+
 }  // namespace omaha
 
 #endif  // OMAHA_GOOPDATE_WORKER_METRICS_H__
@@ -159,6 +159,11 @@ class MockDownloadManager : public DownloadManagerInterface {
       HRESULT(const CString&, const CString&));
   MOCK_METHOD3(CachePackage,
       HRESULT(const Package*, File*, const CString*));
+  MOCK_METHOD4(CacheOfflinePackages,
+      HRESULT(const std::vector<const Package*>&,
+              const std::vector<CString>&,
+              bool,
+              size_t*));
   MOCK_METHOD1(DownloadApp,
       HRESULT(App* app));
   MOCK_METHOD1(DownloadPackage,
@@ -183,6 +188,8 @@ class MockInstallManager : public InstallManagerInterface {
       CString());
   MOCK_METHOD2(InstallApp,
       void(App* app, const CString& dir));
+  MOCK_METHOD2(InstallAppConcurrently,
+      void(App* app, const CString& dir));
 };
 
 ACTION(SimulateDownloadAppStateTransition) {
@@ -423,13 +430,11 @@ TEST_F(WorkerMockedManagersTest, DownloadAsync) {
   SetAppStateUpdateAvailable(app1_);
   SetAppStateUpdateAvailable(app2_);
 
-  {
-    ::testing::InSequence dummy;
-    EXPECT_CALL(*mock_download_manager_, DownloadApp(app1_))
-        .WillOnce(SimulateDownloadAppStateTransition());
-    EXPECT_CALL(*mock_download_manager_, DownloadApp(app2_))
-        .WillOnce(SimulateDownloadAppStateTransition());
-  }
+  // The apps download concurrently, so the downloads can happen in any order.
+  EXPECT_CALL(*mock_download_manager_, DownloadApp(app1_))
+      .WillOnce(SimulateDownloadAppStateTransition());
+  EXPECT_CALL(*mock_download_manager_, DownloadApp(app2_))
+      .WillOnce(SimulateDownloadAppStateTransition());
 
   // Holding the lock prevents the state from changing in the other thread,
   // ensuring consistent results.
@@ -487,15 +492,22 @@ TEST_F(WorkerMockedManagersTest, DownloadAndInstallAsync_NotAlreadyDownloaded) {
   EXPECT_CALL(*mock_install_manager_, install_working_dir())
       .WillRepeatedly(Return(app_util::GetTempDir()));
 
+  // Each app installs after it has been downloaded, and the installs happen in
+  // bundle order. The download of the second app may overlap with the download
+  // and the install of the first app.
   {
-    ::testing::InSequence dummy;
+    ::testing::Sequence app1_sequence, app2_sequence;
     EXPECT_CALL(*mock_download_manager_, DownloadApp(app1_))
+        .InSequence(app1_sequence)
         .WillOnce(SimulateDownloadAppStateTransition());
-    EXPECT_CALL(*mock_install_manager_, InstallApp(app1_, _))
-        .WillOnce(SimulateInstallAppStateTransition());
     EXPECT_CALL(*mock_download_manager_, DownloadApp(app2_))
+        .InSequence(app2_sequence)
         .WillOnce(SimulateDownloadAppStateTransition());
+    EXPECT_CALL(*mock_install_manager_, InstallApp(app1_, _))
+        .InSequence(app1_sequence)
+        .WillOnce(SimulateInstallAppStateTransition());
     EXPECT_CALL(*mock_install_manager_, InstallApp(app2_, _))
+        .InSequence(app1_sequence, app2_sequence)
         .WillOnce(SimulateInstallAppStateTransition());
   }
 
@@ -519,13 +531,11 @@ TEST_F(WorkerMockedManagersTest, DownloadAsync_Then_DownloadAndInstallAsync) {
   SetAppStateUpdateAvailable(app1_);
   SetAppStateUpdateAvailable(app2_);
 
-  {
-    ::testing::InSequence dummy;
-    EXPECT_CALL(*mock_download_manager_, DownloadApp(app1_))
-        .WillOnce(SimulateDownloadAppStateTransition());
-    EXPECT_CALL(*mock_download_manager_, DownloadApp(app2_))
-        .WillOnce(SimulateDownloadAppStateTransition());
-  }
+  // The apps download concurrently, so the downloads can happen in any order.
+  EXPECT_CALL(*mock_download_manager_, DownloadApp(app1_))
+      .WillOnce(SimulateDownloadAppStateTransition());
+  EXPECT_CALL(*mock_download_manager_, DownloadApp(app2_))
+      .WillOnce(SimulateDownloadAppStateTransition());
 
   __mutexBlock(worker_->model()->lock()) {
     EXPECT_SUCCEEDED(worker_->DownloadAsync(app_bundle_.get()));
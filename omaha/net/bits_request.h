@@ -104,6 +104,9 @@ class BitsRequest : public HttpRequestInterface {
     callback_ = callback;
   }
 
+  // BITS throttles its own transfers, so the pacer is not used.
+  virtual void set_pacer(NetworkRequestPacer*) {}
+
   virtual void set_additional_headers(const CString& additional_headers) {
     additional_headers_ = additional_headers;
   }
@@ -0,0 +1,244 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/connection_pool.h"
+
+#include "omaha/base/debug.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace internal {
+
+DEFINE_METRIC_count(net_connection_pool_hits);
+DEFINE_METRIC_count(net_connection_pool_misses);
+DEFINE_METRIC_count(net_connection_pool_evictions);
+
+}  // namespace internal
+
+ConnectionPool* ConnectionPool::instance_ = NULL;
+LLock ConnectionPool::instance_lock_;
+
+ConnectionPool::ConnectionPool()
+    : idle_timeout_ms_(kDefaultIdleTimeoutMs),
+      max_idle_connections_per_host_(kDefaultMaxIdleConnectionsPerHost),
+      num_hits_(0),
+      num_misses_(0),
+      num_evictions_(0) {
+}
+
+ConnectionPool::~ConnectionPool() {
+  // The sessions are expected to be unregistered by their owners.
+  ASSERT1(sessions_.empty());
+  while (!sessions_.empty()) {
+    UnregisterSession(sessions_.begin()->first);
+  }
+}
+
+ConnectionPool& ConnectionPool::Instance() {
+  __mutexScope(instance_lock_);
+  if (!instance_) {
+    instance_ = new ConnectionPool;
+  }
+  return *instance_;
+}
+
+void ConnectionPool::DeleteInstance() {
+  ConnectionPool* instance = omaha::interlocked_exchange_pointer(
+      &instance_, static_cast<ConnectionPool*>(NULL));
+  delete instance;
+}
+
+void ConnectionPool::RegisterSession(HINTERNET session_handle,
+                                     HttpClient* http_client) {
+  ASSERT1(session_handle);
+  ASSERT1(http_client);
+
+  __mutexScope(lock_);
+  ASSERT1(sessions_.find(session_handle) == sessions_.end());
+  sessions_[session_handle].http_client = http_client;
+  NET_LOG(L3, (_T("[ConnectionPool::RegisterSession][0x%p]"), session_handle));
+}
+
+void ConnectionPool::UnregisterSession(HINTERNET session_handle) {
+  __mutexScope(lock_);
+
+  Sessions::iterator it = sessions_.find(session_handle);
+  if (it == sessions_.end()) {
+    return;
+  }
+
+  SessionConnections& session = it->second;
+  for (std::map<CString, IdleConnections>::iterator host_it =
+           session.hosts.begin();
+       host_it != session.hosts.end();
+       ++host_it) {
+    const IdleConnections& connections = host_it->second;
+    for (size_t i = 0; i != connections.size(); ++i) {
+      VERIFY_SUCCEEDED(
+          session.http_client->Close(connections[i].connection_handle));
+    }
+  }
+
+  sessions_.erase(it);
+  NET_LOG(L3, (_T("[ConnectionPool::UnregisterSession][0x%p]"),
+               session_handle));
+}
+
+bool ConnectionPool::Acquire(HINTERNET session_handle,
+                             const CString& server,
+                             int port,
+                             HINTERNET* connection_handle) {
+  ASSERT1(connection_handle);
+
+  __mutexScope(lock_);
+
+  Sessions::iterator it = sessions_.find(session_handle);
+  if (it == sessions_.end()) {
+    return false;
+  }
+
+  CloseExpiredConnectionsLocked(GetCurrentMsTime());
+
+  IdleConnections& connections = it->second.hosts[GetHostKey(server, port)];
+  if (connections.empty()) {
+    ++num_misses_;
+    internal::metric_net_connection_pool_misses++;
+    return false;
+  }
+
+  // The most recently released connection is the most likely to still have a
+  // live socket.
+  *connection_handle = connections.back().connection_handle;
+  connections.pop_back();
+
+  ++num_hits_;
+  internal::metric_net_connection_pool_hits++;
+  NET_LOG(L3, (_T("[ConnectionPool hit][%s:%d][0x%p]"),
+               server, port, *connection_handle));
+  return true;
+}
+
+bool ConnectionPool::Release(HINTERNET session_handle,
+                             const CString& server,
+                             int port,
+                             HINTERNET connection_handle) {
+  ASSERT1(connection_handle);
+
+  __mutexScope(lock_);
+
+  Sessions::iterator it = sessions_.find(session_handle);
+  if (it == sessions_.end() || max_idle_connections_per_host_ <= 0) {
+    return false;
+  }
+
+  const uint64 now_ms = GetCurrentMsTime();
+  CloseExpiredConnectionsLocked(now_ms);
+
+  IdleConnections& connections = it->second.hosts[GetHostKey(server, port)];
+
+  // Evict the oldest connection to make room for this one.
+  if (static_cast<int>(connections.size()) >= max_idle_connections_per_host_) {
+    VERIFY_SUCCEEDED(
+        it->second.http_client->Close(connections.front().connection_handle));
+    connections.erase(connections.begin());
+    ++num_evictions_;
+    internal::metric_net_connection_pool_evictions++;
+  }
+
+  IdleConnection connection;
+  connection.connection_handle = connection_handle;
+  connection.release_time_ms = now_ms;
+  connections.push_back(connection);
+  return true;
+}
+
+void ConnectionPool::CloseExpiredConnections() {
+  __mutexScope(lock_);
+  CloseExpiredConnectionsLocked(GetCurrentMsTime());
+}
+
+void ConnectionPool::CloseExpiredConnectionsLocked(uint64 now_ms) {
+  for (Sessions::iterator it = sessions_.begin(); it != sessions_.end(); ++it) {
+    SessionConnections& session = it->second;
+    for (std::map<CString, IdleConnections>::iterator host_it =
+             session.hosts.begin();
+         host_it != session.hosts.end();
+         ++host_it) {
+      // Connections are released in time order, so the expired connections
+      // are at the front.
+      IdleConnections& connections = host_it->second;
+      size_t num_expired = 0;
+      while (num_expired != connections.size() &&
+             now_ms - connections[num_expired].release_time_ms >=
+                 static_cast<uint64>(idle_timeout_ms_)) {
+        VERIFY_SUCCEEDED(session.http_client->Close(
+            connections[num_expired].connection_handle));
+        ++num_expired;
+      }
+
+      if (num_expired) {
+        connections.erase(connections.begin(),
+                          connections.begin() + num_expired);
+        num_evictions_ += static_cast<int>(num_expired);
+        internal::metric_net_connection_pool_evictions += num_expired;
+      }
+    }
+  }
+}
+
+int ConnectionPool::num_hits() const {
+  __mutexScope(lock_);
+  return num_hits_;
+}
+
+int ConnectionPool::num_misses() const {
+  __mutexScope(lock_);
+  return num_misses_;
+}
+
+int ConnectionPool::num_evictions() const {
+  __mutexScope(lock_);
+  return num_evictions_;
+}
+
+int ConnectionPool::num_idle_connections() const {
+  __mutexScope(lock_);
+
+  size_t num_idle_connections = 0;
+  for (Sessions::const_iterator it = sessions_.begin();
+       it != sessions_.end();
+       ++it) {
+    for (std::map<CString, IdleConnections>::const_iterator host_it =
+             it->second.hosts.begin();
+         host_it != it->second.hosts.end();
+         ++host_it) {
+      num_idle_connections += host_it->second.size();
+    }
+  }
+  return static_cast<int>(num_idle_connections);
+}
+
+// static
+CString ConnectionPool::GetHostKey(const CString& server, int port) {
+  CString key;
+  SafeCStringFormat(&key, _T("%s:%d"), server, port);
+  return key.MakeLower();
+}
+
+}  // namespace omaha
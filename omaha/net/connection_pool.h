@@ -0,0 +1,150 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// ConnectionPool keeps the WinHttp connection handles of finished requests, so
+// that the next request to the same host and port in the process reuses them.
+// WinHttp keeps the keep-alive sockets, and their TLS sessions, with the
+// server state of the connection handles. Reusing the handles avoids paying
+// the TCP and TLS handshakes again when a NetworkRequest is created for each
+// update check, ping, or download.
+//
+// Connections are only pooled for the WinHttp sessions registered with the
+// pool. A session must be unregistered before its handle is closed. Idle
+// connections are closed after an idle timeout, and at most a few idle
+// connections are kept for each host.
+
+#ifndef OMAHA_NET_CONNECTION_POOL_H_
+#define OMAHA_NET_CONNECTION_POOL_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+#include "omaha/net/http_client.h"
+#include "omaha/statsreport/metrics.h"
+
+namespace omaha {
+
+namespace internal {
+
+// Number of connections reused from the pool.
+DECLARE_METRIC_count(net_connection_pool_hits);
+
+// Number of connections which were not found in the pool.
+DECLARE_METRIC_count(net_connection_pool_misses);
+
+// Number of idle connections closed because of the idle timeout or the per
+// host limit.
+DECLARE_METRIC_count(net_connection_pool_evictions);
+
+}  // namespace internal
+
+class ConnectionPool {
+ public:
+  static const int kDefaultIdleTimeoutMs = 60000;
+  static const int kDefaultMaxIdleConnectionsPerHost = 4;
+
+  ConnectionPool();
+  ~ConnectionPool();
+
+  // The pool which is shared by all the network requests in the process.
+  static ConnectionPool& Instance();
+  static void DeleteInstance();
+
+  // Enables pooling for |session_handle|. The idle connections of the session
+  // are closed with |http_client|, which must outlive the registration.
+  void RegisterSession(HINTERNET session_handle, HttpClient* http_client);
+
+  // Closes the idle connections of |session_handle| and stops pooling them.
+  void UnregisterSession(HINTERNET session_handle);
+
+  // Returns true and an idle connection handle to |server| and |port| if the
+  // pool has one. Otherwise, the caller connects and later calls Release.
+  bool Acquire(HINTERNET session_handle,
+               const CString& server,
+               int port,
+               HINTERNET* connection_handle);
+
+  // Returns a connection to the pool. Returns false if the connection is not
+  // pooled, in which case the caller closes it.
+  bool Release(HINTERNET session_handle,
+               const CString& server,
+               int port,
+               HINTERNET connection_handle);
+
+  // Closes the idle connections which have exceeded the idle timeout.
+  void CloseExpiredConnections();
+
+  void set_idle_timeout_ms(int idle_timeout_ms) {
+    __mutexScope(lock_);
+    idle_timeout_ms_ = idle_timeout_ms;
+  }
+
+  void set_max_idle_connections_per_host(int max_idle_connections_per_host) {
+    __mutexScope(lock_);
+    max_idle_connections_per_host_ = max_idle_connections_per_host;
+  }
+
+  int num_hits() const;
+  int num_misses() const;
+  int num_evictions() const;
+  int num_idle_connections() const;
+
+ private:
+  struct IdleConnection {
+    IdleConnection() : connection_handle(NULL), release_time_ms(0) {}
+
+    HINTERNET connection_handle;
+    uint64 release_time_ms;
+  };
+
+  // Idle connections in the order in which they have been released.
+  typedef std::vector<IdleConnection> IdleConnections;
+
+  struct SessionConnections {
+    SessionConnections() : http_client(NULL) {}
+
+    HttpClient* http_client;
+    std::map<CString, IdleConnections> hosts;
+  };
+
+  typedef std::map<HINTERNET, SessionConnections> Sessions;
+
+  static CString GetHostKey(const CString& server, int port);
+
+  void CloseExpiredConnectionsLocked(uint64 now_ms);
+
+  LLock lock_;
+  Sessions sessions_;
+
+  int idle_timeout_ms_;
+  int max_idle_connections_per_host_;
+
+  int num_hits_;
+  int num_misses_;
+  int num_evictions_;
+
+  static ConnectionPool* instance_;
+  static LLock instance_lock_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConnectionPool);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_CONNECTION_POOL_H_
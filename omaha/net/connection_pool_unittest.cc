@@ -0,0 +1,225 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/connection_pool.h"
+
+#include <winsock2.h>
+#include <windows.h>
+#include <winhttp.h>
+#include <memory>
+#include <vector>
+
+#include "omaha/net/network_config.h"
+#include "omaha/net/simple_request.h"
+#include "omaha/testing/local_http_server.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class ConnectionPoolTest : public testing::Test {
+ protected:
+  ConnectionPoolTest() : session_handle_(NULL) {}
+
+  virtual void SetUp() {
+    http_client_.reset(CreateHttpClient());
+    ASSERT_TRUE(http_client_.get());
+    ASSERT_HRESULT_SUCCEEDED(http_client_->Initialize());
+    ASSERT_HRESULT_SUCCEEDED(http_client_->Open(NULL,
+                                                WINHTTP_ACCESS_TYPE_NO_PROXY,
+                                                WINHTTP_NO_PROXY_NAME,
+                                                WINHTTP_NO_PROXY_BYPASS,
+                                                WINHTTP_FLAG_ASYNC,
+                                                &session_handle_));
+  }
+
+  virtual void TearDown() {
+    ConnectionPool::Instance().UnregisterSession(session_handle_);
+    EXPECT_HRESULT_SUCCEEDED(http_client_->Close(session_handle_));
+  }
+
+  HINTERNET Connect(const TCHAR* server, int port) {
+    HINTERNET connection_handle = NULL;
+    EXPECT_HRESULT_SUCCEEDED(http_client_->Connect(session_handle_,
+                                                   server,
+                                                   port,
+                                                   &connection_handle));
+    return connection_handle;
+  }
+
+  void Get(const CString& url) {
+    SimpleRequest simple_request;
+    simple_request.set_session_handle(session_handle_);
+    simple_request.set_url(url);
+    simple_request.set_proxy_configuration(ProxyConfig());
+    EXPECT_HRESULT_SUCCEEDED(simple_request.Send());
+    EXPECT_EQ(HTTP_STATUS_OK, simple_request.GetHttpStatusCode());
+
+    const std::vector<uint8> response(simple_request.GetResponse());
+    EXPECT_EQ(2u, response.size());
+  }
+
+  std::unique_ptr<HttpClient> http_client_;
+  HINTERNET session_handle_;
+};
+
+TEST_F(ConnectionPoolTest, UnregisteredSession) {
+  ConnectionPool pool;
+  HINTERNET connection_handle = NULL;
+  EXPECT_FALSE(pool.Acquire(session_handle_, _T("127.0.0.1"), 80,
+                            &connection_handle));
+
+  connection_handle = Connect(_T("127.0.0.1"), 80);
+  EXPECT_FALSE(pool.Release(session_handle_, _T("127.0.0.1"), 80,
+                            connection_handle));
+  EXPECT_HRESULT_SUCCEEDED(http_client_->Close(connection_handle));
+
+  EXPECT_EQ(0, pool.num_hits());
+  EXPECT_EQ(0, pool.num_misses());
+}
+
+TEST_F(ConnectionPoolTest, AcquireAndRelease) {
+  ConnectionPool pool;
+  pool.RegisterSession(session_handle_, http_client_.get());
+
+  HINTERNET connection_handle = NULL;
+  EXPECT_FALSE(pool.Acquire(session_handle_, _T("127.0.0.1"), 80,
+                            &connection_handle));
+  EXPECT_EQ(1, pool.num_misses());
+
+  connection_handle = Connect(_T("127.0.0.1"), 80);
+  EXPECT_TRUE(pool.Release(session_handle_, _T("127.0.0.1"), 80,
+                           connection_handle));
+  EXPECT_EQ(1, pool.num_idle_connections());
+
+  // Connections are keyed by host and port. The host is case insensitive.
+  HINTERNET pooled_handle = NULL;
+  EXPECT_FALSE(pool.Acquire(session_handle_, _T("127.0.0.1"), 8080,
+                            &pooled_handle));
+  EXPECT_TRUE(pool.Acquire(session_handle_, _T("127.0.0.1"), 80,
+                           &pooled_handle));
+  EXPECT_EQ(connection_handle, pooled_handle);
+  EXPECT_EQ(1, pool.num_hits());
+  EXPECT_EQ(2, pool.num_misses());
+  EXPECT_EQ(0, pool.num_idle_connections());
+
+  EXPECT_TRUE(pool.Release(session_handle_, _T("127.0.0.1"), 80,
+                           pooled_handle));
+
+  connection_handle = Connect(_T("LocalHost"), 80);
+  EXPECT_TRUE(pool.Release(session_handle_, _T("LocalHost"), 80,
+                           connection_handle));
+  EXPECT_TRUE(pool.Acquire(session_handle_, _T("localhost"), 80,
+                           &pooled_handle));
+  EXPECT_EQ(connection_handle, pooled_handle);
+  EXPECT_TRUE(pool.Release(session_handle_, _T("localhost"), 80,
+                           pooled_handle));
+  EXPECT_EQ(2, pool.num_idle_connections());
+
+  // Unregistering the session closes its idle connections.
+  pool.UnregisterSession(session_handle_);
+  EXPECT_EQ(0, pool.num_idle_connections());
+}
+
+TEST_F(ConnectionPoolTest, MaxIdleConnectionsPerHost) {
+  ConnectionPool pool;
+  pool.RegisterSession(session_handle_, http_client_.get());
+  pool.set_max_idle_connections_per_host(2);
+
+  HINTERNET connection_handles[3] = {};
+  for (size_t i = 0; i != arraysize(connection_handles); ++i) {
+    connection_handles[i] = Connect(_T("127.0.0.1"), 80);
+    EXPECT_TRUE(pool.Release(session_handle_, _T("127.0.0.1"), 80,
+                             connection_handles[i]));
+  }
+  EXPECT_TRUE(pool.Release(session_handle_, _T("127.0.0.2"), 80,
+                           Connect(_T("127.0.0.2"), 80)));
+
+  // The oldest connection of the first host has been evicted.
+  EXPECT_EQ(3, pool.num_idle_connections());
+  EXPECT_EQ(1, pool.num_evictions());
+
+  HINTERNET pooled_handle = NULL;
+  EXPECT_TRUE(pool.Acquire(session_handle_, _T("127.0.0.1"), 80,
+                           &pooled_handle));
+  EXPECT_EQ(connection_handles[2], pooled_handle);
+  EXPECT_TRUE(pool.Release(session_handle_, _T("127.0.0.1"), 80,
+                           pooled_handle));
+
+  // No connections are kept when the limit is zero.
+  pool.set_max_idle_connections_per_host(0);
+  pooled_handle = Connect(_T("127.0.0.3"), 80);
+  EXPECT_FALSE(pool.Release(session_handle_, _T("127.0.0.3"), 80,
+                            pooled_handle));
+  EXPECT_HRESULT_SUCCEEDED(http_client_->Close(pooled_handle));
+
+  pool.UnregisterSession(session_handle_);
+}
+
+TEST_F(ConnectionPoolTest, IdleTimeout) {
+  ConnectionPool pool;
+  pool.RegisterSession(session_handle_, http_client_.get());
+  pool.set_idle_timeout_ms(50);
+
+  EXPECT_TRUE(pool.Release(session_handle_, _T("127.0.0.1"), 80,
+                           Connect(_T("127.0.0.1"), 80)));
+  pool.CloseExpiredConnections();
+  EXPECT_EQ(1, pool.num_idle_connections());
+
+  ::Sleep(100);
+  HINTERNET pooled_handle = NULL;
+  EXPECT_FALSE(pool.Acquire(session_handle_, _T("127.0.0.1"), 80,
+                            &pooled_handle));
+  EXPECT_EQ(0, pool.num_idle_connections());
+  EXPECT_EQ(1, pool.num_evictions());
+
+  pool.UnregisterSession(session_handle_);
+}
+
+// Sends requests to a local server through SimpleRequest, with and without
+// pooling, and compares the connections accepted by the server.
+TEST_F(ConnectionPoolTest, LocalServer_ReusesConnections) {
+  const int kNumRequests = 20;
+  ConnectionPool& pool = ConnectionPool::Instance();
+
+  // Without pooling.
+  LocalHttpServer unpooled_server;
+  ASSERT_HRESULT_SUCCEEDED(unpooled_server.Start());
+  for (int i = 0; i != kNumRequests; ++i) {
+    Get(unpooled_server.url());
+  }
+  unpooled_server.Stop();
+
+  // With pooling.
+  pool.RegisterSession(session_handle_, http_client_.get());
+  const int num_hits = pool.num_hits();
+  const int num_misses = pool.num_misses();
+
+  LocalHttpServer pooled_server;
+  ASSERT_HRESULT_SUCCEEDED(pooled_server.Start());
+  for (int i = 0; i != kNumRequests; ++i) {
+    Get(pooled_server.url());
+  }
+  const int pooled_connections = pooled_server.num_connections_accepted();
+  pooled_server.Stop();
+
+  EXPECT_EQ(kNumRequests, unpooled_server.num_requests_received());
+  EXPECT_EQ(kNumRequests, pooled_server.num_requests_received());
+  EXPECT_EQ(kNumRequests - 1, pool.num_hits() - num_hits);
+  EXPECT_EQ(1, pool.num_misses() - num_misses);
+  EXPECT_GT(kNumRequests / 2, pooled_connections);
+  EXPECT_LE(pooled_connections, unpooled_server.num_connections_accepted());
+}
+
+}  // namespace omaha
@@ -0,0 +1,309 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/content_encoding.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/logging.h"
+#include "third_party/zlib/zlib.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR kGzip[]    = _T("gzip");
+const TCHAR kDeflate[] = _T("deflate");
+
+// zlib adds 16 to the window bits to select the gzip wrapper instead of the
+// zlib wrapper.
+const int kWindowBits     = 15;
+const int kGzipWindowBits = kWindowBits + 16;
+
+const int kMemLevel = 8;
+
+const size_t kChunkSize = 16 * 1024;
+
+int GetWindowBits(ContentEncoding encoding) {
+  ASSERT1(encoding != CONTENT_ENCODING_IDENTITY);
+  return encoding == CONTENT_ENCODING_GZIP ? kGzipWindowBits : kWindowBits;
+}
+
+HRESULT ZlibErrorToHResult(int error) {
+  switch (error) {
+    case Z_MEM_ERROR:
+      return E_OUTOFMEMORY;
+    case Z_DATA_ERROR:
+    case Z_NEED_DICT:
+    case Z_BUF_ERROR:
+      return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    default:
+      return E_FAIL;
+  }
+}
+
+}  // namespace
+
+CString ContentEncodingToString(ContentEncoding encoding) {
+  switch (encoding) {
+    case CONTENT_ENCODING_GZIP:
+      return kGzip;
+    case CONTENT_ENCODING_DEFLATE:
+      return kDeflate;
+    case CONTENT_ENCODING_IDENTITY:
+    default:
+      return CString();
+  }
+}
+
+ContentEncoding StringToContentEncoding(const CString& name) {
+  int pos = 0;
+  for (CString token = name.Tokenize(_T(","), pos);
+       pos != -1;
+       token = name.Tokenize(_T(","), pos)) {
+    token.Trim();
+    if (token.CompareNoCase(kGzip) == 0) {
+      return CONTENT_ENCODING_GZIP;
+    }
+    if (token.CompareNoCase(kDeflate) == 0) {
+      return CONTENT_ENCODING_DEFLATE;
+    }
+  }
+  return CONTENT_ENCODING_IDENTITY;
+}
+
+HRESULT EncodeContent(ContentEncoding encoding,
+                      const void* buffer,
+                      size_t length,
+                      std::vector<uint8>* encoded) {
+  ASSERT1(buffer || !length);
+  ASSERT1(encoded);
+
+  if (length > std::numeric_limits<uInt>::max()) {
+    return E_INVALIDARG;
+  }
+
+  if (encoding == CONTENT_ENCODING_IDENTITY) {
+    const uint8* bytes = static_cast<const uint8*>(buffer);
+    encoded->assign(bytes, bytes + length);
+    return S_OK;
+  }
+
+  z_stream stream = {};
+  int result = deflateInit2(&stream,
+                            Z_DEFAULT_COMPRESSION,
+                            Z_DEFLATED,
+                            GetWindowBits(encoding),
+                            kMemLevel,
+                            Z_DEFAULT_STRATEGY);
+  if (result != Z_OK) {
+    NET_LOG(LE, (_T("[deflateInit2 failed][%d]"), result));
+    return ZlibErrorToHResult(result);
+  }
+
+  encoded->resize(deflateBound(&stream, static_cast<uLong>(length)));
+
+  stream.next_in = static_cast<Bytef*>(const_cast<void*>(buffer));
+  stream.avail_in = static_cast<uInt>(length);
+  stream.next_out = &encoded->front();
+  stream.avail_out = static_cast<uInt>(encoded->size());
+
+  // The output buffer is large enough for the whole content, therefore a
+  // single call finishes the stream.
+  result = deflate(&stream, Z_FINISH);
+  const uLong total_out = stream.total_out;
+  deflateEnd(&stream);
+
+  if (result != Z_STREAM_END) {
+    NET_LOG(LE, (_T("[deflate failed][%d]"), result));
+    encoded->clear();
+    return ZlibErrorToHResult(result);
+  }
+
+  encoded->resize(total_out);
+  return S_OK;
+}
+
+HRESULT DecodeContent(ContentEncoding encoding,
+                      const void* buffer,
+                      size_t length,
+                      size_t max_decoded_length,
+                      std::vector<uint8>* decoded) {
+  ASSERT1(buffer || !length);
+  ASSERT1(decoded);
+
+  if (length > std::numeric_limits<uInt>::max()) {
+    return E_INVALIDARG;
+  }
+
+  if (encoding == CONTENT_ENCODING_IDENTITY) {
+    if (length > max_decoded_length) {
+      return HRESULT_FROM_WIN32(ERROR_INVALID_DATA);
+    }
+    const uint8* bytes = static_cast<const uint8*>(buffer);
+    decoded->assign(bytes, bytes + length);
+    return S_OK;
+  }
+
+  z_stream stream = {};
+  int result = inflateInit2(&stream, GetWindowBits(encoding));
+  if (result != Z_OK) {
+    NET_LOG(LE, (_T("[inflateInit2 failed][%d]"), result));
+    return ZlibErrorToHResult(result);
+  }
+
+  decoded->clear();
+  stream.next_in = static_cast<Bytef*>(const_cast<void*>(buffer));
+  stream.avail_in = static_cast<uInt>(length);
+
+  do {
+    if (decoded->size() >= max_decoded_length) {
+      result = Z_BUF_ERROR;
+      break;
+    }
+
+    const size_t offset = decoded->size();
+    const size_t chunk_size = std::min(kChunkSize,
+                                       max_decoded_length - offset);
+    decoded->resize(offset + chunk_size);
+    stream.next_out = &decoded->front() + offset;
+    stream.avail_out = static_cast<uInt>(chunk_size);
+
+    result = inflate(&stream, Z_NO_FLUSH);
+    decoded->resize(offset + chunk_size - stream.avail_out);
+  } while (result == Z_OK);
+
+  inflateEnd(&stream);
+
+  if (result != Z_STREAM_END) {
+    NET_LOG(LE, (_T("[inflate failed][%d]"), result));
+    decoded->clear();
+    return ZlibErrorToHResult(result);
+  }
+
+  return S_OK;
+}
+
+ContentEncoder::ContentEncoder()
+    : encoding_(CONTENT_ENCODING_IDENTITY),
+      is_finished_(false) {
+}
+
+ContentEncoder::~ContentEncoder() {
+  Reset();
+}
+
+void ContentEncoder::Reset() {
+  if (stream_.get()) {
+    deflateEnd(stream_.get());
+    stream_.reset();
+  }
+  is_finished_ = false;
+}
+
+HRESULT ContentEncoder::Initialize(ContentEncoding encoding) {
+  Reset();
+  encoding_ = encoding;
+  if (encoding == CONTENT_ENCODING_IDENTITY) {
+    return S_OK;
+  }
+
+  std::unique_ptr<z_stream_s> stream(new z_stream_s());
+  const int result = deflateInit2(stream.get(),
+                                  Z_DEFAULT_COMPRESSION,
+                                  Z_DEFLATED,
+                                  GetWindowBits(encoding),
+                                  kMemLevel,
+                                  Z_DEFAULT_STRATEGY);
+  if (result != Z_OK) {
+    NET_LOG(LE, (_T("[deflateInit2 failed][%d]"), result));
+    return ZlibErrorToHResult(result);
+  }
+
+  stream_.swap(stream);
+  return S_OK;
+}
+
+HRESULT ContentEncoder::Write(const void* buffer,
+                              size_t length,
+                              std::vector<uint8>* encoded) {
+  ASSERT1(buffer || !length);
+  ASSERT1(encoded);
+
+  if (is_finished_) {
+    return E_UNEXPECTED;
+  }
+  if (encoding_ == CONTENT_ENCODING_IDENTITY) {
+    const uint8* bytes = static_cast<const uint8*>(buffer);
+    encoded->insert(encoded->end(), bytes, bytes + length);
+    return S_OK;
+  }
+  return Deflate(buffer, length, Z_NO_FLUSH, encoded);
+}
+
+HRESULT ContentEncoder::Finish(std::vector<uint8>* encoded) {
+  ASSERT1(encoded);
+
+  if (is_finished_) {
+    return E_UNEXPECTED;
+  }
+  is_finished_ = true;
+  if (encoding_ == CONTENT_ENCODING_IDENTITY) {
+    return S_OK;
+  }
+  return Deflate(NULL, 0, Z_FINISH, encoded);
+}
+
+HRESULT ContentEncoder::Deflate(const void* buffer,
+                                size_t length,
+                                int flush,
+                                std::vector<uint8>* encoded) {
+  ASSERT1(stream_.get());
+  ASSERT1(encoded);
+
+  if (length > std::numeric_limits<uInt>::max()) {
+    return E_INVALIDARG;
+  }
+
+  stream_->next_in = static_cast<Bytef*>(const_cast<void*>(buffer));
+  stream_->avail_in = static_cast<uInt>(length);
+
+  // The output grows by one chunk at a time, until deflate leaves room in
+  // the output, which means it has consumed all the input, or, when
+  // finishing, until the end of the stream.
+  int result = Z_OK;
+  do {
+    const size_t offset = encoded->size();
+    encoded->resize(offset + kChunkSize);
+    stream_->next_out = &encoded->front() + offset;
+    stream_->avail_out = static_cast<uInt>(kChunkSize);
+
+    result = deflate(stream_.get(), flush);
+    encoded->resize(offset + kChunkSize - stream_->avail_out);
+    if (result == Z_STREAM_ERROR) {
+      NET_LOG(LE, (_T("[deflate failed][%d]"), result));
+      return ZlibErrorToHResult(result);
+    }
+  } while (flush == Z_FINISH ? result != Z_STREAM_END :
+                               stream_->avail_out == 0);
+
+  ASSERT1(!stream_->avail_in);
+  return S_OK;
+}
+
+}  // namespace omaha
@@ -0,0 +1,96 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Encodes and decodes http request bodies with the gzip and deflate content
+// codings. The "deflate" coding is the zlib format, as defined by RFC 7230.
+
+#ifndef OMAHA_NET_CONTENT_ENCODING_H__
+#define OMAHA_NET_CONTENT_ENCODING_H__
+
+#include <atlstr.h>
+
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+
+struct z_stream_s;
+
+namespace omaha {
+
+enum ContentEncoding {
+  CONTENT_ENCODING_IDENTITY = 0,
+  CONTENT_ENCODING_GZIP,
+  CONTENT_ENCODING_DEFLATE,
+};
+
+// Returns the name of the content coding, as it appears in the
+// Content-Encoding header. Returns an empty string for the identity coding.
+CString ContentEncodingToString(ContentEncoding encoding);
+
+// Returns the content coding with the given name or the identity coding if
+// the name is not a supported content coding. The name is case insensitive.
+// If |name| is a comma-separated list of content codings, returns the first
+// supported one.
+ContentEncoding StringToContentEncoding(const CString& name);
+
+// Encodes |length| bytes of |buffer|.
+HRESULT EncodeContent(ContentEncoding encoding,
+                      const void* buffer,
+                      size_t length,
+                      std::vector<uint8>* encoded);
+
+// Decodes |length| bytes of |buffer|. Fails if the decoded content would be
+// larger than |max_decoded_length|.
+HRESULT DecodeContent(ContentEncoding encoding,
+                      const void* buffer,
+                      size_t length,
+                      size_t max_decoded_length,
+                      std::vector<uint8>* decoded);
+
+// Encodes content which is produced in parts, so that the content is never
+// entirely in memory. The encoded bytes are appended to |encoded| as they are
+// produced by the encoder, which may buffer some of the content until Finish.
+class ContentEncoder {
+ public:
+  ContentEncoder();
+  ~ContentEncoder();
+
+  // Starts encoding new content. The encoder can be initialized again to
+  // start over.
+  HRESULT Initialize(ContentEncoding encoding);
+
+  HRESULT Write(const void* buffer, size_t length, std::vector<uint8>* encoded);
+
+  // Encodes the rest of the content. Write can't be called after Finish.
+  HRESULT Finish(std::vector<uint8>* encoded);
+
+ private:
+  HRESULT Deflate(const void* buffer,
+                  size_t length,
+                  int flush,
+                  std::vector<uint8>* encoded);
+  void Reset();
+
+  ContentEncoding encoding_;
+  std::unique_ptr<z_stream_s> stream_;
+  bool is_finished_;
+
+  DISALLOW_COPY_AND_ASSIGN(ContentEncoder);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_NET_CONTENT_ENCODING_H__
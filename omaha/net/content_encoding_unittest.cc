@@ -0,0 +1,397 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/net/content_encoding.h"
+
+#include <windows.h>
+#include <winhttp.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "omaha/base/constants.h"
+#include "omaha/base/error.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace {
+
+typedef std::vector<std::pair<CString, CString> > HeaderList;
+
+const size_t kMaxDecodedLength = 16 * 1024 * 1024;
+
+// Returns an update check for |num_apps| apps, similar to the requests of a
+// machine which has many apps installed.
+CStringA BuildUpdateCheck(int num_apps) {
+  CStringA request(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+      "<request protocol=\"3.0\" updater=\"Omaha\" updaterversion=\"1.3.99.0\""
+      " shell_version=\"1.3.99.0\" ismachine=\"1\" sessionid="
+      "\"{2D5E1E70-5F6B-4B7B-9C51-6D52A1E1A3F4}\" installsource=\"scheduler\""
+      " requestid=\"{8C3C8A3D-1F3E-4E2A-8B5C-2A6E1E4F6D7C}\" dedup=\"cr\">"
+      "<hw physmemory=\"16\" sse=\"1\" sse2=\"1\" sse3=\"1\" ssse3=\"1\""
+      " sse41=\"1\" sse42=\"1\" avx=\"1\"/>"
+      "<os platform=\"win\" version=\"10.0.19045.3693\" sp=\"\""
+      " arch=\"x64\"/>");
+  for (int i = 0; i != num_apps; ++i) {
+    SafeCStringAAppendFormat(&request,
+        "<app appid=\"{%08X-5605-4C18-AA51-8BD0A1209C8C}\""
+        " version=\"%d.0.%d.0\" nextversion=\"\" lang=\"en\" brand=\"GGLS\""
+        " client=\"\" installage=\"%d\" cohort=\"1:1x:\" cohortname=\"Stable\">"
+        "<updatecheck/><ping r=\"1\" rd=\"6200\" ping_freshness="
+        "\"{%08X-8ACF-4746-8240-643741C797B5}\"/></app>",
+        i, i % 120, i * 7, i % 400, i * 31);
+  }
+  request += "</request>";
+  return request;
+}
+
+}  // namespace
+
+// A local stand-in for the update server, which handles a request as the
+// server would: it decodes the body according to the Content-Encoding header,
+// rejects the content codings it does not accept with 415, and advertises the
+// coding it wants in the X-Request-Encoding header. It counts the bytes
+// received on the wire.
+class LocalUpdateServer {
+ public:
+  explicit LocalUpdateServer(const CString& accepted_encoding)
+      : accepted_encoding_(accepted_encoding),
+        num_requests_received_(0),
+        num_bytes_received_(0) {}
+
+  int HandleRequest(const HeaderList& headers,
+                    const std::vector<uint8>& body,
+                    HeaderList* response_headers) {
+    EXPECT_TRUE(response_headers);
+
+    ++num_requests_received_;
+    num_bytes_received_ += body.size();
+
+    CString content_encoding;
+    for (size_t i = 0; i != headers.size(); ++i) {
+      num_bytes_received_ += headers[i].first.GetLength() +
+                             headers[i].second.GetLength() + 4;  // ": \r\n".
+      if (headers[i].first.CompareNoCase(kHeaderContentEncoding) == 0) {
+        content_encoding = headers[i].second;
+      }
+    }
+
+    response_headers->clear();
+    response_headers->push_back(
+        std::make_pair(CString(kHeaderXRequestEncoding),
+                       accepted_encoding_.IsEmpty() ? CString(_T("identity")) :
+                                                      accepted_encoding_));
+
+    const ContentEncoding encoding = StringToContentEncoding(content_encoding);
+    if (!content_encoding.IsEmpty() &&
+        (encoding == CONTENT_ENCODING_IDENTITY ||
+         encoding != StringToContentEncoding(accepted_encoding_))) {
+      return HTTP_STATUS_UNSUPPORTED_MEDIA;
+    }
+
+    if (FAILED(DecodeContent(encoding,
+                             body.empty() ? NULL : &body.front(),
+                             body.size(),
+                             kMaxDecodedLength,
+                             &last_request_))) {
+      return HTTP_STATUS_BAD_REQUEST;
+    }
+    return HTTP_STATUS_OK;
+  }
+
+  int num_requests_received() const { return num_requests_received_; }
+  size_t num_bytes_received() const { return num_bytes_received_; }
+  const std::vector<uint8>& last_request() const { return last_request_; }
+
+ private:
+  CString accepted_encoding_;
+  int num_requests_received_;
+  size_t num_bytes_received_;
+  std::vector<uint8> last_request_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalUpdateServer);
+};
+
+class ContentEncodingTest : public testing::Test {
+ protected:
+  // Posts |request| to |server| as WebServicesClient does: the body is
+  // encoded with |*encoding|, and sent again uncompressed if the server
+  // rejects the encoding. |*encoding| receives the encoding that the server
+  // asks for.
+  int Post(LocalUpdateServer* server,
+           const CStringA& request,
+           ContentEncoding* encoding) {
+    HeaderList headers;
+    std::vector<uint8> body;
+    EXPECT_SUCCEEDED(EncodeContent(*encoding,
+                                   request.GetString(),
+                                   request.GetLength(),
+                                   &body));
+    if (*encoding != CONTENT_ENCODING_IDENTITY) {
+      headers.push_back(std::make_pair(CString(kHeaderContentEncoding),
+                                       ContentEncodingToString(*encoding)));
+    }
+
+    HeaderList response_headers;
+    int status = server->HandleRequest(headers, body, &response_headers);
+    if (status == HTTP_STATUS_UNSUPPORTED_MEDIA) {
+      const uint8* bytes = reinterpret_cast<const uint8*>(request.GetString());
+      body.assign(bytes, bytes + request.GetLength());
+      status = server->HandleRequest(HeaderList(), body, &response_headers);
+    }
+
+    for (size_t i = 0; i != response_headers.size(); ++i) {
+      if (response_headers[i].first == kHeaderXRequestEncoding) {
+        *encoding = StringToContentEncoding(response_headers[i].second);
+      }
+    }
+    return status;
+  }
+
+  static CStringA ToString(const std::vector<uint8>& buffer) {
+    return buffer.empty() ?
+        CStringA() :
+        CStringA(reinterpret_cast<const char*>(&buffer.front()),
+                 static_cast<int>(buffer.size()));
+  }
+};
+
+TEST_F(ContentEncodingTest, ContentEncodingToString) {
+  EXPECT_STREQ(_T(""), ContentEncodingToString(CONTENT_ENCODING_IDENTITY));
+  EXPECT_STREQ(_T("gzip"), ContentEncodingToString(CONTENT_ENCODING_GZIP));
+  EXPECT_STREQ(_T("deflate"),
+               ContentEncodingToString(CONTENT_ENCODING_DEFLATE));
+}
+
+TEST_F(ContentEncodingTest, StringToContentEncoding) {
+  EXPECT_EQ(CONTENT_ENCODING_IDENTITY, StringToContentEncoding(_T("")));
+  EXPECT_EQ(CONTENT_ENCODING_IDENTITY,
+            StringToContentEncoding(_T("identity")));
+  EXPECT_EQ(CONTENT_ENCODING_IDENTITY, StringToContentEncoding(_T("br")));
+  EXPECT_EQ(CONTENT_ENCODING_GZIP, StringToContentEncoding(_T("gzip")));
+  EXPECT_EQ(CONTENT_ENCODING_GZIP, StringToContentEncoding(_T("GZip")));
+  EXPECT_EQ(CONTENT_ENCODING_DEFLATE, StringToContentEncoding(_T("deflate")));
+  EXPECT_EQ(CONTENT_ENCODING_DEFLATE,
+            StringToContentEncoding(_T("br, deflate ,gzip")));
+}
+
+TEST_F(ContentEncodingTest, RoundTrip) {
+  const CStringA request(BuildUpdateCheck(50));
+  const ContentEncoding kEncodings[] = {
+    CONTENT_ENCODING_IDENTITY,
+    CONTENT_ENCODING_GZIP,
+    CONTENT_ENCODING_DEFLATE,
+  };
+
+  for (size_t i = 0; i != arraysize(kEncodings); ++i) {
+    std::vector<uint8> encoded;
+    EXPECT_SUCCEEDED(EncodeContent(kEncodings[i],
+                                   request.GetString(),
+                                   request.GetLength(),
+                                   &encoded));
+    if (kEncodings[i] != CONTENT_ENCODING_IDENTITY) {
+      EXPECT_GT(static_cast<size_t>(request.GetLength()) / 4, encoded.size());
+    }
+
+    std::vector<uint8> decoded;
+    EXPECT_SUCCEEDED(DecodeContent(kEncodings[i],
+                                   &encoded.front(),
+                                   encoded.size(),
+                                   kMaxDecodedLength,
+                                   &decoded));
+    EXPECT_STREQ(request, ToString(decoded));
+  }
+}
+
+TEST_F(ContentEncodingTest, EncodeContent_Formats) {
+  const char kContent[] = "content";
+
+  std::vector<uint8> gzip;
+  EXPECT_SUCCEEDED(EncodeContent(CONTENT_ENCODING_GZIP,
+                                 kContent, arraysize(kContent) - 1, &gzip));
+  ASSERT_LT(2u, gzip.size());
+  EXPECT_EQ(0x1f, gzip[0]);
+  EXPECT_EQ(0x8b, gzip[1]);
+
+  std::vector<uint8> deflate;
+  EXPECT_SUCCEEDED(EncodeContent(CONTENT_ENCODING_DEFLATE,
+                                 kContent, arraysize(kContent) - 1, &deflate));
+  ASSERT_LT(2u, deflate.size());
+  EXPECT_EQ(0x78, deflate[0]);
+  EXPECT_EQ(0, ((deflate[0] << 8) | deflate[1]) % 31);
+
+  // Each coding rejects the other's format.
+  std::vector<uint8> decoded;
+  EXPECT_FAILED(DecodeContent(CONTENT_ENCODING_DEFLATE,
+                              &gzip.front(), gzip.size(),
+                              kMaxDecodedLength, &decoded));
+  EXPECT_FAILED(DecodeContent(CONTENT_ENCODING_GZIP,
+                              &deflate.front(), deflate.size(),
+                              kMaxDecodedLength, &decoded));
+}
+
+TEST_F(ContentEncodingTest, EncodeContent_Empty) {
+  std::vector<uint8> encoded;
+  EXPECT_SUCCEEDED(EncodeContent(CONTENT_ENCODING_GZIP, NULL, 0, &encoded));
+  EXPECT_FALSE(encoded.empty());
+
+  std::vector<uint8> decoded(1);
+  EXPECT_SUCCEEDED(DecodeContent(CONTENT_ENCODING_GZIP,
+                                 &encoded.front(), encoded.size(),
+                                 kMaxDecodedLength, &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST_F(ContentEncodingTest, DecodeContent_Truncated) {
+  const CStringA request(BuildUpdateCheck(10));
+  std::vector<uint8> encoded;
+  EXPECT_SUCCEEDED(EncodeContent(CONTENT_ENCODING_GZIP,
+                                 request.GetString(),
+                                 request.GetLength(),
+                                 &encoded));
+
+  std::vector<uint8> decoded;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_INVALID_DATA),
+            DecodeContent(CONTENT_ENCODING_GZIP,
+                          &encoded.front(), encoded.size() - 4,
+                          kMaxDecodedLength, &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST_F(ContentEncodingTest, DecodeContent_MaxDecodedLength) {
+  const CStringA request(BuildUpdateCheck(10));
+  std::vector<uint8> encoded;
+  EXPECT_SUCCEEDED(EncodeContent(CONTENT_ENCODING_DEFLATE,
+                                 request.GetString(),
+                                 request.GetLength(),
+                                 &encoded));
+
+  std::vector<uint8> decoded;
+  EXPECT_FAILED(DecodeContent(CONTENT_ENCODING_DEFLATE,
+                              &encoded.front(), encoded.size(),
+                              request.GetLength() - 1, &decoded));
+  EXPECT_SUCCEEDED(DecodeContent(CONTENT_ENCODING_DEFLATE,
+                                 &encoded.front(), encoded.size(),
+                                 request.GetLength(), &decoded));
+  EXPECT_EQ(static_cast<size_t>(request.GetLength()), decoded.size());
+}
+
+TEST_F(ContentEncodingTest, ContentEncoder_Parts) {
+  const CStringA request(BuildUpdateCheck(200));
+  const ContentEncoding kEncodings[] = {
+    CONTENT_ENCODING_IDENTITY,
+    CONTENT_ENCODING_GZIP,
+    CONTENT_ENCODING_DEFLATE,
+  };
+
+  for (size_t i = 0; i != arraysize(kEncodings); ++i) {
+    // The encoder is initialized twice, to check that it starts over.
+    ContentEncoder encoder;
+    std::vector<uint8> encoded;
+    EXPECT_SUCCEEDED(encoder.Initialize(kEncodings[i]));
+    EXPECT_SUCCEEDED(encoder.Write("discarded", 9, &encoded));
+    EXPECT_SUCCEEDED(encoder.Initialize(kEncodings[i]));
+    encoded.clear();
+
+    // Writes the request in parts of various sizes, including empty parts.
+    const int kPartSizes[] = {0, 1, 7, 1000, 16 * 1024, 70 * 1024};
+    size_t part = 0;
+    for (int offset = 0; offset < request.GetLength(); ++part) {
+      const int part_size = std::min(kPartSizes[part % arraysize(kPartSizes)],
+                                     request.GetLength() - offset);
+      EXPECT_SUCCEEDED(encoder.Write(request.GetString() + offset,
+                                     part_size,
+                                     &encoded));
+      offset += part_size;
+    }
+    EXPECT_SUCCEEDED(encoder.Finish(&encoded));
+    EXPECT_EQ(E_UNEXPECTED, encoder.Write("x", 1, &encoded));
+    EXPECT_EQ(E_UNEXPECTED, encoder.Finish(&encoded));
+
+    std::vector<uint8> decoded;
+    EXPECT_SUCCEEDED(DecodeContent(kEncodings[i],
+                                   &encoded.front(),
+                                   encoded.size(),
+                                   kMaxDecodedLength,
+                                   &decoded));
+    EXPECT_STREQ(request, ToString(decoded));
+  }
+}
+
+TEST_F(ContentEncodingTest, LocalServer_NegotiatesEncoding) {
+  const CStringA request(BuildUpdateCheck(20));
+  LocalUpdateServer server(_T("gzip"));
+
+  // The first request is sent uncompressed. The server asks for gzip.
+  ContentEncoding encoding = CONTENT_ENCODING_IDENTITY;
+  EXPECT_EQ(HTTP_STATUS_OK, Post(&server, request, &encoding));
+  EXPECT_EQ(CONTENT_ENCODING_GZIP, encoding);
+  EXPECT_EQ(1, server.num_requests_received());
+  const size_t identity_bytes = server.num_bytes_received();
+
+  EXPECT_EQ(HTTP_STATUS_OK, Post(&server, request, &encoding));
+  EXPECT_EQ(CONTENT_ENCODING_GZIP, encoding);
+  EXPECT_EQ(2, server.num_requests_received());
+  EXPECT_STREQ(request, ToString(server.last_request()));
+  EXPECT_GT(identity_bytes, server.num_bytes_received() - identity_bytes);
+}
+
+TEST_F(ContentEncodingTest, LocalServer_RejectsEncoding) {
+  const CStringA request(BuildUpdateCheck(20));
+  LocalUpdateServer server(_T(""));
+
+  // The server does not accept deflate, so the request is sent again
+  // uncompressed and the server turns compression off.
+  ContentEncoding encoding = CONTENT_ENCODING_DEFLATE;
+  EXPECT_EQ(HTTP_STATUS_OK, Post(&server, request, &encoding));
+  EXPECT_EQ(CONTENT_ENCODING_IDENTITY, encoding);
+  EXPECT_EQ(2, server.num_requests_received());
+  EXPECT_STREQ(request, ToString(server.last_request()));
+}
+
+// Compares the bytes on the wire for update checks of different sizes.
+TEST_F(ContentEncodingTest, BytesOnWire) {
+  const int kNumApps[] = {1, 20, 100, 500};
+  const ContentEncoding kEncodings[] = {
+    CONTENT_ENCODING_IDENTITY,
+    CONTENT_ENCODING_GZIP,
+    CONTENT_ENCODING_DEFLATE,
+  };
+
+  for (size_t i = 0; i != arraysize(kNumApps); ++i) {
+    const CStringA request(BuildUpdateCheck(kNumApps[i]));
+    size_t bytes[arraysize(kEncodings)] = {};
+
+    for (size_t j = 0; j != arraysize(kEncodings); ++j) {
+      LocalUpdateServer server(ContentEncodingToString(kEncodings[j]));
+      ContentEncoding encoding = kEncodings[j];
+      EXPECT_EQ(HTTP_STATUS_OK, Post(&server, request, &encoding));
+      bytes[j] = server.num_bytes_received();
+      EXPECT_STREQ(request, ToString(server.last_request()));
+    }
+
+    if (kNumApps[i] >= 20) {
+      EXPECT_GT(bytes[0] / 4, bytes[1]);
+      EXPECT_GT(bytes[0] / 4, bytes[2]);
+    }
+  }
+}
+
+}  // namespace omaha
@@ -55,11 +55,7 @@ CupEcdsaRequestImpl::CupEcdsaRequestImpl(HttpRequestInterface* http_request)
       request_buffer_length_(0) {
   ASSERT1(http_request);
 
-  // Load the appropriate ECC public key.
-  const uint8* const encoded_public_key =
-      NetworkConfig::IsUsingCupTestKeys() ? kCupTestPublicKey :
-                                            kCupProductionPublicKey;
-  public_key_.DecodeFromBuffer(encoded_public_key);
+  LoadPublicKey(&public_key_);
 
   // Store the inner HTTP request.
   http_request_.reset(http_request);
@@ -164,6 +160,10 @@ void CupEcdsaRequestImpl::set_callback(NetworkRequestCallback* callback) {
   http_request_->set_callback(callback);
 }
 
+void CupEcdsaRequestImpl::set_pacer(NetworkRequestPacer* pacer) {
+  http_request_->set_pacer(pacer);
+}
+
 void CupEcdsaRequestImpl::set_additional_headers(
     const CString& additional_headers) {
   http_request_->set_additional_headers(additional_headers);
@@ -182,6 +182,36 @@ void CupEcdsaRequestImpl::set_proxy_auth_config(const ProxyAuthConfig& config) {
 }
 
 HRESULT CupEcdsaRequestImpl::BuildRequest() {
+  return BuildRequestUrl(url_,
+                         public_key_.version(),
+                         request_buffer_,
+                         request_buffer_length_,
+                         &cup_->request_url,
+                         &cup_->cup2key,
+                         &cup_->cup2hreq,
+                         &cup_->request_hash);
+}
+
+uint8 CupEcdsaRequestImpl::GetPublicKeyVersion() {
+  EcdsaPublicKey public_key;
+  LoadPublicKey(&public_key);
+  return public_key.version();
+}
+
+HRESULT CupEcdsaRequestImpl::BuildRequestUrl(
+    const CString& url,
+    uint8 key_version,
+    const void* request_buffer,
+    size_t request_buffer_length,
+    CString* request_url,
+    CString* cup2key,
+    CString* cup2hreq,
+    std::vector<uint8>* request_hash) {
+  ASSERT1(request_url);
+  ASSERT1(cup2key);
+  ASSERT1(cup2hreq);
+  ASSERT1(request_hash);
+
   // Generate a random nonce of 256 bits.
   char nonce[32] = {0};
   if (!RandBytes(&nonce, sizeof(nonce))) {
@@ -194,30 +224,37 @@ HRESULT CupEcdsaRequestImpl::BuildRequest() {
 
   // Compute the SHA-256 hash of the request body; we need it to verify the
   // response, and we can optionally send it to the server as well.
-  VERIFY1(SafeSHA256Hash(request_buffer_, request_buffer_length_,
-                         &cup_->request_hash));
+  VERIFY1(SafeSHA256Hash(request_buffer, request_buffer_length,
+                         request_hash));
 
   // Generate the values of our query parameters, cup2key and (opt) cup2hreq.
-  SafeCStringFormat(&cup_->cup2key, _T("%d:%S"),
-                    static_cast<int>(public_key_.version()),
+  SafeCStringFormat(cup2key, _T("%d:%S"),
+                    static_cast<int>(key_version),
                     nonce_string);
-  cup_->cup2hreq = BytesToHex(cup_->request_hash);
+  *cup2hreq = BytesToHex(*request_hash);
 
   // Compute the url of the CUP request -- append a query string, or append to
   // the existing query string if one already exists.
-  ASSERT1(!url_.IsEmpty());
-  const TCHAR* format_string = url_.Find(_T('?')) != -1 ?
+  ASSERT1(!url.IsEmpty());
+  const TCHAR* format_string = url.Find(_T('?')) != -1 ?
       _T("%1&cup2key=%2&cup2hreq=%3") :
       _T("%1?cup2key=%2&cup2hreq=%3");
-  cup_->request_url.FormatMessage(format_string,
-                                  url_,
-                                  cup_->cup2key,
-                                  cup_->cup2hreq);
-  NET_LOG(L4, (_T("[CUP-ECDSA][request:     %s]"), cup_->request_url));
+  request_url->FormatMessage(format_string, url, *cup2key, *cup2hreq);
+  NET_LOG(L4, (_T("[CUP-ECDSA][request:     %s]"), *request_url));
 
   return S_OK;
 }
 
+void CupEcdsaRequestImpl::LoadPublicKey(EcdsaPublicKey* public_key) {
+  ASSERT1(public_key);
+
+  // Load the appropriate ECC public key.
+  const uint8* const encoded_public_key =
+      NetworkConfig::IsUsingCupTestKeys() ? kCupTestPublicKey :
+                                            kCupProductionPublicKey;
+  public_key->DecodeFromBuffer(encoded_public_key);
+}
+
 HRESULT CupEcdsaRequestImpl::DoSend() {
   // Set the URL of the inner request to the full CUP url.
   http_request_->set_url(CString(cup_->request_url));
@@ -489,6 +526,10 @@ void CupEcdsaRequest::set_callback(NetworkRequestCallback* callback) {
   impl_->set_callback(callback);
 }
 
+void CupEcdsaRequest::set_pacer(NetworkRequestPacer* pacer) {
+  impl_->set_pacer(pacer);
+}
+
 void CupEcdsaRequest::set_additional_headers(
     const CString& additional_headers) {
   impl_->set_additional_headers(additional_headers);
@@ -80,6 +80,8 @@ class CupEcdsaRequest : public HttpRequestInterface {
 
   virtual void set_callback(NetworkRequestCallback* callback);
 
+  virtual void set_pacer(NetworkRequestPacer* pacer);
+
   virtual void set_additional_headers(const CString& additional_headers);
 
   virtual CString user_agent() const;
@@ -55,11 +55,29 @@ class CupEcdsaRequestImpl {
   void set_filename(const CString& filename);
   void set_low_priority(bool low_priority);
   void set_callback(NetworkRequestCallback* callback);
+  void set_pacer(NetworkRequestPacer* pacer);
   void set_additional_headers(const CString& additional_headers);
   CString user_agent() const;
   void set_user_agent(const CString& user_agent);
   void set_proxy_auth_config(const ProxyAuthConfig& proxy_auth_config);
 
+  // Returns the version of the public key which the requests use.
+  static uint8 GetPublicKeyVersion();
+
+  // Builds the url of a CUP request with the body in |request_buffer|, by
+  // appending the cup2key parameter, with a new nonce, and the cup2hreq
+  // parameter to |url|. Returns the parameters and the SHA-256 hash of the
+  // body too. Tools which replay requests use this to sign them like the
+  // client does.
+  static HRESULT BuildRequestUrl(const CString& url,
+                                 uint8 key_version,
+                                 const void* request_buffer,
+                                 size_t request_buffer_length,
+                                 CString* request_url,
+                                 CString* cup2key,
+                                 CString* cup2hreq,
+                                 std::vector<uint8>* request_hash);
+
  private:
   friend class CupEcdsaRequestTest;
 
@@ -67,6 +85,8 @@ class CupEcdsaRequestImpl {
   HRESULT DoSend();
   HRESULT AuthenticateResponse();
 
+  static void LoadPublicKey(EcdsaPublicKey* public_key);
+
   static bool ParseServerETag(const CString& etag_in,
                               EcdsaSignature* sig_out,
                               std::vector<uint8>* req_hash_out);
@@ -91,7 +111,10 @@ class CupEcdsaRequestImpl {
   std::unique_ptr<TransientCupState> cup_;
 
   CString     url_;                     // The original url.
-  const void* request_buffer_;          // Contains the request body for POST.
+  // Contains the request body for POST, as it is sent on the wire. When the
+  // body has a content coding, such as gzip, the request hash is computed over
+  // the encoded body.
+  const void* request_buffer_;
   size_t      request_buffer_length_;   // Length of the request body.
 
   typedef const uint8 PublicKeyInstance[];
@@ -27,6 +27,7 @@
 #include "omaha/net/cup_ecdsa_request.h"
 #include "omaha/net/cup_ecdsa_request_impl.h"
 #include "omaha/net/cup_ecdsa_utils.h"
+#include "omaha/net/content_encoding.h"
 #include "omaha/net/network_config.h"
 #include "omaha/net/simple_request.h"
 #include "omaha/testing/unit_test.h"
@@ -98,6 +99,20 @@ class CupEcdsaRequestTest : public testing::Test {
     std::vector<uint8> response(http_request->GetResponse());
   }
 
+  // Builds a CUP request for the body and returns the cup2hreq parameter.
+  CString DoBuildRequest(const void* request_buffer,
+                         size_t request_buffer_length) {
+    internal::CupEcdsaRequestImpl cup_request(new SimpleRequest);
+    cup_request.set_url(kPostUrl);
+    cup_request.set_request_buffer(request_buffer, request_buffer_length);
+    cup_request.cup_.reset(
+        new internal::CupEcdsaRequestImpl::TransientCupState);
+    EXPECT_HRESULT_SUCCEEDED(cup_request.BuildRequest());
+    const CString cup2hreq(cup_request.cup_->cup2hreq);
+    EXPECT_NE(-1, cup_request.cup_->request_url.Find(cup2hreq));
+    return cup2hreq;
+  }
+
   bool DoParseServerETag(const CString& etag) {
     internal::EcdsaSignature sig;
     std::vector<uint8> hash;
@@ -145,6 +160,30 @@ TEST_F(CupEcdsaRequestTest, PostSimpleRequestHttps) {
     _T("1234567890abcdef1234567890______1234567890abcdef1234567890abcdef")
 
 
+// The request hash covers the body as it is sent, which is the compressed
+// body when the request has a content coding.
+TEST_F(CupEcdsaRequestTest, BuildRequest_HashesEncodedBody) {
+  std::vector<uint8> encoded;
+  EXPECT_HRESULT_SUCCEEDED(EncodeContent(CONTENT_ENCODING_GZIP,
+                                         kRequestBuffer,
+                                         arraysize(kRequestBuffer) - 1,
+                                         &encoded));
+  ASSERT_FALSE(encoded.empty());
+
+  std::vector<uint8> encoded_hash;
+  EXPECT_TRUE(internal::SafeSHA256Hash(&encoded.front(), encoded.size(),
+                                       &encoded_hash));
+  std::vector<uint8> hash;
+  EXPECT_TRUE(internal::SafeSHA256Hash(kRequestBuffer,
+                                       arraysize(kRequestBuffer) - 1,
+                                       &hash));
+
+  EXPECT_STREQ(BytesToHex(encoded_hash),
+               DoBuildRequest(&encoded.front(), encoded.size()));
+  EXPECT_STREQ(BytesToHex(hash),
+               DoBuildRequest(kRequestBuffer, arraysize(kRequestBuffer) - 1));
+}
+
 TEST_F(CupEcdsaRequestTest, ParseServerETag_Good) {
   // A Strong ETag formatted as S:H.
   EXPECT_TRUE(DoParseServerETag(
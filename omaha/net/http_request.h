@@ -34,6 +34,7 @@
 namespace omaha {
 
 class NetworkRequestCallback;
+class NetworkRequestPacer;
 struct DownloadMetrics;
 
 class HttpRequestInterface {
@@ -80,6 +81,8 @@ class HttpRequestInterface {
 
   virtual void set_callback(NetworkRequestCallback* callback) = 0;
 
+  virtual void set_pacer(NetworkRequestPacer* pacer) = 0;
+
   virtual void set_additional_headers(const CString& additional_headers) = 0;
 
   // Gets the user agent for this http request. The default user agent has
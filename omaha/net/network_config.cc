@@ -44,6 +44,7 @@
 #include "omaha/base/utils.h"
 #include "omaha/common/config_manager.h"
 #include "omaha/common/const_goopdate.h"
+#include "omaha/net/connection_pool.h"
 #include "omaha/net/http_client.h"
 #include "omaha/net/winhttp.h"
 
@@ -82,6 +83,7 @@ NetworkConfig::NetworkConfig(bool is_machine)
 
 NetworkConfig::~NetworkConfig() {
   if (session_.session_handle && http_client_.get()) {
+    ConnectionPool::Instance().UnregisterSession(session_.session_handle);
     http_client_->Close(session_.session_handle);
     session_.session_handle = NULL;
   }
@@ -122,6 +124,10 @@ HRESULT NetworkConfig::Initialize() {
     return hr;
   }
 
+  // The network requests of the process reuse the connections of the session.
+  ConnectionPool::Instance().RegisterSession(session_.session_handle,
+                                             http_client_.get());
+
   // Allow TLS1.2 on Windows 7 and Windows 8. See KB3140245.
   // TLS 1.2 is enabled by default on Windows 8.1 and Windows 10.
   if (::IsWindows7OrGreater() && !::IsWindows8Point1OrGreater()) {
@@ -740,6 +746,8 @@ void NetworkConfigManager::DeleteInstance() {
     instance->DeleteInstanceInternal();
     delete instance;
   }
+
+  ConnectionPool::DeleteInstance();
 }
 
 NetworkConfigManager& NetworkConfigManager::Instance() {
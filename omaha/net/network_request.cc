@@ -89,6 +89,10 @@ void NetworkRequest::set_callback(NetworkRequestCallback* callback) {
   return impl_->set_callback(callback);
 }
 
+void NetworkRequest::set_pacer(NetworkRequestPacer* pacer) {
+  return impl_->set_pacer(pacer);
+}
+
 CString NetworkRequest::response_headers() const {
   return impl_->response_headers();
 }
@@ -59,6 +59,16 @@ class NetworkRequestCallback {
   virtual void OnRequestRetryScheduled(time64 next_retry_time) = 0;
 };
 
+// Paces the transfer of a response body. The request calls OnBytesReceived
+// after each read and waits for the returned number of milliseconds before it
+// reads again. The wait ends early if the request is canceled.
+class NetworkRequestPacer {
+ public:
+  virtual ~NetworkRequestPacer() {}
+
+  virtual int OnBytesReceived(int num_bytes) = 0;
+};
+
 class  HttpRequestInterface;
 
 // NetworkRequest is the main interface to the net module. The semantics of
@@ -176,6 +186,10 @@ class NetworkRequest {
   // notification for DownloadFile only.
   void set_callback(NetworkRequestCallback* callback);
 
+  // Sets the pacer of the transfers. The ownership of the pacer remains with
+  // the caller. Currently, only WinHttp requests are paced.
+  void set_pacer(NetworkRequestPacer* pacer);
+
   // Sets the priority of the request. Currently, only BITS requests support
   // prioritization of requests.
   void set_low_priority(bool low_priority);
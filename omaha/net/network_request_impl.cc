@@ -96,6 +96,7 @@ NetworkRequestImpl::NetworkRequestImpl(
         response_(NULL),
         network_session_(network_session),
         callback_(NULL),
+        pacer_(NULL),
         cur_http_request_(NULL),
         cur_proxy_config_(NULL),
         last_hr_(S_OK),
@@ -516,6 +517,7 @@ HRESULT NetworkRequestImpl::DoSendHttpRequest(
   cur_http_request_->set_filename(filename_);
   cur_http_request_->set_low_priority(low_priority_);
   cur_http_request_->set_callback(callback_);
+  cur_http_request_->set_pacer(pacer_);
   cur_http_request_->set_additional_headers(BuildPerRequestHeaders());
   cur_http_request_->set_proxy_configuration(*cur_proxy_config_);
   cur_http_request_->set_proxy_auth_config(proxy_auth_config_);
@@ -88,6 +88,8 @@ class NetworkRequestImpl {
     callback_ = callback;
   }
 
+  void set_pacer(NetworkRequestPacer* pacer) { pacer_ = pacer; }
+
   void set_low_priority(bool low_priority) { low_priority_ = low_priority; }
 
   void set_proxy_configuration(const ProxyConfig* proxy_configuration) {
@@ -185,6 +187,7 @@ class NetworkRequestImpl {
 
   const NetworkConfig::Session  network_session_;
   NetworkRequestCallback*       callback_;
+  NetworkRequestPacer*          pacer_;
 
   // The http request and the network configuration currently in use.
   HttpRequestInterface* cur_http_request_;
@@ -54,6 +54,9 @@ namespace {
 // How many times should we retry when we get ERROR_WINHTTP_RESEND_REQUEST.
 constexpr const int kMaxResendAttempts = 3;
 
+// The size of the parts of a request body which is sent from a stream.
+constexpr const size_t kRequestChunkSize = 64 * 1024;
+
 }  // namespace
 
 SimpleRequest::TransientRequestState::TransientRequestState()
@@ -77,9 +80,11 @@ SimpleRequest::SimpleRequest()
       session_handle_(NULL),
       request_buffer_(NULL),
       request_buffer_length_(0),
+      request_stream_(NULL),
       proxy_auth_config_(NULL, CString()),
       low_priority_(false),
       callback_(NULL),
+      pacer_(NULL),
       download_completed_(false),
       resend_count_(0) {
   SafeCStringFormat(&user_agent_, _T("%s;winhttp"),
@@ -93,6 +98,9 @@ SimpleRequest::SimpleRequest()
   // to the caller.
   reset(event_resume_, ::CreateEvent(NULL, true, true, NULL));
   ASSERT1(valid(event_resume_));
+
+  reset(event_cancel_, ::CreateEvent(NULL, true, false, NULL));
+  ASSERT1(valid(event_cancel_));
 }
 
 // TODO(omaha): we should attempt to cleanup the file only if we
@@ -148,6 +156,9 @@ HRESULT SimpleRequest::Cancel() {
   __mutexScope(lock_);
   is_canceled_ = true;
   CloseHandles();
+  if (event_cancel_) {
+    VERIFY1(::SetEvent(get(event_cancel_)));
+  }
 
   // Resume the downloading thread if it is blocked. It is still fine if the
   // event is set since the operation is like no-op in that case.
@@ -361,6 +372,9 @@ HRESULT SimpleRequest::Connect() {
     SafeCStringAppendFormat(&additional_headers, _T("Range: bytes=%d-\r\n"),
                             request_state_->current_bytes);
   }
+  if (request_stream_) {
+    additional_headers.Append(_T("Transfer-Encoding: chunked\r\n"));
+  }
   if (!additional_headers.IsEmpty()) {
     uint32 header_flags = WINHTTP_ADDREQ_FLAG_ADD | WINHTTP_ADDREQ_FLAG_REPLACE;
     hr = winhttp_adapter_->AddRequestHeaders(additional_headers,
@@ -467,12 +481,23 @@ HRESULT SimpleRequest::SendRequest() {
                                                             flags));
     }
 
-    const DWORD bytes_to_send = static_cast<DWORD>(request_buffer_length_);
-    hr = winhttp_adapter_->SendRequest(NULL,
-                                       0,
-                                       request_buffer_,
-                                       bytes_to_send,
-                                       bytes_to_send);
+    if (request_stream_) {
+      hr = winhttp_adapter_->SendRequest(NULL,
+                                         0,
+                                         NULL,
+                                         0,
+                                         WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH);
+      if (SUCCEEDED(hr)) {
+        hr = WriteRequestStream();
+      }
+    } else {
+      const DWORD bytes_to_send = static_cast<DWORD>(request_buffer_length_);
+      hr = winhttp_adapter_->SendRequest(NULL,
+                                         0,
+                                         request_buffer_,
+                                         bytes_to_send,
+                                         bytes_to_send);
+    }
     if (FAILED(hr)) {
       return hr;
     }
@@ -600,6 +625,59 @@ HRESULT SimpleRequest::SendRequest() {
   return hr;
 }
 
+// WinHttp does not frame the chunks of the body, so each part of the stream
+// is sent as a chunk, "<size in hex>\r\n<data>\r\n", and the body ends with
+// a chunk of size 0. The stream is rewound first, since the request may be
+// sent again, for instance after a proxy authentication challenge.
+HRESULT SimpleRequest::WriteRequestStream() {
+  ASSERT1(request_stream_);
+
+  HRESULT hr = request_stream_->Rewind();
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  const char kChunkTrailer[] = "\r\n";
+  std::vector<uint8> chunk;
+  std::vector<uint8> data(kRequestChunkSize);
+  size_t bytes_read = 0;
+  do {
+    hr = request_stream_->Read(&data.front(), data.size(), &bytes_read);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    ASSERT1(bytes_read <= data.size());
+
+    CStringA chunk_header;
+    SafeCStringAFormat(&chunk_header,
+                       "%x\r\n",
+                       static_cast<uint32>(bytes_read));
+    chunk.assign(chunk_header.GetString(),
+                 chunk_header.GetString() + chunk_header.GetLength());
+    chunk.insert(chunk.end(), data.begin(), data.begin() + bytes_read);
+    chunk.insert(chunk.end(),
+                 kChunkTrailer,
+                 kChunkTrailer + arraysize(kChunkTrailer) - 1);
+
+    for (size_t offset = 0; offset != chunk.size();) {
+      DWORD bytes_written = 0;
+      hr = winhttp_adapter_->WriteData(
+          &chunk.front() + offset,
+          static_cast<DWORD>(chunk.size() - offset),
+          &bytes_written);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      if (!bytes_written) {
+        return E_FAIL;
+      }
+      offset += bytes_written;
+    }
+  } while (bytes_read);
+
+  return S_OK;
+}
+
 HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
   ASSERT1(file_handle != INVALID_HANDLE_VALUE || filename_.IsEmpty());
 
@@ -676,6 +754,17 @@ HRESULT SimpleRequest::ReceiveData(HANDLE file_handle) {
                             WINHTTP_CALLBACK_STATUS_READ_COMPLETE,
                             NULL);
     }
+
+    // The pacer delays the next read, which lets the receive window of the
+    // connection fill up and slows down the sender.
+    if (pacer_ && bytes_available) {
+      const int delay_ms = pacer_->OnBytesReceived(bytes_available);
+      if (delay_ms > 0 &&
+          ::WaitForSingleObject(get(event_cancel_), delay_ms) ==
+              WAIT_OBJECT_0) {
+        return GOOPDATE_E_CANCELLED;
+      }
+    }
   } while (!buffer.empty());
 
   NET_LOG(L3, (_T("[bytes downloaded %d]"), request_state_->current_bytes));
@@ -39,6 +39,21 @@ namespace omaha {
 class WinHttpAdapter;
 struct DownloadMetrics;
 
+// Provides the body of a POST request which is sent in parts, with the
+// chunked transfer encoding, when the length of the body is not known before
+// the body is sent.
+class RequestBodyStream {
+ public:
+  virtual ~RequestBodyStream() {}
+
+  // Starts the body over, when the request is sent again.
+  virtual HRESULT Rewind() = 0;
+
+  // Reads up to |size| bytes of the body. The body ends when |bytes_read|
+  // is 0.
+  virtual HRESULT Read(void* buffer, size_t size, size_t* bytes_read) = 0;
+};
+
 class SimpleRequest : public HttpRequestInterface {
  public:
   SimpleRequest();
@@ -79,6 +94,12 @@ class SimpleRequest : public HttpRequestInterface {
     request_buffer_length_ = buffer_length;
   }
 
+  // Sends the body of the request from |request_stream| instead of the
+  // request buffer. The stream is not owned by this class.
+  void set_request_stream(RequestBodyStream* request_stream) {
+    request_stream_ = request_stream;
+  }
+
   virtual void set_proxy_configuration(const ProxyConfig& proxy_config) {
     proxy_config_ = proxy_config;
   }
@@ -94,6 +115,10 @@ class SimpleRequest : public HttpRequestInterface {
     callback_ = callback;
   }
 
+  virtual void set_pacer(NetworkRequestPacer* pacer) {
+    pacer_ = pacer;
+  }
+
   virtual void set_additional_headers(const CString& additional_headers) {
     additional_headers_ = additional_headers;
   }
@@ -116,6 +141,7 @@ class SimpleRequest : public HttpRequestInterface {
   HRESULT PrepareRequest(HANDLE* file_handle);
   HRESULT Connect();
   HRESULT SendRequest();
+  HRESULT WriteRequestStream();
   HRESULT ReceiveData(HANDLE file_handle);
   HRESULT RequestData(HANDLE file_handle);
   bool IsResumeNeeded() const;
@@ -132,8 +158,10 @@ class SimpleRequest : public HttpRequestInterface {
   static uint32 ChooseProxyAuthScheme(uint32 supported_schemes);
 
   // Returns true if the request is a POST request, in other words, if there
-  // is a request buffer to be sent to the server.
-  bool IsPostRequest() const { return request_buffer_ != NULL; }
+  // is a request buffer or a request stream to be sent to the server.
+  bool IsPostRequest() const {
+    return request_buffer_ != NULL || request_stream_ != NULL;
+  }
 
   // When in pause state, caller will be blocked until Resume() is called.
   // Returns immediately otherwise.
@@ -175,15 +203,20 @@ class SimpleRequest : public HttpRequestInterface {
   CString filename_;
   const void* request_buffer_;          // Contains the request body for POST.
   size_t      request_buffer_length_;   // Length of the request body.
+  RequestBodyStream* request_stream_;   // Not owned by this class.
   CString additional_headers_;
   CString user_agent_;
   ProxyAuthConfig proxy_auth_config_;
   ProxyConfig proxy_config_;
   bool low_priority_;
   NetworkRequestCallback* callback_;
+  NetworkRequestPacer* pacer_;
   std::unique_ptr<WinHttpAdapter> winhttp_adapter_;
   std::unique_ptr<TransientRequestState> request_state_;
   scoped_event event_resume_;
+
+  // Signaled by Cancel() to end the waits of the pacer.
+  scoped_event event_cancel_;
   bool download_completed_;
   int resend_count_;
 
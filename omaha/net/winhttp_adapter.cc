@@ -19,16 +19,20 @@
 #include "omaha/base/error.h"
 #include "omaha/base/logging.h"
 #include "omaha/base/safe_format.h"
+#include "omaha/net/connection_pool.h"
 
 namespace omaha {
 
 WinHttpAdapter::WinHttpAdapter()
-    : connection_handle_(NULL),
+    : session_handle_(NULL),
+      connection_handle_(NULL),
       request_handle_(NULL),
+      connection_port_(0),
       async_call_type_(0),
       async_call_is_error_(0),
       async_bytes_available_(0),
       async_bytes_read_(0),
+      async_bytes_written_(0),
       secure_status_flag_(0) {
   memset(&async_call_result_, 0, sizeof(async_call_result_));
   NET_LOG(L3, (_T("[WinHttpAdapter::WinHttpAdapter][0x%p]"), this));
@@ -71,7 +75,12 @@ void WinHttpAdapter::CloseHandles() {
     request_handle_ = NULL;
   }
   if (connection_handle_) {
-    VERIFY_SUCCEEDED(http_client_->Close(connection_handle_));
+    if (!ConnectionPool::Instance().Release(session_handle_,
+                                            connection_server_,
+                                            connection_port_,
+                                            connection_handle_)) {
+      VERIFY_SUCCEEDED(http_client_->Close(connection_handle_));
+    }
     connection_handle_ = NULL;
   }
 }
@@ -81,6 +90,20 @@ HRESULT WinHttpAdapter::Connect(HINTERNET session_handle,
                                 int port) {
   __mutexScope(lock_);
 
+  ASSERT1(!connection_handle_);
+  session_handle_ = session_handle;
+  connection_server_ = server;
+  connection_port_ = port;
+
+  if (ConnectionPool::Instance().Acquire(session_handle,
+                                         connection_server_,
+                                         connection_port_,
+                                         &connection_handle_)) {
+    NET_LOG(L3, (_T("[WinHttpAdapter::Connect][0x%p][0x%x][pooled]"),
+                this, connection_handle_));
+    return S_OK;
+  }
+
   HRESULT hr = http_client_->Connect(session_handle,
                                      server,
                                      port,
@@ -296,6 +319,37 @@ HRESULT WinHttpAdapter::ReadData(void* buffer,
   return S_OK;
 }
 
+HRESULT WinHttpAdapter::WriteData(const void* buffer,
+                                  DWORD bytes_to_write,
+                                  DWORD* bytes_written) {
+  HRESULT hr = AsyncCallBegin(API_WRITE_DATA);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  async_bytes_written_ = 0;
+
+  __mutexBlock(lock_) {
+    hr = http_client_->WriteData(request_handle_,
+                                 buffer,
+                                 bytes_to_write,
+                                 NULL);
+  }
+
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = AsyncCallEnd(API_WRITE_DATA);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  *bytes_written = async_bytes_written_;
+
+  return S_OK;
+}
+
 HRESULT WinHttpAdapter::SetRequestOptionInt(uint32 option, int value) {
   __mutexScope(lock_);
 
@@ -386,6 +440,10 @@ void WinHttpAdapter::StatusCallback(HINTERNET handle,
 
     case WINHTTP_CALLBACK_STATUS_WRITE_COMPLETE:
       ASSERT1(async_call_type_ == API_WRITE_DATA);
+
+      ASSERT1(info_len == sizeof(async_bytes_written_));
+      ASSERT1(info);
+      async_bytes_written_ = *reinterpret_cast<DWORD*>(info);
       break;
 
     case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR:
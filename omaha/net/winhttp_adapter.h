@@ -51,6 +51,7 @@ class WinHttpAdapter {
 
   HRESULT Initialize();
 
+  // Reuses an idle connection from the ConnectionPool if there is one.
   HRESULT Connect(HINTERNET session_handle, const TCHAR* server, int port);
 
   HRESULT OpenRequest(const TCHAR* verb,
@@ -95,12 +96,20 @@ class WinHttpAdapter {
 
   HRESULT ReadData(void* buffer, DWORD buffer_length, DWORD* bytes_read);
 
+  // Writes a part of the request body after SendRequest, when the body is
+  // sent in parts instead of with the SendRequest call.
+  HRESULT WriteData(const void* buffer,
+                    DWORD bytes_to_write,
+                    DWORD* bytes_written);
+
   HRESULT SetRequestOptionInt(uint32 option, int value);
 
   HRESULT SetRequestOption(uint32 option,
                            const void* buffer,
                            DWORD buffer_length);
 
+  // Closes the request handle and returns the connection handle to the
+  // ConnectionPool.
   void CloseHandles();
 
   HRESULT CrackUrl(const TCHAR* url,
@@ -138,9 +147,15 @@ class WinHttpAdapter {
 
   std::unique_ptr<HttpClient> http_client_;
 
+  HINTERNET              session_handle_;
   HINTERNET              connection_handle_;
   HINTERNET              request_handle_;
 
+  // The server and port of the connection, which key the connection in the
+  // ConnectionPool.
+  CString                connection_server_;
+  int                    connection_port_;
+
   CString                server_name_;
   CString                server_ip_;
 
@@ -149,6 +164,7 @@ class WinHttpAdapter {
   WINHTTP_ASYNC_RESULT   async_call_result_;
   DWORD                  async_bytes_available_;
   DWORD                  async_bytes_read_;
+  DWORD                  async_bytes_written_;
   scoped_event           async_completion_event_;
   scoped_event           async_handle_closing_event_;
   DWORD                  secure_status_flag_;
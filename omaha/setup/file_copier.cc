@@ -0,0 +1,197 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/setup/file_copier.h"
+
+#include <algorithm>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/file.h"
+#include "omaha/base/file_copy.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/logging.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/utils.h"
+
+namespace omaha {
+
+namespace {
+
+// The state shared by the threads which process the files.
+struct ForEachFileContext {
+  void (*function)(void*, size_t);
+  void* data;
+  size_t count;
+  volatile LONG next_index;
+};
+
+DWORD WINAPI ForEachFileThreadProc(void* param) {
+  ForEachFileContext* context = static_cast<ForEachFileContext*>(param);
+  for (;;) {
+    const size_t index =
+        static_cast<size_t>(::InterlockedIncrement(&context->next_index) - 1);
+    if (index >= context->count) {
+      return 0;
+    }
+    context->function(context->data, index);
+  }
+}
+
+}  // namespace
+
+FileCopier::FileCopier(int max_threads)
+    : max_threads_(max_threads),
+      source_file_paths_(NULL),
+      destination_file_paths_(NULL),
+      copy_ms_(0),
+      verify_ms_(0),
+      bytes_copied_(0) {
+  ASSERT1(max_threads > 0);
+}
+
+FileCopier::~FileCopier() {
+}
+
+HRESULT FileCopier::CopyFiles(
+    const std::vector<CString>& source_file_paths,
+    const std::vector<CString>& destination_file_paths,
+    size_t* failed_index) {
+  ASSERT1(source_file_paths.size() == destination_file_paths.size());
+  ASSERT1(failed_index);
+
+  source_file_paths_ = &source_file_paths;
+  destination_file_paths_ = &destination_file_paths;
+  results_.clear();
+  results_.resize(source_file_paths.size());
+  bytes_copied_ = 0;
+
+  HighresTimer copy_timer;
+  ForEachFile(results_.size(), &FileCopier::CopyFileAt, this);
+  copy_ms_ = static_cast<int>(copy_timer.GetElapsedMs());
+
+  // Only the files which have been copied are verified.
+  HighresTimer verify_timer;
+  ForEachFile(results_.size(), &FileCopier::VerifyFileAt, this);
+  verify_ms_ = static_cast<int>(verify_timer.GetElapsedMs());
+
+  SETUP_LOG(L2, (_T("[FileCopier::CopyFiles][%Iu files][%llu bytes]")
+                 _T("[copy %d ms][verify %d ms]"),
+                 results_.size(), bytes_copied_, copy_ms_, verify_ms_));
+
+  HRESULT hr = S_OK;
+  for (size_t i = 0; i != results_.size(); ++i) {
+    if (FAILED(results_[i].hr)) {
+      *failed_index = i;
+      hr = results_[i].hr;
+      break;
+    }
+  }
+
+  source_file_paths_ = NULL;
+  destination_file_paths_ = NULL;
+  results_.clear();
+  return hr;
+}
+
+// static
+HRESULT FileCopier::SaveFileForRollback(const TCHAR* file_path,
+                                        const TCHAR* saved_file_path) {
+  ASSERT1(file_path);
+  ASSERT1(saved_file_path);
+
+  // The file is replaced by a rename when it is installed again, therefore a
+  // hard link keeps the data of the previous file.
+  VERIFY_SUCCEEDED(File::Remove(saved_file_path));
+  if (::CreateHardLink(saved_file_path, file_path, NULL)) {
+    SETUP_LOG(L3, (_T("[saved as hard link][%s][%s]"),
+                   file_path, saved_file_path));
+    return S_OK;
+  }
+
+  SETUP_LOG(L3, (_T("[CreateHardLink failed][%s][0x%08x]"),
+                 saved_file_path, HRESULTFromLastError()));
+  return File::Copy(file_path, saved_file_path, true);
+}
+
+void FileCopier::ForEachFile(size_t count,
+                             void (*function)(void*, size_t),
+                             void* data) {
+  ForEachFileContext context = {function, data, count, 0};
+
+  // The calling thread processes files too. If a thread can't be created, the
+  // other threads process its share of the files.
+  const size_t num_threads =
+      std::min(static_cast<size_t>(max_threads_), count);
+  std::vector<HANDLE> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    HANDLE thread = ::CreateThread(NULL, 0, ForEachFileThreadProc, &context,
+                                   0, NULL);
+    if (!thread) {
+      SETUP_LOG(LW, (_T("[CreateThread failed][0x%08x]"),
+                     HRESULTFromLastError()));
+      break;
+    }
+    threads.push_back(thread);
+  }
+
+  ForEachFileThreadProc(&context);
+
+  for (size_t i = 0; i != threads.size(); ++i) {
+    VERIFY1(::WaitForSingleObject(threads[i], INFINITE) == WAIT_OBJECT_0);
+    VERIFY1(::CloseHandle(threads[i]));
+  }
+}
+
+// static
+void FileCopier::CopyFileAt(void* data, size_t index) {
+  FileCopier* copier = static_cast<FileCopier*>(data);
+  FileResult& result = copier->results_[index];
+
+  result.hr = CopyFileAndHash((*copier->source_file_paths_)[index],
+                              (*copier->destination_file_paths_)[index],
+                              &result.hash);
+  if (SUCCEEDED(result.hr)) {
+    uint64 file_size = 0;
+    VERIFY_SUCCEEDED(File::GetFileSizeUnopen64(
+        (*copier->destination_file_paths_)[index], &file_size));
+    ::InterlockedExchangeAdd64(
+        reinterpret_cast<volatile LONGLONG*>(&copier->bytes_copied_),
+        static_cast<LONGLONG>(file_size));
+  }
+}
+
+// static
+void FileCopier::VerifyFileAt(void* data, size_t index) {
+  FileCopier* copier = static_cast<FileCopier*>(data);
+  FileResult& result = copier->results_[index];
+  if (FAILED(result.hr)) {
+    return;
+  }
+
+  const CString& destination_file_path =
+      (*copier->destination_file_paths_)[index];
+  CryptoHash crypto_hash;
+  if (SUCCEEDED(crypto_hash.Validate(destination_file_path, 0, result.hash))) {
+    return;
+  }
+
+  SETUP_LOG(LE, (_T("[post-copy verification failed][%s]"),
+                 destination_file_path));
+  result.hr = GOOPDATE_E_POST_COPY_VERIFICATION_FAILED;
+  VERIFY_SUCCEEDED(File::Remove(destination_file_path));
+}
+
+}  // namespace omaha
@@ -0,0 +1,86 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// FileCopier copies the install files of Setup on a few threads with
+// CopyFileAndHash. Each file is read once, sequentially, and hashed while it
+// is copied. The copies are verified by hashing the destination files, which
+// are read from the disk since they were not written through the cache.
+
+#ifndef OMAHA_SETUP_FILE_COPIER_H_
+#define OMAHA_SETUP_FILE_COPIER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+
+namespace omaha {
+
+class FileCopier {
+ public:
+  explicit FileCopier(int max_threads);
+  ~FileCopier();
+
+  // Copies each source file to the destination file at the same index and
+  // verifies the copies. If a file can't be copied or verified, returns the
+  // error and the index of the first such file in |failed_index|. The
+  // destination files which failed verification are deleted.
+  HRESULT CopyFiles(const std::vector<CString>& source_file_paths,
+                    const std::vector<CString>& destination_file_paths,
+                    size_t* failed_index);
+
+  // Saves a copy of |file_path| in |saved_file_path|, which is on the same
+  // volume if possible. The copy is a hard link if the volume supports them.
+  static HRESULT SaveFileForRollback(const TCHAR* file_path,
+                                     const TCHAR* saved_file_path);
+
+  // Wall-clock time of the last call to CopyFiles for each phase.
+  int copy_ms() const { return copy_ms_; }
+  int verify_ms() const { return verify_ms_; }
+
+  uint64 bytes_copied() const { return bytes_copied_; }
+
+ private:
+  struct FileResult {
+    FileResult() : hr(S_OK) {}
+
+    HRESULT hr;
+    std::vector<byte> hash;
+  };
+
+  // Calls |function| for each index up to |count| on up to |max_threads_|
+  // threads.
+  void ForEachFile(size_t count, void (*function)(void*, size_t), void* data);
+
+  static void CopyFileAt(void* data, size_t index);
+  static void VerifyFileAt(void* data, size_t index);
+
+  const int max_threads_;
+
+  const std::vector<CString>* source_file_paths_;
+  const std::vector<CString>* destination_file_paths_;
+  std::vector<FileResult> results_;
+
+  int copy_ms_;
+  int verify_ms_;
+  uint64 bytes_copied_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileCopier);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_SETUP_FILE_COPIER_H_
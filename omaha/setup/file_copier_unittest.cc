@@ -0,0 +1,137 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/setup/file_copier.h"
+
+#include <vector>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/file_copy.h"
+#include "omaha/base/path.h"
+#include "omaha/base/signatures.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+class FileCopierTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    test_dir_ = ConcatenatePath(app_util::GetTempDir(), _T("FileCopierTest"));
+    DeleteDirectory(test_dir_);
+    ASSERT_SUCCEEDED(CreateDir(test_dir_, NULL));
+  }
+
+  virtual void TearDown() {
+    EXPECT_SUCCEEDED(DeleteDirectory(test_dir_));
+  }
+
+  // Creates the file |name| in the test directory and returns its path.
+  CString CreateTestFile(const TCHAR* name, uint32 size, int seed) {
+    const CString file_path(ConcatenatePath(test_dir_, name));
+    CreatePatternFile(file_path, size, seed);
+    return file_path;
+  }
+
+  CString test_dir_;
+};
+
+TEST_F(FileCopierTest, CopyFiles) {
+  std::vector<CString> sources;
+  std::vector<CString> destinations;
+  for (int i = 0; i != 10; ++i) {
+    CString name;
+    name.Format(_T("file%d"), i);
+    sources.push_back(CreateTestFile(name, 10000 * i, i));
+    destinations.push_back(ConcatenatePath(test_dir_, name + _T(".copy")));
+  }
+
+  // An existing destination file is replaced.
+  CreateTestFile(_T("file3.copy"), 10, 0);
+
+  FileCopier file_copier(3);
+  size_t failed_index = 0;
+  EXPECT_SUCCEEDED(file_copier.CopyFiles(sources, destinations,
+                                         &failed_index));
+  for (size_t i = 0; i != sources.size(); ++i) {
+    EXPECT_TRUE(File::AreFilesIdentical(sources[i], destinations[i]));
+  }
+  EXPECT_EQ(450000, file_copier.bytes_copied());
+}
+
+TEST_F(FileCopierTest, CopyFiles_Failure) {
+  std::vector<CString> sources;
+  std::vector<CString> destinations;
+  sources.push_back(CreateTestFile(_T("file0"), 100, 0));
+  destinations.push_back(ConcatenatePath(test_dir_, _T("file0.copy")));
+  sources.push_back(ConcatenatePath(test_dir_, _T("none")));
+  destinations.push_back(ConcatenatePath(test_dir_, _T("none.copy")));
+
+  FileCopier file_copier(2);
+  size_t failed_index = 0;
+  EXPECT_EQ(HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND),
+            file_copier.CopyFiles(sources, destinations, &failed_index));
+  EXPECT_EQ(1, failed_index);
+  EXPECT_TRUE(File::AreFilesIdentical(sources[0], destinations[0]));
+}
+
+TEST_F(FileCopierTest, SaveFileForRollback) {
+  const CString installed(CreateTestFile(_T("installed"), 5000, 1));
+  const CString original(CreateTestFile(_T("original"), 5000, 1));
+  const CString saved(ConcatenatePath(test_dir_, _T("saved")));
+
+  EXPECT_SUCCEEDED(FileCopier::SaveFileForRollback(installed, saved));
+  EXPECT_TRUE(File::AreFilesIdentical(installed, saved));
+
+  // Installing a new file does not change the saved file.
+  const CString source(CreateTestFile(_T("source"), 6000, 2));
+  std::vector<byte> hash;
+  EXPECT_SUCCEEDED(CopyFileAndHash(source, installed, &hash));
+  EXPECT_TRUE(File::AreFilesIdentical(source, installed));
+  EXPECT_TRUE(File::AreFilesIdentical(original, saved));
+}
+
+// Installs the language files of this build in an empty directory.
+TEST_F(FileCopierTest, CopyFiles_LanguageFiles) {
+  const CString source_dir(app_util::GetCurrentModuleDirectory());
+  std::vector<CString> file_names;
+  ASSERT_SUCCEEDED(FindFiles(source_dir, _T("goopdateres_*.dll"),
+                             &file_names));
+  ASSERT_FALSE(file_names.empty());
+
+  std::vector<CString> sources;
+  std::vector<CString> destinations;
+  for (size_t i = 0; i != file_names.size(); ++i) {
+    sources.push_back(ConcatenatePath(source_dir, file_names[i]));
+    destinations.push_back(ConcatenatePath(test_dir_, file_names[i]));
+  }
+
+  FileCopier file_copier(4);
+  size_t failed_index = 0;
+  EXPECT_SUCCEEDED(file_copier.CopyFiles(sources, destinations,
+                                         &failed_index));
+
+  uint64 bytes = 0;
+  for (size_t i = 0; i != sources.size(); ++i) {
+    EXPECT_TRUE(File::AreFilesIdentical(sources[i], destinations[i]));
+    uint64 file_size = 0;
+    EXPECT_SUCCEEDED(File::GetFileSizeUnopen64(sources[i], &file_size));
+    bytes += file_size;
+  }
+  EXPECT_EQ(bytes, file_copier.bytes_copied());
+}
+
+}  // namespace omaha
@@ -36,6 +36,7 @@
 #include "omaha/common/const_goopdate.h"
 #include "omaha/common/goopdate_utils.h"
 #include "omaha/goopdate/resource_manager.h"
+#include "omaha/setup/file_copier.h"
 #include "omaha/setup/setup_metrics.h"
 #include "omaha/third_party/smartany/scoped_any.h"
 
@@ -46,6 +47,11 @@ namespace {
 const int kNumberOfCreateServiceRetries = 5;
 const int kSleepBetweenCreateServiceRetryMs = 200;
 
+// The files are compared and copied with a few threads, since most of the
+// time is spent waiting for the disk.
+const int kMaxCompareThreads = 4;
+const int kMaxCopyThreads = 4;
+
 }  // namespace
 
 SetupFiles::SetupFiles(bool is_machine)
@@ -279,10 +285,12 @@ HRESULT SetupFiles::SaveShellForRollback(const CString& shell_install_path) {
     return HRESULT_FROM_WIN32(error);
   }
 
-  HRESULT hr = File::Copy(shell_install_path, temp_file, true);
+  HighresTimer save_timer;
+  HRESULT hr = FileCopier::SaveFileForRollback(shell_install_path, temp_file);
   if (FAILED(hr)) {
     return hr;
   }
+  metric_setup_files_save_shell_ms.AddSample(save_timer.GetElapsedMs());
 
   saved_shell_path_ = temp_file;
   return S_OK;
@@ -423,40 +431,82 @@ HRESULT SetupFiles::CopyAndValidateFiles(
     }
   }
 
+  HighresTimer compare_timer;
+
+  // The destination files which already exist are compared with the source
+  // files in parallel. The files which are identical are not copied, and do
+  // not need to be verified after the copy.
+  //
+  // TODO(omaha): Reevaluate the value -- or at least, the naming -- of the
+  // overwrite flag.  As it stands, it's largely a debugging tool to force
+  // calls to File::Copy when it's not technically needed.
+  std::vector<bool> is_up_to_date(source_file_paths.size(), false);
+  if (!overwrite) {
+    std::vector<size_t> existing_indexes;
+    std::vector<CString> existing_source_paths;
+    std::vector<CString> existing_destination_paths;
+    for (size_t i = 0; i != destination_file_paths.size(); ++i) {
+      if (File::Exists(destination_file_paths[i])) {
+        existing_indexes.push_back(i);
+        existing_source_paths.push_back(source_file_paths[i]);
+        existing_destination_paths.push_back(destination_file_paths[i]);
+      }
+    }
+
+    std::vector<bool> are_identical;
+    File::AreFilesIdentical(existing_source_paths,
+                            existing_destination_paths,
+                            kMaxCompareThreads,
+                            &are_identical);
+    for (size_t i = 0; i != existing_indexes.size(); ++i) {
+      is_up_to_date[existing_indexes[i]] = are_identical[i];
+    }
+  }
+
+  std::vector<CString> copied_source_paths;
+  std::vector<CString> copied_destination_paths;
+  std::vector<size_t> copied_indexes;
   for (size_t i = 0; i != source_file_paths.size(); ++i) {
-    const CString& source_file = source_file_paths[i];
-    const CString& destination_file = destination_file_paths[i];
     SETUP_LOG(L2, (_T("[CopyAndValidateFiles][from=%s][to=%s][overwrite=%d]")
-        _T("[destination file exists=%d]"), source_file, destination_file,
-        overwrite, File::Exists(destination_file)));
-
-    // 1-based; reserves 0 for success or not set.
-    extra_code1_ = static_cast<int>(i + 1);
-
-    // TODO(omaha): Reevaluate the value -- or at least, the naming -- of the
-    // overwrite flag.  As it stands, it's largely a debugging tool to force
-    // calls to File::Copy when it's not technically needed.
-    if (overwrite ||
-        !File::Exists(destination_file) ||
-        !File::AreFilesIdentical(source_file, destination_file)) {
-      HRESULT hr = File::Copy(source_file, destination_file, true);
-      if (FAILED(hr)) {
-        OPT_LOG(LE, (_T("[copy failed][from=%s][to=%s][0x%08x]"),
-                     source_file, destination_file, hr));
-        return hr;
-      }
+        _T("[up to date=%d]"), source_file_paths[i], destination_file_paths[i],
+        overwrite, is_up_to_date[i]));
+    if (!is_up_to_date[i]) {
+      copied_indexes.push_back(i);
+      copied_source_paths.push_back(source_file_paths[i]);
+      copied_destination_paths.push_back(destination_file_paths[i]);
     }
+  }
+  metric_setup_files_compare_ms.AddSample(compare_timer.GetElapsedMs());
+
+  if (copied_indexes.empty()) {
+    extra_code1_ = 0;
+    return S_OK;
+  }
 
-    HRESULT hr = File::AreFilesIdentical(source_file, destination_file) ?
-                     S_OK : GOOPDATE_E_POST_COPY_VERIFICATION_FAILED;
+  // The files are verified against the hashes computed while copying them.
+  FileCopier file_copier(kMaxCopyThreads);
+  size_t failed_index = 0;
+  HRESULT hr = file_copier.CopyFiles(copied_source_paths,
+                                     copied_destination_paths,
+                                     &failed_index);
+  metric_setup_files_copy_ms.AddSample(file_copier.copy_ms());
+  metric_setup_files_verify_ms.AddSample(file_copier.verify_ms());
 
-    if (FAILED(hr)) {
+  if (FAILED(hr)) {
+    // 1-based; reserves 0 for success or not set.
+    extra_code1_ = static_cast<int>(copied_indexes[failed_index] + 1);
+
+    if (hr == GOOPDATE_E_POST_COPY_VERIFICATION_FAILED) {
       OPT_LOG(LE, (_T("[postcopy verification failed][from=%s][to=%s][0x%x]"),
-                   source_file, destination_file, hr));
+                   copied_source_paths[failed_index],
+                   copied_destination_paths[failed_index], hr));
       ++metric_setup_files_verification_failed_post;
-      VERIFY_SUCCEEDED(File::Remove(destination_file));
-      return hr;
+    } else {
+      OPT_LOG(LE, (_T("[copy failed][from=%s][to=%s][0x%08x]"),
+                   copied_source_paths[failed_index],
+                   copied_destination_paths[failed_index], hr));
     }
+    return hr;
   }
 
   extra_code1_ = 0;
@@ -324,6 +324,15 @@ class SetupFilesTest : public testing::Test {
     EXPECT_SUCCEEDED(DeleteDirectory(version_path));
   }
 
+  HRESULT CopyAndValidateFiles(
+      const std::vector<CString>& source_file_paths,
+      const std::vector<CString>& destination_file_paths,
+      bool overwrite) {
+    return setup_files_->CopyAndValidateFiles(source_file_paths,
+                                              destination_file_paths,
+                                              overwrite);
+  }
+
   HRESULT ShouldCopyShell(const CString& shell_install_path,
                           bool* should_copy,
                           bool* already_exists) const {
@@ -536,4 +545,52 @@ TEST_F(SetupFilesUserTest, ShouldCopyShell_NoExistingFile) {
   EXPECT_FALSE(already_exists);
 }
 
+// Copies the language files of this build to a directory, then copies them
+// again when they are up to date, which is what a self-update over the same
+// version does.
+TEST_F(SetupFilesUserTest, CopyAndValidateFiles_FilesUpToDate) {
+  const CString source_dir(app_util::GetCurrentModuleDirectory());
+  const CString destination_dir(
+      ConcatenatePath(app_util::GetTempDir(), _T("SetupFilesTest")));
+  DeleteDirectory(destination_dir);
+  ASSERT_SUCCEEDED(CreateDir(destination_dir, NULL));
+
+  std::vector<CString> file_names;
+  ASSERT_SUCCEEDED(FindFiles(source_dir, _T("goopdateres_*.dll"),
+                             &file_names));
+  ASSERT_EQ(kNumberOfLanguageDlls, file_names.size());
+
+  std::vector<CString> source_file_paths;
+  std::vector<CString> destination_file_paths;
+  for (size_t i = 0; i != file_names.size(); ++i) {
+    source_file_paths.push_back(ConcatenatePath(source_dir, file_names[i]));
+    destination_file_paths.push_back(
+        ConcatenatePath(destination_dir, file_names[i]));
+  }
+
+  EXPECT_SUCCEEDED(CopyAndValidateFiles(source_file_paths,
+                                        destination_file_paths,
+                                        false));
+  EXPECT_SUCCEEDED(CopyAndValidateFiles(source_file_paths,
+                                        destination_file_paths,
+                                        false));
+  EXPECT_EQ(0, setup_files_->extra_code1());
+
+  // A modified file is copied again.
+  const byte kData[] = {'x'};
+  File file;
+  ASSERT_SUCCEEDED(file.Open(destination_file_paths[3], true, false));
+  ASSERT_SUCCEEDED(file.WriteAt64(0, kData, sizeof(kData), NULL));
+  ASSERT_SUCCEEDED(file.Close());
+  EXPECT_FALSE(File::AreFilesIdentical(source_file_paths[3],
+                                       destination_file_paths[3]));
+  EXPECT_SUCCEEDED(CopyAndValidateFiles(source_file_paths,
+                                        destination_file_paths,
+                                        false));
+  EXPECT_TRUE(File::AreFilesIdentical(source_file_paths[3],
+                                      destination_file_paths[3]));
+
+  EXPECT_SUCCEEDED(DeleteDirectory(destination_dir));
+}
+
 }  // namespace omaha
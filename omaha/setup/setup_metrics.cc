@@ -45,6 +45,10 @@ DEFINE_METRIC_count(setup_files_verification_succeeded);
 DEFINE_METRIC_count(setup_files_verification_failed_post);
 
 DEFINE_METRIC_timing(setup_files_ms);
+DEFINE_METRIC_timing(setup_files_compare_ms);
+DEFINE_METRIC_timing(setup_files_copy_ms);
+DEFINE_METRIC_timing(setup_files_verify_ms);
+DEFINE_METRIC_timing(setup_files_save_shell_ms);
 
 DEFINE_METRIC_count(setup_files_replace_shell);
 
@@ -91,6 +91,14 @@ DECLARE_METRIC_count(setup_files_verification_failed_post);
 
 // Total time (ms) spent installing files.
 DECLARE_METRIC_timing(setup_files_ms);
+// Time (ms) spent comparing the existing files with the files to install.
+DECLARE_METRIC_timing(setup_files_compare_ms);
+// Time (ms) spent copying the files which are not up to date.
+DECLARE_METRIC_timing(setup_files_copy_ms);
+// Time (ms) spent verifying the copied files.
+DECLARE_METRIC_timing(setup_files_verify_ms);
+// Time (ms) spent saving the shell for roll back.
+DECLARE_METRIC_timing(setup_files_save_shell_ms);
 
 // How many times the shell was replaced.
 DECLARE_METRIC_count(setup_files_replace_shell);
@@ -0,0 +1,395 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/testing/benchmark.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+
+#include "omaha/base/app_util.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/path.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+
+namespace omaha {
+
+namespace benchmark {
+
+namespace {
+
+// The calibration stops growing the number of iterations once a run takes
+// this fraction of the minimum time, then extrapolates.
+const double kCalibrationFraction = 0.1;
+const int64 kMaxIterations = 1000000000;
+
+const TCHAR kRegistryOverrideKey[] =
+    _T("HKCU\\Software\\") PATH_COMPANY_NAME _T("\\") PRODUCT_NAME
+    _T("\\Benchmarks\\");
+
+typedef std::map<CString, BenchmarkFunction> Benchmarks;
+
+Benchmarks& GetBenchmarks() {
+  static Benchmarks benchmarks;
+  return benchmarks;
+}
+
+double TicksToNs(ULONGLONG ticks) {
+  return static_cast<double>(ticks) * 1e9 / HighresTimer::GetTimerFrequency();
+}
+
+CStringA EscapeJsonString(const CString& value) {
+  const CStringA utf8_value(WideToUtf8(value));
+  CStringA escaped;
+  for (int i = 0; i != utf8_value.GetLength(); ++i) {
+    const char c = utf8_value[i];
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+      escaped += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      SafeCStringAAppendFormat(&escaped, "\\u%04x", c);
+    } else {
+      escaped += c;
+    }
+  }
+  return escaped;
+}
+
+// Finds the string value of |key| in |line|. The string must not contain
+// \u escapes, which ResultsToJson only writes for control characters.
+bool FindJsonString(const CStringA& line, const char* key, CString* value) {
+  ASSERT1(key);
+  ASSERT1(value);
+
+  CStringA pattern;
+  SafeCStringAFormat(&pattern, "\"%s\": \"", key);
+  const int begin = line.Find(pattern);
+  if (begin == -1) {
+    return false;
+  }
+
+  CStringA utf8_value;
+  for (int i = begin + pattern.GetLength(); i < line.GetLength(); ++i) {
+    if (line[i] == '"') {
+      *value = Utf8ToWideChar(utf8_value.GetString(), utf8_value.GetLength());
+      return true;
+    }
+    if (line[i] == '\\' && ++i == line.GetLength()) {
+      break;
+    }
+    utf8_value += line[i];
+  }
+  return false;
+}
+
+bool FindJsonNumber(const CStringA& line, const char* key, double* value) {
+  ASSERT1(key);
+  ASSERT1(value);
+
+  CStringA pattern;
+  SafeCStringAFormat(&pattern, "\"%s\": ", key);
+  const int begin = line.Find(pattern);
+  if (begin == -1) {
+    return false;
+  }
+  *value = atof(line.GetString() + begin + pattern.GetLength());
+  return true;
+}
+
+}  // namespace
+
+State::State(int64 max_iterations)
+    : max_iterations_(max_iterations),
+      iterations_(0),
+      bytes_per_iteration_(0),
+      is_started_(false),
+      elapsed_ticks_(0),
+      sink_(0) {
+  ASSERT1(max_iterations_ > 0);
+}
+
+bool State::KeepRunning() {
+  if (!is_started_) {
+    is_started_ = true;
+    timer_.Start();
+  }
+  if (error_.IsEmpty() && iterations_ < max_iterations_) {
+    ++iterations_;
+    return true;
+  }
+  elapsed_ticks_ = timer_.GetElapsedTicks();
+  return false;
+}
+
+void State::SkipWithError(const CString& error) {
+  ASSERT1(!error.IsEmpty());
+  error_ = error;
+}
+
+Registrar::Registrar(const TCHAR* name, BenchmarkFunction function) {
+  ASSERT1(name);
+  ASSERT1(function);
+  ASSERT1(GetBenchmarks().find(name) == GetBenchmarks().end());
+  GetBenchmarks()[name] = function;
+}
+
+CString GetSupportFilePath(const TCHAR* file_name) {
+  ASSERT1(file_name);
+  return ConcatenatePath(ConcatenatePath(app_util::GetCurrentModuleDirectory(),
+                                         _T("unittest_support")),
+                         file_name);
+}
+
+ScopedRegistryOverride::ScopedRegistryOverride() : is_overridden_(false) {
+}
+
+ScopedRegistryOverride::~ScopedRegistryOverride() {
+  if (is_overridden_) {
+    ::RegOverridePredefKey(HKEY_LOCAL_MACHINE, NULL);
+    ::RegOverridePredefKey(HKEY_CURRENT_USER, NULL);
+  }
+  RegKey::DeleteKey(kRegistryOverrideKey);
+}
+
+HRESULT ScopedRegistryOverride::Initialize() {
+  ASSERT1(!is_overridden_);
+
+  const CString key_name(kRegistryOverrideKey);
+  RegKey machine_key;
+  RegKey user_key;
+  HRESULT hr = machine_key.Create(key_name + MACHINE_KEY);
+  if (SUCCEEDED(hr)) {
+    hr = user_key.Create(key_name + USER_KEY);
+  }
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  LONG result = ::RegOverridePredefKey(HKEY_LOCAL_MACHINE, machine_key.Key());
+  if (result == ERROR_SUCCESS) {
+    is_overridden_ = true;
+    result = ::RegOverridePredefKey(HKEY_CURRENT_USER, user_key.Key());
+  }
+  return HRESULT_FROM_WIN32(result);
+}
+
+void RunBenchmarks(const RunOptions& options, std::vector<Result>* results) {
+  ASSERT1(results);
+
+  const Benchmarks& benchmarks = GetBenchmarks();
+  for (Benchmarks::const_iterator it = benchmarks.begin();
+       it != benchmarks.end();
+       ++it) {
+    if (it->first.Find(options.filter) != -1) {
+      results->push_back(RunBenchmark(it->first, it->second, options));
+    }
+  }
+}
+
+Result RunBenchmark(const CString& name,
+                    BenchmarkFunction function,
+                    const RunOptions& options) {
+  ASSERT1(function);
+  ASSERT1(options.min_time_ms > 0);
+  ASSERT1(options.repetitions > 0);
+
+  Result result;
+  result.name = name;
+
+  // Grows the number of iterations tenfold until a run is long enough to be
+  // measured, then scales it to the minimum time.
+  const double min_time_ns = options.min_time_ms * 1e6;
+  int64 iterations = 1;
+  for (;;) {
+    State state(iterations);
+    function(&state);
+    if (!state.error().IsEmpty()) {
+      result.error = state.error();
+      return result;
+    }
+
+    const double elapsed_ns = TicksToNs(state.elapsed_ticks());
+    if (elapsed_ns >= min_time_ns * kCalibrationFraction ||
+        iterations >= kMaxIterations / 10) {
+      const double scaled_iterations =
+          iterations * min_time_ns / std::max(elapsed_ns, 1.0);
+      iterations = static_cast<int64>(
+          std::min(std::max(scaled_iterations, 1.0),
+                   static_cast<double>(kMaxIterations)));
+      break;
+    }
+    iterations *= 10;
+  }
+
+  std::vector<double> times_ns;
+  int64 bytes_per_iteration = 0;
+  CString label;
+  for (int i = 0; i != options.repetitions; ++i) {
+    State state(iterations);
+    function(&state);
+    if (!state.error().IsEmpty()) {
+      result.error = state.error();
+      return result;
+    }
+    times_ns.push_back(TicksToNs(state.elapsed_ticks()) / state.iterations());
+    bytes_per_iteration = state.bytes_per_iteration();
+    label = state.label();
+  }
+
+  std::sort(times_ns.begin(), times_ns.end());
+  result.iterations = iterations;
+  result.median_ns = times_ns[times_ns.size() / 2];
+  result.min_ns = times_ns.front();
+  result.label = label;
+  if (bytes_per_iteration && result.median_ns > 0) {
+    result.bytes_per_second = bytes_per_iteration * 1e9 / result.median_ns;
+  }
+  return result;
+}
+
+CStringA ResultsToJson(const std::vector<Result>& results) {
+  SYSTEM_INFO system_info = {};
+  ::GetSystemInfo(&system_info);
+  SYSTEMTIME now = {};
+  ::GetSystemTime(&now);
+
+  CStringA json;
+  SafeCStringAFormat(&json,
+                     "{\n"
+                     "  \"context\": {\"version\": \"%s\", "
+                     "\"date\": \"%04d-%02d-%02dT%02d:%02d:%02dZ\", "
+                     "\"num_cpus\": %u},\n"
+                     "  \"benchmarks\": [\n",
+                     EscapeJsonString(OMAHA_BUILD_VERSION_STRING),
+                     now.wYear, now.wMonth, now.wDay,
+                     now.wHour, now.wMinute, now.wSecond,
+                     system_info.dwNumberOfProcessors);
+
+  for (size_t i = 0; i != results.size(); ++i) {
+    const Result& result = results[i];
+    SafeCStringAAppendFormat(&json,
+                             "    {\"name\": \"%s\", ",
+                             EscapeJsonString(result.name));
+    if (result.error.IsEmpty()) {
+      SafeCStringAAppendFormat(&json,
+                               "\"iterations\": %lld, "
+                               "\"median_ns\": %.1f, \"min_ns\": %.1f, "
+                               "\"bytes_per_second\": %.0f",
+                               result.iterations,
+                               result.median_ns,
+                               result.min_ns,
+                               result.bytes_per_second);
+      if (!result.label.IsEmpty()) {
+        SafeCStringAAppendFormat(&json,
+                                 ", \"label\": \"%s\"",
+                                 EscapeJsonString(result.label));
+      }
+      json += "}";
+    } else {
+      SafeCStringAAppendFormat(&json,
+                               "\"error\": \"%s\"}",
+                               EscapeJsonString(result.error));
+    }
+    json += i + 1 == results.size() ? "\n" : ",\n";
+  }
+
+  json += "  ]\n}\n";
+  return json;
+}
+
+HRESULT ResultsFromJson(const CStringA& json, std::vector<Result>* results) {
+  ASSERT1(results);
+
+  const int benchmarks_begin = json.Find("\"benchmarks\": [");
+  if (benchmarks_begin == -1) {
+    return E_INVALIDARG;
+  }
+
+  int line_begin = benchmarks_begin;
+  for (;;) {
+    line_begin = json.Find('\n', line_begin);
+    if (line_begin == -1) {
+      return S_OK;
+    }
+    ++line_begin;
+    int line_end = json.Find('\n', line_begin);
+    if (line_end == -1) {
+      line_end = json.GetLength();
+    }
+    const CStringA line(json.Mid(line_begin, line_end - line_begin));
+
+    Result result;
+    if (!FindJsonString(line, "name", &result.name)) {
+      continue;
+    }
+    if (!FindJsonString(line, "error", &result.error)) {
+      double iterations = 0;
+      if (!FindJsonNumber(line, "iterations", &iterations) ||
+          !FindJsonNumber(line, "median_ns", &result.median_ns) ||
+          !FindJsonNumber(line, "min_ns", &result.min_ns) ||
+          !FindJsonNumber(line, "bytes_per_second",
+                          &result.bytes_per_second)) {
+        return E_INVALIDARG;
+      }
+      result.iterations = static_cast<int64>(iterations);
+      FindJsonString(line, "label", &result.label);
+    }
+    results->push_back(result);
+  }
+}
+
+void FindRegressions(const std::vector<Result>& baseline,
+                     const std::vector<Result>& results,
+                     double max_regression_percent,
+                     std::vector<CString>* regressions) {
+  ASSERT1(regressions);
+
+  std::map<CString, double> baseline_times_ns;
+  for (size_t i = 0; i != baseline.size(); ++i) {
+    if (baseline[i].error.IsEmpty() && baseline[i].median_ns > 0) {
+      baseline_times_ns[baseline[i].name] = baseline[i].median_ns;
+    }
+  }
+
+  for (size_t i = 0; i != results.size(); ++i) {
+    const Result& result = results[i];
+    std::map<CString, double>::const_iterator it =
+        baseline_times_ns.find(result.name);
+    if (!result.error.IsEmpty() || it == baseline_times_ns.end()) {
+      continue;
+    }
+
+    const double regression_percent =
+        (result.median_ns - it->second) * 100 / it->second;
+    if (regression_percent > max_regression_percent) {
+      CString regression;
+      SafeCStringFormat(&regression,
+                        _T("[%s][%.1f ns -> %.1f ns][+%.1f%%]"),
+                        result.name,
+                        it->second,
+                        result.median_ns,
+                        regression_percent);
+      regressions->push_back(regression);
+    }
+  }
+}
+
+}  // namespace benchmark
+
+}  // namespace omaha
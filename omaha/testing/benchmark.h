@@ -0,0 +1,187 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// A small benchmark framework for the hot paths of Omaha. A benchmark is a
+// function which does its setup, then loops on State::KeepRunning() around
+// the code being measured:
+//
+//   OMAHA_BENCHMARK(Sha256_1KB) {
+//     std::vector<uint8> data(1024);
+//     state->SetBytesPerIteration(data.size());
+//     while (state->KeepRunning()) {
+//       ...
+//     }
+//   }
+//
+// The runner calibrates the number of iterations so that a run takes about
+// the minimum time, then repeats the run and reports the median and the
+// minimum time per iteration. The results are written as JSON, one benchmark
+// per line, and can be compared against the results of a previous release.
+
+#ifndef OMAHA_TESTING_BENCHMARK_H_
+#define OMAHA_TESTING_BENCHMARK_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/highres_timer-win32.h"
+
+namespace omaha {
+
+namespace benchmark {
+
+class State {
+ public:
+  explicit State(int64 max_iterations);
+
+  // Returns true while the benchmark must run another iteration. The time
+  // is measured from the first call to the call which returns false.
+  bool KeepRunning();
+
+  // Reports the throughput of the benchmark in bytes per second.
+  void SetBytesPerIteration(int64 bytes) { bytes_per_iteration_ = bytes; }
+
+  // Reports |label| with the times of the benchmark, for the figures which
+  // are not times, such as the results of a simulation.
+  void SetLabel(const CString& label) { label_ = label; }
+
+  // Stops the benchmark and reports |error| instead of a time.
+  void SkipWithError(const CString& error);
+
+  // Keeps the compiler from optimizing away the computation of |value|.
+  template <typename T>
+  void DoNotOptimize(const T& value) {
+    sink_ = *reinterpret_cast<const volatile char*>(&value);
+  }
+
+  int64 iterations() const { return iterations_; }
+  int64 bytes_per_iteration() const { return bytes_per_iteration_; }
+  ULONGLONG elapsed_ticks() const { return elapsed_ticks_; }
+  const CString& label() const { return label_; }
+  const CString& error() const { return error_; }
+
+ private:
+  const int64 max_iterations_;
+  int64 iterations_;
+  int64 bytes_per_iteration_;
+  bool is_started_;
+  HighresTimer timer_;
+  ULONGLONG elapsed_ticks_;
+  CString label_;
+  CString error_;
+  volatile char sink_;
+
+  DISALLOW_COPY_AND_ASSIGN(State);
+};
+
+typedef void (*BenchmarkFunction)(State* state);
+
+// Registers a benchmark at static initialization time.
+class Registrar {
+ public:
+  Registrar(const TCHAR* name, BenchmarkFunction function);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Registrar);
+};
+
+#define OMAHA_BENCHMARK(name)                                              \
+  static void Benchmark_##name(omaha::benchmark::State* state);            \
+  static omaha::benchmark::Registrar benchmark_registrar_##name(           \
+      _T(#name), &Benchmark_##name);                                       \
+  static void Benchmark_##name(omaha::benchmark::State* state)
+
+struct Result {
+  Result() : iterations(0), median_ns(0), min_ns(0), bytes_per_second(0) {}
+
+  CString name;
+  int64 iterations;
+
+  // The times per iteration.
+  double median_ns;
+  double min_ns;
+
+  // Zero when the benchmark does not report its throughput.
+  double bytes_per_second;
+
+  // The label of the last repetition. Empty when the benchmark has no label.
+  CString label;
+
+  // Not empty when the benchmark failed, in which case there are no times.
+  CString error;
+};
+
+struct RunOptions {
+  RunOptions() : min_time_ms(200), repetitions(5) {}
+
+  // Only the benchmarks whose name contains |filter| run.
+  CString filter;
+
+  // The target duration of each repetition.
+  double min_time_ms;
+  int repetitions;
+};
+
+// Returns the path of |file_name| in the unittest_support directory, which
+// is installed next to the benchmarks.
+CString GetSupportFilePath(const TCHAR* file_name);
+
+// Overrides HKCU and HKLM with keys under the benchmarks key of HKCU, so that
+// the benchmarks can register apps without changing the registry of the
+// machine. The keys are deleted when the override is destroyed.
+class ScopedRegistryOverride {
+ public:
+  ScopedRegistryOverride();
+  ~ScopedRegistryOverride();
+
+  HRESULT Initialize();
+
+ private:
+  bool is_overridden_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedRegistryOverride);
+};
+
+// Runs the registered benchmarks, in the order of their names.
+void RunBenchmarks(const RunOptions& options, std::vector<Result>* results);
+
+// Runs a single benchmark.
+Result RunBenchmark(const CString& name,
+                    BenchmarkFunction function,
+                    const RunOptions& options);
+
+// Serializes |results| as JSON. Each benchmark is on its own line, so the
+// files diff well from one release to the next.
+CStringA ResultsToJson(const std::vector<Result>& results);
+
+// Parses the JSON written by ResultsToJson.
+HRESULT ResultsFromJson(const CStringA& json, std::vector<Result>* results);
+
+// Appends to |regressions| a line for each benchmark whose median time grew
+// by more than |max_regression_percent| compared to |baseline|. The
+// benchmarks which are missing from either side or which failed are not
+// compared.
+void FindRegressions(const std::vector<Result>& baseline,
+                     const std::vector<Result>& results,
+                     double max_regression_percent,
+                     std::vector<CString>* regressions);
+
+}  // namespace benchmark
+
+}  // namespace omaha
+
+#endif  // OMAHA_TESTING_BENCHMARK_H_
@@ -0,0 +1,144 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/testing/benchmark.h"
+
+#include <vector>
+
+#include "omaha/testing/unit_test.h"
+
+namespace omaha {
+
+namespace benchmark {
+
+namespace {
+
+int64 num_benchmark_iterations = 0;
+
+void CountIterations(State* state) {
+  state->SetBytesPerIteration(100);
+  while (state->KeepRunning()) {
+    ++num_benchmark_iterations;
+  }
+}
+
+void SetLabel(State* state) {
+  state->SetLabel(_T("a \"label\""));
+  while (state->KeepRunning()) {
+  }
+}
+
+void FailAfterSetup(State* state) {
+  state->SkipWithError(_T("no \"setup\""));
+}
+
+Result MakeResult(const TCHAR* name, double median_ns) {
+  Result result;
+  result.name = name;
+  result.iterations = 1000;
+  result.median_ns = median_ns;
+  result.min_ns = median_ns - 1;
+  return result;
+}
+
+}  // namespace
+
+TEST(BenchmarkTest, RunBenchmark) {
+  RunOptions options;
+  options.min_time_ms = 10;
+  options.repetitions = 3;
+
+  num_benchmark_iterations = 0;
+  const Result result = RunBenchmark(_T("count"), &CountIterations, options);
+  EXPECT_STREQ(_T("count"), result.name);
+  EXPECT_TRUE(result.error.IsEmpty());
+  EXPECT_LT(1, result.iterations);
+  EXPECT_LT(3 * result.iterations, num_benchmark_iterations);
+  EXPECT_LE(result.min_ns, result.median_ns);
+  EXPECT_LT(0, result.bytes_per_second);
+  EXPECT_TRUE(result.label.IsEmpty());
+
+  const Result labeled_result = RunBenchmark(_T("label"), &SetLabel, options);
+  EXPECT_STREQ(_T("a \"label\""), labeled_result.label);
+
+  const Result failed_result = RunBenchmark(_T("fail"),
+                                            &FailAfterSetup,
+                                            options);
+  EXPECT_STREQ(_T("no \"setup\""), failed_result.error);
+  EXPECT_EQ(0, failed_result.iterations);
+}
+
+TEST(BenchmarkTest, Json_RoundTrip) {
+  std::vector<Result> results;
+  results.push_back(MakeResult(_T("Fast"), 12.5));
+  results.push_back(MakeResult(_T("Slow"), 1e6));
+  results.back().bytes_per_second = 1048576;
+  results.back().label = _T("a \"quoted\" label");
+  results.push_back(Result());
+  results.back().name = _T("Failed");
+  results.back().error = _T("a \"quoted\" \\ error");
+
+  const CStringA json(ResultsToJson(results));
+  EXPECT_NE(-1, json.Find("\"context\": {\"version\": \""));
+
+  std::vector<Result> parsed_results;
+  EXPECT_SUCCEEDED(ResultsFromJson(json, &parsed_results));
+  ASSERT_EQ(results.size(), parsed_results.size());
+  for (size_t i = 0; i != results.size(); ++i) {
+    EXPECT_STREQ(results[i].name, parsed_results[i].name);
+    EXPECT_EQ(results[i].iterations, parsed_results[i].iterations);
+    EXPECT_DOUBLE_EQ(results[i].median_ns, parsed_results[i].median_ns);
+    EXPECT_DOUBLE_EQ(results[i].min_ns, parsed_results[i].min_ns);
+    EXPECT_DOUBLE_EQ(results[i].bytes_per_second,
+                     parsed_results[i].bytes_per_second);
+    EXPECT_STREQ(results[i].label, parsed_results[i].label);
+    EXPECT_STREQ(results[i].error, parsed_results[i].error);
+  }
+
+  parsed_results.clear();
+  EXPECT_EQ(E_INVALIDARG, ResultsFromJson("{}", &parsed_results));
+  EXPECT_TRUE(parsed_results.empty());
+}
+
+TEST(BenchmarkTest, FindRegressions) {
+  std::vector<Result> baseline;
+  baseline.push_back(MakeResult(_T("Faster"), 100));
+  baseline.push_back(MakeResult(_T("Slower"), 100));
+  baseline.push_back(MakeResult(_T("MuchSlower"), 100));
+  baseline.push_back(MakeResult(_T("Removed"), 100));
+  baseline.push_back(MakeResult(_T("Fixed"), 0));
+  baseline.back().error = _T("failed");
+
+  std::vector<Result> results;
+  results.push_back(MakeResult(_T("Faster"), 50));
+  results.push_back(MakeResult(_T("Slower"), 105));
+  results.push_back(MakeResult(_T("MuchSlower"), 150));
+  results.push_back(MakeResult(_T("Added"), 1000));
+  results.push_back(MakeResult(_T("Fixed"), 1000));
+
+  std::vector<CString> regressions;
+  FindRegressions(baseline, results, 10, &regressions);
+  ASSERT_EQ(1, regressions.size());
+  EXPECT_STREQ(_T("[MuchSlower][100.0 ns -> 150.0 ns][+50.0%]"),
+               regressions[0]);
+
+  regressions.clear();
+  FindRegressions(baseline, results, 0, &regressions);
+  EXPECT_EQ(2, regressions.size());
+}
+
+}  // namespace benchmark
+
+}  // namespace omaha
@@ -0,0 +1,122 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for reading the registry keys of the registered apps, which each
+// update check does for every app. The time per iteration is the time to get
+// the snapshots of all the apps, which are read from the registry each time
+// without caching, and once with caching. The apps are registered in a
+// registry hive which overrides HKCU and HKLM while the benchmark runs.
+
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/app_registry_utils.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/goopdate/app_registry_snapshot.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const int kNumApps = 500;
+
+// Writes the keys of typical registered user apps.
+HRESULT RegisterApps(std::vector<CString>* app_ids) {
+  ASSERT1(app_ids);
+
+  for (int i = 0; i != kNumApps; ++i) {
+    CString app_id;
+    SafeCStringFormat(&app_id, _T("{B7BAF788-9D64-49C3-AFDC-%012X}"), i);
+
+    const CString clients_key(
+        app_registry_utils::GetAppClientsKey(false, app_id));
+    const CString client_state_key(
+        app_registry_utils::GetAppClientStateKey(false, app_id));
+    HRESULT hr = RegKey::SetValue(clients_key,
+                                  kRegValueProductVersion,
+                                  _T("1.2.3.4"));
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(clients_key, kRegValueAppName, _T("App"));
+    }
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(client_state_key,
+                            kRegValueProductVersion,
+                            _T("1.2.3.4"));
+    }
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(client_state_key, kRegValueBrandCode, _T("GOOG"));
+    }
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(client_state_key,
+                            kRegValueInstallTimeSec,
+                            static_cast<DWORD>(1000));
+    }
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(
+          AppendRegKeyPath(client_state_key, kRegSubkeyCohort),
+          NULL,
+          _T("cohort"));
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    app_ids->push_back(app_id);
+  }
+
+  return S_OK;
+}
+
+void BenchmarkGetSnapshots(bool is_caching, benchmark::State* state) {
+  benchmark::ScopedRegistryOverride registry_override;
+  std::vector<CString> app_ids;
+  if (FAILED(registry_override.Initialize()) ||
+      FAILED(RegisterApps(&app_ids))) {
+    state->SkipWithError(_T("The apps could not be registered."));
+    return;
+  }
+
+  AppRegistrySnapshotCache cache(
+      false,
+      std::unique_ptr<AppRegistryBackendInterface>(
+          new RegKeyAppRegistryBackend));
+  cache.set_is_caching(is_caching);
+
+  while (state->KeepRunning()) {
+    for (size_t i = 0; i != app_ids.size(); ++i) {
+      std::shared_ptr<const AppRegistrySnapshot> snapshot(
+          cache.GetSnapshot(app_ids[i]));
+      const bool exists = snapshot->client_key().exists();
+      state->DoNotOptimize(exists);
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(GetAppRegistrySnapshots_500Apps_Uncached) {
+  BenchmarkGetSnapshots(false, state);
+}
+
+OMAHA_BENCHMARK(GetAppRegistrySnapshots_500Apps_Cached) {
+  BenchmarkGetSnapshots(true, state);
+}
+
+}  // namespace omaha
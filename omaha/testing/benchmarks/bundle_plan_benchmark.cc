@@ -0,0 +1,284 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the completion time of a bundle, with fake downloads and
+// installs which take a fixed amount of time. The time per iteration is the
+// time to download, or to download and install, all the apps of the bundle,
+// so the benchmarks compare the plans with one download or install at a time
+// with the plans which run them concurrently. The apps are created in a
+// registry hive which overrides HKCU and HKLM while the benchmark runs.
+
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/path.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/app_manager.h"
+#include "omaha/goopdate/app_state_waiting_to_download.h"
+#include "omaha/goopdate/bundle_download_plan.h"
+#include "omaha/goopdate/bundle_install_plan.h"
+#include "omaha/goopdate/download_budget.h"
+#include "omaha/goopdate/download_manager.h"
+#include "omaha/goopdate/goopdate.h"
+#include "omaha/goopdate/install_manager.h"
+#include "omaha/goopdate/model.h"
+#include "omaha/goopdate/worker_mock.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kAppGuids[] = {
+  _T("{0B35E146-D9CB-4145-8A91-43FDCAEBCD1E}"),
+  _T("{C7F2B395-A01C-4806-AA07-9163F66AFC48}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E01}"),
+  _T("{2B1B4E62-0E6B-4C8B-8E2A-6C5C5B3C8E02}"),
+};
+
+const int kDownloadTimeMs = 100;
+const int kInstallTimeMs = 300;
+
+// Downloads the packages of an app in a fixed amount of time, holding a
+// connection of the budget like the download manager.
+class FakeDownloadManager : public DownloadManagerInterface {
+ public:
+  explicit FakeDownloadManager(DownloadBudget* download_budget)
+      : download_budget_(download_budget) {}
+
+  virtual HRESULT Initialize() { return S_OK; }
+  virtual HRESULT PurgeAppLowerVersions(const CString&, const CString&) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT CachePackage(const Package*, File*, const CString*) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT CacheOfflinePackages(const std::vector<const Package*>&,
+                                       const std::vector<CString>&,
+                                       bool,
+                                       size_t*) {
+    return E_NOTIMPL;
+  }
+  virtual HRESULT GetPackage(const Package*, const CString&) const {
+    return E_NOTIMPL;
+  }
+  virtual bool IsPackageAvailable(const Package*) const { return false; }
+  virtual void Cancel(App*) {}
+  virtual void CancelAll() {}
+  virtual bool IsBusy() const { return false; }
+
+  virtual HRESULT DownloadApp(App* app) {
+    ScopedDownloadConnection connection(download_budget_, NULL);
+    app->Downloading();
+    ::Sleep(kDownloadTimeMs);
+    app->DownloadComplete();
+    app->MarkReadyToInstall();
+    return connection.result();
+  }
+
+ private:
+  DownloadBudget* download_budget_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeDownloadManager);
+};
+
+// Runs an installer which takes a fixed amount of time.
+class FakeInstallManager : public InstallManagerInterface {
+ public:
+  explicit FakeInstallManager(const CString& install_working_dir)
+      : install_working_dir_(install_working_dir) {}
+
+  virtual CString install_working_dir() const { return install_working_dir_; }
+  virtual HRESULT Initialize() { return S_OK; }
+
+  virtual void InstallApp(App* app, const CString& dir) {
+    UNREFERENCED_PARAMETER(dir);
+
+    app->Installing();
+    ::Sleep(kInstallTimeMs);
+
+    __mutexScope(AppManager::Instance()->GetRegistryStableStateLock());
+    InstallerResultInfo result_info;
+    result_info.type = INSTALLER_RESULT_SUCCESS;
+    result_info.text = _T("success");
+    app->ReportInstallerComplete(result_info);
+  }
+
+  virtual void InstallAppConcurrently(App* app, const CString& dir) {
+    InstallApp(app, dir);
+  }
+
+ private:
+  const CString install_working_dir_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeInstallManager);
+};
+
+// A bundle of user apps, created in the overridden registry.
+class BundleFixture {
+ public:
+  BundleFixture()
+      : goopdate_(false),
+        install_working_dir_(ConcatenatePath(app_util::GetTempDir(),
+                                             _T("omaha_benchmarks_install"))) {}
+
+  ~BundleFixture() {
+    app_bundle_.reset();
+    model_.reset();
+    AppManager::DeleteInstance();
+    DeleteDirectory(install_working_dir_);
+  }
+
+  HRESULT Initialize(size_t num_apps) {
+    ASSERT1(num_apps <= arraysize(kAppGuids));
+
+    HRESULT hr = registry_override_.Initialize();
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = CreateDir(install_working_dir_, NULL);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = AppManager::CreateInstance(false);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    mock_worker_.reset(new testing::NiceMock<MockWorker>);
+    model_.reset(new Model(mock_worker_.get()));
+    app_bundle_ = model_->CreateAppBundle(false);
+    if (!app_bundle_.get()) {
+      return E_FAIL;
+    }
+
+    hr = app_bundle_->put_displayLanguage(CComBSTR(_T("en")));
+    if (SUCCEEDED(hr)) {
+      hr = app_bundle_->put_installSource(CComBSTR(_T("benchmark")));
+    }
+    if (SUCCEEDED(hr)) {
+      hr = app_bundle_->initialize();
+    }
+
+    for (size_t i = 0; SUCCEEDED(hr) && i != num_apps; ++i) {
+      App* app = NULL;
+      hr = app_bundle_->createApp(CComBSTR(kAppGuids[i]), &app);
+      if (SUCCEEDED(hr)) {
+        apps_.push_back(app);
+      }
+    }
+
+    return hr;
+  }
+
+  // Makes the apps ready to be downloaded again.
+  void ResetApps() {
+    for (size_t i = 0; i != apps_.size(); ++i) {
+      SetAppStateForUnitTest(apps_[i], new fsm::AppStateWaitingToDownload);
+    }
+  }
+
+  const std::vector<App*>& apps() const { return apps_; }
+  const CString& install_working_dir() const { return install_working_dir_; }
+
+ private:
+  // Declared first, so that the registry is restored after the other members
+  // are destroyed.
+  benchmark::ScopedRegistryOverride registry_override_;
+  Goopdate goopdate_;
+  const CString install_working_dir_;
+
+  std::unique_ptr<MockWorker> mock_worker_;
+  std::unique_ptr<Model> model_;
+  std::shared_ptr<AppBundle> app_bundle_;
+  std::vector<App*> apps_;
+
+  DISALLOW_COPY_AND_ASSIGN(BundleFixture);
+};
+
+// Downloads the apps with up to |max_connections| connections.
+void BenchmarkBundleDownload(int max_connections, benchmark::State* state) {
+  BundleFixture fixture;
+  DownloadBudget download_budget(max_connections, 0);
+  if (FAILED(fixture.Initialize(arraysize(kAppGuids))) ||
+      FAILED(download_budget.Initialize())) {
+    state->SkipWithError(_T("The bundle could not be created."));
+    return;
+  }
+
+  FakeDownloadManager download_manager(&download_budget);
+  while (state->KeepRunning()) {
+    fixture.ResetApps();
+
+    BundleDownloadPlan download_plan(&download_manager, &download_budget);
+    if (FAILED(download_plan.Start(fixture.apps(), NULL))) {
+      state->SkipWithError(_T("The downloads could not be started."));
+      return;
+    }
+    download_plan.WaitForAll();
+  }
+}
+
+// Downloads the apps with two connections and installs them with up to
+// |max_concurrent_installs| installers.
+void BenchmarkBundleInstall(int max_concurrent_installs,
+                            benchmark::State* state) {
+  BundleFixture fixture;
+  DownloadBudget download_budget(2, 0);
+  if (FAILED(fixture.Initialize(arraysize(kAppGuids))) ||
+      FAILED(download_budget.Initialize())) {
+    state->SkipWithError(_T("The bundle could not be created."));
+    return;
+  }
+
+  FakeDownloadManager download_manager(&download_budget);
+  FakeInstallManager install_manager(fixture.install_working_dir());
+  while (state->KeepRunning()) {
+    fixture.ResetApps();
+
+    BundleDownloadPlan download_plan(&download_manager, &download_budget);
+    if (FAILED(download_plan.Start(fixture.apps(), NULL))) {
+      state->SkipWithError(_T("The downloads could not be started."));
+      return;
+    }
+
+    BundleInstallPlan install_plan(&install_manager, max_concurrent_installs);
+    install_plan.InstallAll(&download_plan);
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(BundleDownload_4Apps_OneConnection) {
+  BenchmarkBundleDownload(1, state);
+}
+
+OMAHA_BENCHMARK(BundleDownload_4Apps_4Connections) {
+  BenchmarkBundleDownload(4, state);
+}
+
+OMAHA_BENCHMARK(BundleInstall_4Apps_OneInstall) {
+  BenchmarkBundleInstall(1, state);
+}
+
+OMAHA_BENCHMARK(BundleInstall_4Apps_4Installs) {
+  BenchmarkBundleInstall(4, state);
+}
+
+}  // namespace omaha
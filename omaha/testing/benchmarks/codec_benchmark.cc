@@ -0,0 +1,236 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the Base64 and hex codecs, which encode the CUP parameters,
+// the hashes of the packages, and the tokens of the requests, and for the
+// UTF-8 conversions of the requests and responses. The conversions are
+// compared with the OS conversions on ASCII text, like a request, and on
+// text with some localized strings, like a response.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/string.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const int kDataSize = 64 * 1024;
+const int kTextLength = 4 * 1024;
+
+CStringA GetData() {
+  CStringA data;
+  for (int i = 0; i != kDataSize; ++i) {
+    data += static_cast<char>(i * 31);
+  }
+  return data;
+}
+
+CString GetAsciiText() {
+  CString text;
+  for (int i = 0; i != kTextLength; ++i) {
+    text.AppendChar(static_cast<TCHAR>(_T(' ') + i % 90));
+  }
+  return text;
+}
+
+// Returns mostly ASCII text, with characters of two and three UTF-8 bytes,
+// and surrogate pairs.
+CString GetMixedText() {
+  CString text;
+  for (int i = 0; text.GetLength() < kTextLength; ++i) {
+    switch (i % 8) {
+      case 5:
+        text.AppendChar(static_cast<TCHAR>(0x80 + i % 0x780));
+        break;
+      case 6:
+        text.AppendChar(static_cast<TCHAR>(0x4e00 + i % 0x5000));
+        break;
+      case 7:
+        text.AppendChar(static_cast<TCHAR>(0xd800 + i % 0x400));
+        text.AppendChar(static_cast<TCHAR>(0xdc00 + i % 0x400));
+        break;
+      default:
+        text.AppendChar(static_cast<TCHAR>(_T(' ') + i % 90));
+        break;
+    }
+  }
+  return text;
+}
+
+std::vector<uint8> ToUtf8Vector(const CString& text) {
+  const CStringA utf8(WideToUtf8(text));
+  return std::vector<uint8>(utf8.GetString(),
+                            utf8.GetString() + utf8.GetLength());
+}
+
+void BenchmarkWideToUtf8(const CString& text, benchmark::State* state) {
+  state->SetBytesPerIteration(text.GetLength() * sizeof(TCHAR));
+  while (state->KeepRunning()) {
+    const CStringA utf8(WideToUtf8(text));
+    state->DoNotOptimize(utf8);
+  }
+}
+
+void BenchmarkOsWideToUtf8(const CString& text, benchmark::State* state) {
+  state->SetBytesPerIteration(text.GetLength() * sizeof(TCHAR));
+  while (state->KeepRunning()) {
+    const int utf8_length = ::WideCharToMultiByte(CP_UTF8, 0,
+                                                  text, text.GetLength(),
+                                                  NULL, 0, NULL, NULL);
+    CStringA utf8;
+    ::WideCharToMultiByte(CP_UTF8, 0, text, text.GetLength(),
+                          utf8.GetBufferSetLength(utf8_length), utf8_length,
+                          NULL, NULL);
+    utf8.ReleaseBufferSetLength(utf8_length);
+    state->DoNotOptimize(utf8);
+  }
+}
+
+void BenchmarkUtf8ToWide(const CString& text, benchmark::State* state) {
+  const std::vector<uint8> utf8(ToUtf8Vector(text));
+
+  state->SetBytesPerIteration(utf8.size());
+  while (state->KeepRunning()) {
+    const CString wide(Utf8BufferToWideChar(utf8));
+    state->DoNotOptimize(wide);
+  }
+}
+
+void BenchmarkOsUtf8ToWide(const CString& text, benchmark::State* state) {
+  const std::vector<uint8> utf8(ToUtf8Vector(text));
+  const char* in = reinterpret_cast<const char*>(&utf8.front());
+  const int in_length = static_cast<int>(utf8.size());
+
+  state->SetBytesPerIteration(utf8.size());
+  while (state->KeepRunning()) {
+    const int wide_length = ::MultiByteToWideChar(CP_UTF8, 0, in, in_length,
+                                                  NULL, 0);
+    CString wide;
+    ::MultiByteToWideChar(CP_UTF8, 0, in, in_length,
+                          wide.GetBufferSetLength(wide_length), wide_length);
+    wide.ReleaseBufferSetLength(wide_length);
+    state->DoNotOptimize(wide);
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(Base64Escape_64KB) {
+  const CStringA data(GetData());
+
+  CStringA encoded;
+  state->SetBytesPerIteration(data.GetLength());
+  while (state->KeepRunning()) {
+    Base64Escape(data.GetString(), data.GetLength(), &encoded, true);
+  }
+}
+
+OMAHA_BENCHMARK(Base64Unescape_64KB) {
+  const CStringA data(GetData());
+  CStringA encoded;
+  Base64Escape(data.GetString(), data.GetLength(), &encoded, true);
+
+  CStringA decoded;
+  state->SetBytesPerIteration(encoded.GetLength());
+  while (state->KeepRunning()) {
+    if (Base64Unescape(encoded, &decoded) != data.GetLength()) {
+      state->SkipWithError(_T("The data did not decode."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(BytesToHex_64KB) {
+  const CStringA data(GetData());
+  const std::vector<uint8> bytes(data.GetString(),
+                                 data.GetString() + data.GetLength());
+
+  state->SetBytesPerIteration(bytes.size());
+  while (state->KeepRunning()) {
+    state->DoNotOptimize(BytesToHex(bytes).GetLength());
+  }
+}
+
+OMAHA_BENCHMARK(B2aHex_64KB) {
+  const CStringA data(GetData());
+
+  state->SetBytesPerIteration(data.GetLength());
+  while (state->KeepRunning()) {
+    const std::string hex(b2a_hex(data.GetString(), data.GetLength()));
+    state->DoNotOptimize(hex);
+  }
+}
+
+OMAHA_BENCHMARK(A2bHex_64KB) {
+  const CStringA data(GetData());
+  const std::string hex(b2a_hex(data.GetString(), data.GetLength()));
+
+  state->SetBytesPerIteration(hex.size());
+  while (state->KeepRunning()) {
+    const std::string bytes(a2b_hex(hex));
+    state->DoNotOptimize(bytes);
+  }
+}
+
+OMAHA_BENCHMARK(HexToBytes_64KB) {
+  const CStringA data(GetData());
+  const CStringA hex(WideToAnsiDirect(BytesToHex(
+      reinterpret_cast<const uint8*>(data.GetString()), data.GetLength())));
+
+  std::vector<uint8> bytes;
+  state->SetBytesPerIteration(hex.GetLength());
+  while (state->KeepRunning()) {
+    if (!SafeHexStringToVector(hex, &bytes)) {
+      state->SkipWithError(_T("The data did not decode."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(WideToUtf8_Ascii_4K) {
+  BenchmarkWideToUtf8(GetAsciiText(), state);
+}
+
+OMAHA_BENCHMARK(WideToUtf8_Mixed_4K) {
+  BenchmarkWideToUtf8(GetMixedText(), state);
+}
+
+OMAHA_BENCHMARK(OsWideToUtf8_Ascii_4K) {
+  BenchmarkOsWideToUtf8(GetAsciiText(), state);
+}
+
+OMAHA_BENCHMARK(OsWideToUtf8_Mixed_4K) {
+  BenchmarkOsWideToUtf8(GetMixedText(), state);
+}
+
+OMAHA_BENCHMARK(Utf8BufferToWideChar_Ascii_4K) {
+  BenchmarkUtf8ToWide(GetAsciiText(), state);
+}
+
+OMAHA_BENCHMARK(Utf8BufferToWideChar_Mixed_4K) {
+  BenchmarkUtf8ToWide(GetMixedText(), state);
+}
+
+OMAHA_BENCHMARK(OsUtf8ToWide_Ascii_4K) {
+  BenchmarkOsUtf8ToWide(GetAsciiText(), state);
+}
+
+OMAHA_BENCHMARK(OsUtf8ToWide_Mixed_4K) {
+  BenchmarkOsUtf8ToWide(GetMixedText(), state);
+}
+
+}  // namespace omaha
@@ -0,0 +1,122 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the policy getters of ConfigManager on a domain joined
+// machine with an install policy for one app. Each iteration calls three
+// getters, which read the policy snapshot, or resolve the policies again
+// when the caller asks for the status values. The policies are written in a
+// registry hive which overrides HKCU and HKLM while the benchmark runs.
+
+#include <atlbase.h>
+
+#include "base/basictypes.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/string.h"
+#include "omaha/common/config_manager.h"
+#include "omaha/common/const_group_policy.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR kAppGuid[] = _T("{6762F466-8863-424f-817C-5757931F346E}");
+
+// Sets the install policy of |kAppGuid|, then creates the ConfigManager
+// which reads it. The ConfigManager is deleted with the policies.
+class PolicyFixture {
+ public:
+  PolicyFixture() {}
+
+  ~PolicyFixture() {
+    ConfigManager::DeleteInstance();
+  }
+
+  HRESULT Initialize() {
+    HRESULT hr = registry_override_.Initialize();
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(MACHINE_REG_UPDATE_DEV,
+                            kRegValueIsEnrolledToDomain,
+                            1UL);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(kRegKeyGoopdateGroupPolicy,
+                            CString(kRegValueInstallAppPrefix) + kAppGuid,
+                            static_cast<DWORD>(kPolicyEnabled));
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    ConfigManager::DeleteInstance();
+    return ConfigManager::Instance() ? S_OK : E_FAIL;
+  }
+
+ private:
+  benchmark::ScopedRegistryOverride registry_override_;
+
+  DISALLOW_COPY_AND_ASSIGN(PolicyFixture);
+};
+
+}  // namespace
+
+OMAHA_BENCHMARK(PolicyGetters_Snapshot) {
+  PolicyFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The policies could not be set."));
+    return;
+  }
+
+  ConfigManager* cm = ConfigManager::Instance();
+  const GUID app_guid = StringToGuid(kAppGuid);
+  while (state->KeepRunning()) {
+    const DWORD cache_size_limit = cm->GetPackageCacheSizeLimitMBytes(NULL);
+    const DWORD install_policy =
+        cm->GetEffectivePolicyForAppInstalls(app_guid, NULL);
+    const DWORD update_policy =
+        cm->GetEffectivePolicyForAppUpdates(app_guid, NULL);
+    state->DoNotOptimize(cache_size_limit);
+    state->DoNotOptimize(install_policy);
+    state->DoNotOptimize(update_policy);
+  }
+}
+
+OMAHA_BENCHMARK(PolicyGetters_ResolvedWithStatusValues) {
+  PolicyFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The policies could not be set."));
+    return;
+  }
+
+  ConfigManager* cm = ConfigManager::Instance();
+  const GUID app_guid = StringToGuid(kAppGuid);
+  while (state->KeepRunning()) {
+    CComPtr<IPolicyStatusValue> status;
+    const DWORD cache_size_limit =
+        cm->GetPackageCacheSizeLimitMBytes(&status);
+    status.Release();
+    const DWORD install_policy =
+        cm->GetEffectivePolicyForAppInstalls(app_guid, &status);
+    status.Release();
+    const DWORD update_policy =
+        cm->GetEffectivePolicyForAppUpdates(app_guid, &status);
+    state->DoNotOptimize(cache_size_limit);
+    state->DoNotOptimize(install_policy);
+    state->DoNotOptimize(update_policy);
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,123 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the requests sent through SimpleRequest to a local http
+// server, with and without the connection pool. The time per iteration is
+// the time of one GET request. The server is on the loopback interface, so
+// the pool only saves the TCP handshake and the WinHttp connection setup.
+
+#include <winsock2.h>
+#include <windows.h>
+#include <winhttp.h>
+#include <memory>
+
+#include "base/basictypes.h"
+#include "omaha/net/connection_pool.h"
+#include "omaha/net/http_client.h"
+#include "omaha/net/network_config.h"
+#include "omaha/net/simple_request.h"
+#include "omaha/testing/benchmark.h"
+#include "omaha/testing/local_http_server.h"
+
+namespace omaha {
+
+namespace {
+
+// A WinHttp session, which is registered with the connection pool if
+// |is_pooled|.
+class SessionFixture {
+ public:
+  explicit SessionFixture(bool is_pooled)
+      : is_pooled_(is_pooled),
+        session_handle_(NULL) {}
+
+  ~SessionFixture() {
+    if (session_handle_) {
+      ConnectionPool::Instance().UnregisterSession(session_handle_);
+      http_client_->Close(session_handle_);
+    }
+  }
+
+  HRESULT Initialize() {
+    http_client_.reset(CreateHttpClient());
+    if (!http_client_.get()) {
+      return E_FAIL;
+    }
+
+    HRESULT hr = http_client_->Initialize();
+    if (SUCCEEDED(hr)) {
+      hr = http_client_->Open(NULL,
+                              WINHTTP_ACCESS_TYPE_NO_PROXY,
+                              WINHTTP_NO_PROXY_NAME,
+                              WINHTTP_NO_PROXY_BYPASS,
+                              WINHTTP_FLAG_ASYNC,
+                              &session_handle_);
+    }
+    if (SUCCEEDED(hr) && is_pooled_) {
+      ConnectionPool::Instance().RegisterSession(session_handle_,
+                                                 http_client_.get());
+    }
+    return hr;
+  }
+
+  HRESULT Get(const CString& url) {
+    SimpleRequest simple_request;
+    simple_request.set_session_handle(session_handle_);
+    simple_request.set_url(url);
+    simple_request.set_proxy_configuration(ProxyConfig());
+    HRESULT hr = simple_request.Send();
+    if (FAILED(hr)) {
+      return hr;
+    }
+    return simple_request.GetHttpStatusCode() == HTTP_STATUS_OK ? S_OK :
+                                                                  E_FAIL;
+  }
+
+ private:
+  const bool is_pooled_;
+  std::unique_ptr<HttpClient> http_client_;
+  HINTERNET session_handle_;
+
+  DISALLOW_COPY_AND_ASSIGN(SessionFixture);
+};
+
+void BenchmarkGet(bool is_pooled, benchmark::State* state) {
+  LocalHttpServer server;
+  SessionFixture fixture(is_pooled);
+  if (FAILED(server.Start()) || FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The local server could not be started."));
+    return;
+  }
+
+  const CString url(server.url());
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.Get(url))) {
+      state->SkipWithError(_T("The request failed."));
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(SimpleRequestGet_LocalServer_Unpooled) {
+  BenchmarkGet(false, state);
+}
+
+OMAHA_BENCHMARK(SimpleRequestGet_LocalServer_Pooled) {
+  BenchmarkGet(true, state);
+}
+
+}  // namespace omaha
@@ -0,0 +1,131 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the gzip and deflate content codings of the request bodies,
+// on update checks of a machine with 20 and 500 apps. The throughput is in
+// bytes of the uncompressed update check, both for encoding and decoding.
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/net/content_encoding.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const size_t kMaxDecodedLength = 16 * 1024 * 1024;
+
+// Returns an update check for |num_apps| apps.
+CStringA BuildUpdateCheck(int num_apps) {
+  CStringA request(
+      "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+      "<request protocol=\"3.0\" updater=\"Omaha\" updaterversion=\"1.3.99.0\""
+      " shell_version=\"1.3.99.0\" ismachine=\"1\" sessionid="
+      "\"{2D5E1E70-5F6B-4B7B-9C51-6D52A1E1A3F4}\" installsource=\"scheduler\""
+      " requestid=\"{8C3C8A3D-1F3E-4E2A-8B5C-2A6E1E4F6D7C}\" dedup=\"cr\">"
+      "<hw physmemory=\"16\" sse=\"1\" sse2=\"1\" sse3=\"1\" ssse3=\"1\""
+      " sse41=\"1\" sse42=\"1\" avx=\"1\"/>"
+      "<os platform=\"win\" version=\"10.0.19045.3693\" sp=\"\""
+      " arch=\"x64\"/>");
+  for (int i = 0; i != num_apps; ++i) {
+    SafeCStringAAppendFormat(&request,
+        "<app appid=\"{%08X-5605-4C18-AA51-8BD0A1209C8C}\""
+        " version=\"%d.0.%d.0\" nextversion=\"\" lang=\"en\" brand=\"GGLS\""
+        " client=\"\" installage=\"%d\" cohort=\"1:1x:\" cohortname=\"Stable\">"
+        "<updatecheck/><ping r=\"1\" rd=\"6200\" ping_freshness="
+        "\"{%08X-8ACF-4746-8240-643741C797B5}\"/></app>",
+        i, i % 120, i * 7, i % 400, i * 31);
+  }
+  request += "</request>";
+  return request;
+}
+
+void BenchmarkEncodeContent(ContentEncoding encoding,
+                            int num_apps,
+                            benchmark::State* state) {
+  const CStringA request(BuildUpdateCheck(num_apps));
+
+  state->SetBytesPerIteration(request.GetLength());
+  while (state->KeepRunning()) {
+    std::vector<uint8> encoded;
+    if (FAILED(EncodeContent(encoding,
+                             request.GetString(),
+                             request.GetLength(),
+                             &encoded))) {
+      state->SkipWithError(_T("The update check could not be encoded."));
+      return;
+    }
+    state->DoNotOptimize(encoded.front());
+  }
+}
+
+void BenchmarkDecodeContent(ContentEncoding encoding,
+                            int num_apps,
+                            benchmark::State* state) {
+  const CStringA request(BuildUpdateCheck(num_apps));
+  std::vector<uint8> encoded;
+  if (FAILED(EncodeContent(encoding,
+                           request.GetString(),
+                           request.GetLength(),
+                           &encoded))) {
+    state->SkipWithError(_T("The update check could not be encoded."));
+    return;
+  }
+
+  state->SetBytesPerIteration(request.GetLength());
+  while (state->KeepRunning()) {
+    std::vector<uint8> decoded;
+    if (FAILED(DecodeContent(encoding,
+                             &encoded.front(),
+                             encoded.size(),
+                             kMaxDecodedLength,
+                             &decoded))) {
+      state->SkipWithError(_T("The update check could not be decoded."));
+      return;
+    }
+    state->DoNotOptimize(decoded.front());
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(EncodeContent_Gzip_20Apps) {
+  BenchmarkEncodeContent(CONTENT_ENCODING_GZIP, 20, state);
+}
+
+OMAHA_BENCHMARK(EncodeContent_Gzip_500Apps) {
+  BenchmarkEncodeContent(CONTENT_ENCODING_GZIP, 500, state);
+}
+
+OMAHA_BENCHMARK(EncodeContent_Deflate_500Apps) {
+  BenchmarkEncodeContent(CONTENT_ENCODING_DEFLATE, 500, state);
+}
+
+OMAHA_BENCHMARK(DecodeContent_Gzip_20Apps) {
+  BenchmarkDecodeContent(CONTENT_ENCODING_GZIP, 20, state);
+}
+
+OMAHA_BENCHMARK(DecodeContent_Gzip_500Apps) {
+  BenchmarkDecodeContent(CONTENT_ENCODING_GZIP, 500, state);
+}
+
+OMAHA_BENCHMARK(DecodeContent_Deflate_500Apps) {
+  BenchmarkDecodeContent(CONTENT_ENCODING_DEFLATE, 500, state);
+}
+
+}  // namespace omaha
@@ -0,0 +1,122 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the hashing and signature verification of the update
+// responses and of the downloaded packages.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "components/crx_file/crx_verifier.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/security/p256.h"
+#include "omaha/base/security/p256_ecdsa.h"
+#include "omaha/base/security/p256_prng.h"
+#include "omaha/base/security/sha256.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+void Sha256(benchmark::State* state, size_t size) {
+  ASSERT1(state);
+
+  std::vector<uint8> data(size);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = static_cast<uint8>(i * 31);
+  }
+
+  uint8 digest[SHA256_DIGEST_SIZE] = {};
+  state->SetBytesPerIteration(data.size());
+  while (state->KeepRunning()) {
+    SHA256_hash(&data.front(), data.size(), digest);
+    state->DoNotOptimize(digest);
+  }
+}
+
+void CrxVerify(benchmark::State* state, const TCHAR* file_name) {
+  ASSERT1(state);
+  ASSERT1(file_name);
+
+  const std::string crx_path(
+      CT2A(benchmark::GetSupportFilePath(file_name)));
+  std::string public_key;
+  while (state->KeepRunning()) {
+    if (crx_file::Verify(crx_path,
+                         crx_file::VerifierFormat::CRX3,
+                         {},
+                         {},
+                         &public_key,
+                         NULL) != crx_file::VerifierResult::OK_FULL) {
+      state->SkipWithError(_T("The CRX did not verify."));
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(Sha256_1KB) {
+  Sha256(state, 1024);
+}
+
+OMAHA_BENCHMARK(Sha256_1MB) {
+  Sha256(state, 1024 * 1024);
+}
+
+// Verifies a signature of a random message with a random key, like the
+// client verifies the ECDSA signature of each CUP response.
+OMAHA_BENCHMARK(P256EcdsaVerify) {
+  P256_PRNG_CTX prng;
+  p256_prng_init(&prng, "omaha_benchmarks", 16, 0);
+
+  uint8_t random_bytes[P256_PRNG_SIZE] = {};
+  p256_int key;
+  do {
+    p256_int p1, p2;
+    p256_prng_draw(&prng, random_bytes);
+    p256_from_bin(random_bytes, &p1);
+    p256_prng_draw(&prng, random_bytes);
+    p256_from_bin(random_bytes, &p2);
+    p256_modmul(&SECP256r1_n, &p1, 0, &p2, &key);
+  } while (p256_is_zero(&key));
+
+  p256_int key_x, key_y;
+  p256_base_point_mul(&key, &key_x, &key_y);
+
+  p256_int message;
+  p256_prng_draw(&prng, random_bytes);
+  p256_from_bin(random_bytes, &message);
+
+  p256_int r, s;
+  p256_ecdsa_sign(&key, &message, &r, &s);
+
+  while (state->KeepRunning()) {
+    if (!p256_ecdsa_verify(&key_x, &key_y, &message, &r, &s)) {
+      state->SkipWithError(_T("The signature did not verify."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(Crx3Verify_NoPublisher) {
+  CrxVerify(state, _T("valid_no_publisher.crx3"));
+}
+
+OMAHA_BENCHMARK(Crx3Verify_Publisher) {
+  CrxVerify(state, _T("valid_publisher.crx3"));
+}
+
+}  // namespace omaha
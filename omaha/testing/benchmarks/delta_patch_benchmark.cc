@@ -0,0 +1,187 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the patches of packages, on the builds of Omaha in the
+// unittest_support directory. The creation benchmarks fail if the patch does
+// not save at least |kMinSavedPercent| of the download. The patches save
+// about 66% of GoogleUpdate.exe from 1.2.131.7 to 1.2.183.9, 58% of
+// GoogleUpdate.exe from 1.2.x to 1.3.x, and 34% of goopdate.dll from 1.2.x
+// to 1.3.x. The apply benchmarks report the throughput in bytes of the new
+// file; the files are created in the temporary directory of the user and
+// deleted afterwards.
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/delta_patch.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const size_t kMinSavedPercent = 25;
+
+HRESULT ReadSupportFile(const TCHAR* file_name, std::vector<uint8>* data) {
+  return ReadEntireFileShareMode(benchmark::GetSupportFilePath(file_name),
+                                 0,
+                                 FILE_SHARE_READ,
+                                 data);
+}
+
+void BenchmarkCreateDeltaPatch(const TCHAR* old_file_name,
+                               const TCHAR* new_file_name,
+                               benchmark::State* state) {
+  std::vector<uint8> old_data;
+  std::vector<uint8> new_data;
+  if (FAILED(ReadSupportFile(old_file_name, &old_data)) ||
+      FAILED(ReadSupportFile(new_file_name, &new_data))) {
+    state->SkipWithError(_T("The files could not be read."));
+    return;
+  }
+
+  state->SetBytesPerIteration(new_data.size());
+  while (state->KeepRunning()) {
+    std::vector<uint8> patch;
+    if (FAILED(CreateDeltaPatch(old_data, new_data, &patch)) ||
+        patch.size() * 100 > new_data.size() * (100 - kMinSavedPercent)) {
+      state->SkipWithError(_T("The patch is too large."));
+      return;
+    }
+    state->DoNotOptimize(patch.front());
+  }
+}
+
+// Applies the patch between two support files from temporary files.
+class PatchFixture {
+ public:
+  PatchFixture()
+      : old_path_(ConcatenatePath(app_util::GetTempDir(),
+                                  _T("omaha_benchmarks_old.exe"))),
+        patch_path_(ConcatenatePath(app_util::GetTempDir(),
+                                    _T("omaha_benchmarks_patch.bin"))),
+        new_path_(ConcatenatePath(app_util::GetTempDir(),
+                                  _T("omaha_benchmarks_new.exe"))),
+        new_size_(0) {}
+
+  ~PatchFixture() {
+    ::DeleteFile(old_path_);
+    ::DeleteFile(patch_path_);
+    ::DeleteFile(new_path_);
+  }
+
+  HRESULT Initialize(const TCHAR* old_file_name, const TCHAR* new_file_name) {
+    std::vector<uint8> old_data;
+    std::vector<uint8> new_data;
+    HRESULT hr = ReadSupportFile(old_file_name, &old_data);
+    if (SUCCEEDED(hr)) {
+      hr = ReadSupportFile(new_file_name, &new_data);
+    }
+    std::vector<uint8> patch;
+    if (SUCCEEDED(hr)) {
+      hr = CreateDeltaPatch(old_data, new_data, &patch);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = WriteEntireFile(old_path_, old_data);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = WriteEntireFile(patch_path_, patch);
+    }
+    new_size_ = new_data.size();
+    return hr;
+  }
+
+  HRESULT Apply() {
+    ::DeleteFile(new_path_);
+
+    File patch_file;
+    File new_file;
+    HRESULT hr = patch_file.OpenWithAccessPattern(patch_path_,
+                                                  false,
+                                                  FILE_SHARE_READ,
+                                                  File::SEQUENTIAL_ACCESS);
+    if (SUCCEEDED(hr)) {
+      hr = new_file.Open(new_path_, true, false);
+    }
+    return SUCCEEDED(hr) ? ApplyDeltaPatch(old_path_, &patch_file, &new_file) :
+                           hr;
+  }
+
+  size_t new_size() const { return new_size_; }
+
+ private:
+  const CString old_path_;
+  const CString patch_path_;
+  const CString new_path_;
+  size_t new_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(PatchFixture);
+};
+
+void BenchmarkApplyDeltaPatch(const TCHAR* old_file_name,
+                              const TCHAR* new_file_name,
+                              benchmark::State* state) {
+  PatchFixture fixture;
+  if (FAILED(fixture.Initialize(old_file_name, new_file_name))) {
+    state->SkipWithError(_T("The patch could not be created."));
+    return;
+  }
+
+  state->SetBytesPerIteration(fixture.new_size());
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.Apply())) {
+      state->SkipWithError(_T("The patch could not be applied."));
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(CreateDeltaPatch_GoogleUpdate_1_2_131_To_1_2_183) {
+  BenchmarkCreateDeltaPatch(_T("omaha_1.2.131.7_shell\\GoogleUpdate.exe"),
+                            _T("omaha_1.2.183.9_shell\\GoogleUpdate.exe"),
+                            state);
+}
+
+OMAHA_BENCHMARK(CreateDeltaPatch_GoogleUpdate_1_2_To_1_3) {
+  BenchmarkCreateDeltaPatch(_T("omaha_1.2.x\\GoogleUpdate.exe"),
+                            _T("omaha_1.3.x\\GoogleUpdate.exe"),
+                            state);
+}
+
+OMAHA_BENCHMARK(CreateDeltaPatch_Goopdate_1_2_To_1_3) {
+  BenchmarkCreateDeltaPatch(_T("omaha_1.2.x\\goopdate.dll"),
+                            _T("omaha_1.3.x\\goopdate.dll"),
+                            state);
+}
+
+OMAHA_BENCHMARK(ApplyDeltaPatch_GoogleUpdate_1_2_To_1_3) {
+  BenchmarkApplyDeltaPatch(_T("omaha_1.2.x\\GoogleUpdate.exe"),
+                           _T("omaha_1.3.x\\GoogleUpdate.exe"),
+                           state);
+}
+
+OMAHA_BENCHMARK(ApplyDeltaPatch_Goopdate_1_2_To_1_3) {
+  BenchmarkApplyDeltaPatch(_T("omaha_1.2.x\\goopdate.dll"),
+                           _T("omaha_1.3.x\\goopdate.dll"),
+                           state);
+}
+
+}  // namespace omaha
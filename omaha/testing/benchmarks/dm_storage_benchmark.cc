@@ -0,0 +1,164 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for loading a cached Omaha DM policy with 500 applications, as
+// GoopdateImpl does at startup. The policy is loaded by parsing the
+// PolicyFetchResponse, which also writes the compiled policy, or from the
+// compiled policy. The DM token is written in a registry hive which
+// overrides HKCU and HKLM, and the policies in the temporary directory of
+// the user.
+
+#include <atlpath.h>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/dm_messages.h"
+#include "omaha/goopdate/dm_storage.h"
+#include "omaha/testing/benchmark.h"
+#include "wireless/android/enterprise/devicemanagement/proto/dm_api.pb.h"
+#include "wireless/android/enterprise/devicemanagement/proto/omaha_settings.pb.h"
+
+namespace omaha {
+
+namespace {
+
+const int kNumApps = 500;
+
+// Persists a policy response for |kNumApps| applications.
+class PolicyFixture {
+ public:
+  PolicyFixture()
+      : policy_responses_dir_(ConcatenatePath(
+            app_util::GetTempDir(), _T("omaha_benchmarks_policies"))),
+        is_dm_storage_created_(false) {}
+
+  ~PolicyFixture() {
+    if (is_dm_storage_created_) {
+      DmStorage::DeleteInstance();
+    }
+    DeleteDirectory(policy_responses_dir_);
+  }
+
+  HRESULT Initialize() {
+    HRESULT hr = registry_override_.Initialize();
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    hr = DmStorage::CreateInstance(CString());
+    if (FAILED(hr)) {
+      return hr;
+    }
+    is_dm_storage_created_ = true;
+
+    hr = DmStorage::Instance()->StoreDmToken("dm_token");
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    wireless_android_enterprise_devicemanagement::OmahaSettingsClientProto
+        omaha_settings;
+    omaha_settings.set_auto_update_check_period_minutes(111);
+    for (int i = 0; i != kNumApps; ++i) {
+      GUID app_guid = GUID_NULL;
+      hr = ::CoCreateGuid(&app_guid);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      wireless_android_enterprise_devicemanagement::ApplicationSettings* app =
+          omaha_settings.add_application_settings();
+      app->set_app_guid(CStringA(GuidToString(app_guid)));
+      app->set_update(
+          wireless_android_enterprise_devicemanagement::AUTOMATIC_UPDATES_ONLY);
+      app->set_target_version_prefix("3.6.55");
+      app->set_target_channel("beta");
+    }
+    enterprise_management::PolicyData policy_data;
+    policy_data.set_policy_value(omaha_settings.SerializeAsString());
+    enterprise_management::PolicyFetchResponse response;
+    response.set_policy_data(policy_data.SerializeAsString());
+
+    PolicyResponses responses = {
+      {{kGoogleUpdatePolicyType, response.SerializeAsString()}}, ""
+    };
+    return DmStorage::PersistPolicies(policy_responses_dir_, responses);
+  }
+
+  // Deletes the compiled policy, so that the next load parses the response.
+  void DeleteCompiledPolicy() {
+    CStringA encoded_policy_response_dirname;
+    Base64Escape(kGoogleUpdatePolicyType,
+                 arraysize(kGoogleUpdatePolicyType) - 1,
+                 &encoded_policy_response_dirname,
+                 true);
+
+    CPath compiled_policy_file(policy_responses_dir_);
+    compiled_policy_file.Append(CString(encoded_policy_response_dirname));
+    compiled_policy_file.Append(kCompiledOmahaPolicyFileName);
+    ::DeleteFile(compiled_policy_file);
+  }
+
+  HRESULT Load() {
+    CachedOmahaPolicy info;
+    HRESULT hr = DmStorage::ReadCachedOmahaPolicy(policy_responses_dir_,
+                                                  &info);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    return info.application_settings.size() == kNumApps ? S_OK : E_FAIL;
+  }
+
+ private:
+  benchmark::ScopedRegistryOverride registry_override_;
+  const CPath policy_responses_dir_;
+  bool is_dm_storage_created_;
+
+  DISALLOW_COPY_AND_ASSIGN(PolicyFixture);
+};
+
+void BenchmarkReadCachedOmahaPolicy(bool is_compiled,
+                                    benchmark::State* state) {
+  PolicyFixture fixture;
+  if (FAILED(fixture.Initialize()) || FAILED(fixture.Load())) {
+    state->SkipWithError(_T("The policy could not be persisted."));
+    return;
+  }
+
+  while (state->KeepRunning()) {
+    if (!is_compiled) {
+      fixture.DeleteCompiledPolicy();
+    }
+    if (FAILED(fixture.Load())) {
+      state->SkipWithError(_T("The policy could not be loaded."));
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(ReadCachedOmahaPolicy_500Apps_Parsed) {
+  BenchmarkReadCachedOmahaPolicy(false, state);
+}
+
+OMAHA_BENCHMARK(ReadCachedOmahaPolicy_500Apps_Compiled) {
+  BenchmarkReadCachedOmahaPolicy(true, state);
+}
+
+}  // namespace omaha
@@ -0,0 +1,106 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for reading the experiment labels of 500 apps with 20 labels
+// each, as an update request does for every app. The time per iteration is
+// the time to read the labels of all the apps without their expirations,
+// either by removing them from the labels read from the registry, or from the
+// parsed labels directly. The labels are written in a registry hive which
+// overrides HKCU and HKLM while the benchmark runs.
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/time.h"
+#include "omaha/common/app_registry_utils.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/common/experiment_labels.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const int kNumApps = 500;
+const int kNumLabels = 20;
+
+// Writes |kNumLabels| labels for each of |kNumApps| user apps.
+HRESULT WriteLabels(std::vector<CString>* app_ids) {
+  ASSERT1(app_ids);
+
+  const time64 expiration = GetCurrent100NSTime() + 30 * kDaysTo100ns;
+  for (int i = 0; i != kNumApps; ++i) {
+    CString app_id;
+    SafeCStringFormat(&app_id, _T("{B7BAF788-9D64-49C3-AFDC-%012X}"), i);
+
+    CString label_list;
+    for (int j = 0; j != kNumLabels; ++j) {
+      CString key;
+      SafeCStringFormat(&key, _T("experiment_%d"), j);
+      CString value;
+      SafeCStringFormat(&value, _T("group_%d"), (i + j) % 4);
+      if (!label_list.IsEmpty()) {
+        label_list.AppendChar(_T(';'));
+      }
+      label_list.Append(ExperimentLabels::CreateLabel(key, value, expiration));
+    }
+    HRESULT hr = RegKey::SetValue(
+        app_registry_utils::GetAppClientStateKey(false, app_id),
+        kRegValueExperimentLabels,
+        label_list);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    app_ids->push_back(app_id);
+  }
+
+  return S_OK;
+}
+
+void BenchmarkReadLabels(bool is_parsed, benchmark::State* state) {
+  benchmark::ScopedRegistryOverride registry_override;
+  std::vector<CString> app_ids;
+  if (FAILED(registry_override.Initialize()) ||
+      FAILED(WriteLabels(&app_ids))) {
+    state->SkipWithError(_T("The labels could not be written."));
+    return;
+  }
+
+  while (state->KeepRunning()) {
+    for (size_t i = 0; i != app_ids.size(); ++i) {
+      const CString labels(is_parsed ?
+          ExperimentLabels::ReadRegistryNoTimestamps(false, app_ids[i]) :
+          ExperimentLabels::RemoveTimestamps(
+              ExperimentLabels::ReadRegistry(false, app_ids[i])));
+      const int length = labels.GetLength();
+      state->DoNotOptimize(length);
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(ExperimentLabelsRead_500Apps_RemoveTimestamps) {
+  BenchmarkReadLabels(false, state);
+}
+
+OMAHA_BENCHMARK(ExperimentLabelsRead_500Apps_NoTimestamps) {
+  BenchmarkReadLabels(true, state);
+}
+
+}  // namespace omaha
@@ -0,0 +1,344 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the file operations of the install path: the extraction of
+// the tag of the metainstaller, the package cache, and the reads of large
+// files in chunks or from a mapped view. The files are created in the
+// temporary directory of the user and deleted afterwards.
+
+#include <string.h>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/apply_tag.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/extractor.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/security/sha256.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/package_cache.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const char kTag[] =
+    "appguid={8A69D345-D564-463C-AFF1-A69D9E530F96}&appname=Google%20Chrome"
+    "&needsadmin=prefers&lang=en&usagestats=1";
+
+const TCHAR kAppId[] = _T("{8A69D345-D564-463C-AFF1-A69D9E530F96}");
+const TCHAR kVersion[] = _T("1.2.3.4");
+const TCHAR kPackageName[] = _T("package.exe");
+const int kPackageSize = 1024 * 1024;
+const uint32 kLargeFileSize = 16 * 1024 * 1024;
+const uint32 kChunkSize = 64 * 1024;
+
+// Tags a copy of a signed installer, like the download server does.
+class TaggedFile {
+ public:
+  TaggedFile()
+      : path_(ConcatenatePath(app_util::GetTempDir(),
+                              _T("omaha_benchmarks_tagged.exe"))) {}
+  ~TaggedFile() { ::DeleteFile(path_); }
+
+  HRESULT Create() {
+    ApplyTag apply_tag;
+    HRESULT hr = apply_tag.Init(
+        benchmark::GetSupportFilePath(_T("chrome_setup.exe")),
+        kTag,
+        static_cast<int>(strlen(kTag)),
+        path_,
+        false);
+    return SUCCEEDED(hr) ? apply_tag.EmbedTagString() : hr;
+  }
+
+  const CString& path() const { return path_; }
+
+ private:
+  const CString path_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaggedFile);
+};
+
+// Creates a cache in a temporary directory, and a package to put in it.
+class PackageCacheFixture {
+ public:
+  PackageCacheFixture()
+      : cache_root_(ConcatenatePath(app_util::GetTempDir(),
+                                    _T("omaha_benchmarks_cache"))),
+        package_path_(ConcatenatePath(app_util::GetTempDir(),
+                                      _T("omaha_benchmarks_package.exe"))),
+        key_(kAppId, kVersion, kPackageName) {}
+
+  ~PackageCacheFixture() {
+    ::DeleteFile(package_path_);
+    DeleteDirectory(cache_root_);
+  }
+
+  HRESULT Initialize() {
+    std::vector<byte> package(kPackageSize);
+    for (size_t i = 0; i != package.size(); ++i) {
+      package[i] = static_cast<byte>(i * 31);
+    }
+    uint8 digest[SHA256_DIGEST_SIZE] = {};
+    SHA256_hash(&package.front(), package.size(), digest);
+    hash_ = BytesToHex(digest, arraysize(digest));
+
+    HRESULT hr = WriteEntireFile(package_path_, package);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    return package_cache_.Initialize(cache_root_);
+  }
+
+  // Puts the package from an open file, like DownloadManager::CachePackage.
+  HRESULT PutOpenFile() {
+    File file;
+    HRESULT hr = file.OpenShareMode(package_path_, false, false,
+                                    FILE_SHARE_READ);
+    return SUCCEEDED(hr) ? package_cache_.Put(key_, &file, hash_) : hr;
+  }
+
+  // Puts the package from its path, like the offline installs.
+  HRESULT Put() {
+    bool is_moved = false;
+    return package_cache_.PutFile(key_, package_path_, hash_, false,
+                                  &is_moved);
+  }
+
+  PackageCache* package_cache() { return &package_cache_; }
+  const PackageCache::Key& key() const { return key_; }
+  const CString& hash() const { return hash_; }
+
+ private:
+  const CString cache_root_;
+  const CString package_path_;
+  const PackageCache::Key key_;
+  CString hash_;
+  PackageCache package_cache_;
+
+  DISALLOW_COPY_AND_ASSIGN(PackageCacheFixture);
+};
+
+// Creates a large file, and opens it for sequential reads.
+class LargeFileFixture {
+ public:
+  LargeFileFixture()
+      : path_(ConcatenatePath(app_util::GetTempDir(),
+                              _T("omaha_benchmarks_large.bin"))) {}
+
+  ~LargeFileFixture() {
+    file_.reset();
+    ::DeleteFile(path_);
+  }
+
+  HRESULT Initialize() {
+    std::vector<byte> chunk(kChunkSize, 0x5a);
+    File file;
+    HRESULT hr = file.Open(path_, true, false);
+    if (SUCCEEDED(hr)) {
+      hr = file.Preallocate(kLargeFileSize);
+    }
+    for (uint32 offset = 0;
+         SUCCEEDED(hr) && offset != kLargeFileSize;
+         offset += kChunkSize) {
+      hr = file.WriteAt64(offset, &chunk.front(), kChunkSize, NULL);
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+    VERIFY_SUCCEEDED(file.Close());
+
+    file_.reset(new File);
+    return file_->OpenWithAccessPattern(path_,
+                                        false,
+                                        FILE_SHARE_READ,
+                                        File::SEQUENTIAL_ACCESS);
+  }
+
+  File* file() { return file_.get(); }
+
+ private:
+  const CString path_;
+  std::unique_ptr<File> file_;
+
+  DISALLOW_COPY_AND_ASSIGN(LargeFileFixture);
+};
+
+}  // namespace
+
+OMAHA_BENCHMARK(TagExtractor_File) {
+  TaggedFile tagged_file;
+  if (FAILED(tagged_file.Create())) {
+    state->SkipWithError(_T("The file could not be tagged."));
+    return;
+  }
+
+  char tag[arraysize(kTag)] = {};
+  while (state->KeepRunning()) {
+    TagExtractor extractor;
+    int tag_length = arraysize(tag);
+    if (!extractor.OpenFile(tagged_file.path()) ||
+        !extractor.ExtractTag(tag, &tag_length)) {
+      state->SkipWithError(_T("The tag was not found."));
+    }
+    extractor.CloseFile();
+  }
+}
+
+OMAHA_BENCHMARK(TagExtractor_Buffer) {
+  TaggedFile tagged_file;
+  std::vector<byte> buffer;
+  if (FAILED(tagged_file.Create()) ||
+      FAILED(ReadEntireFile(tagged_file.path(), 0, &buffer))) {
+    state->SkipWithError(_T("The file could not be tagged."));
+    return;
+  }
+
+  char tag[arraysize(kTag)] = {};
+  state->SetBytesPerIteration(buffer.size());
+  while (state->KeepRunning()) {
+    TagExtractor extractor;
+    int tag_length = arraysize(tag);
+    if (!extractor.ExtractTag(reinterpret_cast<const char*>(&buffer.front()),
+                              buffer.size(),
+                              tag,
+                              &tag_length)) {
+      state->SkipWithError(_T("The tag was not found."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(PackageCachePutFile_1MB) {
+  PackageCacheFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The cache could not be created."));
+    return;
+  }
+
+  state->SetBytesPerIteration(kPackageSize);
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.Put())) {
+      state->SkipWithError(_T("The package was not put."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(PackageCachePut_1MB) {
+  PackageCacheFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The cache could not be created."));
+    return;
+  }
+
+  state->SetBytesPerIteration(kPackageSize);
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.PutOpenFile())) {
+      state->SkipWithError(_T("The package was not put."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(PackageCacheIsCached_1MB) {
+  PackageCacheFixture fixture;
+  if (FAILED(fixture.Initialize()) || FAILED(fixture.Put())) {
+    state->SkipWithError(_T("The cache could not be created."));
+    return;
+  }
+
+  state->SetBytesPerIteration(kPackageSize);
+  while (state->KeepRunning()) {
+    if (!fixture.package_cache()->IsCached(fixture.key(), fixture.hash())) {
+      state->SkipWithError(_T("The package is not cached."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(PackageCacheGet_1MB) {
+  PackageCacheFixture fixture;
+  if (FAILED(fixture.Initialize()) || FAILED(fixture.Put())) {
+    state->SkipWithError(_T("The cache could not be created."));
+    return;
+  }
+
+  const CString destination(ConcatenatePath(app_util::GetTempDir(),
+                                            _T("omaha_benchmarks_get.exe")));
+  state->SetBytesPerIteration(kPackageSize);
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.package_cache()->Get(fixture.key(),
+                                            destination,
+                                            fixture.hash()))) {
+      state->SkipWithError(_T("The package was not copied."));
+    }
+  }
+  ::DeleteFile(destination);
+}
+
+OMAHA_BENCHMARK(FileReadAt64_16MB) {
+  LargeFileFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The file could not be created."));
+    return;
+  }
+
+  std::vector<byte> buffer(kChunkSize);
+  state->SetBytesPerIteration(kLargeFileSize);
+  while (state->KeepRunning()) {
+    uint32 sum = 0;
+    for (uint32 offset = 0; offset != kLargeFileSize; offset += kChunkSize) {
+      uint32 bytes_read = 0;
+      if (FAILED(fixture.file()->ReadAt64(offset,
+                                          &buffer.front(),
+                                          kChunkSize,
+                                          &bytes_read))) {
+        state->SkipWithError(_T("The file could not be read."));
+        return;
+      }
+      for (uint32 i = 0; i != bytes_read; ++i) {
+        sum += buffer[i];
+      }
+    }
+    state->DoNotOptimize(sum);
+  }
+}
+
+OMAHA_BENCHMARK(MappedFileView_16MB) {
+  LargeFileFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The file could not be created."));
+    return;
+  }
+
+  state->SetBytesPerIteration(kLargeFileSize);
+  while (state->KeepRunning()) {
+    MappedFileView view;
+    if (FAILED(view.Map(fixture.file(), 0, 0))) {
+      state->SkipWithError(_T("The file could not be mapped."));
+      return;
+    }
+    uint32 sum = 0;
+    for (size_t i = 0; i != view.length(); ++i) {
+      sum += view.data()[i];
+    }
+    state->DoNotOptimize(sum);
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,178 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmark for the decompression of the metainstaller payload. The payload
+// is packed like the build packs it: BCJ2 filtered, then LZMA compressed. The
+// benchmark binary itself stands in for the x86 code of the payload.
+
+#include <string>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/debug.h"
+#include "omaha/base/utils.h"
+#include "omaha/mi_exe_stub/x86_encoder/bcj2_encoder.h"
+#include "omaha/testing/benchmark.h"
+
+extern "C" {
+#include "third_party/lzma/files/C/Bcj2.h"
+#include "third_party/lzma/files/C/LzmaDec.h"
+#include "third_party/lzma/files/C/LzmaEnc.h"
+}
+
+namespace omaha {
+
+namespace {
+
+void* Alloc(void* p, size_t size) {
+  UNREFERENCED_PARAMETER(p);
+  return new uint8[size];
+}
+
+void Free(void* p, void* address) {
+  UNREFERENCED_PARAMETER(p);
+  delete[] address;
+}
+
+ISzAlloc allocators = { &Alloc, &Free };
+
+void AppendUint32(uint32 value, std::string* buffer) {
+  buffer->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Packs |input| like the metainstaller payload: the LZMA properties, the
+// unpacked size, then the LZMA data of the BCJ2 header and streams.
+bool Pack(const std::vector<uint8>& input, std::vector<uint8>* packed) {
+  ASSERT1(packed);
+
+  std::string streams[4];
+  if (!Bcj2Encode(std::string(input.begin(), input.end()),
+                  &streams[0],
+                  &streams[1],
+                  &streams[2],
+                  &streams[3])) {
+    return false;
+  }
+
+  std::string unpacked;
+  AppendUint32(static_cast<uint32>(input.size()), &unpacked);
+  for (size_t i = 0; i != arraysize(streams); ++i) {
+    AppendUint32(static_cast<uint32>(streams[i].size()), &unpacked);
+  }
+  for (size_t i = 0; i != arraysize(streams); ++i) {
+    unpacked += streams[i];
+  }
+
+  CLzmaEncProps props;
+  LzmaEncProps_Init(&props);
+  props.level = 9;
+
+  const uint64 unpacked_size = unpacked.size();
+  const size_t header_size = LZMA_PROPS_SIZE + sizeof(unpacked_size);
+  packed->resize(header_size + unpacked.size() + unpacked.size() / 2 + 1024);
+  SizeT props_size = LZMA_PROPS_SIZE;
+  SizeT data_size = packed->size() - header_size;
+  if (LzmaEncode(&packed->front() + header_size,
+                 &data_size,
+                 reinterpret_cast<const Byte*>(unpacked.data()),
+                 unpacked.size(),
+                 &props,
+                 &packed->front(),
+                 &props_size,
+                 0,
+                 NULL,
+                 &allocators,
+                 &allocators) != SZ_OK) {
+    return false;
+  }
+
+  memcpy(&packed->front() + LZMA_PROPS_SIZE,
+         &unpacked_size,
+         sizeof(unpacked_size));
+  packed->resize(header_size + data_size);
+  return true;
+}
+
+// Unpacks like MetaInstaller::DecompressBufferToFile, without the file.
+bool Unpack(const std::vector<uint8>& packed, std::vector<uint8>* output) {
+  ASSERT1(output);
+
+  const uint8* packed_buffer = &packed.front();
+  SizeT packed_size = packed.size() - LZMA_PROPS_SIZE - sizeof(uint64);
+  SizeT unpacked_size = static_cast<SizeT>(
+      *reinterpret_cast<const uint64*>(packed_buffer + LZMA_PROPS_SIZE));
+  std::vector<uint8> unpacked(unpacked_size);
+
+  CLzmaDec lzma_state;
+  LzmaDec_Construct(&lzma_state);
+  LzmaDec_Allocate(&lzma_state, packed_buffer, LZMA_PROPS_SIZE, &allocators);
+  LzmaDec_Init(&lzma_state);
+  ELzmaStatus status = static_cast<ELzmaStatus>(0);
+  const SRes result = LzmaDec_DecodeToBuf(
+      &lzma_state,
+      &unpacked.front(),
+      &unpacked_size,
+      packed_buffer + LZMA_PROPS_SIZE + sizeof(uint64),
+      &packed_size,
+      LZMA_FINISH_END,
+      &status);
+  LzmaDec_Free(&lzma_state, &allocators);
+  if (result != SZ_OK) {
+    return false;
+  }
+
+  const uint32* header = reinterpret_cast<const uint32*>(&unpacked.front());
+  const uint8* stream = &unpacked.front() + 5 * sizeof(uint32);
+  output->resize(header[0]);
+  return Bcj2_Decode(stream,
+                     header[1],
+                     stream + header[1],
+                     header[2],
+                     stream + header[1] + header[2],
+                     header[3],
+                     stream + header[1] + header[2] + header[3],
+                     header[4],
+                     &output->front(),
+                     header[0]) == SZ_OK;
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(LzmaBcj2Decode) {
+  std::vector<uint8> input;
+  std::vector<uint8> packed;
+  if (FAILED(ReadEntireFileShareMode(app_util::GetModulePath(NULL),
+                                     0,
+                                     FILE_SHARE_READ,
+                                     &input)) ||
+      !Pack(input, &packed)) {
+    state->SkipWithError(_T("The payload could not be packed."));
+    return;
+  }
+
+  std::vector<uint8> output;
+  state->SetBytesPerIteration(input.size());
+  while (state->KeepRunning()) {
+    if (!Unpack(packed, &output)) {
+      state->SkipWithError(_T("The payload did not unpack."));
+    }
+  }
+  if (state->error().IsEmpty() && output != input) {
+    state->SkipWithError(_T("The payload did not round trip."));
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,184 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the name/value files, such as the custom info files of the
+// crashes, with 1000 names. The profile API benchmarks are the reference for
+// the one-pass reader and writer of goopdate_utils.
+
+#include <map>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/name_value_file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/common/goopdate_utils.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR kSectionName[] = _T("ClientCustomData");
+const size_t kNumPairs = 1000;
+
+std::map<CString, CString> GetPairs() {
+  std::map<CString, CString> pairs;
+  for (size_t i = 0; i != kNumPairs; ++i) {
+    CString name;
+    SafeCStringFormat(&name, _T("name%04d"), static_cast<int>(i));
+    CString value;
+    SafeCStringFormat(&value, _T("value %d"), static_cast<int>(i));
+    pairs[name] = value;
+  }
+  return pairs;
+}
+
+// Writes a file with the pairs, in the temporary directory of the user.
+class NameValueFile {
+ public:
+  NameValueFile()
+      : path_(ConcatenatePath(app_util::GetTempDir(),
+                              _T("omaha_benchmarks_name_value.txt"))),
+        pairs_(GetPairs()) {}
+  ~NameValueFile() { ::DeleteFile(path_); }
+
+  HRESULT Create() {
+    ::DeleteFile(path_);
+    return goopdate_utils::WriteNameValuePairsToFile(path_,
+                                                     kSectionName,
+                                                     pairs_);
+  }
+
+  const CString& path() const { return path_; }
+  const std::map<CString, CString>& pairs() const { return pairs_; }
+
+ private:
+  const CString path_;
+  const std::map<CString, CString> pairs_;
+
+  DISALLOW_COPY_AND_ASSIGN(NameValueFile);
+};
+
+// Reads the pairs the way goopdate_utils::ReadNameValuePairsFromFile used
+// to: each value is read with a call to GetPrivateProfileString, which reads
+// the file again.
+void ReadPairsWithProfileApi(const CString& path,
+                             std::map<CString, CString>* pairs) {
+  pairs->clear();
+  std::vector<TCHAR> names(32768);
+  const DWORD names_length = ::GetPrivateProfileString(
+      kSectionName,
+      NULL,
+      NULL,
+      &names.front(),
+      static_cast<DWORD>(names.size()),
+      path);
+  for (DWORD offset = 0; offset < names_length;) {
+    const CString name(&names.front() + offset);
+    TCHAR value[1024] = {};
+    ::GetPrivateProfileString(kSectionName,
+                              name,
+                              NULL,
+                              value,
+                              arraysize(value),
+                              path);
+    (*pairs)[name] = value;
+    offset += name.GetLength() + 1;
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(ReadNameValuePairs_1000) {
+  NameValueFile file;
+  if (FAILED(file.Create())) {
+    state->SkipWithError(_T("The file could not be written."));
+    return;
+  }
+
+  std::map<CString, CString> pairs;
+  while (state->KeepRunning()) {
+    if (FAILED(goopdate_utils::ReadNameValuePairsFromFile(file.path(),
+                                                          kSectionName,
+                                                          &pairs)) ||
+        pairs.size() != kNumPairs) {
+      state->SkipWithError(_T("The pairs were not read."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(ReadNameValuePairsProfileApi_1000) {
+  NameValueFile file;
+  if (FAILED(file.Create())) {
+    state->SkipWithError(_T("The file could not be written."));
+    return;
+  }
+
+  std::map<CString, CString> pairs;
+  while (state->KeepRunning()) {
+    ReadPairsWithProfileApi(file.path(), &pairs);
+    if (pairs.size() != kNumPairs) {
+      state->SkipWithError(_T("The pairs were not read."));
+    }
+  }
+}
+
+// Parses the text of the file in memory, without copying the names and the
+// values.
+OMAHA_BENCHMARK(ParseNameValueSection_1000) {
+  CString text;
+  AppendNameValueSection(kSectionName, GetPairs(), &text);
+
+  std::vector<NameValueParser::Line> lines;
+  state->SetBytesPerIteration(text.GetLength() * sizeof(TCHAR));
+  while (state->KeepRunning()) {
+    NameValueParser parser(text, text.GetLength());
+    if (!parser.ReadSection(kSectionName, &lines) ||
+        lines.size() != kNumPairs) {
+      state->SkipWithError(_T("The section was not parsed."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(WriteNameValuePairs_1000) {
+  NameValueFile file;
+  while (state->KeepRunning()) {
+    if (FAILED(file.Create())) {
+      state->SkipWithError(_T("The file could not be written."));
+    }
+  }
+}
+
+OMAHA_BENCHMARK(WriteNameValuePairsProfileApi_1000) {
+  NameValueFile file;
+  while (state->KeepRunning()) {
+    ::DeleteFile(file.path());
+    for (std::map<CString, CString>::const_iterator it = file.pairs().begin();
+         it != file.pairs().end();
+         ++it) {
+      if (!::WritePrivateProfileString(kSectionName,
+                                       it->first,
+                                       it->second,
+                                       file.path())) {
+        state->SkipWithError(_T("The file could not be written."));
+        break;
+      }
+    }
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,135 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for draining the ping journal. Each iteration queues 1000
+// pings, each from a different session, then flushes them to a fake server
+// which takes a fixed amount of time per request. The pings are sent one at
+// a time, as SendPersistedPings used to, or merged into as few requests as
+// possible. The journal is in the temporary directory of the user.
+
+#include <memory>
+
+#include "base/basictypes.h"
+#include "omaha/base/file.h"
+#include "omaha/base/time.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/ping_coalescer.h"
+#include "omaha/common/ping_journal.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const int kNumPings = 1000;
+const int kServerLatencyMs = 2;
+
+// Accepts every request after |kServerLatencyMs|.
+class FakePingServer : public PingSenderInterface {
+ public:
+  FakePingServer() {}
+
+  virtual HRESULT SendPing(const HeadersVector& headers,
+                           const CString& request_string) {
+    UNREFERENCED_PARAMETER(headers);
+    UNREFERENCED_PARAMETER(request_string);
+    ::Sleep(kServerLatencyMs);
+    return S_OK;
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(FakePingServer);
+};
+
+CString BuildPingString(const CString& session_id,
+                        const CString& request_id,
+                        const CString& app_id) {
+  CString ping_string;
+  ping_string.Format(
+      _T("<?xml version=\"1.0\" encoding=\"UTF-8\"?>")
+      _T("<request protocol=\"3.0\" updater=\"Omaha\" ")
+      _T("updaterversion=\"1.3.99.0\" shell_version=\"1.3.99.0\" ")
+      _T("ismachine=\"0\" sessionid=\"%s\" installsource=\"ondemand\" ")
+      _T("requestid=\"%s\" dedup=\"cr\">")
+      _T("<hw physmemory=\"16\" sse=\"1\" sse2=\"1\"/>")
+      _T("<os platform=\"win\" version=\"10.0\" sp=\"\" arch=\"x64\"/>")
+      _T("<app appid=\"%s\" version=\"1.0.0.0\" nextversion=\"\" ")
+      _T("lang=\"en\" brand=\"GGLS\" client=\"\">")
+      _T("<event eventtype=\"2\" eventresult=\"1\" errorcode=\"0\" ")
+      _T("extracode1=\"0\"/></app></request>"),
+      session_id, request_id, app_id);
+  return ping_string;
+}
+
+HRESULT AppendPings(PingJournal* journal) {
+  for (int i = 0; i != kNumPings; ++i) {
+    CString session_id;
+    CString request_id;
+    CString app_id;
+    HRESULT hr = GetGuid(&session_id);
+    if (SUCCEEDED(hr)) {
+      hr = GetGuid(&request_id);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = GetGuid(&app_id);
+    }
+    if (SUCCEEDED(hr)) {
+      hr = journal->Append(PersistedPing(
+          request_id,
+          GetCurrent100NSTime(),
+          BuildPingString(session_id, request_id, app_id)));
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+  return S_OK;
+}
+
+// Queues and drains the pings, with requests of up to |max_request_length|
+// characters.
+void BenchmarkFlushPings(int max_request_length, benchmark::State* state) {
+  const CString file_path(GetTempFilename(_T("png")));
+  if (file_path.IsEmpty() || FAILED(File::Remove(file_path))) {
+    state->SkipWithError(_T("The journal could not be created."));
+    return;
+  }
+
+  std::unique_ptr<PingJournal> journal(new PingJournal(false, file_path));
+  FakePingServer server;
+  PingCoalescer coalescer(journal.get(), &server);
+  coalescer.set_max_request_length(max_request_length);
+  while (state->KeepRunning()) {
+    if (FAILED(AppendPings(journal.get())) || FAILED(coalescer.Flush())) {
+      state->SkipWithError(_T("The pings could not be sent."));
+      break;
+    }
+  }
+
+  journal.reset();
+  File::Remove(file_path);
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(FlushPings_1000Pings_OneAtATime) {
+  BenchmarkFlushPings(0, state);
+}
+
+OMAHA_BENCHMARK(FlushPings_1000Pings_Coalesced) {
+  BenchmarkFlushPings(PingCoalescer::kDefaultMaxRequestLength, state);
+}
+
+}  // namespace omaha
@@ -0,0 +1,134 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the progress of the apps, as the clients poll it. A client
+// used to get the progress from the COM server, which wrote three registry
+// values on every poll. The progress table is read from shared memory.
+
+#include "base/basictypes.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/common/progress_table.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR kCurrentStateKey[] =
+    _T("HKCU\\Software\\OmahaBenchmarks\\CurrentState");
+
+const GUID kAppGuid = {0x8a69d345, 0xd564, 0x463c,
+                       {0xaf, 0xf1, 0xa6, 0x9d, 0x9e, 0x53, 0x0f, 0x96}};
+
+// The number of apps in the table, as in a bundle which updates all apps.
+const int kNumApps = 20;
+
+AppProgress GetProgress(int app_index, uint64 bytes) {
+  AppProgress progress;
+  progress.app_guid = kAppGuid;
+  progress.app_guid.Data1 += app_index;
+  progress.state = STATE_DOWNLOADING;
+  progress.available_version = _T("1.2.3.4");
+  progress.bytes_downloaded = bytes;
+  progress.total_bytes_to_download = 1024 * 1024;
+  progress.download_time_remaining_ms = 1000;
+  return progress;
+}
+
+// Creates a table with kNumApps apps.
+HRESULT CreateTable(ProgressTable* table, CString* session_id) {
+  HRESULT hr = GetGuid(session_id);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  hr = table->Create(false, *session_id);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  for (int i = 0; i != kNumApps; ++i) {
+    hr = table->Write(GetProgress(i, 0));
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+  return S_OK;
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(WriteProgressTable) {
+  ProgressTable table;
+  CString session_id;
+  if (FAILED(CreateTable(&table, &session_id))) {
+    state->SkipWithError(_T("The table was not created."));
+    return;
+  }
+
+  uint64 bytes = 0;
+  while (state->KeepRunning()) {
+    table.Write(GetProgress(kNumApps - 1, ++bytes));
+  }
+}
+
+// Reads the last app of the table, which is the slowest to find.
+OMAHA_BENCHMARK(ReadProgressTable) {
+  ProgressTable writer;
+  CString session_id;
+  if (FAILED(CreateTable(&writer, &session_id))) {
+    state->SkipWithError(_T("The table was not created."));
+    return;
+  }
+
+  ProgressTable reader;
+  if (FAILED(reader.Open(false, session_id))) {
+    state->SkipWithError(_T("The table was not opened."));
+    return;
+  }
+
+  const GUID app_guid = GetProgress(kNumApps - 1, 0).app_guid;
+  AppProgress progress;
+  while (state->KeepRunning()) {
+    if (!reader.Read(app_guid, &progress)) {
+      state->SkipWithError(_T("The app was not found."));
+    }
+  }
+}
+
+// The registry values which the COM server wrote every time a client polled
+// the progress of a downloading app.
+OMAHA_BENCHMARK(WriteCurrentStateRegistry) {
+  DWORD bytes = 0;
+  while (state->KeepRunning()) {
+    if (FAILED(RegKey::SetValue(kCurrentStateKey,
+                                kRegValueStateValue,
+                                static_cast<DWORD>(STATE_DOWNLOADING))) ||
+        FAILED(RegKey::SetValue(kCurrentStateKey,
+                                kRegValueDownloadTimeRemainingMs,
+                                static_cast<DWORD>(1000))) ||
+        FAILED(RegKey::SetValue(kCurrentStateKey,
+                                kRegValueDownloadProgressPercent,
+                                ++bytes % 100))) {
+      state->SkipWithError(_T("The registry was not written."));
+    }
+  }
+
+  RegKey::DeleteKey(_T("HKCU\\Software\\OmahaBenchmarks"));
+}
+
+}  // namespace omaha
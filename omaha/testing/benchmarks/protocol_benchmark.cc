@@ -0,0 +1,120 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the serialization of the update requests, the parsing of
+// the update responses, and the parsing of the experiment labels. The
+// requests are synthesized like the load generator does, so that they have
+// the apps, cohorts, and pings of real clients.
+
+#include <memory>
+#include <vector>
+
+#include "omaha/base/string.h"
+#include "omaha/common/experiment_labels.h"
+#include "omaha/common/update_request.h"
+#include "omaha/common/update_response.h"
+#include "omaha/common/xml_parser.h"
+#include "omaha/testing/benchmark.h"
+#include "omaha/tools/loadgen/request_population.h"
+
+namespace omaha {
+
+namespace {
+
+const int kClientIndex = 7;
+
+// A label set with the number of labels of a busy app.
+const TCHAR kLabels[] =
+    _T("label_a=value_a|Wed, 31 Dec 2036 23:59:59 GMT;")
+    _T("label_b=value_b|Wed, 31 Dec 2036 23:59:59 GMT;")
+    _T("label_c=value_c|Wed, 31 Dec 2036 23:59:59 GMT;")
+    _T("label_d=value_d|Wed, 31 Dec 2036 23:59:59 GMT;")
+    _T("label_e=value_e|Wed, 31 Dec 2036 23:59:59 GMT");
+
+PopulationConfig GetPopulationConfig() {
+  PopulationConfig config;
+  config.max_apps_per_client = 8;
+  config.ping_event_percent = 50;
+  return config;
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(XmlSerializeRequest) {
+  std::unique_ptr<xml::UpdateRequest> update_request(
+      RequestPopulation(GetPopulationConfig()).CreateRequest(kClientIndex));
+
+  CString buffer;
+  while (state->KeepRunning()) {
+    if (FAILED(xml::XmlParser::SerializeRequest(*update_request, &buffer))) {
+      state->SkipWithError(_T("The request did not serialize."));
+    }
+  }
+  state->SetBytesPerIteration(WideToUtf8(buffer).GetLength());
+}
+
+OMAHA_BENCHMARK(XmlDeserializeResponse) {
+  std::unique_ptr<xml::UpdateRequest> update_request(
+      RequestPopulation(GetPopulationConfig()).CreateRequest(kClientIndex));
+  CString request_string;
+  if (FAILED(update_request->Serialize(&request_string))) {
+    state->SkipWithError(_T("The request did not serialize."));
+    return;
+  }
+
+  CStringA response_body;
+  BuildMockResponse(WideToUtf8(request_string), 50, 1, &response_body);
+  const std::vector<uint8> buffer(
+      response_body.GetString(),
+      response_body.GetString() + response_body.GetLength());
+
+  state->SetBytesPerIteration(buffer.size());
+  while (state->KeepRunning()) {
+    std::unique_ptr<xml::UpdateResponse> update_response(
+        xml::UpdateResponse::Create());
+    if (FAILED(xml::XmlParser::DeserializeResponse(buffer,
+                                                   update_response.get()))) {
+      state->SkipWithError(_T("The response did not parse."));
+    }
+  }
+}
+
+// Parses the labels and writes them without their expirations, as they are
+// sent in the update requests.
+OMAHA_BENCHMARK(ExperimentLabelsRemoveTimestamps) {
+  state->SetBytesPerIteration(arraysize(kLabels) - 1);
+  while (state->KeepRunning()) {
+    state->DoNotOptimize(
+        ExperimentLabels::RemoveTimestamps(kLabels).GetLength());
+  }
+}
+
+// Applies the labels of an update response to the labels of an app.
+OMAHA_BENCHMARK(ExperimentLabelsMerge) {
+  const CString new_labels(
+      _T("label_b=value_x|Wed, 31 Dec 2036 23:59:59 GMT;")
+      _T("label_f=value_f|Wed, 31 Dec 2036 23:59:59 GMT"));
+
+  CString merged_labels;
+  while (state->KeepRunning()) {
+    if (!ExperimentLabels::MergeLabelSets(kLabels,
+                                          new_labels,
+                                          &merged_labels)) {
+      state->SkipWithError(_T("The labels did not merge."));
+    }
+  }
+}
+
+}  // namespace omaha
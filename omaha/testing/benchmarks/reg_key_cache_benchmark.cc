@@ -0,0 +1,124 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for reading two values of a key with the static RegKey
+// functions, which open the key for each read unless the key is cached, and
+// with RegKey::GetValues, which reads both values from one open key. The key
+// is created under the benchmarks key of HKCU and deleted afterwards.
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/reg_key.h"
+#include "omaha/base/reg_key_cache.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+#define kKeyTree  _T("HKCU\\Software\\") PATH_COMPANY_NAME _T("\\") \
+                  PRODUCT_NAME _T("\\Benchmarks\\RegKeyCache")
+#define kKey      kKeyTree _T("\\Key")
+
+const TCHAR kValueNameDword[] = _T("dword");
+const TCHAR kValueNameString[] = _T("string");
+
+// Creates the key and its values, and caches the keys under |kKeyTree| if
+// |is_cached|.
+class KeyFixture {
+ public:
+  explicit KeyFixture(bool is_cached) : is_cached_(is_cached) {}
+
+  ~KeyFixture() {
+    if (is_cached_) {
+      RegKeyCache::Instance().set_cached_key_trees(std::vector<CString>());
+    }
+    RegKey::DeleteKey(kKeyTree);
+  }
+
+  HRESULT Initialize() {
+    HRESULT hr = RegKey::SetValue(kKey,
+                                  kValueNameDword,
+                                  static_cast<DWORD>(1));
+    if (SUCCEEDED(hr)) {
+      hr = RegKey::SetValue(kKey, kValueNameString, _T("foo"));
+    }
+    if (SUCCEEDED(hr) && is_cached_) {
+      RegKeyCache::Instance().set_cached_key_trees(
+          std::vector<CString>(1, kKeyTree));
+    }
+    return hr;
+  }
+
+ private:
+  const bool is_cached_;
+
+  DISALLOW_COPY_AND_ASSIGN(KeyFixture);
+};
+
+void BenchmarkGetValue(bool is_cached, benchmark::State* state) {
+  KeyFixture fixture(is_cached);
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The key could not be created."));
+    return;
+  }
+
+  while (state->KeepRunning()) {
+    DWORD dword_value = 0;
+    CString string_value;
+    if (FAILED(RegKey::GetValue(kKey, kValueNameDword, &dword_value)) ||
+        FAILED(RegKey::GetValue(kKey, kValueNameString, &string_value))) {
+      state->SkipWithError(_T("The values could not be read."));
+      return;
+    }
+    state->DoNotOptimize(dword_value);
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(RegKeyGetValue_2Values_Uncached) {
+  BenchmarkGetValue(false, state);
+}
+
+OMAHA_BENCHMARK(RegKeyGetValue_2Values_Cached) {
+  BenchmarkGetValue(true, state);
+}
+
+OMAHA_BENCHMARK(RegKeyGetValues_2Values_Cached) {
+  KeyFixture fixture(true);
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The key could not be created."));
+    return;
+  }
+
+  while (state->KeepRunning()) {
+    DWORD dword_value = 0;
+    CString string_value;
+    RegKey::ValueRequest values[] = {
+      {kValueNameDword, REG_DWORD, &dword_value, S_OK},
+      {kValueNameString, REG_SZ, &string_value, S_OK},
+    };
+    if (FAILED(RegKey::GetValues(kKey, values, arraysize(values)))) {
+      state->SkipWithError(_T("The values could not be read."));
+      return;
+    }
+    state->DoNotOptimize(dword_value);
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,91 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the scheduler of the core over a population of 100000
+// simulated clients, with the schedule of the update worker and of the code
+// red check, at fixed intervals or with jitter and coalescing. The time per
+// iteration is the time to simulate the population for two days. The label
+// reports the wakeups per hour of a client while it is awake, and the mean,
+// the 99th percentile and the peak of the requests which reach the server
+// per minute.
+
+#include <algorithm>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/testing/benchmark.h"
+#include "omaha/testing/scheduler_simulation.h"
+
+namespace omaha {
+
+namespace {
+
+const int kNumClients = 100000;
+
+void BenchmarkSimulation(bool is_spread, benchmark::State* state) {
+  SchedulerSimulationResult result;
+  while (state->KeepRunning()) {
+    if (FAILED(SimulateSchedulerClients(kNumClients, is_spread, &result))) {
+      state->SkipWithError(_T("The work could not be scheduled."));
+      return;
+    }
+    state->DoNotOptimize(result.wakeups);
+  }
+  if (result.arrivals.empty() || !result.awake_minutes) {
+    return;
+  }
+
+  // The clients are asleep during the night, so the minutes without arrivals
+  // are not counted in the distribution.
+  std::vector<int> arrivals;
+  for (size_t i = 0; i != result.arrivals.size(); ++i) {
+    if (result.arrivals[i]) {
+      arrivals.push_back(result.arrivals[i]);
+    }
+  }
+  std::sort(arrivals.begin(), arrivals.end());
+
+  const double wakeups_per_hour = 60.0 * result.wakeups /
+                                  (static_cast<double>(kNumClients) *
+                                   result.awake_minutes);
+  const double mean_arrivals = static_cast<double>(result.requests) /
+                               result.awake_minutes;
+  const int p99_arrivals =
+      arrivals.empty() ? 0 : arrivals[arrivals.size() * 99 / 100];
+  const int peak_arrivals = arrivals.empty() ? 0 : arrivals.back();
+
+  CString label;
+  SafeCStringFormat(&label,
+                    _T("%.2f wakeups/hour, arrivals/minute mean %.1f, ")
+                    _T("p99 %d, peak %d"),
+                    wakeups_per_hour,
+                    mean_arrivals,
+                    p99_arrivals,
+                    peak_arrivals);
+  state->SetLabel(label);
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(SchedulerSimulation_100000Clients_FixedIntervals) {
+  BenchmarkSimulation(false, state);
+}
+
+OMAHA_BENCHMARK(SchedulerSimulation_100000Clients_JitterAndCoalescing) {
+  BenchmarkSimulation(true, state);
+}
+
+}  // namespace omaha
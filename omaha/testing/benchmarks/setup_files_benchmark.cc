@@ -0,0 +1,207 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for the file operations of Setup on the language files of this
+// build, which are next to the benchmarks. Copying the files with FileCopier
+// is compared with File::Copy followed by a comparison of the files, and
+// with comparing them to up to date copies, which is what a self-update over
+// the same version does. The copies are in the temporary directory of the
+// user and deleted afterwards.
+
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/app_util.h"
+#include "omaha/base/file.h"
+#include "omaha/base/path.h"
+#include "omaha/base/utils.h"
+#include "omaha/setup/file_copier.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const int kMaxCompareThreads = 4;
+const int kMaxCopyThreads = 4;
+
+// Finds the language files and copies them to a temporary directory.
+class LanguageFilesFixture {
+ public:
+  LanguageFilesFixture()
+      : destination_dir_(ConcatenatePath(app_util::GetTempDir(),
+                                         _T("omaha_benchmarks_setup"))),
+        num_bytes_(0) {}
+
+  ~LanguageFilesFixture() {
+    DeleteDirectory(destination_dir_);
+  }
+
+  HRESULT Initialize() {
+    const CString source_dir(app_util::GetCurrentModuleDirectory());
+    std::vector<CString> file_names;
+    HRESULT hr = FindFiles(source_dir, _T("goopdateres_*.dll"), &file_names);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    if (file_names.empty()) {
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+
+    DeleteDirectory(destination_dir_);
+    hr = CreateDir(destination_dir_, NULL);
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    for (size_t i = 0; i != file_names.size(); ++i) {
+      source_paths_.push_back(ConcatenatePath(source_dir, file_names[i]));
+      destination_paths_.push_back(
+          ConcatenatePath(destination_dir_, file_names[i]));
+    }
+    hr = CopyAll();
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    for (size_t i = 0; i != source_paths_.size(); ++i) {
+      uint32 file_size = 0;
+      hr = File::GetFileSizeUnopen(source_paths_[i], &file_size);
+      if (FAILED(hr)) {
+        return hr;
+      }
+      num_bytes_ += file_size;
+    }
+    return S_OK;
+  }
+
+  HRESULT CopyAll() {
+    for (size_t i = 0; i != source_paths_.size(); ++i) {
+      HRESULT hr = File::Copy(source_paths_[i], destination_paths_[i], true);
+      if (FAILED(hr)) {
+        return hr;
+      }
+    }
+    return S_OK;
+  }
+
+  HRESULT CopyAllWithFileCopier() {
+    FileCopier file_copier(kMaxCopyThreads);
+    size_t failed_index = 0;
+    return file_copier.CopyFiles(source_paths_,
+                                 destination_paths_,
+                                 &failed_index);
+  }
+
+  bool AreAllIdentical(int max_threads) {
+    std::vector<bool> are_identical;
+    File::AreFilesIdentical(source_paths_,
+                            destination_paths_,
+                            max_threads,
+                            &are_identical);
+    for (size_t i = 0; i != are_identical.size(); ++i) {
+      if (!are_identical[i]) {
+        return false;
+      }
+    }
+    return are_identical.size() == source_paths_.size();
+  }
+
+  int64 num_bytes() const { return num_bytes_; }
+
+ private:
+  const CString destination_dir_;
+  std::vector<CString> source_paths_;
+  std::vector<CString> destination_paths_;
+  int64 num_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(LanguageFilesFixture);
+};
+
+void BenchmarkCompareLanguageFiles(int max_threads, benchmark::State* state) {
+  LanguageFilesFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The language files could not be copied."));
+    return;
+  }
+
+  state->SetBytesPerIteration(fixture.num_bytes());
+  while (state->KeepRunning()) {
+    if (!fixture.AreAllIdentical(max_threads)) {
+      state->SkipWithError(_T("The copies are not identical."));
+      return;
+    }
+  }
+}
+
+}  // namespace
+
+OMAHA_BENCHMARK(CopyLanguageFiles) {
+  LanguageFilesFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The language files could not be copied."));
+    return;
+  }
+
+  state->SetBytesPerIteration(fixture.num_bytes());
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.CopyAll())) {
+      state->SkipWithError(_T("The language files could not be copied."));
+      return;
+    }
+  }
+}
+
+OMAHA_BENCHMARK(CopyAndCompareLanguageFiles) {
+  LanguageFilesFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The language files could not be copied."));
+    return;
+  }
+
+  state->SetBytesPerIteration(fixture.num_bytes());
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.CopyAll()) || !fixture.AreAllIdentical(1)) {
+      state->SkipWithError(_T("The language files could not be copied."));
+      return;
+    }
+  }
+}
+
+OMAHA_BENCHMARK(FileCopierCopyLanguageFiles_4Threads) {
+  LanguageFilesFixture fixture;
+  if (FAILED(fixture.Initialize())) {
+    state->SkipWithError(_T("The language files could not be copied."));
+    return;
+  }
+
+  state->SetBytesPerIteration(fixture.num_bytes());
+  while (state->KeepRunning()) {
+    if (FAILED(fixture.CopyAllWithFileCopier())) {
+      state->SkipWithError(_T("The language files could not be copied."));
+      return;
+    }
+  }
+}
+
+OMAHA_BENCHMARK(CompareLanguageFiles_OneThread) {
+  BenchmarkCompareLanguageFiles(1, state);
+}
+
+OMAHA_BENCHMARK(CompareLanguageFiles_4Threads) {
+  BenchmarkCompareLanguageFiles(kMaxCompareThreads, state);
+}
+
+}  // namespace omaha
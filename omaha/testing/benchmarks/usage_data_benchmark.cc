@@ -0,0 +1,216 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Benchmarks for reading the did run values of 50 apps on a terminal server
+// with 1000 users, from an in-memory registry. Each registry operation costs
+// a map lookup instead of a system call, so the benchmarks mostly compare the
+// number of operations: ApplicationUsageData reads the key of each app under
+// each user, while UsageDataCollector enumerates the ClientState key of each
+// user and only reads the keys which changed.
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/constants.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/utils.h"
+#include "omaha/goopdate/usage_data_collector.h"
+#include "omaha/testing/benchmark.h"
+
+namespace omaha {
+
+namespace {
+
+const int kNumUsers = 1000;
+const int kNumApps = 50;
+
+// Every user has the same apps. One user in ten ran each app.
+class UsersUsageDataBackend : public UsageDataBackendInterface {
+ public:
+  UsersUsageDataBackend() {
+    for (int i = 0; i != kNumUsers; ++i) {
+      CString sid;
+      SafeCStringFormat(&sid, _T("S-1-5-21-1-2-3-%d"), 1000 + i);
+      user_key_names_.push_back(sid);
+
+      CString key_name(AppendRegKeyPath(USERS_KEY,
+                                        sid,
+                                        GOOPDATE_REG_RELATIVE_CLIENT_STATE));
+      key_name.MakeLower();
+      users_[key_name] = i;
+    }
+
+    for (int i = 0; i != kNumApps; ++i) {
+      RegistrySubkeyInfo app;
+      SafeCStringFormat(&app.name,
+                        _T("{%08X-0000-0000-0000-000000000000}"),
+                        i);
+      app.last_write_time.dwLowDateTime = i;
+      app.last_write_time.dwHighDateTime = 0;
+      apps_.push_back(app);
+    }
+  }
+
+  const std::vector<RegistrySubkeyInfo>& apps() const { return apps_; }
+
+  virtual HRESULT GetUserKeyNames(std::vector<CString>* user_key_names) {
+    *user_key_names = user_key_names_;
+    return S_OK;
+  }
+
+  virtual HRESULT GetSubkeys(const CString& key_name,
+                             std::vector<RegistrySubkeyInfo>* subkeys) {
+    if (FindUser(key_name) == -1) {
+      subkeys->clear();
+      return S_FALSE;
+    }
+    *subkeys = apps_;
+    return S_OK;
+  }
+
+  virtual HRESULT ReadDidRun(const CString& key_name, bool* did_run) {
+    const int separator = key_name.ReverseFind(_T('\\'));
+    const int user = FindUser(key_name.Left(separator + 1));
+    if (user == -1) {
+      return HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+    }
+    *did_run = user % 10 == 0;
+    return S_OK;
+  }
+
+  virtual HRESULT ClearDidRun(const CString&) { return S_OK; }
+
+  virtual HRESULT DeleteDidRun(const CString&) { return S_OK; }
+
+ private:
+  int FindUser(const CString& key_name) const {
+    CString lower_key_name(key_name);
+    lower_key_name.MakeLower();
+    std::map<CString, int>::const_iterator it = users_.find(lower_key_name);
+    return it == users_.end() ? -1 : it->second;
+  }
+
+  std::vector<CString> user_key_names_;
+  std::map<CString, int> users_;
+  std::vector<RegistrySubkeyInfo> apps_;
+
+  DISALLOW_COPY_AND_ASSIGN(UsersUsageDataBackend);
+};
+
+// Reads the did run values the way ApplicationUsageData does, one app at a
+// time.
+ActiveStates ReadDidRunPerApp(const CString& app_id,
+                              UsersUsageDataBackend* backend) {
+  std::vector<CString> user_key_names;
+  backend->GetUserKeyNames(&user_key_names);
+
+  ActiveStates state = ACTIVE_UNKNOWN;
+  for (size_t i = 0; i != user_key_names.size(); ++i) {
+    const CString key_name(AppendRegKeyPath(
+        AppendRegKeyPath(USERS_KEY,
+                         user_key_names[i],
+                         GOOPDATE_REG_RELATIVE_CLIENT_STATE),
+        app_id));
+    bool did_run = false;
+    if (SUCCEEDED(backend->ReadDidRun(key_name, &did_run))) {
+      state = (did_run || state == ACTIVE_RUN) ? ACTIVE_RUN : ACTIVE_NOTRUN;
+    }
+  }
+  return state;
+}
+
+// Lets the collectors use the same backend, so that the benchmarks do not
+// build the registry again.
+class BorrowedUsageDataBackend : public UsageDataBackendInterface {
+ public:
+  explicit BorrowedUsageDataBackend(UsageDataBackendInterface* backend)
+      : backend_(backend) {}
+
+  virtual HRESULT GetUserKeyNames(std::vector<CString>* user_key_names) {
+    return backend_->GetUserKeyNames(user_key_names);
+  }
+  virtual HRESULT GetSubkeys(const CString& key_name,
+                             std::vector<RegistrySubkeyInfo>* subkeys) {
+    return backend_->GetSubkeys(key_name, subkeys);
+  }
+  virtual HRESULT ReadDidRun(const CString& key_name, bool* did_run) {
+    return backend_->ReadDidRun(key_name, did_run);
+  }
+  virtual HRESULT ClearDidRun(const CString& key_name) {
+    return backend_->ClearDidRun(key_name);
+  }
+  virtual HRESULT DeleteDidRun(const CString& key_name) {
+    return backend_->DeleteDidRun(key_name);
+  }
+
+ private:
+  UsageDataBackendInterface* const backend_;
+
+  DISALLOW_COPY_AND_ASSIGN(BorrowedUsageDataBackend);
+};
+
+UsageDataCollector* CreateCollector(UsersUsageDataBackend* backend) {
+  return new UsageDataCollector(
+      true,
+      false,
+      std::make_unique<BorrowedUsageDataBackend>(backend));
+}
+
+}  // namespace
+
+// 50 enumerations of HKU and 50000 reads.
+OMAHA_BENCHMARK(ReadDidRunPerApp_1000Users_50Apps) {
+  UsersUsageDataBackend backend;
+  while (state->KeepRunning()) {
+    for (size_t i = 0; i != backend.apps().size(); ++i) {
+      if (ReadDidRunPerApp(backend.apps()[i].name, &backend) != ACTIVE_RUN) {
+        state->SkipWithError(_T("The did run value was not read."));
+      }
+    }
+  }
+}
+
+// The first sweep: 1000 enumerations and 50000 reads.
+OMAHA_BENCHMARK(CollectDidRunFirstSweep_1000Users_50Apps) {
+  UsersUsageDataBackend backend;
+  while (state->KeepRunning()) {
+    std::unique_ptr<UsageDataCollector> collector(CreateCollector(&backend));
+    if (FAILED(collector->Collect()) ||
+        collector->num_values_read() != kNumUsers * kNumApps) {
+      state->SkipWithError(_T("The did run values were not read."));
+    }
+  }
+}
+
+// The next sweeps, with no changes: 1000 enumerations and no reads.
+OMAHA_BENCHMARK(CollectDidRunIncrementalSweep_1000Users_50Apps) {
+  UsersUsageDataBackend backend;
+  std::unique_ptr<UsageDataCollector> collector(CreateCollector(&backend));
+  if (FAILED(collector->Collect())) {
+    state->SkipWithError(_T("The did run values were not read."));
+    return;
+  }
+
+  while (state->KeepRunning()) {
+    if (FAILED(collector->Collect()) ||
+        collector->num_values_read() != kNumUsers * kNumApps) {
+      state->SkipWithError(_T("The did run values were read again."));
+    }
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,323 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/testing/local_http_server.h"
+
+#include <stdlib.h>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/safe_format.h"
+
+namespace omaha {
+
+namespace {
+
+const char kResponse[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 2\r\n"
+    "\r\n"
+    "ok";
+
+const char kHeadersEnd[] = "\r\n\r\n";
+const int kHeadersEndLength = static_cast<int>(arraysize(kHeadersEnd) - 1);
+const char kLineEnd[] = "\r\n";
+const int kLineEndLength = static_cast<int>(arraysize(kLineEnd) - 1);
+
+// Sends all of |buffer|. Returns false if the connection failed.
+bool SendAll(SOCKET socket, const char* buffer, int length) {
+  while (length > 0) {
+    const int bytes_sent = ::send(socket, buffer, length, 0);
+    if (bytes_sent <= 0) {
+      return false;
+    }
+    buffer += bytes_sent;
+    length -= bytes_sent;
+  }
+  return true;
+}
+
+}  // namespace
+
+CStringA LocalHttpServer::Request::GetHeader(const char* name) const {
+  ASSERT1(name);
+
+  CStringA lower_headers(headers);
+  lower_headers.MakeLower();
+  CStringA prefix(name);
+  prefix.MakeLower();
+  prefix = kLineEnd + prefix + ":";
+
+  const int header_begin = lower_headers.Find(prefix);
+  if (header_begin == -1) {
+    return CStringA();
+  }
+  const int value_begin = header_begin + prefix.GetLength();
+  int value_end = headers.Find(kLineEnd, value_begin);
+  if (value_end == -1) {
+    value_end = headers.GetLength();
+  }
+
+  CStringA value(headers.Mid(value_begin, value_end - value_begin));
+  value.Trim();
+  return value;
+}
+
+LocalHttpServer::LocalHttpServer()
+    : listen_socket_(INVALID_SOCKET),
+      port_(0),
+      stopping_(0),
+      num_connections_accepted_(0),
+      num_requests_received_(0) {}
+
+LocalHttpServer::LocalHttpServer(int port)
+    : listen_socket_(INVALID_SOCKET),
+      port_(port),
+      stopping_(0),
+      num_connections_accepted_(0),
+      num_requests_received_(0) {}
+
+LocalHttpServer::~LocalHttpServer() {
+  Stop();
+}
+
+HRESULT LocalHttpServer::Start() {
+  WSADATA wsa_data = {};
+  if (::WSAStartup(MAKEWORD(2, 2), &wsa_data)) {
+    return E_FAIL;
+  }
+
+  listen_socket_ = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (listen_socket_ == INVALID_SOCKET) {
+    return HRESULTFromLastError();
+  }
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = ::htonl(INADDR_LOOPBACK);
+  address.sin_port = ::htons(static_cast<u_short>(port_));
+  int address_length = sizeof(address);
+  if (::bind(listen_socket_,
+             reinterpret_cast<sockaddr*>(&address),
+             sizeof(address)) ||
+      ::listen(listen_socket_, SOMAXCONN) ||
+      ::getsockname(listen_socket_,
+                    reinterpret_cast<sockaddr*>(&address),
+                    &address_length)) {
+    return E_FAIL;
+  }
+  port_ = ::ntohs(address.sin_port);
+
+  reset(thread_, ::CreateThread(NULL, 0, ThreadProc, this, 0, NULL));
+  return valid(thread_) ? S_OK : HRESULTFromLastError();
+}
+
+void LocalHttpServer::Stop() {
+  if (valid(thread_)) {
+    ::InterlockedExchange(&stopping_, 1);
+    VERIFY1(::WaitForSingleObject(get(thread_), INFINITE) == WAIT_OBJECT_0);
+    reset(thread_);
+  }
+
+  for (size_t i = 0; i != connections_.size(); ++i) {
+    ::closesocket(connections_[i].socket);
+  }
+  connections_.clear();
+
+  if (listen_socket_ != INVALID_SOCKET) {
+    ::closesocket(listen_socket_);
+    listen_socket_ = INVALID_SOCKET;
+    ::WSACleanup();
+  }
+}
+
+CString LocalHttpServer::url() const {
+  CString url;
+  SafeCStringFormat(&url, _T("http://127.0.0.1:%d/"), port_);
+  return url;
+}
+
+int LocalHttpServer::num_connections_accepted() const {
+  return ::InterlockedCompareExchange(
+      const_cast<volatile LONG*>(&num_connections_accepted_), 0, 0);
+}
+
+int LocalHttpServer::num_requests_received() const {
+  return ::InterlockedCompareExchange(
+      const_cast<volatile LONG*>(&num_requests_received_), 0, 0);
+}
+
+DWORD WINAPI LocalHttpServer::ThreadProc(void* context) {
+  static_cast<LocalHttpServer*>(context)->Serve();
+  return 0;
+}
+
+void LocalHttpServer::Serve() {
+  while (!::InterlockedCompareExchange(&stopping_, 0, 0)) {
+    fd_set read_set;
+    FD_ZERO(&read_set);
+    FD_SET(listen_socket_, &read_set);
+
+    // The connections over the size of a set wait for the next round.
+    for (size_t i = 0;
+         i != connections_.size() && read_set.fd_count < FD_SETSIZE;
+         ++i) {
+      FD_SET(connections_[i].socket, &read_set);
+    }
+
+    const timeval timeout = {0, 50000};  // 50 ms.
+    if (::select(0, &read_set, NULL, NULL, &timeout) <= 0) {
+      continue;
+    }
+
+    if (FD_ISSET(listen_socket_, &read_set)) {
+      Connection connection;
+      connection.socket = ::accept(listen_socket_, NULL, NULL);
+      if (connection.socket != INVALID_SOCKET) {
+        connections_.push_back(connection);
+        ::InterlockedIncrement(&num_connections_accepted_);
+      }
+    }
+
+    for (size_t i = 0; i < connections_.size();) {
+      if (FD_ISSET(connections_[i].socket, &read_set) &&
+          !Receive(&connections_[i])) {
+        ::closesocket(connections_[i].socket);
+        connections_.erase(connections_.begin() + i);
+      } else {
+        ++i;
+      }
+    }
+  }
+}
+
+bool LocalHttpServer::BuildResponse(const Request& request,
+                                    CStringA* response) {
+  UNREFERENCED_PARAMETER(request);
+  ASSERT1(response);
+
+  *response = kResponse;
+  return true;
+}
+
+bool LocalHttpServer::Receive(Connection* connection) {
+  ASSERT1(connection);
+
+  char buffer[16 * 1024] = {};
+  const int bytes_received = ::recv(connection->socket,
+                                    buffer,
+                                    sizeof(buffer),
+                                    0);
+  if (bytes_received <= 0) {
+    return false;
+  }
+  connection->received.Append(buffer, bytes_received);
+
+  Request request;
+  while (ParseRequest(&connection->received, &request)) {
+    ::InterlockedIncrement(&num_requests_received_);
+    CStringA response;
+    if (!BuildResponse(request, &response) ||
+        !SendAll(connection->socket,
+                 response.GetString(),
+                 response.GetLength())) {
+      return false;
+    }
+    request = Request();
+  }
+  return true;
+}
+
+bool LocalHttpServer::ParseRequest(CStringA* received, Request* request) {
+  ASSERT1(received);
+  ASSERT1(request);
+
+  const int headers_end = received->Find(kHeadersEnd);
+  if (headers_end == -1) {
+    return false;
+  }
+
+  const int request_line_end = received->Find(kLineEnd);
+  request->request_line = received->Left(request_line_end);
+  request->headers = received->Mid(request_line_end,
+                                   headers_end - request_line_end);
+  const int body_begin = headers_end + kHeadersEndLength;
+
+  CStringA transfer_encoding(request->GetHeader("Transfer-Encoding"));
+  transfer_encoding.MakeLower();
+  int body_end = body_begin;
+  if (transfer_encoding.Find("chunked") != -1) {
+    request->is_chunked = true;
+    body_end = ParseChunkedBody(*received, body_begin, request);
+    if (body_end == -1) {
+      return false;
+    }
+  } else {
+    const int content_length = atoi(request->GetHeader("Content-Length"));
+    if (content_length < 0 ||
+        received->GetLength() < body_begin + content_length) {
+      return false;
+    }
+    request->body = received->Mid(body_begin, content_length);
+    body_end = body_begin + content_length;
+  }
+
+  received->Delete(0, body_end);
+  return true;
+}
+
+int LocalHttpServer::ParseChunkedBody(const CStringA& received,
+                                      int pos,
+                                      Request* request) {
+  ASSERT1(request);
+
+  request->body.Empty();
+  request->num_chunks = 0;
+  for (;;) {
+    const int size_end = received.Find(kLineEnd, pos);
+    if (size_end == -1) {
+      return -1;
+    }
+
+    // The chunk extensions after the size are ignored.
+    const int chunk_size = static_cast<int>(
+        strtoul(received.GetString() + pos, NULL, 16));
+    const int data_begin = size_end + kLineEndLength;
+    if (!chunk_size) {
+      // The trailer fields end with an empty line.
+      for (pos = data_begin;;) {
+        const int line_end = received.Find(kLineEnd, pos);
+        if (line_end == -1) {
+          return -1;
+        }
+        if (line_end == pos) {
+          return line_end + kLineEndLength;
+        }
+        pos = line_end + kLineEndLength;
+      }
+    }
+
+    const int data_end = data_begin + chunk_size;
+    if (received.GetLength() < data_end + kLineEndLength) {
+      return -1;
+    }
+    request->body.Append(received.GetString() + data_begin, chunk_size);
+    ++request->num_chunks;
+    pos = data_end + kLineEndLength;
+  }
+}
+
+}  // namespace omaha
@@ -0,0 +1,112 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// A local http server for the tests and the benchmarks of the network code.
+// It listens on the loopback interface, reads the body of each request, with
+// a Content-Length or with the chunked transfer encoding, and keeps the
+// connections alive. It counts the connections it accepts and the requests it
+// receives. The requests get a short response, unless a derived class builds
+// the responses.
+
+#ifndef OMAHA_TESTING_LOCAL_HTTP_SERVER_H_
+#define OMAHA_TESTING_LOCAL_HTTP_SERVER_H_
+
+#include <winsock2.h>
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+class LocalHttpServer {
+ public:
+  LocalHttpServer();
+
+  // Listens on |port|, or on a free port if |port| is 0.
+  explicit LocalHttpServer(int port);
+  virtual ~LocalHttpServer();
+
+  HRESULT Start();
+  void Stop();
+
+  CString url() const;
+  int port() const { return port_; }
+  int num_connections_accepted() const;
+  int num_requests_received() const;
+
+ protected:
+  struct Request {
+    Request() : is_chunked(false), num_chunks(0) {}
+
+    // Returns the value of the header |name|, which is case insensitive, or
+    // an empty string if the request has no such header.
+    CStringA GetHeader(const char* name) const;
+
+    CStringA request_line;
+    CStringA headers;
+
+    // The body, without the chunked transfer encoding if |is_chunked|. In
+    // that case, |num_chunks| counts the chunks which are not empty.
+    CStringA body;
+    bool is_chunked;
+    int num_chunks;
+  };
+
+  // Builds the complete response to |request|. Called on the thread of the
+  // server, so the derived classes must Stop the server in their destructor.
+  // Returns false to close the connection instead.
+  virtual bool BuildResponse(const Request& request, CStringA* response);
+
+ private:
+  struct Connection {
+    SOCKET socket;
+    CStringA received;
+  };
+
+  static DWORD WINAPI ThreadProc(void* context);
+  void Serve();
+
+  // Reads from the connection and answers the complete requests. Returns
+  // false when the client has closed the connection.
+  bool Receive(Connection* connection);
+
+  // Moves the first complete request of |received| to |request|. Returns
+  // false if the request is not complete yet.
+  static bool ParseRequest(CStringA* received, Request* request);
+
+  // Reads the chunked body which starts at |pos| of |received|. Returns the
+  // end of the body, or -1 if the body is not complete yet.
+  static int ParseChunkedBody(const CStringA& received,
+                              int pos,
+                              Request* request);
+
+  SOCKET listen_socket_;
+  int port_;
+  scoped_handle thread_;
+  std::vector<Connection> connections_;   // Only used by the server thread.
+
+  volatile LONG stopping_;
+  volatile LONG num_connections_accepted_;
+  volatile LONG num_requests_received_;
+
+  DISALLOW_COPY_AND_ASSIGN(LocalHttpServer);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_TESTING_LOCAL_HTTP_SERVER_H_
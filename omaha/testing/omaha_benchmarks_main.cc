@@ -0,0 +1,177 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// Runs the benchmarks of the hot paths of Omaha and reports the time per
+// iteration of each of them. With /json, the results are also written to a
+// file, which can be kept as the baseline of the next release. With
+// /baseline, the results are compared to a previous run, and the program
+// fails if a benchmark is slower than its baseline by more than
+// /max_regression percent.
+//
+// omaha_benchmarks [/filter <substring>] [/json <file>]
+//                  [/baseline <file>] [/max_regression <percent>]
+//                  [/min_time_ms <ms>] [/repetitions <n>]
+
+#include <windows.h>
+#include <stdio.h>
+#include <tchar.h>
+#include <vector>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/utils.h"
+#include "omaha/testing/benchmark.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+
+namespace omaha {
+
+namespace {
+
+struct Options {
+  Options() : max_regression_percent(10) {}
+
+  benchmark::RunOptions run_options;
+  CString json_path;
+  CString baseline_path;
+  double max_regression_percent;
+};
+
+bool ParseOptions(int argc, TCHAR* argv[], Options* options) {
+  ASSERT1(argv);
+  ASSERT1(options);
+
+  for (int i = 1; i < argc; ++i) {
+    const TCHAR* name = argv[i];
+    if (i + 1 == argc) {
+      return false;
+    }
+    const TCHAR* value = argv[++i];
+    if (!_tcsicmp(name, _T("/filter"))) {
+      options->run_options.filter = value;
+    } else if (!_tcsicmp(name, _T("/json"))) {
+      options->json_path = value;
+    } else if (!_tcsicmp(name, _T("/baseline"))) {
+      options->baseline_path = value;
+    } else if (!_tcsicmp(name, _T("/max_regression"))) {
+      options->max_regression_percent = _tstof(value);
+    } else if (!_tcsicmp(name, _T("/min_time_ms"))) {
+      options->run_options.min_time_ms = _tstof(value);
+    } else if (!_tcsicmp(name, _T("/repetitions"))) {
+      options->run_options.repetitions = _ttoi(value);
+    } else {
+      return false;
+    }
+  }
+
+  return options->run_options.min_time_ms > 0 &&
+         options->run_options.repetitions > 0 &&
+         options->max_regression_percent >= 0;
+}
+
+HRESULT ReadBaseline(const CString& path,
+                     std::vector<benchmark::Result>* baseline) {
+  ASSERT1(baseline);
+
+  std::vector<byte> buffer;
+  HRESULT hr = ReadEntireFileShareMode(path, 0, FILE_SHARE_READ, &buffer);
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (buffer.empty()) {
+    return E_INVALIDARG;
+  }
+  const CStringA json(reinterpret_cast<const char*>(&buffer.front()),
+                      static_cast<int>(buffer.size()));
+  return benchmark::ResultsFromJson(json, baseline);
+}
+
+int DoMain(int argc, TCHAR* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    wprintf(_T("Usage: omaha_benchmarks [/filter <substring>] [/json <file>] ")
+            _T("[/baseline <file>] [/max_regression <percent>] ")
+            _T("[/min_time_ms <ms>] [/repetitions <n>]\n"));
+    return 1;
+  }
+
+  // The baseline is read first, so that a bad path fails before the run.
+  std::vector<benchmark::Result> baseline;
+  if (!options.baseline_path.IsEmpty()) {
+    HRESULT hr = ReadBaseline(options.baseline_path, &baseline);
+    if (FAILED(hr)) {
+      wprintf(_T("[Failed to read the baseline][%s][0x%08x]\n"),
+              options.baseline_path, hr);
+      return 1;
+    }
+  }
+
+  // The protocol benchmarks use MSXML.
+  scoped_co_init co_init(COINIT_MULTITHREADED);
+  VERIFY1(SUCCEEDED(co_init.hresult()));
+
+  std::vector<benchmark::Result> results;
+  benchmark::RunBenchmarks(options.run_options, &results);
+
+  int num_errors = 0;
+  for (size_t i = 0; i != results.size(); ++i) {
+    const benchmark::Result& result = results[i];
+    if (!result.error.IsEmpty()) {
+      ++num_errors;
+      wprintf(_T("%-36s [error][%s]\n"), result.name, result.error);
+    } else if (result.bytes_per_second) {
+      wprintf(_T("%-36s %14.1f ns %14.1f ns %10.1f MB/s\n"),
+              result.name, result.median_ns, result.min_ns,
+              result.bytes_per_second / (1024 * 1024));
+    } else {
+      wprintf(_T("%-36s %14.1f ns %14.1f ns\n"),
+              result.name, result.median_ns, result.min_ns);
+    }
+    if (!result.label.IsEmpty()) {
+      wprintf(_T("%-36s [%s]\n"), _T(""), result.label);
+    }
+  }
+
+  if (!options.json_path.IsEmpty()) {
+    const CStringA json(benchmark::ResultsToJson(results));
+    HRESULT hr = WriteEntireFile(
+        options.json_path,
+        std::vector<byte>(json.GetString(),
+                          json.GetString() + json.GetLength()));
+    if (FAILED(hr)) {
+      wprintf(_T("[Failed to write the results][%s][0x%08x]\n"),
+              options.json_path, hr);
+      return 1;
+    }
+  }
+
+  std::vector<CString> regressions;
+  benchmark::FindRegressions(baseline,
+                             results,
+                             options.max_regression_percent,
+                             &regressions);
+  for (size_t i = 0; i != regressions.size(); ++i) {
+    wprintf(_T("[Regression]%s\n"), regressions[i]);
+  }
+
+  return num_errors || !regressions.empty() ? 1 : 0;
+}
+
+}  // namespace
+
+}  // namespace omaha
+
+int _tmain(int argc, TCHAR* argv[]) {
+  return omaha::DoMain(argc, argv);
+}
@@ -0,0 +1,123 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/testing/scheduler_simulation.h"
+
+#include <algorithm>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/highres_timer-win32.h"
+
+namespace omaha {
+
+namespace {
+
+const uint64 kMinuteMs = 60 * 1000;
+const uint64 kHourMs = 60 * kMinuteMs;
+
+const uint64 kEndMs = 48 * kHourMs;
+const uint64 kSleepMs = 18 * kHourMs;
+const uint64 kResumeMs = 32 * kHourMs;
+const int kUpdateIntervalMs = static_cast<int>(kHourMs);
+const int kCodeRedIntervalMs = static_cast<int>(24 * kHourMs);
+
+}  // namespace
+
+FakeSchedulerClock::FakeSchedulerClock(uint32 seed)
+    : now_ms_(0), random_state_(seed ? seed : 1) {
+}
+
+uint64 FakeSchedulerClock::NowMs() {
+  return now_ms_;
+}
+
+uint32 FakeSchedulerClock::Random(uint32 range) {
+  random_state_ ^= random_state_ << 13;
+  random_state_ ^= random_state_ >> 17;
+  random_state_ ^= random_state_ << 5;
+  return range == UINT_MAX ? random_state_ : random_state_ % (range + 1);
+}
+
+void RunScheduler(const Scheduler& scheduler,
+                  FakeSchedulerClock* clock,
+                  uint64 sleep_ms,
+                  uint64 resume_ms,
+                  uint64 end_ms) {
+  ASSERT1(clock);
+
+  uint64 next_wakeup_ms = 0;
+  if (!scheduler.GetNextWakeup(&next_wakeup_ms)) {
+    return;
+  }
+  while (next_wakeup_ms < end_ms) {
+    if (next_wakeup_ms >= sleep_ms && next_wakeup_ms < resume_ms) {
+      next_wakeup_ms = resume_ms;
+    }
+    clock->set_now_ms(std::max(clock->NowMs(), next_wakeup_ms));
+    if (!scheduler.RunDueWork(&next_wakeup_ms)) {
+      return;
+    }
+  }
+}
+
+HRESULT SimulateSchedulerClients(int num_clients,
+                                 bool is_spread,
+                                 SchedulerSimulationResult* result) {
+  ASSERT1(num_clients > 0);
+  ASSERT1(result);
+
+  result->wakeups = 0;
+  result->requests = 0;
+  result->arrivals.assign(static_cast<size_t>(kEndMs / kMinuteMs), 0);
+  result->awake_minutes =
+      static_cast<int>((kEndMs - (kResumeMs - kSleepMs)) / kMinuteMs);
+
+  for (int client = 0; client != num_clients; ++client) {
+    FakeSchedulerClock clock(client + 1);
+    clock.set_now_ms(clock.Random(static_cast<uint32>(kHourMs)));
+    Scheduler scheduler(&clock);
+
+    auto request = [&clock, result](HighresTimer*) {
+      ++result->requests;
+      ++result->arrivals[static_cast<size_t>(clock.NowMs() / kMinuteMs)];
+    };
+    const int start_delay = static_cast<int>(
+        5 * kMinuteMs + clock.Random(static_cast<uint32>(10 * kMinuteMs)));
+    HRESULT hr = scheduler.StartWithJitter(
+        start_delay,
+        kUpdateIntervalMs,
+        is_spread ? kUpdateIntervalMs / 10 : 0,
+        0,
+        request);
+    if (SUCCEEDED(hr)) {
+      hr = scheduler.StartWithJitter(
+          kCodeRedIntervalMs,
+          kCodeRedIntervalMs,
+          is_spread ? kCodeRedIntervalMs / 24 : 0,
+          is_spread ? std::min(kUpdateIntervalMs, kCodeRedIntervalMs / 24) : 0,
+          request);
+    }
+    if (FAILED(hr)) {
+      return hr;
+    }
+
+    RunScheduler(scheduler, &clock, kSleepMs, kResumeMs, kEndMs);
+    result->wakeups += scheduler.wakeups();
+  }
+
+  return S_OK;
+}
+
+}  // namespace omaha
@@ -0,0 +1,81 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// A fake clock for the Scheduler, and a simulation of the schedule of the
+// core over a population of clients, for the tests and the benchmarks of the
+// Scheduler.
+
+#ifndef OMAHA_TESTING_SCHEDULER_SIMULATION_H_
+#define OMAHA_TESTING_SCHEDULER_SIMULATION_H_
+
+#include <windows.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/core/scheduler.h"
+
+namespace omaha {
+
+// A clock which only moves when it is told to, with repeatable random numbers.
+class FakeSchedulerClock : public SchedulerClock {
+ public:
+  explicit FakeSchedulerClock(uint32 seed);
+
+  virtual uint64 NowMs();
+  virtual uint32 Random(uint32 range);
+
+  void set_now_ms(uint64 now_ms) { now_ms_ = now_ms; }
+
+ private:
+  uint64 now_ms_;
+  uint32 random_state_;
+
+  DISALLOW_COPY_AND_ASSIGN(FakeSchedulerClock);
+};
+
+// Runs the scheduler until |end_ms|. The computer sleeps from |sleep_ms| to
+// |resume_ms|, and the wakeups due while it sleeps happen when it resumes.
+void RunScheduler(const Scheduler& scheduler,
+                  FakeSchedulerClock* clock,
+                  uint64 sleep_ms,
+                  uint64 resume_ms,
+                  uint64 end_ms);
+
+struct SchedulerSimulationResult {
+  SchedulerSimulationResult() : wakeups(0), requests(0), awake_minutes(0) {}
+
+  // The wakeups of all the clients, and the requests they send.
+  int64 wakeups;
+  int64 requests;
+
+  // The number of requests which reach the server in each minute.
+  std::vector<int> arrivals;
+
+  // The number of minutes the clients are awake.
+  int awake_minutes;
+};
+
+// Simulates |num_clients| clients for two days, with the schedule of the
+// update worker and of the code red check of the core. The clients start
+// during the first hour, and they all sleep during the night from 18:00 to
+// 8:00. The work runs at fixed intervals, as before, or with jitter and
+// coalescing if |is_spread|.
+HRESULT SimulateSchedulerClients(int num_clients,
+                                 bool is_spread,
+                                 SchedulerSimulationResult* result);
+
+}  // namespace omaha
+
+#endif  // OMAHA_TESTING_SCHEDULER_SIMULATION_H_
@@ -15,13 +15,17 @@
 
 #include "testing/unit_test.h"
 
+#include <vector>
+
 #include "omaha/base/app_util.h"
 #include "omaha/base/constants.h"
 #include "omaha/base/error.h"
+#include "omaha/base/file.h"
 #include "omaha/base/path.h"
 #include "omaha/base/process.h"
 #include "omaha/base/reg_key.h"
 #include "omaha/base/scope_guard.h"
+#include "omaha/base/signatures.h"
 #include "omaha/base/string.h"
 #include "omaha/base/system.h"
 #include "omaha/base/user_info.h"
@@ -372,6 +376,28 @@ void CreateFiles(const TCHAR* parent_dir,
   }
 }
 
+CString CreatePatternFile(const CString& file_path, uint32 size, int seed) {
+  std::vector<byte> data(size);
+  for (size_t i = 0; i != data.size(); ++i) {
+    data[i] = static_cast<byte>(i * 31 + seed);
+  }
+
+  if (File::Exists(file_path)) {
+    EXPECT_SUCCEEDED(File::Remove(file_path));
+  }
+  File file;
+  EXPECT_SUCCEEDED(file.Open(file_path, true, false));
+  if (size) {
+    EXPECT_SUCCEEDED(file.Write(&data.front(), size, NULL));
+  }
+  EXPECT_SUCCEEDED(file.Close());
+
+  CryptoHash crypto_hash;
+  std::vector<byte> hash;
+  EXPECT_SUCCEEDED(crypto_hash.Compute(data, &hash));
+  return BytesToHex(hash);
+}
+
 HRESULT SetPolicy(const TCHAR* policy_name, DWORD value) {
   ON_SCOPE_EXIT_OBJ(*ConfigManager::Instance(),
                     &ConfigManager::LoadPolicies,
@@ -21,6 +21,7 @@
 #include <windows.h>
 #include <atlstr.h>
 
+#include "base/basictypes.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "omaha/testing/unittest_debug_helper.h"
@@ -199,6 +200,11 @@ void CreateFiles(const TCHAR* parent_dir,
                  const FileStruct files[],
                  size_t number_of_files);
 
+// Creates the file |file_path| of |size| bytes with a pattern which depends on
+// |seed|, replacing the file if it exists. Returns the SHA-256 hash of the
+// file.
+CString CreatePatternFile(const CString& file_path, uint32 size, int seed);
+
 HRESULT SetPolicy(const TCHAR* policy_name, DWORD value);
 HRESULT SetPolicyString(const TCHAR* policy_name, const CString& value);
 
@@ -0,0 +1,110 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/tools/loadgen/latency_stats.h"
+
+#include <algorithm>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/safe_format.h"
+
+namespace omaha {
+
+LatencyStats::LatencyStats()
+    : is_sorted_(true),
+      num_errors_(0),
+      num_bytes_(0) {
+}
+
+LatencyStats::~LatencyStats() {
+}
+
+void LatencyStats::AddSample(double latency_ms) {
+  __mutexScope(lock_);
+  samples_.push_back(latency_ms);
+  is_sorted_ = false;
+}
+
+void LatencyStats::AddError() {
+  __mutexScope(lock_);
+  ++num_errors_;
+}
+
+void LatencyStats::AddBytes(uint64 num_bytes) {
+  __mutexScope(lock_);
+  num_bytes_ += num_bytes;
+}
+
+size_t LatencyStats::num_samples() const {
+  __mutexScope(lock_);
+  return samples_.size();
+}
+
+int LatencyStats::num_errors() const {
+  __mutexScope(lock_);
+  return num_errors_;
+}
+
+double LatencyStats::GetPercentile(double percentile) const {
+  ASSERT1(percentile >= 0 && percentile <= 100);
+
+  __mutexScope(lock_);
+  if (samples_.empty()) {
+    return 0;
+  }
+  if (!is_sorted_) {
+    std::sort(samples_.begin(), samples_.end());
+    is_sorted_ = true;
+  }
+
+  // Nearest rank.
+  size_t rank = static_cast<size_t>(percentile / 100 * samples_.size());
+  rank = std::min(rank, samples_.size() - 1);
+  return samples_[rank];
+}
+
+CString LatencyStats::Summarize(const TCHAR* name, double elapsed_ms) const {
+  ASSERT1(name);
+
+  size_t num_samples = 0;
+  int num_errors = 0;
+  uint64 num_bytes = 0;
+  {
+    __mutexScope(lock_);
+    num_samples = samples_.size();
+    num_errors = num_errors_;
+    num_bytes = num_bytes_;
+  }
+
+  const double elapsed_sec = std::max(elapsed_ms, 1.0) / 1000;
+  CString summary;
+  SafeCStringFormat(&summary,
+                    _T("[%s][%Iu ok][%d errors][%.1f qps][%.1f KB/s]")
+                    _T("[ms: p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, ")
+                    _T("max %.1f]"),
+                    name,
+                    num_samples,
+                    num_errors,
+                    num_samples / elapsed_sec,
+                    num_bytes / 1024.0 / elapsed_sec,
+                    GetPercentile(50),
+                    GetPercentile(90),
+                    GetPercentile(99),
+                    GetPercentile(99.9),
+                    GetPercentile(100));
+  return summary;
+}
+
+}  // namespace omaha
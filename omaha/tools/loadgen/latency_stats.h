@@ -0,0 +1,62 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// LatencyStats collects latency samples from several threads and reports
+// their percentiles and the throughput.
+
+#ifndef OMAHA_TOOLS_LOADGEN_LATENCY_STATS_H_
+#define OMAHA_TOOLS_LOADGEN_LATENCY_STATS_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/synchronized.h"
+
+namespace omaha {
+
+class LatencyStats {
+ public:
+  LatencyStats();
+  ~LatencyStats();
+
+  void AddSample(double latency_ms);
+  void AddError();
+  void AddBytes(uint64 num_bytes);
+
+  size_t num_samples() const;
+  int num_errors() const;
+
+  // Returns the latency below which |percentile| percent of the samples are,
+  // or 0 if there are no samples.
+  double GetPercentile(double percentile) const;
+
+  // Returns a one line summary of the samples collected over |elapsed_ms|.
+  CString Summarize(const TCHAR* name, double elapsed_ms) const;
+
+ private:
+  mutable LLock lock_;
+  mutable std::vector<double> samples_;
+  mutable bool is_sorted_;
+  int num_errors_;
+  uint64 num_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(LatencyStats);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_TOOLS_LOADGEN_LATENCY_STATS_H_
@@ -0,0 +1,174 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/tools/loadgen/load_generator.h"
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/net/connection_pool.h"
+#include "omaha/net/cup_ecdsa_request_impl.h"
+#include "omaha/net/network_config.h"
+#include "omaha/net/simple_request.h"
+
+namespace omaha {
+
+LoadGenerator::LoadGenerator(const std::vector<CStringA>& request_bodies,
+                             const LoadConfig& config)
+    : request_bodies_(request_bodies),
+      config_(config),
+      session_handle_(NULL),
+      next_request_(0),
+      elapsed_ms_(0) {
+  ASSERT1(!request_bodies_.empty());
+  ASSERT1(config_.qps > 0);
+  ASSERT1(config_.num_threads > 0);
+}
+
+LoadGenerator::~LoadGenerator() {
+  if (session_handle_) {
+    ConnectionPool::Instance().UnregisterSession(session_handle_);
+    VERIFY_SUCCEEDED(http_client_->Close(session_handle_));
+  }
+}
+
+HRESULT LoadGenerator::Replay() {
+  http_client_.reset(CreateHttpClient());
+  if (!http_client_.get()) {
+    return E_FAIL;
+  }
+  HRESULT hr = http_client_->Initialize();
+  if (FAILED(hr)) {
+    return hr;
+  }
+  hr = http_client_->Open(NULL,
+                          WINHTTP_ACCESS_TYPE_NO_PROXY,
+                          WINHTTP_NO_PROXY_NAME,
+                          WINHTTP_NO_PROXY_BYPASS,
+                          WINHTTP_FLAG_ASYNC,
+                          &session_handle_);
+  if (FAILED(hr)) {
+    return hr;
+  }
+
+  // The requests reuse the connections of the session, like the requests of
+  // the clients.
+  ConnectionPool::Instance().RegisterSession(session_handle_,
+                                             http_client_.get());
+
+  start_timer_.Start();
+
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int i = 0; i != config_.num_threads; ++i) {
+    threads.push_back(std::make_unique<Thread>());
+    if (!threads.back()->Start(this)) {
+      hr = HRESULTFromLastError();
+      threads.pop_back();
+      break;
+    }
+  }
+
+  for (size_t i = 0; i != threads.size(); ++i) {
+    VERIFY1(threads[i]->WaitTillExit(INFINITE));
+  }
+
+  elapsed_ms_ = GetElapsedMs();
+  return hr;
+}
+
+void LoadGenerator::Run() {
+  const double duration_ms = config_.duration_sec * 1000.0;
+  for (;;) {
+    const LONG index = ::InterlockedIncrement(&next_request_) - 1;
+    const double due_ms = index * 1000.0 / config_.qps;
+    if (due_ms >= duration_ms) {
+      return;
+    }
+
+    const double now_ms = GetElapsedMs();
+    if (due_ms > now_ms) {
+      ::Sleep(static_cast<DWORD>(due_ms - now_ms));
+    }
+
+    const CStringA& request_body(
+        request_bodies_[index % request_bodies_.size()]);
+    const double sent_ms = GetElapsedMs();
+    size_t response_size = 0;
+    HRESULT hr = Send(request_body, &response_size);
+    const double completed_ms = GetElapsedMs();
+
+    if (FAILED(hr)) {
+      latency_stats_.AddError();
+      service_stats_.AddError();
+      continue;
+    }
+
+    latency_stats_.AddSample(completed_ms - due_ms);
+    service_stats_.AddSample(completed_ms - sent_ms);
+    service_stats_.AddBytes(request_body.GetLength() + response_size);
+  }
+}
+
+HRESULT LoadGenerator::Send(const CStringA& request_body,
+                            size_t* response_size) {
+  ASSERT1(response_size);
+
+  CString url(config_.url);
+  if (config_.use_cup) {
+    // Signs the request like CupEcdsaRequest does before it sends it.
+    static const uint8 key_version =
+        internal::CupEcdsaRequestImpl::GetPublicKeyVersion();
+    CString cup2key;
+    CString cup2hreq;
+    std::vector<uint8> request_hash;
+    HRESULT hr = internal::CupEcdsaRequestImpl::BuildRequestUrl(
+        config_.url,
+        key_version,
+        request_body.GetString(),
+        request_body.GetLength(),
+        &url,
+        &cup2key,
+        &cup2hreq,
+        &request_hash);
+    if (FAILED(hr)) {
+      return hr;
+    }
+  }
+
+  SimpleRequest request;
+  request.set_session_handle(session_handle_);
+  request.set_url(url);
+  request.set_request_buffer(request_body.GetString(),
+                             request_body.GetLength());
+  request.set_proxy_configuration(ProxyConfig());
+  request.set_additional_headers(
+      _T("Content-Type: application/x-www-form-urlencoded\r\n"));
+  HRESULT hr = request.Send();
+  if (FAILED(hr)) {
+    return hr;
+  }
+  if (request.GetHttpStatusCode() != HTTP_STATUS_OK) {
+    return HRESULTFromHttpStatusCode(request.GetHttpStatusCode());
+  }
+
+  *response_size = request.GetResponse().size();
+  return S_OK;
+}
+
+double LoadGenerator::GetElapsedMs() const {
+  return static_cast<double>(start_timer_.GetElapsedTicks()) * 1000 /
+         HighresTimer::GetTimerFrequency();
+}
+
+}  // namespace omaha
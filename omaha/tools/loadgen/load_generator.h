@@ -0,0 +1,97 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// LoadGenerator replays serialized update requests to a server at a fixed
+// rate. Request k is due k / qps seconds after the start, whether or not the
+// previous requests completed, so a slow server shows in the latency instead
+// of lowering the rate. The latency of a request is measured from the time
+// it was due, and the service time from the time it was sent.
+
+#ifndef OMAHA_TOOLS_LOADGEN_LOAD_GENERATOR_H_
+#define OMAHA_TOOLS_LOADGEN_LOAD_GENERATOR_H_
+
+#include <windows.h>
+#include <winhttp.h>
+#include <atlstr.h>
+#include <memory>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/thread.h"
+#include "omaha/net/http_client.h"
+#include "omaha/tools/loadgen/latency_stats.h"
+
+namespace omaha {
+
+struct LoadConfig {
+  LoadConfig()
+      : qps(10),
+        duration_sec(10),
+        num_threads(16),
+        use_cup(false) {}
+
+  CString url;
+  double qps;
+  int duration_sec;
+
+  // The number of requests which can be in flight at the same time.
+  int num_threads;
+
+  // Signs the requests with CUP-ECDSA parameters, like the client does.
+  bool use_cup;
+};
+
+class LoadGenerator : public Runnable {
+ public:
+  LoadGenerator(const std::vector<CStringA>& request_bodies,
+                const LoadConfig& config);
+  virtual ~LoadGenerator();
+
+  // Sends the requests and returns when all of them completed.
+  HRESULT Replay();
+
+  const LatencyStats& latency_stats() const { return latency_stats_; }
+  const LatencyStats& service_stats() const { return service_stats_; }
+  double elapsed_ms() const { return elapsed_ms_; }
+
+ private:
+  // Runnable. Each thread sends the next request which is due, until the
+  // end of the run.
+  virtual void Run();
+
+  // Sends |request_body| and returns the size of the response.
+  HRESULT Send(const CStringA& request_body, size_t* response_size);
+
+  double GetElapsedMs() const;
+
+  const std::vector<CStringA>& request_bodies_;
+  const LoadConfig config_;
+
+  std::unique_ptr<HttpClient> http_client_;
+  HINTERNET session_handle_;
+  HighresTimer start_timer_;
+  volatile LONG next_request_;
+  double elapsed_ms_;
+
+  LatencyStats latency_stats_;
+  LatencyStats service_stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoadGenerator);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_TOOLS_LOADGEN_LOAD_GENERATOR_H_
@@ -0,0 +1,202 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// A tool for load testing update servers. It synthesizes the update requests
+// of a population of clients and replays them at a fixed rate, either to the
+// server at /url or to a local mock server. It reports the latency
+// percentiles and the throughput of the client, and of the mock server when
+// there is one. With /server, it only runs the mock server, for another
+// instance of the tool or for a client under test.
+//
+// loadgen [/url <url>] [/qps <n>] [/duration <sec>] [/threads <n>] [/cup]
+//         [/clients <n>] [/apps <n>] [/seed <n>]
+//         [/server] [/port <n>] [/updates <percent>]
+
+#include <windows.h>
+#include <stdio.h>
+#include <tchar.h>
+#include <vector>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/third_party/smartany/scoped_any.h"
+#include "omaha/tools/loadgen/load_generator.h"
+#include "omaha/tools/loadgen/mock_update_server.h"
+#include "omaha/tools/loadgen/request_population.h"
+
+namespace omaha {
+
+namespace {
+
+struct Options {
+  Options() : run_server_only(false), port(0), update_percent(10) {}
+
+  LoadConfig load_config;
+  PopulationConfig population_config;
+  bool run_server_only;
+  int port;
+  int update_percent;
+};
+
+bool ParseOptions(int argc, TCHAR* argv[], Options* options) {
+  ASSERT1(argv);
+  ASSERT1(options);
+
+  for (int i = 1; i < argc; ++i) {
+    const TCHAR* name = argv[i];
+    if (!_tcsicmp(name, _T("/server"))) {
+      options->run_server_only = true;
+      continue;
+    }
+    if (!_tcsicmp(name, _T("/cup"))) {
+      options->load_config.use_cup = true;
+      continue;
+    }
+
+    if (i + 1 == argc) {
+      return false;
+    }
+    const TCHAR* value = argv[++i];
+    if (!_tcsicmp(name, _T("/url"))) {
+      options->load_config.url = value;
+    } else if (!_tcsicmp(name, _T("/qps"))) {
+      options->load_config.qps = _tstof(value);
+    } else if (!_tcsicmp(name, _T("/duration"))) {
+      options->load_config.duration_sec = _ttoi(value);
+    } else if (!_tcsicmp(name, _T("/threads"))) {
+      options->load_config.num_threads = _ttoi(value);
+    } else if (!_tcsicmp(name, _T("/clients"))) {
+      options->population_config.num_clients = _ttoi(value);
+    } else if (!_tcsicmp(name, _T("/apps"))) {
+      options->population_config.num_apps = _ttoi(value);
+    } else if (!_tcsicmp(name, _T("/seed"))) {
+      options->population_config.seed = _tcstoul(value, NULL, 10);
+    } else if (!_tcsicmp(name, _T("/port"))) {
+      options->port = _ttoi(value);
+    } else if (!_tcsicmp(name, _T("/updates"))) {
+      options->update_percent = _ttoi(value);
+    } else {
+      return false;
+    }
+  }
+
+  return options->load_config.qps > 0 &&
+         options->load_config.duration_sec > 0 &&
+         options->load_config.num_threads > 0 &&
+         options->population_config.num_clients > 0 &&
+         options->population_config.num_apps > 0 &&
+         options->port >= 0 &&
+         options->update_percent >= 0 && options->update_percent <= 100;
+}
+
+int RunServer(const Options& options) {
+  MockUpdateServer server(options.port, options.update_percent);
+  HRESULT hr = server.Start();
+  if (FAILED(hr)) {
+    wprintf(_T("[Failed to start the mock server][0x%08x]\n"), hr);
+    return 1;
+  }
+  wprintf(_T("[Mock server listening][%s]\n"), server.update_url());
+
+  // Reports the server side every few seconds, until the duration elapses.
+  const int kReportIntervalSec = 5;
+  for (int elapsed_sec = 0;
+       elapsed_sec < options.load_config.duration_sec;
+       elapsed_sec += kReportIntervalSec) {
+    ::Sleep(kReportIntervalSec * 1000);
+    wprintf(_T("%s\n"),
+            server.stats().Summarize(_T("server"),
+                                     (elapsed_sec + kReportIntervalSec) *
+                                         1000.0));
+  }
+  return 0;
+}
+
+int RunLoad(const Options& options) {
+  wprintf(_T("[Synthesizing requests][%d clients]\n"),
+          options.population_config.num_clients);
+  RequestPopulation population(options.population_config);
+  std::vector<CStringA> request_bodies;
+  HRESULT hr = population.SerializeRequests(&request_bodies);
+  if (FAILED(hr)) {
+    wprintf(_T("[Failed to synthesize the requests][0x%08x]\n"), hr);
+    return 1;
+  }
+
+  std::unique_ptr<MockUpdateServer> server;
+  LoadConfig load_config(options.load_config);
+  if (load_config.url.IsEmpty()) {
+    server.reset(new MockUpdateServer(options.port, options.update_percent));
+    hr = server->Start();
+    if (FAILED(hr)) {
+      wprintf(_T("[Failed to start the mock server][0x%08x]\n"), hr);
+      return 1;
+    }
+    load_config.url = server->update_url();
+  }
+
+  wprintf(_T("[Replaying][%s][%.1f qps][%d sec][%d threads][cup %d]\n"),
+          load_config.url,
+          load_config.qps,
+          load_config.duration_sec,
+          load_config.num_threads,
+          load_config.use_cup);
+  LoadGenerator load_generator(request_bodies, load_config);
+  hr = load_generator.Replay();
+  if (FAILED(hr)) {
+    wprintf(_T("[Replay failed][0x%08x]\n"), hr);
+    return 1;
+  }
+
+  const double elapsed_ms = load_generator.elapsed_ms();
+  wprintf(_T("%s\n"), load_generator.latency_stats().Summarize(
+      _T("client latency"), elapsed_ms));
+  wprintf(_T("%s\n"), load_generator.service_stats().Summarize(
+      _T("client service time"), elapsed_ms));
+  if (server.get()) {
+    server->Stop();
+    wprintf(_T("%s\n"), server->stats().Summarize(_T("server"), elapsed_ms));
+    if (load_config.use_cup) {
+      wprintf(_T("[server][%d cup2hreq mismatches]\n"),
+              server->num_cup_mismatches());
+    }
+  }
+
+  return load_generator.latency_stats().num_errors() ? 1 : 0;
+}
+
+int DoMain(int argc, TCHAR* argv[]) {
+  Options options;
+  if (!ParseOptions(argc, argv, &options)) {
+    wprintf(_T("Usage: loadgen [/url <url>] [/qps <n>] [/duration <sec>] ")
+            _T("[/threads <n>] [/cup] [/clients <n>] [/apps <n>] ")
+            _T("[/seed <n>] [/server] [/port <n>] [/updates <percent>]\n"));
+    return 1;
+  }
+
+  // The requests are serialized with MSXML.
+  scoped_co_init co_init(COINIT_MULTITHREADED);
+  VERIFY1(SUCCEEDED(co_init.hresult()));
+
+  return options.run_server_only ? RunServer(options) : RunLoad(options);
+}
+
+}  // namespace
+
+}  // namespace omaha
+
+int _tmain(int argc, TCHAR* argv[]) {
+  return omaha::DoMain(argc, argv);
+}
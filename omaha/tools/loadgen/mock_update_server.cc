@@ -0,0 +1,105 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/tools/loadgen/mock_update_server.h"
+
+#include <vector>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/highres_timer-win32.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+#include "omaha/net/cup_ecdsa_utils.h"
+#include "omaha/tools/loadgen/request_population.h"
+
+namespace omaha {
+
+namespace {
+
+const char kCupRequestHash[] = "cup2hreq=";
+
+}  // namespace
+
+MockUpdateServer::MockUpdateServer(int port, int update_percent)
+    : LocalHttpServer(port),
+      update_percent_(update_percent),
+      random_value_(::GetTickCount()),
+      num_cup_mismatches_(0) {
+}
+
+MockUpdateServer::~MockUpdateServer() {
+  Stop();
+}
+
+CString MockUpdateServer::update_url() const {
+  CString url;
+  SafeCStringFormat(&url, _T("http://127.0.0.1:%d/service/update2"), port());
+  return url;
+}
+
+int MockUpdateServer::num_cup_mismatches() const {
+  return ::InterlockedCompareExchange(
+      const_cast<volatile LONG*>(&num_cup_mismatches_), 0, 0);
+}
+
+bool MockUpdateServer::BuildResponse(const Request& request,
+                                     CStringA* response) {
+  ASSERT1(response);
+
+  HighresTimer timer;
+
+  const CStringA& request_line(request.request_line);
+  const CStringA& body(request.body);
+  const int request_hash_begin = request_line.Find(kCupRequestHash);
+  if (request_hash_begin != -1) {
+    const int value_begin = request_hash_begin + arraysize(kCupRequestHash) - 1;
+    int value_end = value_begin;
+    while (value_end < request_line.GetLength() &&
+           request_line[value_end] != '&' &&
+           request_line[value_end] != ' ') {
+      ++value_end;
+    }
+
+    std::vector<uint8> request_hash;
+    VERIFY1(internal::SafeSHA256Hash(body.GetString(),
+                                     body.GetLength(),
+                                     &request_hash));
+    const CString expected_hash(BytesToHex(request_hash));
+    const CString actual_hash(request_line.Mid(value_begin,
+                                               value_end - value_begin));
+    if (expected_hash.CompareNoCase(actual_hash)) {
+      ::InterlockedIncrement(&num_cup_mismatches_);
+    }
+  }
+
+  random_value_ = random_value_ * 1103515245 + 12345;
+  CStringA response_body;
+  BuildMockResponse(body, update_percent_, random_value_, &response_body);
+
+  SafeCStringAFormat(response,
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: application/xml; charset=utf-8\r\n"
+                     "Content-Length: %d\r\n"
+                     "\r\n",
+                     response_body.GetLength());
+  *response += response_body;
+
+  stats_.AddBytes(body.GetLength() + response->GetLength());
+  stats_.AddSample(static_cast<double>(timer.GetElapsedTicks()) * 1000 /
+                   HighresTimer::GetTimerFrequency());
+  return true;
+}
+
+}  // namespace omaha
@@ -0,0 +1,66 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// MockUpdateServer is a local http server which answers update requests with
+// the responses of BuildMockResponse. It keeps the connections alive, like
+// the update servers, and measures the time it takes to build the response
+// to each request.
+// When a request carries a cup2hreq parameter, the server checks it against
+// the hash of the body, like the update servers do before they sign the
+// response. The responses are not signed.
+
+#ifndef OMAHA_TOOLS_LOADGEN_MOCK_UPDATE_SERVER_H_
+#define OMAHA_TOOLS_LOADGEN_MOCK_UPDATE_SERVER_H_
+
+#include <windows.h>
+#include <atlstr.h>
+
+#include "base/basictypes.h"
+#include "omaha/testing/local_http_server.h"
+#include "omaha/tools/loadgen/latency_stats.h"
+
+namespace omaha {
+
+class MockUpdateServer : public LocalHttpServer {
+ public:
+  // Listens on |port| of the loopback interface, or on a free port if |port|
+  // is 0. About |update_percent| percent of the apps get an update.
+  MockUpdateServer(int port, int update_percent);
+  virtual ~MockUpdateServer();
+
+  // Returns the url of the update requests.
+  CString update_url() const;
+
+  const LatencyStats& stats() const { return stats_; }
+
+  int num_cup_mismatches() const;
+
+ protected:
+  virtual bool BuildResponse(const Request& request, CStringA* response);
+
+ private:
+  const int update_percent_;
+  uint32 random_value_;                   // Only used by the server thread.
+
+  LatencyStats stats_;
+
+  volatile LONG num_cup_mismatches_;
+
+  DISALLOW_COPY_AND_ASSIGN(MockUpdateServer);
+};
+
+}  // namespace omaha
+
+#endif  // OMAHA_TOOLS_LOADGEN_MOCK_UPDATE_SERVER_H_
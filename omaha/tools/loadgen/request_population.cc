@@ -0,0 +1,347 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/tools/loadgen/request_population.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "omaha/base/debug.h"
+#include "omaha/base/error.h"
+#include "omaha/base/safe_format.h"
+#include "omaha/base/string.h"
+#include "omaha/base/utils.h"
+#include "omaha/common/const_goopdate.h"
+#include "omaha/common/ping_event.h"
+
+namespace omaha {
+
+namespace {
+
+const TCHAR* const kOsVersions[] = {
+  _T("6.1"),
+  _T("6.3"),
+  _T("10.0.19045.3693"),
+  _T("10.0.22631.2861"),
+};
+
+const TCHAR* const kChannels[] = {
+  _T(""),
+  _T("x64-stable"),
+  _T("beta"),
+  _T("dev"),
+};
+
+const TCHAR* const kLanguages[] = {
+  _T("en"),
+  _T("en-GB"),
+  _T("de"),
+  _T("fr"),
+  _T("ja"),
+  _T("pt-BR"),
+  _T("zh-CN"),
+};
+
+const TCHAR* const kBrands[] = {
+  _T(""),
+  _T("GGLS"),
+  _T("GCEA"),
+};
+
+const uint32 kPhysicalMemoryGb[] = {2, 4, 8, 16, 32};
+
+const TCHAR kLabelExpiration[] = _T("Sat, 01 Jan 2039 00:00:00 GMT");
+
+// A deterministic random generator, so a seed always gives the same
+// population.
+class PopulationRandom {
+ public:
+  explicit PopulationRandom(uint32 seed) : state_(seed ? seed : 1) {}
+
+  uint32 Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_;
+  }
+
+  // Returns a number in [0, range).
+  int Uniform(int range) {
+    ASSERT1(range > 0);
+    return static_cast<int>(Next() % static_cast<uint32>(range));
+  }
+
+  bool Percent(int percent) {
+    return Uniform(100) < percent;
+  }
+
+  template <typename T, size_t N>
+  const T& Pick(const T (&values)[N]) {
+    return values[Uniform(static_cast<int>(N))];
+  }
+
+  CString Guid() {
+    CString guid;
+    SafeCStringFormat(&guid, _T("{%08X-%04X-4%03X-8%03X-%04X%08X}"),
+                      Next(),
+                      Next() & 0xffff,
+                      Next() & 0xfff,
+                      Next() & 0xfff,
+                      Next() & 0xffff,
+                      Next());
+    return guid;
+  }
+
+ private:
+  uint32 state_;
+};
+
+// Returns the value of the attribute |name| in the element which starts at
+// |begin| in |xml|, or an empty string.
+CStringA GetAttribute(const CStringA& xml, int begin, const char* name) {
+  const int tag_end = xml.Find('>', begin);
+  CStringA pattern;
+  SafeCStringAFormat(&pattern, " %s=\"", name);
+  const int attribute = xml.Find(pattern, begin);
+  if (attribute == -1 || (tag_end != -1 && attribute > tag_end)) {
+    return CStringA();
+  }
+  const int value_begin = attribute + pattern.GetLength();
+  const int value_end = xml.Find('"', value_begin);
+  return value_end == -1 ? CStringA() :
+                           xml.Mid(value_begin, value_end - value_begin);
+}
+
+// Returns the number of occurrences of |tag| in |xml| in [begin, end).
+int CountElements(const CStringA& xml, int begin, int end, const char* tag) {
+  int count = 0;
+  for (int pos = xml.Find(tag, begin);
+       pos != -1 && pos < end;
+       pos = xml.Find(tag, pos + 1)) {
+    ++count;
+  }
+  return count;
+}
+
+}  // namespace
+
+RequestPopulation::RequestPopulation(const PopulationConfig& config)
+    : config_(config) {
+  ASSERT1(config_.num_clients > 0);
+  ASSERT1(config_.num_apps > 0);
+  ASSERT1(config_.max_apps_per_client > 0);
+  ASSERT1(config_.num_cohorts > 0);
+}
+
+RequestPopulation::~RequestPopulation() {
+}
+
+xml::UpdateRequest* RequestPopulation::CreateRequest(int client_index) const {
+  ASSERT1(client_index >= 0);
+
+  PopulationRandom random(config_.seed * 2654435761U + client_index);
+
+  xml::request::Request request;
+  request.is_machine = random.Percent(config_.machine_percent);
+  request.protocol_version = _T("3.0");
+  request.uid = random.Guid();
+  request.omaha_version = _T("1.3.36.372");
+  request.omaha_shell_version = _T("1.3.36.372");
+  request.install_source = random.Percent(10) ? _T("ondemandupdate") :
+                                                _T("scheduler");
+  request.session_id = random.Guid();
+  request.request_id = random.Guid();
+  request.domain_joined = random.Percent(5);
+
+  request.hw.physmemory = random.Pick(kPhysicalMemoryGb);
+  request.hw.has_sse = true;
+  request.hw.has_sse2 = true;
+  request.hw.has_sse3 = true;
+  request.hw.has_ssse3 = true;
+  request.hw.has_sse41 = true;
+  request.hw.has_sse42 = true;
+  request.hw.has_avx = random.Percent(80);
+
+  request.os.platform = kPlatformWin;
+  request.os.version = random.Pick(kOsVersions);
+  request.os.arch = random.Percent(90) ? _T("x64") : _T("x86");
+
+  // The first apps are installed on most clients, like the browsers, and the
+  // apps at the end of the list are rare.
+  std::vector<int> app_indexes;
+  const int num_apps = 1 + random.Uniform(std::min(config_.max_apps_per_client,
+                                                   config_.num_apps));
+  while (static_cast<int>(app_indexes.size()) != num_apps) {
+    const int app_index = random.Uniform(1 + random.Uniform(config_.num_apps));
+    if (std::find(app_indexes.begin(), app_indexes.end(), app_index) ==
+        app_indexes.end()) {
+      app_indexes.push_back(app_index);
+    }
+  }
+
+  for (size_t i = 0; i != app_indexes.size(); ++i) {
+    xml::request::App app;
+    app.app_id = GetAppId(app_indexes[i]);
+    SafeCStringFormat(&app.version, _T("%d.0.%d.%d"),
+                      100 + app_indexes[i] % 30,
+                      random.Uniform(7000),
+                      random.Uniform(200));
+    app.ap = random.Pick(kChannels);
+    app.lang = random.Pick(kLanguages);
+    app.brand_code = random.Pick(kBrands);
+    app.iid = GuidToString(GUID_NULL);
+    app.install_time_diff_sec = random.Uniform(5 * 365 * 24 * 60 * 60);
+
+    const int cohort = random.Uniform(config_.num_cohorts);
+    SafeCStringFormat(&app.cohort, _T("1:%x:"), cohort);
+    SafeCStringFormat(&app.cohort_name, _T("Cohort%d"), cohort);
+
+    const int num_labels = config_.max_experiment_labels ?
+        random.Uniform(config_.max_experiment_labels + 1) : 0;
+    for (int label = 0; label != num_labels; ++label) {
+      if (label) {
+        app.experiments.AppendChar(_T(';'));
+      }
+      SafeCStringAppendFormat(&app.experiments, _T("exp%d=group%c|%s"),
+                              label,
+                              _T('A') + random.Uniform(4),
+                              kLabelExpiration);
+    }
+
+    app.update_check.is_valid = true;
+
+    app.ping.active = random.Percent(70) ? ACTIVE_RUN : ACTIVE_NOTRUN;
+    app.ping.days_since_last_active_ping = random.Uniform(3);
+    app.ping.days_since_last_roll_call = random.Uniform(2);
+    app.ping.day_of_last_activity = 6500 + random.Uniform(30);
+    app.ping.day_of_last_roll_call = 6500 + random.Uniform(30);
+
+    if (random.Percent(config_.ping_event_percent)) {
+      app.ping_events.push_back(PingEventPtr(
+          new PingEvent(PingEvent::EVENT_UPDATE_COMPLETE,
+                        PingEvent::EVENT_RESULT_SUCCESS,
+                        0,
+                        0)));
+    }
+
+    request.apps.push_back(app);
+  }
+
+  return xml::UpdateRequest::CreateFromRequest(request);
+}
+
+HRESULT RequestPopulation::SerializeRequests(
+    std::vector<CStringA>* request_bodies) const {
+  ASSERT1(request_bodies);
+
+  request_bodies->clear();
+  request_bodies->reserve(config_.num_clients);
+  for (int i = 0; i != config_.num_clients; ++i) {
+    std::unique_ptr<xml::UpdateRequest> update_request(CreateRequest(i));
+    CString request_string;
+    HRESULT hr = update_request->Serialize(&request_string);
+    if (FAILED(hr)) {
+      return hr;
+    }
+    request_bodies->push_back(WideToUtf8(request_string));
+  }
+  return S_OK;
+}
+
+CString RequestPopulation::GetAppId(int app_index) {
+  CString app_id;
+  SafeCStringFormat(&app_id, _T("{4C0AD000-0000-4000-8000-%012X}"),
+                    app_index);
+  return app_id;
+}
+
+void BuildMockResponse(const CStringA& request_body,
+                       int update_percent,
+                       uint32 random_value,
+                       CStringA* response_body) {
+  ASSERT1(response_body);
+
+  PopulationRandom random(random_value);
+
+  CStringA& response = *response_body;
+  response = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+             "<response protocol=\"3.0\" server=\"loadgen\">"
+             "<daystart elapsed_seconds=\"43200\" elapsed_days=\"6500\"/>";
+
+  for (int begin = request_body.Find("<app ");
+       begin != -1;
+       begin = request_body.Find("<app ", begin + 1)) {
+    // The child elements of the app are up to the end tag, unless the start
+    // tag is also the end tag.
+    const int tag_end = request_body.Find('>', begin);
+    if (tag_end == -1) {
+      break;
+    }
+    int end = tag_end;
+    if (request_body[tag_end - 1] != '/') {
+      end = request_body.Find("</app>", tag_end);
+      if (end == -1) {
+        end = request_body.GetLength();
+      }
+    }
+
+    const CStringA app_id(GetAttribute(request_body, begin, "appid"));
+    const CStringA cohort(GetAttribute(request_body, begin, "cohort"));
+    const CStringA cohort_name(GetAttribute(request_body, begin, "cohortname"));
+    SafeCStringAAppendFormat(&response,
+                             "<app appid=\"%s\" status=\"ok\" cohort=\"%s\" "
+                             "cohortname=\"%s\">",
+                             app_id, cohort, cohort_name);
+
+    if (CountElements(request_body, tag_end, end, "<updatecheck")) {
+      if (random.Percent(update_percent)) {
+        SafeCStringAAppendFormat(
+            &response,
+            "<updatecheck status=\"ok\"><urls>"
+            "<url codebase=\"http://dl.example.com/edgedl/%s/\"/></urls>"
+            "<manifest version=\"200.0.%d.0\"><packages>"
+            "<package hash_sha256=\"%08x%08x%08x%08x%08x%08x%08x%08x\" "
+            "name=\"setup.exe\" required=\"true\" size=\"%d\"/>"
+            "</packages><actions>"
+            "<action event=\"install\" run=\"setup.exe\" "
+            "arguments=\"--update\" needsadmin=\"false\"/>"
+            "<action event=\"postinstall\" "
+            "onsuccess=\"exitsilentlyonlaunchcmd\"/>"
+            "</actions></manifest></updatecheck>",
+            app_id,
+            random.Uniform(7000),
+            random.Next(), random.Next(), random.Next(), random.Next(),
+            random.Next(), random.Next(), random.Next(), random.Next(),
+            1000000 + random.Uniform(100000000));
+      } else {
+        response += "<updatecheck status=\"noupdate\"/>";
+      }
+    }
+
+    if (CountElements(request_body, tag_end, end, "<ping ")) {
+      response += "<ping status=\"ok\"/>";
+    }
+    const int num_events = CountElements(request_body, tag_end, end, "<event ");
+    for (int i = 0; i != num_events; ++i) {
+      response += "<event status=\"ok\"/>";
+    }
+
+    response += "</app>";
+  }
+
+  response += "</response>";
+}
+
+}  // namespace omaha
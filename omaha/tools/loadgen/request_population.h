@@ -0,0 +1,98 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+//
+// RequestPopulation synthesizes the update requests of a population of
+// clients, with the apps, cohorts, experiment labels, and pings which real
+// clients send. The requests are serialized by the same code as the client.
+// BuildMockResponse answers a serialized request like an update server.
+
+#ifndef OMAHA_TOOLS_LOADGEN_REQUEST_POPULATION_H_
+#define OMAHA_TOOLS_LOADGEN_REQUEST_POPULATION_H_
+
+#include <windows.h>
+#include <atlstr.h>
+#include <vector>
+
+#include "base/basictypes.h"
+#include "omaha/common/update_request.h"
+
+namespace omaha {
+
+struct PopulationConfig {
+  PopulationConfig()
+      : num_clients(1000),
+        num_apps(20),
+        max_apps_per_client(5),
+        num_cohorts(8),
+        max_experiment_labels(3),
+        ping_event_percent(10),
+        machine_percent(80),
+        seed(1) {}
+
+  int num_clients;
+
+  // The number of different apps. A few apps are installed on most clients.
+  int num_apps;
+  int max_apps_per_client;
+
+  int num_cohorts;
+  int max_experiment_labels;
+
+  // The percentage of the apps which report an event ping, as they do after
+  // an install or an update.
+  int ping_event_percent;
+
+  // The percentage of the clients which are machine installs.
+  int machine_percent;
+
+  // The same seed synthesizes the same population.
+  uint32 seed;
+};
+
+class RequestPopulation {
+ public:
+  explicit RequestPopulation(const PopulationConfig& config);
+  ~RequestPopulation();
+
+  // Synthesizes the request of the client at |client_index|. The same index
+  // always gives the same request. Caller takes ownership.
+  xml::UpdateRequest* CreateRequest(int client_index) const;
+
+  // Synthesizes and serializes the requests of all the clients, as UTF-8.
+  HRESULT SerializeRequests(std::vector<CStringA>* request_bodies) const;
+
+  const PopulationConfig& config() const { return config_; }
+
+ private:
+  // Returns the id of the app at |app_index| in the population.
+  static CString GetAppId(int app_index);
+
+  const PopulationConfig config_;
+
+  DISALLOW_COPY_AND_ASSIGN(RequestPopulation);
+};
+
+// Builds the body of the response of an update server to |request_body|:
+// every app gets an update check response, which is an update for about
+// |update_percent| percent of the apps, and every ping and event is
+// acknowledged. |random_value| picks the apps which get an update.
+void BuildMockResponse(const CStringA& request_body,
+                       int update_percent,
+                       uint32 random_value,
+                       CStringA* response_body);
+
+}  // namespace omaha
+
+#endif  // OMAHA_TOOLS_LOADGEN_REQUEST_POPULATION_H_
@@ -0,0 +1,156 @@
+// Copyright 2026 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+// ========================================================================
+
+#include "omaha/tools/loadgen/request_population.h"
+
+#include <memory>
+#include <vector>
+
+#include "omaha/common/update_response.h"
+#include "omaha/common/xml_parser.h"
+#include "omaha/testing/unit_test.h"
+#include "omaha/tools/loadgen/latency_stats.h"
+
+namespace omaha {
+
+namespace {
+
+std::vector<uint8> ToBuffer(const CStringA& string) {
+  return std::vector<uint8>(string.GetString(),
+                            string.GetString() + string.GetLength());
+}
+
+}  // namespace
+
+TEST(RequestPopulationTest, CreateRequest) {
+  PopulationConfig config;
+  config.max_apps_per_client = 4;
+  config.ping_event_percent = 50;
+  RequestPopulation population(config);
+
+  for (int i = 0; i != 50; ++i) {
+    std::unique_ptr<xml::UpdateRequest> update_request(
+        population.CreateRequest(i));
+    const xml::request::Request& request = update_request->request();
+    EXPECT_STREQ(_T("3.0"), request.protocol_version);
+    EXPECT_FALSE(request.uid.IsEmpty());
+    EXPECT_LE(1u, request.apps.size());
+    EXPECT_GE(4u, request.apps.size());
+
+    for (size_t j = 0; j != request.apps.size(); ++j) {
+      EXPECT_TRUE(request.apps[j].update_check.is_valid);
+      EXPECT_FALSE(request.apps[j].cohort.IsEmpty());
+      for (size_t k = 0; k != j; ++k) {
+        EXPECT_STRNE(request.apps[k].app_id, request.apps[j].app_id);
+      }
+    }
+  }
+}
+
+TEST(RequestPopulationTest, SerializeRequests_Deterministic) {
+  PopulationConfig config;
+  config.num_clients = 20;
+  std::vector<CStringA> request_bodies;
+  EXPECT_SUCCEEDED(
+      RequestPopulation(config).SerializeRequests(&request_bodies));
+  ASSERT_EQ(20u, request_bodies.size());
+
+  std::vector<CStringA> same_request_bodies;
+  EXPECT_SUCCEEDED(
+      RequestPopulation(config).SerializeRequests(&same_request_bodies));
+
+  config.seed = 2;
+  std::vector<CStringA> other_request_bodies;
+  EXPECT_SUCCEEDED(
+      RequestPopulation(config).SerializeRequests(&other_request_bodies));
+
+  for (size_t i = 0; i != request_bodies.size(); ++i) {
+    EXPECT_EQ(0, request_bodies[i].Find("<?xml"));
+    EXPECT_NE(-1, request_bodies[i].Find("<updatecheck"));
+    EXPECT_STREQ(request_bodies[i], same_request_bodies[i]);
+    EXPECT_STRNE(request_bodies[i], other_request_bodies[i]);
+    if (i) {
+      EXPECT_STRNE(request_bodies[i - 1], request_bodies[i]);
+    }
+  }
+}
+
+// The mock responses are parsed by the client.
+TEST(RequestPopulationTest, BuildMockResponse) {
+  PopulationConfig config;
+  config.num_clients = 20;
+  config.ping_event_percent = 50;
+  RequestPopulation population(config);
+
+  const int kUpdatePercents[] = {0, 100};
+  for (size_t i = 0; i != arraysize(kUpdatePercents); ++i) {
+    for (int client = 0; client != config.num_clients; ++client) {
+      std::unique_ptr<xml::UpdateRequest> update_request(
+          population.CreateRequest(client));
+      CString request_string;
+      EXPECT_SUCCEEDED(update_request->Serialize(&request_string));
+
+      CStringA response_body;
+      BuildMockResponse(WideToUtf8(request_string),
+                        kUpdatePercents[i],
+                        client + 1,
+                        &response_body);
+
+      std::unique_ptr<xml::UpdateResponse> update_response(
+          xml::UpdateResponse::Create());
+      ASSERT_SUCCEEDED(xml::XmlParser::DeserializeResponse(
+          ToBuffer(response_body),
+          update_response.get()));
+
+      const xml::request::Request& request = update_request->request();
+      const xml::response::Response& response = update_response->response();
+      ASSERT_EQ(request.apps.size(), response.apps.size());
+      for (size_t j = 0; j != response.apps.size(); ++j) {
+        const xml::response::App& app = response.apps[j];
+        EXPECT_STREQ(request.apps[j].app_id, app.appid);
+        EXPECT_STREQ(request.apps[j].cohort, app.cohort);
+        EXPECT_STREQ(_T("ok"), app.status);
+        EXPECT_STREQ(kUpdatePercents[i] ? _T("ok") : _T("noupdate"),
+                     app.update_check.status);
+        EXPECT_EQ(kUpdatePercents[i] ? 1u : 0u,
+                  app.update_check.install_manifest.packages.size());
+        EXPECT_EQ(request.apps[j].ping_events.size(), app.events.size());
+      }
+    }
+  }
+}
+
+TEST(LatencyStatsTest, Percentiles) {
+  LatencyStats stats;
+  EXPECT_EQ(0, stats.GetPercentile(50));
+
+  for (int i = 1000; i != 0; --i) {
+    stats.AddSample(i);
+  }
+  stats.AddError();
+  EXPECT_EQ(1000u, stats.num_samples());
+  EXPECT_EQ(1, stats.num_errors());
+  EXPECT_EQ(1, stats.GetPercentile(0));
+  EXPECT_EQ(501, stats.GetPercentile(50));
+  EXPECT_EQ(991, stats.GetPercentile(99));
+  EXPECT_EQ(1000, stats.GetPercentile(100));
+
+  // Samples can be added after the percentiles are read.
+  stats.AddSample(2000);
+  EXPECT_EQ(2000, stats.GetPercentile(100));
+  EXPECT_NE(-1, stats.Summarize(_T("test"), 1000).Find(_T("[1001 ok]")));
+}
+
+}  // namespace omaha